@@ -1769,6 +1769,12 @@ COMMAND_CALLBACK(debug)
         return WEECHAT_RC_OK;
     }
 
+    if (string_strcasecmp (argv[1], "bars") == 0)
+    {
+        debug_bars ();
+        return WEECHAT_RC_OK;
+    }
+
     if (string_strcasecmp (argv[1], "buffer") == 0)
     {
         gui_buffer_dump_hexa (buffer);
@@ -1848,6 +1854,7 @@ COMMAND_CALLBACK(debug)
     if (string_strcasecmp (argv[1], "tags") == 0)
     {
         gui_chat_display_tags ^= 1;
+        gui_line_layout_changed ();
         gui_window_ask_refresh (2);
         return WEECHAT_RC_OK;
     }
@@ -1903,6 +1910,12 @@ COMMAND_CALLBACK(debug)
         return WEECHAT_RC_OK;
     }
 
+    if (string_strcasecmp (argv[1], "upgrade") == 0)
+    {
+        debug_upgrade ();
+        return WEECHAT_RC_OK;
+    }
+
     if (string_strcasecmp (argv[1], "time") == 0)
     {
         COMMAND_MIN_ARGS(3, "time");
@@ -4365,11 +4378,10 @@ command_plugin_list (const char *name, int full)
                         hook_found = 1;
                         gui_chat_printf (NULL,
                                          _("      socket: %d, address: %s, "
-                                           "port: %d, child pid: %d"),
+                                           "port: %d"),
                                          HOOK_CONNECT(ptr_hook, sock),
                                          HOOK_CONNECT(ptr_hook, address),
-                                         HOOK_CONNECT(ptr_hook, port),
-                                         HOOK_CONNECT(ptr_hook, child_pid));
+                                         HOOK_CONNECT(ptr_hook, port));
                     }
                 }
 
@@ -7296,7 +7308,7 @@ command_init ()
         N_("list"
            " || set <plugin> <level>"
            " || dump [<plugin>]"
-           " || buffer|color|infolists|memory|tags|term|windows"
+           " || bars|buffer|color|infolists|memory|tags|term|upgrade|windows"
            " || mouse|cursor [verbose]"
            " || hdata [free]"
            " || time <command>"),
@@ -7306,6 +7318,8 @@ command_init ()
            "    level: debug level for plugin (0 = disable debug)\n"
            "     dump: save memory dump in WeeChat log file (same dump is "
            "written when WeeChat crashes)\n"
+           "     bars: display counters of bar items updates and bar "
+           "conditions evaluated\n"
            "   buffer: dump buffer content with hexadecimal values in log file\n"
            "    color: display infos about current color pairs\n"
            "   cursor: toggle debug for cursor mode\n"
@@ -7319,12 +7333,15 @@ command_init ()
            "    mouse: toggle debug for mouse\n"
            "     tags: display tags for lines\n"
            "     term: display infos about terminal\n"
+           "  upgrade: display time to save and load core data during last "
+           "upgrade\n"
            "  windows: display windows tree\n"
            "     time: measure time to execute a command or to send text to "
            "the current buffer"),
         "list"
         " || set %(plugins_names)|" PLUGIN_CORE
         " || dump %(plugins_names)|" PLUGIN_CORE
+        " || bars"
         " || buffer"
         " || color"
         " || cursor verbose"
@@ -7337,6 +7354,7 @@ command_init ()
         " || mouse verbose"
         " || tags"
         " || term"
+        " || upgrade"
         " || windows"
         " || time %(commands:/)",
         &command_debug, NULL, NULL);
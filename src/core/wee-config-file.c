@@ -36,6 +36,7 @@
 #include "weechat.h"
 #include "wee-config-file.h"
 #include "wee-config.h"
+#include "wee-hashtable.h"
 #include "wee-hdata.h"
 #include "wee-hook.h"
 #include "wee-infolist.h"
@@ -59,6 +60,61 @@ char *config_boolean_false[] = { "off", "no", "n", "false", "f", "0", NULL };
 void config_file_option_free_data (struct t_config_option *option);
 
 
+/*
+ * Hashes a name of section or option (case insensitive).
+ */
+
+unsigned long long
+config_file_hash_key_cb (struct t_hashtable *hashtable, const void *key)
+{
+    unsigned long long hash;
+    const char *ptr_key;
+    char chr;
+
+    /* make C compiler happy */
+    (void) hashtable;
+
+    hash = 5381;
+    for (ptr_key = (const char *)key; ptr_key[0]; ptr_key++)
+    {
+        chr = ptr_key[0];
+        if ((chr >= 'A') && (chr <= 'Z'))
+            chr += ('a' - 'A');
+        hash ^= (hash << 5) + (hash >> 2) + (int)chr;
+    }
+
+    return hash;
+}
+
+/*
+ * Compares two names of section or option (case insensitive).
+ */
+
+int
+config_file_keycmp_cb (struct t_hashtable *hashtable,
+                       const void *key1, const void *key2)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return string_strcasecmp ((const char *)key1, (const char *)key2);
+}
+
+/*
+ * Creates a hashtable to index sections or options by name (case
+ * insensitive).
+ */
+
+struct t_hashtable *
+config_file_hashtable_new ()
+{
+    return hashtable_new (32,
+                          WEECHAT_HASHTABLE_STRING,
+                          WEECHAT_HASHTABLE_POINTER,
+                          &config_file_hash_key_cb,
+                          &config_file_keycmp_cb);
+}
+
 /*
  * Searches for a configuration file.
  */
@@ -163,6 +219,7 @@ config_file_new (struct t_weechat_plugin *plugin, const char *name,
         new_config_file->callback_reload_data = callback_reload_data;
         new_config_file->sections = NULL;
         new_config_file->last_section = NULL;
+        new_config_file->hash_sections = config_file_hashtable_new ();
 
         new_config_file->prev_config = last_config_file;
         new_config_file->next_config = NULL;
@@ -283,6 +340,7 @@ config_file_new_section (struct t_config_file *config_file, const char *name,
         new_section->callback_delete_option_data = callback_delete_option_data;
         new_section->options = NULL;
         new_section->last_option = NULL;
+        new_section->hash_options = config_file_hashtable_new ();
 
         new_section->prev_section = config_file->last_section;
         new_section->next_section = NULL;
@@ -291,6 +349,8 @@ config_file_new_section (struct t_config_file *config_file, const char *name,
         else
             config_file->sections = new_section;
         config_file->last_section = new_section;
+        if (config_file->hash_sections)
+            hashtable_set (config_file->hash_sections, name, new_section);
     }
 
     return new_section;
@@ -311,6 +371,9 @@ config_file_search_section (struct t_config_file *config_file,
     if (!config_file || !section_name)
         return NULL;
 
+    if (config_file->hash_sections)
+        return hashtable_get (config_file->hash_sections, section_name);
+
     for (ptr_section = config_file->sections; ptr_section;
          ptr_section = ptr_section->next_section)
     {
@@ -416,6 +479,12 @@ config_file_option_find_pos (struct t_config_section *section, const char *name)
 
     if (section && name)
     {
+        /* options are often added in order (for example when reading file) */
+        if (section->last_option
+            && (string_strcasecmp (name, section->last_option->name) >= 0))
+        {
+            return NULL;
+        }
         for (ptr_option = section->options; ptr_option;
              ptr_option = ptr_option->next_option)
         {
@@ -472,6 +541,52 @@ config_file_option_insert_in_section (struct t_config_option *option)
         (option->section)->options = option;
         (option->section)->last_option = option;
     }
+
+    /*
+     * add option in hashtable (if an option with same name already exists,
+     * it is before this one in list and it remains the one found)
+     */
+    if ((option->section)->hash_options
+        && !hashtable_has_key ((option->section)->hash_options, option->name))
+    {
+        hashtable_set ((option->section)->hash_options, option->name, option);
+    }
+}
+
+/*
+ * Removes an option from hashtable of options in its section.
+ *
+ * If another option has same name (it is then next or previous option in
+ * list), it replaces the option in hashtable.
+ */
+
+void
+config_file_option_remove_from_hash (struct t_config_option *option)
+{
+    struct t_hashtable *ptr_hash;
+
+    if (!option || !option->section || !option->name)
+        return;
+
+    ptr_hash = (option->section)->hash_options;
+    if (!ptr_hash || (hashtable_get (ptr_hash, option->name) != option))
+        return;
+
+    if (option->next_option
+        && (string_strcasecmp (option->next_option->name, option->name) == 0))
+    {
+        hashtable_set (ptr_hash, option->name, option->next_option);
+    }
+    else if (option->prev_option
+             && (string_strcasecmp (option->prev_option->name,
+                                    option->name) == 0))
+    {
+        hashtable_set (ptr_hash, option->name, option->prev_option);
+    }
+    else
+    {
+        hashtable_remove (ptr_hash, option->name);
+    }
 }
 
 /*
@@ -813,6 +928,35 @@ end:
     return new_option;
 }
 
+/*
+ * Searches for an option in a section (case insensitive).
+ *
+ * Returns pointer to option found, NULL if not found.
+ */
+
+struct t_config_option *
+config_file_section_search_option (struct t_config_section *section,
+                                   const char *option_name)
+{
+    struct t_config_option *ptr_option;
+
+    if (!section || !option_name)
+        return NULL;
+
+    if (section->hash_options)
+        return hashtable_get (section->hash_options, option_name);
+
+    for (ptr_option = section->options; ptr_option;
+         ptr_option = ptr_option->next_option)
+    {
+        if (string_strcasecmp (ptr_option->name, option_name) == 0)
+            return ptr_option;
+    }
+
+    /* option not found */
+    return NULL;
+}
+
 /*
  * Searches for an option in a configuration file or section.
  *
@@ -829,24 +973,17 @@ config_file_search_option (struct t_config_file *config_file,
 
     if (section)
     {
-        for (ptr_option = section->options; ptr_option;
-             ptr_option = ptr_option->next_option)
-        {
-            if (string_strcasecmp (ptr_option->name, option_name) == 0)
-                return ptr_option;
-        }
+        return config_file_section_search_option (section, option_name);
     }
     else if (config_file)
     {
         for (ptr_section = config_file->sections; ptr_section;
              ptr_section = ptr_section->next_section)
         {
-            for (ptr_option = ptr_section->options; ptr_option;
-                 ptr_option = ptr_option->next_option)
-            {
-                if (string_strcasecmp (ptr_option->name, option_name) == 0)
-                    return ptr_option;
-            }
+            ptr_option = config_file_section_search_option (ptr_section,
+                                                            option_name);
+            if (ptr_option)
+                return ptr_option;
         }
     }
 
@@ -876,30 +1013,25 @@ config_file_search_section_option (struct t_config_file *config_file,
 
     if (section)
     {
-        for (ptr_option = section->options; ptr_option;
-             ptr_option = ptr_option->next_option)
+        ptr_option = config_file_section_search_option (section, option_name);
+        if (ptr_option)
         {
-            if (string_strcasecmp (ptr_option->name, option_name) == 0)
-            {
-                *section_found = section;
-                *option_found = ptr_option;
-                return;
-            }
+            *section_found = section;
+            *option_found = ptr_option;
         }
     }
     else if (config_file)
     {
+        /* if option is in many sections, the last section is returned */
         for (ptr_section = config_file->sections; ptr_section;
              ptr_section = ptr_section->next_section)
         {
-            for (ptr_option = ptr_section->options; ptr_option;
-                 ptr_option = ptr_option->next_option)
+            ptr_option = config_file_section_search_option (ptr_section,
+                                                            option_name);
+            if (ptr_option)
             {
-                if (string_strcasecmp (ptr_option->name, option_name) == 0)
-                {
-                    *section_found = ptr_section;
-                    *option_found = ptr_option;
-                }
+                *section_found = ptr_section;
+                *option_found = ptr_option;
             }
         }
     }
@@ -1643,6 +1775,7 @@ config_file_option_rename (struct t_config_option *option,
         /* remove option from list */
         if (option->section)
         {
+            config_file_option_remove_from_hash (option);
             if (option->prev_option)
                 (option->prev_option)->next_option = option->next_option;
             if (option->next_option)
@@ -2895,6 +3028,9 @@ config_file_option_free (struct t_config_option *option, int run_callback)
 
     ptr_section = option->section;
 
+    /* remove option from hashtable of section (before name is freed) */
+    config_file_option_remove_from_hash (option);
+
     /* free data */
     config_file_option_free_data (option);
 
@@ -2957,6 +3093,13 @@ config_file_section_free (struct t_config_section *section)
 
     /* free data */
     config_file_section_free_options (section);
+    if (section->hash_options)
+        hashtable_free (section->hash_options);
+    if (ptr_config->hash_sections
+        && (hashtable_get (ptr_config->hash_sections, section->name) == section))
+    {
+        hashtable_remove (ptr_config->hash_sections, section->name);
+    }
     if (section->name)
         free (section->name);
     if (section->callback_read_data)
@@ -3006,6 +3149,8 @@ config_file_free (struct t_config_file *config_file)
     {
         config_file_section_free (config_file->sections);
     }
+    if (config_file->hash_sections)
+        hashtable_free (config_file->hash_sections);
     if (config_file->name)
         free (config_file->name);
     if (config_file->filename)
@@ -3408,6 +3553,7 @@ config_file_print_log ()
         log_printf ("  callback_reload_data . : 0x%lx", ptr_config_file->callback_reload_data);
         log_printf ("  sections . . . . . . . : 0x%lx", ptr_config_file->sections);
         log_printf ("  last_section . . . . . : 0x%lx", ptr_config_file->last_section);
+        log_printf ("  hash_sections. . . . . : 0x%lx", ptr_config_file->hash_sections);
         log_printf ("  prev_config. . . . . . : 0x%lx", ptr_config_file->prev_config);
         log_printf ("  next_config. . . . . . : 0x%lx", ptr_config_file->next_config);
 
@@ -3435,6 +3581,7 @@ config_file_print_log ()
             log_printf ("      callback_delete_option_data . : 0x%lx", ptr_section->callback_delete_option_data);
             log_printf ("      options . . . . . . . . . . . : 0x%lx", ptr_section->options);
             log_printf ("      last_option . . . . . . . . . : 0x%lx", ptr_section->last_option);
+            log_printf ("      hash_options. . . . . . . . . : 0x%lx", ptr_section->hash_options);
             log_printf ("      prev_section. . . . . . . . . : 0x%lx", ptr_section->prev_section);
             log_printf ("      next_section. . . . . . . . . : 0x%lx", ptr_section->next_section);
 
@@ -40,6 +40,7 @@
 
 struct t_weelist;
 struct t_infolist;
+struct t_hashtable;
 
 struct t_config_option;
 
@@ -58,6 +59,8 @@ struct t_config_file
     void *callback_reload_data;            /* data sent to callback         */
     struct t_config_section *sections;     /* config sections               */
     struct t_config_section *last_section; /* last config section           */
+    struct t_hashtable *hash_sections;     /* sections by name (case        */
+                                           /* insensitive)                  */
     struct t_config_file *prev_config;     /* link to previous config file  */
     struct t_config_file *next_config;     /* link to next config file      */
 };
@@ -110,6 +113,8 @@ struct t_config_section
     void *callback_delete_option_data;     /* data sent to delete callback  */
     struct t_config_option *options;       /* options in section            */
     struct t_config_option *last_option;   /* last option in section        */
+    struct t_hashtable *hash_options;      /* options by name (case         */
+                                           /* insensitive)                  */
     struct t_config_section *prev_section; /* link to previous section      */
     struct t_config_section *next_section; /* link to next section          */
 };
@@ -239,6 +244,8 @@ extern struct t_config_option *config_file_new_option (struct t_config_file *con
                                                                                struct t_config_option *option),
                                                        const void *callback_delete_pointer,
                                                        void *callback_delete_data);
+extern struct t_config_option *config_file_section_search_option (struct t_config_section *section,
+                                                                  const char *option_name);
 extern struct t_config_option *config_file_search_option (struct t_config_file *config_file,
                                                           struct t_config_section *section,
                                                           const char *option_name);
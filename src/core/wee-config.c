@@ -95,6 +95,7 @@ struct t_config_option *config_look_buffer_notify_default;
 struct t_config_option *config_look_buffer_position;
 struct t_config_option *config_look_buffer_search_case_sensitive;
 struct t_config_option *config_look_buffer_search_force_default;
+struct t_config_option *config_look_buffer_search_index;
 struct t_config_option *config_look_buffer_search_regex;
 struct t_config_option *config_look_buffer_search_where;
 struct t_config_option *config_look_buffer_time_format;
@@ -559,6 +560,7 @@ config_change_buffers (const void *pointer, void *data,
     (void) data;
     (void) option;
 
+    gui_line_layout_changed ();
     gui_window_ask_refresh (1);
 }
 
@@ -649,6 +651,7 @@ config_change_buffer_time_format (const void *pointer, void *data,
 
     gui_chat_time_length = gui_chat_get_time_length ();
     gui_chat_change_time_format ();
+    gui_line_layout_changed ();
     if (gui_init_ok)
         gui_window_ask_refresh (1);
 }
@@ -759,6 +762,7 @@ config_change_nick_prefix_suffix (const void *pointer, void *data,
         + gui_chat_strlen_screen (CONFIG_STRING(config_look_nick_suffix));
 
     config_compute_prefix_max_length_all_buffers ();
+    gui_line_layout_changed ();
     gui_window_ask_refresh (1);
 }
 
@@ -779,6 +783,7 @@ config_change_prefix_same_nick (const void *pointer, void *data,
         gui_chat_strlen_screen (CONFIG_STRING(config_look_prefix_same_nick));
 
     config_compute_prefix_max_length_all_buffers ();
+    gui_line_layout_changed ();
     gui_window_ask_refresh (1);
 }
 
@@ -840,6 +845,22 @@ config_change_emphasized_attributes (const void *pointer, void *data,
     gui_window_ask_refresh (1);
 }
 
+/*
+ * Callback for changes on option "weechat.look.highlight".
+ */
+
+void
+config_change_highlight (const void *pointer, void *data,
+                         struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    gui_buffer_highlight_words_compiled_free_all ();
+}
+
 /*
  * Callback for changes on option "weechat.look.highlight_regex".
  */
@@ -1066,6 +1087,7 @@ config_change_prefix_align_min (const void *pointer, void *data,
     (void) option;
 
     config_compute_prefix_max_length_all_buffers ();
+    gui_line_layout_changed ();
     gui_window_ask_refresh (1);
 }
 
@@ -1136,6 +1158,7 @@ config_change_tab_width (const void *pointer, void *data,
     memset (config_tab_spaces, ' ', CONFIG_INTEGER(config_look_tab_width));
     config_tab_spaces[CONFIG_INTEGER(config_look_tab_width)] = '\0';
 
+    gui_line_layout_changed ();
     gui_window_ask_refresh (1);
 }
 
@@ -2618,6 +2641,15 @@ config_weechat_init_options ()
            "values from last search in buffer)"),
         NULL, 0, 0, "off", NULL, 0,
         NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    config_look_buffer_search_index = config_file_new_option (
+        weechat_config_file, ptr_section,
+        "buffer_search_index", "boolean",
+        N_("index trigrams of text (without colors) in lines added to buffers, "
+           "to quickly skip lines which can not match the text searched "
+           "(this uses 16 bytes per line); this is not used for the search "
+           "of regular expressions"),
+        NULL, 0, 0, "on", NULL, 0,
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
     config_look_buffer_search_regex = config_file_new_option (
         weechat_config_file, ptr_section,
         "buffer_search_regex", "boolean",
@@ -2834,7 +2866,9 @@ config_weechat_init_options ()
            "sensitive), words may begin or end with \"*\" for partial match; "
            "example: \"test,(?-i)*toto*,flash*\""),
         NULL, 0, 0, "", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &config_change_highlight, NULL, NULL,
+        NULL, NULL, NULL);
     config_look_highlight_regex = config_file_new_option (
         weechat_config_file, ptr_section,
         "highlight_regex", "string",
@@ -49,6 +49,7 @@
 #include "wee-log.h"
 #include "wee-proxy.h"
 #include "wee-string.h"
+#include "wee-upgrade.h"
 #include "wee-util.h"
 #include "../gui/gui-bar.h"
 #include "../gui/gui-bar-item.h"
@@ -586,6 +587,65 @@ debug_directories ()
     gui_chat_printf (NULL, "  locale: %s", LOCALEDIR);
 }
 
+/*
+ * Displays statistics on last upgrade (time to save and load core data).
+ */
+
+void
+debug_upgrade ()
+{
+    gui_chat_printf (NULL, "");
+    if (weechat_upgrade_count == 0)
+    {
+        gui_chat_printf (NULL, _("No upgrade done"));
+        return;
+    }
+
+    gui_chat_printf (NULL, _("Last upgrade (core data):"));
+    if (upgrade_weechat_time_save >= 0)
+    {
+        gui_chat_printf (NULL, "  save: %.3f ms",
+                         ((float)upgrade_weechat_time_save) / 1000);
+    }
+    else
+    {
+        gui_chat_printf (NULL, "  save: -");
+    }
+    if (upgrade_weechat_time_load >= 0)
+    {
+        gui_chat_printf (NULL, "  load: %.3f ms",
+                         ((float)upgrade_weechat_time_load) / 1000);
+    }
+    else
+    {
+        gui_chat_printf (NULL, "  load: -");
+    }
+    gui_chat_printf (NULL, "  file: %ld bytes (%s)",
+                     upgrade_weechat_file_size,
+                     (upgrade_weechat_file_mmap) ? "mmap" : "read");
+    gui_chat_printf (NULL, "  objects: %d, records: %d",
+                     upgrade_weechat_count_objects,
+                     upgrade_weechat_count_records);
+}
+
+/*
+ * Displays counters of bar items updates and bar conditions evaluated.
+ */
+
+void
+debug_bars ()
+{
+    gui_chat_printf (NULL, "");
+    gui_chat_printf (NULL, _("Bar items updates:"));
+    gui_chat_printf (NULL, "  requested: %lld, done: %lld",
+                     gui_bar_item_count_updates_requested,
+                     gui_bar_item_count_updates_done);
+    gui_chat_printf (NULL, _("Bar conditions:"));
+    gui_chat_printf (NULL, "  evaluated: %lld, skipped: %lld",
+                     gui_bar_item_count_conditions_evaluated,
+                     gui_bar_item_count_conditions_skipped);
+}
+
 /*
  * Display time elapsed between two times.
  *
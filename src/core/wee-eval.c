@@ -49,11 +49,28 @@ char *logical_ops[EVAL_NUM_LOGICAL_OPS] =
 char *comparisons[EVAL_NUM_COMPARISONS] =
 { "=~", "!~", "=*", "!*", "==", "!=", "<=", "<", ">=", ">" };
 
+struct t_hashtable *eval_cache = NULL;  /* compiled expressions (by expr)   */
+struct t_eval_compiled *eval_cache_first = NULL; /* recently used expr.     */
+struct t_eval_compiled *eval_cache_last = NULL;  /* least recently used     */
+int eval_cache_count = 0;               /* number of expressions in cache   */
+
 
 char *eval_replace_vars (const char *expr,
                          struct t_eval_context *eval_context);
 char *eval_expression_condition (const char *expr,
                                  struct t_eval_context *eval_context);
+void eval_node_free (struct t_eval_node *node);
+struct t_eval_template *eval_compile_template (const char *string,
+                                               const char *prefix,
+                                               const char *suffix,
+                                               int count_recursion);
+struct t_eval_node *eval_compile_condition (const char *expr,
+                                            const char *prefix,
+                                            const char *suffix);
+char *eval_template_part_exec (struct t_eval_template_part *part,
+                               struct t_eval_context *eval_context);
+char *eval_node_exec (struct t_eval_node *node,
+                      struct t_eval_context *eval_context);
 
 
 /*
@@ -284,6 +301,104 @@ end:
     return value;
 }
 
+/*
+ * Gets value of an option (format: file.section.option) or a secured data
+ * (format: sec.data.xxx).
+ *
+ * Returns NULL if the option is not found.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+eval_option_value (const char *text)
+{
+    struct t_config_option *ptr_option;
+    char str_value[64];
+    const char *ptr_value;
+
+    if (strncmp (text, "sec.data.", 9) == 0)
+    {
+        ptr_value = hashtable_get (secure_hashtable_data, text + 9);
+        return strdup ((ptr_value) ? ptr_value : "");
+    }
+
+    config_file_search_with_string (text, NULL, NULL, &ptr_option, NULL);
+    if (!ptr_option)
+        return NULL;
+
+    if (!ptr_option->value)
+        return strdup ("");
+    switch (ptr_option->type)
+    {
+        case CONFIG_OPTION_TYPE_BOOLEAN:
+            return strdup (CONFIG_BOOLEAN(ptr_option) ? EVAL_STR_TRUE : EVAL_STR_FALSE);
+        case CONFIG_OPTION_TYPE_INTEGER:
+            if (ptr_option->string_values)
+                return strdup (ptr_option->string_values[CONFIG_INTEGER(ptr_option)]);
+            snprintf (str_value, sizeof (str_value),
+                      "%d", CONFIG_INTEGER(ptr_option));
+            return strdup (str_value);
+        case CONFIG_OPTION_TYPE_STRING:
+            return strdup (CONFIG_STRING(ptr_option));
+        case CONFIG_OPTION_TYPE_COLOR:
+            return strdup (gui_color_get_name (CONFIG_COLOR(ptr_option)));
+        case CONFIG_NUM_OPTION_TYPES:
+            return strdup ("");
+    }
+
+    return NULL;
+}
+
+/*
+ * Gets value of a hdata variable, using the hdata name, an optional list name
+ * (or pointer, format: 0x123abc) and a path to a variable.
+ *
+ * Returns NULL if the hdata or pointer is not found.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+eval_hdata_value (const char *hdata_name, const char *list_name,
+                  const char *path, struct t_eval_context *eval_context)
+{
+    struct t_hdata *hdata;
+    void *pointer;
+    long unsigned int ptr;
+    int rc;
+
+    hdata = hook_hdata_get (NULL, hdata_name);
+    if (!hdata)
+        return NULL;
+
+    pointer = NULL;
+
+    if (list_name)
+    {
+        if (strncmp (list_name, "0x", 2) == 0)
+        {
+            rc = sscanf (list_name, "%lx", &ptr);
+            if ((rc == EOF) || (rc == 0))
+                return NULL;
+            pointer = (void *)ptr;
+            if (!hdata_check_pointer (hdata, NULL, pointer))
+                return NULL;
+        }
+        else
+            pointer = hdata_get_list (hdata, list_name);
+    }
+
+    if (!pointer)
+    {
+        pointer = hashtable_get (eval_context->pointers, hdata_name);
+        if (!pointer)
+            return NULL;
+    }
+
+    return eval_hdata_get_value (hdata, pointer, path);
+}
+
 /*
  * Replaces variables, which can be, by order of priority:
  *   1. an extra variable from hashtable "extra_vars"
@@ -313,17 +428,13 @@ char *
 eval_replace_vars_cb (void *data, const char *text)
 {
     struct t_eval_context *eval_context;
-    struct t_config_option *ptr_option;
     struct t_gui_buffer *ptr_buffer;
     char str_value[512], *value, *pos, *pos1, *pos2, *hdata_name, *list_name;
     char *tmp, *info_name, *hide_char, *hidden_string, *error, *condition;
     const char *ptr_value, *ptr_arguments, *ptr_string;
-    struct t_hdata *hdata;
-    void *pointer;
     int i, length_hide_char, length, index, rc, screen;
     int count_suffix;
     long number;
-    long unsigned int ptr;
     time_t date;
     struct tm *date_tmp;
 
@@ -595,37 +706,9 @@ eval_replace_vars_cb (void *data, const char *text)
     }
 
     /* 12. option: if found, return this value */
-    if (strncmp (text, "sec.data.", 9) == 0)
-    {
-        ptr_value = hashtable_get (secure_hashtable_data, text + 9);
-        return strdup ((ptr_value) ? ptr_value : "");
-    }
-    else
-    {
-        config_file_search_with_string (text, NULL, NULL, &ptr_option, NULL);
-        if (ptr_option)
-        {
-            if (!ptr_option->value)
-                return strdup ("");
-            switch (ptr_option->type)
-            {
-                case CONFIG_OPTION_TYPE_BOOLEAN:
-                    return strdup (CONFIG_BOOLEAN(ptr_option) ? EVAL_STR_TRUE : EVAL_STR_FALSE);
-                case CONFIG_OPTION_TYPE_INTEGER:
-                    if (ptr_option->string_values)
-                        return strdup (ptr_option->string_values[CONFIG_INTEGER(ptr_option)]);
-                    snprintf (str_value, sizeof (str_value),
-                              "%d", CONFIG_INTEGER(ptr_option));
-                    return strdup (str_value);
-                case CONFIG_OPTION_TYPE_STRING:
-                    return strdup (CONFIG_STRING(ptr_option));
-                case CONFIG_OPTION_TYPE_COLOR:
-                    return strdup (gui_color_get_name (CONFIG_COLOR(ptr_option)));
-                case CONFIG_NUM_OPTION_TYPES:
-                    return strdup ("");
-            }
-        }
-    }
+    value = eval_option_value (text);
+    if (value)
+        return value;
 
     /* 13. local variable in buffer */
     ptr_buffer = hashtable_get (eval_context->pointers, "buffer");
@@ -640,7 +723,6 @@ eval_replace_vars_cb (void *data, const char *text)
     value = NULL;
     hdata_name = NULL;
     list_name = NULL;
-    pointer = NULL;
 
     pos = strchr (text, '.');
     if (pos > text)
@@ -667,36 +749,8 @@ eval_replace_vars_cb (void *data, const char *text)
         }
     }
 
-    hdata = hook_hdata_get (NULL, hdata_name);
-    if (!hdata)
-        goto end;
-
-    if (list_name)
-    {
-        if (strncmp (list_name, "0x", 2) == 0)
-        {
-            rc = sscanf (list_name, "%lx", &ptr);
-            if ((rc != EOF) && (rc != 0))
-            {
-                pointer = (void *)ptr;
-                if (!hdata_check_pointer (hdata, NULL, pointer))
-                    goto end;
-            }
-            else
-                goto end;
-        }
-        else
-            pointer = hdata_get_list (hdata, list_name);
-    }
-
-    if (!pointer)
-    {
-        pointer = hashtable_get (eval_context->pointers, hdata_name);
-        if (!pointer)
-            goto end;
-    }
-
-    value = eval_hdata_get_value (hdata, pointer, (pos) ? pos + 1 : NULL);
+    value = eval_hdata_value (hdata_name, list_name,
+                              (pos) ? pos + 1 : NULL, eval_context);
 
 end:
     if (hdata_name)
@@ -1064,144 +1118,1020 @@ end:
 }
 
 /*
- * Replaces text in a string using a regular expression and replacement text.
- *
- * The argument "regex" is a pointer to a regex compiled with WeeChat function
- * string_regcomp (or function regcomp).
- *
- * The argument "replace" is evaluated and can contain any valid expression,
- * and these ones:
- *   ${re:0} .. ${re:99}  match 0 to 99 (0 is whole match, 1 .. 99 are groups
- *                        captured)
- *   ${re:+}              the last match (with highest number)
- *
- * Examples:
- *
- *    string   | regex         | replace                    | result
- *   ----------+---------------+----------------------------+-------------
- *    test foo | test          | Z                          | Z foo
- *    test foo | ^(test +)(.*) | ${re:2}                    | foo
- *    test foo | ^(test +)(.*) | ${re:1}/ ${hide:*,${re:2}} | test / ***
- *    test foo | ^(test +)(.*) | ${hide:%,${re:+}}          | %%%
- *
- * Note: result must be freed after use.
+ * Frees a compiled template.
  */
 
-char *
-eval_replace_regex (const char *string, regex_t *regex, const char *replace,
-                    struct t_eval_context *eval_context)
+void
+eval_template_free (struct t_eval_template *eval_template)
 {
-    char *result, *result2, *str_replace;
-    int length, length_replace, start_offset, i, rc, end;
-    struct t_eval_regex eval_regex;
+    int i;
 
-    if (!string || !regex || !replace)
-        return NULL;
+    if (!eval_template)
+        return;
 
-    length = strlen (string) + 1;
-    result = malloc (length);
-    if (!result)
-        return NULL;
-    snprintf (result, length, "%s", string);
+    for (i = 0; i < eval_template->parts_count; i++)
+    {
+        if (eval_template->parts[i].text)
+            free (eval_template->parts[i].text);
+        eval_template_free (eval_template->parts[i].name);
+        if (eval_template->parts[i].value)
+            free (eval_template->parts[i].value);
+        eval_template_free (eval_template->parts[i].value_true);
+        eval_template_free (eval_template->parts[i].value_false);
+        eval_node_free (eval_template->parts[i].condition);
+        if (eval_template->parts[i].hdata_name)
+            free (eval_template->parts[i].hdata_name);
+        if (eval_template->parts[i].list_name)
+            free (eval_template->parts[i].list_name);
+        if (eval_template->parts[i].path)
+            free (eval_template->parts[i].path);
+    }
+    if (eval_template->parts)
+        free (eval_template->parts);
 
-    eval_context->regex = &eval_regex;
+    free (eval_template);
+}
 
-    start_offset = 0;
-    while (result && result[start_offset])
+/*
+ * Frees a compiled condition.
+ */
+
+void
+eval_node_free (struct t_eval_node *node)
+{
+    if (!node)
+        return;
+
+    if (node->text)
+        free (node->text);
+    eval_template_free (node->expr_template);
+    eval_node_free (node->left);
+    eval_node_free (node->right);
+    if (node->regex)
     {
-        for (i = 0; i < 100; i++)
-        {
-            eval_regex.match[i].rm_so = -1;
-        }
+        regfree (node->regex);
+        free (node->regex);
+    }
 
-        rc = regexec (regex, result + start_offset, 100, eval_regex.match, 0);
-        /*
-         * no match found: exit the loop (if rm_eo == 0, it is an empty match
-         * at beginning of string: we consider there is no match, to prevent an
-         * infinite loop)
-         */
-        if ((rc != 0)
-            || (eval_regex.match[0].rm_so < 0)
-            || (eval_regex.match[0].rm_eo <= 0))
-        {
-            break;
-        }
+    free (node);
+}
 
-        /* adjust the start/end offsets */
-        eval_regex.last_match = 0;
-        for (i = 0; i < 100; i++)
-        {
-            if (eval_regex.match[i].rm_so >= 0)
-            {
-                eval_regex.last_match = i;
-                eval_regex.match[i].rm_so += start_offset;
-                eval_regex.match[i].rm_eo += start_offset;
-            }
-        }
+/*
+ * Adds a part in a compiled template.
+ *
+ * Returns pointer to new part, NULL if error.
+ */
 
-        /* check if the regex matched the end of string */
-        end = !result[eval_regex.match[0].rm_eo];
+struct t_eval_template_part *
+eval_template_add_part (struct t_eval_template *eval_template)
+{
+    struct t_eval_template_part *new_parts;
 
-        eval_regex.result = result;
+    new_parts = realloc (eval_template->parts,
+                         (eval_template->parts_count + 1) *
+                         sizeof (eval_template->parts[0]));
+    if (!new_parts)
+        return NULL;
+    eval_template->parts = new_parts;
+    memset (&eval_template->parts[eval_template->parts_count], 0,
+            sizeof (eval_template->parts[0]));
+    eval_template->parts_count++;
 
-        str_replace = eval_replace_vars (replace, eval_context);
+    return &eval_template->parts[eval_template->parts_count - 1];
+}
 
-        length_replace = (str_replace) ? strlen (str_replace) : 0;
+/*
+ * Adds literal text in a compiled template (text is merged with previous
+ * part if it is a literal text).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
 
-        length = eval_regex.match[0].rm_so + length_replace +
-            strlen (result + eval_regex.match[0].rm_eo) + 1;
-        result2 = malloc (length);
-        if (!result2)
-        {
-            free (result);
-            return NULL;
-        }
-        result2[0] = '\0';
-        if (eval_regex.match[0].rm_so > 0)
-        {
-            memcpy (result2, result, eval_regex.match[0].rm_so);
-            result2[eval_regex.match[0].rm_so] = '\0';
-        }
-        if (str_replace)
-            strcat (result2, str_replace);
-        strcat (result2, result + eval_regex.match[0].rm_eo);
+int
+eval_template_add_text (struct t_eval_template *eval_template,
+                        const char *text, int length)
+{
+    struct t_eval_template_part *ptr_part;
+    char *new_text;
+    int old_length;
 
-        free (result);
-        result = result2;
+    if (length <= 0)
+        return 1;
 
-        if (str_replace)
-            free (str_replace);
+    if ((eval_template->parts_count > 0)
+        && !eval_template->parts[eval_template->parts_count - 1].is_var)
+    {
+        ptr_part = &eval_template->parts[eval_template->parts_count - 1];
+        old_length = strlen (ptr_part->text);
+        new_text = realloc (ptr_part->text, old_length + length + 1);
+        if (!new_text)
+            return 0;
+        memcpy (new_text + old_length, text, length);
+        new_text[old_length + length] = '\0';
+        ptr_part->text = new_text;
+        return 1;
+    }
 
-        if (end)
-            break;
+    ptr_part = eval_template_add_part (eval_template);
+    if (!ptr_part)
+        return 0;
+    ptr_part->text = string_strndup (text, length);
 
-        start_offset = eval_regex.match[0].rm_so + length_replace;
+    return (ptr_part->text) ? 1 : 0;
+}
+
+/*
+ * Creates a compiled template with a constant string (not counted for
+ * recursion).
+ *
+ * Returns pointer to compiled template, NULL if error.
+ */
+
+struct t_eval_template *
+eval_template_new_constant (const char *text)
+{
+    struct t_eval_template *new_template;
+
+    new_template = malloc (sizeof (*new_template));
+    if (!new_template)
+        return NULL;
+
+    new_template->count_recursion = 0;
+    new_template->parts_count = 0;
+    new_template->parts = NULL;
+
+    if (!eval_template_add_text (new_template, text, strlen (text)))
+    {
+        eval_template_free (new_template);
+        return NULL;
     }
 
-    return result;
+    return new_template;
 }
 
 /*
- * Evaluates an expression.
- *
- * The hashtable "pointers" must have string for keys, pointer for values.
- * The hashtable "extra_vars" must have string for keys and values.
- * The hashtable "options" must have string for keys and values.
- *
- * Supported options:
- *   - prefix: change the default prefix before variables to replace ("${")
- *   - suffix: change the default suffix after variables to replace ('}")
- *   - type:
- *       - condition: evaluate as a condition (use operators/parentheses,
- *         return a boolean)
- *
- * If the expression is a condition, it can contain:
- *   - conditions:  ==  != <  <=  >  >=
- *   - logical operators:  &&  ||
- *   - parentheses for priority
+ * Compiles a variable (content of "${...}"), following the order of
+ * priority of function eval_replace_vars_cb: the type of variable is
+ * determined once, and constant values (like "esc:" or "hide:") are
+ * computed now.
  *
- * Examples of simple expression without condition (the [ ] are NOT part of
- * result):
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+eval_compile_var (struct t_eval_template_part *part, const char *text,
+                  const char *prefix, const char *suffix)
+{
+    struct t_eval_context eval_context;
+    const char *pos, *pos2;
+    char *tmp, *pos_list, *pos_list_end;
+
+    part->text = strdup (text);
+    if (!part->text)
+        return 0;
+
+    /* string to evaluate */
+    if (strncmp (text, "eval:", 5) == 0)
+    {
+        part->var_type = EVAL_VAR_EVAL;
+        part->value_true = eval_compile_template (text + 5, prefix, suffix, 1);
+        return (part->value_true) ? 1 : 0;
+    }
+
+    /* escaped chars, hidden chars, cut of string: value is constant */
+    if ((strncmp (text, "esc:", 4) == 0)
+        || ((text[0] == '\\') && text[1] && (text[1] != '\\'))
+        || (strncmp (text, "hide:", 5) == 0)
+        || (strncmp (text, "cut:", 4) == 0)
+        || (strncmp (text, "cutscr:", 7) == 0))
+    {
+        memset (&eval_context, 0, sizeof (eval_context));
+        part->var_type = EVAL_VAR_CONSTANT;
+        part->value = eval_replace_vars_cb (&eval_context, text);
+        return (part->value) ? 1 : 0;
+    }
+
+    /* regex group, color, info, date, environment variable */
+    if ((strncmp (text, "re:", 3) == 0)
+        || (strncmp (text, "color:", 6) == 0)
+        || (strncmp (text, "info:", 5) == 0)
+        || ((strncmp (text, "date", 4) == 0) && (!text[4] || (text[4] == ':')))
+        || (strncmp (text, "env:", 4) == 0))
+    {
+        part->var_type = EVAL_VAR_DYNAMIC;
+        return 1;
+    }
+
+    /* ternary operator: if:condition?value_if_true:value_if_false */
+    if (strncmp (text, "if:", 3) == 0)
+    {
+        part->var_type = EVAL_VAR_IF;
+        pos = eval_strstr_level (text + 3, "?", prefix, suffix, 1);
+        pos2 = (pos) ?
+            eval_strstr_level (pos + 1, ":", prefix, suffix, 1) : NULL;
+        tmp = (pos) ?
+            string_strndup (text + 3, pos - (text + 3)) : strdup (text + 3);
+        if (!tmp)
+            return 0;
+        part->condition = eval_compile_condition (tmp, prefix, suffix);
+        free (tmp);
+        if (!part->condition)
+            return 0;
+        if (pos)
+        {
+            tmp = (pos2) ?
+                string_strndup (pos + 1, pos2 - pos - 1) : strdup (pos + 1);
+            if (!tmp)
+                return 0;
+            part->value_true = eval_compile_template (tmp, prefix, suffix, 1);
+            free (tmp);
+        }
+        else
+        {
+            part->value_true = eval_template_new_constant (EVAL_STR_TRUE);
+        }
+        part->value_false = (pos2) ?
+            eval_compile_template (pos2 + 1, prefix, suffix, 1) :
+            eval_template_new_constant ((pos) ? "" : EVAL_STR_FALSE);
+        return (part->value_true && part->value_false) ? 1 : 0;
+    }
+
+    /*
+     * option, local variable or hdata: an option has format
+     * "file.section.option", and the hdata name, list and path are
+     * extracted now
+     */
+    part->var_type = EVAL_VAR_NAME;
+    pos = strchr (text, '.');
+    part->may_be_option = (pos && strchr (pos + 1, '.')) ? 1 : 0;
+    part->hdata_name = (pos > text) ?
+        string_strndup (text, pos - text) : strdup (text);
+    if (!part->hdata_name)
+        return 0;
+    pos_list = strchr (part->hdata_name, '[');
+    if (pos_list > part->hdata_name)
+    {
+        pos_list_end = strchr (pos_list + 1, ']');
+        if (pos_list_end > pos_list + 1)
+        {
+            part->list_name = string_strndup (pos_list + 1,
+                                              pos_list_end - pos_list - 1);
+        }
+        tmp = string_strndup (part->hdata_name,
+                              pos_list - part->hdata_name);
+        if (tmp)
+        {
+            free (part->hdata_name);
+            part->hdata_name = tmp;
+        }
+    }
+    if (pos)
+    {
+        part->path = strdup (pos + 1);
+        if (!part->path)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Compiles a string with variables: the string is split into literal text
+ * and variables (same parsing as function string_replace_with_callback,
+ * called by eval_replace_vars).
+ *
+ * If count_recursion is 1, the template is evaluated like a call to
+ * eval_replace_vars (limited by EVAL_RECURSION_MAX).
+ *
+ * Returns pointer to compiled template, NULL if error.
+ */
+
+struct t_eval_template *
+eval_compile_template (const char *string, const char *prefix,
+                       const char *suffix, int count_recursion)
+{
+    struct t_eval_template *new_template;
+    struct t_eval_template_part *ptr_part;
+    const char *ptr_string, *pos_end_name;
+    char *key;
+    int length_prefix, length_suffix, sub_count, sub_level, rc;
+
+    if (!string || !prefix || !prefix[0] || !suffix || !suffix[0])
+        return NULL;
+
+    new_template = malloc (sizeof (*new_template));
+    if (!new_template)
+        return NULL;
+    new_template->count_recursion = count_recursion;
+    new_template->parts_count = 0;
+    new_template->parts = NULL;
+
+    length_prefix = strlen (prefix);
+    length_suffix = strlen (suffix);
+
+    ptr_string = string;
+    while (ptr_string[0])
+    {
+        if ((ptr_string[0] == '\\') && (ptr_string[1] == prefix[0]))
+        {
+            if (!eval_template_add_text (new_template, ptr_string + 1, 1))
+                goto error;
+            ptr_string += 2;
+        }
+        else if (strncmp (ptr_string, prefix, length_prefix) == 0)
+        {
+            sub_count = 0;
+            sub_level = 0;
+            pos_end_name = ptr_string + length_prefix;
+            while (pos_end_name[0])
+            {
+                if (strncmp (pos_end_name, suffix, length_suffix) == 0)
+                {
+                    if (sub_level == 0)
+                        break;
+                    sub_level--;
+                }
+                if ((pos_end_name[0] == '\\')
+                    && (pos_end_name[1] == prefix[0]))
+                {
+                    pos_end_name++;
+                }
+                else if (strncmp (pos_end_name, prefix, length_prefix) == 0)
+                {
+                    sub_count++;
+                    sub_level++;
+                }
+                pos_end_name++;
+            }
+            /* prefix without matching suffix: end of string is ignored */
+            if (!pos_end_name[0])
+                break;
+            key = string_strndup (ptr_string + length_prefix,
+                                  pos_end_name - (ptr_string + length_prefix));
+            if (!key)
+                goto error;
+            ptr_part = eval_template_add_part (new_template);
+            if (!ptr_part)
+            {
+                free (key);
+                goto error;
+            }
+            ptr_part->is_var = 1;
+            if ((sub_count > 0) && (strncmp (key, "if:", 3) != 0))
+            {
+                /* name with variables: evaluated on each execution */
+                ptr_part->var_type = EVAL_VAR_DYNAMIC;
+                ptr_part->text = key;
+                ptr_part->name = eval_compile_template (key, prefix, suffix,
+                                                        0);
+                rc = (ptr_part->name) ? 1 : 0;
+            }
+            else
+            {
+                rc = eval_compile_var (ptr_part, key, prefix, suffix);
+                free (key);
+            }
+            if (!rc)
+                goto error;
+            ptr_string = pos_end_name + length_suffix;
+        }
+        else
+        {
+            if (!eval_template_add_text (new_template, ptr_string, 1))
+                goto error;
+            ptr_string++;
+        }
+    }
+
+    return new_template;
+
+error:
+    eval_template_free (new_template);
+    return NULL;
+}
+
+/*
+ * Creates a new node for a compiled condition.
+ *
+ * Returns pointer to new node, NULL if error.
+ */
+
+struct t_eval_node *
+eval_node_new (enum t_eval_node_type type, const char *text)
+{
+    struct t_eval_node *new_node;
+
+    new_node = malloc (sizeof (*new_node));
+    if (!new_node)
+        return NULL;
+
+    new_node->type = type;
+    new_node->op = 0;
+    new_node->text = NULL;
+    new_node->expr_template = NULL;
+    new_node->left = NULL;
+    new_node->right = NULL;
+    new_node->regex = NULL;
+    new_node->regex_rc = 0;
+
+    if (text)
+    {
+        new_node->text = strdup (text);
+        if (!new_node->text)
+        {
+            free (new_node);
+            return NULL;
+        }
+    }
+
+    return new_node;
+}
+
+/*
+ * Creates a new node with a string with variables.
+ *
+ * Returns pointer to new node, NULL if error.
+ */
+
+struct t_eval_node *
+eval_node_new_template (const char *string, const char *prefix,
+                        const char *suffix)
+{
+    struct t_eval_node *new_node;
+
+    new_node = eval_node_new (EVAL_NODE_TEMPLATE, NULL);
+    if (!new_node)
+        return NULL;
+
+    new_node->expr_template = eval_compile_template (string, prefix, suffix,
+                                                     1);
+    if (!new_node->expr_template)
+    {
+        eval_node_free (new_node);
+        return NULL;
+    }
+
+    return new_node;
+}
+
+/*
+ * Compiles a condition: logical operators, comparisons and parentheses are
+ * searched once (same parsing as function eval_expression_condition).
+ *
+ * Returns pointer to compiled condition, NULL if error.
+ */
+
+struct t_eval_node *
+eval_compile_condition (const char *expr, const char *prefix,
+                        const char *suffix)
+{
+    struct t_eval_node *node;
+    struct t_eval_template *ptr_template;
+    int logic, comp, level;
+    const char *pos, *pos_end;
+    char *expr2, *sub_expr;
+
+    if (!expr)
+        return NULL;
+
+    /* skip spaces at beginning of string */
+    while (expr[0] == ' ')
+    {
+        expr++;
+    }
+    if (!expr[0])
+        return eval_node_new (EVAL_NODE_CONSTANT, "");
+
+    /* skip spaces at end of string */
+    pos_end = expr + strlen (expr) - 1;
+    while ((pos_end > expr) && (pos_end[0] == ' '))
+    {
+        pos_end--;
+    }
+
+    expr2 = string_strndup (expr, pos_end + 1 - expr);
+    if (!expr2)
+        return NULL;
+
+    node = NULL;
+
+    /* logical operator */
+    for (logic = 0; logic < EVAL_NUM_LOGICAL_OPS; logic++)
+    {
+        pos = eval_strstr_level (expr2, logical_ops[logic], "(", ")", 0);
+        if (pos > expr2)
+        {
+            pos_end = pos - 1;
+            while ((pos_end > expr2) && (pos_end[0] == ' '))
+            {
+                pos_end--;
+            }
+            sub_expr = string_strndup (expr2, pos_end + 1 - expr2);
+            if (!sub_expr)
+                goto end;
+            node = eval_node_new (EVAL_NODE_LOGICAL, NULL);
+            if (node)
+            {
+                node->op = logic;
+                node->left = eval_compile_condition (sub_expr, prefix, suffix);
+                pos += strlen (logical_ops[logic]);
+                while (pos[0] == ' ')
+                {
+                    pos++;
+                }
+                node->right = eval_compile_condition (pos, prefix, suffix);
+                if (!node->left || !node->right)
+                {
+                    eval_node_free (node);
+                    node = NULL;
+                }
+            }
+            free (sub_expr);
+            goto end;
+        }
+    }
+
+    /* comparison */
+    for (comp = 0; comp < EVAL_NUM_COMPARISONS; comp++)
+    {
+        pos = eval_strstr_level (expr2, comparisons[comp], "(", ")", 0);
+        if (pos > expr2)
+        {
+            pos_end = pos - 1;
+            while ((pos_end > expr2) && (pos_end[0] == ' '))
+            {
+                pos_end--;
+            }
+            sub_expr = string_strndup (expr2, pos_end + 1 - expr2);
+            if (!sub_expr)
+                goto end;
+            pos += strlen (comparisons[comp]);
+            while (pos[0] == ' ')
+            {
+                pos++;
+            }
+            node = eval_node_new (EVAL_NODE_COMPARE, NULL);
+            if (node)
+            {
+                node->op = comp;
+                if ((comp == EVAL_COMPARE_REGEX_MATCHING)
+                    || (comp == EVAL_COMPARE_REGEX_NOT_MATCHING))
+                {
+                    /* for regex: just replace vars in both expressions */
+                    node->left = eval_node_new_template (sub_expr,
+                                                         prefix, suffix);
+                    node->right = eval_node_new_template (pos,
+                                                          prefix, suffix);
+                    /* constant regex: compile it now */
+                    ptr_template = (node->right) ?
+                        node->right->expr_template : NULL;
+                    if (ptr_template
+                        && ((ptr_template->parts_count == 0)
+                            || ((ptr_template->parts_count == 1)
+                                && !ptr_template->parts[0].is_var)))
+                    {
+                        node->regex = malloc (sizeof (*node->regex));
+                        if (node->regex)
+                        {
+                            node->regex_rc = string_regcomp (
+                                node->regex,
+                                (ptr_template->parts_count == 0) ?
+                                "" : ptr_template->parts[0].text,
+                                REG_EXTENDED | REG_ICASE | REG_NOSUB);
+                            if (node->regex_rc != 0)
+                            {
+                                free (node->regex);
+                                node->regex = NULL;
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    /* other comparison: fully evaluate both expressions */
+                    node->left = eval_compile_condition (sub_expr,
+                                                         prefix, suffix);
+                    node->right = eval_compile_condition (pos,
+                                                          prefix, suffix);
+                }
+                if (!node->left || !node->right)
+                {
+                    eval_node_free (node);
+                    node = NULL;
+                }
+            }
+            free (sub_expr);
+            goto end;
+        }
+    }
+
+    /* sub-expression between parentheses */
+    if (expr2[0] == '(')
+    {
+        level = 0;
+        pos = expr2 + 1;
+        while (pos[0])
+        {
+            if (pos[0] == '(')
+                level++;
+            else if (pos[0] == ')')
+            {
+                if (level == 0)
+                    break;
+                level--;
+            }
+            pos++;
+        }
+        if ((pos[0] == ')') && !pos[1])
+        {
+            /* nothing around parentheses: compile the sub-expression */
+            sub_expr = string_strndup (expr2 + 1, pos - expr2 - 1);
+            if (sub_expr)
+            {
+                node = eval_compile_condition (sub_expr, prefix, suffix);
+                free (sub_expr);
+            }
+        }
+        else
+        {
+            /*
+             * value of sub-expression is concatenated with the string after
+             * parentheses (or closing parenthesis is missing): the result
+             * depends on the value, so the expression is interpreted
+             */
+            node = eval_node_new (EVAL_NODE_INTERPRETED, expr2);
+        }
+        goto end;
+    }
+
+    /* no operator: just replace variables in string */
+    node = eval_node_new_template (expr2, prefix, suffix);
+
+end:
+    free (expr2);
+
+    return node;
+}
+
+/*
+ * Executes a compiled template.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+eval_template_exec (struct t_eval_template *eval_template,
+                    struct t_eval_context *eval_context)
+{
+    char **result, *value;
+    int i;
+
+    if (eval_template->count_recursion)
+    {
+        eval_context->recursion_count++;
+        if (eval_context->recursion_count >= EVAL_RECURSION_MAX)
+        {
+            eval_context->recursion_count--;
+            return strdup ("");
+        }
+    }
+
+    if (eval_template->parts_count == 0)
+    {
+        value = strdup ("");
+    }
+    else if (eval_template->parts_count == 1)
+    {
+        value = (eval_template->parts[0].is_var) ?
+            eval_template_part_exec (&eval_template->parts[0],
+                                     eval_context) :
+            strdup (eval_template->parts[0].text);
+    }
+    else
+    {
+        result = string_dyn_alloc (256);
+        if (result)
+        {
+            for (i = 0; i < eval_template->parts_count; i++)
+            {
+                if (eval_template->parts[i].is_var)
+                {
+                    value = eval_template_part_exec (&eval_template->parts[i],
+                                                     eval_context);
+                    if (value)
+                    {
+                        string_dyn_concat (result, value);
+                        free (value);
+                    }
+                }
+                else
+                {
+                    string_dyn_concat (result, eval_template->parts[i].text);
+                }
+            }
+            value = string_dyn_free (result, 0);
+        }
+        else
+        {
+            value = NULL;
+        }
+    }
+
+    if (eval_template->count_recursion)
+        eval_context->recursion_count--;
+
+    return value;
+}
+
+/*
+ * Executes a compiled variable.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+eval_template_part_exec (struct t_eval_template_part *part,
+                         struct t_eval_context *eval_context)
+{
+    struct t_gui_buffer *ptr_buffer;
+    const char *ptr_value;
+    char *name, *value;
+    int rc;
+
+    if (part->var_type == EVAL_VAR_DYNAMIC)
+    {
+        if (!part->name)
+            return eval_replace_vars_cb (eval_context, part->text);
+        name = eval_template_exec (part->name, eval_context);
+        value = eval_replace_vars_cb (eval_context, (name) ? name : "");
+        if (name)
+            free (name);
+        return value;
+    }
+
+    /* variable in hashtable "extra_vars" has highest priority */
+    if (eval_context->extra_vars
+        && hashtable_get (eval_context->extra_vars, part->text))
+    {
+        return eval_replace_vars_cb (eval_context, part->text);
+    }
+
+    switch (part->var_type)
+    {
+        case EVAL_VAR_CONSTANT:
+            return strdup (part->value);
+        case EVAL_VAR_EVAL:
+            return eval_template_exec (part->value_true, eval_context);
+        case EVAL_VAR_IF:
+            value = eval_node_exec (part->condition, eval_context);
+            rc = eval_is_true (value);
+            if (value)
+                free (value);
+            value = eval_template_exec (
+                (rc) ? part->value_true : part->value_false,
+                eval_context);
+            return (value) ? value : strdup ("");
+        case EVAL_VAR_NAME:
+            if (part->may_be_option)
+            {
+                value = eval_option_value (part->text);
+                if (value)
+                    return value;
+            }
+            ptr_buffer = hashtable_get (eval_context->pointers, "buffer");
+            if (ptr_buffer)
+            {
+                ptr_value = hashtable_get (ptr_buffer->local_variables,
+                                           part->text);
+                if (ptr_value)
+                    return strdup (ptr_value);
+            }
+            value = eval_hdata_value (part->hdata_name, part->list_name,
+                                      part->path, eval_context);
+            return (value) ? value : strdup ("");
+        case EVAL_VAR_DYNAMIC:
+        case EVAL_NUM_VAR_TYPES:
+            break;
+    }
+
+    return strdup ("");
+}
+
+/*
+ * Executes a compiled condition.
+ *
+ * Note: result must be freed after use (if not NULL).
+ */
+
+char *
+eval_node_exec (struct t_eval_node *node, struct t_eval_context *eval_context)
+{
+    char *value, *value2, *result;
+    int rc;
+
+    switch (node->type)
+    {
+        case EVAL_NODE_CONSTANT:
+            return strdup (node->text);
+        case EVAL_NODE_TEMPLATE:
+            return eval_template_exec (node->expr_template, eval_context);
+        case EVAL_NODE_LOGICAL:
+            value = eval_node_exec (node->left, eval_context);
+            rc = eval_is_true (value);
+            if (value)
+                free (value);
+            if ((!rc && (node->op == EVAL_LOGICAL_OP_AND))
+                || (rc && (node->op == EVAL_LOGICAL_OP_OR)))
+            {
+                return strdup ((rc) ? EVAL_STR_TRUE : EVAL_STR_FALSE);
+            }
+            value = eval_node_exec (node->right, eval_context);
+            rc = eval_is_true (value);
+            if (value)
+                free (value);
+            return strdup ((rc) ? EVAL_STR_TRUE : EVAL_STR_FALSE);
+        case EVAL_NODE_COMPARE:
+            value = eval_node_exec (node->left, eval_context);
+            if ((node->regex || (node->regex_rc != 0))
+                && (eval_context->recursion_count + 1 < EVAL_RECURSION_MAX))
+            {
+                /* regex already compiled */
+                rc = 0;
+                if (value && node->regex)
+                {
+                    rc = (regexec (node->regex, value, 0, NULL, 0) == 0) ? 1 : 0;
+                    if (node->op == EVAL_COMPARE_REGEX_NOT_MATCHING)
+                        rc ^= 1;
+                }
+                if (value)
+                    free (value);
+                return strdup ((rc) ? EVAL_STR_TRUE : EVAL_STR_FALSE);
+            }
+            value2 = eval_node_exec (node->right, eval_context);
+            result = eval_compare (value, node->op, value2);
+            if (value)
+                free (value);
+            if (value2)
+                free (value2);
+            return result;
+        case EVAL_NODE_INTERPRETED:
+            return eval_expression_condition (node->text, eval_context);
+        case EVAL_NUM_NODE_TYPES:
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+ * Replaces text in a string using a regular expression and replacement text.
+ *
+ * The argument "regex" is a pointer to a regex compiled with WeeChat function
+ * string_regcomp (or function regcomp).
+ *
+ * The argument "replace" is evaluated and can contain any valid expression,
+ * and these ones:
+ *   ${re:0} .. ${re:99}  match 0 to 99 (0 is whole match, 1 .. 99 are groups
+ *                        captured)
+ *   ${re:+}              the last match (with highest number)
+ *
+ * Examples:
+ *
+ *    string   | regex         | replace                    | result
+ *   ----------+---------------+----------------------------+-------------
+ *    test foo | test          | Z                          | Z foo
+ *    test foo | ^(test +)(.*) | ${re:2}                    | foo
+ *    test foo | ^(test +)(.*) | ${re:1}/ ${hide:*,${re:2}} | test / ***
+ *    test foo | ^(test +)(.*) | ${hide:%,${re:+}}          | %%%
+ *
+ * If "replace_template" is not NULL, it is the compiled "replace" and it is
+ * used instead of "replace".
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+eval_replace_regex (const char *string, regex_t *regex, const char *replace,
+                    struct t_eval_template *replace_template,
+                    struct t_eval_context *eval_context)
+{
+    char *result, *result2, *str_replace;
+    int length, length_replace, start_offset, i, rc, end;
+    struct t_eval_regex eval_regex;
+
+    if (!string || !regex || !replace)
+        return NULL;
+
+    length = strlen (string) + 1;
+    result = malloc (length);
+    if (!result)
+        return NULL;
+    snprintf (result, length, "%s", string);
+
+    eval_context->regex = &eval_regex;
+
+    start_offset = 0;
+    while (result && result[start_offset])
+    {
+        for (i = 0; i < 100; i++)
+        {
+            eval_regex.match[i].rm_so = -1;
+        }
+
+        rc = regexec (regex, result + start_offset, 100, eval_regex.match, 0);
+        /*
+         * no match found: exit the loop (if rm_eo == 0, it is an empty match
+         * at beginning of string: we consider there is no match, to prevent an
+         * infinite loop)
+         */
+        if ((rc != 0)
+            || (eval_regex.match[0].rm_so < 0)
+            || (eval_regex.match[0].rm_eo <= 0))
+        {
+            break;
+        }
+
+        /* adjust the start/end offsets */
+        eval_regex.last_match = 0;
+        for (i = 0; i < 100; i++)
+        {
+            if (eval_regex.match[i].rm_so >= 0)
+            {
+                eval_regex.last_match = i;
+                eval_regex.match[i].rm_so += start_offset;
+                eval_regex.match[i].rm_eo += start_offset;
+            }
+        }
+
+        /* check if the regex matched the end of string */
+        end = !result[eval_regex.match[0].rm_eo];
+
+        eval_regex.result = result;
+
+        str_replace = (replace_template) ?
+            eval_template_exec (replace_template, eval_context) :
+            eval_replace_vars (replace, eval_context);
+
+        length_replace = (str_replace) ? strlen (str_replace) : 0;
+
+        length = eval_regex.match[0].rm_so + length_replace +
+            strlen (result + eval_regex.match[0].rm_eo) + 1;
+        result2 = malloc (length);
+        if (!result2)
+        {
+            free (result);
+            return NULL;
+        }
+        result2[0] = '\0';
+        if (eval_regex.match[0].rm_so > 0)
+        {
+            memcpy (result2, result, eval_regex.match[0].rm_so);
+            result2[eval_regex.match[0].rm_so] = '\0';
+        }
+        if (str_replace)
+            strcat (result2, str_replace);
+        strcat (result2, result + eval_regex.match[0].rm_eo);
+
+        free (result);
+        result = result2;
+
+        if (str_replace)
+            free (str_replace);
+
+        if (end)
+            break;
+
+        start_offset = eval_regex.match[0].rm_so + length_replace;
+    }
+
+    return result;
+}
+
+/*
+ * Evaluates an expression.
+ *
+ * The hashtable "pointers" must have string for keys, pointer for values.
+ * The hashtable "extra_vars" must have string for keys and values.
+ * The hashtable "options" must have string for keys and values.
+ *
+ * Supported options:
+ *   - prefix: change the default prefix before variables to replace ("${")
+ *   - suffix: change the default suffix after variables to replace ('}")
+ *   - type:
+ *       - condition: evaluate as a condition (use operators/parentheses,
+ *         return a boolean)
+ *
+ * If the expression is a condition, it can contain:
+ *   - conditions:  ==  != <  <=  >  >=
+ *   - logical operators:  &&  ||
+ *   - parentheses for priority
+ *
+ * Examples of simple expression without condition (the [ ] are NOT part of
+ * result):
  *   >> ${window.buffer.number}
  *   == [2]
  *   >> buffer:${window.buffer.full_name}
@@ -1219,12 +2149,16 @@ eval_replace_regex (const char *string, regex_t *regex, const char *replace,
  *   >> ${window.win_width} >= 30 && ${window.win_height} >= 20
  *   == [1]
  *
+ * The expression is interpreted (parsed during the evaluation); function
+ * eval_expression uses a compiled expression, with the same result.
+ *
  * Note: result must be freed after use (if not NULL).
  */
 
 char *
-eval_expression (const char *expr, struct t_hashtable *pointers,
-                 struct t_hashtable *extra_vars, struct t_hashtable *options)
+eval_expression_interpreted (const char *expr, struct t_hashtable *pointers,
+                             struct t_hashtable *extra_vars,
+                             struct t_hashtable *options)
 {
     struct t_eval_context eval_context;
     int condition, rc, pointers_allocated, regex_allocated;
@@ -1348,7 +2282,7 @@ eval_expression (const char *expr, struct t_hashtable *pointers,
         if (regex && regex_replace)
         {
             /* replace with regex */
-            value = eval_replace_regex (expr, regex, regex_replace,
+            value = eval_replace_regex (expr, regex, regex_replace, NULL,
                                         &eval_context);
         }
         else
@@ -1368,3 +2302,486 @@ eval_expression (const char *expr, struct t_hashtable *pointers,
 
     return value;
 }
+
+/*
+ * Reads options of evaluation (see function eval_expression_interpreted).
+ */
+
+void
+eval_read_options (struct t_hashtable *options, int *condition,
+                   int *extra_vars_eval, const char **prefix,
+                   const char **suffix, const char **regex,
+                   const char **regex_replace)
+{
+    const char *ptr_value;
+
+    *condition = 0;
+    *extra_vars_eval = 0;
+    *prefix = EVAL_DEFAULT_PREFIX;
+    *suffix = EVAL_DEFAULT_SUFFIX;
+    *regex = NULL;
+    *regex_replace = NULL;
+
+    if (!options)
+        return;
+
+    ptr_value = hashtable_get (options, "type");
+    if (ptr_value && (strcmp (ptr_value, "condition") == 0))
+        *condition = 1;
+
+    ptr_value = hashtable_get (options, "extra");
+    if (ptr_value && (strcmp (ptr_value, "eval") == 0))
+        *extra_vars_eval = 1;
+
+    ptr_value = hashtable_get (options, "prefix");
+    if (ptr_value && ptr_value[0])
+        *prefix = ptr_value;
+
+    ptr_value = hashtable_get (options, "suffix");
+    if (ptr_value && ptr_value[0])
+        *suffix = ptr_value;
+
+    *regex = hashtable_get (options, "regex");
+    *regex_replace = hashtable_get (options, "regex_replace");
+}
+
+/*
+ * Compiles an expression: the expression is parsed once, and can then be
+ * evaluated many times with function eval_exec (faster than function
+ * eval_expression_interpreted, with the same result).
+ *
+ * The hashtable "options" must have string for keys and values, supported
+ * options are the same as function eval_expression_interpreted.
+ *
+ * Returns pointer to compiled expression, NULL if error.
+ *
+ * Note: result must be freed by a call to function eval_compiled_free.
+ */
+
+struct t_eval_compiled *
+eval_compile (const char *expr, struct t_hashtable *options)
+{
+    struct t_eval_compiled *new_compiled;
+    const char *prefix, *suffix, *regex, *regex_replace;
+    int condition, extra_vars_eval;
+
+    if (!expr)
+        return NULL;
+
+    eval_read_options (options, &condition, &extra_vars_eval,
+                       &prefix, &suffix, &regex, &regex_replace);
+
+    new_compiled = malloc (sizeof (*new_compiled));
+    if (!new_compiled)
+        return NULL;
+
+    new_compiled->expr = strdup (expr);
+    new_compiled->condition = condition;
+    new_compiled->extra_vars_eval = extra_vars_eval;
+    new_compiled->prefix = strdup (prefix);
+    new_compiled->suffix = strdup (suffix);
+    new_compiled->regex_string = (regex) ? strdup (regex) : NULL;
+    new_compiled->regex_replace = (regex_replace) ?
+        strdup (regex_replace) : NULL;
+    new_compiled->regex = NULL;
+    new_compiled->node = NULL;
+    new_compiled->expr_template = NULL;
+    new_compiled->replace_template = NULL;
+    new_compiled->refcount = 1;
+    new_compiled->prev_compiled = NULL;
+    new_compiled->next_compiled = NULL;
+
+    if (!new_compiled->expr || !new_compiled->prefix || !new_compiled->suffix
+        || (regex && !new_compiled->regex_string)
+        || (regex_replace && !new_compiled->regex_replace))
+    {
+        goto error;
+    }
+
+    if (regex)
+    {
+        new_compiled->regex = malloc (sizeof (*new_compiled->regex));
+        if (!new_compiled->regex)
+            goto error;
+        if (string_regcomp (new_compiled->regex, regex,
+                            REG_EXTENDED | REG_ICASE) != 0)
+        {
+            free (new_compiled->regex);
+            new_compiled->regex = NULL;
+        }
+    }
+
+    if (condition)
+    {
+        new_compiled->node = eval_compile_condition (expr, prefix, suffix);
+        if (!new_compiled->node)
+            goto error;
+    }
+    else
+    {
+        new_compiled->expr_template = eval_compile_template (expr,
+                                                             prefix, suffix,
+                                                             1);
+        if (!new_compiled->expr_template)
+            goto error;
+        if (regex_replace)
+        {
+            new_compiled->replace_template = eval_compile_template (
+                regex_replace, prefix, suffix, 1);
+            if (!new_compiled->replace_template)
+                goto error;
+        }
+    }
+
+    return new_compiled;
+
+error:
+    eval_compiled_free (new_compiled);
+    return NULL;
+}
+
+/*
+ * Evaluates a compiled expression.
+ *
+ * The hashtable "pointers" must have string for keys, pointer for values.
+ * The hashtable "extra_vars" must have string for keys and values.
+ *
+ * Note: result must be freed after use (if not NULL).
+ */
+
+char *
+eval_exec (struct t_eval_compiled *compiled, struct t_hashtable *pointers,
+           struct t_hashtable *extra_vars)
+{
+    struct t_eval_context eval_context;
+    struct t_gui_window *window;
+    int rc, pointers_allocated;
+    char *value;
+    regex_t *regex;
+
+    if (!compiled)
+        return NULL;
+
+    pointers_allocated = 0;
+    regex = NULL;
+
+    if (pointers)
+    {
+        regex = (regex_t *)hashtable_get (pointers, "regex");
+    }
+    else
+    {
+        /* create hashtable pointers if it's NULL */
+        pointers = hashtable_new (32,
+                                  WEECHAT_HASHTABLE_STRING,
+                                  WEECHAT_HASHTABLE_POINTER,
+                                  NULL,
+                                  NULL);
+        if (!pointers)
+            return NULL;
+        pointers_allocated = 1;
+    }
+
+    /* regex in options has higher priority than regex in pointers */
+    if (compiled->regex_string)
+        regex = compiled->regex;
+
+    eval_context.pointers = pointers;
+    eval_context.extra_vars = extra_vars;
+    eval_context.extra_vars_eval = compiled->extra_vars_eval;
+    eval_context.prefix = compiled->prefix;
+    eval_context.suffix = compiled->suffix;
+    eval_context.regex = NULL;
+    eval_context.recursion_count = 0;
+
+    /*
+     * set window/buffer with pointer to current window/buffer
+     * (if not already defined in the hashtable)
+     */
+    if (gui_current_window)
+    {
+        if (!hashtable_has_key (pointers, "window"))
+            hashtable_set (pointers, "window", gui_current_window);
+        if (!hashtable_has_key (pointers, "buffer"))
+        {
+            window = (struct t_gui_window *)hashtable_get (pointers, "window");
+            if (window)
+                hashtable_set (pointers, "buffer", window->buffer);
+        }
+    }
+
+    /* the compiled expression must not be freed during evaluation */
+    compiled->refcount++;
+
+    if (compiled->condition)
+    {
+        /* evaluate as condition (return a boolean: "0" or "1") */
+        value = eval_node_exec (compiled->node, &eval_context);
+        rc = eval_is_true (value);
+        if (value)
+            free (value);
+        value = strdup ((rc) ? EVAL_STR_TRUE : EVAL_STR_FALSE);
+    }
+    else if (regex && compiled->regex_replace)
+    {
+        /* replace with regex */
+        value = eval_replace_regex (compiled->expr, regex,
+                                    compiled->regex_replace,
+                                    compiled->replace_template,
+                                    &eval_context);
+    }
+    else
+    {
+        /* only replace variables in expression */
+        value = eval_template_exec (compiled->expr_template, &eval_context);
+    }
+
+    eval_compiled_free (compiled);
+
+    if (pointers_allocated)
+        hashtable_free (pointers);
+
+    return value;
+}
+
+/*
+ * Frees a compiled expression (or removes a reference if the compiled
+ * expression is still used).
+ */
+
+void
+eval_compiled_free (struct t_eval_compiled *compiled)
+{
+    if (!compiled)
+        return;
+
+    compiled->refcount--;
+    if (compiled->refcount > 0)
+        return;
+
+    if (compiled->expr)
+        free (compiled->expr);
+    if (compiled->prefix)
+        free (compiled->prefix);
+    if (compiled->suffix)
+        free (compiled->suffix);
+    if (compiled->regex_string)
+        free (compiled->regex_string);
+    if (compiled->regex_replace)
+        free (compiled->regex_replace);
+    if (compiled->regex)
+    {
+        regfree (compiled->regex);
+        free (compiled->regex);
+    }
+    eval_node_free (compiled->node);
+    eval_template_free (compiled->expr_template);
+    eval_template_free (compiled->replace_template);
+
+    free (compiled);
+}
+
+/*
+ * Checks if a compiled expression has been compiled with these options.
+ *
+ * Returns:
+ *   1: same options
+ *   0: different options
+ */
+
+int
+eval_compiled_has_options (struct t_eval_compiled *compiled,
+                           struct t_hashtable *options)
+{
+    const char *prefix, *suffix, *regex, *regex_replace;
+    int condition, extra_vars_eval;
+
+    eval_read_options (options, &condition, &extra_vars_eval,
+                       &prefix, &suffix, &regex, &regex_replace);
+
+    return ((condition == compiled->condition)
+            && (extra_vars_eval == compiled->extra_vars_eval)
+            && (strcmp (prefix, compiled->prefix) == 0)
+            && (strcmp (suffix, compiled->suffix) == 0)
+            && (((!regex && !compiled->regex_string)
+                 || (regex && compiled->regex_string
+                     && (strcmp (regex, compiled->regex_string) == 0))))
+            && (((!regex_replace && !compiled->regex_replace)
+                 || (regex_replace && compiled->regex_replace
+                     && (strcmp (regex_replace,
+                                 compiled->regex_replace) == 0))))) ? 1 : 0;
+}
+
+/*
+ * Removes a compiled expression from cache.
+ */
+
+void
+eval_cache_remove (struct t_eval_compiled *compiled)
+{
+    if (compiled->prev_compiled)
+        (compiled->prev_compiled)->next_compiled = compiled->next_compiled;
+    else
+        eval_cache_first = compiled->next_compiled;
+    if (compiled->next_compiled)
+        (compiled->next_compiled)->prev_compiled = compiled->prev_compiled;
+    else
+        eval_cache_last = compiled->prev_compiled;
+
+    hashtable_remove (eval_cache, compiled->expr);
+    eval_cache_count--;
+
+    eval_compiled_free (compiled);
+}
+
+/*
+ * Gets a compiled expression from cache: if the expression is not in cache
+ * (or was compiled with other options), it is compiled and added in cache.
+ *
+ * The cache keeps the EVAL_CACHE_MAX_SIZE expressions recently used.
+ *
+ * Returns pointer to compiled expression, NULL if error.
+ *
+ * Note: result must be freed by a call to function eval_compiled_free.
+ */
+
+struct t_eval_compiled *
+eval_cache_get (const char *expr, struct t_hashtable *options)
+{
+    struct t_eval_compiled *ptr_compiled;
+
+    if (!eval_cache)
+    {
+        eval_cache = hashtable_new (EVAL_CACHE_MAX_SIZE,
+                                    WEECHAT_HASHTABLE_STRING,
+                                    WEECHAT_HASHTABLE_POINTER,
+                                    NULL,
+                                    NULL);
+        if (!eval_cache)
+            return NULL;
+    }
+
+    ptr_compiled = hashtable_get (eval_cache, expr);
+    if (ptr_compiled && !eval_compiled_has_options (ptr_compiled, options))
+    {
+        eval_cache_remove (ptr_compiled);
+        ptr_compiled = NULL;
+    }
+
+    if (ptr_compiled)
+    {
+        /* move compiled expression at beginning of list (recently used) */
+        if (ptr_compiled->prev_compiled)
+        {
+            (ptr_compiled->prev_compiled)->next_compiled = ptr_compiled->next_compiled;
+            if (ptr_compiled->next_compiled)
+                (ptr_compiled->next_compiled)->prev_compiled = ptr_compiled->prev_compiled;
+            else
+                eval_cache_last = ptr_compiled->prev_compiled;
+            ptr_compiled->prev_compiled = NULL;
+            ptr_compiled->next_compiled = eval_cache_first;
+            eval_cache_first->prev_compiled = ptr_compiled;
+            eval_cache_first = ptr_compiled;
+        }
+    }
+    else
+    {
+        ptr_compiled = eval_compile (expr, options);
+        if (!ptr_compiled)
+            return NULL;
+        if (!hashtable_set (eval_cache, expr, ptr_compiled))
+            return ptr_compiled;
+        ptr_compiled->prev_compiled = NULL;
+        ptr_compiled->next_compiled = eval_cache_first;
+        if (eval_cache_first)
+            eval_cache_first->prev_compiled = ptr_compiled;
+        else
+            eval_cache_last = ptr_compiled;
+        eval_cache_first = ptr_compiled;
+        eval_cache_count++;
+
+        /* remove the least recently used expressions */
+        while (eval_cache_count > EVAL_CACHE_MAX_SIZE)
+        {
+            eval_cache_remove (eval_cache_last);
+        }
+    }
+
+    /* reference for the caller */
+    ptr_compiled->refcount++;
+
+    return ptr_compiled;
+}
+
+/*
+ * Evaluates an expression (see function eval_expression_interpreted for
+ * the description of arguments and examples).
+ *
+ * The expression is compiled and kept in a cache (so that expressions
+ * evaluated many times, like bar items or conditions of triggers, are
+ * parsed only once).
+ *
+ * Note: result must be freed after use (if not NULL).
+ */
+
+char *
+eval_expression (const char *expr, struct t_hashtable *pointers,
+                 struct t_hashtable *extra_vars, struct t_hashtable *options)
+{
+    struct t_eval_compiled *ptr_compiled;
+    const char *prefix, *suffix, *regex, *regex_replace;
+    int condition, extra_vars_eval;
+    char *value;
+
+    if (!expr)
+        return NULL;
+
+    eval_read_options (options, &condition, &extra_vars_eval,
+                       &prefix, &suffix, &regex, &regex_replace);
+
+    /*
+     * with a regex (as string in options or compiled in pointers), the
+     * expression is a string where text is replaced (for example a message
+     * in a trigger): it is different on each call and may contain private
+     * data, so it is not kept in cache
+     */
+    if (regex || regex_replace
+        || (pointers && hashtable_has_key (pointers, "regex")))
+    {
+        return eval_expression_interpreted (expr, pointers, extra_vars,
+                                            options);
+    }
+
+    /* no variable to replace: return the string as-is */
+    if (!condition && !regex_replace && !strchr (expr, prefix[0]))
+        return strdup (expr);
+
+    ptr_compiled = eval_cache_get (expr, options);
+    if (!ptr_compiled)
+        return eval_expression_interpreted (expr, pointers, extra_vars,
+                                            options);
+
+    value = eval_exec (ptr_compiled, pointers, extra_vars);
+
+    eval_compiled_free (ptr_compiled);
+
+    return value;
+}
+
+/*
+ * Frees all compiled expressions in cache.
+ */
+
+void
+eval_cache_free_all ()
+{
+    while (eval_cache_first)
+    {
+        eval_cache_remove (eval_cache_first);
+    }
+    if (eval_cache)
+    {
+        hashtable_free (eval_cache);
+        eval_cache = NULL;
+    }
+}
@@ -30,7 +30,11 @@
 
 #define EVAL_RECURSION_MAX  32
 
+#define EVAL_CACHE_MAX_SIZE 256
+
 struct t_hashtable;
+struct t_eval_node;
+struct t_eval_template;
 
 enum t_eval_logical_op
 {
@@ -56,6 +60,85 @@ enum t_eval_comparison
     EVAL_NUM_COMPARISONS,
 };
 
+enum t_eval_var_type
+{
+    EVAL_VAR_DYNAMIC = 0,              /* name with variables, or var       */
+                                       /* evaluated by eval_replace_vars_cb */
+    EVAL_VAR_CONSTANT,                 /* constant (esc:, hide:, cut:)      */
+    EVAL_VAR_EVAL,                     /* string to evaluate (eval:)        */
+    EVAL_VAR_IF,                       /* ternary operator (if:)            */
+    EVAL_VAR_NAME,                     /* option, local variable or hdata   */
+    /* number of variable types */
+    EVAL_NUM_VAR_TYPES,
+};
+
+enum t_eval_node_type
+{
+    EVAL_NODE_CONSTANT = 0,            /* constant string                   */
+    EVAL_NODE_TEMPLATE,                /* string with variables             */
+    EVAL_NODE_LOGICAL,                 /* logical operator: && ||           */
+    EVAL_NODE_COMPARE,                 /* comparison: == != ...             */
+    EVAL_NODE_INTERPRETED,             /* evaluated by interpreter          */
+    /* number of node types */
+    EVAL_NUM_NODE_TYPES,
+};
+
+struct t_eval_template_part
+{
+    char *text;                        /* literal text or name of variable  */
+    int is_var;                        /* 1 if part is a variable           */
+    enum t_eval_var_type var_type;     /* type of variable                  */
+    struct t_eval_template *name;      /* name with variables (dynamic var) */
+    char *value;                       /* value (constant var)              */
+    struct t_eval_template *value_true;  /* eval: string, if: value if true */
+    struct t_eval_template *value_false; /* if: value if false              */
+    struct t_eval_node *condition;     /* if: condition                     */
+    int may_be_option;                 /* 1 if name can be an option        */
+    char *hdata_name;                  /* hdata name (var name)             */
+    char *list_name;                   /* hdata list or pointer (var name)  */
+    char *path;                        /* hdata path (var name)             */
+};
+
+struct t_eval_template
+{
+    int count_recursion;               /* 1 if evaluated as a call to       */
+                                       /* eval_replace_vars (recursion max) */
+    int parts_count;                   /* number of parts                   */
+    struct t_eval_template_part *parts;  /* literal text and variables      */
+};
+
+struct t_eval_node
+{
+    enum t_eval_node_type type;        /* type of node                      */
+    int op;                            /* logical operator or comparison    */
+    char *text;                        /* constant/expression to interpret  */
+    struct t_eval_template *expr_template; /* string with variables         */
+    struct t_eval_node *left;          /* left operand                      */
+    struct t_eval_node *right;         /* right operand                     */
+    regex_t *regex;                    /* regex compiled (if right operand  */
+                                       /* of regex comparison is constant)  */
+    int regex_rc;                      /* return code of regex compilation  */
+};
+
+struct t_eval_compiled
+{
+    char *expr;                        /* expression compiled               */
+    int condition;                     /* 1 if evaluated as condition       */
+    int extra_vars_eval;               /* 1 if extra vars are evaluated     */
+    char *prefix;                      /* prefix before variables           */
+    char *suffix;                      /* suffix after variables            */
+    char *regex_string;                /* regex (option "regex")            */
+    char *regex_replace;               /* replacement (option               */
+                                       /* "regex_replace")                  */
+    regex_t *regex;                    /* regex compiled                    */
+    struct t_eval_node *node;          /* compiled condition                */
+    struct t_eval_template *expr_template; /* compiled expression           */
+    struct t_eval_template *replace_template; /* compiled replacement       */
+    int refcount;                      /* number of references              */
+    struct t_eval_compiled *prev_compiled; /* link to previous (cache)      */
+    struct t_eval_compiled *next_compiled; /* link to next (cache)          */
+};
+
 struct t_eval_regex
 {
     const char *result;
@@ -74,10 +157,23 @@ struct t_eval_context
     int recursion_count;
 };
 
+extern int eval_cache_count;
+
 extern int eval_is_true (const char *value);
+extern struct t_eval_compiled *eval_compile (const char *expr,
+                                             struct t_hashtable *options);
+extern char *eval_exec (struct t_eval_compiled *compiled,
+                        struct t_hashtable *pointers,
+                        struct t_hashtable *extra_vars);
+extern void eval_compiled_free (struct t_eval_compiled *compiled);
+extern char *eval_expression_interpreted (const char *expr,
+                                          struct t_hashtable *pointers,
+                                          struct t_hashtable *extra_vars,
+                                          struct t_hashtable *options);
 extern char *eval_expression (const char *expr,
                               struct t_hashtable *pointers,
                               struct t_hashtable *extra_vars,
                               struct t_hashtable *options);
+extern void eval_cache_free_all ();
 
 #endif /* WEECHAT_EVAL_H */
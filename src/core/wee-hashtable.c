@@ -41,6 +41,11 @@ char *hashtable_type_string[HASHTABLE_NUM_TYPES] =
   WEECHAT_HASHTABLE_POINTER, WEECHAT_HASHTABLE_BUFFER,
   WEECHAT_HASHTABLE_TIME };
 
+char hashtable_deleted_key;            /* its address is used as key in     */
+                                       /* slots of deleted items            */
+
+#define HASHTABLE_DELETED_KEY ((void *)&hashtable_deleted_key)
+
 
 /*
  * Searches for a hashtable type.
@@ -175,13 +180,165 @@ hashtable_keycmp_default_cb (struct t_hashtable *hashtable,
     return rc;
 }
 
+/*
+ * Checks if a slot of hashtable is used by an item.
+ *
+ * Returns:
+ *   1: slot is used
+ *   0: slot is free or item has been deleted
+ */
+
+int
+hashtable_item_is_used (struct t_hashtable_item *item)
+{
+    return (item->key && (item->key != HASHTABLE_DELETED_KEY)) ? 1 : 0;
+}
+
+/*
+ * Returns the index of slot for a hashed key.
+ *
+ * The hash is multiplied by a constant (Fibonacci hashing), so that all bits
+ * of hash are used, even if the size of hashtable is a power of 2 (for
+ * example pointers are aligned, so their lowest bits are often 0).
+ */
+
+int
+hashtable_get_index (struct t_hashtable *hashtable, unsigned long long hash)
+{
+    return (int)(((hash * 11400714819323198485ULL) >> 32)
+                 & (unsigned long long)(hashtable->size - 1));
+}
+
+/*
+ * Searches for slot of an item with a key.
+ *
+ * If index_insert is not NULL and that the key is not found, it is set to the
+ * index of slot where the item can be inserted.
+ *
+ * Returns pointer to item found, NULL if not found.
+ */
+
+struct t_hashtable_item *
+hashtable_search_slot (struct t_hashtable *hashtable, const void *key,
+                       unsigned long long hash, int *index_insert)
+{
+    struct t_hashtable_item *ptr_item;
+    int index, mask, first_deleted;
+
+    mask = hashtable->size - 1;
+    first_deleted = -1;
+
+    for (index = hashtable_get_index (hashtable, hash); ;
+         index = (index + 1) & mask)
+    {
+        ptr_item = &hashtable->htable[index];
+        if (!ptr_item->key)
+        {
+            /* free slot: the key is not in hashtable */
+            if (index_insert)
+                *index_insert = (first_deleted >= 0) ? first_deleted : index;
+            return NULL;
+        }
+        if (ptr_item->key == HASHTABLE_DELETED_KEY)
+        {
+            if (first_deleted < 0)
+                first_deleted = index;
+        }
+        else if ((ptr_item->hash == hash)
+                 && (hashtable->callback_keycmp (hashtable, key,
+                                                 ptr_item->key) == 0))
+        {
+            return ptr_item;
+        }
+    }
+
+    /* never executed: there is always at least one free slot */
+    return NULL;
+}
+
+/*
+ * Resizes the array with slots: all items are moved in the new array (the
+ * hashed keys are not computed again), deleted items are dropped.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+hashtable_resize (struct t_hashtable *hashtable, int new_size)
+{
+    struct t_hashtable_item *old_htable, *ptr_item;
+    int i, old_size, index, mask;
+
+    while (new_size <= hashtable->items_count)
+    {
+        new_size *= 2;
+    }
+
+    old_htable = hashtable->htable;
+    old_size = hashtable->size;
+
+    hashtable->htable = calloc (new_size, sizeof (*hashtable->htable));
+    if (!hashtable->htable)
+    {
+        hashtable->htable = old_htable;
+        return 0;
+    }
+    hashtable->size = new_size;
+    hashtable->deleted_count = 0;
+
+    mask = new_size - 1;
+    for (i = 0; i < old_size; i++)
+    {
+        if (!hashtable_item_is_used (&old_htable[i]))
+            continue;
+        for (index = hashtable_get_index (hashtable, old_htable[i].hash);
+             hashtable->htable[index].key;
+             index = (index + 1) & mask)
+        {
+        }
+        ptr_item = &hashtable->htable[index];
+        memcpy (ptr_item, &old_htable[i], sizeof (*ptr_item));
+    }
+
+    free (old_htable);
+
+    return 1;
+}
+
+/*
+ * Shrinks the array of hashtable if it is less than 1/8 full (the size never
+ * goes below the initial size).
+ */
+
+void
+hashtable_shrink (struct t_hashtable *hashtable)
+{
+    int new_size;
+
+    if (hashtable->map_running)
+        return;
+
+    new_size = hashtable->size;
+    while ((new_size > hashtable->size_min)
+           && (hashtable->items_count * 8 < new_size))
+    {
+        new_size /= 2;
+    }
+
+    if (new_size < hashtable->size)
+        hashtable_resize (hashtable, new_size);
+}
+
 /*
  * Creates a new hashtable.
  *
- * The size is NOT a limit for number of items in hashtable. It is the size of
- * internal array to store hashed keys: a high value uses more memory, but has
- * better performance because this reduces the collisions of hashed keys and
- * then reduces length of linked lists.
+ * The size is NOT a limit for number of items in hashtable. It is the initial
+ * size of internal array to store items (rounded to the next power of 2):
+ * the array grows automatically when needed, but never shrinks below this
+ * size. A high value uses more memory, but prevents resizes of array when
+ * many items are added.
  *
  * Returns pointer to new hashtable, NULL if error.
  */
@@ -193,7 +350,7 @@ hashtable_new (int size,
                t_hashtable_keycmp *callback_keycmp)
 {
     struct t_hashtable *new_hashtable;
-    int i, type_keys_int, type_values_int;
+    int type_keys_int, type_values_int, size_slots;
 
     if (size <= 0)
         return NULL;
@@ -209,24 +366,31 @@ hashtable_new (int size,
     if ((type_keys_int == HASHTABLE_BUFFER) && (!callback_hash_key || !callback_keycmp))
         return NULL;
 
+    /* size of array is a power of 2 */
+    size_slots = HASHTABLE_MIN_SIZE;
+    while ((size_slots < size) && (size_slots < (1 << 30)))
+    {
+        size_slots *= 2;
+    }
+
     new_hashtable = malloc (sizeof (*new_hashtable));
     if (new_hashtable)
     {
-        new_hashtable->size = size;
+        new_hashtable->size = size_slots;
+        new_hashtable->size_min = size_slots;
         new_hashtable->type_keys = type_keys_int;
         new_hashtable->type_values = type_values_int;
-        new_hashtable->htable = malloc (size * sizeof (*(new_hashtable->htable)));
+        new_hashtable->htable = calloc (size_slots,
+                                        sizeof (*(new_hashtable->htable)));
         new_hashtable->keys_values = NULL;
         if (!new_hashtable->htable)
         {
             free (new_hashtable);
             return NULL;
         }
-        for (i = 0; i < size; i++)
-        {
-            new_hashtable->htable[i] = NULL;
-        }
         new_hashtable->items_count = 0;
+        new_hashtable->deleted_count = 0;
+        new_hashtable->map_running = 0;
 
         new_hashtable->callback_hash_key = (callback_hash_key) ?
             callback_hash_key : &hashtable_hash_key_default_cb;
@@ -366,6 +530,9 @@ hashtable_free_value (struct t_hashtable *hashtable,
  *
  * The size arguments are used only for type "buffer".
  *
+ * Note: the pointer to item returned is valid only until the next change in
+ * the hashtable (items are moved when the hashtable is resized).
+ *
  * Returns pointer to item created/updated, NULL if error.
  */
 
@@ -375,7 +542,8 @@ hashtable_set_with_size (struct t_hashtable *hashtable,
                          const void *value, int value_size)
 {
     unsigned long long hash;
-    struct t_hashtable_item *ptr_item, *pos_item, *new_item;
+    struct t_hashtable_item *ptr_item, new_item;
+    int index, new_size;
 
     if (!hashtable || !key
         || ((hashtable->type_keys == HASHTABLE_BUFFER) && (key_size <= 0))
@@ -384,63 +552,68 @@ hashtable_set_with_size (struct t_hashtable *hashtable,
         return NULL;
     }
 
-    /* search position for item in hashtable */
-    hash = hashtable->callback_hash_key (hashtable, key) % hashtable->size;
-    pos_item = NULL;
-    for (ptr_item = hashtable->htable[hash];
-         ptr_item
-             && ((int)(hashtable->callback_keycmp) (hashtable, key, ptr_item->key) > 0);
-         ptr_item = ptr_item->next_item)
-    {
-        pos_item = ptr_item;
-    }
+    /* search item in hashtable */
+    hash = hashtable->callback_hash_key (hashtable, key);
+    ptr_item = hashtable_search_slot (hashtable, key, hash, &index);
 
     /* replace value if item is already in hashtable */
-    if (ptr_item && (hashtable->callback_keycmp (hashtable, key, ptr_item->key) == 0))
+    if (ptr_item)
     {
-        hashtable_free_value (hashtable, ptr_item);
+        memcpy (&new_item, ptr_item, sizeof (new_item));
         hashtable_alloc_type (hashtable->type_values,
                               value, value_size,
                               &ptr_item->value, &ptr_item->value_size);
+        hashtable_free_value (hashtable, &new_item);
         return ptr_item;
     }
 
-    /* create new item */
-    new_item = malloc (sizeof (*new_item));
-    if (!new_item)
-        return NULL;
-
     /* set key and value */
     hashtable_alloc_type (hashtable->type_keys,
                           key, key_size,
-                          &new_item->key, &new_item->key_size);
+                          &new_item.key, &new_item.key_size);
+    if (!new_item.key)
+        return NULL;
     hashtable_alloc_type (hashtable->type_values,
                           value, value_size,
-                          &new_item->value, &new_item->value_size);
-
-    /* add item */
-    if (pos_item)
-    {
-        /* insert item after position found */
-        new_item->prev_item = pos_item;
-        new_item->next_item = pos_item->next_item;
-        if (pos_item->next_item)
-            (pos_item->next_item)->prev_item = new_item;
-        pos_item->next_item = new_item;
-    }
-    else
+                          &new_item.value, &new_item.value_size);
+    new_item.hash = hash;
+
+    /*
+     * grow the array if it is more than 3/4 full (with deleted items); if
+     * there are many deleted items, the array is just cleaned (same size);
+     * while hashtable_map is running, the array is resized only if it is
+     * full (to keep at least one free slot)
+     */
+    if ((hashtable->items_count + hashtable->deleted_count + 1) * 4
+        > hashtable->size * 3)
     {
-        /* insert item at beginning of list */
-        new_item->prev_item = NULL;
-        new_item->next_item = hashtable->htable[hash];
-        if (hashtable->htable[hash])
-            (hashtable->htable[hash])->prev_item = new_item;
-        hashtable->htable[hash] = new_item;
+        if (!hashtable->map_running
+            || (hashtable->items_count + hashtable->deleted_count + 1
+                >= hashtable->size))
+        {
+            new_size = ((hashtable->items_count + 1) * 2 > hashtable->size) ?
+                hashtable->size * 2 : hashtable->size;
+            if (hashtable_resize (hashtable, new_size))
+                (void) hashtable_search_slot (hashtable, key, hash, &index);
+            else if (hashtable->items_count + hashtable->deleted_count + 1
+                     >= hashtable->size)
+            {
+                hashtable_free_key (hashtable, &new_item);
+                hashtable_free_value (hashtable, &new_item);
+                return NULL;
+            }
+        }
     }
 
+    /* add item */
+    ptr_item = &hashtable->htable[index];
+    if (ptr_item->key == HASHTABLE_DELETED_KEY)
+        hashtable->deleted_count--;
+    memcpy (ptr_item, &new_item, sizeof (*ptr_item));
+
     hashtable->items_count++;
 
-    return new_item;
+    return ptr_item;
 }
 
 /*
@@ -464,6 +637,9 @@ hashtable_set (struct t_hashtable *hashtable,
  *
  * If hash is non NULL, then it is set with hash value of key (even if key is
  * not found).
+ *
+ * Note: the pointer to item returned is valid only until the next change in
+ * the hashtable (items are moved when the hashtable is resized).
  */
 
 struct t_hashtable_item *
@@ -471,27 +647,15 @@ hashtable_get_item (struct t_hashtable *hashtable, const void *key,
                     unsigned long long *hash)
 {
     unsigned long long key_hash;
-    struct t_hashtable_item *ptr_item;
 
     if (!hashtable || !key)
         return NULL;
 
-    key_hash = hashtable->callback_hash_key (hashtable, key) % hashtable->size;
+    key_hash = hashtable->callback_hash_key (hashtable, key);
     if (hash)
         *hash = key_hash;
-    for (ptr_item = hashtable->htable[key_hash];
-         ptr_item && hashtable->callback_keycmp (hashtable, key, ptr_item->key) > 0;
-         ptr_item = ptr_item->next_item)
-    {
-    }
-
-    if (ptr_item
-        && (hashtable->callback_keycmp (hashtable, key, ptr_item->key) == 0))
-    {
-        return ptr_item;
-    }
 
-    return NULL;
+    return hashtable_search_slot (hashtable, key, key_hash, NULL);
 }
 
 /*
@@ -574,26 +738,29 @@ hashtable_map (struct t_hashtable *hashtable,
                void *callback_map_data)
 {
     int i;
-    struct t_hashtable_item *ptr_item, *ptr_next_item;
+    struct t_hashtable_item *ptr_item;
 
     if (!hashtable)
         return;
 
+    hashtable->map_running++;
+
     for (i = 0; i < hashtable->size; i++)
     {
-        ptr_item = hashtable->htable[i];
-        while (ptr_item)
+        ptr_item = &hashtable->htable[i];
+        if (hashtable_item_is_used (ptr_item))
         {
-            ptr_next_item = ptr_item->next_item;
-
             (void) (callback_map) (callback_map_data,
                                    hashtable,
                                    ptr_item->key,
                                    ptr_item->value);
-
-            ptr_item = ptr_next_item;
         }
     }
+
+    hashtable->map_running--;
+
+    /* items may have been removed by callback */
+    hashtable_shrink (hashtable);
 }
 
 /*
@@ -606,41 +773,44 @@ hashtable_map_string (struct t_hashtable *hashtable,
                       void *callback_map_data)
 {
     int i;
-    struct t_hashtable_item *ptr_item, *ptr_next_item;
+    struct t_hashtable_item *ptr_item;
     const char *str_key, *str_value;
     char *key, *value;
 
     if (!hashtable)
         return;
 
+    hashtable->map_running++;
+
     for (i = 0; i < hashtable->size; i++)
     {
-        ptr_item = hashtable->htable[i];
-        while (ptr_item)
-        {
-            ptr_next_item = ptr_item->next_item;
-
-            str_key = hashtable_to_string (hashtable->type_keys,
-                                           ptr_item->key);
-            key = (str_key) ? strdup (str_key) : NULL;
-
-            str_value = hashtable_to_string (hashtable->type_values,
-                                             ptr_item->value);
-            value = (str_value) ? strdup (str_value) : NULL;
-
-            (void) (callback_map) (callback_map_data,
-                                   hashtable,
-                                   key,
-                                   value);
+        ptr_item = &hashtable->htable[i];
+        if (!hashtable_item_is_used (ptr_item))
+            continue;
+
+        str_key = hashtable_to_string (hashtable->type_keys,
+                                       ptr_item->key);
+        key = (str_key) ? strdup (str_key) : NULL;
+
+        str_value = hashtable_to_string (hashtable->type_values,
+                                         ptr_item->value);
+        value = (str_value) ? strdup (str_value) : NULL;
+
+        (void) (callback_map) (callback_map_data,
+                               hashtable,
+                               key,
+                               value);
+
+        if (key)
+            free (key);
+        if (value)
+            free (value);
+    }
 
-            if (key)
-                free (key);
-            if (value)
-                free (value);
+    hashtable->map_running--;
 
-            ptr_item = ptr_next_item;
-        }
-    }
+    /* items may have been removed by callback */
+    hashtable_shrink (hashtable);
 }
 
 /*
@@ -674,7 +844,7 @@ hashtable_dup (struct t_hashtable *hashtable)
 {
     struct t_hashtable *new_hashtable;
 
-    new_hashtable = hashtable_new (hashtable->size,
+    new_hashtable = hashtable_new (hashtable->size_min,
                                    hashtable_type_string[hashtable->type_keys],
                                    hashtable_type_string[hashtable->type_values],
                                    hashtable->callback_hash_key,
@@ -683,6 +853,8 @@ hashtable_dup (struct t_hashtable *hashtable)
     {
         new_hashtable->callback_free_key = hashtable->callback_free_key;
         new_hashtable->callback_free_value = hashtable->callback_free_value;
+        if (hashtable->size > new_hashtable->size)
+            hashtable_resize (new_hashtable, hashtable->size);
         hashtable_map (hashtable,
                        &hashtable_duplicate_map_cb,
                        new_hashtable);
@@ -1053,8 +1225,8 @@ hashtable_add_to_infolist (struct t_hashtable *hashtable,
     item_number = 0;
     for (i = 0; i < hashtable->size; i++)
     {
-        for (ptr_item = hashtable->htable[i]; ptr_item;
-             ptr_item = ptr_item->next_item)
+        ptr_item = &hashtable->htable[i];
+        if (hashtable_item_is_used (ptr_item))
         {
             snprintf (option_name, sizeof (option_name),
                       "%s_name_%05d", prefix, item_number);
@@ -1192,27 +1364,40 @@ hashtable_add_from_infolist (struct t_hashtable *hashtable,
 
 void
 hashtable_remove_item (struct t_hashtable *hashtable,
-                       struct t_hashtable_item *item,
-                       unsigned long long hash)
+                       struct t_hashtable_item *item)
 {
+    struct t_hashtable_item old_item;
+    int next_index;
+
     if (!hashtable || !item)
         return;
 
-    /* free key and value */
-    hashtable_free_value (hashtable, item);
-    hashtable_free_key (hashtable, item);
-
-    /* remove item from list */
-    if (item->prev_item)
-        (item->prev_item)->next_item = item->next_item;
-    if (item->next_item)
-        (item->next_item)->prev_item = item->prev_item;
-    if (hashtable->htable[hash] == item)
-        hashtable->htable[hash] = item->next_item;
-
-    free (item);
+    /*
+     * mark slot as deleted (or free if next slot is free: then the slot is
+     * not used by any search of other keys) before freeing key and value,
+     * so that the callbacks can safely use the hashtable
+     */
+    memcpy (&old_item, item, sizeof (old_item));
+    next_index = ((item - hashtable->htable) + 1) & (hashtable->size - 1);
+    if (hashtable->htable[next_index].key)
+    {
+        item->key = HASHTABLE_DELETED_KEY;
+        hashtable->deleted_count++;
+    }
+    else
+    {
+        item->key = NULL;
+    }
+    item->key_size = 0;
+    item->value = NULL;
+    item->value_size = 0;
+    item->hash = 0;
 
     hashtable->items_count--;
+
+    /* free key and value */
+    hashtable_free_value (hashtable, &old_item);
+    hashtable_free_key (hashtable, &old_item);
 }
 
 /*
@@ -1223,14 +1408,16 @@ void
 hashtable_remove (struct t_hashtable *hashtable, const void *key)
 {
     struct t_hashtable_item *ptr_item;
-    unsigned long long hash;
 
     if (!hashtable || !key)
         return;
 
-    ptr_item = hashtable_get_item (hashtable, key, &hash);
+    ptr_item = hashtable_get_item (hashtable, key, NULL);
     if (ptr_item)
-        hashtable_remove_item (hashtable, ptr_item, hash);
+    {
+        hashtable_remove_item (hashtable, ptr_item);
+        hashtable_shrink (hashtable);
+    }
 }
 
 /*
@@ -1247,11 +1434,11 @@ hashtable_remove_all (struct t_hashtable *hashtable)
 
     for (i = 0; i < hashtable->size; i++)
     {
-        while (hashtable->htable[i])
-        {
-            hashtable_remove_item (hashtable, hashtable->htable[i], i);
-        }
+        if (hashtable_item_is_used (&hashtable->htable[i]))
+            hashtable_remove_item (hashtable, &hashtable->htable[i]);
     }
+
+    hashtable_shrink (hashtable);
 }
 
 /*
@@ -1284,8 +1471,11 @@ hashtable_print_log (struct t_hashtable *hashtable, const char *name)
     log_printf ("");
     log_printf ("[hashtable %s (addr:0x%lx)]", name, hashtable);
     log_printf ("  size . . . . . . . . . : %d",    hashtable->size);
+    log_printf ("  size_min . . . . . . . : %d",    hashtable->size_min);
     log_printf ("  htable . . . . . . . . : 0x%lx", hashtable->htable);
     log_printf ("  items_count. . . . . . : %d",    hashtable->items_count);
+    log_printf ("  deleted_count. . . . . : %d",    hashtable->deleted_count);
+    log_printf ("  map_running. . . . . . : %d",    hashtable->map_running);
     log_printf ("  type_keys. . . . . . . : %d (%s)",
                 hashtable->type_keys,
                 hashtable_type_string[hashtable->type_keys]);
@@ -1300,11 +1490,11 @@ hashtable_print_log (struct t_hashtable *hashtable, const char *name)
 
     for (i = 0; i < hashtable->size; i++)
     {
-        log_printf ("  htable[%06d] . . . . : 0x%lx", i, hashtable->htable[i]);
-        for (ptr_item = hashtable->htable[i]; ptr_item;
-             ptr_item = ptr_item->next_item)
+        ptr_item = &hashtable->htable[i];
+        if (hashtable_item_is_used (ptr_item))
         {
-            log_printf ("    [item 0x%lx]", hashtable->htable);
+            log_printf ("  htable[%06d] . . . . : 0x%lx", i, ptr_item);
+            log_printf ("      hash . . . . . . . : %llu", ptr_item->hash);
             switch (hashtable->type_keys)
             {
                 case HASHTABLE_INTEGER:
@@ -1347,8 +1537,6 @@ hashtable_print_log (struct t_hashtable *hashtable, const char *name)
                     break;
             }
             log_printf ("      value_size . . . . : %d",    ptr_item->value_size);
-            log_printf ("      prev_item. . . . . : 0x%lx", ptr_item->prev_item);
-            log_printf ("      next_item. . . . . : 0x%lx", ptr_item->next_item);
         }
     }
 }
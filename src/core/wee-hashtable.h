@@ -40,33 +40,40 @@ typedef void (t_hashtable_map_string)(void *data,
                                       const char *key, const char *value);
 
 /*
- * Hashtable is a structure with an array "htable", each entry is a pointer
- * to a linked list, and it is read with hashed key (as unsigned long long).
- * Keys with same hashed key are grouped in a linked list pointed by htable.
- * The htable is not sorted, the linked list is sorted.
+ * Hashtable is a structure with an array "htable" of slots, each slot can
+ * store one item (items are stored inline in the array, there is no linked
+ * list). The position of an item is computed with the hashed key (as
+ * unsigned long long), and if the slot is already used, the next free slot
+ * is used (linear probing).
+ * The hashed key is stored in each item, so that the hash of keys is never
+ * computed again and keys are compared only if the hashes are the same.
+ *
+ * The size of array is always a power of 2. The array grows automatically
+ * when it is more than 3/4 full (including deleted items), and shrinks when
+ * it is less than 1/8 full (but never below the initial size).
  *
  * Example of a hashtable with size 8 and 6 items added inside, items are:
  * "weechat", "fast", "light", "extensible", "chat", "client"
- * Keys "fast" and "light" have same hashed value, so they are together in
- * linked list.
+ * Keys "fast" and "light" have the same position (2), so "light" is stored
+ * in the next slot; same for keys "weechat" and "chat" (position 0).
  *
- * Result is:
+ * Result is (a 7th item would make the array grow to 16 slots):
  * +-----+
- * |   0 |
+ * |   0 | "weechat"
  * +-----+
- * |   1 |
+ * |   1 | "chat"
  * +-----+
- * |   2 | --> "extensible"
+ * |   2 | "fast"
  * +-----+
- * |   3 | --> "fast" --> "light"
+ * |   3 | "light"
  * +-----+
  * |   4 |
  * +-----+
- * |   5 | --> "chat"
+ * |   5 |
  * +-----+
- * |   6 | --> "client"
+ * |   6 | "extensible"
  * +-----+
- * |   7 | --> "weechat"
+ * |   7 | "client"
  * +-----+
  */
 
@@ -81,22 +88,28 @@ enum t_hashtable_type
     HASHTABLE_NUM_TYPES,
 };
 
+/* min size of hashtable (number of slots) */
+#define HASHTABLE_MIN_SIZE 4
+
 struct t_hashtable_item
 {
-    void *key;                          /* item key                         */
+    void *key;                          /* item key (NULL = free slot)      */
     int key_size;                       /* size of key (in bytes)           */
     void *value;                        /* pointer to value                 */
     int value_size;                     /* size of value (in bytes)         */
-    struct t_hashtable_item *prev_item; /* link to previous item            */
-    struct t_hashtable_item *next_item; /* link to next item                */
+    unsigned long long hash;            /* hashed key                       */
 };
 
 struct t_hashtable
 {
-    int size;                          /* hashtable size                    */
-    struct t_hashtable_item **htable;  /* table to map hashes with linked   */
-                                       /* lists                             */
+    int size;                          /* hashtable size (number of slots,  */
+                                       /* always a power of 2)              */
+    int size_min;                      /* initial size (min size)           */
+    struct t_hashtable_item *htable;   /* slots with items                  */
     int items_count;                   /* number of items in hashtable      */
+    int deleted_count;                 /* number of slots with deleted item */
+    int map_running;                   /* > 0 if hashtable_map is running   */
+                                       /* (then hashtable is not resized)   */
 
     /* type for keys and values */
     enum t_hashtable_type type_keys;   /* type for keys: int/str/pointer    */
@@ -114,6 +127,7 @@ struct t_hashtable
 };
 
 extern unsigned long long hashtable_hash_key_djb2 (const char *string);
+extern int hashtable_item_is_used (struct t_hashtable_item *item);
 extern struct t_hashtable *hashtable_new (int size,
                                           const char *type_keys,
                                           const char *type_values,
@@ -127,6 +127,7 @@ hdata_new (struct t_weechat_plugin *plugin, const char *hdata_name,
                                               NULL,
                                               NULL);
         new_hdata->hash_list->callback_free_value = &hdata_free_list;
+        new_hdata->hash_pointers = NULL;
         hashtable_set (weechat_hdata, hdata_name, new_hdata);
         new_hdata->create_allowed = create_allowed;
         new_hdata->delete_allowed = delete_allowed;
@@ -186,6 +187,25 @@ hdata_new_list (struct t_hdata *hdata, const char *name, void *pointer,
     }
 }
 
+/*
+ * Sets the registry of pointers in a hdata: a hashtable (keys are pointers)
+ * with all objects of this hdata, maintained by the code which creates and
+ * frees the objects. The hashtable itself can be created later or freed
+ * (then pointer is NULL): the registry is not used in this case.
+ *
+ * All objects in registry must be in all lists with flag "check_pointers",
+ * so that hdata_check_pointer can use the registry instead of walking lists.
+ */
+
+void
+hdata_new_pointers (struct t_hdata *hdata, struct t_hashtable **pointers)
+{
+    if (!hdata)
+        return;
+
+    hdata->hash_pointers = pointers;
+}
+
 /*
  * Gets offset of variable in hdata.
  */
@@ -503,6 +523,33 @@ hdata_check_pointer_map_cb (void *data, struct t_hashtable *hashtable,
     (*num_lists)++;
 }
 
+/*
+ * Checks if a list is a list of hdata with flag "check_pointers" (callback
+ * called for each list in hdata).
+ */
+
+void
+hdata_check_pointer_list_map_cb (void *data, struct t_hashtable *hashtable,
+                                 const void *key, const void *value)
+{
+    void **pointers;
+    struct t_hdata_list *ptr_list;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    pointers = (void **)data;
+
+    ptr_list = (struct t_hdata_list *)value;
+    if (ptr_list
+        && (ptr_list->flags & WEECHAT_HDATA_LIST_CHECK_POINTERS)
+        && (*((void **)(ptr_list->pointer)) == pointers[0]))
+    {
+        pointers[1] = (void *)1;
+    }
+}
+
 /*
  * Checks if a pointer is valid for a given hdata/list.
  *
@@ -511,6 +558,10 @@ hdata_check_pointer_map_cb (void *data, struct t_hashtable *hashtable,
  * the pointer is considered valid (so this function returns 1); if the
  * pointer is not found in any list, this function returns 0.
  *
+ * If the hdata has a registry of pointers (see hdata_new_pointers), the
+ * registry is used instead of walking lists with flag "check_pointers"
+ * and a pointer not registered is invalid in any list.
+ *
  * Returns:
  *   1: pointer exists in the given list (or a list with check_pointers flag)
  *   0: pointer does not exist
@@ -524,6 +575,25 @@ hdata_check_pointer (struct t_hdata *hdata, void *list, void *pointer)
     if (!hdata || !pointer)
         return 0;
 
+    if (list && (pointer == list))
+        return 1;
+
+    if (hdata->hash_pointers && *(hdata->hash_pointers))
+    {
+        if (!hashtable_has_key (*(hdata->hash_pointers), pointer))
+            return 0;
+        if (!list)
+            return 1;
+        /* registry is enough if list is a list with flag "check_pointers" */
+        pointers[0] = list;
+        pointers[1] = 0;
+        hashtable_map (hdata->hash_list,
+                       &hdata_check_pointer_list_map_cb,
+                       pointers);
+        if (pointers[1])
+            return 1;
+    }
+
     if (list)
     {
         /* search pointer in the given list */
@@ -1291,6 +1361,10 @@ hdata_print_log_map_cb (void *data, struct t_hashtable *hashtable,
     log_printf ("  hash_list. . . . . . . : 0x%lx (hashtable: '%s')",
                 ptr_hdata->hash_list,
                 hashtable_get_string (ptr_hdata->hash_list, "keys_values"));
+    log_printf ("  hash_pointers. . . . . : 0x%lx (items: %d)",
+                ptr_hdata->hash_pointers,
+                (ptr_hdata->hash_pointers && *(ptr_hdata->hash_pointers)) ?
+                (*(ptr_hdata->hash_pointers))->items_count : 0);
     log_printf ("  create_allowed . . . . : %d",    (int)ptr_hdata->create_allowed);
     log_printf ("  delete_allowed . . . . : %d",    (int)ptr_hdata->delete_allowed);
     log_printf ("  callback_update. . . . : 0x%lx", ptr_hdata->callback_update);
@@ -29,6 +29,8 @@
                    __array_size, __hdata_name)
 #define HDATA_LIST(__name, __flags)                                     \
     hdata_new_list (hdata, #__name, &(__name), __flags);
+#define HDATA_POINTERS(__name)                                          \
+    hdata_new_pointers (hdata, &(__name));
 
 struct t_hdata_var
 {
@@ -57,6 +59,10 @@ struct t_hdata
     struct t_hashtable *hash_var;      /* hash with type & offset of vars   */
     struct t_hashtable *hash_list;     /* hashtable with pointers on lists  */
                                        /* (used to search objects)          */
+    struct t_hashtable **hash_pointers; /* pointer to hashtable with all    */
+                                       /* objects (to check pointers        */
+                                       /* without walking lists), NULL if   */
+                                       /* objects are not registered        */
 
     char create_allowed;               /* create allowed?                   */
     char delete_allowed;               /* delete allowed?                   */
@@ -89,6 +95,8 @@ extern void hdata_new_var (struct t_hdata *hdata, const char *name, int offset,
                            const char *hdata_name);
 extern void hdata_new_list (struct t_hdata *hdata, const char *name,
                             void *pointer, int flags);
+extern void hdata_new_pointers (struct t_hdata *hdata,
+                                struct t_hashtable **pointers);
 extern int hdata_get_var_offset (struct t_hdata *hdata, const char *name);
 extern int hdata_get_var_type (struct t_hdata *hdata, const char *name);
 extern const char *hdata_get_var_type_string (struct t_hdata *hdata,
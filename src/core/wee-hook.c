@@ -38,9 +38,13 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <errno.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 #include "weechat.h"
 #include "wee-hook.h"
+#include "wee-arraylist.h"
 #include "wee-config.h"
 #include "wee-hashtable.h"
 #include "wee-hdata.h"
@@ -73,17 +77,37 @@ struct t_hook *last_weechat_hook[HOOK_NUM_TYPES]; /* last hook              */
 int hooks_count[HOOK_NUM_TYPES];                  /* number of hooks        */
 int hooks_count_total = 0;                        /* total number of hooks  */
 int hook_exec_recursion = 0;           /* 1 when a hook is executed         */
-time_t hook_last_system_time = 0;      /* used to detect system clock skew  */
+long long hook_timer_clock_offset = 0; /* system clock - monotonic clock   */
+                                       /* (used to detect system clock skew)*/
+struct t_hook **hook_timer_heap = NULL; /* timers sorted by next execution  */
+                                       /* (binary min-heap)                 */
+int hook_timer_heap_size = 0;          /* size of heap (allocated)          */
+int hook_timer_heap_count = 0;         /* number of timers in heap          */
+int hook_modifier_print_count = 0;     /* number of "weechat_print"         */
+                                       /* modifiers (not deleted)           */
 int real_delete_pending = 0;           /* 1 if some hooks must be deleted   */
 
 struct pollfd *hook_fd_pollfd = NULL;  /* file descriptors for poll()       */
 int hook_fd_pollfd_count = 0;          /* number of file descriptors        */
+struct t_hashtable *hook_fd_index = NULL; /* fd hooks by file descriptor    */
+int hook_fd_epoll = -1;                /* epoll fd (-1 if poll() is used)   */
+unsigned int hook_fd_epoll_last_id = 0; /* last id of fd added in epoll     */
+int hook_fd_epoll_not_added = 0;       /* number of fd hooks not in epoll   */
+                                       /* (always ready, like with poll())  */
+int hook_fd_epoll_rebuild = 0;         /* 1 if epoll set must be rebuilt    */
+int hook_process_sigchld_pipe[2] = { -1, -1 }; /* pipe written on SIGCHLD */
+struct t_hook *hook_process_sigchld_hook_fd = NULL; /* fd hook on this pipe */
 int hook_process_pending = 0;          /* 1 if there are some process to    */
                                        /* run (via fork)                    */
-int hook_socketpair_ok = 0;            /* 1 if socketpair() is OK           */
+
+struct t_hashtable *hook_signal_index_exact = NULL; /* signals: exact names */
+struct t_hook_signal_node *hook_signal_index_prefix = NULL; /* "name*"      */
+struct t_arraylist *hook_signal_index_masks = NULL; /* other signal masks   */
+unsigned long long hook_signal_sequence = 0; /* creation order of signals   */
 
 
 void hook_process_run (struct t_hook *hook_process);
+long long hook_timer_get_clock_offset ();
 
 
 /*
@@ -93,7 +117,7 @@ void hook_process_run (struct t_hook *hook_process);
 void
 hook_init ()
 {
-    int type, sock[2], rc;
+    int type;
 
     /* initialize list of hooks */
     for (type = 0; type < HOOK_NUM_TYPES; type++)
@@ -103,42 +127,12 @@ hook_init ()
         hooks_count[type] = 0;
     }
     hooks_count_total = 0;
-    hook_last_system_time = time (NULL);
+    hook_timer_clock_offset = hook_timer_get_clock_offset ();
 
-    /*
-     * Set a flag to 0 if socketpair() function is not available.
-     *
-     * For the connect hook, when this is defined an array of sockets will
-     * be passed from the parent process to the child process instead of using
-     * SCM_RIGHTS to pass a socket back from the child process to parent
-     * process.
-     *
-     * This allows connections to work on Windows but it limits the number of
-     * IPs that can be attempted each time.
-     */
-    hook_socketpair_ok = 1;
 
-#if defined(__CYGWIN__) || defined(__APPLE__) || defined(__MACH__)
-    hook_socketpair_ok = 0;
-    (void) sock;
-    (void) rc;
-#else
-    /*
-     * Test if socketpair() function is working fine: this is NOT the case
-     * on Windows with Ubuntu bash
-     * (errno == 94: ESOCKTNOSUPPORT: socket type not supported)
-     */
-    rc = socketpair (AF_LOCAL, SOCK_DGRAM, 0, sock);
-    if (rc < 0)
-    {
-        /* Windows/Ubuntu */
-        hook_socketpair_ok = 0;
-    }
-    else
-    {
-        close (sock[0]);
-        close (sock[1]);
-    }
+    /* use epoll for fd hooks if available (poll() is used otherwise) */
+#ifdef HAVE_SYS_EPOLL_H
+    hook_fd_epoll = epoll_create1 (EPOLL_CLOEXEC);
 #endif
 }
 
@@ -1059,8 +1053,13 @@ hook_timer_init (struct t_hook *hook)
     time_t time_now;
     struct tm *local_time, *gm_time;
     int local_hour, gm_hour, diff_hour;
+    struct timeval tv_now;
+    long long time_monotonic;
 
-    gettimeofday (&HOOK_TIMER(hook, last_exec), NULL);
+    gettimeofday (&tv_now, NULL);
+    time_monotonic = util_get_time_monotonic ();
+    HOOK_TIMER(hook, last_exec).tv_sec = tv_now.tv_sec;
+    HOOK_TIMER(hook, last_exec).tv_usec = tv_now.tv_usec;
     time_now = time (NULL);
     local_time = localtime (&time_now);
     local_hour = local_time->tm_hour;
@@ -1103,6 +1102,170 @@ hook_timer_init (struct t_hook *hook)
     /* add interval to next call date */
     util_timeval_add (&HOOK_TIMER(hook, next_exec),
                       ((long long)HOOK_TIMER(hook, interval)) * 1000);
+
+    /* same date with monotonic clock */
+    HOOK_TIMER(hook, next_exec_monotonic) = time_monotonic +
+        util_timeval_diff (&tv_now, &HOOK_TIMER(hook, next_exec));
+}
+
+/*
+ * Compares next execution of two timers in heap.
+ *
+ * Returns 1 if timer at index1 must be executed before timer at index2,
+ * otherwise 0.
+ */
+
+int
+hook_timer_heap_less (int index1, int index2)
+{
+    return (HOOK_TIMER(hook_timer_heap[index1], next_exec_monotonic) <
+            HOOK_TIMER(hook_timer_heap[index2], next_exec_monotonic)) ? 1 : 0;
+}
+
+/*
+ * Swaps two timers in heap.
+ */
+
+void
+hook_timer_heap_swap (int index1, int index2)
+{
+    struct t_hook *ptr_hook;
+
+    ptr_hook = hook_timer_heap[index1];
+    hook_timer_heap[index1] = hook_timer_heap[index2];
+    hook_timer_heap[index2] = ptr_hook;
+    HOOK_TIMER(hook_timer_heap[index1], heap_index) = index1;
+    HOOK_TIMER(hook_timer_heap[index2], heap_index) = index2;
+}
+
+/*
+ * Moves a timer up in heap (when its next execution is earlier than its
+ * parent).
+ */
+
+void
+hook_timer_heap_sift_up (int index)
+{
+    int parent;
+
+    while (index > 0)
+    {
+        parent = (index - 1) / 2;
+        if (!hook_timer_heap_less (index, parent))
+            break;
+        hook_timer_heap_swap (index, parent);
+        index = parent;
+    }
+}
+
+/*
+ * Moves a timer down in heap (when its next execution is later than one of
+ * its children).
+ */
+
+void
+hook_timer_heap_sift_down (int index)
+{
+    int child, smallest;
+
+    while (1)
+    {
+        smallest = index;
+        child = (2 * index) + 1;
+        if ((child < hook_timer_heap_count)
+            && hook_timer_heap_less (child, smallest))
+        {
+            smallest = child;
+        }
+        child++;
+        if ((child < hook_timer_heap_count)
+            && hook_timer_heap_less (child, smallest))
+        {
+            smallest = child;
+        }
+        if (smallest == index)
+            break;
+        hook_timer_heap_swap (index, smallest);
+        index = smallest;
+    }
+}
+
+/*
+ * Adds a timer in heap.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (not enough memory)
+ */
+
+int
+hook_timer_heap_add (struct t_hook *hook)
+{
+    struct t_hook **new_heap;
+    int new_size;
+
+    if (hook_timer_heap_count >= hook_timer_heap_size)
+    {
+        new_size = (hook_timer_heap_size > 0) ? hook_timer_heap_size * 2 : 32;
+        new_heap = realloc (hook_timer_heap, new_size * sizeof (*new_heap));
+        if (!new_heap)
+            return 0;
+        hook_timer_heap = new_heap;
+        hook_timer_heap_size = new_size;
+    }
+
+    hook_timer_heap[hook_timer_heap_count] = hook;
+    HOOK_TIMER(hook, heap_index) = hook_timer_heap_count;
+    hook_timer_heap_count++;
+    hook_timer_heap_sift_up (hook_timer_heap_count - 1);
+
+    return 1;
+}
+
+/*
+ * Removes a timer from heap.
+ */
+
+void
+hook_timer_heap_remove (struct t_hook *hook)
+{
+    int index, last;
+
+    index = HOOK_TIMER(hook, heap_index);
+    if ((index < 0) || (index >= hook_timer_heap_count)
+        || (hook_timer_heap[index] != hook))
+    {
+        return;
+    }
+
+    HOOK_TIMER(hook, heap_index) = -1;
+    last = hook_timer_heap_count - 1;
+    hook_timer_heap_count--;
+    if (index != last)
+    {
+        hook_timer_heap[index] = hook_timer_heap[last];
+        HOOK_TIMER(hook_timer_heap[index], heap_index) = index;
+        hook_timer_heap_sift_up (index);
+        hook_timer_heap_sift_down (HOOK_TIMER(hook_timer_heap[index],
+                                              heap_index));
+    }
+}
+
+/*
+ * Moves a timer in heap after a change of its next execution.
+ */
+
+void
+hook_timer_heap_update (struct t_hook *hook)
+{
+    int index;
+
+    index = HOOK_TIMER(hook, heap_index);
+    if ((index < 0) || (index >= hook_timer_heap_count))
+        return;
+
+    hook_timer_heap_sift_up (index);
+    hook_timer_heap_sift_down (HOOK_TIMER(hook, heap_index));
 }
 
 /*
@@ -1141,54 +1304,88 @@ hook_timer (struct t_weechat_plugin *plugin, long interval, int align_second,
     new_hook_timer->interval = interval;
     new_hook_timer->align_second = align_second;
     new_hook_timer->remaining_calls = max_calls;
+    new_hook_timer->heap_index = -1;
 
     hook_timer_init (new_hook);
 
+    if (!hook_timer_heap_add (new_hook))
+    {
+        free (new_hook_timer);
+        free (new_hook);
+        return NULL;
+    }
+
     hook_add_to_list (new_hook);
 
     return new_hook;
 }
 
 /*
- * Checks if system clock is older than previous call to this function (that
- * means new time is lower than in past). If yes, adjusts all timers to current
- * time.
+ * Returns difference between system clock and monotonic clock (in
+ * microseconds).
+ */
+
+long long
+hook_timer_get_clock_offset ()
+{
+    struct timeval tv_now;
+
+    gettimeofday (&tv_now, NULL);
+    return ((((long long)tv_now.tv_sec) * 1000000) + tv_now.tv_usec)
+        - util_get_time_monotonic ();
+}
+
+/*
+ * Checks if system clock has changed since previous call to this function
+ * (difference between system clock and monotonic clock has changed).
+ * If yes, reinitializes timers aligned on seconds (they are scheduled with
+ * system clock) and adjusts dates of other timers (they are scheduled with
+ * the monotonic clock, so their next execution does not change).
  */
 
 void
 hook_timer_check_system_clock ()
 {
-    time_t now;
-    long diff_time;
+    long long offset, diff_time;
     struct t_hook *ptr_hook;
 
-    now = time (NULL);
+    offset = hook_timer_get_clock_offset ();
 
     /*
-     * check if difference with previous time is more than 10 seconds:
-     * if it is, then consider it's clock skew and reinitialize all timers
+     * check if difference with previous offset is at least one second:
+     * if it is, then the system clock has been changed
      */
-    diff_time = now - hook_last_system_time;
-    if ((diff_time <= -10) || (diff_time >= 10))
+    diff_time = offset - hook_timer_clock_offset;
+    if ((diff_time <= -1000000) || (diff_time >= 1000000))
     {
         if (weechat_debug_core >= 1)
         {
             gui_chat_printf (NULL,
                              _("System clock skew detected (%+ld seconds), "
                                "reinitializing all timers"),
-                             diff_time);
+                             (long)(diff_time / 1000000));
         }
 
-        /* reinitialize all timers */
         for (ptr_hook = weechat_hooks[HOOK_TYPE_TIMER]; ptr_hook;
              ptr_hook = ptr_hook->next_hook)
         {
-            if (!ptr_hook->deleted)
+            if (ptr_hook->deleted)
+                continue;
+            if ((HOOK_TIMER(ptr_hook, interval) >= 1000)
+                && (HOOK_TIMER(ptr_hook, align_second) > 0))
+            {
                 hook_timer_init (ptr_hook);
+                hook_timer_heap_update (ptr_hook);
+            }
+            else
+            {
+                util_timeval_add (&HOOK_TIMER(ptr_hook, last_exec), diff_time);
+                util_timeval_add (&HOOK_TIMER(ptr_hook, next_exec), diff_time);
+            }
         }
     }
 
-    hook_last_system_time = now;
+    hook_timer_clock_offset = offset;
 }
 
 /*
@@ -1198,136 +1395,169 @@ hook_timer_check_system_clock ()
 int
 hook_timer_get_time_to_next ()
 {
-    struct t_hook *ptr_hook;
-    int found, timeout;
-    struct timeval tv_now, tv_timeout;
-    long diff_usec;
+    long long diff_usec;
 
     hook_timer_check_system_clock ();
 
-    found = 0;
-    tv_timeout.tv_sec = 0;
-    tv_timeout.tv_usec = 0;
-
-    for (ptr_hook = weechat_hooks[HOOK_TYPE_TIMER]; ptr_hook;
-         ptr_hook = ptr_hook->next_hook)
-    {
-        if (!ptr_hook->deleted
-            && (!found
-                || (util_timeval_cmp (&HOOK_TIMER(ptr_hook, next_exec),
-                                      &tv_timeout) < 0)))
-        {
-            found = 1;
-            tv_timeout.tv_sec = HOOK_TIMER(ptr_hook, next_exec).tv_sec;
-            tv_timeout.tv_usec = HOOK_TIMER(ptr_hook, next_exec).tv_usec;
-        }
-    }
-
     /* no timeout found, return 2 seconds by default */
-    if (!found)
-    {
-        tv_timeout.tv_sec = 2;
-        tv_timeout.tv_usec = 0;
-        goto end;
-    }
+    if (hook_timer_heap_count == 0)
+        return 2000;
 
-    gettimeofday (&tv_now, NULL);
+    diff_usec = HOOK_TIMER(hook_timer_heap[0], next_exec_monotonic)
+        - util_get_time_monotonic ();
 
     /* next timeout is past date! */
-    if (util_timeval_cmp (&tv_timeout, &tv_now) < 0)
-    {
-        tv_timeout.tv_sec = 0;
-        tv_timeout.tv_usec = 0;
-        goto end;
-    }
-
-    tv_timeout.tv_sec = tv_timeout.tv_sec - tv_now.tv_sec;
-    diff_usec = tv_timeout.tv_usec - tv_now.tv_usec;
-    if (diff_usec >= 0)
-    {
-        tv_timeout.tv_usec = diff_usec;
-    }
-    else
-    {
-        tv_timeout.tv_sec--;
-        tv_timeout.tv_usec = 1000000 + diff_usec;
-    }
+    if (diff_usec < 1000)
+        return 1;
 
     /*
-     * to detect clock skew, we ensure there's a call to timers every
-     * 2 seconds max
+     * to detect changes of system clock (for timers aligned on seconds),
+     * we ensure there's a call to timers every 2 seconds max
      */
-    if (tv_timeout.tv_sec >= 2)
-    {
-        tv_timeout.tv_sec = 2;
-        tv_timeout.tv_usec = 0;
-    }
+    if (diff_usec >= 2000000)
+        return 2000;
 
-end:
-    /* return a number of milliseconds */
-    timeout = (tv_timeout.tv_sec * 1000) + (tv_timeout.tv_usec / 1000);
-    return (timeout < 1) ? 1 : timeout;
+    return (int)(diff_usec / 1000);
 }
 
 /*
  * Executes timer hooks.
+ *
+ * The timers to execute are first removed from heap, so that each timer is
+ * executed at most once by call to this function (even if its next
+ * execution is already past).
  */
 
 void
 hook_timer_exec ()
 {
     struct timeval tv_time;
-    struct t_hook *ptr_hook, *next_hook;
+    long long time_monotonic;
+    struct t_hook *ptr_hook, **timers, **new_timers;
+    int i, num_timers, size_timers;
 
     hook_timer_check_system_clock ();
 
+    if (hook_timer_heap_count == 0)
+        return;
+
     gettimeofday (&tv_time, NULL);
+    time_monotonic = util_get_time_monotonic ();
+
+    /* remove timers to execute from heap (sorted by next execution) */
+    timers = NULL;
+    num_timers = 0;
+    size_timers = 0;
+    while ((hook_timer_heap_count > 0)
+           && (HOOK_TIMER(hook_timer_heap[0], next_exec_monotonic) <=
+               time_monotonic))
+    {
+        if (num_timers >= size_timers)
+        {
+            size_timers = (size_timers > 0) ? size_timers * 2 : 16;
+            new_timers = realloc (timers, size_timers * sizeof (*new_timers));
+            if (!new_timers)
+                break;
+            timers = new_timers;
+        }
+        timers[num_timers++] = hook_timer_heap[0];
+        hook_timer_heap_remove (hook_timer_heap[0]);
+    }
+
+    if (num_timers == 0)
+    {
+        if (timers)
+            free (timers);
+        return;
+    }
 
     hook_exec_start ();
 
-    ptr_hook = weechat_hooks[HOOK_TYPE_TIMER];
-    while (ptr_hook)
+    for (i = 0; i < num_timers; i++)
     {
-        next_hook = ptr_hook->next_hook;
+        ptr_hook = timers[i];
 
-        if (!ptr_hook->deleted
-            && !ptr_hook->running
-            && (util_timeval_cmp (&HOOK_TIMER(ptr_hook, next_exec),
-                                  &tv_time) <= 0))
+        /* timer removed by a previous callback? */
+        if (ptr_hook->deleted)
+            continue;
+
+        ptr_hook->running = 1;
+        (void) (HOOK_TIMER(ptr_hook, callback))
+            (ptr_hook->callback_pointer,
+             ptr_hook->callback_data,
+             (HOOK_TIMER(ptr_hook, remaining_calls) > 0) ?
+              HOOK_TIMER(ptr_hook, remaining_calls) - 1 : -1);
+        ptr_hook->running = 0;
+        if (!ptr_hook->deleted)
         {
-            ptr_hook->running = 1;
-            (void) (HOOK_TIMER(ptr_hook, callback))
-                (ptr_hook->callback_pointer,
-                 ptr_hook->callback_data,
-                 (HOOK_TIMER(ptr_hook, remaining_calls) > 0) ?
-                  HOOK_TIMER(ptr_hook, remaining_calls) - 1 : -1);
-            ptr_hook->running = 0;
-            if (!ptr_hook->deleted)
+            HOOK_TIMER(ptr_hook, last_exec).tv_sec = tv_time.tv_sec;
+            HOOK_TIMER(ptr_hook, last_exec).tv_usec = tv_time.tv_usec;
+
+            util_timeval_add (
+                &HOOK_TIMER(ptr_hook, next_exec),
+                ((long long)HOOK_TIMER(ptr_hook, interval)) * 1000);
+            if ((HOOK_TIMER(ptr_hook, interval) >= 1000)
+                && (HOOK_TIMER(ptr_hook, align_second) > 0))
+            {
+                /* keep timer aligned on seconds of system clock */
+                HOOK_TIMER(ptr_hook, next_exec_monotonic) = time_monotonic +
+                    util_timeval_diff (&tv_time,
+                                       &HOOK_TIMER(ptr_hook, next_exec));
+            }
+            else
             {
-                HOOK_TIMER(ptr_hook, last_exec).tv_sec = tv_time.tv_sec;
-                HOOK_TIMER(ptr_hook, last_exec).tv_usec = tv_time.tv_usec;
+                HOOK_TIMER(ptr_hook, next_exec_monotonic) +=
+                    ((long long)HOOK_TIMER(ptr_hook, interval)) * 1000;
+            }
 
-                util_timeval_add (
-                    &HOOK_TIMER(ptr_hook, next_exec),
-                    ((long long)HOOK_TIMER(ptr_hook, interval)) * 1000);
+            /*
+             * timer still late after one interval (for example after a
+             * suspend of system, which is not seen as a clock skew with
+             * a boot time clock): schedule it again from now, so that it
+             * is not executed many times in a row to catch up
+             */
+            if (HOOK_TIMER(ptr_hook, next_exec_monotonic) <= time_monotonic)
+            {
+                if ((HOOK_TIMER(ptr_hook, interval) >= 1000)
+                    && (HOOK_TIMER(ptr_hook, align_second) > 0))
+                {
+                    hook_timer_init (ptr_hook);
+                }
+                else
+                {
+                    HOOK_TIMER(ptr_hook, next_exec).tv_sec = tv_time.tv_sec;
+                    HOOK_TIMER(ptr_hook, next_exec).tv_usec = tv_time.tv_usec;
+                    util_timeval_add (
+                        &HOOK_TIMER(ptr_hook, next_exec),
+                        ((long long)HOOK_TIMER(ptr_hook, interval)) * 1000);
+                    HOOK_TIMER(ptr_hook, next_exec_monotonic) =
+                        time_monotonic +
+                        ((long long)HOOK_TIMER(ptr_hook, interval)) * 1000;
+                }
+            }
 
-                if (HOOK_TIMER(ptr_hook, remaining_calls) > 0)
+            if (HOOK_TIMER(ptr_hook, remaining_calls) > 0)
+            {
+                HOOK_TIMER(ptr_hook, remaining_calls)--;
+                if (HOOK_TIMER(ptr_hook, remaining_calls) == 0)
                 {
-                    HOOK_TIMER(ptr_hook, remaining_calls)--;
-                    if (HOOK_TIMER(ptr_hook, remaining_calls) == 0)
-                        unhook (ptr_hook);
+                    unhook (ptr_hook);
+                    continue;
                 }
             }
-        }
 
-        ptr_hook = next_hook;
+            if (!hook_timer_heap_add (ptr_hook))
+                unhook (ptr_hook);
+        }
     }
 
     hook_exec_end ();
+
+    free (timers);
 }
 
 /*
- * Searches for a fd hook in list.
+ * Searches for a fd hook.
  *
  * Returns pointer to hook found, NULL if not found.
  */
@@ -1335,81 +1565,269 @@ hook_timer_exec ()
 struct t_hook *
 hook_search_fd (int fd)
 {
-    struct t_hook *ptr_hook;
+    if (!hook_fd_index)
+        return NULL;
 
-    for (ptr_hook = weechat_hooks[HOOK_TYPE_FD]; ptr_hook;
-         ptr_hook = ptr_hook->next_hook)
-    {
-        if (!ptr_hook->deleted && (HOOK_FD(ptr_hook, fd) == fd))
-            return ptr_hook;
-    }
+    return hashtable_get (hook_fd_index, &fd);
+}
 
-    /* fd hook not found */
-    return NULL;
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ * Builds the epoll event for a fd hook (using flags of hook).
+ */
+
+void
+hook_fd_epoll_build_event (struct t_hook *hook, unsigned int epoll_id,
+                           struct epoll_event *event)
+{
+    memset (event, 0, sizeof (*event));
+    if (HOOK_FD(hook, flags) & HOOK_FD_FLAG_READ)
+        event->events |= EPOLLIN;
+    if (HOOK_FD(hook, flags) & HOOK_FD_FLAG_WRITE)
+        event->events |= EPOLLOUT;
+    event->data.u64 = ((uint64_t)epoll_id << 32)
+        | (uint32_t)HOOK_FD(hook, fd);
 }
+#endif /* HAVE_SYS_EPOLL_H */
 
 /*
- * Hooks a fd event.
+ * Adds an epoll event for a fd hook.
  *
- * Returns pointer to new hook, NULL if error.
+ * If the file descriptor can not be watched by epoll (for example a regular
+ * file), it is considered as always ready, like with poll().
  */
 
-struct t_hook *
-hook_fd (struct t_weechat_plugin *plugin, int fd, int flag_read,
-         int flag_write, int flag_exception,
-         t_hook_callback_fd *callback,
-         const void *callback_pointer,
-         void *callback_data)
+void
+hook_fd_epoll_add (struct t_hook *hook)
 {
-    struct t_hook *new_hook;
-    struct t_hook_fd *new_hook_fd;
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event event;
 
-    if ((fd < 0) || hook_search_fd (fd) || !callback)
-        return NULL;
+    HOOK_FD(hook, epoll_id) = 0;
 
-    new_hook = malloc (sizeof (*new_hook));
-    if (!new_hook)
-        return NULL;
-    new_hook_fd = malloc (sizeof (*new_hook_fd));
-    if (!new_hook_fd)
-    {
-        free (new_hook);
-        return NULL;
-    }
+    if (hook_fd_epoll < 0)
+        return;
 
-    hook_init_data (new_hook, plugin, HOOK_TYPE_FD, HOOK_PRIORITY_DEFAULT,
-                    callback_pointer, callback_data);
+    hook_fd_epoll_last_id++;
+    if (hook_fd_epoll_last_id == 0)
+        hook_fd_epoll_last_id++;
 
-    new_hook->hook_data = new_hook_fd;
-    new_hook_fd->callback = callback;
-    new_hook_fd->fd = fd;
-    new_hook_fd->flags = 0;
-    new_hook_fd->error = 0;
-    if (flag_read)
-        new_hook_fd->flags |= HOOK_FD_FLAG_READ;
-    if (flag_write)
-        new_hook_fd->flags |= HOOK_FD_FLAG_WRITE;
-    if (flag_exception)
-        new_hook_fd->flags |= HOOK_FD_FLAG_EXCEPTION;
+    hook_fd_epoll_build_event (hook, hook_fd_epoll_last_id, &event);
 
-    hook_add_to_list (new_hook);
+    if ((epoll_ctl (hook_fd_epoll, EPOLL_CTL_ADD, HOOK_FD(hook, fd),
+                    &event) == 0)
+        || ((errno == EEXIST)
+            && (epoll_ctl (hook_fd_epoll, EPOLL_CTL_MOD, HOOK_FD(hook, fd),
+                           &event) == 0)))
+    {
+        HOOK_FD(hook, epoll_id) = hook_fd_epoll_last_id;
+        return;
+    }
 
-    return new_hook;
+    if (errno == EBADF)
+    {
+        if (HOOK_FD(hook, error) == 0)
+        {
+            HOOK_FD(hook, error) = errno;
+            gui_chat_printf (NULL,
+                             _("%sError: bad file descriptor (%d) "
+                               "used in hook_fd"),
+                             gui_chat_prefix[GUI_CHAT_PREFIX_ERROR],
+                             HOOK_FD(hook, fd));
+        }
+        return;
+    }
+
+    hook_fd_epoll_not_added++;
+#else
+    /* make C compiler happy */
+    (void) hook;
+#endif
 }
 
 /*
- * Executes fd hooks:
- * - poll() on fie descriptors
- * - call of hook fd callbacks if needed.
+ * Removes epoll event of a fd hook.
  */
 
 void
-hook_fd_exec ()
+hook_fd_epoll_remove (struct t_hook *hook)
 {
-    int i, num_fd, timeout, ready, found;
-    struct t_hook *ptr_hook, *next_hook;
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event event;
 
-    /* build an array of "struct pollfd" for poll() */
+    if (hook_fd_epoll < 0)
+        return;
+
+    if (HOOK_FD(hook, epoll_id) > 0)
+    {
+        /*
+         * if the fd is already closed, this fails: the event is then
+         * automatically removed by kernel, or it will be detected as stale
+         * in hook_fd_exec
+         */
+        memset (&event, 0, sizeof (event));
+        (void) epoll_ctl (hook_fd_epoll, EPOLL_CTL_DEL, HOOK_FD(hook, fd),
+                          &event);
+        HOOK_FD(hook, epoll_id) = 0;
+    }
+    else if (HOOK_FD(hook, error) == 0)
+    {
+        hook_fd_epoll_not_added--;
+    }
+#else
+    /* make C compiler happy */
+    (void) hook;
+#endif
+}
+
+/*
+ * Rebuilds the epoll set with all fd hooks.
+ *
+ * This is done when an event is received for a file descriptor which is not
+ * hooked any more (fd closed before unhook while still opened in another
+ * process, so the event could not be removed).
+ */
+
+void
+hook_fd_epoll_rebuild_set ()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct t_hook *ptr_hook;
+
+    hook_fd_epoll_rebuild = 0;
+
+    if (hook_fd_epoll >= 0)
+        close (hook_fd_epoll);
+    hook_fd_epoll = epoll_create1 (EPOLL_CLOEXEC);
+    hook_fd_epoll_not_added = 0;
+
+    for (ptr_hook = weechat_hooks[HOOK_TYPE_FD]; ptr_hook;
+         ptr_hook = ptr_hook->next_hook)
+    {
+        if (!ptr_hook->deleted && (HOOK_FD(ptr_hook, error) == 0))
+            hook_fd_epoll_add (ptr_hook);
+    }
+#endif
+}
+
+/*
+ * Sets flags of a fd hook (HOOK_FD_FLAG_READ, HOOK_FD_FLAG_WRITE,
+ * HOOK_FD_FLAG_EXCEPTION).
+ */
+
+void
+hook_fd_set_flags (struct t_hook *hook, int flags)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event event;
+#endif
+
+    if (!hook || hook->deleted || (hook->type != HOOK_TYPE_FD))
+        return;
+
+    HOOK_FD(hook, flags) = flags;
+
+#ifdef HAVE_SYS_EPOLL_H
+    if ((hook_fd_epoll >= 0) && (HOOK_FD(hook, epoll_id) > 0))
+    {
+        hook_fd_epoll_build_event (hook, HOOK_FD(hook, epoll_id), &event);
+        (void) epoll_ctl (hook_fd_epoll, EPOLL_CTL_MOD, HOOK_FD(hook, fd),
+                          &event);
+    }
+#endif
+}
+
+/*
+ * Hooks a fd event.
+ *
+ * Returns pointer to new hook, NULL if error.
+ */
+
+struct t_hook *
+hook_fd (struct t_weechat_plugin *plugin, int fd, int flag_read,
+         int flag_write, int flag_exception,
+         t_hook_callback_fd *callback,
+         const void *callback_pointer,
+         void *callback_data)
+{
+    struct t_hook *new_hook;
+    struct t_hook_fd *new_hook_fd;
+
+    if ((fd < 0) || hook_search_fd (fd) || !callback)
+        return NULL;
+
+    if (!hook_fd_index)
+    {
+        hook_fd_index = hashtable_new (32,
+                                       WEECHAT_HASHTABLE_INTEGER,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       NULL, NULL);
+        if (!hook_fd_index)
+            return NULL;
+    }
+
+    new_hook = malloc (sizeof (*new_hook));
+    if (!new_hook)
+        return NULL;
+    new_hook_fd = malloc (sizeof (*new_hook_fd));
+    if (!new_hook_fd)
+    {
+        free (new_hook);
+        return NULL;
+    }
+
+    hook_init_data (new_hook, plugin, HOOK_TYPE_FD, HOOK_PRIORITY_DEFAULT,
+                    callback_pointer, callback_data);
+
+    new_hook->hook_data = new_hook_fd;
+    new_hook_fd->callback = callback;
+    new_hook_fd->fd = fd;
+    new_hook_fd->flags = 0;
+    new_hook_fd->error = 0;
+    new_hook_fd->epoll_id = 0;
+    if (flag_read)
+        new_hook_fd->flags |= HOOK_FD_FLAG_READ;
+    if (flag_write)
+        new_hook_fd->flags |= HOOK_FD_FLAG_WRITE;
+    if (flag_exception)
+        new_hook_fd->flags |= HOOK_FD_FLAG_EXCEPTION;
+
+    hook_add_to_list (new_hook);
+
+    hashtable_set (hook_fd_index, &fd, new_hook);
+    hook_fd_epoll_add (new_hook);
+
+    return new_hook;
+}
+
+/*
+ * Runs callback of a fd hook.
+ */
+
+void
+hook_fd_run (struct t_hook *hook)
+{
+    hook->running = 1;
+    (void) (HOOK_FD(hook, callback)) (
+        hook->callback_pointer,
+        hook->callback_data,
+        HOOK_FD(hook, fd));
+    hook->running = 0;
+}
+
+/*
+ * Executes fd hooks with poll():
+ * - poll() on fie descriptors
+ * - call of hook fd callbacks if needed.
+ */
+
+void
+hook_fd_exec_poll ()
+{
+    int i, num_fd, timeout, ready, found;
+    struct t_hook *ptr_hook, *next_hook;
+
+    /* build an array of "struct pollfd" for poll() */
     num_fd = 0;
     for (ptr_hook = weechat_hooks[HOOK_TYPE_FD]; ptr_hook;
          ptr_hook = ptr_hook->next_hook)
@@ -1478,14 +1896,7 @@ hook_fd_exec ()
                 }
             }
             if (found)
-            {
-                ptr_hook->running = 1;
-                (void) (HOOK_FD(ptr_hook, callback)) (
-                    ptr_hook->callback_pointer,
-                    ptr_hook->callback_data,
-                    HOOK_FD(ptr_hook, fd));
-                ptr_hook->running = 0;
-            }
+                hook_fd_run (ptr_hook);
         }
 
         ptr_hook = next_hook;
@@ -1494,6 +1905,90 @@ hook_fd_exec ()
     hook_exec_end ();
 }
 
+/*
+ * Executes fd hooks with epoll:
+ * - epoll_wait() on the epoll set (file descriptors are added/removed in
+ *   functions hook_fd and unhook)
+ * - call of hook fd callbacks if needed.
+ */
+
+void
+hook_fd_exec_epoll ()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event events[HOOK_FD_EPOLL_MAX_EVENTS];
+    int i, fd, timeout, ready;
+    unsigned int epoll_id;
+    struct t_hook *ptr_hook, *next_hook;
+
+    timeout = hook_timer_get_time_to_next ();
+    if (hook_process_pending || (hook_fd_epoll_not_added > 0))
+        timeout = 0;
+    ready = epoll_wait (hook_fd_epoll, events, HOOK_FD_EPOLL_MAX_EVENTS,
+                        timeout);
+    if ((ready <= 0) && (hook_fd_epoll_not_added == 0))
+        return;
+
+    /* execute callbacks for file descriptors with activity */
+    hook_exec_start ();
+
+    for (i = 0; i < ready; i++)
+    {
+        fd = (int)(events[i].data.u64 & 0xFFFFFFFF);
+        epoll_id = (unsigned int)(events[i].data.u64 >> 32);
+        ptr_hook = hook_search_fd (fd);
+        if (!ptr_hook || (HOOK_FD(ptr_hook, epoll_id) != epoll_id))
+        {
+            /* event for a fd not hooked any more */
+            hook_fd_epoll_rebuild = 1;
+            continue;
+        }
+        if (!ptr_hook->deleted && !ptr_hook->running)
+            hook_fd_run (ptr_hook);
+    }
+
+    /* file descriptors not handled by epoll are always ready */
+    if (hook_fd_epoll_not_added > 0)
+    {
+        ptr_hook = weechat_hooks[HOOK_TYPE_FD];
+        while (ptr_hook)
+        {
+            next_hook = ptr_hook->next_hook;
+
+            if (!ptr_hook->deleted
+                && !ptr_hook->running
+                && (HOOK_FD(ptr_hook, epoll_id) == 0)
+                && (HOOK_FD(ptr_hook, error) == 0)
+                && (HOOK_FD(ptr_hook, flags) & (HOOK_FD_FLAG_READ
+                                                | HOOK_FD_FLAG_WRITE)))
+            {
+                hook_fd_run (ptr_hook);
+            }
+
+            ptr_hook = next_hook;
+        }
+    }
+
+    hook_exec_end ();
+
+    if (hook_fd_epoll_rebuild)
+        hook_fd_epoll_rebuild_set ();
+#endif
+}
+
+/*
+ * Executes fd hooks (with epoll if available, poll() otherwise).
+ */
+
+void
+hook_fd_exec ()
+{
+    if (hook_fd_epoll >= 0)
+        hook_fd_exec_epoll ();
+    else
+        hook_fd_exec_poll ();
+}
+
 /*
  * Hooks a process (using fork) with options in hashtable.
  *
@@ -1644,6 +2139,9 @@ hook_process_child (struct t_hook *hook_process)
     int rc, i, num_args;
     FILE *f;
 
+    /* restore default handler for SIGCHLD (set by WeeChat) */
+    util_catch_signal (SIGCHLD, SIG_DFL);
+
     /* read stdin from parent, if a pipe was defined */
     if (HOOK_PROCESS(hook_process, child_read[HOOK_PROCESS_STDIN]) >= 0)
     {
@@ -1998,14 +2496,54 @@ hook_process_child_read_until_eof (struct t_hook *hook_process)
 }
 
 /*
- * Checks if child process is still alive.
+ * Checks if child process has ended: if so, reads its last output, sends
+ * buffers to callback and removes the hook.
+ */
+
+void
+hook_process_check_child (struct t_hook *hook_process)
+{
+    int status;
+
+    if (hook_process->deleted
+        || (HOOK_PROCESS(hook_process, child_pid) <= 0))
+    {
+        return;
+    }
+
+    if (waitpid (HOOK_PROCESS(hook_process, child_pid),
+                 &status, WNOHANG) > 0)
+    {
+        if (WIFEXITED(status))
+        {
+            /* child terminated normally */
+            HOOK_PROCESS(hook_process, child_pid) = 0;
+            hook_process_child_read_until_eof (hook_process);
+            hook_process_send_buffers (hook_process, WEXITSTATUS(status));
+            unhook (hook_process);
+        }
+        else if (WIFSIGNALED(status))
+        {
+            /* child terminated by a signal */
+            HOOK_PROCESS(hook_process, child_pid) = 0;
+            hook_process_child_read_until_eof (hook_process);
+            hook_process_send_buffers (hook_process,
+                                       WEECHAT_HOOK_PROCESS_ERROR);
+            unhook (hook_process);
+        }
+    }
+}
+
+/*
+ * Callback for timer of process: kills the child process if the timeout is
+ * reached, otherwise checks if child process is still alive (this is done
+ * only if the SIGCHLD handler could not be set up).
  */
 
 int
 hook_process_timer_cb (const void *pointer, void *data, int remaining_calls)
 {
     struct t_hook *hook_process;
-    int status, rc;
 
     /* make C compiler happy */
     (void) data;
@@ -2032,85 +2570,179 @@ hook_process_timer_cb (const void *pointer, void *data, int remaining_calls)
     }
     else
     {
-        if (waitpid (HOOK_PROCESS(hook_process, child_pid),
-                     &status, WNOHANG) > 0)
-        {
-            if (WIFEXITED(status))
-            {
-                /* child terminated normally */
-                rc = WEXITSTATUS(status);
-                hook_process_child_read_until_eof (hook_process);
-                hook_process_send_buffers (hook_process, rc);
-                unhook (hook_process);
-            }
-            else if (WIFSIGNALED(status))
-            {
-                /* child terminated by a signal */
-                hook_process_child_read_until_eof (hook_process);
-                hook_process_send_buffers (hook_process,
-                                           WEECHAT_HOOK_PROCESS_ERROR);
-                unhook (hook_process);
-            }
-        }
+        hook_process_check_child (hook_process);
     }
 
     return WEECHAT_RC_OK;
 }
 
 /*
- * Executes process command in child, and read data in current process,
- * with fd hook.
+ * Handler for system signal SIGCHLD: writes a byte in the pipe watched by
+ * the main loop (only async-signal-safe functions can be called here).
  */
 
 void
-hook_process_run (struct t_hook *hook_process)
+hook_process_sigchld_handler (int signo)
 {
-    int pipes[3][2], timeout, max_calls, rc, i;
-    char str_error[1024];
-    long interval;
-    pid_t pid;
+    int saved_errno;
+    ssize_t num_written;
 
-    for (i = 0; i < 3; i++)
-    {
-        pipes[i][0] = -1;
-        pipes[i][1] = -1;
-    }
+    /* make C compiler happy */
+    (void) signo;
 
-    /* create pipe for stdin (only if stdin was given in options) */
-    if (HOOK_PROCESS(hook_process, options)
-        && hashtable_has_key (HOOK_PROCESS(hook_process, options), "stdin"))
-    {
-        if (pipe (pipes[HOOK_PROCESS_STDIN]) < 0)
-            goto error;
-    }
+    saved_errno = errno;
+    num_written = write (hook_process_sigchld_pipe[1], "c", 1);
+    (void) num_written;
+    errno = saved_errno;
+}
 
-    /* create pipes for stdout/err (if not running in detached mode) */
-    if (!HOOK_PROCESS(hook_process, detached))
+/*
+ * Callback for pipe written by SIGCHLD handler: checks all child processes
+ * and completes the ones which have ended.
+ */
+
+int
+hook_process_sigchld_cb (const void *pointer, void *data, int fd)
+{
+    char buffer[256];
+    struct t_hook *ptr_hook, *next_hook;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+
+    /* empty the pipe (many signals may have been received) */
+    while (read (fd, buffer, sizeof (buffer)) > 0)
     {
-        if (pipe (pipes[HOOK_PROCESS_STDOUT]) < 0)
-            goto error;
-        if (pipe (pipes[HOOK_PROCESS_STDERR]) < 0)
-            goto error;
     }
 
-    /* assign pipes to variables in hook */
-    for (i = 0; i < 3; i++)
+    hook_exec_start ();
+
+    ptr_hook = weechat_hooks[HOOK_TYPE_PROCESS];
+    while (ptr_hook)
     {
-        HOOK_PROCESS(hook_process, child_read[i]) = pipes[i][0];
-        HOOK_PROCESS(hook_process, child_write[i]) = pipes[i][1];
+        next_hook = ptr_hook->next_hook;
+        hook_process_check_child (ptr_hook);
+        ptr_hook = next_hook;
     }
 
-    /* fork */
-    switch (pid = fork ())
-    {
-        /* fork failed */
-        case -1:
-            snprintf (str_error, sizeof (str_error),
-                      "fork error: %s",
-                      strerror (errno));
-            (void) (HOOK_PROCESS(hook_process, callback))
-                (hook_process->callback_pointer,
-                 hook_process->callback_data,
+    hook_exec_end ();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Initializes the handler for signal SIGCHLD: the handler writes in a pipe
+ * which is watched by a fd hook, so that child processes are completed as
+ * soon as they exit, by the main loop.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (the child processes must be checked with a timer)
+ */
+
+int
+hook_process_sigchld_init ()
+{
+    struct sigaction act;
+    int i, flags;
+
+    if (hook_process_sigchld_pipe[0] < 0)
+    {
+        if (pipe (hook_process_sigchld_pipe) < 0)
+        {
+            hook_process_sigchld_pipe[0] = -1;
+            hook_process_sigchld_pipe[1] = -1;
+            return 0;
+        }
+        for (i = 0; i < 2; i++)
+        {
+            flags = fcntl (hook_process_sigchld_pipe[i], F_GETFL);
+            fcntl (hook_process_sigchld_pipe[i], F_SETFL, flags | O_NONBLOCK);
+            fcntl (hook_process_sigchld_pipe[i], F_SETFD, FD_CLOEXEC);
+        }
+        sigemptyset (&act.sa_mask);
+        act.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        act.sa_handler = &hook_process_sigchld_handler;
+        if (sigaction (SIGCHLD, &act, NULL) < 0)
+        {
+            close (hook_process_sigchld_pipe[0]);
+            close (hook_process_sigchld_pipe[1]);
+            hook_process_sigchld_pipe[0] = -1;
+            hook_process_sigchld_pipe[1] = -1;
+            return 0;
+        }
+    }
+
+    if (!hook_process_sigchld_hook_fd)
+    {
+        hook_process_sigchld_hook_fd = hook_fd (NULL,
+                                                hook_process_sigchld_pipe[0],
+                                                1, 0, 0,
+                                                &hook_process_sigchld_cb,
+                                                NULL, NULL);
+    }
+
+    return (hook_process_sigchld_hook_fd) ? 1 : 0;
+}
+
+/*
+ * Executes process command in child, and read data in current process,
+ * with fd hook.
+ */
+
+void
+hook_process_run (struct t_hook *hook_process)
+{
+    int pipes[3][2], timeout, max_calls, rc, i, sigchld_ok;
+    char str_error[1024];
+    long interval;
+    pid_t pid;
+
+    /* SIGCHLD handler must be ready before the fork */
+    sigchld_ok = hook_process_sigchld_init ();
+
+    for (i = 0; i < 3; i++)
+    {
+        pipes[i][0] = -1;
+        pipes[i][1] = -1;
+    }
+
+    /* create pipe for stdin (only if stdin was given in options) */
+    if (HOOK_PROCESS(hook_process, options)
+        && hashtable_has_key (HOOK_PROCESS(hook_process, options), "stdin"))
+    {
+        if (pipe (pipes[HOOK_PROCESS_STDIN]) < 0)
+            goto error;
+    }
+
+    /* create pipes for stdout/err (if not running in detached mode) */
+    if (!HOOK_PROCESS(hook_process, detached))
+    {
+        if (pipe (pipes[HOOK_PROCESS_STDOUT]) < 0)
+            goto error;
+        if (pipe (pipes[HOOK_PROCESS_STDERR]) < 0)
+            goto error;
+    }
+
+    /* assign pipes to variables in hook */
+    for (i = 0; i < 3; i++)
+    {
+        HOOK_PROCESS(hook_process, child_read[i]) = pipes[i][0];
+        HOOK_PROCESS(hook_process, child_write[i]) = pipes[i][1];
+    }
+
+    /* fork */
+    switch (pid = fork ())
+    {
+        /* fork failed */
+        case -1:
+            snprintf (str_error, sizeof (str_error),
+                      "fork error: %s",
+                      strerror (errno));
+            (void) (HOOK_PROCESS(hook_process, callback))
+                (hook_process->callback_pointer,
+                 hook_process->callback_data,
                  HOOK_PROCESS(hook_process, command),
                  WEECHAT_HOOK_PROCESS_ERROR,
                  NULL, str_error);
@@ -2165,6 +2797,26 @@ hook_process_run (struct t_hook *hook_process)
     }
 
     timeout = HOOK_PROCESS(hook_process, timeout);
+
+    if (sigchld_ok)
+    {
+        /*
+         * end of child is detected with SIGCHLD, a timer is used only for
+         * the timeout
+         */
+        if (timeout > 0)
+        {
+            HOOK_PROCESS(hook_process, hook_timer) = hook_timer (
+                hook_process->plugin,
+                timeout, 0, 1,
+                &hook_process_timer_cb,
+                hook_process,
+                NULL);
+        }
+        return;
+    }
+
+    /* no SIGCHLD handler: check child process every 100ms */
     interval = 100;
     max_calls = 0;
     if (timeout > 0)
@@ -2240,7 +2892,8 @@ hook_process_exec ()
 }
 
 /*
- * Hooks a connection to a peer (using fork).
+ * Hooks a connection to a peer (the connection is made by the main loop,
+ * without blocking, see network_connect_start).
  *
  * Returns pointer to new hook, NULL if error.
  */
@@ -2299,29 +2952,36 @@ hook_connect (struct t_weechat_plugin *plugin, const char *proxy,
 #endif /* HAVE_GNUTLS */
     new_hook_connect->local_hostname = (local_hostname) ?
         strdup (local_hostname) : NULL;
-    new_hook_connect->child_read = -1;
-    new_hook_connect->child_write = -1;
-    new_hook_connect->child_recv = -1;
-    new_hook_connect->child_send = -1;
-    new_hook_connect->child_pid = 0;
-    new_hook_connect->hook_child_timer = NULL;
+    new_hook_connect->hook_timer = NULL;
+    new_hook_connect->resolve = NULL;
+    new_hook_connect->res_remote = NULL;
+    new_hook_connect->res_local = NULL;
+    new_hook_connect->addresses = NULL;
+    new_hook_connect->num_addresses = 0;
+    new_hook_connect->next_address = 0;
+    new_hook_connect->status = WEECHAT_HOOK_CONNECT_IP_ADDRESS_NOT_FOUND;
+    for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
+    {
+        new_hook_connect->attempt_sock[i] = -1;
+        new_hook_connect->attempt_hook_fd[i] = NULL;
+        new_hook_connect->attempt_address[i] = NULL;
+    }
+    new_hook_connect->hook_attempt_timer = NULL;
+    new_hook_connect->proxy_target_ip = NULL;
+    new_hook_connect->proxy_ip_address = NULL;
     new_hook_connect->hook_fd = NULL;
+    new_hook_connect->proxy_step = 0;
+    new_hook_connect->proxy_sending = 0;
+    new_hook_connect->proxy_buffer_size = 0;
+    new_hook_connect->proxy_buffer_pos = 0;
     new_hook_connect->handshake_hook_fd = NULL;
     new_hook_connect->handshake_hook_timer = NULL;
     new_hook_connect->handshake_fd_flags = 0;
     new_hook_connect->handshake_ip_address = NULL;
-    if (!hook_socketpair_ok)
-    {
-        for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
-        {
-            new_hook_connect->sock_v4[i] = -1;
-            new_hook_connect->sock_v6[i] = -1;
-        }
-    }
 
     hook_add_to_list (new_hook);
 
-    network_connect_with_fork (new_hook);
+    network_connect_start (new_hook);
 
     return new_hook;
 }
@@ -2356,190 +3016,722 @@ hook_connect_gnutls_verify_certificates (gnutls_session_t tls_session)
         }
         ptr_hook = ptr_hook->next_hook;
     }
-
-    return rc;
+
+    return rc;
+}
+#endif /* HAVE_GNUTLS */
+
+/*
+ * Sets certificates.
+ */
+
+#ifdef HAVE_GNUTLS
+int
+hook_connect_gnutls_set_certificates (gnutls_session_t tls_session,
+                                      const gnutls_datum_t *req_ca, int nreq,
+                                      const gnutls_pk_algorithm_t *pk_algos,
+                                      int pk_algos_len,
+#if LIBGNUTLS_VERSION_NUMBER >= 0x020b00 /* 2.11.0 */
+                                      gnutls_retr2_st *answer)
+#else
+                                      gnutls_retr_st *answer)
+#endif /* LIBGNUTLS_VERSION_NUMBER >= 0x020b00 */
+{
+    struct t_hook *ptr_hook;
+    int rc;
+
+    rc = -1;
+    ptr_hook = weechat_hooks[HOOK_TYPE_CONNECT];
+    while (ptr_hook)
+    {
+        /* looking for the right hook using to the gnutls session pointer */
+        if (!ptr_hook->deleted
+            && HOOK_CONNECT(ptr_hook, gnutls_sess)
+            && (*(HOOK_CONNECT(ptr_hook, gnutls_sess)) == tls_session))
+        {
+            rc = (int) (HOOK_CONNECT(ptr_hook, gnutls_cb))
+                (ptr_hook->callback_pointer,
+                 ptr_hook->callback_data,
+                 tls_session, req_ca, nreq,
+                 pk_algos, pk_algos_len, answer,
+                 WEECHAT_HOOK_CONNECT_GNUTLS_CB_SET_CERT);
+            break;
+        }
+        ptr_hook = ptr_hook->next_hook;
+    }
+
+    return rc;
+}
+#endif /* HAVE_GNUTLS */
+
+/*
+ * Hooks a message printed by WeeChat.
+ *
+ * Returns pointer to new hook, NULL if error.
+ */
+
+struct t_hook *
+hook_print (struct t_weechat_plugin *plugin, struct t_gui_buffer *buffer,
+            const char *tags, const char *message, int strip_colors,
+            t_hook_callback_print *callback,
+            const void *callback_pointer,
+            void *callback_data)
+{
+    struct t_hook *new_hook;
+    struct t_hook_print *new_hook_print;
+    char **tags_array;
+    int i;
+
+    if (!callback)
+        return NULL;
+
+    new_hook = malloc (sizeof (*new_hook));
+    if (!new_hook)
+        return NULL;
+    new_hook_print = malloc (sizeof (*new_hook_print));
+    if (!new_hook_print)
+    {
+        free (new_hook);
+        return NULL;
+    }
+
+    hook_init_data (new_hook, plugin, HOOK_TYPE_PRINT, HOOK_PRIORITY_DEFAULT,
+                    callback_pointer, callback_data);
+
+    new_hook->hook_data = new_hook_print;
+    new_hook_print->callback = callback;
+    new_hook_print->buffer = buffer;
+    new_hook_print->tags_count = 0;
+    new_hook_print->tags_array = NULL;
+    if (tags)
+    {
+        tags_array = string_split (tags, ",", 0, 0,
+                                   &new_hook_print->tags_count);
+        if (tags_array)
+        {
+            new_hook_print->tags_array = malloc (new_hook_print->tags_count *
+                                                 sizeof (*new_hook_print->tags_array));
+            if (new_hook_print->tags_array)
+            {
+                for (i = 0; i < new_hook_print->tags_count; i++)
+                {
+                    new_hook_print->tags_array[i] = string_split (tags_array[i],
+                                                                  "+", 0, 0,
+                                                                  NULL);
+                }
+            }
+            string_free_split (tags_array);
+        }
+    }
+    new_hook_print->message = (message) ? strdup (message) : NULL;
+    new_hook_print->strip_colors = strip_colors;
+
+    hook_add_to_list (new_hook);
+
+    return new_hook;
+}
+
+/*
+ * Executes a print hook.
+ */
+
+void
+hook_print_exec (struct t_gui_buffer *buffer, struct t_gui_line *line)
+{
+    struct t_hook *ptr_hook, *next_hook;
+    char *prefix_no_color, *message_no_color;
+
+    if (!line->data->message || !line->data->message[0])
+        return;
+
+    prefix_no_color = (line->data->prefix) ?
+        gui_color_decode (line->data->prefix, NULL) : NULL;
+
+    message_no_color = gui_color_decode (line->data->message, NULL);
+    if (!message_no_color)
+    {
+        if (prefix_no_color)
+            free (prefix_no_color);
+        return;
+    }
+
+    hook_exec_start ();
+
+    ptr_hook = weechat_hooks[HOOK_TYPE_PRINT];
+    while (ptr_hook)
+    {
+        next_hook = ptr_hook->next_hook;
+
+        if (!ptr_hook->deleted
+            && !ptr_hook->running
+            && (!HOOK_PRINT(ptr_hook, buffer)
+                || (buffer == HOOK_PRINT(ptr_hook, buffer)))
+            && (!HOOK_PRINT(ptr_hook, message)
+                || !HOOK_PRINT(ptr_hook, message)[0]
+                || string_strcasestr (prefix_no_color, HOOK_PRINT(ptr_hook, message))
+                || string_strcasestr (message_no_color, HOOK_PRINT(ptr_hook, message))))
+        {
+            /* check if tags match */
+            if (!HOOK_PRINT(ptr_hook, tags_array)
+                || gui_line_match_tags (line->data,
+                                        HOOK_PRINT(ptr_hook, tags_count),
+                                        HOOK_PRINT(ptr_hook, tags_array)))
+            {
+                /* run callback */
+                ptr_hook->running = 1;
+                (void) (HOOK_PRINT(ptr_hook, callback))
+                    (ptr_hook->callback_pointer,
+                     ptr_hook->callback_data, buffer, line->data->date,
+                     line->data->tags_count,
+                     (const char **)line->data->tags_array,
+                     (int)line->data->displayed, (int)line->data->highlight,
+                     (HOOK_PRINT(ptr_hook, strip_colors)) ? prefix_no_color : line->data->prefix,
+                     (HOOK_PRINT(ptr_hook, strip_colors)) ? message_no_color : line->data->message);
+                ptr_hook->running = 0;
+            }
+        }
+
+        ptr_hook = next_hook;
+    }
+
+    if (prefix_no_color)
+        free (prefix_no_color);
+    if (message_no_color)
+        free (message_no_color);
+
+    hook_exec_end ();
+}
+
+/*
+ * Hashes a signal name (case insensitive), for the signal index.
+ */
+
+unsigned long long
+hook_signal_hash_key_cb (struct t_hashtable *hashtable, const void *key)
+{
+    unsigned long long hash;
+    const char *ptr_key;
+    char chr;
+
+    /* make C compiler happy */
+    (void) hashtable;
+
+    hash = 5381;
+    for (ptr_key = (const char *)key; ptr_key[0]; ptr_key++)
+    {
+        chr = ptr_key[0];
+        if ((chr >= 'A') && (chr <= 'Z'))
+            chr += ('a' - 'A');
+        hash ^= (hash << 5) + (hash >> 2) + (int)chr;
+    }
+
+    return hash;
+}
+
+/*
+ * Compares two signal names (case insensitive), for the signal index.
+ */
+
+int
+hook_signal_keycmp_cb (struct t_hashtable *hashtable,
+                       const void *key1, const void *key2)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return string_strcasecmp ((const char *)key1, (const char *)key2);
+}
+
+/*
+ * Compares two signal hooks: same order as in list of hooks (by priority,
+ * then creation order).
+ */
+
+int
+hook_signal_cmp_cb (void *data, struct t_arraylist *arraylist,
+                    void *pointer1, void *pointer2)
+{
+    struct t_hook *hook1, *hook2;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) arraylist;
+
+    hook1 = (struct t_hook *)pointer1;
+    hook2 = (struct t_hook *)pointer2;
+
+    if (hook1->priority != hook2->priority)
+        return (hook1->priority > hook2->priority) ? -1 : 1;
+
+    if (HOOK_SIGNAL(hook1, sequence) != HOOK_SIGNAL(hook2, sequence))
+        return (HOOK_SIGNAL(hook1, sequence) < HOOK_SIGNAL(hook2, sequence)) ?
+            -1 : 1;
+
+    return 0;
+}
+
+/*
+ * Compares two signal hooks (callback for qsort).
+ */
+
+int
+hook_signal_qsort_cmp_cb (const void *hook1, const void *hook2)
+{
+    return hook_signal_cmp_cb (NULL, NULL,
+                               *((struct t_hook **)hook1),
+                               *((struct t_hook **)hook2));
+}
+
+/*
+ * Frees a list of hooks in the exact names index.
+ */
+
+void
+hook_signal_index_free_value_cb (struct t_hashtable *hashtable,
+                                 const void *key, void *value)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    arraylist_free ((struct t_arraylist *)value);
+}
+
+/*
+ * Creates a new list of signal hooks (sorted like list of hooks).
+ */
+
+struct t_arraylist *
+hook_signal_index_list_new ()
+{
+    return arraylist_new (4, 1, 0, &hook_signal_cmp_cb, NULL, NULL, NULL);
+}
+
+/*
+ * Adds a hook in a list of signal hooks (creates the list if needed).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+hook_signal_index_list_add (struct t_arraylist **list, struct t_hook *hook)
+{
+    if (!*list)
+    {
+        *list = hook_signal_index_list_new ();
+        if (!*list)
+            return 0;
+    }
+
+    return (arraylist_add (*list, hook) >= 0) ? 1 : 0;
+}
+
+/*
+ * Removes a hook from a list of signal hooks (the list is freed if it
+ * becomes empty).
+ */
+
+void
+hook_signal_index_list_remove (struct t_arraylist **list, struct t_hook *hook)
+{
+    int index;
+
+    if (!*list)
+        return;
+
+    if (arraylist_search (*list, hook, &index, NULL))
+        arraylist_remove (*list, index);
+
+    if (arraylist_size (*list) == 0)
+    {
+        arraylist_free (*list);
+        *list = NULL;
+    }
+}
+
+/*
+ * Gets the type of a signal mask for the index.
+ *
+ * Returns:
+ *   0: exact name (no wildcard)
+ *   1: prefix: name followed by wildcard(s) ("*" alone is a prefix too),
+ *      length of prefix is stored in *length
+ *   2: any other mask
+ */
+
+int
+hook_signal_index_mask_type (const char *mask, int *length)
+{
+    const char *pos;
+    int i;
+
+    pos = strchr (mask, '*');
+    if (!pos)
+        return 0;
+
+    for (i = 0; pos[i]; i++)
+    {
+        if (pos[i] != '*')
+            return 2;
+    }
+
+    if (length)
+        *length = pos - mask;
+
+    return 1;
+}
+
+/*
+ * Searches a node in the prefix trie.
+ *
+ * If create == 1, the missing nodes are created.
+ *
+ * Returns pointer to node found, NULL if not found.
+ */
+
+struct t_hook_signal_node *
+hook_signal_index_node_search (const char *prefix, int length, int create)
+{
+    struct t_hook_signal_node *ptr_node, *ptr_child;
+    char chr;
+    int i;
+
+    if (!hook_signal_index_prefix)
+    {
+        if (!create)
+            return NULL;
+        hook_signal_index_prefix = calloc (1,
+                                           sizeof (*hook_signal_index_prefix));
+        if (!hook_signal_index_prefix)
+            return NULL;
+    }
+
+    ptr_node = hook_signal_index_prefix;
+    for (i = 0; i < length; i++)
+    {
+        chr = prefix[i];
+        if ((chr >= 'A') && (chr <= 'Z'))
+            chr += ('a' - 'A');
+        for (ptr_child = ptr_node->children; ptr_child;
+             ptr_child = ptr_child->next_node)
+        {
+            if (ptr_child->chr == chr)
+                break;
+        }
+        if (!ptr_child)
+        {
+            if (!create)
+                return NULL;
+            ptr_child = calloc (1, sizeof (*ptr_child));
+            if (!ptr_child)
+                return NULL;
+            ptr_child->chr = chr;
+            ptr_child->next_node = ptr_node->children;
+            ptr_node->children = ptr_child;
+        }
+        ptr_node = ptr_child;
+    }
+
+    return ptr_node;
+}
+
+/*
+ * Removes a hook from a node of prefix trie (and its children, according to
+ * prefix), then frees nodes which become empty.
+ *
+ * Returns:
+ *   1: node is empty (no hooks and no children) and has been freed
+ *   0: node is still used
+ */
+
+int
+hook_signal_index_node_remove (struct t_hook_signal_node *node,
+                               const char *prefix, int length,
+                               struct t_hook *hook)
+{
+    struct t_hook_signal_node *ptr_child, *prev_child;
+    char chr;
+
+    if (length == 0)
+    {
+        hook_signal_index_list_remove (&node->hooks, hook);
+    }
+    else
+    {
+        chr = prefix[0];
+        if ((chr >= 'A') && (chr <= 'Z'))
+            chr += ('a' - 'A');
+        prev_child = NULL;
+        for (ptr_child = node->children; ptr_child;
+             ptr_child = ptr_child->next_node)
+        {
+            if (ptr_child->chr == chr)
+                break;
+            prev_child = ptr_child;
+        }
+        if (ptr_child)
+        {
+            if (prev_child)
+                prev_child->next_node = ptr_child->next_node;
+            else
+                node->children = ptr_child->next_node;
+            if (!hook_signal_index_node_remove (ptr_child, prefix + 1,
+                                                length - 1, hook))
+            {
+                /* child is still used: put it back in list */
+                if (prev_child)
+                    prev_child->next_node = ptr_child;
+                else
+                    node->children = ptr_child;
+            }
+        }
+    }
+
+    if (node->hooks || node->children)
+        return 0;
+
+    free (node);
+    return 1;
+}
+
+/*
+ * Adds a signal hook in the signal index.
+ */
+
+void
+hook_signal_index_add (struct t_hook *hook)
+{
+    struct t_arraylist *ptr_list;
+    struct t_hook_signal_node *ptr_node;
+    const char *mask;
+    int length;
+
+    mask = HOOK_SIGNAL(hook, signal);
+    if (!mask)
+        return;
+
+    switch (hook_signal_index_mask_type (mask, &length))
+    {
+        case 0:
+            if (!hook_signal_index_exact)
+            {
+                hook_signal_index_exact = hashtable_new (
+                    64,
+                    WEECHAT_HASHTABLE_STRING,
+                    WEECHAT_HASHTABLE_POINTER,
+                    &hook_signal_hash_key_cb,
+                    &hook_signal_keycmp_cb);
+                if (!hook_signal_index_exact)
+                    return;
+                hook_signal_index_exact->callback_free_value =
+                    &hook_signal_index_free_value_cb;
+            }
+            ptr_list = hashtable_get (hook_signal_index_exact, mask);
+            if (ptr_list)
+            {
+                arraylist_add (ptr_list, hook);
+            }
+            else
+            {
+                ptr_list = NULL;
+                if (hook_signal_index_list_add (&ptr_list, hook))
+                    hashtable_set (hook_signal_index_exact, mask, ptr_list);
+            }
+            break;
+        case 1:
+            ptr_node = hook_signal_index_node_search (mask, length, 1);
+            if (ptr_node)
+                hook_signal_index_list_add (&ptr_node->hooks, hook);
+            break;
+        default:
+            hook_signal_index_list_add (&hook_signal_index_masks, hook);
+            break;
+    }
 }
-#endif /* HAVE_GNUTLS */
 
 /*
- * Sets certificates.
+ * Removes a signal hook from the signal index.
  */
 
-#ifdef HAVE_GNUTLS
-int
-hook_connect_gnutls_set_certificates (gnutls_session_t tls_session,
-                                      const gnutls_datum_t *req_ca, int nreq,
-                                      const gnutls_pk_algorithm_t *pk_algos,
-                                      int pk_algos_len,
-#if LIBGNUTLS_VERSION_NUMBER >= 0x020b00 /* 2.11.0 */
-                                      gnutls_retr2_st *answer)
-#else
-                                      gnutls_retr_st *answer)
-#endif /* LIBGNUTLS_VERSION_NUMBER >= 0x020b00 */
+void
+hook_signal_index_remove (struct t_hook *hook)
 {
-    struct t_hook *ptr_hook;
-    int rc;
+    struct t_arraylist *ptr_list;
+    const char *mask;
+    int length, index;
 
-    rc = -1;
-    ptr_hook = weechat_hooks[HOOK_TYPE_CONNECT];
-    while (ptr_hook)
+    mask = HOOK_SIGNAL(hook, signal);
+    if (!mask)
+        return;
+
+    switch (hook_signal_index_mask_type (mask, &length))
     {
-        /* looking for the right hook using to the gnutls session pointer */
-        if (!ptr_hook->deleted
-            && HOOK_CONNECT(ptr_hook, gnutls_sess)
-            && (*(HOOK_CONNECT(ptr_hook, gnutls_sess)) == tls_session))
-        {
-            rc = (int) (HOOK_CONNECT(ptr_hook, gnutls_cb))
-                (ptr_hook->callback_pointer,
-                 ptr_hook->callback_data,
-                 tls_session, req_ca, nreq,
-                 pk_algos, pk_algos_len, answer,
-                 WEECHAT_HOOK_CONNECT_GNUTLS_CB_SET_CERT);
+        case 0:
+            if (!hook_signal_index_exact)
+                return;
+            ptr_list = hashtable_get (hook_signal_index_exact, mask);
+            if (!ptr_list)
+                return;
+            if (arraylist_search (ptr_list, hook, &index, NULL))
+                arraylist_remove (ptr_list, index);
+            if (arraylist_size (ptr_list) == 0)
+            {
+                /* the list is freed by the hashtable */
+                hashtable_remove (hook_signal_index_exact, mask);
+                if (hook_signal_index_exact->items_count == 0)
+                {
+                    hashtable_free (hook_signal_index_exact);
+                    hook_signal_index_exact = NULL;
+                }
+            }
+            break;
+        case 1:
+            if (hook_signal_index_prefix
+                && hook_signal_index_node_remove (hook_signal_index_prefix,
+                                                  mask, length, hook))
+            {
+                hook_signal_index_prefix = NULL;
+            }
+            break;
+        default:
+            hook_signal_index_list_remove (&hook_signal_index_masks, hook);
             break;
-        }
-        ptr_hook = ptr_hook->next_hook;
     }
-
-    return rc;
 }
-#endif /* HAVE_GNUTLS */
 
 /*
- * Hooks a message printed by WeeChat.
+ * Adds hooks of a list to an array of hooks (the array is reallocated if
+ * needed, the first array given is never freed).
  *
- * Returns pointer to new hook, NULL if error.
+ * If signal is not NULL, only hooks with a mask matching the signal are
+ * added.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
  */
 
-struct t_hook *
-hook_print (struct t_weechat_plugin *plugin, struct t_gui_buffer *buffer,
-            const char *tags, const char *message, int strip_colors,
-            t_hook_callback_print *callback,
-            const void *callback_pointer,
-            void *callback_data)
+int
+hook_signal_index_add_hooks (struct t_arraylist *list, const char *signal,
+                             struct t_hook ***hooks, int *count, int *size,
+                             struct t_hook **hooks_static)
 {
-    struct t_hook *new_hook;
-    struct t_hook_print *new_hook_print;
-    char **tags_array;
-    int i;
-
-    if (!callback)
-        return NULL;
-
-    new_hook = malloc (sizeof (*new_hook));
-    if (!new_hook)
-        return NULL;
-    new_hook_print = malloc (sizeof (*new_hook_print));
-    if (!new_hook_print)
-    {
-        free (new_hook);
-        return NULL;
-    }
-
-    hook_init_data (new_hook, plugin, HOOK_TYPE_PRINT, HOOK_PRIORITY_DEFAULT,
-                    callback_pointer, callback_data);
+    struct t_hook *ptr_hook, **new_hooks;
+    int i, list_size, new_size;
 
-    new_hook->hook_data = new_hook_print;
-    new_hook_print->callback = callback;
-    new_hook_print->buffer = buffer;
-    new_hook_print->tags_count = 0;
-    new_hook_print->tags_array = NULL;
-    if (tags)
+    list_size = arraylist_size (list);
+    for (i = 0; i < list_size; i++)
     {
-        tags_array = string_split (tags, ",", 0, 0,
-                                   &new_hook_print->tags_count);
-        if (tags_array)
+        ptr_hook = (struct t_hook *)arraylist_get (list, i);
+        if (signal && !string_match (signal, HOOK_SIGNAL(ptr_hook, signal), 0))
+            continue;
+        if (*count >= *size)
         {
-            new_hook_print->tags_array = malloc (new_hook_print->tags_count *
-                                                 sizeof (*new_hook_print->tags_array));
-            if (new_hook_print->tags_array)
+            new_size = *size * 2;
+            if (*hooks == hooks_static)
             {
-                for (i = 0; i < new_hook_print->tags_count; i++)
-                {
-                    new_hook_print->tags_array[i] = string_split (tags_array[i],
-                                                                  "+", 0, 0,
-                                                                  NULL);
-                }
+                new_hooks = malloc (new_size * sizeof (*new_hooks));
+                if (new_hooks)
+                    memcpy (new_hooks, *hooks, *count * sizeof (*new_hooks));
             }
-            string_free_split (tags_array);
+            else
+            {
+                new_hooks = realloc (*hooks, new_size * sizeof (*new_hooks));
+            }
+            if (!new_hooks)
+                return 0;
+            *hooks = new_hooks;
+            *size = new_size;
         }
+        (*hooks)[(*count)++] = ptr_hook;
     }
-    new_hook_print->message = (message) ? strdup (message) : NULL;
-    new_hook_print->strip_colors = strip_colors;
-
-    hook_add_to_list (new_hook);
 
-    return new_hook;
+    return 1;
 }
 
 /*
- * Executes a print hook.
+ * Searches signal hooks matching a signal, using the signal index.
+ *
+ * The array "*hooks" must be initialized with a static array of "*size"
+ * hooks; it is replaced by an allocated array if more hooks are found (then
+ * it must be freed by caller).
+ *
+ * Hooks found are sorted like the list of hooks (by priority, then creation
+ * order).
+ *
+ * Returns number of hooks found.
  */
 
-void
-hook_print_exec (struct t_gui_buffer *buffer, struct t_gui_line *line)
+int
+hook_signal_index_search (const char *signal, struct t_hook ***hooks,
+                          int *size)
 {
-    struct t_hook *ptr_hook, *next_hook;
-    char *prefix_no_color, *message_no_color;
-
-    if (!line->data->message || !line->data->message[0])
-        return;
+    struct t_hook **hooks_static;
+    struct t_hook_signal_node *ptr_node, *ptr_child;
+    struct t_arraylist *ptr_list;
+    const char *ptr_signal;
+    char chr;
+    int count, count_before, lists;
 
-    prefix_no_color = (line->data->prefix) ?
-        gui_color_decode (line->data->prefix, NULL) : NULL;
+    hooks_static = *hooks;
+    count = 0;
+    lists = 0;
 
-    message_no_color = gui_color_decode (line->data->message, NULL);
-    if (!message_no_color)
+    /* hooks with exact signal name */
+    if (hook_signal_index_exact)
     {
-        if (prefix_no_color)
-            free (prefix_no_color);
-        return;
+        ptr_list = hashtable_get (hook_signal_index_exact, signal);
+        if (ptr_list)
+        {
+            hook_signal_index_add_hooks (ptr_list, NULL, hooks, &count, size,
+                                         hooks_static);
+            lists++;
+        }
     }
 
-    hook_exec_start ();
-
-    ptr_hook = weechat_hooks[HOOK_TYPE_PRINT];
-    while (ptr_hook)
+    /* hooks with a prefix of signal ("name*") */
+    ptr_node = hook_signal_index_prefix;
+    ptr_signal = signal;
+    while (ptr_node)
     {
-        next_hook = ptr_hook->next_hook;
-
-        if (!ptr_hook->deleted
-            && !ptr_hook->running
-            && (!HOOK_PRINT(ptr_hook, buffer)
-                || (buffer == HOOK_PRINT(ptr_hook, buffer)))
-            && (!HOOK_PRINT(ptr_hook, message)
-                || !HOOK_PRINT(ptr_hook, message)[0]
-                || string_strcasestr (prefix_no_color, HOOK_PRINT(ptr_hook, message))
-                || string_strcasestr (message_no_color, HOOK_PRINT(ptr_hook, message))))
+        if (ptr_node->hooks)
         {
-            /* check if tags match */
-            if (!HOOK_PRINT(ptr_hook, tags_array)
-                || gui_line_match_tags (line->data,
-                                        HOOK_PRINT(ptr_hook, tags_count),
-                                        HOOK_PRINT(ptr_hook, tags_array)))
-            {
-                /* run callback */
-                ptr_hook->running = 1;
-                (void) (HOOK_PRINT(ptr_hook, callback))
-                    (ptr_hook->callback_pointer,
-                     ptr_hook->callback_data, buffer, line->data->date,
-                     line->data->tags_count,
-                     (const char **)line->data->tags_array,
-                     (int)line->data->displayed, (int)line->data->highlight,
-                     (HOOK_PRINT(ptr_hook, strip_colors)) ? prefix_no_color : line->data->prefix,
-                     (HOOK_PRINT(ptr_hook, strip_colors)) ? message_no_color : line->data->message);
-                ptr_hook->running = 0;
-            }
+            hook_signal_index_add_hooks (ptr_node->hooks, NULL, hooks, &count,
+                                         size, hooks_static);
+            lists++;
+        }
+        if (!ptr_signal[0])
+            break;
+        chr = ptr_signal[0];
+        if ((chr >= 'A') && (chr <= 'Z'))
+            chr += ('a' - 'A');
+        for (ptr_child = ptr_node->children; ptr_child;
+             ptr_child = ptr_child->next_node)
+        {
+            if (ptr_child->chr == chr)
+                break;
         }
+        ptr_node = ptr_child;
+        ptr_signal++;
+    }
 
-        ptr_hook = next_hook;
+    /* hooks with any other mask */
+    if (hook_signal_index_masks)
+    {
+        count_before = count;
+        hook_signal_index_add_hooks (hook_signal_index_masks, signal, hooks,
+                                     &count, size, hooks_static);
+        if (count > count_before)
+            lists++;
     }
 
-    if (prefix_no_color)
-        free (prefix_no_color);
-    if (message_no_color)
-        free (message_no_color);
+    /* hooks come from many lists: sort them */
+    if ((lists > 1) && (count > 1))
+        qsort (*hooks, count, sizeof (**hooks), &hook_signal_qsort_cmp_cb);
 
-    hook_exec_end ();
+    return count;
 }
 
 /*
@@ -2579,34 +3771,45 @@ hook_signal (struct t_weechat_plugin *plugin, const char *signal,
     new_hook->hook_data = new_hook_signal;
     new_hook_signal->callback = callback;
     new_hook_signal->signal = strdup ((ptr_signal) ? ptr_signal : signal);
+    new_hook_signal->sequence = hook_signal_sequence++;
 
     hook_add_to_list (new_hook);
+    hook_signal_index_add (new_hook);
 
     return new_hook;
 }
 
 /*
  * Sends a signal.
+ *
+ * Hooks are found with the signal index, then callbacks are called by
+ * priority (same order as list of hooks); if a callback returns
+ * WEECHAT_RC_OK_EAT, the signal is not sent to other hooks.
  */
 
 int
 hook_signal_send (const char *signal, const char *type_data, void *signal_data)
 {
-    struct t_hook *ptr_hook, *next_hook;
-    int rc;
+    struct t_hook *hooks_static[HOOK_SIGNAL_SEND_STATIC_HOOKS];
+    struct t_hook **hooks, *ptr_hook;
+    int rc, i, count, size;
 
     rc = WEECHAT_RC_OK;
 
+    if (!signal)
+        return rc;
+
     hook_exec_start ();
 
-    ptr_hook = weechat_hooks[HOOK_TYPE_SIGNAL];
-    while (ptr_hook)
+    hooks = hooks_static;
+    size = HOOK_SIGNAL_SEND_STATIC_HOOKS;
+    count = hook_signal_index_search (signal, &hooks, &size);
+
+    for (i = 0; i < count; i++)
     {
-        next_hook = ptr_hook->next_hook;
+        ptr_hook = hooks[i];
 
-        if (!ptr_hook->deleted
-            && !ptr_hook->running
-            && (string_match (signal, HOOK_SIGNAL(ptr_hook, signal), 0)))
+        if (!ptr_hook->deleted && !ptr_hook->running)
         {
             ptr_hook->running = 1;
             rc = (HOOK_SIGNAL(ptr_hook, callback))
@@ -2620,10 +3823,11 @@ hook_signal_send (const char *signal, const char *type_data, void *signal_data)
             if (rc == WEECHAT_RC_OK_EAT)
                 break;
         }
-
-        ptr_hook = next_hook;
     }
 
+    if (hooks != hooks_static)
+        free (hooks);
+
     hook_exec_end ();
 
     return rc;
@@ -2957,12 +4161,45 @@ hook_modifier (struct t_weechat_plugin *plugin, const char *modifier,
     new_hook->hook_data = new_hook_modifier;
     new_hook_modifier->callback = callback;
     new_hook_modifier->modifier = strdup ((ptr_modifier) ? ptr_modifier : modifier);
+    if (new_hook_modifier->modifier
+        && (string_strcasecmp (new_hook_modifier->modifier,
+                               "weechat_print") == 0))
+    {
+        hook_modifier_print_count++;
+    }
 
     hook_add_to_list (new_hook);
 
     return new_hook;
 }
 
+/*
+ * Searches for a modifier hook.
+ *
+ * Returns pointer to first hook found, NULL if not found.
+ */
+
+struct t_hook *
+hook_search_modifier (const char *modifier)
+{
+    struct t_hook *ptr_hook;
+
+    if (!modifier || !modifier[0])
+        return NULL;
+
+    for (ptr_hook = weechat_hooks[HOOK_TYPE_MODIFIER]; ptr_hook;
+         ptr_hook = ptr_hook->next_hook)
+    {
+        if (!ptr_hook->deleted
+            && (string_strcasecmp (HOOK_MODIFIER(ptr_hook, modifier),
+                                   modifier) == 0))
+            return ptr_hook;
+    }
+
+    /* modifier hook not found */
+    return NULL;
+}
+
 /*
  * Executes a modifier hook.
  *
@@ -3667,7 +4904,7 @@ hook_set (struct t_hook *hook, const char *property, const char *value)
     ssize_t num_written;
     char *error;
     long number;
-    int rc;
+    int rc, flag;
 
     /* invalid hook? */
     if (!hook_valid (hook))
@@ -3730,6 +4967,24 @@ hook_set (struct t_hook *hook, const char *property, const char *value)
             }
         }
     }
+    else if ((string_strcasecmp (property, "flag_read") == 0)
+             || (string_strcasecmp (property, "flag_write") == 0)
+             || (string_strcasecmp (property, "flag_exception") == 0))
+    {
+        if (!hook->deleted && (hook->type == HOOK_TYPE_FD))
+        {
+            if (string_strcasecmp (property, "flag_read") == 0)
+                flag = HOOK_FD_FLAG_READ;
+            else if (string_strcasecmp (property, "flag_write") == 0)
+                flag = HOOK_FD_FLAG_WRITE;
+            else
+                flag = HOOK_FD_FLAG_EXCEPTION;
+            hook_fd_set_flags (
+                hook,
+                (value && (strcmp (value, "1") == 0)) ?
+                HOOK_FD(hook, flags) | flag : HOOK_FD(hook, flags) & ~flag);
+        }
+    }
 }
 
 /*
@@ -3836,8 +5091,26 @@ unhook (struct t_hook *hook)
                 }
                 break;
             case HOOK_TYPE_TIMER:
+                hook_timer_heap_remove (hook);
+                if (hook_timer_heap_count == 0)
+                {
+                    free (hook_timer_heap);
+                    hook_timer_heap = NULL;
+                    hook_timer_heap_size = 0;
+                }
                 break;
             case HOOK_TYPE_FD:
+                if (hook == hook_process_sigchld_hook_fd)
+                    hook_process_sigchld_hook_fd = NULL;
+                if (hook == network_resolve_hook_fd)
+                    network_resolve_hook_fd = NULL;
+                hook_fd_epoll_remove (hook);
+                if (hook_fd_index
+                    && (hashtable_get (hook_fd_index,
+                                       &(HOOK_FD(hook, fd))) == hook))
+                {
+                    hashtable_remove (hook_fd_index, &(HOOK_FD(hook, fd)));
+                }
                 break;
             case HOOK_TYPE_PROCESS:
                 if (HOOK_PROCESS(hook, command))
@@ -3945,16 +5218,7 @@ unhook (struct t_hook *hook)
                     free (HOOK_CONNECT(hook, local_hostname));
                     HOOK_CONNECT(hook, local_hostname) = NULL;
                 }
-                if (HOOK_CONNECT(hook, hook_child_timer))
-                {
-                    unhook (HOOK_CONNECT(hook, hook_child_timer));
-                    HOOK_CONNECT(hook, hook_child_timer) = NULL;
-                }
-                if (HOOK_CONNECT(hook, hook_fd))
-                {
-                    unhook (HOOK_CONNECT(hook, hook_fd));
-                    HOOK_CONNECT(hook, hook_fd) = NULL;
-                }
+                network_connect_free_data (hook);
                 if (HOOK_CONNECT(hook, handshake_hook_fd))
                 {
                     unhook (HOOK_CONNECT(hook, handshake_hook_fd));
@@ -3970,48 +5234,6 @@ unhook (struct t_hook *hook)
                     free (HOOK_CONNECT(hook, handshake_ip_address));
                     HOOK_CONNECT(hook, handshake_ip_address) = NULL;
                 }
-                if (HOOK_CONNECT(hook, child_pid) > 0)
-                {
-                    kill (HOOK_CONNECT(hook, child_pid), SIGKILL);
-                    waitpid (HOOK_CONNECT(hook, child_pid), NULL, 0);
-                    HOOK_CONNECT(hook, child_pid) = 0;
-                }
-                if (HOOK_CONNECT(hook, child_read) != -1)
-                {
-                    close (HOOK_CONNECT(hook, child_read));
-                    HOOK_CONNECT(hook, child_read) = -1;
-                }
-                if (HOOK_CONNECT(hook, child_write) != -1)
-                {
-                    close (HOOK_CONNECT(hook, child_write));
-                    HOOK_CONNECT(hook, child_write) = -1;
-                }
-                if (HOOK_CONNECT(hook, child_recv) != -1)
-                {
-                    close (HOOK_CONNECT(hook, child_recv));
-                    HOOK_CONNECT(hook, child_recv) = -1;
-                }
-                if (HOOK_CONNECT(hook, child_send) != -1)
-                {
-                    close (HOOK_CONNECT(hook, child_send));
-                    HOOK_CONNECT(hook, child_send) = -1;
-                }
-                if (!hook_socketpair_ok)
-                {
-                    for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
-                    {
-                        if (HOOK_CONNECT(hook, sock_v4[i]) != -1)
-                        {
-                            close (HOOK_CONNECT(hook, sock_v4[i]));
-                            HOOK_CONNECT(hook, sock_v4[i]) = -1;
-                        }
-                        if (HOOK_CONNECT(hook, sock_v6[i]) != -1)
-                        {
-                            close (HOOK_CONNECT(hook, sock_v6[i]));
-                            HOOK_CONNECT(hook, sock_v6[i]) = -1;
-                        }
-                    }
-                }
                 break;
             case HOOK_TYPE_PRINT:
                 if (HOOK_PRINT(hook, tags_array))
@@ -4030,6 +5252,7 @@ unhook (struct t_hook *hook)
                 }
                 break;
             case HOOK_TYPE_SIGNAL:
+                hook_signal_index_remove (hook);
                 if (HOOK_SIGNAL(hook, signal))
                 {
                     free (HOOK_SIGNAL(hook, signal));
@@ -4065,6 +5288,11 @@ unhook (struct t_hook *hook)
             case HOOK_TYPE_MODIFIER:
                 if (HOOK_MODIFIER(hook, modifier))
                 {
+                    if (string_strcasecmp (HOOK_MODIFIER(hook, modifier),
+                                           "weechat_print") == 0)
+                    {
+                        hook_modifier_print_count--;
+                    }
                     free (HOOK_MODIFIER(hook, modifier));
                     HOOK_MODIFIER(hook, modifier) = NULL;
                 }
@@ -4420,20 +5648,22 @@ hook_add_to_infolist_pointer (struct t_infolist *infolist, struct t_hook *hook)
 #endif /* HAVE_GNUTLS */
                 if (!infolist_new_var_string (ptr_item, "local_hostname", HOOK_CONNECT(hook, local_hostname)))
                     return 0;
-                if (!infolist_new_var_integer (ptr_item, "child_read", HOOK_CONNECT(hook, child_read)))
+                if (!infolist_new_var_pointer (ptr_item, "hook_timer", HOOK_CONNECT(hook, hook_timer)))
                     return 0;
-                if (!infolist_new_var_integer (ptr_item, "child_write", HOOK_CONNECT(hook, child_write)))
+                if (!infolist_new_var_pointer (ptr_item, "resolve", HOOK_CONNECT(hook, resolve)))
                     return 0;
-                if (!infolist_new_var_integer (ptr_item, "child_recv", HOOK_CONNECT(hook, child_recv)))
+                if (!infolist_new_var_integer (ptr_item, "num_addresses", HOOK_CONNECT(hook, num_addresses)))
                     return 0;
-                if (!infolist_new_var_integer (ptr_item, "child_send", HOOK_CONNECT(hook, child_send)))
+                if (!infolist_new_var_integer (ptr_item, "next_address", HOOK_CONNECT(hook, next_address)))
                     return 0;
-                if (!infolist_new_var_integer (ptr_item, "child_pid", HOOK_CONNECT(hook, child_pid)))
+                if (!infolist_new_var_integer (ptr_item, "status", HOOK_CONNECT(hook, status)))
                     return 0;
-                if (!infolist_new_var_pointer (ptr_item, "hook_child_timer", HOOK_CONNECT(hook, hook_child_timer)))
+                if (!infolist_new_var_pointer (ptr_item, "hook_attempt_timer", HOOK_CONNECT(hook, hook_attempt_timer)))
                     return 0;
                 if (!infolist_new_var_pointer (ptr_item, "hook_fd", HOOK_CONNECT(hook, hook_fd)))
                     return 0;
+                if (!infolist_new_var_integer (ptr_item, "proxy_step", HOOK_CONNECT(hook, proxy_step)))
+                    return 0;
                 if (!infolist_new_var_pointer (ptr_item, "handshake_hook_fd", HOOK_CONNECT(hook, handshake_hook_fd)))
                     return 0;
                 if (!infolist_new_var_pointer (ptr_item, "handshake_hook_timer", HOOK_CONNECT(hook, handshake_hook_timer)))
@@ -4826,6 +6056,8 @@ hook_print_log ()
                                 (long long)(HOOK_TIMER(ptr_hook, next_exec.tv_sec)),
                                 text_time);
                     log_printf ("    next_exec.tv_usec . . : %ld",   HOOK_TIMER(ptr_hook, next_exec.tv_usec));
+                    log_printf ("    next_exec_monotonic . : %lld",  HOOK_TIMER(ptr_hook, next_exec_monotonic));
+                    log_printf ("    heap_index. . . . . . : %d",    HOOK_TIMER(ptr_hook, heap_index));
                     break;
                 case HOOK_TYPE_FD:
                     log_printf ("  fd data:");
@@ -4833,6 +6065,7 @@ hook_print_log ()
                     log_printf ("    fd. . . . . . . . . . : %d",    HOOK_FD(ptr_hook, fd));
                     log_printf ("    flags . . . . . . . . : %d",    HOOK_FD(ptr_hook, flags));
                     log_printf ("    error . . . . . . . . : %d",    HOOK_FD(ptr_hook, error));
+                    log_printf ("    epoll_id. . . . . . . : %u",    HOOK_FD(ptr_hook, epoll_id));
                     break;
                 case HOOK_TYPE_PROCESS:
                     log_printf ("  process data:");
@@ -4871,25 +6104,31 @@ hook_print_log ()
                     log_printf ("    gnutls_priorities . . : '%s'",  HOOK_CONNECT(ptr_hook, gnutls_priorities));
 #endif /* HAVE_GNUTLS */
                     log_printf ("    local_hostname. . . . : '%s'",  HOOK_CONNECT(ptr_hook, local_hostname));
-                    log_printf ("    child_read. . . . . . : %d",    HOOK_CONNECT(ptr_hook, child_read));
-                    log_printf ("    child_write . . . . . : %d",    HOOK_CONNECT(ptr_hook, child_write));
-                    log_printf ("    child_recv. . . . . . : %d",    HOOK_CONNECT(ptr_hook, child_recv));
-                    log_printf ("    child_send. . . . . . : %d",    HOOK_CONNECT(ptr_hook, child_send));
-                    log_printf ("    child_pid . . . . . . : %d",    HOOK_CONNECT(ptr_hook, child_pid));
-                    log_printf ("    hook_child_timer. . . : 0x%lx", HOOK_CONNECT(ptr_hook, hook_child_timer));
+                    log_printf ("    hook_timer. . . . . . : 0x%lx", HOOK_CONNECT(ptr_hook, hook_timer));
+                    log_printf ("    resolve . . . . . . . : 0x%lx", HOOK_CONNECT(ptr_hook, resolve));
+                    log_printf ("    res_remote. . . . . . : 0x%lx", HOOK_CONNECT(ptr_hook, res_remote));
+                    log_printf ("    res_local . . . . . . : 0x%lx", HOOK_CONNECT(ptr_hook, res_local));
+                    log_printf ("    addresses . . . . . . : 0x%lx", HOOK_CONNECT(ptr_hook, addresses));
+                    log_printf ("    num_addresses . . . . : %d",    HOOK_CONNECT(ptr_hook, num_addresses));
+                    log_printf ("    next_address. . . . . : %d",    HOOK_CONNECT(ptr_hook, next_address));
+                    log_printf ("    status. . . . . . . . : %d",    HOOK_CONNECT(ptr_hook, status));
+                    for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
+                    {
+                        log_printf ("    attempt_sock[%d]. . . : %d",    i, HOOK_CONNECT(ptr_hook, attempt_sock[i]));
+                        log_printf ("    attempt_hook_fd[%d] . : 0x%lx", i, HOOK_CONNECT(ptr_hook, attempt_hook_fd[i]));
+                    }
+                    log_printf ("    hook_attempt_timer. . : 0x%lx", HOOK_CONNECT(ptr_hook, hook_attempt_timer));
+                    log_printf ("    proxy_target_ip . . . : '%s'",  HOOK_CONNECT(ptr_hook, proxy_target_ip));
+                    log_printf ("    proxy_ip_address. . . : '%s'",  HOOK_CONNECT(ptr_hook, proxy_ip_address));
                     log_printf ("    hook_fd . . . . . . . : 0x%lx", HOOK_CONNECT(ptr_hook, hook_fd));
+                    log_printf ("    proxy_step. . . . . . : %d",    HOOK_CONNECT(ptr_hook, proxy_step));
+                    log_printf ("    proxy_sending . . . . : %d",    HOOK_CONNECT(ptr_hook, proxy_sending));
+                    log_printf ("    proxy_buffer_size . . : %d",    HOOK_CONNECT(ptr_hook, proxy_buffer_size));
+                    log_printf ("    proxy_buffer_pos. . . : %d",    HOOK_CONNECT(ptr_hook, proxy_buffer_pos));
                     log_printf ("    handshake_hook_fd . . : 0x%lx", HOOK_CONNECT(ptr_hook, handshake_hook_fd));
                     log_printf ("    handshake_hook_timer. : 0x%lx", HOOK_CONNECT(ptr_hook, handshake_hook_timer));
                     log_printf ("    handshake_fd_flags. . : %d",    HOOK_CONNECT(ptr_hook, handshake_fd_flags));
                     log_printf ("    handshake_ip_address. : '%s'",  HOOK_CONNECT(ptr_hook, handshake_ip_address));
-                    if (!hook_socketpair_ok)
-                    {
-                        for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
-                        {
-                            log_printf ("    sock_v4[%d]. . . . . . : '%d'", HOOK_CONNECT(ptr_hook, sock_v4[i]));
-                            log_printf ("    sock_v6[%d]. . . . . . : '%d'", HOOK_CONNECT(ptr_hook, sock_v6[i]));
-                        }
-                    }
                     break;
                 case HOOK_TYPE_PRINT:
                     log_printf ("  print data:");
@@ -23,13 +23,15 @@
 
 #include <unistd.h>
 #include <time.h>
+#include <netdb.h>
 
 #ifdef HAVE_GNUTLS
 #include <gnutls/gnutls.h>
 #endif
 
-/* used if socketpair() function is NOT available */
+/* max number of connections attempted in parallel by a connect hook */
 #define HOOK_CONNECT_MAX_SOCKETS 4
+#define HOOK_CONNECT_PROXY_BUFFER_SIZE 1024
 
 struct t_gui_bar;
 struct t_gui_buffer;
@@ -38,6 +40,7 @@ struct t_gui_completion;
 struct t_gui_window;
 struct t_weelist;
 struct t_hashtable;
+struct t_network_resolve;
 struct t_infolist;
 
 /* hook types */
@@ -93,6 +96,12 @@ enum t_hook_type
 #define HOOK_PROCESS_STDERR      2
 #define HOOK_PROCESS_BUFFER_SIZE 65536
 
+/* number of hooks found for a signal before allocating a bigger array */
+#define HOOK_SIGNAL_SEND_STATIC_HOOKS 32
+
+/* max number of fd events returned by epoll in one main loop iteration */
+#define HOOK_FD_EPOLL_MAX_EVENTS 256
+
 /* macros to access hook specific data */
 #define HOOK_COMMAND(hook, var) (((struct t_hook_command *)hook->hook_data)->var)
 #define HOOK_COMMAND_RUN(hook, var) (((struct t_hook_command_run *)hook->hook_data)->var)
@@ -190,6 +199,10 @@ struct t_hook_timer
     int remaining_calls;               /* calls remaining (0 = unlimited)   */
     struct timeval last_exec;          /* last time hook was executed       */
     struct timeval next_exec;          /* next scheduled execution          */
+    long long next_exec_monotonic;     /* next execution (monotonic clock,  */
+                                       /* in microseconds)                  */
+    int heap_index;                    /* index in heap of timers (-1 if    */
+                                       /* not in heap)                      */
 };
 
 /* hook fd */
@@ -203,6 +216,8 @@ struct t_hook_fd
     int flags;                         /* fd flags (read,write,..)          */
     int error;                         /* contains errno if error occurred  */
                                        /* with fd                           */
+    unsigned int epoll_id;             /* id of fd registered in epoll      */
+                                       /* (0 if not registered)             */
 };
 
 /* hook process */
@@ -266,20 +281,31 @@ struct t_hook_connect
     char *gnutls_priorities;           /* GnuTLS priorities                 */
 #endif /* HAVE_GNUTLS */
     char *local_hostname;              /* force local hostname (optional)   */
-    int child_read;                    /* to read data in pipe from child   */
-    int child_write;                   /* to write data in pipe for child   */
-    int child_recv;                    /* to read data from child socket    */
-    int child_send;                    /* to write data to child socket     */
-    pid_t child_pid;                   /* pid of child process (connecting) */
-    struct t_hook *hook_child_timer;   /* timer for child process timeout   */
-    struct t_hook *hook_fd;            /* pointer to fd hook                */
+    struct t_hook *hook_timer;         /* timer for connection timeout      */
+    struct t_network_resolve *resolve; /* resolution of addresses (done in  */
+                                       /* a thread of resolver)             */
+    struct addrinfo *res_remote;       /* addresses of peer (or proxy)      */
+    struct addrinfo *res_local;        /* local addresses (to bind socket)  */
+    struct addrinfo **addresses;       /* addresses to try (sorted)         */
+    int num_addresses;                 /* number of addresses to try        */
+    int next_address;                  /* index of next address to try      */
+    int status;                        /* status of last connection attempt */
+    int attempt_sock[HOOK_CONNECT_MAX_SOCKETS]; /* sockets being connected  */
+    struct t_hook *attempt_hook_fd[HOOK_CONNECT_MAX_SOCKETS]; /* fd hooks   */
+    struct addrinfo *attempt_address[HOOK_CONNECT_MAX_SOCKETS]; /* address  */
+    struct t_hook *hook_attempt_timer; /* timer to start next attempt       */
+    char *proxy_target_ip;             /* IPv4 of peer (for socks4 proxy)   */
+    char *proxy_ip_address;            /* IP address of proxy (connected)   */
+    struct t_hook *hook_fd;            /* fd hook for proxy handshake       */
+    int proxy_step;                    /* current step of proxy handshake   */
+    int proxy_sending;                 /* 1 if sending data, 0 if receiving */
+    unsigned char proxy_buffer[HOOK_CONNECT_PROXY_BUFFER_SIZE]; /* data     */
+    int proxy_buffer_size;             /* size of data to send/receive      */
+    int proxy_buffer_pos;              /* number of bytes sent/received     */
     struct t_hook *handshake_hook_fd;  /* fd hook for handshake             */
     struct t_hook *handshake_hook_timer; /* timer for handshake timeout     */
     int handshake_fd_flags;            /* socket flags saved for handshake  */
     char *handshake_ip_address;        /* ip address (used for handshake)   */
-    /* sockets used if socketpair() is NOT available */
-    int sock_v4[HOOK_CONNECT_MAX_SOCKETS];  /* IPv4 sockets for connecting  */
-    int sock_v6[HOOK_CONNECT_MAX_SOCKETS];  /* IPv6 sockets for connecting  */
 };
 
 /* hook print */
@@ -312,6 +338,26 @@ struct t_hook_signal
     t_hook_callback_signal *callback;  /* signal callback                   */
     char *signal;                      /* signal selected (may begin or end */
                                        /* with "*", "*" == any signal)      */
+    unsigned long long sequence;       /* creation order (used to sort      */
+                                       /* hooks with same priority)         */
+};
+
+/*
+ * Signal hooks are indexed by mask to quickly find hooks matching a signal:
+ *   - "name": exact name, in a hashtable (case insensitive)
+ *   - "name*": prefix, in a trie (one node per char, lower case)
+ *   - any other mask (like "*name" or "na*me"): in a list, string_match()
+ *     is called on each of these masks
+ * Each list of hooks in the index is sorted like the hooks list (by
+ * priority, then creation order).
+ */
+
+struct t_hook_signal_node
+{
+    char chr;                          /* char (lower case), 0 for root     */
+    struct t_arraylist *hooks;         /* hooks with prefix ending here     */
+    struct t_hook_signal_node *children;  /* child nodes (next chars)       */
+    struct t_hook_signal_node *next_node; /* link to next node (same level) */
 };
 
 /* hook hsignal */
@@ -445,7 +491,10 @@ extern struct t_hook *weechat_hooks[];
 extern struct t_hook *last_weechat_hook[];
 extern int hooks_count[];
 extern int hooks_count_total;
-extern int hook_socketpair_ok;
+extern int hook_fd_epoll;
+extern struct t_hook **hook_timer_heap;
+extern int hook_timer_heap_count;
+extern int hook_modifier_print_count;
 
 /* hook functions */
 
@@ -476,6 +525,8 @@ extern struct t_hook *hook_timer (struct t_weechat_plugin *plugin,
                                   t_hook_callback_timer *callback,
                                   const void *callback_pointer,
                                   void *callback_data);
+extern void hook_timer_heap_update (struct t_hook *hook);
+extern int hook_timer_get_time_to_next ();
 extern void hook_timer_exec ();
 extern struct t_hook *hook_fd (struct t_weechat_plugin *plugin, int fd,
                                int flag_read, int flag_write,
@@ -483,6 +534,7 @@ extern struct t_hook *hook_fd (struct t_weechat_plugin *plugin, int fd,
                                t_hook_callback_fd *callback,
                                const void *callback_pointer,
                                void *callback_data);
+extern void hook_fd_set_flags (struct t_hook *hook, int flags);
 extern void hook_fd_exec ();
 extern struct t_hook *hook_process (struct t_weechat_plugin *plugin,
                                     const char *command,
@@ -569,6 +621,7 @@ extern struct t_hook *hook_modifier (struct t_weechat_plugin *plugin,
                                      t_hook_callback_modifier *callback,
                                      const void *callback_pointer,
                                      void *callback_data);
+extern struct t_hook *hook_search_modifier (const char *modifier);
 extern char *hook_modifier_exec (struct t_weechat_plugin *plugin,
                                  const char *modifier,
                                  const char *modifier_data,
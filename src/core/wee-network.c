@@ -46,6 +46,8 @@
 #include <netdb.h>
 #include <resolv.h>
 #include <errno.h>
+#include <signal.h>
+#include <pthread.h>
 #include <gcrypt.h>
 #include <sys/time.h>
 #if defined(__OpenBSD__)
@@ -72,6 +74,26 @@ int network_init_gnutls_ok = 0;
 gnutls_certificate_credentials_t gnutls_xcred; /* GnuTLS client credentials */
 #endif /* HAVE_GNUTLS */
 
+/* resolver (threads calling getaddrinfo for connect hooks) */
+pthread_mutex_t network_resolve_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t network_resolve_cond = PTHREAD_COND_INITIALIZER;
+struct t_network_resolve *network_resolve_queue = NULL; /* to resolve       */
+struct t_network_resolve *network_resolve_last_queue = NULL;
+struct t_network_resolve *network_resolve_done = NULL;  /* resolved         */
+int network_resolve_started = 0;       /* 1 if threads have been started    */
+int network_resolve_threads = 0;       /* number of threads running         */
+int network_resolve_quit = 0;          /* 1 if threads must exit            */
+int network_resolve_pipe[2] = { -1, -1 }; /* pipe to wake up main loop      */
+struct t_hook *network_resolve_hook_fd = NULL; /* fd hook on this pipe      */
+
+
+void network_resolve_end ();
+void network_connect_resolved (struct t_hook *hook_connect,
+                               struct t_network_resolve *resolve);
+int network_connect_attempt_fd_cb (const void *pointer, void *data, int fd);
+int network_connect_attempt_timer_cb (const void *pointer, void *data,
+                                      int remaining_calls);
+
 
 /*
  * Initializes gcrypt.
@@ -154,6 +176,8 @@ network_init_gnutls ()
 void
 network_end ()
 {
+    network_resolve_end ();
+
     if (network_init_gnutls_ok)
     {
 #ifdef HAVE_GNUTLS
@@ -232,21 +256,17 @@ network_recv_with_retry (int sock, void *buffer, int length, int flags)
 }
 
 /*
- * Establishes a connection and authenticates with a HTTP proxy.
- *
- * WARNING: this function is blocking, it must be called only in a forked
- * process.
+ * Builds the request "CONNECT" for a HTTP proxy (with authentication if a
+ * username is set in proxy).
  *
- * Returns:
- *   1: OK
- *   0: error
+ * Returns length of request in buffer, -1 if error.
  */
 
 int
-network_pass_httpproxy (struct t_proxy *proxy, int sock, const char *address,
-                        int port)
+network_proxy_build_http_connect (struct t_proxy *proxy, const char *address,
+                                  int port, char *buffer, int size)
 {
-    char buffer[256], authbuf[128], authbuf_base64[512], *username, *password;
+    char authbuf[128], authbuf_base64[512], *username, *password;
     int length;
 
     if (CONFIG_STRING(proxy->options[PROXY_OPTION_USERNAME])
@@ -256,19 +276,19 @@ network_pass_httpproxy (struct t_proxy *proxy, int sock, const char *address,
         username = eval_expression (CONFIG_STRING(proxy->options[PROXY_OPTION_USERNAME]),
                                     NULL, NULL, NULL);
         if (!username)
-            return 0;
+            return -1;
         password = eval_expression (CONFIG_STRING(proxy->options[PROXY_OPTION_PASSWORD]),
                                     NULL, NULL, NULL);
         if (!password)
         {
             free (username);
-            return 0;
+            return -1;
         }
         snprintf (authbuf, sizeof (authbuf), "%s:%s", username, password);
         free (username);
         free (password);
         string_encode_base64 (authbuf, strlen (authbuf), authbuf_base64);
-        length = snprintf (buffer, sizeof (buffer),
+        length = snprintf (buffer, size,
                            "CONNECT %s:%d HTTP/1.0\r\nProxy-Authorization: "
                            "Basic %s\r\n\r\n",
                            address, port, authbuf_base64);
@@ -276,20 +296,64 @@ network_pass_httpproxy (struct t_proxy *proxy, int sock, const char *address,
     else
     {
         /* no authentication */
-        length = snprintf (buffer, sizeof (buffer),
+        length = snprintf (buffer, size,
                            "CONNECT %s:%d HTTP/1.0\r\n\r\n", address, port);
     }
 
-    if (network_send_with_retry (sock, buffer, length, 0) != length)
-        return 0;
+    return ((length < 0) || (length >= size)) ? -1 : length;
+}
+
+/*
+ * Checks response of a HTTP proxy to request "CONNECT".
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
 
+int
+network_proxy_check_http_response (const char *buffer, int length)
+{
     /* success result must be like: "HTTP/1.0 200 OK" */
-    if (network_recv_with_retry (sock, buffer, sizeof (buffer), 0) < 12)
+    if (length < 12)
         return 0;
 
     if (memcmp (buffer, "HTTP/", 5) || memcmp (buffer + 9, "200", 3))
         return 0;
 
+    return 1;
+}
+
+/*
+ * Establishes a connection and authenticates with a HTTP proxy.
+ *
+ * WARNING: this function is blocking, it must be called only in a forked
+ * process.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+network_pass_httpproxy (struct t_proxy *proxy, int sock, const char *address,
+                        int port)
+{
+    char buffer[512];
+    int length;
+
+    length = network_proxy_build_http_connect (proxy, address, port,
+                                               buffer, sizeof (buffer));
+    if (length < 0)
+        return 0;
+
+    if (network_send_with_retry (sock, buffer, length, 0) != length)
+        return 0;
+
+    length = network_recv_with_retry (sock, buffer, sizeof (buffer), 0);
+    if (!network_proxy_check_http_response (buffer, length))
+        return 0;
+
     /* connection OK */
     return 1;
 }
@@ -342,46 +406,78 @@ network_resolve (const char *hostname, char *ip, int *version)
 }
 
 /*
- * Establishes a connection and authenticates with a socks4 proxy.
+ * Builds the request "connect" for a socks4 proxy, ip_address is the IPv4
+ * address of peer.
  *
  * The socks4 protocol is explained here: http://en.wikipedia.org/wiki/SOCKS
  *
- * WARNING: this function is blocking, it must be called only in a forked
- * process.
- *
- * Returns:
- *   1: OK
- *   0: error
+ * Returns length of request in buffer, -1 if error.
  */
 
 int
-network_pass_socks4proxy (struct t_proxy *proxy, int sock, const char *address,
-                          int port)
+network_proxy_build_socks4_connect (struct t_proxy *proxy,
+                                    const char *ip_address, int port,
+                                    unsigned char *buffer, int size)
 {
     struct t_network_socks4 socks4;
-    unsigned char buffer[24];
-    char ip_addr[NI_MAXHOST], *username;
+    char *username;
     int length;
 
     username = eval_expression (CONFIG_STRING(proxy->options[PROXY_OPTION_USERNAME]),
                                 NULL, NULL, NULL);
     if (!username)
-        return 0;
+        return -1;
 
+    memset (&socks4, 0, sizeof (socks4));
     socks4.version = 4;
     socks4.method = 1;
     socks4.port = htons (port);
-    network_resolve (address, ip_addr, NULL);
-    socks4.address = inet_addr (ip_addr);
+    socks4.address = inet_addr (ip_address);
     strncpy (socks4.user, username, sizeof (socks4.user) - 1);
 
     free (username);
 
     length = 8 + strlen (socks4.user) + 1;
-    if (network_send_with_retry (sock, (char *) &socks4, length, 0) != length)
+    if (length > size)
+        return -1;
+    memcpy (buffer, &socks4, length);
+
+    return length;
+}
+
+/*
+ * Establishes a connection and authenticates with a socks4 proxy.
+ *
+ * The socks4 protocol is explained here: http://en.wikipedia.org/wiki/SOCKS
+ *
+ * WARNING: this function is blocking, it must be called only in a forked
+ * process.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+network_pass_socks4proxy (struct t_proxy *proxy, int sock, const char *address,
+                          int port)
+{
+    unsigned char buffer[256];
+    char ip_addr[NI_MAXHOST];
+    int length;
+
+    if (!network_resolve (address, ip_addr, NULL))
+        return 0;
+
+    length = network_proxy_build_socks4_connect (proxy, ip_addr, port,
+                                                 buffer, sizeof (buffer));
+    if (length < 0)
         return 0;
 
-    if (network_recv_with_retry (sock, buffer, sizeof (buffer), 0) < 2)
+    if (network_send_with_retry (sock, buffer, length, 0) != length)
+        return 0;
+
+    if (network_recv_with_retry (sock, buffer, 8, 0) < 2)
         return 0;
 
     /* connection OK */
@@ -392,6 +488,86 @@ network_pass_socks4proxy (struct t_proxy *proxy, int sock, const char *address,
     return 0;
 }
 
+/*
+ * Builds the authentication with username/password for a socks5 proxy.
+ *
+ * The socks5 authentication with username/pass is explained in RFC 1929.
+ *
+ * Returns length of request in buffer, -1 if error.
+ */
+
+int
+network_proxy_build_socks5_auth (struct t_proxy *proxy,
+                                 unsigned char *buffer, int size)
+{
+    char *username, *password;
+    int username_len, password_len;
+
+    username = eval_expression (CONFIG_STRING(proxy->options[PROXY_OPTION_USERNAME]),
+                                NULL, NULL, NULL);
+    if (!username)
+        return -1;
+    password = eval_expression (CONFIG_STRING(proxy->options[PROXY_OPTION_PASSWORD]),
+                                NULL, NULL, NULL);
+    if (!password)
+    {
+        free (username);
+        return -1;
+    }
+    username_len = strlen (username);
+    password_len = strlen (password);
+
+    if ((username_len > 255) || (password_len > 255)
+        || (3 + username_len + password_len > size))
+    {
+        free (username);
+        free (password);
+        return -1;
+    }
+
+    /* make username/password buffer */
+    buffer[0] = 1;
+    buffer[1] = (unsigned char) username_len;
+    memcpy (buffer + 2, username, username_len);
+    buffer[2 + username_len] = (unsigned char) password_len;
+    memcpy (buffer + 3 + username_len, password, password_len);
+
+    free (username);
+    free (password);
+
+    return 3 + username_len + password_len;
+}
+
+/*
+ * Builds the request "connect" for a socks5 proxy (the address is sent as
+ * a domain name, it is resolved by the proxy).
+ *
+ * Returns length of request in buffer, -1 if error.
+ */
+
+int
+network_proxy_build_socks5_connect (const char *address, int port,
+                                    unsigned char *buffer, int size)
+{
+    int addr_len;
+    unsigned short port_net;
+
+    addr_len = strlen (address);
+    if ((addr_len > 255) || (4 + 1 + addr_len + 2 > size))
+        return -1;
+
+    buffer[0] = 5;   /* version 5 */
+    buffer[1] = 1;   /* command: 1 for connect */
+    buffer[2] = 0;   /* reserved */
+    buffer[3] = 3;   /* address type : ipv4 (1), domainname (3), ipv6 (4) */
+    buffer[4] = (unsigned char) addr_len;
+    memcpy (buffer + 5, address, addr_len); /* server address */
+    port_net = htons (port);
+    memcpy (buffer + 5 + addr_len, &port_net, 2); /* server port */
+
+    return 4 + 1 + addr_len + 2;
+}
+
 /*
  * Establishes a connection and authenticates with a socks5 proxy.
  *
@@ -411,10 +587,8 @@ network_pass_socks5proxy (struct t_proxy *proxy, int sock, const char *address,
                           int port)
 {
     struct t_network_socks5 socks5;
-    unsigned char buffer[288];
-    int username_len, password_len, addr_len, addr_buffer_len;
-    unsigned char *addr_buffer;
-    char *username, *password;
+    unsigned char buffer[520];
+    int length, addr_len;
 
     socks5.version = 5;
     socks5.nmethods = 1;
@@ -446,31 +620,12 @@ network_pass_socks5proxy (struct t_proxy *proxy, int sock, const char *address,
             return 0;
 
         /* authentication as in RFC 1929 */
-        username = eval_expression (CONFIG_STRING(proxy->options[PROXY_OPTION_USERNAME]),
-                                    NULL, NULL, NULL);
-        if (!username)
-            return 0;
-        password = eval_expression (CONFIG_STRING(proxy->options[PROXY_OPTION_PASSWORD]),
-                                    NULL, NULL, NULL);
-        if (!password)
-        {
-            free (username);
+        length = network_proxy_build_socks5_auth (proxy, buffer,
+                                                  sizeof (buffer));
+        if (length < 0)
             return 0;
-        }
-        username_len = strlen (username);
-        password_len = strlen (password);
-
-        /* make username/password buffer */
-        buffer[0] = 1;
-        buffer[1] = (unsigned char) username_len;
-        memcpy (buffer + 2, username, username_len);
-        buffer[2 + username_len] = (unsigned char) password_len;
-        memcpy (buffer + 3 + username_len, password, password_len);
-
-        free (username);
-        free (password);
 
-        if (network_send_with_retry (sock, buffer, 3 + username_len + password_len, 0) < 3 + username_len + password_len)
+        if (network_send_with_retry (sock, buffer, length, 0) < length)
             return 0;
 
         /* server socks5 must respond with 2 bytes */
@@ -494,25 +649,13 @@ network_pass_socks5proxy (struct t_proxy *proxy, int sock, const char *address,
     }
 
     /* authentication successful then giving address/port to connect */
-    addr_len = strlen (address);
-    addr_buffer_len = 4 + 1 + addr_len + 2;
-    addr_buffer = malloc (addr_buffer_len * sizeof (*addr_buffer));
-    if (!addr_buffer)
+    length = network_proxy_build_socks5_connect (address, port,
+                                                 buffer, sizeof (buffer));
+    if (length < 0)
         return 0;
-    addr_buffer[0] = 5;   /* version 5 */
-    addr_buffer[1] = 1;   /* command: 1 for connect */
-    addr_buffer[2] = 0;   /* reserved */
-    addr_buffer[3] = 3;   /* address type : ipv4 (1), domainname (3), ipv6 (4) */
-    addr_buffer[4] = (unsigned char) addr_len;
-    memcpy (addr_buffer + 5, address, addr_len); /* server address */
-    *((unsigned short *) (addr_buffer + 5 + addr_len)) = htons (port); /* server port */
 
-    if (network_send_with_retry (sock, addr_buffer, addr_buffer_len, 0) < addr_buffer_len)
-    {
-        free (addr_buffer);
+    if (network_send_with_retry (sock, buffer, length, 0) < length)
         return 0;
-    }
-    free (addr_buffer);
 
     /* dialog with proxy server */
     if (network_recv_with_retry (sock, buffer, 4, 0) < 4)
@@ -743,509 +886,446 @@ error:
 }
 
 /*
- * Connects to peer in a child process.
+ * Resolves hostnames of a request (called by a thread of resolver, or by
+ * main thread if no thread could be created).
+ *
+ * Only fields "rc_*", "res_*" and "target_ip" of request are set here.
  */
 
 void
-network_connect_child (struct t_hook *hook_connect)
+network_resolve_run (struct t_network_resolve *resolve)
 {
-    struct t_proxy *ptr_proxy;
-    struct addrinfo hints, *res_local, *res_remote, *ptr_res, *ptr_loc;
-    char port[NI_MAXSERV + 1];
-    char status_str[2], *ptr_address, *status_with_string;
-    char remote_address[NI_MAXHOST + 1];
-    char status_without_string[1 + 5 + 1];
-    const char *error;
-    int rc, length, num_written;
-    int sock, set, flags, j;
-    struct msghdr msg;
-    struct cmsghdr *cmsg;
-    char msg_buf[CMSG_SPACE(sizeof (sock))];
-    struct iovec iov[1];
-    char iov_data[1] = { 0 };
-    /*
-     * indicates that something is wrong with whichever group of
-     * servers is being tried first after connecting, so start at
-     * a different offset to increase the chance of success
-     */
-    int retry, rand_num, i;
-    int num_groups, tmp_num_groups, num_hosts, tmp_host;
-    struct addrinfo **res_reorder;
-    int last_af;
-    struct timeval tv_time;
-
-    res_local = NULL;
-    res_remote = NULL;
-    res_reorder = NULL;
-    port[0] = '\0';
+    struct addrinfo hints, *res_target;
 
-    status_str[1] = '\0';
-    status_with_string = NULL;
-
-    ptr_address = NULL;
-
-    gettimeofday (&tv_time, NULL);
-    srand ((tv_time.tv_sec * tv_time.tv_usec) ^ getpid ());
-
-    ptr_proxy = NULL;
-    if (HOOK_CONNECT(hook_connect, proxy)
-        && HOOK_CONNECT(hook_connect, proxy)[0])
-    {
-        ptr_proxy = proxy_search (HOOK_CONNECT(hook_connect, proxy));
-        if (!ptr_proxy)
-        {
-            /* proxy not found */
-            snprintf (status_without_string, sizeof (status_without_string),
-                      "%c00000", '0' + WEECHAT_HOOK_CONNECT_PROXY_ERROR);
-            num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                 status_without_string, strlen (status_without_string));
-            (void) num_written;
-            goto end;
-        }
-    }
+    res_init ();
 
-    /* get info about peer */
+    /* get info about peer (or proxy) */
     memset (&hints, 0, sizeof (hints));
+    hints.ai_family = resolve->family;
     hints.ai_socktype = SOCK_STREAM;
 #ifdef AI_ADDRCONFIG
     hints.ai_flags = AI_ADDRCONFIG;
 #endif /* AI_ADDRCONFIG */
-    res_init ();
-    if (ptr_proxy)
-    {
-        hints.ai_family = (CONFIG_BOOLEAN(ptr_proxy->options[PROXY_OPTION_IPV6])) ?
-            AF_UNSPEC : AF_INET;
-        snprintf (port, sizeof (port), "%d", CONFIG_INTEGER(ptr_proxy->options[PROXY_OPTION_PORT]));
-        rc = getaddrinfo (CONFIG_STRING(ptr_proxy->options[PROXY_OPTION_ADDRESS]),
-                          port, &hints, &res_remote);
-    }
-    else
+    resolve->rc_remote = getaddrinfo (resolve->hostname, resolve->service,
+                                      &hints, &resolve->res_remote);
+    if (resolve->rc_remote != 0)
+        return;
+
+    /* get info about local hostname/IP (to bind socket) */
+    if (resolve->local_hostname)
     {
-        hints.ai_family = HOOK_CONNECT(hook_connect, ipv6) ? AF_UNSPEC : AF_INET;
-        snprintf (port, sizeof (port), "%d", HOOK_CONNECT(hook_connect, port));
-        rc = getaddrinfo (HOOK_CONNECT(hook_connect, address), port, &hints, &res_remote);
+        memset (&hints, 0, sizeof (hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+#ifdef AI_ADDRCONFIG
+        hints.ai_flags = AI_ADDRCONFIG;
+#endif /* AI_ADDRCONFIG */
+        resolve->rc_local = getaddrinfo (resolve->local_hostname, NULL,
+                                         &hints, &resolve->res_local);
+        if (resolve->rc_local != 0)
+            return;
     }
 
-    if (rc != 0)
+    /* get IPv4 address of peer (for socks4 proxy) */
+    if (resolve->target_hostname)
     {
-        /* address not found */
-        status_with_string = NULL;
-        error = gai_strerror (rc);
-        if (error)
+        memset (&hints, 0, sizeof (hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        res_target = NULL;
+        if ((getaddrinfo (resolve->target_hostname, NULL,
+                          &hints, &res_target) == 0) && res_target)
         {
-            length = 1 + 5 + strlen (error) + 1;
-            status_with_string = malloc (length);
-            if (status_with_string)
+            if (getnameinfo (res_target->ai_addr, res_target->ai_addrlen,
+                             resolve->target_ip, sizeof (resolve->target_ip),
+                             NULL, 0, NI_NUMERICHOST) != 0)
             {
-                snprintf (status_with_string, length, "%c%05d%s",
-                          '0' + WEECHAT_HOOK_CONNECT_ADDRESS_NOT_FOUND,
-                          (int)strlen (error), error);
+                resolve->target_ip[0] = '\0';
             }
         }
-        if (status_with_string)
-        {
-            num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                 status_with_string, strlen (status_with_string));
-        }
-        else
+        if (res_target)
+            freeaddrinfo (res_target);
+    }
+}
+
+/*
+ * Frees a resolver request.
+ */
+
+void
+network_resolve_free (struct t_network_resolve *resolve)
+{
+    if (!resolve)
+        return;
+
+    if (resolve->hostname)
+        free (resolve->hostname);
+    if (resolve->service)
+        free (resolve->service);
+    if (resolve->local_hostname)
+        free (resolve->local_hostname);
+    if (resolve->target_hostname)
+        free (resolve->target_hostname);
+    if (resolve->res_remote)
+        freeaddrinfo (resolve->res_remote);
+    if (resolve->res_local)
+        freeaddrinfo (resolve->res_local);
+
+    free (resolve);
+}
+
+/*
+ * Main function of a resolver thread: resolves hostnames of requests in
+ * queue, then moves them to the list of resolved requests and wakes up the
+ * main loop (with a pipe).
+ */
+
+void *
+network_resolve_thread_run (void *arg)
+{
+    sigset_t signals;
+    struct t_network_resolve *ptr_resolve;
+    ssize_t num_written;
+
+    /* make C compiler happy */
+    (void) arg;
+
+    /* signals are handled by the main thread */
+    sigfillset (&signals);
+    pthread_sigmask (SIG_BLOCK, &signals, NULL);
+
+    pthread_mutex_lock (&network_resolve_mutex);
+    while (1)
+    {
+        while (!network_resolve_queue && !network_resolve_quit)
         {
-            snprintf (status_without_string, sizeof (status_without_string),
-                      "%c00000", '0' + WEECHAT_HOOK_CONNECT_ADDRESS_NOT_FOUND);
-            num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                 status_without_string, strlen (status_without_string));
+            pthread_cond_wait (&network_resolve_cond, &network_resolve_mutex);
         }
+        if (network_resolve_quit)
+            break;
+
+        ptr_resolve = network_resolve_queue;
+        network_resolve_queue = ptr_resolve->next_resolve;
+        if (!network_resolve_queue)
+            network_resolve_last_queue = NULL;
+
+        pthread_mutex_unlock (&network_resolve_mutex);
+        network_resolve_run (ptr_resolve);
+        pthread_mutex_lock (&network_resolve_mutex);
+
+        ptr_resolve->next_resolve = network_resolve_done;
+        network_resolve_done = ptr_resolve;
+        num_written = write (network_resolve_pipe[1], "r", 1);
         (void) num_written;
-        goto end;
     }
+    network_resolve_threads--;
+    pthread_mutex_unlock (&network_resolve_mutex);
+
+    return NULL;
+}
+
+/*
+ * Callback for pipe of resolver: sends result of resolved requests to
+ * the connect hooks.
+ */
+
+int
+network_resolve_fd_cb (const void *pointer, void *data, int fd)
+{
+    char buffer[256];
+    struct t_network_resolve *ptr_resolve, *next_resolve;
+    struct t_hook *ptr_hook;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
 
-    if (!res_remote)
+    /* empty the pipe */
+    while (read (fd, buffer, sizeof (buffer)) > 0)
     {
-        /* address not found */
-        snprintf (status_without_string, sizeof (status_without_string),
-                  "%c00000", '0' + WEECHAT_HOOK_CONNECT_ADDRESS_NOT_FOUND);
-        num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                             status_without_string, strlen (status_without_string));
-        (void) num_written;
-        goto end;
     }
 
-    /* set local hostname/IP if asked by user */
-    if (HOOK_CONNECT(hook_connect, local_hostname)
-        && HOOK_CONNECT(hook_connect, local_hostname[0]))
+    pthread_mutex_lock (&network_resolve_mutex);
+    ptr_resolve = network_resolve_done;
+    network_resolve_done = NULL;
+    pthread_mutex_unlock (&network_resolve_mutex);
+
+    while (ptr_resolve)
     {
-        memset (&hints, 0, sizeof (hints));
-        hints.ai_family = AF_UNSPEC;
-        hints.ai_socktype = SOCK_STREAM;
-#ifdef AI_ADDRCONFIG
-        hints.ai_flags = AI_ADDRCONFIG;
-#endif /* AI_ADDRCONFIG */
-        rc = getaddrinfo (HOOK_CONNECT(hook_connect, local_hostname),
-                          NULL, &hints, &res_local);
-        if (rc != 0)
+        next_resolve = ptr_resolve->next_resolve;
+        /* hook_connect is NULL if the hook was removed while resolving */
+        ptr_hook = ptr_resolve->hook_connect;
+        if (ptr_hook)
         {
-            /* address not found */
-            status_with_string = NULL;
-            error = gai_strerror (rc);
-            if (error)
-            {
-                length = 1 + 5 + strlen (error) + 1;
-                status_with_string = malloc (length);
-                if (status_with_string)
-                {
-                    snprintf (status_with_string, length, "%c%05d%s",
-                              '0' + WEECHAT_HOOK_CONNECT_LOCAL_HOSTNAME_ERROR,
-                              (int)strlen (error), error);
-                }
-            }
-            if (status_with_string)
-            {
-                num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                     status_with_string, strlen (status_with_string));
-            }
-            else
-            {
-                snprintf (status_without_string, sizeof (status_without_string),
-                          "%c00000", '0' + WEECHAT_HOOK_CONNECT_LOCAL_HOSTNAME_ERROR);
-                num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                     status_without_string, strlen (status_without_string));
-            }
-            (void) num_written;
-            goto end;
+            HOOK_CONNECT(ptr_hook, resolve) = NULL;
+            network_connect_resolved (ptr_hook, ptr_resolve);
         }
+        network_resolve_free (ptr_resolve);
+        ptr_resolve = next_resolve;
+    }
 
-        if (!res_local)
-        {
-            /* address not found */
-            snprintf (status_without_string, sizeof (status_without_string),
-                      "%c00000", '0' + WEECHAT_HOOK_CONNECT_LOCAL_HOSTNAME_ERROR);
-            num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                 status_without_string, strlen (status_without_string));
-            (void) num_written;
-            goto end;
-        }
-    }
+    return WEECHAT_RC_OK;
+}
 
-    /* res_local != NULL now indicates that bind() is required */
+/*
+ * Initializes the resolver: pipe to wake up the main loop and threads
+ * (created on first call).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
 
-    /*
-     * count all the groups of hosts by tracking family, e.g.
-     * 0 = [2001:db8::1, 2001:db8::2,
-     * 1 =  192.0.2.1, 192.0.2.2,
-     * 2 =  2002:c000:201::1, 2002:c000:201::2]
-     */
-    last_af = AF_UNSPEC;
-    num_groups = 0;
-    num_hosts = 0;
-    for (ptr_res = res_remote; ptr_res; ptr_res = ptr_res->ai_next)
-    {
-        if (ptr_res->ai_family != last_af)
-            if (last_af != AF_UNSPEC)
-                num_groups++;
+int
+network_resolve_init ()
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    int i, flags;
 
-        num_hosts++;
-        last_af = ptr_res->ai_family;
+    if (network_resolve_pipe[0] < 0)
+    {
+        if (pipe (network_resolve_pipe) < 0)
+        {
+            network_resolve_pipe[0] = -1;
+            network_resolve_pipe[1] = -1;
+            return 0;
+        }
+        for (i = 0; i < 2; i++)
+        {
+            flags = fcntl (network_resolve_pipe[i], F_GETFL);
+            fcntl (network_resolve_pipe[i], F_SETFL, flags | O_NONBLOCK);
+            fcntl (network_resolve_pipe[i], F_SETFD, FD_CLOEXEC);
+        }
     }
-    if (last_af != AF_UNSPEC)
-        num_groups++;
 
-    res_reorder = malloc (sizeof (*res_reorder) * num_hosts);
-    if (!res_reorder)
+    if (!network_resolve_hook_fd)
     {
-        snprintf (status_without_string, sizeof (status_without_string),
-                  "%c00000", '0' + WEECHAT_HOOK_CONNECT_MEMORY_ERROR);
-        num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                             status_without_string, strlen (status_without_string));
-        (void) num_written;
-        goto end;
+        network_resolve_hook_fd = hook_fd (NULL, network_resolve_pipe[0],
+                                           1, 0, 0,
+                                           &network_resolve_fd_cb,
+                                           NULL, NULL);
+        if (!network_resolve_hook_fd)
+            return 0;
     }
 
-    /* reorder groups */
-    retry = HOOK_CONNECT(hook_connect, retry);
-    if (num_groups > 0)
+    pthread_mutex_lock (&network_resolve_mutex);
+    if (!network_resolve_started)
     {
-        retry %= num_groups;
-        i = 0;
-
-        last_af = AF_UNSPEC;
-        tmp_num_groups = 0;
-        tmp_host = i; /* start of current group */
-
-        /* top of list */
-        for (ptr_res = res_remote; ptr_res; ptr_res = ptr_res->ai_next)
+        network_resolve_started = 1;
+        network_resolve_quit = 0;
+        pthread_attr_init (&attr);
+        pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+        for (i = 0; i < NETWORK_RESOLVE_THREADS; i++)
         {
-            if (ptr_res->ai_family != last_af)
-            {
-                if (last_af != AF_UNSPEC)
-                    tmp_num_groups++;
-
-                tmp_host = i;
-            }
-
-            if (tmp_num_groups >= retry)
+            if (pthread_create (&thread, &attr,
+                                &network_resolve_thread_run, NULL) == 0)
             {
-                /* shuffle while adding */
-                rand_num = tmp_host + (rand () % ((i + 1) - tmp_host));
-                if (rand_num == i)
-                    res_reorder[i++] = ptr_res;
-                else
-                {
-                    res_reorder[i++] = res_reorder[rand_num];
-                    res_reorder[rand_num] = ptr_res;
-                }
+                network_resolve_threads++;
             }
-
-            last_af = ptr_res->ai_family;
         }
+        pthread_attr_destroy (&attr);
+    }
+    pthread_mutex_unlock (&network_resolve_mutex);
 
-        last_af = AF_UNSPEC;
-        tmp_num_groups = 0;
-        tmp_host = i; /* start of current group */
+    return 1;
+}
 
-        /* remainder of list */
-        for (ptr_res = res_remote; ptr_res; ptr_res = ptr_res->ai_next)
-        {
-            if (ptr_res->ai_family != last_af)
-            {
-                if (last_af != AF_UNSPEC)
-                    tmp_num_groups++;
+/*
+ * Adds a request in queue of resolver.
+ *
+ * If no thread is running, the request is resolved immediately (blocking)
+ * but the result is still sent to the hook by the main loop.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
 
-                tmp_host = i;
-            }
+int
+network_resolve_add (struct t_network_resolve *resolve)
+{
+    ssize_t num_written;
 
-            if (tmp_num_groups < retry)
-            {
-                /* shuffle while adding */
-                rand_num = tmp_host + (rand () % ((i + 1) - tmp_host));
-                if (rand_num == i)
-                    res_reorder[i++] = ptr_res;
-                else
-                {
-                    res_reorder[i++] = res_reorder[rand_num];
-                    res_reorder[rand_num] = ptr_res;
-                }
-            }
-            else
-                break;
+    if (!network_resolve_init ())
+        return 0;
 
-            last_af = ptr_res->ai_family;
-        }
-    }
-    else
+    resolve->next_resolve = NULL;
+
+    pthread_mutex_lock (&network_resolve_mutex);
+    if (network_resolve_threads > 0)
     {
-        /* no IP addresses found (all AF_UNSPEC) */
-        snprintf (status_without_string, sizeof (status_without_string),
-                  "%c00000", '0' + WEECHAT_HOOK_CONNECT_IP_ADDRESS_NOT_FOUND);
-        num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                             status_without_string, strlen (status_without_string));
-        (void) num_written;
-        goto end;
+        if (network_resolve_last_queue)
+            network_resolve_last_queue->next_resolve = resolve;
+        else
+            network_resolve_queue = resolve;
+        network_resolve_last_queue = resolve;
+        pthread_cond_signal (&network_resolve_cond);
+        pthread_mutex_unlock (&network_resolve_mutex);
+        return 1;
     }
+    pthread_mutex_unlock (&network_resolve_mutex);
 
-    status_str[0] = '0' + WEECHAT_HOOK_CONNECT_IP_ADDRESS_NOT_FOUND;
-
-    /* try all IP addresses found, stop when connection is OK */
-    sock = -1;
-    for (i = 0; i < num_hosts; i++)
-    {
-        ptr_res = res_reorder[i];
+    /* no thread: resolve now */
+    network_resolve_run (resolve);
+    pthread_mutex_lock (&network_resolve_mutex);
+    resolve->next_resolve = network_resolve_done;
+    network_resolve_done = resolve;
+    pthread_mutex_unlock (&network_resolve_mutex);
+    num_written = write (network_resolve_pipe[1], "r", 1);
+    (void) num_written;
 
-        if (hook_socketpair_ok)
-        {
-            /* create a socket */
-            sock = socket (ptr_res->ai_family,
-                           ptr_res->ai_socktype,
-                           ptr_res->ai_protocol);
-        }
-        else
-        {
-            /* use pre-created socket pool */
-            sock = -1;
-            for (j = 0; j < HOOK_CONNECT_MAX_SOCKETS; j++)
-            {
-                if (ptr_res->ai_family == AF_INET)
-                {
-                    sock = HOOK_CONNECT(hook_connect, sock_v4[j]);
-                    if (sock != -1)
-                    {
-                        HOOK_CONNECT(hook_connect, sock_v4[j]) = -1;
-                        break;
-                    }
-                }
-                else if (ptr_res->ai_family == AF_INET6)
-                {
-                    sock = HOOK_CONNECT(hook_connect, sock_v6[j]);
-                    if (sock != -1)
-                    {
-                        HOOK_CONNECT(hook_connect, sock_v6[j]) = -1;
-                        break;
-                    }
-                }
-            }
-            if (sock < 0)
-                continue;
-        }
-        if (sock < 0)
-        {
-            status_str[0] = '0' + WEECHAT_HOOK_CONNECT_SOCKET_ERROR;
-            continue;
-        }
+    return 1;
+}
 
-        /* set SO_REUSEADDR option for socket */
-        set = 1;
-        setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, (void *) &set, sizeof (set));
+/*
+ * Stops the resolver threads and frees requests not yet resolved.
+ */
 
-        /* set SO_KEEPALIVE option for socket */
-        set = 1;
-        setsockopt (sock, SOL_SOCKET, SO_KEEPALIVE, (void *) &set, sizeof (set));
+void
+network_resolve_end ()
+{
+    struct t_network_resolve *ptr_resolve, *next_resolve;
 
-        /* set flag O_NONBLOCK on socket */
-        flags = fcntl (sock, F_GETFL);
-        if (flags == -1)
-            flags = 0;
-        fcntl (sock, F_SETFL, flags | O_NONBLOCK);
+    pthread_mutex_lock (&network_resolve_mutex);
+    network_resolve_quit = 1;
+    network_resolve_started = 0;
+    ptr_resolve = network_resolve_queue;
+    while (ptr_resolve)
+    {
+        next_resolve = ptr_resolve->next_resolve;
+        network_resolve_free (ptr_resolve);
+        ptr_resolve = next_resolve;
+    }
+    network_resolve_queue = NULL;
+    network_resolve_last_queue = NULL;
+    ptr_resolve = network_resolve_done;
+    while (ptr_resolve)
+    {
+        next_resolve = ptr_resolve->next_resolve;
+        network_resolve_free (ptr_resolve);
+        ptr_resolve = next_resolve;
+    }
+    network_resolve_done = NULL;
+    pthread_cond_broadcast (&network_resolve_cond);
+    pthread_mutex_unlock (&network_resolve_mutex);
+}
 
-        if (res_local)
-        {
-            rc = -1;
+/*
+ * Sends an error to the callback of connect hook, then removes the hook.
+ *
+ * The hook must not be used any more after call to this function.
+ */
 
-            /* bind local hostname/IP if asked by user */
-            for (ptr_loc = res_local; ptr_loc; ptr_loc = ptr_loc->ai_next)
-            {
-                if (ptr_loc->ai_family != ptr_res->ai_family)
-                    continue;
+void
+network_connect_error (struct t_hook *hook_connect, int status,
+                       const char *error)
+{
+    (void) (HOOK_CONNECT(hook_connect, callback))
+        (hook_connect->callback_pointer,
+         hook_connect->callback_data,
+         status, 0, -1, error, NULL);
+    unhook (hook_connect);
+}
 
-                rc = bind (sock, ptr_loc->ai_addr, ptr_loc->ai_addrlen);
-                if (rc < 0)
-                    continue;
-            }
+/*
+ * Stops the connections attempted (except the one with given index if >= 0)
+ * and the timer used to start the next attempt.
+ */
 
-            if (rc < 0)
-            {
-                status_str[0] = '0' + WEECHAT_HOOK_CONNECT_LOCAL_HOSTNAME_ERROR;
-                close (sock);
-                sock = -1;
-                continue;
-            }
-        }
+void
+network_connect_attempts_stop (struct t_hook *hook_connect, int index)
+{
+    int i;
 
-        /* connect to peer */
-        if (network_connect (sock, ptr_res->ai_addr, ptr_res->ai_addrlen))
+    for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
+    {
+        if (i == index)
+            continue;
+        if (HOOK_CONNECT(hook_connect, attempt_hook_fd[i]))
         {
-            status_str[0] = '0' + WEECHAT_HOOK_CONNECT_OK;
-            rc = getnameinfo (ptr_res->ai_addr, ptr_res->ai_addrlen,
-                              remote_address, sizeof (remote_address),
-                              NULL, 0, NI_NUMERICHOST);
-            if (rc == 0)
-                ptr_address = remote_address;
-            break;
+            unhook (HOOK_CONNECT(hook_connect, attempt_hook_fd[i]));
+            HOOK_CONNECT(hook_connect, attempt_hook_fd[i]) = NULL;
         }
-        else
+        if (HOOK_CONNECT(hook_connect, attempt_sock[i]) >= 0)
         {
-            status_str[0] = '0' + WEECHAT_HOOK_CONNECT_CONNECTION_REFUSED;
-            close (sock);
-            sock = -1;
+            close (HOOK_CONNECT(hook_connect, attempt_sock[i]));
+            HOOK_CONNECT(hook_connect, attempt_sock[i]) = -1;
         }
+        HOOK_CONNECT(hook_connect, attempt_address[i]) = NULL;
     }
 
-    HOOK_CONNECT(hook_connect, sock) = sock;
-
-    if (ptr_proxy && status_str[0] == '0' + WEECHAT_HOOK_CONNECT_OK)
+    if (HOOK_CONNECT(hook_connect, hook_attempt_timer))
     {
-        if (!network_pass_proxy (HOOK_CONNECT(hook_connect, proxy),
-                                 HOOK_CONNECT(hook_connect, sock),
-                                 HOOK_CONNECT(hook_connect, address),
-                                 HOOK_CONNECT(hook_connect, port)))
-        {
-            /* proxy fails to connect to peer */
-            status_str[0] = '0' + WEECHAT_HOOK_CONNECT_PROXY_ERROR;
-        }
+        unhook (HOOK_CONNECT(hook_connect, hook_attempt_timer));
+        HOOK_CONNECT(hook_connect, hook_attempt_timer) = NULL;
     }
+}
 
-    if (status_str[0] == '0' + WEECHAT_HOOK_CONNECT_OK)
-    {
-        status_with_string = NULL;
-        if (ptr_address)
-        {
-            length = strlen (status_str) + 5 + strlen (ptr_address) + 1;
-            status_with_string = malloc (length);
-            if (status_with_string)
-            {
-                snprintf (status_with_string, length, "%s%05d%s",
-                          status_str, (int)strlen (ptr_address), ptr_address);
-            }
-        }
-
-        if (status_with_string)
-        {
-            num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                 status_with_string, strlen (status_with_string));
-            (void) num_written;
-        }
-        else
-        {
-            snprintf (status_without_string, sizeof (status_without_string),
-                      "%s00000", status_str);
-            num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                                 status_without_string, strlen (status_without_string));
-            (void) num_written;
-        }
+/*
+ * Frees data used by a connect hook while connecting (called by unhook).
+ */
 
-        /* send the socket to the parent process */
-        if (hook_socketpair_ok)
-        {
-            memset (&msg, 0, sizeof (msg));
-            msg.msg_control = msg_buf;
-            msg.msg_controllen = sizeof (msg_buf);
-
-            /* send 1 byte of data (not required on Linux, required by BSD/OSX) */
-            memset (iov, 0, sizeof (iov));
-            iov[0].iov_base = iov_data;
-            iov[0].iov_len = 1;
-            msg.msg_iov = iov;
-            msg.msg_iovlen = 1;
-
-            cmsg = CMSG_FIRSTHDR(&msg);
-            cmsg->cmsg_level = SOL_SOCKET;
-            cmsg->cmsg_type = SCM_RIGHTS;
-            cmsg->cmsg_len = CMSG_LEN(sizeof (sock));
-            memcpy (CMSG_DATA(cmsg), &sock, sizeof (sock));
-            msg.msg_controllen = cmsg->cmsg_len;
-            num_written = sendmsg (HOOK_CONNECT(hook_connect, child_send), &msg, 0);
-            (void) num_written;
-        }
-        else
+void
+network_connect_free_data (struct t_hook *hook_connect)
+{
+    if (HOOK_CONNECT(hook_connect, hook_timer))
+    {
+        unhook (HOOK_CONNECT(hook_connect, hook_timer));
+        HOOK_CONNECT(hook_connect, hook_timer) = NULL;
+    }
+    if (HOOK_CONNECT(hook_connect, resolve))
+    {
+        /* the request is freed when resolved (it is used by a thread) */
+        HOOK_CONNECT(hook_connect, resolve)->hook_connect = NULL;
+        HOOK_CONNECT(hook_connect, resolve) = NULL;
+    }
+    network_connect_attempts_stop (hook_connect, -1);
+    if (HOOK_CONNECT(hook_connect, hook_fd))
+    {
+        /* proxy handshake not finished: socket was not sent to callback */
+        unhook (HOOK_CONNECT(hook_connect, hook_fd));
+        HOOK_CONNECT(hook_connect, hook_fd) = NULL;
+        if (HOOK_CONNECT(hook_connect, sock) >= 0)
         {
-            num_written = write (HOOK_CONNECT(hook_connect, child_write), &sock, sizeof (sock));
-            (void) num_written;
+            close (HOOK_CONNECT(hook_connect, sock));
+            HOOK_CONNECT(hook_connect, sock) = -1;
         }
     }
-    else
+    if (HOOK_CONNECT(hook_connect, addresses))
     {
-        snprintf (status_without_string, sizeof (status_without_string),
-                  "%s00000", status_str);
-        num_written = write (HOOK_CONNECT(hook_connect, child_write),
-                             status_without_string, strlen (status_without_string));
-        (void) num_written;
+        free (HOOK_CONNECT(hook_connect, addresses));
+        HOOK_CONNECT(hook_connect, addresses) = NULL;
+    }
+    if (HOOK_CONNECT(hook_connect, res_remote))
+    {
+        freeaddrinfo (HOOK_CONNECT(hook_connect, res_remote));
+        HOOK_CONNECT(hook_connect, res_remote) = NULL;
+    }
+    if (HOOK_CONNECT(hook_connect, res_local))
+    {
+        freeaddrinfo (HOOK_CONNECT(hook_connect, res_local));
+        HOOK_CONNECT(hook_connect, res_local) = NULL;
+    }
+    if (HOOK_CONNECT(hook_connect, proxy_target_ip))
+    {
+        free (HOOK_CONNECT(hook_connect, proxy_target_ip));
+        HOOK_CONNECT(hook_connect, proxy_target_ip) = NULL;
+    }
+    if (HOOK_CONNECT(hook_connect, proxy_ip_address))
+    {
+        free (HOOK_CONNECT(hook_connect, proxy_ip_address));
+        HOOK_CONNECT(hook_connect, proxy_ip_address) = NULL;
     }
-
-end:
-    if (status_with_string)
-        free (status_with_string);
-    if (res_reorder)
-        free (res_reorder);
-    if (res_local)
-        freeaddrinfo (res_local);
-    if (res_remote)
-        freeaddrinfo (res_remote);
 }
 
 /*
- * Timer callback for timeout of child process.
+ * Timer callback for timeout of connection.
  */
 
 int
-network_connect_child_timer_cb (const void *pointer, void *data,
-                                int remaining_calls)
+network_connect_timer_cb (const void *pointer, void *data,
+                          int remaining_calls)
 {
     struct t_hook *hook_connect;
 
@@ -1255,14 +1335,9 @@ network_connect_child_timer_cb (const void *pointer, void *data,
 
     hook_connect = (struct t_hook *)pointer;
 
-    HOOK_CONNECT(hook_connect, hook_child_timer) = NULL;
+    HOOK_CONNECT(hook_connect, hook_timer) = NULL;
 
-    (void) (HOOK_CONNECT(hook_connect, callback))
-        (hook_connect->callback_pointer,
-         hook_connect->callback_data,
-         WEECHAT_HOOK_CONNECT_TIMEOUT,
-         0, -1, NULL, NULL);
-    unhook (hook_connect);
+    network_connect_error (hook_connect, WEECHAT_HOOK_CONNECT_TIMEOUT, NULL);
 
     return WEECHAT_RC_OK;
 }
@@ -1299,8 +1374,9 @@ network_connect_gnutls_handshake_fd_cb (const void *pointer, void *data,
             || (((flags & HOOK_FD_FLAG_WRITE) == HOOK_FD_FLAG_WRITE)
                 && (direction != 1)))
         {
-            HOOK_FD(HOOK_CONNECT(hook_connect, handshake_hook_fd), flags) =
-                (direction) ? HOOK_FD_FLAG_WRITE: HOOK_FD_FLAG_READ;
+            hook_fd_set_flags (HOOK_CONNECT(hook_connect, handshake_hook_fd),
+                               (direction) ?
+                               HOOK_FD_FLAG_WRITE: HOOK_FD_FLAG_READ);
         }
     }
     else if (rc != GNUTLS_E_SUCCESS)
@@ -1386,264 +1462,981 @@ network_connect_gnutls_handshake_timer_cb (const void *pointer,
 #endif /* HAVE_GNUTLS */
 
 /*
- * Reads connection progress from child process.
+ * Called when the connection to peer is established (and the proxy
+ * handshake is done, if a proxy is used): starts the GnuTLS handshake if
+ * needed, or sends the socket to the callback.
  */
 
-int
-network_connect_child_read_cb (const void *pointer, void *data, int fd)
+void
+network_connect_established (struct t_hook *hook_connect,
+                             const char *ip_address)
 {
-    struct t_hook *hook_connect;
-    char buffer[1], buf_size[6], *cb_error, *cb_ip_address, *error;
-    int num_read;
-    long size_msg;
 #ifdef HAVE_GNUTLS
     int rc, direction;
 #endif /* HAVE_GNUTLS */
-    int sock, i;
-    struct msghdr msg;
-    struct cmsghdr *cmsg;
-    char msg_buf[CMSG_SPACE(sizeof (sock))];
-    struct iovec iov[1];
-    char iov_data[1];
-
-    /* make C compiler happy */
-    (void) data;
-    (void) fd;
-
-    hook_connect = (struct t_hook *)pointer;
-
-    cb_error = NULL;
-    cb_ip_address = NULL;
-    sock = -1;
 
-    num_read = read (HOOK_CONNECT(hook_connect, child_read),
-                     buffer, sizeof (buffer));
-    if (num_read == sizeof (buffer))
+    if (HOOK_CONNECT(hook_connect, hook_fd))
     {
-        if (buffer[0] - '0' == WEECHAT_HOOK_CONNECT_OK)
-        {
-            /* connection OK, read IP address */
-            buf_size[5] = '\0';
-            num_read = read (HOOK_CONNECT(hook_connect, child_read),
-                             buf_size, 5);
-            if (num_read == 5)
-            {
-                error = NULL;
-                size_msg = strtol (buf_size, &error, 10);
-                if (error && !error[0] && (size_msg > 0))
-                {
-                    cb_ip_address = malloc (size_msg + 1);
-                    if (cb_ip_address)
-                    {
-                        num_read = read (HOOK_CONNECT(hook_connect, child_read),
-                                         cb_ip_address, size_msg);
-                        if (num_read == size_msg)
-                            cb_ip_address[size_msg] = '\0';
-                        else
-                        {
-                            free (cb_ip_address);
-                            cb_ip_address = NULL;
-                        }
-                    }
-                }
-            }
-
-            if (hook_socketpair_ok)
-            {
-                /* receive the socket from the child process */
-                memset (&msg, 0, sizeof (msg));
-                msg.msg_control = msg_buf;
-                msg.msg_controllen = sizeof (msg_buf);
-
-                /* recv 1 byte of data (not required on Linux, required by BSD/OSX) */
-                memset (iov, 0, sizeof (iov));
-                iov[0].iov_base = iov_data;
-                iov[0].iov_len = 1;
-                msg.msg_iov = iov;
-                msg.msg_iovlen = 1;
-
-                if (recvmsg (HOOK_CONNECT(hook_connect, child_recv), &msg, 0) >= 0)
-                {
-                    cmsg = CMSG_FIRSTHDR(&msg);
-                    if (cmsg != NULL
-                        && cmsg->cmsg_level == SOL_SOCKET
-                        && cmsg->cmsg_type == SCM_RIGHTS
-                        && cmsg->cmsg_len >= sizeof (sock))
-                    {
-                        memcpy (&sock, CMSG_DATA(cmsg), sizeof (sock));
-                    }
-                }
-            }
-            else
-            {
-                num_read = read (HOOK_CONNECT(hook_connect, child_read), &sock, sizeof (sock));
-                (void) num_read;
-
-                /* prevent unhook process from closing the socket */
-                for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
-                {
-                    if (HOOK_CONNECT(hook_connect, sock_v4[i]) == sock)
-                        HOOK_CONNECT(hook_connect, sock_v4[i]) = -1;
-
-                    if (HOOK_CONNECT(hook_connect, sock_v6[i]) == sock)
-                        HOOK_CONNECT(hook_connect, sock_v6[i]) = -1;
-                }
-            }
-
-            HOOK_CONNECT(hook_connect, sock) = sock;
+        unhook (HOOK_CONNECT(hook_connect, hook_fd));
+        HOOK_CONNECT(hook_connect, hook_fd) = NULL;
+    }
 
 #ifdef HAVE_GNUTLS
-            if (HOOK_CONNECT(hook_connect, gnutls_sess))
-            {
-                /*
-                 * the socket needs to be non-blocking since the call to
-                 * gnutls_handshake can block
-                 */
-                HOOK_CONNECT(hook_connect, handshake_fd_flags) =
-                    fcntl (HOOK_CONNECT(hook_connect, sock), F_GETFL);
-                if (HOOK_CONNECT(hook_connect, handshake_fd_flags) == -1)
-                    HOOK_CONNECT(hook_connect, handshake_fd_flags) = 0;
-                fcntl (HOOK_CONNECT(hook_connect, sock), F_SETFL,
-                       HOOK_CONNECT(hook_connect, handshake_fd_flags) | O_NONBLOCK);
-                gnutls_transport_set_ptr (*HOOK_CONNECT(hook_connect, gnutls_sess),
-                                          (gnutls_transport_ptr_t) ((ptrdiff_t) HOOK_CONNECT(hook_connect, sock)));
-                if (HOOK_CONNECT(hook_connect, gnutls_dhkey_size) > 0)
-                {
-                    gnutls_dh_set_prime_bits (*HOOK_CONNECT(hook_connect, gnutls_sess),
-                                              (unsigned int) HOOK_CONNECT(hook_connect, gnutls_dhkey_size));
-                }
-                rc = gnutls_handshake (*HOOK_CONNECT(hook_connect, gnutls_sess));
-                if ((rc == GNUTLS_E_AGAIN) || (rc == GNUTLS_E_INTERRUPTED))
-                {
-                    /*
-                     * gnutls was unable to proceed with the handshake without
-                     * blocking: non fatal error, we just have to wait for an
-                     * event about handshake
-                     */
-                    unhook (HOOK_CONNECT(hook_connect, hook_fd));
-                    HOOK_CONNECT(hook_connect, hook_fd) = NULL;
-                    direction = gnutls_record_get_direction (*HOOK_CONNECT(hook_connect, gnutls_sess));
-                    HOOK_CONNECT(hook_connect, handshake_ip_address) = cb_ip_address;
-                    HOOK_CONNECT(hook_connect, handshake_hook_fd) =
-                        hook_fd (hook_connect->plugin,
-                                 HOOK_CONNECT(hook_connect, sock),
-                                 (!direction ? 1 : 0), (direction  ? 1 : 0), 0,
-                                 &network_connect_gnutls_handshake_fd_cb,
-                                 hook_connect, NULL);
-                    HOOK_CONNECT(hook_connect, handshake_hook_timer) =
-                        hook_timer (hook_connect->plugin,
-                                    CONFIG_INTEGER(config_network_gnutls_handshake_timeout) * 1000,
-                                    0, 1,
-                                    &network_connect_gnutls_handshake_timer_cb,
-                                    hook_connect, NULL);
-                    return WEECHAT_RC_OK;
-                }
-                else if (rc != GNUTLS_E_SUCCESS)
-                {
-                    (void) (HOOK_CONNECT(hook_connect, callback))
-                        (hook_connect->callback_pointer,
-                         hook_connect->callback_data,
-                         WEECHAT_HOOK_CONNECT_GNUTLS_HANDSHAKE_ERROR,
-                         rc, sock,
-                         gnutls_strerror (rc),
-                         cb_ip_address);
-                    unhook (hook_connect);
-                    if (cb_ip_address)
-                        free (cb_ip_address);
-                    return WEECHAT_RC_OK;
-                }
-                fcntl (HOOK_CONNECT(hook_connect, sock), F_SETFL,
-                       HOOK_CONNECT(hook_connect, handshake_fd_flags));
-#if LIBGNUTLS_VERSION_NUMBER < 0x02090a /* 2.9.10 */
-                /*
-                 * gnutls only has the gnutls_certificate_set_verify_function()
-                 * function since version 2.9.10. We need to call our verify
-                 * function manually after the handshake for old gnutls versions
-                 */
-                if (hook_connect_gnutls_verify_certificates (*HOOK_CONNECT(hook_connect, gnutls_sess)) != 0)
-                {
-                    (void) (HOOK_CONNECT(hook_connect, callback))
-                        (hook_connect->callback_pointer,
-                         hook_connect->callback_data,
-                         WEECHAT_HOOK_CONNECT_GNUTLS_HANDSHAKE_ERROR,
-                         rc, sock,
-                         "Error in the certificate.",
-                         cb_ip_address);
-                    unhook (hook_connect);
-                    if (cb_ip_address)
-                        free (cb_ip_address);
-                    return WEECHAT_RC_OK;
-                }
-#endif /* LIBGNUTLS_VERSION_NUMBER < 0x02090a */
-            }
-#endif /* HAVE_GNUTLS */
-        }
-        else
+    if (HOOK_CONNECT(hook_connect, gnutls_sess))
+    {
+        /*
+         * the socket needs to be non-blocking since the call to
+         * gnutls_handshake can block
+         */
+        HOOK_CONNECT(hook_connect, handshake_fd_flags) =
+            fcntl (HOOK_CONNECT(hook_connect, sock), F_GETFL);
+        if (HOOK_CONNECT(hook_connect, handshake_fd_flags) == -1)
+            HOOK_CONNECT(hook_connect, handshake_fd_flags) = 0;
+        fcntl (HOOK_CONNECT(hook_connect, sock), F_SETFL,
+               HOOK_CONNECT(hook_connect, handshake_fd_flags) | O_NONBLOCK);
+        gnutls_transport_set_ptr (*HOOK_CONNECT(hook_connect, gnutls_sess),
+                                  (gnutls_transport_ptr_t) ((ptrdiff_t) HOOK_CONNECT(hook_connect, sock)));
+        if (HOOK_CONNECT(hook_connect, gnutls_dhkey_size) > 0)
         {
-            /* connection error, read error */
-            buf_size[5] = '\0';
-            num_read = read (HOOK_CONNECT(hook_connect, child_read),
-                             buf_size, 5);
-            if (num_read == 5)
-            {
-                error = NULL;
-                size_msg = strtol (buf_size, &error, 10);
-                if (error && !error[0] && (size_msg > 0))
-                {
-                    cb_error = malloc (size_msg + 1);
-                    if (cb_error)
-                    {
-                        num_read = read (HOOK_CONNECT(hook_connect, child_read),
-                                         cb_error, size_msg);
-                        if (num_read == size_msg)
-                            cb_error[size_msg] = '\0';
-                        else
-                        {
-                            free (cb_error);
-                            cb_error = NULL;
-                        }
-                    }
-                }
-            }
+            gnutls_dh_set_prime_bits (*HOOK_CONNECT(hook_connect, gnutls_sess),
+                                      (unsigned int) HOOK_CONNECT(hook_connect, gnutls_dhkey_size));
         }
-        (void) (HOOK_CONNECT(hook_connect, callback))
-            (hook_connect->callback_pointer,
-             hook_connect->callback_data,
-             buffer[0] - '0', 0,
-             sock, cb_error, cb_ip_address);
-        unhook (hook_connect);
+        rc = gnutls_handshake (*HOOK_CONNECT(hook_connect, gnutls_sess));
+        if ((rc == GNUTLS_E_AGAIN) || (rc == GNUTLS_E_INTERRUPTED))
+        {
+            /*
+             * gnutls was unable to proceed with the handshake without
+             * blocking: non fatal error, we just have to wait for an
+             * event about handshake
+             */
+            direction = gnutls_record_get_direction (*HOOK_CONNECT(hook_connect, gnutls_sess));
+            HOOK_CONNECT(hook_connect, handshake_ip_address) =
+                (ip_address) ? strdup (ip_address) : NULL;
+            HOOK_CONNECT(hook_connect, handshake_hook_fd) =
+                hook_fd (hook_connect->plugin,
+                         HOOK_CONNECT(hook_connect, sock),
+                         (!direction ? 1 : 0), (direction  ? 1 : 0), 0,
+                         &network_connect_gnutls_handshake_fd_cb,
+                         hook_connect, NULL);
+            HOOK_CONNECT(hook_connect, handshake_hook_timer) =
+                hook_timer (hook_connect->plugin,
+                            CONFIG_INTEGER(config_network_gnutls_handshake_timeout) * 1000,
+                            0, 1,
+                            &network_connect_gnutls_handshake_timer_cb,
+                            hook_connect, NULL);
+            return;
+        }
+        else if (rc != GNUTLS_E_SUCCESS)
+        {
+            (void) (HOOK_CONNECT(hook_connect, callback))
+                (hook_connect->callback_pointer,
+                 hook_connect->callback_data,
+                 WEECHAT_HOOK_CONNECT_GNUTLS_HANDSHAKE_ERROR,
+                 rc, HOOK_CONNECT(hook_connect, sock),
+                 gnutls_strerror (rc),
+                 ip_address);
+            unhook (hook_connect);
+            return;
+        }
+        fcntl (HOOK_CONNECT(hook_connect, sock), F_SETFL,
+               HOOK_CONNECT(hook_connect, handshake_fd_flags));
+#if LIBGNUTLS_VERSION_NUMBER < 0x02090a /* 2.9.10 */
+        /*
+         * gnutls only has the gnutls_certificate_set_verify_function()
+         * function since version 2.9.10. We need to call our verify
+         * function manually after the handshake for old gnutls versions
+         */
+        if (hook_connect_gnutls_verify_certificates (*HOOK_CONNECT(hook_connect, gnutls_sess)) != 0)
+        {
+            (void) (HOOK_CONNECT(hook_connect, callback))
+                (hook_connect->callback_pointer,
+                 hook_connect->callback_data,
+                 WEECHAT_HOOK_CONNECT_GNUTLS_HANDSHAKE_ERROR,
+                 rc, HOOK_CONNECT(hook_connect, sock),
+                 "Error in the certificate.",
+                 ip_address);
+            unhook (hook_connect);
+            return;
+        }
+#endif /* LIBGNUTLS_VERSION_NUMBER < 0x02090a */
     }
-    else
+#endif /* HAVE_GNUTLS */
+
+    (void) (HOOK_CONNECT(hook_connect, callback))
+        (hook_connect->callback_pointer,
+         hook_connect->callback_data,
+         WEECHAT_HOOK_CONNECT_OK, 0,
+         HOOK_CONNECT(hook_connect, sock),
+         NULL, ip_address);
+    unhook (hook_connect);
+}
+
+/*
+ * Sets data to send to proxy for a step of handshake.
+ */
+
+void
+network_connect_proxy_send (struct t_hook *hook_connect, int step,
+                            const void *data, int size)
+{
+    if (size > HOOK_CONNECT_PROXY_BUFFER_SIZE)
+        size = HOOK_CONNECT_PROXY_BUFFER_SIZE;
+
+    memcpy (HOOK_CONNECT(hook_connect, proxy_buffer), data, size);
+    HOOK_CONNECT(hook_connect, proxy_step) = step;
+    HOOK_CONNECT(hook_connect, proxy_sending) = 1;
+    HOOK_CONNECT(hook_connect, proxy_buffer_size) = size;
+    HOOK_CONNECT(hook_connect, proxy_buffer_pos) = 0;
+    hook_fd_set_flags (HOOK_CONNECT(hook_connect, hook_fd),
+                       HOOK_FD_FLAG_WRITE);
+}
+
+/*
+ * Sets size of data to receive from proxy for a step of handshake.
+ */
+
+void
+network_connect_proxy_recv (struct t_hook *hook_connect, int step, int size)
+{
+    if (size > HOOK_CONNECT_PROXY_BUFFER_SIZE)
+        size = HOOK_CONNECT_PROXY_BUFFER_SIZE;
+
+    HOOK_CONNECT(hook_connect, proxy_step) = step;
+    HOOK_CONNECT(hook_connect, proxy_sending) = 0;
+    HOOK_CONNECT(hook_connect, proxy_buffer_size) = size;
+    HOOK_CONNECT(hook_connect, proxy_buffer_pos) = 0;
+    hook_fd_set_flags (HOOK_CONNECT(hook_connect, hook_fd),
+                       HOOK_FD_FLAG_READ);
+}
+
+/*
+ * Goes to next step of proxy handshake, after the data of current step has
+ * been sent or received.
+ *
+ * Returns:
+ *    1: handshake done (connected to peer)
+ *    0: OK, data must be sent/received for next step
+ *   -1: error
+ */
+
+int
+network_connect_proxy_next_step (struct t_hook *hook_connect)
+{
+    struct t_proxy *ptr_proxy;
+    struct t_network_socks5 socks5;
+    unsigned char *buffer, request[HOOK_CONNECT_PROXY_BUFFER_SIZE];
+    int length, auth;
+
+    ptr_proxy = proxy_search (HOOK_CONNECT(hook_connect, proxy));
+    if (!ptr_proxy)
+        return -1;
+
+    buffer = HOOK_CONNECT(hook_connect, proxy_buffer);
+    auth = (CONFIG_STRING(ptr_proxy->options[PROXY_OPTION_USERNAME])
+            && CONFIG_STRING(ptr_proxy->options[PROXY_OPTION_USERNAME])[0]);
+
+    switch (HOOK_CONNECT(hook_connect, proxy_step))
     {
-        (void) (HOOK_CONNECT(hook_connect, callback))
-            (hook_connect->callback_pointer,
-             hook_connect->callback_data,
-             WEECHAT_HOOK_CONNECT_MEMORY_ERROR,
-             0, sock, "child_read_cb", NULL);
-        unhook (hook_connect);
+        case NETWORK_PROXY_STEP_INIT:
+            switch (CONFIG_INTEGER(ptr_proxy->options[PROXY_OPTION_TYPE]))
+            {
+                case PROXY_TYPE_HTTP:
+                    length = network_proxy_build_http_connect (
+                        ptr_proxy,
+                        HOOK_CONNECT(hook_connect, address),
+                        HOOK_CONNECT(hook_connect, port),
+                        (char *)request, sizeof (request));
+                    if (length < 0)
+                        return -1;
+                    network_connect_proxy_send (
+                        hook_connect, NETWORK_PROXY_STEP_HTTP_SEND_CONNECT,
+                        request, length);
+                    return 0;
+                case PROXY_TYPE_SOCKS4:
+                    if (!HOOK_CONNECT(hook_connect, proxy_target_ip))
+                        return -1;
+                    length = network_proxy_build_socks4_connect (
+                        ptr_proxy,
+                        HOOK_CONNECT(hook_connect, proxy_target_ip),
+                        HOOK_CONNECT(hook_connect, port),
+                        request, sizeof (request));
+                    if (length < 0)
+                        return -1;
+                    network_connect_proxy_send (
+                        hook_connect, NETWORK_PROXY_STEP_SOCKS4_SEND_CONNECT,
+                        request, length);
+                    return 0;
+                case PROXY_TYPE_SOCKS5:
+                    socks5.version = 5;
+                    socks5.nmethods = 1;
+                    socks5.method = (auth) ? 2 : 0;
+                    network_connect_proxy_send (
+                        hook_connect, NETWORK_PROXY_STEP_SOCKS5_SEND_METHOD,
+                        &socks5, sizeof (socks5));
+                    return 0;
+            }
+            return -1;
+        case NETWORK_PROXY_STEP_HTTP_SEND_CONNECT:
+            /* response is read until end of headers */
+            network_connect_proxy_recv (
+                hook_connect, NETWORK_PROXY_STEP_HTTP_RECV_RESPONSE,
+                HOOK_CONNECT_PROXY_BUFFER_SIZE);
+            return 0;
+        case NETWORK_PROXY_STEP_HTTP_RECV_RESPONSE:
+            return (network_proxy_check_http_response (
+                        (const char *)buffer,
+                        HOOK_CONNECT(hook_connect, proxy_buffer_pos))) ?
+                1 : -1;
+        case NETWORK_PROXY_STEP_SOCKS4_SEND_CONNECT:
+            network_connect_proxy_recv (
+                hook_connect, NETWORK_PROXY_STEP_SOCKS4_RECV_RESPONSE, 8);
+            return 0;
+        case NETWORK_PROXY_STEP_SOCKS4_RECV_RESPONSE:
+            return ((buffer[0] == 0) && (buffer[1] == 90)) ? 1 : -1;
+        case NETWORK_PROXY_STEP_SOCKS5_SEND_METHOD:
+            /* server socks5 must respond with 2 bytes */
+            network_connect_proxy_recv (
+                hook_connect, NETWORK_PROXY_STEP_SOCKS5_RECV_METHOD, 2);
+            return 0;
+        case NETWORK_PROXY_STEP_SOCKS5_RECV_METHOD:
+            /*
+             * socks server must respond with:
+             *   - socks version (buffer[0]) = 5 => socks5
+             *   - socks method  (buffer[1]) = 2 => authentication
+             *                                 0 => no authentication
+             */
+            if ((buffer[0] != 5) || (buffer[1] != ((auth) ? 2 : 0)))
+                return -1;
+            if (auth)
+            {
+                /* authentication as in RFC 1929 */
+                length = network_proxy_build_socks5_auth (ptr_proxy, request,
+                                                          sizeof (request));
+                if (length < 0)
+                    return -1;
+                network_connect_proxy_send (
+                    hook_connect, NETWORK_PROXY_STEP_SOCKS5_SEND_AUTH,
+                    request, length);
+                return 0;
+            }
+            /* no authentication: send address/port to connect */
+            length = network_proxy_build_socks5_connect (
+                HOOK_CONNECT(hook_connect, address),
+                HOOK_CONNECT(hook_connect, port),
+                request, sizeof (request));
+            if (length < 0)
+                return -1;
+            network_connect_proxy_send (
+                hook_connect, NETWORK_PROXY_STEP_SOCKS5_SEND_CONNECT,
+                request, length);
+            return 0;
+        case NETWORK_PROXY_STEP_SOCKS5_SEND_AUTH:
+            network_connect_proxy_recv (
+                hook_connect, NETWORK_PROXY_STEP_SOCKS5_RECV_AUTH, 2);
+            return 0;
+        case NETWORK_PROXY_STEP_SOCKS5_RECV_AUTH:
+            /* buffer[1] = auth state, must be 0 for success */
+            if (buffer[1] != 0)
+                return -1;
+            length = network_proxy_build_socks5_connect (
+                HOOK_CONNECT(hook_connect, address),
+                HOOK_CONNECT(hook_connect, port),
+                request, sizeof (request));
+            if (length < 0)
+                return -1;
+            network_connect_proxy_send (
+                hook_connect, NETWORK_PROXY_STEP_SOCKS5_SEND_CONNECT,
+                request, length);
+            return 0;
+        case NETWORK_PROXY_STEP_SOCKS5_SEND_CONNECT:
+            network_connect_proxy_recv (
+                hook_connect, NETWORK_PROXY_STEP_SOCKS5_RECV_CONNECT, 4);
+            return 0;
+        case NETWORK_PROXY_STEP_SOCKS5_RECV_CONNECT:
+            if ((buffer[0] != 5) || (buffer[1] != 0))
+                return -1;
+            /* buffer[3] = address type of server bound address */
+            switch (buffer[3])
+            {
+                case 1:
+                    /* ipv4: address of 4 bytes and port of 2 bytes */
+                    network_connect_proxy_recv (
+                        hook_connect, NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS,
+                        6);
+                    return 0;
+                case 3:
+                    /* domainname: length, then address and port */
+                    network_connect_proxy_recv (
+                        hook_connect,
+                        NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS_LENGTH, 1);
+                    return 0;
+                case 4:
+                    /* ipv6: address of 16 bytes and port of 2 bytes */
+                    network_connect_proxy_recv (
+                        hook_connect, NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS,
+                        18);
+                    return 0;
+            }
+            return -1;
+        case NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS_LENGTH:
+            network_connect_proxy_recv (
+                hook_connect, NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS,
+                buffer[0] + 2);
+            return 0;
+        case NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS:
+            return 1;
+    }
+
+    return -1;
+}
+
+/*
+ * Callback for socket connected to proxy: sends/receives data of the
+ * current step of handshake (without blocking).
+ */
+
+int
+network_connect_proxy_fd_cb (const void *pointer, void *data, int fd)
+{
+    struct t_hook *hook_connect;
+    unsigned char *buffer;
+    int num, size, rc;
+
+    /* make C compiler happy */
+    (void) data;
+
+    hook_connect = (struct t_hook *)pointer;
+    buffer = HOOK_CONNECT(hook_connect, proxy_buffer);
+
+    while (1)
+    {
+        size = HOOK_CONNECT(hook_connect, proxy_buffer_size);
+        if (HOOK_CONNECT(hook_connect, proxy_sending))
+        {
+            num = send (fd,
+                        buffer + HOOK_CONNECT(hook_connect, proxy_buffer_pos),
+                        size - HOOK_CONNECT(hook_connect, proxy_buffer_pos),
+                        0);
+            if (num < 0)
+            {
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK)
+                    || (errno == EINTR))
+                {
+                    return WEECHAT_RC_OK;
+                }
+                goto error;
+            }
+            HOOK_CONNECT(hook_connect, proxy_buffer_pos) += num;
+            if (HOOK_CONNECT(hook_connect, proxy_buffer_pos) < size)
+                continue;
+        }
+        else
+        {
+            /*
+             * response of HTTP proxy is read byte by byte, to not read data
+             * sent by peer after the end of headers
+             */
+            num = recv (fd,
+                        buffer + HOOK_CONNECT(hook_connect, proxy_buffer_pos),
+                        (HOOK_CONNECT(hook_connect, proxy_step) == NETWORK_PROXY_STEP_HTTP_RECV_RESPONSE) ?
+                        1 : size - HOOK_CONNECT(hook_connect, proxy_buffer_pos),
+                        0);
+            if (num == 0)
+                goto error;
+            if (num < 0)
+            {
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK)
+                    || (errno == EINTR))
+                {
+                    return WEECHAT_RC_OK;
+                }
+                goto error;
+            }
+            HOOK_CONNECT(hook_connect, proxy_buffer_pos) += num;
+            if (HOOK_CONNECT(hook_connect, proxy_step) == NETWORK_PROXY_STEP_HTTP_RECV_RESPONSE)
+            {
+                if ((HOOK_CONNECT(hook_connect, proxy_buffer_pos) < 4)
+                    || (memcmp (buffer + HOOK_CONNECT(hook_connect, proxy_buffer_pos) - 4,
+                                "\r\n\r\n", 4) != 0))
+                {
+                    if (HOOK_CONNECT(hook_connect, proxy_buffer_pos) >= size)
+                        goto error;
+                    continue;
+                }
+            }
+            else if (HOOK_CONNECT(hook_connect, proxy_buffer_pos) < size)
+            {
+                continue;
+            }
+        }
+
+        /* data of step sent/received: go to next step */
+        rc = network_connect_proxy_next_step (hook_connect);
+        if (rc < 0)
+            goto error;
+        if (rc > 0)
+        {
+            network_connect_established (
+                hook_connect, HOOK_CONNECT(hook_connect, proxy_ip_address));
+        }
+        return WEECHAT_RC_OK;
+    }
+
+error:
+    /* proxy fails to connect to peer */
+    network_connect_error (hook_connect, WEECHAT_HOOK_CONNECT_PROXY_ERROR,
+                           NULL);
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Called when a connection attempt succeeded: stops the other attempts,
+ * then starts the proxy handshake or ends the connection.
+ */
+
+void
+network_connect_attempt_ok (struct t_hook *hook_connect, int index)
+{
+    struct addrinfo *ptr_res;
+    char ip_address[NI_MAXHOST + 1], *ptr_ip_address;
+
+    ptr_res = HOOK_CONNECT(hook_connect, attempt_address[index]);
+
+    /* keep this socket, stop other attempts */
+    if (HOOK_CONNECT(hook_connect, attempt_hook_fd[index]))
+    {
+        unhook (HOOK_CONNECT(hook_connect, attempt_hook_fd[index]));
+        HOOK_CONNECT(hook_connect, attempt_hook_fd[index]) = NULL;
+    }
+    HOOK_CONNECT(hook_connect, sock) =
+        HOOK_CONNECT(hook_connect, attempt_sock[index]);
+    HOOK_CONNECT(hook_connect, attempt_sock[index]) = -1;
+    HOOK_CONNECT(hook_connect, attempt_address[index]) = NULL;
+    network_connect_attempts_stop (hook_connect, -1);
+
+    ptr_ip_address = NULL;
+    if (getnameinfo (ptr_res->ai_addr, ptr_res->ai_addrlen,
+                     ip_address, sizeof (ip_address),
+                     NULL, 0, NI_NUMERICHOST) == 0)
+    {
+        ptr_ip_address = ip_address;
+    }
+
+    if (HOOK_CONNECT(hook_connect, proxy)
+        && HOOK_CONNECT(hook_connect, proxy)[0])
+    {
+        /* connected to proxy: start the handshake */
+        HOOK_CONNECT(hook_connect, proxy_ip_address) =
+            (ptr_ip_address) ? strdup (ptr_ip_address) : NULL;
+        HOOK_CONNECT(hook_connect, hook_fd) =
+            hook_fd (hook_connect->plugin,
+                     HOOK_CONNECT(hook_connect, sock),
+                     0, 1, 0,
+                     &network_connect_proxy_fd_cb,
+                     hook_connect, NULL);
+        if (!HOOK_CONNECT(hook_connect, hook_fd))
+        {
+            close (HOOK_CONNECT(hook_connect, sock));
+            HOOK_CONNECT(hook_connect, sock) = -1;
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_MEMORY_ERROR,
+                                   "hook_fd");
+            return;
+        }
+        HOOK_CONNECT(hook_connect, proxy_step) = NETWORK_PROXY_STEP_INIT;
+        if (network_connect_proxy_next_step (hook_connect) < 0)
+        {
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_PROXY_ERROR, NULL);
+        }
+        return;
+    }
+
+    network_connect_established (hook_connect, ptr_ip_address);
+}
+
+/*
+ * Starts connection to next addresses, while there are free slots for
+ * parallel attempts.
+ *
+ * The next address is tried when an attempt fails, or after a delay
+ * (NETWORK_CONNECT_ATTEMPT_DELAY) if the attempts are still in progress
+ * (a non-responding address does not delay the other ones until the
+ * connection timeout).
+ *
+ * If all addresses failed, the error is sent to the callback and the hook
+ * is removed.
+ */
+
+void
+network_connect_attempt_next (struct t_hook *hook_connect)
+{
+    struct addrinfo *ptr_res, *ptr_loc;
+    int i, index, sock, set, flags, rc;
+
+    if (HOOK_CONNECT(hook_connect, hook_attempt_timer))
+    {
+        unhook (HOOK_CONNECT(hook_connect, hook_attempt_timer));
+        HOOK_CONNECT(hook_connect, hook_attempt_timer) = NULL;
+    }
+
+    while (HOOK_CONNECT(hook_connect, next_address) < HOOK_CONNECT(hook_connect, num_addresses))
+    {
+        /* search a free slot */
+        index = -1;
+        for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
+        {
+            if (HOOK_CONNECT(hook_connect, attempt_sock[i]) < 0)
+            {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0)
+            break;
+
+        ptr_res = HOOK_CONNECT(hook_connect, addresses)[HOOK_CONNECT(hook_connect, next_address)];
+        HOOK_CONNECT(hook_connect, next_address)++;
+
+        /* create a socket */
+        sock = socket (ptr_res->ai_family, ptr_res->ai_socktype,
+                       ptr_res->ai_protocol);
+        if (sock < 0)
+        {
+            HOOK_CONNECT(hook_connect, status) = WEECHAT_HOOK_CONNECT_SOCKET_ERROR;
+            continue;
+        }
+
+        /* set SO_REUSEADDR option for socket */
+        set = 1;
+        setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, (void *) &set, sizeof (set));
+
+        /* set SO_KEEPALIVE option for socket */
+        set = 1;
+        setsockopt (sock, SOL_SOCKET, SO_KEEPALIVE, (void *) &set, sizeof (set));
+
+        /* set flag O_NONBLOCK on socket */
+        flags = fcntl (sock, F_GETFL);
+        if (flags == -1)
+            flags = 0;
+        fcntl (sock, F_SETFL, flags | O_NONBLOCK);
+
+        if (HOOK_CONNECT(hook_connect, res_local))
+        {
+            /* bind local hostname/IP if asked by user */
+            rc = -1;
+            for (ptr_loc = HOOK_CONNECT(hook_connect, res_local); ptr_loc;
+                 ptr_loc = ptr_loc->ai_next)
+            {
+                if (ptr_loc->ai_family != ptr_res->ai_family)
+                    continue;
+                rc = bind (sock, ptr_loc->ai_addr, ptr_loc->ai_addrlen);
+                if (rc == 0)
+                    break;
+            }
+            if (rc < 0)
+            {
+                HOOK_CONNECT(hook_connect, status) = WEECHAT_HOOK_CONNECT_LOCAL_HOSTNAME_ERROR;
+                close (sock);
+                continue;
+            }
+        }
+
+        HOOK_CONNECT(hook_connect, attempt_sock[index]) = sock;
+        HOOK_CONNECT(hook_connect, attempt_address[index]) = ptr_res;
+
+        /* connect to peer (non-blocking) */
+        if (connect (sock, ptr_res->ai_addr, ptr_res->ai_addrlen) == 0)
+        {
+            network_connect_attempt_ok (hook_connect, index);
+            return;
+        }
+        if (errno == EINPROGRESS)
+        {
+            HOOK_CONNECT(hook_connect, attempt_hook_fd[index]) =
+                hook_fd (hook_connect->plugin, sock, 0, 1, 0,
+                         &network_connect_attempt_fd_cb,
+                         hook_connect, NULL);
+        }
+        if (!HOOK_CONNECT(hook_connect, attempt_hook_fd[index]))
+        {
+            HOOK_CONNECT(hook_connect, status) = WEECHAT_HOOK_CONNECT_CONNECTION_REFUSED;
+            close (sock);
+            HOOK_CONNECT(hook_connect, attempt_sock[index]) = -1;
+            HOOK_CONNECT(hook_connect, attempt_address[index]) = NULL;
+            continue;
+        }
+
+        /* try next address if this one is not connected quickly */
+        if (HOOK_CONNECT(hook_connect, next_address) < HOOK_CONNECT(hook_connect, num_addresses))
+        {
+            HOOK_CONNECT(hook_connect, hook_attempt_timer) =
+                hook_timer (hook_connect->plugin,
+                            NETWORK_CONNECT_ATTEMPT_DELAY, 0, 1,
+                            &network_connect_attempt_timer_cb,
+                            hook_connect, NULL);
+        }
+        return;
+    }
+
+    /* some connections are still in progress? */
+    for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
+    {
+        if (HOOK_CONNECT(hook_connect, attempt_sock[i]) >= 0)
+            return;
     }
 
-    if (cb_error)
-        free (cb_error);
-    if (cb_ip_address)
-        free (cb_ip_address);
+    /* all addresses failed */
+    network_connect_error (hook_connect, HOOK_CONNECT(hook_connect, status),
+                           NULL);
+}
+
+/*
+ * Callback for a socket being connected: checks if the connection is OK.
+ */
+
+int
+network_connect_attempt_fd_cb (const void *pointer, void *data, int fd)
+{
+    struct t_hook *hook_connect;
+    int i, index, value;
+    socklen_t len;
+
+    /* make C compiler happy */
+    (void) data;
+
+    hook_connect = (struct t_hook *)pointer;
+
+    index = -1;
+    for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
+    {
+        if (HOOK_CONNECT(hook_connect, attempt_sock[i]) == fd)
+        {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0)
+        return WEECHAT_RC_OK;
+
+    /*
+     * the socket is writable: the option SO_ERROR is 0 if connect is OK
+     * (see man connect)
+     */
+    value = -1;
+    len = sizeof (value);
+    if ((getsockopt (fd, SOL_SOCKET, SO_ERROR, &value, &len) == 0)
+        && (value == 0))
+    {
+        network_connect_attempt_ok (hook_connect, index);
+        return WEECHAT_RC_OK;
+    }
+
+    /* connection failed: try next address now */
+    HOOK_CONNECT(hook_connect, status) = WEECHAT_HOOK_CONNECT_CONNECTION_REFUSED;
+    unhook (HOOK_CONNECT(hook_connect, attempt_hook_fd[index]));
+    HOOK_CONNECT(hook_connect, attempt_hook_fd[index]) = NULL;
+    close (fd);
+    HOOK_CONNECT(hook_connect, attempt_sock[index]) = -1;
+    HOOK_CONNECT(hook_connect, attempt_address[index]) = NULL;
+    network_connect_attempt_next (hook_connect);
 
     return WEECHAT_RC_OK;
 }
 
 /*
- * Connects with fork (called by hook_connect() only!).
+ * Timer callback to start the next connection attempt.
+ */
+
+int
+network_connect_attempt_timer_cb (const void *pointer, void *data,
+                                  int remaining_calls)
+{
+    struct t_hook *hook_connect;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) remaining_calls;
+
+    hook_connect = (struct t_hook *)pointer;
+
+    HOOK_CONNECT(hook_connect, hook_attempt_timer) = NULL;
+
+    network_connect_attempt_next (hook_connect);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Sorts addresses to try: groups of addresses (by family) are rotated
+ * according to the retry count, addresses are shuffled in each group, then
+ * families are interleaved (so that a broken IPv6 or IPv4 route delays the
+ * connection only by NETWORK_CONNECT_ATTEMPT_DELAY).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (the error is sent to callback and the hook is removed)
+ */
+
+int
+network_connect_sort_addresses (struct t_hook *hook_connect)
+{
+    struct addrinfo *ptr_res, **res_reorder, **addresses;
+    int retry, rand_num, i, j, k;
+    int num_groups, tmp_num_groups, num_hosts, tmp_host;
+    int last_af;
+
+    /*
+     * count all the groups of hosts by tracking family, e.g.
+     * 0 = [2001:db8::1, 2001:db8::2,
+     * 1 =  192.0.2.1, 192.0.2.2,
+     * 2 =  2002:c000:201::1, 2002:c000:201::2]
+     */
+    last_af = AF_UNSPEC;
+    num_groups = 0;
+    num_hosts = 0;
+    for (ptr_res = HOOK_CONNECT(hook_connect, res_remote); ptr_res;
+         ptr_res = ptr_res->ai_next)
+    {
+        if (ptr_res->ai_family != last_af)
+            if (last_af != AF_UNSPEC)
+                num_groups++;
+
+        num_hosts++;
+        last_af = ptr_res->ai_family;
+    }
+    if (last_af != AF_UNSPEC)
+        num_groups++;
+
+    if (num_groups == 0)
+    {
+        /* no IP addresses found (all AF_UNSPEC) */
+        network_connect_error (hook_connect,
+                               WEECHAT_HOOK_CONNECT_IP_ADDRESS_NOT_FOUND,
+                               NULL);
+        return 0;
+    }
+
+    res_reorder = malloc (sizeof (*res_reorder) * num_hosts);
+    addresses = malloc (sizeof (*addresses) * num_hosts);
+    if (!res_reorder || !addresses)
+    {
+        if (res_reorder)
+            free (res_reorder);
+        if (addresses)
+            free (addresses);
+        network_connect_error (hook_connect,
+                               WEECHAT_HOOK_CONNECT_MEMORY_ERROR, NULL);
+        return 0;
+    }
+
+    /* reorder groups */
+    retry = HOOK_CONNECT(hook_connect, retry) % num_groups;
+    i = 0;
+
+    last_af = AF_UNSPEC;
+    tmp_num_groups = 0;
+    tmp_host = i; /* start of current group */
+
+    /* top of list */
+    for (ptr_res = HOOK_CONNECT(hook_connect, res_remote); ptr_res;
+         ptr_res = ptr_res->ai_next)
+    {
+        if (ptr_res->ai_family != last_af)
+        {
+            if (last_af != AF_UNSPEC)
+                tmp_num_groups++;
+
+            tmp_host = i;
+        }
+
+        if (tmp_num_groups >= retry)
+        {
+            /* shuffle while adding */
+            rand_num = tmp_host + (rand () % ((i + 1) - tmp_host));
+            if (rand_num == i)
+                res_reorder[i++] = ptr_res;
+            else
+            {
+                res_reorder[i++] = res_reorder[rand_num];
+                res_reorder[rand_num] = ptr_res;
+            }
+        }
+
+        last_af = ptr_res->ai_family;
+    }
+
+    last_af = AF_UNSPEC;
+    tmp_num_groups = 0;
+    tmp_host = i; /* start of current group */
+
+    /* remainder of list */
+    for (ptr_res = HOOK_CONNECT(hook_connect, res_remote); ptr_res;
+         ptr_res = ptr_res->ai_next)
+    {
+        if (ptr_res->ai_family != last_af)
+        {
+            if (last_af != AF_UNSPEC)
+                tmp_num_groups++;
+
+            tmp_host = i;
+        }
+
+        if (tmp_num_groups < retry)
+        {
+            /* shuffle while adding */
+            rand_num = tmp_host + (rand () % ((i + 1) - tmp_host));
+            if (rand_num == i)
+                res_reorder[i++] = ptr_res;
+            else
+            {
+                res_reorder[i++] = res_reorder[rand_num];
+                res_reorder[rand_num] = ptr_res;
+            }
+        }
+        else
+            break;
+
+        last_af = ptr_res->ai_family;
+    }
+
+    /*
+     * interleave families: first address of first family, then first
+     * address of other families, then second address of first family, ...
+     */
+    j = 0;
+    k = 0;
+    for (i = 0; i < num_hosts; i++)
+    {
+        if ((i % 2 == 0) || (k >= num_hosts))
+        {
+            while ((j < num_hosts)
+                   && (res_reorder[j]->ai_family != res_reorder[0]->ai_family))
+            {
+                j++;
+            }
+            if (j < num_hosts)
+            {
+                addresses[i] = res_reorder[j++];
+                continue;
+            }
+        }
+        while ((k < num_hosts)
+               && (res_reorder[k]->ai_family == res_reorder[0]->ai_family))
+        {
+            k++;
+        }
+        if (k < num_hosts)
+        {
+            addresses[i] = res_reorder[k++];
+            continue;
+        }
+        while ((j < num_hosts)
+               && (res_reorder[j]->ai_family != res_reorder[0]->ai_family))
+        {
+            j++;
+        }
+        addresses[i] = res_reorder[j++];
+    }
+
+    free (res_reorder);
+
+    HOOK_CONNECT(hook_connect, addresses) = addresses;
+    HOOK_CONNECT(hook_connect, num_addresses) = num_hosts;
+    HOOK_CONNECT(hook_connect, next_address) = 0;
+
+    return 1;
+}
+
+/*
+ * Receives result of resolver for a connect hook, and starts the
+ * connection to the addresses found.
+ */
+
+void
+network_connect_resolved (struct t_hook *hook_connect,
+                          struct t_network_resolve *resolve)
+{
+    if (resolve->rc_remote != 0)
+    {
+        /* address not found */
+        network_connect_error (hook_connect,
+                               WEECHAT_HOOK_CONNECT_ADDRESS_NOT_FOUND,
+                               gai_strerror (resolve->rc_remote));
+        return;
+    }
+    if (!resolve->res_remote)
+    {
+        /* address not found */
+        network_connect_error (hook_connect,
+                               WEECHAT_HOOK_CONNECT_ADDRESS_NOT_FOUND, NULL);
+        return;
+    }
+
+    if (resolve->local_hostname)
+    {
+        if (resolve->rc_local != 0)
+        {
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_LOCAL_HOSTNAME_ERROR,
+                                   gai_strerror (resolve->rc_local));
+            return;
+        }
+        if (!resolve->res_local)
+        {
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_LOCAL_HOSTNAME_ERROR,
+                                   NULL);
+            return;
+        }
+    }
+
+    if (resolve->target_hostname)
+    {
+        /* socks4 proxy: the IPv4 address of peer is sent to proxy */
+        if (!resolve->target_ip[0])
+        {
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_PROXY_ERROR, NULL);
+            return;
+        }
+        HOOK_CONNECT(hook_connect, proxy_target_ip) =
+            strdup (resolve->target_ip);
+    }
+
+    /* addresses are now owned by the hook */
+    HOOK_CONNECT(hook_connect, res_remote) = resolve->res_remote;
+    resolve->res_remote = NULL;
+    HOOK_CONNECT(hook_connect, res_local) = resolve->res_local;
+    resolve->res_local = NULL;
+
+    if (!network_connect_sort_addresses (hook_connect))
+        return;
+
+    HOOK_CONNECT(hook_connect, status) = WEECHAT_HOOK_CONNECT_IP_ADDRESS_NOT_FOUND;
+    network_connect_attempt_next (hook_connect);
+}
+
+/*
+ * Starts connection (called by hook_connect() only!).
+ *
+ * The connection is made without blocking and without fork:
+ *   1. the addresses are resolved by a thread of resolver,
+ *   2. connections to addresses are attempted in parallel (non-blocking),
+ *   3. the handshake with proxy (if any) is made with non-blocking socket,
+ *   4. the GnuTLS handshake (if any) is made with non-blocking socket.
  */
 
 void
-network_connect_with_fork (struct t_hook *hook_connect)
+network_connect_start (struct t_hook *hook_connect)
 {
-    int child_pipe[2], child_socket[2], rc, i;
-    char str_error[1024];
+    struct t_proxy *ptr_proxy;
+    struct t_network_resolve *new_resolve;
+    char str_port[16];
 #ifdef HAVE_GNUTLS
+    int rc;
     const char *pos_error;
 #endif /* HAVE_GNUTLS */
-    pid_t pid;
 
 #ifdef HAVE_GNUTLS
     /* initialize GnuTLS if SSL asked */
@@ -1651,12 +2444,9 @@ network_connect_with_fork (struct t_hook *hook_connect)
     {
         if (gnutls_init (HOOK_CONNECT(hook_connect, gnutls_sess), GNUTLS_CLIENT) != GNUTLS_E_SUCCESS)
         {
-            (void) (HOOK_CONNECT(hook_connect, callback))
-                (hook_connect->callback_pointer,
-                 hook_connect->callback_data,
-                 WEECHAT_HOOK_CONNECT_GNUTLS_INIT_ERROR,
-                 0, -1, NULL, NULL);
-            unhook (hook_connect);
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_GNUTLS_INIT_ERROR,
+                                   NULL);
             return;
         }
         rc = gnutls_server_name_set (*HOOK_CONNECT(hook_connect, gnutls_sess),
@@ -1665,12 +2455,9 @@ network_connect_with_fork (struct t_hook *hook_connect)
                                      strlen (HOOK_CONNECT(hook_connect, address)));
         if (rc != GNUTLS_E_SUCCESS)
         {
-            (void) (HOOK_CONNECT(hook_connect, callback))
-                (hook_connect->callback_pointer,
-                 hook_connect->callback_data,
-                 WEECHAT_HOOK_CONNECT_GNUTLS_INIT_ERROR,
-                 0, -1, _("set server name indication (SNI) failed"), NULL);
-            unhook (hook_connect);
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_GNUTLS_INIT_ERROR,
+                                   _("set server name indication (SNI) failed"));
             return;
         }
         rc = gnutls_priority_set_direct (*HOOK_CONNECT(hook_connect, gnutls_sess),
@@ -1678,12 +2465,9 @@ network_connect_with_fork (struct t_hook *hook_connect)
                                          &pos_error);
         if (rc != GNUTLS_E_SUCCESS)
         {
-            (void) (HOOK_CONNECT(hook_connect, callback))
-                (hook_connect->callback_pointer,
-                 hook_connect->callback_data,
-                 WEECHAT_HOOK_CONNECT_GNUTLS_INIT_ERROR,
-                 0, -1, _("invalid priorities"), NULL);
-            unhook (hook_connect);
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_GNUTLS_INIT_ERROR,
+                                   _("invalid priorities"));
             return;
         }
         gnutls_credentials_set (*HOOK_CONNECT(hook_connect, gnutls_sess),
@@ -1694,87 +2478,68 @@ network_connect_with_fork (struct t_hook *hook_connect)
     }
 #endif /* HAVE_GNUTLS */
 
-    /* create pipe for child process */
-    if (pipe (child_pipe) < 0)
-    {
-        (void) (HOOK_CONNECT(hook_connect, callback))
-            (hook_connect->callback_pointer,
-             hook_connect->callback_data,
-             WEECHAT_HOOK_CONNECT_MEMORY_ERROR,
-             0, -1, "pipe", NULL);
-        unhook (hook_connect);
-        return;
-    }
-    HOOK_CONNECT(hook_connect, child_read) = child_pipe[0];
-    HOOK_CONNECT(hook_connect, child_write) = child_pipe[1];
-
-    if (hook_socketpair_ok)
+    ptr_proxy = NULL;
+    if (HOOK_CONNECT(hook_connect, proxy)
+        && HOOK_CONNECT(hook_connect, proxy)[0])
     {
-        /* create socket for child process */
-        if (socketpair (AF_LOCAL, SOCK_DGRAM, 0, child_socket) < 0)
+        ptr_proxy = proxy_search (HOOK_CONNECT(hook_connect, proxy));
+        if (!ptr_proxy)
         {
-            (void) (HOOK_CONNECT(hook_connect, callback))
-                (hook_connect->callback_pointer,
-                 hook_connect->callback_data,
-                 WEECHAT_HOOK_CONNECT_MEMORY_ERROR,
-                 0, -1, "socketpair", NULL);
-            unhook (hook_connect);
+            /* proxy not found */
+            network_connect_error (hook_connect,
+                                   WEECHAT_HOOK_CONNECT_PROXY_ERROR, NULL);
             return;
         }
-        HOOK_CONNECT(hook_connect, child_recv) = child_socket[0];
-        HOOK_CONNECT(hook_connect, child_send) = child_socket[1];
+    }
+
+    new_resolve = malloc (sizeof (*new_resolve));
+    if (!new_resolve)
+    {
+        network_connect_error (hook_connect,
+                               WEECHAT_HOOK_CONNECT_MEMORY_ERROR, NULL);
+        return;
+    }
+    memset (new_resolve, 0, sizeof (*new_resolve));
+    new_resolve->hook_connect = hook_connect;
+    if (ptr_proxy)
+    {
+        new_resolve->hostname = strdup (CONFIG_STRING(ptr_proxy->options[PROXY_OPTION_ADDRESS]));
+        snprintf (str_port, sizeof (str_port), "%d",
+                  CONFIG_INTEGER(ptr_proxy->options[PROXY_OPTION_PORT]));
+        new_resolve->family = (CONFIG_BOOLEAN(ptr_proxy->options[PROXY_OPTION_IPV6])) ?
+            AF_UNSPEC : AF_INET;
+        if (CONFIG_INTEGER(ptr_proxy->options[PROXY_OPTION_TYPE]) == PROXY_TYPE_SOCKS4)
+            new_resolve->target_hostname = strdup (HOOK_CONNECT(hook_connect, address));
     }
     else
     {
-        for (i = 0; i < HOOK_CONNECT_MAX_SOCKETS; i++)
-        {
-            HOOK_CONNECT(hook_connect, sock_v4[i]) = socket (AF_INET, SOCK_STREAM, 0);
-            HOOK_CONNECT(hook_connect, sock_v6[i]) = socket (AF_INET6, SOCK_STREAM, 0);
-        }
+        new_resolve->hostname = strdup (HOOK_CONNECT(hook_connect, address));
+        snprintf (str_port, sizeof (str_port), "%d",
+                  HOOK_CONNECT(hook_connect, port));
+        new_resolve->family = (HOOK_CONNECT(hook_connect, ipv6)) ?
+            AF_UNSPEC : AF_INET;
     }
+    new_resolve->service = strdup (str_port);
+    if (HOOK_CONNECT(hook_connect, local_hostname)
+        && HOOK_CONNECT(hook_connect, local_hostname)[0])
+    {
+        new_resolve->local_hostname = strdup (HOOK_CONNECT(hook_connect, local_hostname));
+    }
+
+    HOOK_CONNECT(hook_connect, hook_timer) = hook_timer (hook_connect->plugin,
+                                                         CONFIG_INTEGER(config_network_connection_timeout) * 1000,
+                                                         0, 1,
+                                                         &network_connect_timer_cb,
+                                                         hook_connect,
+                                                         NULL);
 
-    switch (pid = fork ())
+    if (!new_resolve->hostname || !new_resolve->service
+        || !network_resolve_add (new_resolve))
     {
-        /* fork failed */
-        case -1:
-            snprintf (str_error, sizeof (str_error),
-                      "fork error: %s",
-                      strerror (errno));
-            (void) (HOOK_CONNECT(hook_connect, callback))
-                (hook_connect->callback_pointer,
-                 hook_connect->callback_data,
-                 WEECHAT_HOOK_CONNECT_MEMORY_ERROR,
-                 0, -1, str_error, NULL);
-            unhook (hook_connect);
-            return;
-        /* child process */
-        case 0:
-            rc = setuid (getuid ());
-            (void) rc;
-            close (HOOK_CONNECT(hook_connect, child_read));
-            if (hook_socketpair_ok)
-                close (HOOK_CONNECT(hook_connect, child_recv));
-            network_connect_child (hook_connect);
-            _exit (EXIT_SUCCESS);
-    }
-    /* parent process */
-    HOOK_CONNECT(hook_connect, child_pid) = pid;
-    close (HOOK_CONNECT(hook_connect, child_write));
-    HOOK_CONNECT(hook_connect, child_write) = -1;
-    if (hook_socketpair_ok)
-    {
-        close (HOOK_CONNECT(hook_connect, child_send));
-        HOOK_CONNECT(hook_connect, child_send) = -1;
-    }
-    HOOK_CONNECT(hook_connect, hook_child_timer) = hook_timer (hook_connect->plugin,
-                                                               CONFIG_INTEGER(config_network_connection_timeout) * 1000,
-                                                               0, 1,
-                                                               &network_connect_child_timer_cb,
-                                                               hook_connect,
-                                                               NULL);
-    HOOK_CONNECT(hook_connect, hook_fd) = hook_fd (hook_connect->plugin,
-                                                   HOOK_CONNECT(hook_connect, child_read),
-                                                   1, 0, 0,
-                                                   &network_connect_child_read_cb,
-                                                   hook_connect, NULL);
+        network_resolve_free (new_resolve);
+        network_connect_error (hook_connect,
+                               WEECHAT_HOOK_CONNECT_MEMORY_ERROR, "resolve");
+        return;
+    }
+    HOOK_CONNECT(hook_connect, resolve) = new_resolve;
 }
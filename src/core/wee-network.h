@@ -22,9 +22,54 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netdb.h>
+
+/* number of threads to resolve addresses (for connect hooks) */
+#define NETWORK_RESOLVE_THREADS 4
+
+/* delay (in ms) before trying next address if connection is in progress */
+#define NETWORK_CONNECT_ATTEMPT_DELAY 250
 
 struct t_hook;
 
+/* steps of handshake with proxy (non-blocking) */
+
+enum t_network_proxy_step
+{
+    NETWORK_PROXY_STEP_INIT = 0,
+    NETWORK_PROXY_STEP_HTTP_SEND_CONNECT,
+    NETWORK_PROXY_STEP_HTTP_RECV_RESPONSE,
+    NETWORK_PROXY_STEP_SOCKS4_SEND_CONNECT,
+    NETWORK_PROXY_STEP_SOCKS4_RECV_RESPONSE,
+    NETWORK_PROXY_STEP_SOCKS5_SEND_METHOD,
+    NETWORK_PROXY_STEP_SOCKS5_RECV_METHOD,
+    NETWORK_PROXY_STEP_SOCKS5_SEND_AUTH,
+    NETWORK_PROXY_STEP_SOCKS5_RECV_AUTH,
+    NETWORK_PROXY_STEP_SOCKS5_SEND_CONNECT,
+    NETWORK_PROXY_STEP_SOCKS5_RECV_CONNECT,
+    NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS_LENGTH,
+    NETWORK_PROXY_STEP_SOCKS5_RECV_ADDRESS,
+};
+
+/* request for resolver (hostnames are resolved in a thread) */
+
+struct t_network_resolve
+{
+    struct t_hook *hook_connect;       /* connect hook (NULL if the hook    */
+                                       /* was removed while resolving)      */
+    char *hostname;                    /* hostname of peer (or proxy)       */
+    char *service;                     /* port of peer (or proxy)           */
+    int family;                        /* AF_UNSPEC or AF_INET              */
+    char *local_hostname;              /* local hostname (optional)         */
+    char *target_hostname;             /* peer to resolve in IPv4 (socks4)  */
+    int rc_remote;                     /* return code for hostname          */
+    struct addrinfo *res_remote;       /* addresses of hostname             */
+    int rc_local;                      /* return code for local hostname    */
+    struct addrinfo *res_local;        /* addresses of local hostname       */
+    char target_ip[NI_MAXHOST];        /* IPv4 of target_hostname           */
+    struct t_network_resolve *next_resolve; /* link to next request         */
+};
+
 struct t_network_socks4
 {
     char version;         /* 1 byte : socks version: 4 or 5                 */
@@ -44,6 +89,7 @@ struct t_network_socks5
 };
 
 extern int network_init_gnutls_ok;
+extern struct t_hook *network_resolve_hook_fd;
 
 extern void network_init_gcrypt ();
 extern void network_set_gnutls_ca_file ();
@@ -53,6 +99,7 @@ extern int network_pass_proxy (const char *proxy, int sock,
                                const char *address, int port);
 extern int network_connect_to (const char *proxy, struct sockaddr *address,
                                socklen_t address_length);
-extern void network_connect_with_fork (struct t_hook *hook_connect);
+extern void network_connect_free_data (struct t_hook *hook_connect);
+extern void network_connect_start (struct t_hook *hook_connect);
 
 #endif /* WEECHAT_NETWORK_H */
@@ -62,8 +62,24 @@
                     ((c >= 'A') && (c <= 'F')) ? c - 'A' + 10 :         \
                     c - '0')
 
+#define STRING_ICONV_CACHE_MAX 64      /* max iconv converters in cache     */
+
 struct t_hashtable *string_hashtable_shared = NULL;
 
+#ifdef HAVE_ICONV
+/* iconv converter kept in cache (by string_iconv) */
+struct t_string_iconv_cd
+{
+    iconv_t cd;                        /* iconv descriptor ((iconv_t)(-1)   */
+                                       /* if conversion is not supported)  */
+    int ascii;                         /* 1 if 7-bit chars are unchanged    */
+    int utf8;                          /* 1 if both charsets are UTF-8      */
+};
+
+struct t_hashtable *string_hashtable_iconv = NULL; /* iconv converters      */
+                                       /* by "from_code\tto_code"           */
+#endif /* HAVE_ICONV */
+
 
 /*
  * Defines a "strndup" function for systems where this function does not exist
@@ -1232,6 +1248,543 @@ string_has_highlight (const char *string, const char *highlight_words)
     return 0;
 }
 
+/*
+ * Creates a new structure for compiled highlight words (see function
+ * string_highlight_add_words to add words).
+ *
+ * Returns pointer to new structure, NULL if error.
+ */
+
+struct t_string_highlight *
+string_highlight_new ()
+{
+    struct t_string_highlight *new_highlight;
+
+    new_highlight = malloc (sizeof (*new_highlight));
+    if (!new_highlight)
+        return NULL;
+
+    new_highlight->words_count = 0;
+    new_highlight->words = NULL;
+    new_highlight->nodes_count = 0;
+    new_highlight->nodes = NULL;
+    new_highlight->max_chars = 0;
+    new_highlight->offsets = NULL;
+
+    return new_highlight;
+}
+
+/*
+ * Folds a char for the highlight automaton: comparison of chars is the same
+ * as function utf8_charcasecmp (only letters A-Z are converted to lower case).
+ */
+
+unsigned int
+string_highlight_fold_char (const char *string)
+{
+    wint_t wchar;
+
+    wchar = utf8_wide_char (string);
+    if ((wchar >= 'A') && (wchar <= 'Z'))
+        wchar += ('a' - 'A');
+
+    return (unsigned int)wchar;
+}
+
+/*
+ * Returns the child of a node in highlight automaton for a char (binary
+ * search in edges of node), -1 if not found.
+ *
+ * If "index_insert" is not NULL, it is set with the index of edge to insert
+ * if the char is not found.
+ */
+
+int
+string_highlight_node_child (struct t_string_highlight_node *node,
+                             unsigned int c, int *index_insert)
+{
+    int start, end, middle;
+
+    start = 0;
+    end = node->edges_count - 1;
+    while (start <= end)
+    {
+        middle = (start + end) / 2;
+        if (node->edges_char[middle] == c)
+            return node->edges_node[middle];
+        if (node->edges_char[middle] < c)
+            start = middle + 1;
+        else
+            end = middle - 1;
+    }
+
+    if (index_insert)
+        *index_insert = start;
+
+    return -1;
+}
+
+/*
+ * Adds a node in highlight automaton.
+ *
+ * Returns index of new node, -1 if error.
+ */
+
+int
+string_highlight_add_node (struct t_string_highlight *highlight)
+{
+    struct t_string_highlight_node *new_nodes, *ptr_node;
+
+    new_nodes = realloc (highlight->nodes,
+                         (highlight->nodes_count + 1) * sizeof (*new_nodes));
+    if (!new_nodes)
+        return -1;
+    highlight->nodes = new_nodes;
+
+    ptr_node = &highlight->nodes[highlight->nodes_count];
+    ptr_node->edges_count = 0;
+    ptr_node->edges_char = NULL;
+    ptr_node->edges_node = NULL;
+    ptr_node->fail = 0;
+    ptr_node->first_word = -1;
+    ptr_node->output = -1;
+
+    return (highlight->nodes_count)++;
+}
+
+/*
+ * Adds an edge from a node to a new node for a char in highlight automaton.
+ *
+ * Returns index of new node, -1 if error.
+ */
+
+int
+string_highlight_add_edge (struct t_string_highlight *highlight, int node,
+                           unsigned int c, int index_insert)
+{
+    struct t_string_highlight_node *ptr_node;
+    unsigned int *new_edges_char;
+    int *new_edges_node, new_node;
+
+    new_node = string_highlight_add_node (highlight);
+    if (new_node < 0)
+        return -1;
+
+    ptr_node = &highlight->nodes[node];
+    new_edges_char = realloc (ptr_node->edges_char,
+                              (ptr_node->edges_count + 1) *
+                              sizeof (*new_edges_char));
+    if (!new_edges_char)
+        return -1;
+    ptr_node->edges_char = new_edges_char;
+    new_edges_node = realloc (ptr_node->edges_node,
+                              (ptr_node->edges_count + 1) *
+                              sizeof (*new_edges_node));
+    if (!new_edges_node)
+        return -1;
+    ptr_node->edges_node = new_edges_node;
+
+    /* insert edge (edges are sorted by char) */
+    memmove (&ptr_node->edges_char[index_insert + 1],
+             &ptr_node->edges_char[index_insert],
+             (ptr_node->edges_count - index_insert) *
+             sizeof (*ptr_node->edges_char));
+    memmove (&ptr_node->edges_node[index_insert + 1],
+             &ptr_node->edges_node[index_insert],
+             (ptr_node->edges_count - index_insert) *
+             sizeof (*ptr_node->edges_node));
+    ptr_node->edges_char[index_insert] = c;
+    ptr_node->edges_node[index_insert] = new_node;
+    ptr_node->edges_count++;
+
+    return new_node;
+}
+
+/*
+ * Frees automaton of compiled highlight words (words are kept).
+ */
+
+void
+string_highlight_free_nodes (struct t_string_highlight *highlight)
+{
+    int i;
+
+    for (i = 0; i < highlight->nodes_count; i++)
+    {
+        if (highlight->nodes[i].edges_char)
+            free (highlight->nodes[i].edges_char);
+        if (highlight->nodes[i].edges_node)
+            free (highlight->nodes[i].edges_node);
+    }
+    if (highlight->nodes)
+    {
+        free (highlight->nodes);
+        highlight->nodes = NULL;
+    }
+    highlight->nodes_count = 0;
+    if (highlight->offsets)
+    {
+        free (highlight->offsets);
+        highlight->offsets = NULL;
+    }
+    highlight->max_chars = 0;
+}
+
+/*
+ * Builds the automaton with all highlight words: a trie of words (with
+ * folded chars), then the failure and output links (Aho-Corasick).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+string_highlight_build (struct t_string_highlight *highlight)
+{
+    struct t_string_highlight_node *ptr_node;
+    const char *ptr_word;
+    unsigned int c;
+    int i, node, child, index_insert, *queue, queue_start, queue_end;
+    int fail, next;
+
+    string_highlight_free_nodes (highlight);
+
+    if (string_highlight_add_node (highlight) < 0)
+        return 0;
+
+    /* build the trie */
+    for (i = 0; i < highlight->words_count; i++)
+    {
+        node = 0;
+        for (ptr_word = highlight->words[i].word; ptr_word[0];
+             ptr_word = utf8_next_char (ptr_word))
+        {
+            c = string_highlight_fold_char (ptr_word);
+            child = string_highlight_node_child (&highlight->nodes[node], c,
+                                                 &index_insert);
+            if (child < 0)
+            {
+                child = string_highlight_add_edge (highlight, node, c,
+                                                   index_insert);
+                if (child < 0)
+                    return 0;
+            }
+            node = child;
+        }
+        highlight->words[i].next_word = highlight->nodes[node].first_word;
+        highlight->nodes[node].first_word = i;
+        if (highlight->words[i].chars > highlight->max_chars)
+            highlight->max_chars = highlight->words[i].chars;
+    }
+
+    highlight->offsets = malloc ((highlight->max_chars + 1) *
+                                 sizeof (*highlight->offsets));
+    if (!highlight->offsets)
+        return 0;
+
+    /* build failure and output links (breadth-first traversal of trie) */
+    queue = malloc (highlight->nodes_count * sizeof (*queue));
+    if (!queue)
+        return 0;
+    queue_start = 0;
+    queue_end = 0;
+    queue[queue_end++] = 0;
+    while (queue_start < queue_end)
+    {
+        node = queue[queue_start++];
+        for (i = 0; i < highlight->nodes[node].edges_count; i++)
+        {
+            c = highlight->nodes[node].edges_char[i];
+            child = highlight->nodes[node].edges_node[i];
+            fail = 0;
+            if (node != 0)
+            {
+                fail = highlight->nodes[node].fail;
+                while (1)
+                {
+                    next = string_highlight_node_child (
+                        &highlight->nodes[fail], c, NULL);
+                    if (next >= 0)
+                    {
+                        fail = next;
+                        break;
+                    }
+                    if (fail == 0)
+                        break;
+                    fail = highlight->nodes[fail].fail;
+                }
+            }
+            ptr_node = &highlight->nodes[child];
+            ptr_node->fail = fail;
+            ptr_node->output = (highlight->nodes[fail].first_word >= 0) ?
+                fail : highlight->nodes[fail].output;
+            queue[queue_end++] = child;
+        }
+    }
+    free (queue);
+
+    return 1;
+}
+
+/*
+ * Adds highlight words in a structure of compiled highlight words.
+ *
+ * Format of words is the same as in function string_has_highlight: comma
+ * separated list of words, case insensitive by default, each word can begin
+ * with regex flags (like "(?-i)") and can begin or end with "*" for partial
+ * match.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+string_highlight_add_words (struct t_string_highlight *highlight,
+                            const char *highlight_words)
+{
+    struct t_string_highlight_word *new_words, *ptr_word;
+    char *words, *pos, *pos_end;
+    int end, length, wildcard_start, wildcard_end, flags;
+
+    if (!highlight)
+        return 0;
+
+    if (!highlight_words || !highlight_words[0])
+        return 1;
+
+    words = strdup (highlight_words);
+    if (!words)
+        return 0;
+
+    /* split words (same parsing as function string_has_highlight) */
+    pos = words;
+    end = 0;
+    while (!end)
+    {
+        flags = 0;
+        pos = (char *)string_regex_flags (pos, REG_ICASE, &flags);
+
+        pos_end = strchr (pos, ',');
+        if (!pos_end)
+        {
+            pos_end = strchr (pos, '\0');
+            end = 1;
+        }
+
+        length = pos_end - pos;
+        pos_end[0] = '\0';
+        wildcard_start = 0;
+        wildcard_end = 0;
+        if (length > 0)
+        {
+            if ((wildcard_start = (pos[0] == '*')))
+            {
+                pos++;
+                length--;
+            }
+            if ((wildcard_end = (*(pos_end - 1) == '*')))
+            {
+                *(pos_end - 1) = '\0';
+                length--;
+            }
+        }
+
+        if (length > 0)
+        {
+            new_words = realloc (highlight->words,
+                                 (highlight->words_count + 1) *
+                                 sizeof (*new_words));
+            if (!new_words)
+            {
+                free (words);
+                return 0;
+            }
+            highlight->words = new_words;
+            ptr_word = &highlight->words[highlight->words_count];
+            ptr_word->word = strdup (pos);
+            if (!ptr_word->word)
+            {
+                free (words);
+                return 0;
+            }
+            ptr_word->length = length;
+            ptr_word->chars = utf8_strlen (pos);
+            ptr_word->case_sensitive = (flags & REG_ICASE) ? 0 : 1;
+            ptr_word->wildcard_start = wildcard_start;
+            ptr_word->wildcard_end = wildcard_end;
+            ptr_word->next_word = -1;
+            ptr_word->pos_next_match = 0;
+            highlight->words_count++;
+        }
+
+        if (!end)
+            pos = pos_end + 1;
+    }
+
+    free (words);
+
+    return string_highlight_build (highlight);
+}
+
+/*
+ * Checks if a word found by the highlight automaton is a highlight
+ * (word boundaries and wildcards are checked like in function
+ * string_has_highlight).
+ *
+ * Returns:
+ *   1: highlight
+ *   0: no highlight
+ */
+
+int
+string_highlight_check_word (const char *string,
+                             struct t_string_highlight_word *word,
+                             int offset)
+{
+    const char *match, *match_pre, *match_post;
+    int startswith, endswith;
+
+    /* this match overlaps a previous match of the same word: ignore it */
+    if (offset < word->pos_next_match)
+        return 0;
+
+    match = string + offset;
+
+    /* the automaton ignores case: compare again for case sensitive words */
+    if (word->case_sensitive && (strncmp (match, word->word, word->length) != 0))
+        return 0;
+
+    match_pre = utf8_prev_char (string, match);
+    if (!match_pre)
+        match_pre = match - 1;
+    match_post = match + word->length;
+    startswith = ((match == string) || (!string_is_word_char_highlight (match_pre)));
+    endswith = ((!match_post[0]) || (!string_is_word_char_highlight (match_post)));
+    if ((word->wildcard_start && word->wildcard_end) ||
+        (!word->wildcard_start && !word->wildcard_end &&
+         startswith && endswith) ||
+        (word->wildcard_start && endswith) ||
+        (word->wildcard_end && startswith))
+    {
+        return 1;
+    }
+
+    /* search next match of this word after this one */
+    word->pos_next_match = offset + word->length;
+
+    return 0;
+}
+
+/*
+ * Checks if a string has a highlight, using compiled highlight words.
+ *
+ * The result is the same as function string_has_highlight, but the string is
+ * scanned only once for all words.
+ *
+ * Note: this function is not reentrant (the structure is used to store
+ * temporary data during the search).
+ *
+ * Returns:
+ *   1: string has a highlight
+ *   0: string has no highlight
+ */
+
+int
+string_has_highlight_compiled (const char *string,
+                               struct t_string_highlight *highlight)
+{
+    struct t_string_highlight_node *nodes;
+    const char *ptr_string;
+    unsigned int c;
+    int i, node, next, output, index_char, word;
+
+    if (!string || !string[0] || !highlight || (highlight->words_count == 0)
+        || !highlight->nodes || !highlight->offsets)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < highlight->words_count; i++)
+    {
+        highlight->words[i].pos_next_match = 0;
+    }
+
+    nodes = highlight->nodes;
+    node = 0;
+    index_char = 0;
+    for (ptr_string = string; ptr_string[0];
+         ptr_string = utf8_next_char (ptr_string))
+    {
+        c = string_highlight_fold_char (ptr_string);
+        highlight->offsets[index_char % highlight->max_chars] =
+            ptr_string - string;
+
+        /* follow failure links until a node has an edge for this char */
+        while (1)
+        {
+            next = string_highlight_node_child (&nodes[node], c, NULL);
+            if (next >= 0)
+            {
+                node = next;
+                break;
+            }
+            if (node == 0)
+                break;
+            node = nodes[node].fail;
+        }
+
+        /* check all words ending at this char */
+        for (output = (nodes[node].first_word >= 0) ? node : nodes[node].output;
+             output >= 0; output = nodes[output].output)
+        {
+            for (word = nodes[output].first_word; word >= 0;
+                 word = highlight->words[word].next_word)
+            {
+                if (string_highlight_check_word (
+                        string,
+                        &highlight->words[word],
+                        highlight->offsets[
+                            (index_char - highlight->words[word].chars + 1) %
+                            highlight->max_chars]))
+                {
+                    return 1;
+                }
+            }
+        }
+
+        index_char++;
+    }
+
+    /* no highlight found */
+    return 0;
+}
+
+/*
+ * Frees compiled highlight words.
+ */
+
+void
+string_highlight_free (struct t_string_highlight *highlight)
+{
+    int i;
+
+    if (!highlight)
+        return;
+
+    string_highlight_free_nodes (highlight);
+    for (i = 0; i < highlight->words_count; i++)
+    {
+        if (highlight->words[i].word)
+            free (highlight->words[i].word);
+    }
+    if (highlight->words)
+        free (highlight->words);
+
+    free (highlight);
+}
+
 /*
  * Checks if a string has a highlight using a compiled regular expression (any
  * match in string must be surrounded by delimiters).
@@ -2263,9 +2816,151 @@ string_free_split_command (char **split_command)
     }
 }
 
+#ifdef HAVE_ICONV
+/*
+ * Frees an iconv converter kept in cache.
+ */
+
+void
+string_iconv_free_cd_cb (struct t_hashtable *hashtable,
+                         const void *key, void *value)
+{
+    struct t_string_iconv_cd *ptr_cd;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    ptr_cd = (struct t_string_iconv_cd *)value;
+    if (ptr_cd)
+    {
+        if (ptr_cd->cd != (iconv_t)(-1))
+            iconv_close (ptr_cd->cd);
+        free (ptr_cd);
+    }
+}
+
+/*
+ * Checks if an iconv converter leaves 7-bit chars unchanged (this is the case
+ * for most charsets, but not for UTF-16, UTF-7, ISO-2022-JP, ...).
+ *
+ * Returns:
+ *   1: 7-bit chars are unchanged
+ *   0: 7-bit chars are changed (or error)
+ */
+
+int
+string_iconv_check_ascii (iconv_t cd)
+{
+    char ascii[127], output[1024], *ptr_inbuf, *ptr_outbuf;
+    size_t inbytesleft, outbytesleft;
+    int i, rc;
+
+    for (i = 0; i < 127; i++)
+    {
+        ascii[i] = i + 1;
+    }
+    ptr_inbuf = ascii;
+    inbytesleft = sizeof (ascii);
+    ptr_outbuf = output;
+    outbytesleft = sizeof (output);
+
+    rc = ((iconv (cd, (ICONV_CONST char **)(&ptr_inbuf), &inbytesleft,
+                  &ptr_outbuf, &outbytesleft) != (size_t)(-1))
+          && (iconv (cd, NULL, NULL, &ptr_outbuf, &outbytesleft) != (size_t)(-1))
+          && (inbytesleft == 0)
+          && (ptr_outbuf - output == sizeof (ascii))
+          && (memcmp (output, ascii, sizeof (ascii)) == 0));
+
+    /* reset conversion state */
+    iconv (cd, NULL, NULL, NULL, NULL);
+
+    return rc;
+}
+
+/*
+ * Checks if a charset is UTF-8.
+ *
+ * Returns:
+ *   1: charset is UTF-8
+ *   0: charset is not UTF-8
+ */
+
+int
+string_iconv_charset_is_utf8 (const char *charset)
+{
+    return ((string_strcasecmp (charset, "UTF-8") == 0)
+            || (string_strcasecmp (charset, "UTF8") == 0));
+}
+
+/*
+ * Gets an iconv converter: the converters are opened only one time and kept
+ * in cache.
+ *
+ * Returns pointer to converter, NULL if error.
+ */
+
+struct t_string_iconv_cd *
+string_iconv_get_cd (const char *from_code, const char *to_code)
+{
+    struct t_string_iconv_cd *ptr_cd;
+    char key[256];
+
+    if (!string_hashtable_iconv)
+    {
+        string_hashtable_iconv = hashtable_new (32,
+                                                WEECHAT_HASHTABLE_STRING,
+                                                WEECHAT_HASHTABLE_POINTER,
+                                                NULL, NULL);
+        if (!string_hashtable_iconv)
+            return NULL;
+        string_hashtable_iconv->callback_free_value = &string_iconv_free_cd_cb;
+    }
+
+    snprintf (key, sizeof (key), "%s\t%s", from_code, to_code);
+
+    ptr_cd = hashtable_get (string_hashtable_iconv, key);
+    if (ptr_cd)
+    {
+        /* reset conversion state */
+        if (ptr_cd->cd != (iconv_t)(-1))
+            iconv (ptr_cd->cd, NULL, NULL, NULL, NULL);
+        return ptr_cd;
+    }
+
+    /* not too many converters in cache */
+    if (string_hashtable_iconv->items_count >= STRING_ICONV_CACHE_MAX)
+        hashtable_remove_all (string_hashtable_iconv);
+
+    ptr_cd = malloc (sizeof (*ptr_cd));
+    if (!ptr_cd)
+        return NULL;
+
+    /* unsupported conversions are kept in cache too */
+    ptr_cd->cd = iconv_open (to_code, from_code);
+    ptr_cd->ascii = (ptr_cd->cd != (iconv_t)(-1)) ?
+        string_iconv_check_ascii (ptr_cd->cd) : 0;
+    ptr_cd->utf8 = string_iconv_charset_is_utf8 (from_code)
+        && string_iconv_charset_is_utf8 (to_code);
+
+    if (!hashtable_set (string_hashtable_iconv, key, ptr_cd))
+    {
+        string_iconv_free_cd_cb (NULL, NULL, ptr_cd);
+        return NULL;
+    }
+
+    return ptr_cd;
+}
+#endif /* HAVE_ICONV */
+
 /*
  * Converts a string to another charset.
  *
+ * The iconv converters are kept in cache. No conversion is done (the string
+ * is just duplicated) if the string has only 7-bit chars and that the
+ * converter does not change them, or if both charsets are UTF-8 and that the
+ * string is UTF-8 valid.
+ *
  * Note: result must be freed after use.
  */
 
@@ -2276,6 +2971,7 @@ string_iconv (int from_utf8, const char *from_code, const char *to_code,
     char *outbuf;
 
 #ifdef HAVE_ICONV
+    struct t_string_iconv_cd *ptr_cd;
     iconv_t cd;
     char *inbuf, *ptr_outbuf;
     const char *ptr_inbuf, *ptr_inbuf_shift, *next_char;
@@ -2290,11 +2986,16 @@ string_iconv (int from_utf8, const char *from_code, const char *to_code,
     if (from_code && from_code[0] && to_code && to_code[0]
         && (string_strcasecmp (from_code, to_code) != 0))
     {
-        cd = iconv_open (to_code, from_code);
-        if (cd == (iconv_t)(-1))
+        ptr_cd = string_iconv_get_cd (from_code, to_code);
+        if (!ptr_cd || (ptr_cd->cd == (iconv_t)(-1)))
+            outbuf = strdup (string);
+        else if (ptr_cd->ascii && !utf8_has_8bits (string))
+            outbuf = strdup (string);
+        else if (ptr_cd->utf8 && utf8_is_valid (string, -1, NULL))
             outbuf = strdup (string);
         else
         {
+            cd = ptr_cd->cd;
             inbuf = strdup (string);
             if (!inbuf)
                 return NULL;
@@ -2363,7 +3064,6 @@ string_iconv (int from_utf8, const char *from_code, const char *to_code,
                 ptr_inbuf = ptr_inbuf_shift;
             ptr_outbuf[0] = '\0';
             free (inbuf);
-            iconv_close (cd);
         }
     }
     else
@@ -3498,4 +4198,11 @@ string_end ()
         hashtable_free (string_hashtable_shared);
         string_hashtable_shared = NULL;
     }
+#ifdef HAVE_ICONV
+    if (string_hashtable_iconv)
+    {
+        hashtable_free (string_hashtable_iconv);
+        string_hashtable_iconv = NULL;
+    }
+#endif /* HAVE_ICONV */
 }
@@ -34,6 +34,43 @@ struct t_string_dyn
     string_dyn_size_t size;            /* size of string (including '\0')   */
 };
 
+/* highlight words compiled in an Aho-Corasick automaton */
+
+struct t_string_highlight_word
+{
+    char *word;                        /* word (without flags and "*")      */
+    int length;                        /* length of word (in bytes)         */
+    int chars;                         /* length of word (number of chars)  */
+    int case_sensitive;                /* 1 if word is case sensitive       */
+    int wildcard_start;                /* 1 if word begins with "*"         */
+    int wildcard_end;                  /* 1 if word ends with "*"           */
+    int next_word;                     /* next word ending on same node     */
+    int pos_next_match;                /* min offset for next match         */
+                                       /* (used during search)              */
+};
+
+struct t_string_highlight_node
+{
+    int edges_count;                   /* number of edges (children)        */
+    unsigned int *edges_char;          /* chars of edges (sorted)           */
+    int *edges_node;                   /* nodes of edges                    */
+    int fail;                          /* node for longest proper suffix    */
+    int first_word;                    /* first word ending on this node    */
+    int output;                        /* next node with words, by fail     */
+                                       /* links (-1 if none)                */
+};
+
+struct t_string_highlight
+{
+    int words_count;                   /* number of words                   */
+    struct t_string_highlight_word *words; /* words                         */
+    int nodes_count;                   /* number of nodes in automaton      */
+    struct t_string_highlight_node *nodes; /* nodes (0 is the root)         */
+    int max_chars;                     /* max length of a word (in chars)   */
+    int *offsets;                      /* offsets of last chars in string   */
+                                       /* (ring buffer, used during search) */
+};
+
 struct t_hashtable;
 
 extern char *string_strndup (const char *string, int length);
@@ -74,6 +111,12 @@ extern const char *string_regex_flags (const char *regex, int default_flags,
 extern int string_regcomp (void *preg, const char *regex, int default_flags);
 extern int string_has_highlight (const char *string,
                                  const char *highlight_words);
+extern struct t_string_highlight *string_highlight_new ();
+extern int string_highlight_add_words (struct t_string_highlight *highlight,
+                                       const char *highlight_words);
+extern int string_has_highlight_compiled (const char *string,
+                                          struct t_string_highlight *highlight);
+extern void string_highlight_free (struct t_string_highlight *highlight);
 extern int string_has_highlight_regex_compiled (const char *string,
                                                 regex_t *regex);
 extern int string_has_highlight_regex (const char *string, const char *regex);
@@ -28,8 +28,11 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "weechat.h"
 #include "wee-upgrade-file.h"
@@ -50,8 +53,8 @@ struct t_upgrade_file *last_upgrade_file = NULL;
  */
 
 void
-upgrade_file_error (struct t_upgrade_file *upgrade_file, char *message1,
-                    char *message2, char *file, int line)
+upgrade_file_error (struct t_upgrade_file *upgrade_file, const char *message1,
+                    const char *message2, char *file, int line)
 {
     gui_chat_printf (NULL,
                      _("%sError upgrading WeeChat with file \"%s\":"),
@@ -83,7 +86,7 @@ upgrade_file_error (struct t_upgrade_file *upgrade_file, char *message1,
 }
 
 /*
- * Writes an integer value in upgrade file.
+ * Writes data of write buffer in upgrade file.
  *
  * Returns:
  *   1: OK
@@ -91,16 +94,36 @@ upgrade_file_error (struct t_upgrade_file *upgrade_file, char *message1,
  */
 
 int
-upgrade_file_write_integer (struct t_upgrade_file *upgrade_file, int value)
+upgrade_file_flush (struct t_upgrade_file *upgrade_file)
 {
-    if (fwrite ((void *)(&value), sizeof (value), 1, upgrade_file->file) <= 0)
+    int pos, num_written;
+
+    if (!upgrade_file || (upgrade_file->fd < 0))
         return 0;
 
+    pos = 0;
+    while (pos < upgrade_file->write_buffer_size)
+    {
+        num_written = write (upgrade_file->fd,
+                             upgrade_file->write_buffer + pos,
+                             upgrade_file->write_buffer_size - pos);
+        if (num_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            upgrade_file->write_buffer_size = 0;
+            return 0;
+        }
+        pos += num_written;
+    }
+    upgrade_file->write_buffer_size = 0;
+
     return 1;
 }
 
 /*
- * Writes a time value in upgrade file.
+ * Writes raw data in upgrade file (data is buffered and written by chunks
+ * of UPGRADE_FILE_WRITE_BUFFER_SIZE bytes).
  *
  * Returns:
  *   1: OK
@@ -108,14 +131,68 @@ upgrade_file_write_integer (struct t_upgrade_file *upgrade_file, int value)
  */
 
 int
-upgrade_file_write_time (struct t_upgrade_file *upgrade_file, time_t date)
+upgrade_file_write_data (struct t_upgrade_file *upgrade_file,
+                         const void *data, int size)
 {
-    if (fwrite ((void *)(&date), sizeof (date), 1, upgrade_file->file) <= 0)
+    const char *ptr_data;
+    int size_copy;
+
+    if (!upgrade_file->write_buffer)
         return 0;
 
+    if (size <= 0)
+        return 1;
+
+    ptr_data = (const char *)data;
+    while (size > 0)
+    {
+        if (upgrade_file->write_buffer_size >= UPGRADE_FILE_WRITE_BUFFER_SIZE)
+        {
+            if (!upgrade_file_flush (upgrade_file))
+                return 0;
+        }
+        size_copy = UPGRADE_FILE_WRITE_BUFFER_SIZE
+            - upgrade_file->write_buffer_size;
+        if (size_copy > size)
+            size_copy = size;
+        memcpy (upgrade_file->write_buffer + upgrade_file->write_buffer_size,
+                ptr_data, size_copy);
+        upgrade_file->write_buffer_size += size_copy;
+        ptr_data += size_copy;
+        size -= size_copy;
+    }
+
     return 1;
 }
 
+/*
+ * Writes an integer value in upgrade file.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_write_integer (struct t_upgrade_file *upgrade_file, int value)
+{
+    return upgrade_file_write_data (upgrade_file, &value, sizeof (value));
+}
+
+/*
+ * Writes a time value in upgrade file.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_write_time (struct t_upgrade_file *upgrade_file, time_t date)
+{
+    return upgrade_file_write_data (upgrade_file, &date, sizeof (date));
+}
+
 /*
  * Writes a string in upgrade file.
  *
@@ -135,7 +212,7 @@ upgrade_file_write_string (struct t_upgrade_file *upgrade_file,
         length = strlen (string);
         if (!upgrade_file_write_integer (upgrade_file, length))
             return 0;
-        if (fwrite ((void *)string, length, 1, upgrade_file->file) <= 0)
+        if (!upgrade_file_write_data (upgrade_file, string, length))
             return 0;
     }
     else
@@ -163,7 +240,7 @@ upgrade_file_write_buffer (struct t_upgrade_file *upgrade_file, void *pointer,
     {
         if (!upgrade_file_write_integer (upgrade_file, size))
             return 0;
-        if (fwrite (pointer, size, 1, upgrade_file->file) <= 0)
+        if (!upgrade_file_write_data (upgrade_file, pointer, size))
             return 0;
     }
     else
@@ -175,10 +252,79 @@ upgrade_file_write_buffer (struct t_upgrade_file *upgrade_file, void *pointer,
     return 1;
 }
 
+/*
+ * Loads content of upgrade file in memory (read mode): the file is mapped in
+ * memory with mmap, or read in an allocated buffer if mmap fails.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_load_data (struct t_upgrade_file *upgrade_file, int fd)
+{
+    struct stat st;
+    void *ptr_map;
+    long pos;
+    ssize_t num_read;
+
+    if (fstat (fd, &st) != 0)
+        return 0;
+
+    upgrade_file->data = NULL;
+    upgrade_file->data_size = (long)st.st_size;
+    upgrade_file->data_mmap = 0;
+
+    if (upgrade_file->data_size == 0)
+        return 1;
+
+    ptr_map = mmap (NULL, (size_t)upgrade_file->data_size, PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+    if (ptr_map != MAP_FAILED)
+    {
+#ifdef MADV_SEQUENTIAL
+        (void) madvise (ptr_map, (size_t)upgrade_file->data_size,
+                        MADV_SEQUENTIAL);
+#endif /* MADV_SEQUENTIAL */
+        upgrade_file->data = (char *)ptr_map;
+        upgrade_file->data_mmap = 1;
+        return 1;
+    }
+
+    /* mmap failed: read the whole file in memory */
+    upgrade_file->data = malloc (upgrade_file->data_size);
+    if (!upgrade_file->data)
+        return 0;
+    pos = 0;
+    while (pos < upgrade_file->data_size)
+    {
+        num_read = read (fd, upgrade_file->data + pos,
+                         upgrade_file->data_size - pos);
+        if (num_read < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (num_read == 0)
+            break;
+        pos += num_read;
+    }
+    if (pos < upgrade_file->data_size)
+    {
+        free (upgrade_file->data);
+        upgrade_file->data = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
 /*
  * Creates an upgrade file.
  *
- * If write == 1, then opens in write mode, otherwise in read mode.
+ * If callback_read is NULL, then opens in write mode, otherwise in read mode.
  *
  * Returns pointer to new upgrade file, NULL if error.
  */
@@ -193,7 +339,7 @@ upgrade_file_new (const char *filename,
                   const void *callback_read_pointer,
                   void *callback_read_data)
 {
-    int length;
+    int length, fd, rc;
     struct t_upgrade_file *new_upgrade_file;
 
     if (!filename)
@@ -212,18 +358,45 @@ upgrade_file_new (const char *filename,
         }
         snprintf (new_upgrade_file->filename, length, "%s/%s.upgrade",
                   weechat_home, filename);
+        new_upgrade_file->fd = -1;
+        new_upgrade_file->write_buffer = NULL;
+        new_upgrade_file->write_buffer_size = 0;
+        new_upgrade_file->data = NULL;
+        new_upgrade_file->data_size = 0;
+        new_upgrade_file->data_pos = 0;
+        new_upgrade_file->version = UPGRADE_FILE_VERSION;
+        new_upgrade_file->data_mmap = 0;
+        new_upgrade_file->records = NULL;
+        new_upgrade_file->records_size = 0;
+        new_upgrade_file->count_objects = 0;
+        new_upgrade_file->count_records = 0;
         new_upgrade_file->callback_read = callback_read;
+        new_upgrade_file->callback_read_record = NULL;
         new_upgrade_file->callback_read_pointer = callback_read_pointer;
         new_upgrade_file->callback_read_data = callback_read_data;
 
         /* open file in read or write mode */
         if (callback_read)
-            new_upgrade_file->file = fopen (new_upgrade_file->filename, "rb");
+        {
+            fd = open (new_upgrade_file->filename, O_RDONLY);
+            rc = (fd >= 0) ? upgrade_file_load_data (new_upgrade_file, fd) : 0;
+            if (fd >= 0)
+                close (fd);
+        }
         else
-            new_upgrade_file->file = fopen (new_upgrade_file->filename, "wb");
+        {
+            new_upgrade_file->write_buffer = malloc (
+                UPGRADE_FILE_WRITE_BUFFER_SIZE);
+            new_upgrade_file->fd = (new_upgrade_file->write_buffer) ?
+                open (new_upgrade_file->filename,
+                      O_WRONLY | O_CREAT | O_TRUNC, 0600) : -1;
+            rc = (new_upgrade_file->fd >= 0);
+        }
 
-        if (!new_upgrade_file->file)
+        if (!rc)
         {
+            if (new_upgrade_file->write_buffer)
+                free (new_upgrade_file->write_buffer);
             free (new_upgrade_file->filename);
             free (new_upgrade_file);
             return NULL;
@@ -234,8 +407,10 @@ upgrade_file_new (const char *filename,
         {
             chmod (new_upgrade_file->filename, 0600);
 
-            /* write signature */
+            /* write signature and version of format */
             upgrade_file_write_string (new_upgrade_file, UPGRADE_SIGNATURE);
+            upgrade_file_write_integer (new_upgrade_file,
+                                        UPGRADE_FILE_VERSION);
         }
 
         /* init positions */
@@ -255,6 +430,244 @@ upgrade_file_new (const char *filename,
     return new_upgrade_file;
 }
 
+/*
+ * Frees a record schema.
+ */
+
+void
+upgrade_file_record_free (struct t_upgrade_record *record)
+{
+    if (!record)
+        return;
+
+    if (record->fields_names)
+        string_free_split (record->fields_names);
+    if (record->fields_types)
+        free (record->fields_types);
+    if (record->values)
+        free (record->values);
+    if (record->sizes)
+        free (record->sizes);
+
+    free (record);
+}
+
+/*
+ * Creates a record schema with fields (format: "type:name,type:name,...",
+ * same format as fields of infolist), and adds it in upgrade file (replacing
+ * any schema with same object id).
+ *
+ * Allowed types are: 'i' (integer), 's' (string), 't' (time), 'b' (buffer).
+ *
+ * Returns pointer to new record, NULL if error.
+ */
+
+struct t_upgrade_record *
+upgrade_file_record_new (struct t_upgrade_file *upgrade_file, int object_id,
+                         const char *fields)
+{
+    struct t_upgrade_record *new_record, **new_records;
+    char **argv;
+    int i, argc, new_size;
+
+    if ((object_id < 0) || !fields || !fields[0])
+        return NULL;
+
+    argv = string_split (fields, ",", 0, 0, &argc);
+    if (!argv || (argc <= 0))
+    {
+        if (argv)
+            string_free_split (argv);
+        return NULL;
+    }
+
+    new_record = malloc (sizeof (*new_record));
+    if (!new_record)
+    {
+        string_free_split (argv);
+        return NULL;
+    }
+    new_record->object_id = object_id;
+    new_record->fields_count = argc;
+    new_record->fields_names = argv;
+    new_record->fields_types = malloc (argc);
+    new_record->values = malloc (argc * sizeof (new_record->values[0]));
+    new_record->sizes = malloc (argc * sizeof (new_record->sizes[0]));
+    if (!new_record->fields_types || !new_record->values || !new_record->sizes)
+    {
+        upgrade_file_record_free (new_record);
+        return NULL;
+    }
+    for (i = 0; i < argc; i++)
+    {
+        if (!strchr ("istb", argv[i][0]) || (argv[i][1] != ':')
+            || !argv[i][2])
+        {
+            upgrade_file_record_free (new_record);
+            return NULL;
+        }
+        new_record->fields_types[i] = argv[i][0];
+        /* keep only the name in fields_names */
+        memmove (argv[i], argv[i] + 2, strlen (argv[i] + 2) + 1);
+        new_record->values[i] = NULL;
+        new_record->sizes[i] = 0;
+    }
+
+    /* add record in upgrade file */
+    if (object_id >= upgrade_file->records_size)
+    {
+        new_size = object_id + 8;
+        new_records = realloc (upgrade_file->records,
+                               new_size * sizeof (upgrade_file->records[0]));
+        if (!new_records)
+        {
+            upgrade_file_record_free (new_record);
+            return NULL;
+        }
+        for (i = upgrade_file->records_size; i < new_size; i++)
+        {
+            new_records[i] = NULL;
+        }
+        upgrade_file->records = new_records;
+        upgrade_file->records_size = new_size;
+    }
+    upgrade_file_record_free (upgrade_file->records[object_id]);
+    upgrade_file->records[object_id] = new_record;
+
+    return new_record;
+}
+
+/*
+ * Searches a record schema by object id.
+ *
+ * Returns pointer to record found, NULL if not found.
+ */
+
+struct t_upgrade_record *
+upgrade_file_record_search (struct t_upgrade_file *upgrade_file,
+                            int object_id)
+{
+    if ((object_id < 0) || (object_id >= upgrade_file->records_size))
+        return NULL;
+
+    return upgrade_file->records[object_id];
+}
+
+/*
+ * Writes schema of records for an object id in upgrade file; fields have same
+ * format as fields of infolist ("type:name,type:name,...").
+ *
+ * The schema must be written before records with this object id.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_write_schema (struct t_upgrade_file *upgrade_file, int object_id,
+                           const char *fields)
+{
+    if (!upgrade_file || (upgrade_file->fd < 0))
+        return 0;
+
+    if (!upgrade_file_record_new (upgrade_file, object_id, fields))
+    {
+        UPGRADE_ERROR(_("write - schema"), fields);
+        return 0;
+    }
+
+    if (!upgrade_file_write_integer (upgrade_file, UPGRADE_TYPE_SCHEMA)
+        || !upgrade_file_write_integer (upgrade_file, object_id)
+        || !upgrade_file_write_string (upgrade_file, fields))
+    {
+        UPGRADE_ERROR(_("write - schema"), fields);
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Writes a record in upgrade file: values are given as arguments, in the
+ * order of fields of schema, with these C types:
+ *   'i': int
+ *   's': const char * (can be NULL)
+ *   't': time_t
+ *   'b': void *, int (pointer and size)
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_write_record (struct t_upgrade_file *upgrade_file,
+                           int object_id, ...)
+{
+    struct t_upgrade_record *ptr_record;
+    va_list args;
+    const char *ptr_string;
+    void *ptr_buffer;
+    int i, rc, size;
+
+    if (!upgrade_file || (upgrade_file->fd < 0))
+        return 0;
+
+    ptr_record = upgrade_file_record_search (upgrade_file, object_id);
+    if (!ptr_record)
+    {
+        UPGRADE_ERROR(_("write - record without schema"), "");
+        return 0;
+    }
+
+    if (!upgrade_file_write_integer (upgrade_file, UPGRADE_TYPE_RECORD)
+        || !upgrade_file_write_integer (upgrade_file, object_id))
+    {
+        UPGRADE_ERROR(_("write - object type"), "record");
+        return 0;
+    }
+
+    rc = 1;
+    va_start (args, object_id);
+    for (i = 0; rc && (i < ptr_record->fields_count); i++)
+    {
+        switch (ptr_record->fields_types[i])
+        {
+            case 'i':
+                rc = upgrade_file_write_integer (upgrade_file,
+                                                 va_arg (args, int));
+                break;
+            case 's':
+                /* string is written with its final '\0' */
+                ptr_string = va_arg (args, const char *);
+                size = (ptr_string) ? (int)strlen (ptr_string) + 1 : 0;
+                rc = upgrade_file_write_integer (upgrade_file, size)
+                    && upgrade_file_write_data (upgrade_file, ptr_string, size);
+                break;
+            case 't':
+                rc = upgrade_file_write_time (upgrade_file,
+                                              va_arg (args, time_t));
+                break;
+            case 'b':
+                ptr_buffer = va_arg (args, void *);
+                size = va_arg (args, int);
+                rc = upgrade_file_write_buffer (upgrade_file, ptr_buffer, size);
+                break;
+        }
+    }
+    va_end (args);
+
+    if (!rc)
+    {
+        UPGRADE_ERROR(_("write - variable"),
+                      ptr_record->fields_names[i - 1]);
+        return 0;
+    }
+
+    return 1;
+}
+
 /*
  * Writes an object in upgrade file.
  *
@@ -412,7 +825,7 @@ upgrade_file_write_object (struct t_upgrade_file *upgrade_file, int object_id,
 }
 
 /*
- * Reads an integer in upgrade file.
+ * Reads raw data in upgrade file (if data is NULL, the data is skipped).
  *
  * Returns:
  *   1: OK
@@ -420,24 +833,39 @@ upgrade_file_write_object (struct t_upgrade_file *upgrade_file, int object_id,
  */
 
 int
-upgrade_file_read_integer (struct t_upgrade_file *upgrade_file, int *value)
+upgrade_file_read_data (struct t_upgrade_file *upgrade_file, void *data,
+                        int size)
 {
-    upgrade_file->last_read_pos = ftell (upgrade_file->file);
-    upgrade_file->last_read_length = sizeof (*value);
+    upgrade_file->last_read_pos = upgrade_file->data_pos;
+    upgrade_file->last_read_length = size;
 
-    if (value)
-    {
-        if (fread ((void *)value, sizeof (*value), 1, upgrade_file->file) <= 0)
-            return 0;
-    }
-    else
+    if ((size < 0)
+        || (size > upgrade_file->data_size - upgrade_file->data_pos))
     {
-        if (fseek (upgrade_file->file, sizeof (*value), SEEK_CUR) < 0)
-            return 0;
+        return 0;
     }
+
+    if (data)
+        memcpy (data, upgrade_file->data + upgrade_file->data_pos, size);
+    upgrade_file->data_pos += size;
+
     return 1;
 }
 
+/*
+ * Reads an integer in upgrade file.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_read_integer (struct t_upgrade_file *upgrade_file, int *value)
+{
+    return upgrade_file_read_data (upgrade_file, value, sizeof (*value));
+}
+
 /*
  * Reads a string in upgrade file.
  *
@@ -460,32 +888,23 @@ upgrade_file_read_string (struct t_upgrade_file *upgrade_file, char **string)
     if (!upgrade_file_read_integer (upgrade_file, &length))
         return 0;
 
-    upgrade_file->last_read_pos = ftell (upgrade_file->file);
-    upgrade_file->last_read_length = length;
-
-    if (string)
+    if (string && (length > 0))
     {
-        if (length == 0)
-            return 1;
-
         (*string) = malloc (length + 1);
         if (!(*string))
             return 0;
 
-        if (fread ((void *)(*string), length, 1, upgrade_file->file) <= 0)
+        if (!upgrade_file_read_data (upgrade_file, *string, length))
         {
             free (*string);
             *string = NULL;
             return 0;
         }
         (*string)[length] = '\0';
+        return 1;
     }
-    else
-    {
-        if (fseek (upgrade_file->file, length, SEEK_CUR) < 0)
-            return 0;
-    }
-    return 1;
+
+    return upgrade_file_read_data (upgrade_file, NULL, length);
 }
 
 /*
@@ -514,28 +933,245 @@ upgrade_file_read_buffer (struct t_upgrade_file *upgrade_file,
 
     if (*size > 0)
     {
-        upgrade_file->last_read_pos = ftell (upgrade_file->file);
-        upgrade_file->last_read_length = *size;
-
         *buffer = malloc (*size);
+        if (!upgrade_file_read_data (upgrade_file, *buffer, *size))
+            return 0;
+    }
 
-        if (*buffer)
-        {
-            if (fread (*buffer, *size, 1, upgrade_file->file) <= 0)
-                return 0;
-        }
-        else
+    return 1;
+}
+
+/*
+ * Reads time in upgrade file.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_read_time (struct t_upgrade_file *upgrade_file, time_t *time)
+{
+    return upgrade_file_read_data (upgrade_file, time, sizeof (*time));
+}
+
+/*
+ * Searches a field in a record.
+ *
+ * Returns index of field, -1 if not found.
+ */
+
+int
+upgrade_file_record_search_field (struct t_upgrade_record *record,
+                                  const char *name)
+{
+    int i;
+
+    if (!record || !name)
+        return -1;
+
+    for (i = 0; i < record->fields_count; i++)
+    {
+        if (strcmp (record->fields_names[i], name) == 0)
+            return i;
+    }
+
+    /* field not found */
+    return -1;
+}
+
+/*
+ * Gets integer value of a field in current record.
+ *
+ * Returns 0 if the field is not found or is not an integer.
+ */
+
+int
+upgrade_file_record_integer (struct t_upgrade_record *record, int index)
+{
+    int value;
+
+    if (!record || (index < 0) || (index >= record->fields_count)
+        || (record->fields_types[index] != 'i') || !record->values[index])
+    {
+        return 0;
+    }
+
+    memcpy (&value, record->values[index], sizeof (value));
+    return value;
+}
+
+/*
+ * Gets string value of a field in current record (pointer in the content of
+ * upgrade file, it must not be freed and is valid only in the read callback).
+ *
+ * Returns NULL if the field is not found, is not a string or is NULL.
+ */
+
+const char *
+upgrade_file_record_string (struct t_upgrade_record *record, int index)
+{
+    if (!record || (index < 0) || (index >= record->fields_count)
+        || (record->fields_types[index] != 's'))
+    {
+        return NULL;
+    }
+
+    return record->values[index];
+}
+
+/*
+ * Gets time value of a field in current record.
+ *
+ * Returns 0 if the field is not found or is not a time.
+ */
+
+time_t
+upgrade_file_record_time (struct t_upgrade_record *record, int index)
+{
+    time_t value;
+
+    if (!record || (index < 0) || (index >= record->fields_count)
+        || (record->fields_types[index] != 't') || !record->values[index])
+    {
+        return 0;
+    }
+
+    memcpy (&value, record->values[index], sizeof (value));
+    return value;
+}
+
+/*
+ * Gets buffer value of a field in current record (pointer in the content of
+ * upgrade file, it may be not aligned: the content must be copied with
+ * memcpy).
+ *
+ * Returns NULL if the field is not found, is not a buffer or is empty.
+ */
+
+const void *
+upgrade_file_record_buffer (struct t_upgrade_record *record, int index,
+                            int *size)
+{
+    if (size)
+        *size = 0;
+
+    if (!record || (index < 0) || (index >= record->fields_count)
+        || (record->fields_types[index] != 'b') || !record->values[index])
+    {
+        return NULL;
+    }
+
+    if (size)
+        *size = record->sizes[index];
+    return record->values[index];
+}
+
+/*
+ * Converts current record to an infolist (used if there is no callback for
+ * records).
+ *
+ * Returns pointer to new infolist, NULL if error.
+ */
+
+struct t_infolist *
+upgrade_file_record_to_infolist (struct t_upgrade_record *record)
+{
+    struct t_infolist *ptr_infolist;
+    struct t_infolist_item *ptr_item;
+    const void *ptr_buffer;
+    int i, size;
+
+    ptr_infolist = infolist_new (NULL);
+    if (!ptr_infolist)
+        return NULL;
+
+    ptr_item = infolist_new_item (ptr_infolist);
+    if (!ptr_item)
+    {
+        infolist_free (ptr_infolist);
+        return NULL;
+    }
+
+    for (i = 0; i < record->fields_count; i++)
+    {
+        switch (record->fields_types[i])
         {
-            if (fseek (upgrade_file->file, *size, SEEK_CUR) < 0)
-                return 0;
+            case 'i':
+                infolist_new_var_integer (
+                    ptr_item, record->fields_names[i],
+                    upgrade_file_record_integer (record, i));
+                break;
+            case 's':
+                infolist_new_var_string (
+                    ptr_item, record->fields_names[i],
+                    upgrade_file_record_string (record, i));
+                break;
+            case 't':
+                infolist_new_var_time (
+                    ptr_item, record->fields_names[i],
+                    upgrade_file_record_time (record, i));
+                break;
+            case 'b':
+                ptr_buffer = upgrade_file_record_buffer (record, i, &size);
+                if (ptr_buffer)
+                {
+                    infolist_new_var_buffer (ptr_item,
+                                             record->fields_names[i],
+                                             (void *)ptr_buffer, size);
+                }
+                break;
         }
     }
 
+    return ptr_infolist;
+}
+
+/*
+ * Reads a schema in upgrade file.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_file_read_schema (struct t_upgrade_file *upgrade_file)
+{
+    int object_id;
+    char *fields;
+
+    if (!upgrade_file_read_integer (upgrade_file, &object_id))
+    {
+        UPGRADE_ERROR(_("read - object id"), "");
+        return 0;
+    }
+
+    fields = NULL;
+    if (!upgrade_file_read_string (upgrade_file, &fields) || !fields)
+    {
+        UPGRADE_ERROR(_("read - schema"), "");
+        if (fields)
+            free (fields);
+        return 0;
+    }
+
+    if (!upgrade_file_record_new (upgrade_file, object_id, fields))
+    {
+        UPGRADE_ERROR(_("read - schema"), fields);
+        free (fields);
+        return 0;
+    }
+
+    free (fields);
+
     return 1;
 }
 
 /*
- * Reads time in upgrade file.
+ * Reads a record in upgrade file and calls read callback.
+ *
+ * Values of record are not copied: they point to the content of upgrade file.
  *
  * Returns:
  *   1: OK
@@ -543,23 +1179,81 @@ upgrade_file_read_buffer (struct t_upgrade_file *upgrade_file,
  */
 
 int
-upgrade_file_read_time (struct t_upgrade_file *upgrade_file, time_t *time)
+upgrade_file_read_record (struct t_upgrade_file *upgrade_file)
 {
-    upgrade_file->last_read_pos = ftell (upgrade_file->file);
-    upgrade_file->last_read_length = sizeof (*time);
+    struct t_upgrade_record *ptr_record;
+    struct t_infolist *ptr_infolist;
+    int i, object_id, size, rc;
+
+    if (!upgrade_file_read_integer (upgrade_file, &object_id))
+    {
+        UPGRADE_ERROR(_("read - object id"), "");
+        return 0;
+    }
 
-    if (time)
+    ptr_record = upgrade_file_record_search (upgrade_file, object_id);
+    if (!ptr_record)
     {
-        if (fread ((void *)time, sizeof (*time), 1, upgrade_file->file) <= 0)
+        UPGRADE_ERROR(_("read - record without schema"), "");
+        return 0;
+    }
+
+    for (i = 0; i < ptr_record->fields_count; i++)
+    {
+        switch (ptr_record->fields_types[i])
+        {
+            case 'i':
+                size = sizeof (int);
+                break;
+            case 't':
+                size = sizeof (time_t);
+                break;
+            default:
+                if (!upgrade_file_read_integer (upgrade_file, &size))
+                    size = -1;
+                break;
+        }
+        ptr_record->values[i] = (size > 0) ?
+            upgrade_file->data + upgrade_file->data_pos : NULL;
+        ptr_record->sizes[i] = size;
+        if (!upgrade_file_read_data (upgrade_file, NULL, size)
+            || ((ptr_record->fields_types[i] == 's') && (size > 0)
+                && (ptr_record->values[i][size - 1] != '\0')))
+        {
+            UPGRADE_ERROR(_("read - variable"), ptr_record->fields_names[i]);
             return 0;
+        }
     }
-    else
+
+    upgrade_file->count_records++;
+
+    rc = WEECHAT_RC_OK;
+    if (upgrade_file->callback_read_record)
     {
-        if (fseek (upgrade_file->file, sizeof (*time), SEEK_CUR) < 0)
+        rc = (int)(upgrade_file->callback_read_record) (
+            upgrade_file->callback_read_pointer,
+            upgrade_file->callback_read_data,
+            upgrade_file,
+            ptr_record);
+    }
+    else if (upgrade_file->callback_read)
+    {
+        ptr_infolist = upgrade_file_record_to_infolist (ptr_record);
+        if (!ptr_infolist)
+        {
+            UPGRADE_ERROR(_("read - infolist creation"), "");
             return 0;
+        }
+        rc = (int)(upgrade_file->callback_read) (
+            upgrade_file->callback_read_pointer,
+            upgrade_file->callback_read_data,
+            upgrade_file,
+            object_id,
+            ptr_infolist);
+        infolist_free (ptr_infolist);
     }
 
-    return 1;
+    return (rc == WEECHAT_RC_ERROR) ? 0 : 1;
 }
 
 /*
@@ -589,17 +1283,31 @@ upgrade_file_read_object (struct t_upgrade_file *upgrade_file)
 
     if (!upgrade_file_read_integer (upgrade_file, &type))
     {
-        if (feof (upgrade_file->file))
-            rc = 1;
-        else
-            UPGRADE_ERROR(_("read - object type"), "");
+        UPGRADE_ERROR(_("read - object type"), "");
         goto end;
     }
 
-    if (type != UPGRADE_TYPE_OBJECT_START)
+    switch (type)
     {
-        UPGRADE_ERROR(_("read - bad object type ('object start' expected)"), "");
-        goto end;
+        case UPGRADE_TYPE_OBJECT_START:
+            break;
+        case UPGRADE_TYPE_SCHEMA:
+            if (upgrade_file->version < 2)
+            {
+                UPGRADE_ERROR(_("read - bad object type (schema in format 1)"), "");
+                goto end;
+            }
+            return upgrade_file_read_schema (upgrade_file);
+        case UPGRADE_TYPE_RECORD:
+            if (upgrade_file->version < 2)
+            {
+                UPGRADE_ERROR(_("read - bad object type (record in format 1)"), "");
+                goto end;
+            }
+            return upgrade_file_read_record (upgrade_file);
+        default:
+            UPGRADE_ERROR(_("read - bad object type ('object start' expected)"), "");
+            goto end;
     }
 
     if (!upgrade_file_read_integer (upgrade_file, &object_id))
@@ -692,6 +1400,8 @@ upgrade_file_read_object (struct t_upgrade_file *upgrade_file)
 
     rc = 1;
 
+    upgrade_file->count_objects++;
+
     if (upgrade_file->callback_read)
     {
         if ((int)(upgrade_file->callback_read) (
@@ -729,7 +1439,7 @@ end:
 int
 upgrade_file_read (struct t_upgrade_file *upgrade_file)
 {
-    char *signature;
+    char *signature, str_version[32];
 
     if (!upgrade_file || !upgrade_file->callback_read)
         return 0;
@@ -741,7 +1451,21 @@ upgrade_file_read (struct t_upgrade_file *upgrade_file)
         return 0;
     }
 
-    if (!signature || (strcmp (signature, UPGRADE_SIGNATURE) != 0))
+    if (signature && (strcmp (signature, UPGRADE_SIGNATURE) == 0))
+    {
+        free (signature);
+        if (!upgrade_file_read_integer (upgrade_file, &upgrade_file->version))
+        {
+            UPGRADE_ERROR(_("read - version not found"), "");
+            return 0;
+        }
+    }
+    else if (signature && (strcmp (signature, UPGRADE_SIGNATURE_V1) == 0))
+    {
+        free (signature);
+        upgrade_file->version = 1;
+    }
+    else
     {
         UPGRADE_ERROR(_("read - bad signature (upgrade file format may have "
                         "changed since last version)"), "");
@@ -750,9 +1474,17 @@ upgrade_file_read (struct t_upgrade_file *upgrade_file)
         return 0;
     }
 
-    free (signature);
+    if ((upgrade_file->version < 1)
+        || (upgrade_file->version > UPGRADE_FILE_VERSION))
+    {
+        snprintf (str_version, sizeof (str_version),
+                  "%d", upgrade_file->version);
+        UPGRADE_ERROR(_("read - unsupported upgrade file version"),
+                      str_version);
+        return 0;
+    }
 
-    while (!feof (upgrade_file->file))
+    while (upgrade_file->data_pos < upgrade_file->data_size)
     {
         if (!upgrade_file_read_object (upgrade_file))
             return 0;
@@ -768,13 +1500,35 @@ upgrade_file_read (struct t_upgrade_file *upgrade_file)
 void
 upgrade_file_close (struct t_upgrade_file *upgrade_file)
 {
+    int i;
+
     if (!upgrade_file)
         return;
 
     if (upgrade_file->filename)
         free (upgrade_file->filename);
-    if (upgrade_file->file)
-        fclose (upgrade_file->file);
+    if (upgrade_file->fd >= 0)
+    {
+        (void) upgrade_file_flush (upgrade_file);
+        close (upgrade_file->fd);
+    }
+    if (upgrade_file->write_buffer)
+        free (upgrade_file->write_buffer);
+    if (upgrade_file->data)
+    {
+        if (upgrade_file->data_mmap)
+            munmap (upgrade_file->data, (size_t)upgrade_file->data_size);
+        else
+            free (upgrade_file->data);
+    }
+    if (upgrade_file->records)
+    {
+        for (i = 0; i < upgrade_file->records_size; i++)
+        {
+            upgrade_file_record_free (upgrade_file->records[i]);
+        }
+        free (upgrade_file->records);
+    }
     if (upgrade_file->callback_read_data)
         free (upgrade_file->callback_read_data);
 
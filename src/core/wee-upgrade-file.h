@@ -21,12 +21,27 @@
 #define WEECHAT_UPGRADE_FILE_H
 
 #include <stdio.h>
+#include <time.h>
 
-#define UPGRADE_SIGNATURE "===== WeeChat Upgrade file v2.2 - binary, do not edit! ====="
+/*
+ * signature of upgrade file, followed by the version of format (integer);
+ * files with the old signature (without version) have format 1
+ */
+#define UPGRADE_SIGNATURE "===== WeeChat Upgrade file - binary, do not edit! ====="
+#define UPGRADE_SIGNATURE_V1 "===== WeeChat Upgrade file v2.2 - binary, do not edit! ====="
+
+/*
+ * version of upgrade file format:
+ *   1: objects (infolists)
+ *   2: objects, schemas and records
+ */
+#define UPGRADE_FILE_VERSION 2
 
 #define UPGRADE_ERROR(msg1, msg2)                                       \
     upgrade_file_error(upgrade_file, msg1, msg2, __FILE__, __LINE__)
 
+#define UPGRADE_FILE_WRITE_BUFFER_SIZE (256 * 1024)
+
 struct t_infolist;
 
 enum t_upgrade_type
@@ -34,20 +49,56 @@ enum t_upgrade_type
     UPGRADE_TYPE_OBJECT_START = 0,
     UPGRADE_TYPE_OBJECT_END,
     UPGRADE_TYPE_OBJECT_VAR,
+    UPGRADE_TYPE_SCHEMA,
+    UPGRADE_TYPE_RECORD,
+};
+
+/*
+ * A record is an object written without names of variables: the fields
+ * (names and types) are written once in the file with the schema of the
+ * object id, then each record contains only the values, in the same order
+ * as fields.
+ */
+
+struct t_upgrade_record
+{
+    int object_id;                         /* object id                     */
+    int fields_count;                      /* number of fields              */
+    char **fields_names;                   /* names of fields               */
+    char *fields_types;                    /* types: 'i', 's', 't', 'b'     */
+    const char **values;                   /* values of current record      */
+                                           /* (pointers in file data)       */
+    int *sizes;                            /* sizes of values               */
 };
 
 struct t_upgrade_file
 {
     char *filename;                        /* filename with path            */
-    FILE *file;                            /* file pointer                  */
+    int fd;                                /* file descriptor (write mode)  */
+    char *write_buffer;                    /* data not yet written          */
+    int write_buffer_size;                 /* size of data in write buffer  */
+    char *data;                            /* content of file (read mode)   */
+    long data_size;                        /* size of file content          */
+    long data_pos;                         /* current read position         */
+    int version;                           /* version of format (read mode) */
+    int data_mmap;                         /* 1 if data is mapped (mmap)    */
     long last_read_pos;                    /* last read position            */
     int last_read_length;                  /* last read length              */
+    struct t_upgrade_record **records;     /* records schemas by object id  */
+    int records_size;                      /* size of array "records"       */
+    int count_objects;                     /* number of objects read        */
+    int count_records;                     /* number of records read        */
     int (*callback_read)                   /* callback called when reading  */
     (const void *pointer,                  /* file                          */
      void *data,
      struct t_upgrade_file *upgrade_file,
      int object_id,
      struct t_infolist *infolist);
+    int (*callback_read_record)            /* callback called for records   */
+    (const void *pointer,                  /* (if NULL, records are sent    */
+     void *data,                           /* to callback_read in infolist) */
+     struct t_upgrade_file *upgrade_file,
+     struct t_upgrade_record *record);
     const void *callback_read_pointer;     /* pointer sent to callback      */
     void *callback_read_data;              /* data sent to callback         */
     struct t_upgrade_file *prev_upgrade;   /* link to previous upgrade file */
@@ -65,6 +116,21 @@ extern struct t_upgrade_file *upgrade_file_new (const char *filename,
 extern int upgrade_file_write_object (struct t_upgrade_file *upgrade_file,
                                       int object_id,
                                       struct t_infolist *infolist);
+extern int upgrade_file_write_schema (struct t_upgrade_file *upgrade_file,
+                                      int object_id, const char *fields);
+extern int upgrade_file_write_record (struct t_upgrade_file *upgrade_file,
+                                      int object_id, ...);
+extern int upgrade_file_flush (struct t_upgrade_file *upgrade_file);
+extern int upgrade_file_record_search_field (struct t_upgrade_record *record,
+                                             const char *name);
+extern int upgrade_file_record_integer (struct t_upgrade_record *record,
+                                        int index);
+extern const char *upgrade_file_record_string (struct t_upgrade_record *record,
+                                               int index);
+extern time_t upgrade_file_record_time (struct t_upgrade_record *record,
+                                        int index);
+extern const void *upgrade_file_record_buffer (struct t_upgrade_record *record,
+                                               int index, int *size);
 extern int upgrade_file_read (struct t_upgrade_file *upgrade_file);
 extern void upgrade_file_close (struct t_upgrade_file *upgrade_file);
 
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/time.h>
 
 #include "weechat.h"
@@ -53,6 +54,26 @@ int upgrade_set_current_window = 0;
 int hotlist_reset = 0;
 struct t_gui_layout *upgrade_layout = NULL;
 
+/* names of fields read in records (indexes are computed once by schema) */
+char *upgrade_weechat_nicklist_fields[UPGRADE_WEECHAT_NICKLIST_NUM_FIELDS + 1] =
+{ "type", "name", "group_name", "color", "prefix", "prefix_color", "visible",
+  NULL };
+char *upgrade_weechat_line_fields[UPGRADE_WEECHAT_LINE_NUM_FIELDS + 1] =
+{ "y", "date", "date_printed", "highlight", "last_read_line", "tags",
+  "prefix", "message", NULL };
+struct t_upgrade_record *upgrade_weechat_nicklist_record = NULL;
+int upgrade_weechat_nicklist_index[UPGRADE_WEECHAT_NICKLIST_NUM_FIELDS];
+struct t_upgrade_record *upgrade_weechat_line_record = NULL;
+int upgrade_weechat_line_index[UPGRADE_WEECHAT_LINE_NUM_FIELDS];
+
+/* statistics on last upgrade (displayed with /debug upgrade) */
+long long upgrade_weechat_time_save = -1;   /* time to save core data (µs)  */
+long long upgrade_weechat_time_load = -1;   /* time to load core data (µs)  */
+long upgrade_weechat_file_size = 0;         /* size of core upgrade file    */
+int upgrade_weechat_file_mmap = 0;          /* 1 if file was read with mmap */
+int upgrade_weechat_count_objects = 0;      /* objects read (infolists)     */
+int upgrade_weechat_count_records = 0;      /* records read                 */
+
 
 /*
  * Saves history in WeeChat upgrade file (from last to first, to restore it in
@@ -67,45 +88,127 @@ int
 upgrade_weechat_save_history (struct t_upgrade_file *upgrade_file,
                               struct t_gui_history *last_history)
 {
-    struct t_infolist *ptr_infolist;
-    struct t_infolist_item *ptr_item;
     struct t_gui_history *ptr_history;
-    int rc;
-
-    if (!last_history)
-        return 1;
-
-    ptr_infolist = infolist_new (NULL);
-    if (!ptr_infolist)
-        return 0;
 
-    ptr_history = last_history;
-    while (ptr_history)
+    for (ptr_history = last_history; ptr_history;
+         ptr_history = ptr_history->prev_history)
     {
-        ptr_item = infolist_new_item (ptr_infolist);
-        if (!ptr_item)
+        if (!upgrade_file_write_record (upgrade_file,
+                                        UPGRADE_WEECHAT_TYPE_HISTORY,
+                                        ptr_history->text))
         {
-            infolist_free (ptr_infolist);
             return 0;
         }
+    }
+
+    return 1;
+}
 
-        if (!infolist_new_var_string (ptr_item, "text", ptr_history->text))
+/*
+ * Saves nicklist of a buffer in WeeChat upgrade file (groups and nicks are
+ * saved in the same order as they are displayed).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_weechat_save_nicklist (struct t_upgrade_file *upgrade_file,
+                               struct t_gui_buffer *buffer)
+{
+    struct t_gui_nick_group *ptr_group;
+    struct t_gui_nick *ptr_nick;
+    int rc;
+
+    ptr_group = NULL;
+    ptr_nick = NULL;
+    gui_nicklist_get_next_item (buffer, &ptr_group, &ptr_nick);
+    while (ptr_group || ptr_nick)
+    {
+        if (ptr_nick)
         {
-            infolist_free (ptr_infolist);
-            return 0;
+            rc = upgrade_file_write_record (
+                upgrade_file,
+                UPGRADE_WEECHAT_TYPE_NICKLIST,
+                "nick",
+                ptr_nick->name,
+                (ptr_nick->group) ? ptr_nick->group->name : NULL,
+                ptr_nick->color,
+                ptr_nick->prefix,
+                ptr_nick->prefix_color,
+                ptr_nick->visible);
         }
-
-        ptr_history = ptr_history->prev_history;
+        else
+        {
+            rc = upgrade_file_write_record (
+                upgrade_file,
+                UPGRADE_WEECHAT_TYPE_NICKLIST,
+                "group",
+                ptr_group->name,
+                (ptr_group->parent) ? ptr_group->parent->name : NULL,
+                ptr_group->color,
+                NULL,
+                NULL,
+                ptr_group->visible);
+        }
+        if (!rc)
+            return 0;
+        gui_nicklist_get_next_item (buffer, &ptr_group, &ptr_nick);
     }
 
-    rc = upgrade_file_write_object (upgrade_file,
-                                    UPGRADE_WEECHAT_TYPE_HISTORY,
-                                    ptr_infolist);
-    infolist_free (ptr_infolist);
-    if (!rc)
+    return 1;
+}
+
+/*
+ * Saves lines of a buffer in WeeChat upgrade file.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+upgrade_weechat_save_buffer_lines (struct t_upgrade_file *upgrade_file,
+                                   struct t_gui_buffer *buffer)
+{
+    struct t_gui_line *ptr_line;
+    char **tags;
+    int i, rc;
+
+    tags = string_dyn_alloc (256);
+    if (!tags)
         return 0;
 
-    return 1;
+    rc = 1;
+    for (ptr_line = buffer->own_lines->first_line; ptr_line;
+         ptr_line = ptr_line->next_line)
+    {
+        string_dyn_copy (tags, NULL);
+        for (i = 0; i < ptr_line->data->tags_count; i++)
+        {
+            if (i > 0)
+                string_dyn_concat (tags, ",");
+            string_dyn_concat (tags, ptr_line->data->tags_array[i]);
+        }
+        rc = upgrade_file_write_record (
+            upgrade_file,
+            UPGRADE_WEECHAT_TYPE_BUFFER_LINE,
+            ptr_line->data->y,
+            ptr_line->data->date,
+            ptr_line->data->date_printed,
+            (int)ptr_line->data->highlight,
+            (buffer->own_lines->last_read_line == ptr_line) ? 1 : 0,
+            *tags,
+            ptr_line->data->prefix,
+            ptr_line->data->message);
+        if (!rc)
+            break;
+    }
+
+    string_dyn_free (tags, 1);
+
+    return rc;
 }
 
 /*
@@ -121,7 +224,6 @@ upgrade_weechat_save_buffers (struct t_upgrade_file *upgrade_file)
 {
     struct t_infolist *ptr_infolist;
     struct t_gui_buffer *ptr_buffer;
-    struct t_gui_line *ptr_line;
     int rc;
 
     for (ptr_buffer = gui_buffers; ptr_buffer;
@@ -146,43 +248,13 @@ upgrade_weechat_save_buffers (struct t_upgrade_file *upgrade_file)
         /* save nicklist */
         if (ptr_buffer->nicklist)
         {
-            ptr_infolist = infolist_new (NULL);
-            if (!ptr_infolist)
-                return 0;
-            if (!gui_nicklist_add_to_infolist (ptr_infolist, ptr_buffer, NULL))
-            {
-                infolist_free (ptr_infolist);
-                return 0;
-            }
-            rc = upgrade_file_write_object (upgrade_file,
-                                            UPGRADE_WEECHAT_TYPE_NICKLIST,
-                                            ptr_infolist);
-            infolist_free (ptr_infolist);
-            if (!rc)
+            if (!upgrade_weechat_save_nicklist (upgrade_file, ptr_buffer))
                 return 0;
         }
 
         /* save buffer lines */
-        for (ptr_line = ptr_buffer->own_lines->first_line; ptr_line;
-             ptr_line = ptr_line->next_line)
-        {
-            ptr_infolist = infolist_new (NULL);
-            if (!ptr_infolist)
-                return 0;
-            if (!gui_line_add_to_infolist (ptr_infolist,
-                                           ptr_buffer->own_lines,
-                                           ptr_line))
-            {
-                infolist_free (ptr_infolist);
-                return 0;
-            }
-            rc = upgrade_file_write_object (upgrade_file,
-                                            UPGRADE_WEECHAT_TYPE_BUFFER_LINE,
-                                            ptr_infolist);
-            infolist_free (ptr_infolist);
-            if (!rc)
-                return 0;
-        }
+        if (!upgrade_weechat_save_buffer_lines (upgrade_file, ptr_buffer))
+            return 0;
 
         /* save command/text history of buffer */
         if (ptr_buffer->history)
@@ -198,7 +270,8 @@ upgrade_weechat_save_buffers (struct t_upgrade_file *upgrade_file)
 }
 
 /*
- * Saves miscellaneous info in WeeChat upgrade file.
+ * Saves miscellaneous info in WeeChat upgrade file (time_save is the time
+ * spent to save buffers, in microseconds).
  *
  * Returns:
  *   1: OK
@@ -206,7 +279,8 @@ upgrade_weechat_save_buffers (struct t_upgrade_file *upgrade_file)
  */
 
 int
-upgrade_weechat_save_misc (struct t_upgrade_file *upgrade_file)
+upgrade_weechat_save_misc (struct t_upgrade_file *upgrade_file,
+                           long long time_save)
 {
     struct t_infolist *ptr_infolist;
     struct t_infolist_item *ptr_item;
@@ -237,6 +311,13 @@ upgrade_weechat_save_misc (struct t_upgrade_file *upgrade_file)
         infolist_free (ptr_infolist);
         return 0;
     }
+    if (!infolist_new_var_integer (ptr_item, "time_save",
+                                   (time_save > INT_MAX) ?
+                                   INT_MAX : (int)time_save))
+    {
+        infolist_free (ptr_infolist);
+        return 0;
+    }
 
     rc = upgrade_file_write_object (upgrade_file,
                                     UPGRADE_WEECHAT_TYPE_MISC,
@@ -257,27 +338,26 @@ upgrade_weechat_save_misc (struct t_upgrade_file *upgrade_file)
 int
 upgrade_weechat_save_hotlist (struct t_upgrade_file *upgrade_file)
 {
-    struct t_infolist *ptr_infolist;
     struct t_gui_hotlist *ptr_hotlist;
-    int rc;
 
     for (ptr_hotlist = gui_hotlist; ptr_hotlist;
          ptr_hotlist = ptr_hotlist->next_hotlist)
     {
-        ptr_infolist = infolist_new (NULL);
-        if (!ptr_infolist)
-            return 0;
-        if (!gui_hotlist_add_to_infolist (ptr_infolist, ptr_hotlist))
+        if (!upgrade_file_write_record (
+                upgrade_file,
+                UPGRADE_WEECHAT_TYPE_HOTLIST,
+                gui_buffer_get_plugin_name (ptr_hotlist->buffer),
+                ptr_hotlist->buffer->name,
+                ptr_hotlist->priority,
+                &(ptr_hotlist->creation_time),
+                (int)sizeof (ptr_hotlist->creation_time),
+                ptr_hotlist->count[0],
+                ptr_hotlist->count[1],
+                ptr_hotlist->count[2],
+                ptr_hotlist->count[3]))
         {
-            infolist_free (ptr_infolist);
             return 0;
         }
-        rc = upgrade_file_write_object (upgrade_file,
-                                        UPGRADE_WEECHAT_TYPE_HOTLIST,
-                                        ptr_infolist);
-        infolist_free (ptr_infolist);
-        if (!rc)
-            return 0;
     }
 
     return 1;
@@ -378,6 +458,9 @@ upgrade_weechat_save ()
 {
     int rc;
     struct t_upgrade_file *upgrade_file;
+    struct timeval time_start, time_end;
+
+    gettimeofday (&time_start, NULL);
 
     upgrade_file = upgrade_file_new (WEECHAT_UPGRADE_FILENAME,
                                      NULL, NULL, NULL);
@@ -385,11 +468,31 @@ upgrade_weechat_save ()
         return 0;
 
     rc = 1;
+    rc &= upgrade_file_write_schema (upgrade_file,
+                                     UPGRADE_WEECHAT_TYPE_HISTORY,
+                                     UPGRADE_WEECHAT_FIELDS_HISTORY);
+    rc &= upgrade_file_write_schema (upgrade_file,
+                                     UPGRADE_WEECHAT_TYPE_NICKLIST,
+                                     UPGRADE_WEECHAT_FIELDS_NICKLIST);
+    rc &= upgrade_file_write_schema (upgrade_file,
+                                     UPGRADE_WEECHAT_TYPE_BUFFER_LINE,
+                                     UPGRADE_WEECHAT_FIELDS_BUFFER_LINE);
+    rc &= upgrade_file_write_schema (upgrade_file,
+                                     UPGRADE_WEECHAT_TYPE_HOTLIST,
+                                     UPGRADE_WEECHAT_FIELDS_HOTLIST);
+    if (!rc)
+    {
+        upgrade_file_close (upgrade_file);
+        return 0;
+    }
     rc &= upgrade_weechat_save_history (upgrade_file, last_gui_history);
     rc &= upgrade_weechat_save_buffers (upgrade_file);
-    rc &= upgrade_weechat_save_misc (upgrade_file);
+    gettimeofday (&time_end, NULL);
+    rc &= upgrade_weechat_save_misc (
+        upgrade_file, util_timeval_diff (&time_start, &time_end));
     rc &= upgrade_weechat_save_hotlist (upgrade_file);
     rc &= upgrade_weechat_save_layout_window (upgrade_file);
+    rc &= upgrade_file_flush (upgrade_file);
 
     upgrade_file_close (upgrade_file);
 
@@ -759,6 +862,248 @@ upgrade_weechat_read_hotlist (struct t_infolist *infolist)
     }
 }
 
+/*
+ * Computes indexes of fields in a record, if not yet done for this schema.
+ */
+
+void
+upgrade_weechat_record_map_fields (struct t_upgrade_record *record,
+                                   struct t_upgrade_record **mapped_record,
+                                   char **fields, int *indexes)
+{
+    int i;
+
+    if (record == *mapped_record)
+        return;
+
+    for (i = 0; fields[i]; i++)
+    {
+        indexes[i] = upgrade_file_record_search_field (record, fields[i]);
+    }
+    *mapped_record = record;
+}
+
+/*
+ * Reads a nick or a group of nicklist from a record.
+ */
+
+void
+upgrade_weechat_read_nicklist_record (struct t_upgrade_record *record)
+{
+    struct t_gui_nick_group *ptr_group;
+    const char *type, *name, *group_name;
+    int *index;
+
+    if (!upgrade_current_buffer)
+        return;
+
+    upgrade_weechat_record_map_fields (record,
+                                       &upgrade_weechat_nicklist_record,
+                                       upgrade_weechat_nicklist_fields,
+                                       upgrade_weechat_nicklist_index);
+    index = upgrade_weechat_nicklist_index;
+
+    upgrade_current_buffer->nicklist = 1;
+
+    type = upgrade_file_record_string (
+        record, index[UPGRADE_WEECHAT_NICKLIST_TYPE]);
+    name = upgrade_file_record_string (
+        record, index[UPGRADE_WEECHAT_NICKLIST_NAME]);
+    if (!type || !name)
+        return;
+
+    ptr_group = NULL;
+    group_name = upgrade_file_record_string (
+        record, index[UPGRADE_WEECHAT_NICKLIST_GROUP_NAME]);
+    if (group_name)
+    {
+        ptr_group = gui_nicklist_search_group (upgrade_current_buffer, NULL,
+                                               group_name);
+    }
+
+    if (strcmp (type, "group") == 0)
+    {
+        if (strcmp (name, "root") != 0)
+        {
+            gui_nicklist_add_group (
+                upgrade_current_buffer,
+                ptr_group,
+                name,
+                upgrade_file_record_string (
+                    record, index[UPGRADE_WEECHAT_NICKLIST_COLOR]),
+                upgrade_file_record_integer (
+                    record, index[UPGRADE_WEECHAT_NICKLIST_VISIBLE]));
+        }
+    }
+    else if (strcmp (type, "nick") == 0)
+    {
+        gui_nicklist_add_nick (
+            upgrade_current_buffer,
+            ptr_group,
+            name,
+            upgrade_file_record_string (
+                record, index[UPGRADE_WEECHAT_NICKLIST_COLOR]),
+            upgrade_file_record_string (
+                record, index[UPGRADE_WEECHAT_NICKLIST_PREFIX]),
+            upgrade_file_record_string (
+                record, index[UPGRADE_WEECHAT_NICKLIST_PREFIX_COLOR]),
+            upgrade_file_record_integer (
+                record, index[UPGRADE_WEECHAT_NICKLIST_VISIBLE]));
+    }
+}
+
+/*
+ * Reads a buffer line from a record.
+ */
+
+void
+upgrade_weechat_read_buffer_line_record (struct t_upgrade_record *record)
+{
+    struct t_gui_line *new_line;
+    int *index;
+
+    if (!upgrade_current_buffer)
+        return;
+
+    upgrade_weechat_record_map_fields (record,
+                                       &upgrade_weechat_line_record,
+                                       upgrade_weechat_line_fields,
+                                       upgrade_weechat_line_index);
+    index = upgrade_weechat_line_index;
+
+    switch (upgrade_current_buffer->type)
+    {
+        case GUI_BUFFER_TYPE_FORMATTED:
+            new_line = gui_line_add (
+                upgrade_current_buffer,
+                upgrade_file_record_time (
+                    record, index[UPGRADE_WEECHAT_LINE_DATE]),
+                upgrade_file_record_time (
+                    record, index[UPGRADE_WEECHAT_LINE_DATE_PRINTED]),
+                upgrade_file_record_string (
+                    record, index[UPGRADE_WEECHAT_LINE_TAGS]),
+                upgrade_file_record_string (
+                    record, index[UPGRADE_WEECHAT_LINE_PREFIX]),
+                upgrade_file_record_string (
+                    record, index[UPGRADE_WEECHAT_LINE_MESSAGE]));
+            if (new_line)
+            {
+                new_line->data->highlight = upgrade_file_record_integer (
+                    record, index[UPGRADE_WEECHAT_LINE_HIGHLIGHT]);
+                if (upgrade_file_record_integer (
+                        record, index[UPGRADE_WEECHAT_LINE_LAST_READ_LINE]))
+                {
+                    upgrade_current_buffer->lines->last_read_line = new_line;
+                }
+            }
+            break;
+        case GUI_BUFFER_TYPE_FREE:
+            gui_line_add_y (
+                upgrade_current_buffer,
+                upgrade_file_record_integer (
+                    record, index[UPGRADE_WEECHAT_LINE_Y]),
+                upgrade_file_record_string (
+                    record, index[UPGRADE_WEECHAT_LINE_MESSAGE]));
+            break;
+        case GUI_BUFFER_NUM_TYPES:
+            break;
+    }
+}
+
+/*
+ * Reads a hotlist entry from a record.
+ */
+
+void
+upgrade_weechat_read_hotlist_record (struct t_upgrade_record *record)
+{
+    const char *plugin_name, *buffer_name;
+    char field_name[64];
+    struct t_gui_buffer *ptr_buffer;
+    struct t_gui_hotlist *new_hotlist;
+    struct timeval creation_time;
+    const void *buf;
+    int i, size;
+
+    if (!hotlist_reset)
+    {
+        gui_hotlist_clear (GUI_HOTLIST_MASK_MAX);
+        hotlist_reset = 1;
+    }
+    plugin_name = upgrade_file_record_string (
+        record, upgrade_file_record_search_field (record, "plugin_name"));
+    buffer_name = upgrade_file_record_string (
+        record, upgrade_file_record_search_field (record, "buffer_name"));
+    if (!plugin_name || !buffer_name)
+        return;
+
+    ptr_buffer = gui_buffer_search_by_name (plugin_name, buffer_name);
+    if (!ptr_buffer)
+        return;
+
+    buf = upgrade_file_record_buffer (
+        record, upgrade_file_record_search_field (record, "creation_time"),
+        &size);
+    if (!buf || (size != (int)sizeof (creation_time)))
+        return;
+
+    memcpy (&creation_time, buf, size);
+    new_hotlist = gui_hotlist_add (
+        ptr_buffer,
+        upgrade_file_record_integer (
+            record, upgrade_file_record_search_field (record, "priority")),
+        &creation_time);
+    if (new_hotlist)
+    {
+        for (i = 0; i < GUI_HOTLIST_NUM_PRIORITIES; i++)
+        {
+            snprintf (field_name, sizeof (field_name), "count_%02d", i);
+            new_hotlist->count[i] = upgrade_file_record_integer (
+                record, upgrade_file_record_search_field (record, field_name));
+        }
+    }
+}
+
+/*
+ * Reads a record in WeeChat upgrade file.
+ */
+
+int
+upgrade_weechat_read_record_cb (const void *pointer, void *data,
+                                struct t_upgrade_file *upgrade_file,
+                                struct t_upgrade_record *record)
+{
+    const char *text;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) upgrade_file;
+
+    switch (record->object_id)
+    {
+        case UPGRADE_WEECHAT_TYPE_HISTORY:
+            text = upgrade_file_record_string (
+                record, upgrade_file_record_search_field (record, "text"));
+            if (upgrade_current_buffer)
+                gui_history_buffer_add (upgrade_current_buffer, text);
+            else
+                gui_history_global_add (text);
+            break;
+        case UPGRADE_WEECHAT_TYPE_NICKLIST:
+            upgrade_weechat_read_nicklist_record (record);
+            break;
+        case UPGRADE_WEECHAT_TYPE_BUFFER_LINE:
+            upgrade_weechat_read_buffer_line_record (record);
+            break;
+        case UPGRADE_WEECHAT_TYPE_HOTLIST:
+            upgrade_weechat_read_hotlist_record (record);
+            break;
+    }
+
+    return WEECHAT_RC_OK;
+}
+
 /*
  * Reads WeeChat upgrade file.
  */
@@ -803,6 +1148,9 @@ upgrade_weechat_read_cb (const void *pointer, void *data,
                 weechat_first_start_time = infolist_time (infolist, "start_time");
                 weechat_upgrade_count = infolist_integer (infolist, "upgrade_count");
                 upgrade_set_current_window = infolist_integer (infolist, "current_window_number");
+                /* "time_save" is new in WeeChat 2.2 */
+                upgrade_weechat_time_save = (infolist_search_var (infolist, "time_save")) ?
+                    infolist_integer (infolist, "time_save") : -1;
                 break;
             case UPGRADE_WEECHAT_TYPE_HOTLIST:
                 upgrade_weechat_read_hotlist (infolist);
@@ -836,6 +1184,9 @@ upgrade_weechat_load ()
 {
     int rc;
     struct t_upgrade_file *upgrade_file;
+    struct timeval time_start, time_end;
+
+    gettimeofday (&time_start, NULL);
 
     upgrade_layout = gui_layout_alloc (GUI_LAYOUT_UPGRADE);
 
@@ -843,9 +1194,17 @@ upgrade_weechat_load ()
                                      &upgrade_weechat_read_cb, NULL, NULL);
     if (!upgrade_file)
         return 0;
+    upgrade_file->callback_read_record = &upgrade_weechat_read_record_cb;
 
     rc = upgrade_file_read (upgrade_file);
 
+    upgrade_weechat_file_size = upgrade_file->data_size;
+    upgrade_weechat_file_mmap = upgrade_file->data_mmap;
+    upgrade_weechat_count_objects = upgrade_file->count_objects;
+    upgrade_weechat_count_records = upgrade_file->count_records;
+    upgrade_weechat_nicklist_record = NULL;
+    upgrade_weechat_line_record = NULL;
+
     upgrade_file_close (upgrade_file);
 
     if (!hotlist_reset)
@@ -878,6 +1237,9 @@ upgrade_weechat_load ()
 
     gui_layout_buffer_get_number_all (gui_layout_current);
 
+    gettimeofday (&time_end, NULL);
+    upgrade_weechat_time_load = util_timeval_diff (&time_start, &time_end);
+
     return rc;
 }
 
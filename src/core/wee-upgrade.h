@@ -37,6 +37,53 @@ enum t_upgrade_weechat_type
     UPGRADE_WEECHAT_TYPE_LAYOUT_WINDOW,
 };
 
+/* fields of records (schemas are written once in upgrade file) */
+
+#define UPGRADE_WEECHAT_FIELDS_HISTORY "s:text"
+#define UPGRADE_WEECHAT_FIELDS_NICKLIST                                 \
+    "s:type,s:name,s:group_name,s:color,s:prefix,s:prefix_color,"       \
+    "i:visible"
+#define UPGRADE_WEECHAT_FIELDS_BUFFER_LINE                              \
+    "i:y,t:date,t:date_printed,i:highlight,i:last_read_line,"           \
+    "s:tags,s:prefix,s:message"
+#define UPGRADE_WEECHAT_FIELDS_HOTLIST                                  \
+    "s:plugin_name,s:buffer_name,i:priority,b:creation_time,"           \
+    "i:count_00,i:count_01,i:count_02,i:count_03"
+
+enum t_upgrade_weechat_nicklist_field
+{
+    UPGRADE_WEECHAT_NICKLIST_TYPE = 0,
+    UPGRADE_WEECHAT_NICKLIST_NAME,
+    UPGRADE_WEECHAT_NICKLIST_GROUP_NAME,
+    UPGRADE_WEECHAT_NICKLIST_COLOR,
+    UPGRADE_WEECHAT_NICKLIST_PREFIX,
+    UPGRADE_WEECHAT_NICKLIST_PREFIX_COLOR,
+    UPGRADE_WEECHAT_NICKLIST_VISIBLE,
+    /* number of fields */
+    UPGRADE_WEECHAT_NICKLIST_NUM_FIELDS,
+};
+
+enum t_upgrade_weechat_line_field
+{
+    UPGRADE_WEECHAT_LINE_Y = 0,
+    UPGRADE_WEECHAT_LINE_DATE,
+    UPGRADE_WEECHAT_LINE_DATE_PRINTED,
+    UPGRADE_WEECHAT_LINE_HIGHLIGHT,
+    UPGRADE_WEECHAT_LINE_LAST_READ_LINE,
+    UPGRADE_WEECHAT_LINE_TAGS,
+    UPGRADE_WEECHAT_LINE_PREFIX,
+    UPGRADE_WEECHAT_LINE_MESSAGE,
+    /* number of fields */
+    UPGRADE_WEECHAT_LINE_NUM_FIELDS,
+};
+
+extern long long upgrade_weechat_time_save;
+extern long long upgrade_weechat_time_load;
+extern long upgrade_weechat_file_size;
+extern int upgrade_weechat_file_mmap;
+extern int upgrade_weechat_count_objects;
+extern int upgrade_weechat_count_records;
+
 int upgrade_weechat_save ();
 int upgrade_weechat_load ();
 void upgrade_weechat_end ();
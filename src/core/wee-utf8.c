@@ -25,6 +25,7 @@
 #endif
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <wctype.h>
 
@@ -58,12 +59,29 @@ utf8_init ()
 int
 utf8_has_8bits (const char *string)
 {
-    while (string && string[0])
+    uint64_t word;
+    size_t length, i;
+
+    if (!string)
+        return 0;
+
+    length = strlen (string);
+
+    /* check 8 bytes at once */
+    for (i = 0; i + sizeof (word) <= length; i += sizeof (word))
     {
-        if (string[0] & 0x80)
+        memcpy (&word, string + i, sizeof (word));
+        if (word & 0x8080808080808080ULL)
             return 1;
-        string++;
     }
+
+    /* check remaining bytes */
+    for (; i < length; i++)
+    {
+        if (string[i] & 0x80)
+            return 1;
+    }
+
     return 0;
 }
 
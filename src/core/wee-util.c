@@ -302,6 +302,36 @@ util_timeval_add (struct timeval *tv, long long interval)
         tv->tv_usec = usec;
 }
 
+/*
+ * Gets time of a monotonic clock (not affected by changes of system clock),
+ * in microseconds.
+ *
+ * The clock includes time spent in suspend if possible (CLOCK_BOOTTIME), so
+ * that it advances like the system clock. If no monotonic clock is
+ * available, the system clock is used.
+ */
+
+long long
+util_get_time_monotonic ()
+{
+    struct timeval tv;
+#if defined(CLOCK_BOOTTIME) || defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+#ifdef CLOCK_BOOTTIME
+    if (clock_gettime (CLOCK_BOOTTIME, &ts) == 0)
+        return (((long long)ts.tv_sec) * 1000000) + (ts.tv_nsec / 1000);
+#endif /* CLOCK_BOOTTIME */
+#ifdef CLOCK_MONOTONIC
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+        return (((long long)ts.tv_sec) * 1000000) + (ts.tv_nsec / 1000);
+#endif /* CLOCK_MONOTONIC */
+#endif /* defined(CLOCK_BOOTTIME) || defined(CLOCK_MONOTONIC) */
+
+    gettimeofday (&tv, NULL);
+    return (((long long)tv.tv_sec) * 1000000) + tv.tv_usec;
+}
+
 /*
  * Converts date to a string, using format of option "weechat.look.time_format"
  * (can be localized).
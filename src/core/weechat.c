@@ -728,6 +728,7 @@ weechat_end (void (*gui_end_cb)(int clean_exit))
     config_file_free_all ();            /* free all configuration files     */
     gui_key_end ();                     /* remove all keys                  */
     unhook_all ();                      /* remove all hooks                 */
+    eval_cache_free_all ();             /* free compiled expressions        */
     hdata_end ();                       /* end hdata                        */
     secure_end ();                      /* end secured data                 */
     string_end ();                      /* end string                       */
@@ -423,6 +423,7 @@ gui_bar_window_draw (struct t_gui_bar_window *bar_window,
     int diff, max_length, optimal_number_of_lines;
     int some_data_not_displayed;
     int index_item, index_subitem, index_line;
+    int first_line, total_lines;
 
     if (!gui_init_ok)
         return;
@@ -487,6 +488,19 @@ gui_bar_window_draw (struct t_gui_bar_window *bar_window,
         }
 
         items = string_split (content, "\n", 0, 0, &items_count);
+
+        /* item with only lines displayed? (lines before/after not built) */
+        if (bar_window->items_window_first_line >= 0)
+        {
+            first_line = bar_window->items_window_first_line;
+            total_lines = bar_window->items_num_lines[0][0];
+        }
+        else
+        {
+            first_line = 0;
+            total_lines = items_count;
+        }
+
         if (items_count == 0)
         {
             if (CONFIG_INTEGER(bar_window->bar->options[GUI_BAR_OPTION_SIZE]) == 0)
@@ -522,6 +536,8 @@ gui_bar_window_draw (struct t_gui_bar_window *bar_window,
                         num_lines = 1;
                     optimal_number_of_lines += num_lines;
                 }
+                if (bar_window->items_window_max_length > max_length)
+                    max_length = bar_window->items_window_max_length;
                 if (max_length == 0)
                     max_length = 1;
 
@@ -553,9 +569,9 @@ gui_bar_window_draw (struct t_gui_bar_window *bar_window,
             y = 0;
             some_data_not_displayed = 0;
             if ((bar_window->scroll_y > 0)
-                && (bar_window->scroll_y > items_count - bar_window->height))
+                && (bar_window->scroll_y > total_lines - bar_window->height))
             {
-                bar_window->scroll_y = items_count - bar_window->height;
+                bar_window->scroll_y = total_lines - bar_window->height;
                 if (bar_window->scroll_y < 0)
                     bar_window->scroll_y = 0;
             }
@@ -639,7 +655,7 @@ gui_bar_window_draw (struct t_gui_bar_window *bar_window,
                 }
 
                 if ((bar_window->scroll_y == 0)
-                    || (line >= bar_window->scroll_y))
+                    || (first_line + line >= bar_window->scroll_y))
                 {
                     if (!gui_bar_window_print_string (bar_window, filling,
                                                       &x, &y,
@@ -709,7 +725,8 @@ gui_bar_window_draw (struct t_gui_bar_window *bar_window,
                 }
             }
             if ((bar_window->cursor_x < 0) && (bar_window->cursor_y < 0)
-                && (some_data_not_displayed || (line < items_count)))
+                && (some_data_not_displayed
+                    || (first_line + line < total_lines)))
             {
                 ptr_string = (filling == GUI_BAR_FILLING_HORIZONTAL) ?
                     CONFIG_STRING(config_look_bar_more_right) :
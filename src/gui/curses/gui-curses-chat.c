@@ -1241,7 +1241,7 @@ gui_chat_display_line (struct t_gui_window *window, struct t_gui_line *line,
                        int count, int simulate)
 {
     int num_lines, x, y, pre_lines_displayed, lines_displayed, line_align;
-    int read_marker_x, read_marker_y;
+    int read_marker_x, read_marker_y, rows, lines_before_message;
     int word_start_offset, word_end_offset;
     int word_length_with_spaces, word_length;
     char *message_with_tags, *message_with_search;
@@ -1317,6 +1317,24 @@ gui_chat_display_line (struct t_gui_window *window, struct t_gui_line *line,
         read_marker_x = x;
     read_marker_y = y;
 
+    /*
+     * when simulating, use number of rows for time, prefix and message
+     * computed previously (if still valid), so that word-wrap is not done
+     * again (for example when scrolling with a lot of lines)
+     */
+    if (simulate)
+    {
+        rows = gui_line_rows_get (line, window->buffer,
+                                  gui_chat_get_real_width (window),
+                                  (lines_displayed == 0) ? 1 : 0);
+        if (rows >= 0)
+        {
+            lines_displayed += rows;
+            goto end_message;
+        }
+    }
+    lines_before_message = lines_displayed;
+
     /* display time and prefix */
     gui_chat_display_time_to_prefix (window, line, num_lines, count,
                                      pre_lines_displayed, &lines_displayed,
@@ -1477,6 +1495,15 @@ gui_chat_display_line (struct t_gui_window *window, struct t_gui_line *line,
     if (message_with_search)
         free (message_with_search);
 
+    if (simulate)
+    {
+        gui_line_rows_set (line, window->buffer,
+                           gui_chat_get_real_width (window),
+                           (lines_before_message == 0) ? 1 : 0,
+                           lines_displayed - lines_before_message);
+    }
+
+end_message:
     /* display message if day has changed after this line */
     if ((line->data->date != 0)
         && CONFIG_BOOLEAN(config_look_day_change)
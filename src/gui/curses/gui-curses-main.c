@@ -345,6 +345,9 @@ gui_main_refreshes ()
     struct t_gui_buffer *ptr_buffer;
     struct t_gui_bar *ptr_bar;
 
+    /* update bar items asked since last refresh */
+    gui_bar_item_update_dirty ();
+
     /* refresh color buffer if needed */
     if (gui_color_buffer_refresh_needed)
     {
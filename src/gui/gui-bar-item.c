@@ -80,6 +80,12 @@ char *gui_bar_items_default_for_bars[][2] =
 };
 struct t_gui_bar_item_hook *gui_bar_item_hooks = NULL;
 struct t_hook *gui_bar_item_timer = NULL;
+struct t_hashtable *gui_bar_item_dirty = NULL;   /* items to update         */
+struct t_hashtable *gui_bar_item_index = NULL;   /* item name -> slots      */
+long long gui_bar_item_count_updates_requested = 0; /* calls to update     */
+long long gui_bar_item_count_updates_done = 0;      /* items updated       */
+long long gui_bar_item_count_conditions_evaluated = 0; /* bars evaluated   */
+long long gui_bar_item_count_conditions_skipped = 0;   /* bars skipped     */
 
 
 /*
@@ -363,12 +369,14 @@ gui_bar_item_get_vars (const char *item_name,
  *               returns: color(delimiter) + "[" +
  *                        (value of item "time") + color(delimiter) + "]"
  *
+ * Argument "extra_info" (can be NULL) is sent to the callback.
+ *
  * Note: result must be freed after use.
  */
 
 char *
 gui_bar_item_get_value (struct t_gui_bar *bar, struct t_gui_window *window,
-                        int item, int subitem)
+                        int item, int subitem, struct t_hashtable *extra_info)
 {
     char *item_value, delimiter_color[32], bar_color[32];
     char *result, str_attr[8];
@@ -402,7 +410,7 @@ gui_bar_item_get_value (struct t_gui_bar *bar, struct t_gui_window *window,
                 ptr_item,
                 window,
                 buffer,
-                NULL);
+                extra_info);
         }
         if (item_value && !item_value[0])
         {
@@ -572,97 +580,283 @@ gui_bar_item_new (struct t_weechat_plugin *plugin, const char *name,
 }
 
 /*
- * Updates an item on all bars displayed on screen.
+ * Frees the list of slots of an item name in index (callback called by
+ * hashtable).
  */
 
 void
-gui_bar_item_update (const char *item_name)
+gui_bar_item_index_free_value_cb (struct t_hashtable *hashtable,
+                                  const void *key, void *value)
 {
-    struct t_gui_bar *ptr_bar;
-    struct t_gui_window *ptr_window;
-    struct t_gui_bar_window *ptr_bar_window;
-    int i, j, check_bar_conditions, condition_ok;
+    struct t_gui_bar_item_slot *ptr_slot, *next_slot;
 
-    if (!item_name)
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    ptr_slot = (struct t_gui_bar_item_slot *)value;
+    while (ptr_slot)
+    {
+        next_slot = ptr_slot->next_slot;
+        free (ptr_slot);
+        ptr_slot = next_slot;
+    }
+}
+
+/*
+ * Builds index of items used in bars: for each item name, the list of
+ * bars/slots where the item is displayed.
+ */
+
+void
+gui_bar_item_index_build ()
+{
+    struct t_gui_bar *ptr_bar;
+    struct t_gui_bar_item_slot *new_slot, *ptr_slot;
+    int i, j;
+
+    gui_bar_item_index = hashtable_new (32,
+                                        WEECHAT_HASHTABLE_STRING,
+                                        WEECHAT_HASHTABLE_POINTER,
+                                        NULL, NULL);
+    if (!gui_bar_item_index)
         return;
+    gui_bar_item_index->callback_free_value = &gui_bar_item_index_free_value_cb;
 
     for (ptr_bar = gui_bars; ptr_bar; ptr_bar = ptr_bar->next_bar)
     {
-        check_bar_conditions = 0;
-
         for (i = 0; i < ptr_bar->items_count; i++)
         {
             for (j = 0; j < ptr_bar->items_subcount[i]; j++)
             {
-                if (ptr_bar->items_name[i][j]
-                    && (strcmp (ptr_bar->items_name[i][j], item_name) == 0))
+                if (!ptr_bar->items_name[i][j])
+                    continue;
+                new_slot = malloc (sizeof (*new_slot));
+                if (!new_slot)
+                    continue;
+                new_slot->bar = ptr_bar;
+                new_slot->item = i;
+                new_slot->subitem = j;
+                new_slot->next_slot = NULL;
+                ptr_slot = hashtable_get (gui_bar_item_index,
+                                          ptr_bar->items_name[i][j]);
+                if (ptr_slot)
                 {
-                    if (!CONFIG_BOOLEAN(ptr_bar->options[GUI_BAR_OPTION_HIDDEN]))
-                        check_bar_conditions = 1;
-
-                    if (CONFIG_INTEGER(ptr_bar->options[GUI_BAR_OPTION_TYPE]) == GUI_BAR_TYPE_ROOT)
+                    /* add slot at the end of list */
+                    while (ptr_slot->next_slot)
                     {
-                        if (ptr_bar->bar_window)
-                        {
-                            ptr_bar->bar_window->items_refresh_needed[i][j] = 1;
-                        }
+                        ptr_slot = ptr_slot->next_slot;
                     }
-                    else
-                    {
-                        for (ptr_window = gui_windows; ptr_window;
-                             ptr_window = ptr_window->next_window)
-                        {
-                            for (ptr_bar_window = ptr_window->bar_windows;
-                                 ptr_bar_window;
-                                 ptr_bar_window = ptr_bar_window->next_bar_window)
-                            {
-                                if (ptr_bar_window->bar == ptr_bar)
-                                {
-                                    ptr_bar_window->items_refresh_needed[i][j] = 1;
-                                }
-                            }
-                        }
-                    }
-                    gui_bar_ask_refresh (ptr_bar);
+                    ptr_slot->next_slot = new_slot;
+                }
+                else
+                {
+                    hashtable_set (gui_bar_item_index,
+                                   ptr_bar->items_name[i][j], new_slot);
                 }
             }
         }
+    }
+}
 
-        /*
-         * evaluate bar conditions (if needed) to check if bar must be toggled
-         * (hidden if shown, or shown if hidden)
-         */
-        if (check_bar_conditions)
+/*
+ * Invalidates index of items used in bars (it will be built again on next
+ * update of items).
+ *
+ * This function must be called when items of a bar are changed or when a
+ * bar is deleted.
+ */
+
+void
+gui_bar_item_index_invalidate ()
+{
+    if (gui_bar_item_index)
+    {
+        hashtable_free (gui_bar_item_index);
+        gui_bar_item_index = NULL;
+    }
+}
+
+/*
+ * Asks for update of an item on all bars displayed on screen.
+ *
+ * The update is delayed until next refresh of screen (see function
+ * gui_bar_item_update_dirty): many updates of same item between two
+ * refreshes are coalesced into a single one.
+ */
+
+void
+gui_bar_item_update (const char *item_name)
+{
+    if (!item_name)
+        return;
+
+    gui_bar_item_count_updates_requested++;
+
+    if (!gui_bar_item_dirty)
+    {
+        gui_bar_item_dirty = hashtable_new (32,
+                                            WEECHAT_HASHTABLE_STRING,
+                                            WEECHAT_HASHTABLE_STRING,
+                                            NULL, NULL);
+        if (!gui_bar_item_dirty)
+            return;
+    }
+
+    hashtable_set (gui_bar_item_dirty, item_name, NULL);
+}
+
+/*
+ * Marks an item as "refresh needed" in all bars where it is displayed
+ * (callback called for each item name in hashtable of dirty items).
+ */
+
+void
+gui_bar_item_update_dirty_map_cb (void *data,
+                                  struct t_hashtable *hashtable,
+                                  const void *key, const void *value)
+{
+    struct t_hashtable *bars_to_check;
+    struct t_gui_bar_item_slot *ptr_slot;
+    struct t_gui_window *ptr_window;
+    struct t_gui_bar_window *ptr_bar_window;
+
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) value;
+
+    bars_to_check = (struct t_hashtable *)data;
+
+    gui_bar_item_count_updates_done++;
+
+    for (ptr_slot = hashtable_get (gui_bar_item_index, (const char *)key);
+         ptr_slot; ptr_slot = ptr_slot->next_slot)
+    {
+        if (!CONFIG_BOOLEAN(ptr_slot->bar->options[GUI_BAR_OPTION_HIDDEN]))
+            hashtable_set (bars_to_check, ptr_slot->bar, NULL);
+
+        if (CONFIG_INTEGER(ptr_slot->bar->options[GUI_BAR_OPTION_TYPE]) == GUI_BAR_TYPE_ROOT)
         {
-            if (CONFIG_INTEGER(ptr_bar->options[GUI_BAR_OPTION_TYPE]) == GUI_BAR_TYPE_ROOT)
+            if (ptr_slot->bar->bar_window)
             {
-                condition_ok = gui_bar_check_conditions (ptr_bar, NULL);
-                if ((condition_ok && !ptr_bar->bar_window)
-                    || (!condition_ok && ptr_bar->bar_window))
-                {
-                    gui_window_ask_refresh (1);
-                }
+                ptr_slot->bar->bar_window->items_refresh_needed[ptr_slot->item][ptr_slot->subitem] = 1;
             }
-            else
+        }
+        else
+        {
+            for (ptr_window = gui_windows; ptr_window;
+                 ptr_window = ptr_window->next_window)
             {
-                for (ptr_window = gui_windows; ptr_window;
-                     ptr_window = ptr_window->next_window)
+                for (ptr_bar_window = ptr_window->bar_windows;
+                     ptr_bar_window;
+                     ptr_bar_window = ptr_bar_window->next_bar_window)
                 {
-                    condition_ok = gui_bar_check_conditions (ptr_bar,
-                                                             ptr_window);
-                    ptr_bar_window = gui_bar_window_search_bar (ptr_window,
-                                                                ptr_bar);
-                    if ((condition_ok && !ptr_bar_window)
-                        || (!condition_ok && ptr_bar_window))
+                    if (ptr_bar_window->bar == ptr_slot->bar)
                     {
-                        gui_window_ask_refresh (1);
+                        ptr_bar_window->items_refresh_needed[ptr_slot->item][ptr_slot->subitem] = 1;
                     }
                 }
             }
         }
+        gui_bar_ask_refresh (ptr_slot->bar);
     }
 }
 
+/*
+ * Updates items asked since last refresh of screen (with function
+ * gui_bar_item_update) on all bars displayed on screen.
+ *
+ * Conditions of bars displaying these items are evaluated (if needed) to
+ * check if bars must be toggled (hidden if shown, or shown if hidden).
+ */
+
+void
+gui_bar_item_update_dirty ()
+{
+    struct t_hashtable *dirty, *bars_to_check;
+    struct t_gui_bar *ptr_bar;
+    struct t_gui_window *ptr_window;
+    struct t_gui_bar_window *ptr_bar_window;
+    int condition_ok;
+
+    if (!gui_bar_item_dirty || (gui_bar_item_dirty->items_count == 0))
+        return;
+
+    /*
+     * detach the hashtable, so that items updated during the refresh of
+     * items are added in a new hashtable (updated on next refresh)
+     */
+    dirty = gui_bar_item_dirty;
+    gui_bar_item_dirty = NULL;
+
+    if (!gui_bar_item_index)
+        gui_bar_item_index_build ();
+    if (!gui_bar_item_index)
+    {
+        hashtable_free (dirty);
+        return;
+    }
+
+    bars_to_check = hashtable_new (32,
+                                   WEECHAT_HASHTABLE_POINTER,
+                                   WEECHAT_HASHTABLE_POINTER,
+                                   NULL, NULL);
+    if (!bars_to_check)
+    {
+        hashtable_free (dirty);
+        return;
+    }
+
+    hashtable_map (dirty, &gui_bar_item_update_dirty_map_cb, bars_to_check);
+    hashtable_free (dirty);
+
+    /*
+     * evaluate bar conditions (if needed) to check if bar must be toggled
+     * (hidden if shown, or shown if hidden)
+     */
+    for (ptr_bar = gui_bars; ptr_bar; ptr_bar = ptr_bar->next_bar)
+    {
+        if (!hashtable_has_key (bars_to_check, ptr_bar))
+            continue;
+
+        if (!gui_bar_conditions_depend_on_items (ptr_bar))
+        {
+            gui_bar_item_count_conditions_skipped++;
+            continue;
+        }
+
+        gui_bar_item_count_conditions_evaluated++;
+
+        if (CONFIG_INTEGER(ptr_bar->options[GUI_BAR_OPTION_TYPE]) == GUI_BAR_TYPE_ROOT)
+        {
+            condition_ok = gui_bar_check_conditions (ptr_bar, NULL);
+            if ((condition_ok && !ptr_bar->bar_window)
+                || (!condition_ok && ptr_bar->bar_window))
+            {
+                gui_window_ask_refresh (1);
+            }
+        }
+        else
+        {
+            for (ptr_window = gui_windows; ptr_window;
+                 ptr_window = ptr_window->next_window)
+            {
+                condition_ok = gui_bar_check_conditions (ptr_bar,
+                                                         ptr_window);
+                ptr_bar_window = gui_bar_window_search_bar (ptr_window,
+                                                            ptr_bar);
+                if ((condition_ok && !ptr_bar_window)
+                    || (!condition_ok && ptr_bar_window))
+                {
+                    gui_window_ask_refresh (1);
+                }
+            }
+        }
+    }
+
+    hashtable_free (bars_to_check);
+}
+
 /*
  * Deletes a bar item.
  */
@@ -1656,8 +1850,146 @@ gui_bar_item_buffer_title_cb (const void *pointer, void *data,
     return (buffer->title) ? strdup (buffer->title) : NULL;
 }
 
+/*
+ * Adds a nick (or a group if nick is NULL) in content of bar item "nicklist".
+ */
+
+void
+gui_bar_item_nicklist_add_line (char **nicklist, struct t_gui_buffer *buffer,
+                                struct t_gui_nick_group *group,
+                                struct t_gui_nick *nick)
+{
+    struct t_config_option *ptr_option;
+    int i;
+
+    if (*nicklist[0])
+        string_dyn_concat (nicklist, "\n");
+
+    if (nick)
+    {
+        if (buffer->nicklist_display_groups)
+        {
+            for (i = 0; i < nick->group->level; i++)
+            {
+                string_dyn_concat (nicklist, " ");
+            }
+        }
+        if (nick->prefix_color)
+        {
+            if (strchr (nick->prefix_color, '.'))
+            {
+                config_file_search_with_string (nick->prefix_color,
+                                                NULL, NULL, &ptr_option,
+                                                NULL);
+                if (ptr_option)
+                {
+                    string_dyn_concat (
+                        nicklist,
+                        gui_color_get_custom (
+                            gui_color_get_name (
+                                CONFIG_COLOR(ptr_option))));
+                }
+            }
+            else
+            {
+                string_dyn_concat (nicklist,
+                                   gui_color_get_custom (
+                                       nick->prefix_color));
+            }
+        }
+        if (nick->prefix)
+            string_dyn_concat (nicklist, nick->prefix);
+        if (nick->color)
+        {
+            if (strchr (nick->color, '.'))
+            {
+                config_file_search_with_string (nick->color,
+                                                NULL, NULL, &ptr_option,
+                                                NULL);
+                if (ptr_option)
+                {
+                    string_dyn_concat (
+                        nicklist,
+                        gui_color_get_custom (
+                            gui_color_get_name (
+                                CONFIG_COLOR(ptr_option))));
+                }
+            }
+            else
+            {
+                string_dyn_concat (nicklist,
+                                   gui_color_get_custom (
+                                       nick->color));
+            }
+        }
+        string_dyn_concat (nicklist, nick->name);
+    }
+    else
+    {
+        for (i = 0; i < group->level - 1; i++)
+        {
+            string_dyn_concat (nicklist, " ");
+        }
+        if (group->color)
+        {
+            if (strchr (group->color, '.'))
+            {
+                config_file_search_with_string (group->color,
+                                                NULL, NULL, &ptr_option,
+                                                NULL);
+                if (ptr_option)
+                {
+                    string_dyn_concat (
+                        nicklist,
+                        gui_color_get_custom (
+                            gui_color_get_name (
+                                CONFIG_COLOR(ptr_option))));
+                }
+            }
+            else
+            {
+                string_dyn_concat (nicklist,
+                                   gui_color_get_custom (
+                                       group->color));
+            }
+        }
+        string_dyn_concat (nicklist,
+                           gui_nicklist_get_group_start (group->name));
+    }
+}
+
+/*
+ * Returns length on screen of a nick (or a group if nick is NULL) in bar
+ * item "nicklist".
+ */
+
+int
+gui_bar_item_nicklist_line_length (struct t_gui_buffer *buffer,
+                                   struct t_gui_nick_group *group,
+                                   struct t_gui_nick *nick)
+{
+    int length;
+
+    if (nick)
+    {
+        length = (buffer->nicklist_display_groups) ? nick->group->level : 0;
+        if (nick->prefix)
+            length += utf8_strlen_screen (nick->prefix);
+        return length + utf8_strlen_screen (nick->name);
+    }
+
+    length = (group->level > 1) ? group->level - 1 : 0;
+    return length + utf8_strlen_screen (
+        gui_nicklist_get_group_start (group->name));
+}
+
 /*
  * Bar item with nicklist.
+ *
+ * If the bar window asks for lines displayed only (keys "_window_first_line"
+ * and "_window_lines" in extra_info), only these lines are built, and the
+ * total number of lines (and the max length of lines, if asked) is returned
+ * in extra_info.
  */
 
 char *
@@ -1669,24 +2001,52 @@ gui_bar_item_buffer_nicklist_cb (const void *pointer, void *data,
 {
     struct t_gui_nick_group *ptr_group;
     struct t_gui_nick *ptr_nick;
-    struct t_config_option *ptr_option;
-    char **nicklist, *str_nicklist;
-    int i;
+    const char *ptr_first_line, *ptr_lines, *ptr_max_length;
+    char **nicklist, *str_nicklist, *error1, *error2, str_value[32];
+    long first_line, num_lines;
+    int windowed, compute_max_length, line, length, max_length;
 
     /* make C compiler happy */
     (void) pointer;
     (void) data;
     (void) item;
     (void) window;
-    (void) extra_info;
 
     if (!buffer)
         return NULL;
 
+    windowed = 0;
+    compute_max_length = 0;
+    first_line = 0;
+    num_lines = 0;
+    if (extra_info)
+    {
+        ptr_first_line = hashtable_get (extra_info, "_window_first_line");
+        ptr_lines = hashtable_get (extra_info, "_window_lines");
+        if (ptr_first_line && ptr_lines)
+        {
+            error1 = NULL;
+            first_line = strtol (ptr_first_line, &error1, 10);
+            error2 = NULL;
+            num_lines = strtol (ptr_lines, &error2, 10);
+            if (error1 && !error1[0] && (first_line >= 0)
+                && error2 && !error2[0] && (num_lines >= 0))
+            {
+                windowed = 1;
+                ptr_max_length = hashtable_get (extra_info,
+                                                "_window_max_length");
+                compute_max_length = (ptr_max_length
+                                      && (strcmp (ptr_max_length, "1") == 0));
+            }
+        }
+    }
+
     nicklist = string_dyn_alloc (256);
     if (!nicklist)
         return NULL;
 
+    line = 0;
+    max_length = 0;
     ptr_group = NULL;
     ptr_nick = NULL;
     gui_nicklist_get_next_item (buffer, &ptr_group, &ptr_nick);
@@ -1697,105 +2057,36 @@ gui_bar_item_buffer_nicklist_cb (const void *pointer, void *data,
                 && buffer->nicklist_display_groups
                 && ptr_group->visible))
         {
-            if (*nicklist[0])
-                string_dyn_concat (nicklist, "\n");
-
-            if (ptr_nick)
+            if (!windowed
+                || ((line >= first_line) && (line - first_line < num_lines)))
             {
-                if (buffer->nicklist_display_groups)
-                {
-                    for (i = 0; i < ptr_nick->group->level; i++)
-                    {
-                        string_dyn_concat (nicklist, " ");
-                    }
-                }
-                if (ptr_nick->prefix_color)
-                {
-                    if (strchr (ptr_nick->prefix_color, '.'))
-                    {
-                        config_file_search_with_string (ptr_nick->prefix_color,
-                                                        NULL, NULL, &ptr_option,
-                                                            NULL);
-                        if (ptr_option)
-                        {
-                            string_dyn_concat (
-                                nicklist,
-                                gui_color_get_custom (
-                                    gui_color_get_name (
-                                        CONFIG_COLOR(ptr_option))));
-                        }
-                    }
-                    else
-                    {
-                        string_dyn_concat (nicklist,
-                                           gui_color_get_custom (
-                                               ptr_nick->prefix_color));
-                    }
-                }
-                if (ptr_nick->prefix)
-                    string_dyn_concat (nicklist, ptr_nick->prefix);
-                if (ptr_nick->color)
-                {
-                    if (strchr (ptr_nick->color, '.'))
-                    {
-                        config_file_search_with_string (ptr_nick->color,
-                                                        NULL, NULL, &ptr_option,
-                                                        NULL);
-                        if (ptr_option)
-                        {
-                            string_dyn_concat (
-                                nicklist,
-                                gui_color_get_custom (
-                                    gui_color_get_name (
-                                        CONFIG_COLOR(ptr_option))));
-                        }
-                    }
-                    else
-                    {
-                        string_dyn_concat (nicklist,
-                                           gui_color_get_custom (
-                                               ptr_nick->color));
-                    }
-                }
-                string_dyn_concat (nicklist, ptr_nick->name);
+                gui_bar_item_nicklist_add_line (nicklist, buffer,
+                                                ptr_group, ptr_nick);
             }
-            else
+            if (compute_max_length)
             {
-                for (i = 0; i < ptr_group->level - 1; i++)
-                {
-                    string_dyn_concat (nicklist, " ");
-                }
-                if (ptr_group->color)
-                {
-                    if (strchr (ptr_group->color, '.'))
-                    {
-                        config_file_search_with_string (ptr_group->color,
-                                                        NULL, NULL, &ptr_option,
-                                                        NULL);
-                        if (ptr_option)
-                        {
-                            string_dyn_concat (
-                                nicklist,
-                                gui_color_get_custom (
-                                    gui_color_get_name (
-                                        CONFIG_COLOR(ptr_option))));
-                        }
-                    }
-                    else
-                    {
-                        string_dyn_concat (nicklist,
-                                           gui_color_get_custom (
-                                               ptr_group->color));
-                    }
-                }
-                string_dyn_concat (nicklist,
-                                   gui_nicklist_get_group_start (
-                                       ptr_group->name));
+                length = gui_bar_item_nicklist_line_length (buffer,
+                                                            ptr_group,
+                                                            ptr_nick);
+                if (length > max_length)
+                    max_length = length;
             }
+            line++;
         }
         gui_nicklist_get_next_item (buffer, &ptr_group, &ptr_nick);
     }
 
+    if (windowed)
+    {
+        snprintf (str_value, sizeof (str_value), "%d", line);
+        hashtable_set (extra_info, "_window_total_lines", str_value);
+        if (compute_max_length)
+        {
+            snprintf (str_value, sizeof (str_value), "%d", max_length);
+            hashtable_set (extra_info, "_window_max_length", str_value);
+        }
+    }
+
     str_nicklist = *nicklist;
 
     string_dyn_free (nicklist, 0);
@@ -2360,6 +2651,14 @@ gui_bar_item_end ()
 
     /* remove bar items */
     gui_bar_item_free_all ();
+
+    /* remove items to update and index of items */
+    if (gui_bar_item_dirty)
+    {
+        hashtable_free (gui_bar_item_dirty);
+        gui_bar_item_dirty = NULL;
+    }
+    gui_bar_item_index_invalidate ();
 }
 
 /*
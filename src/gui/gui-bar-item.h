@@ -74,12 +74,24 @@ struct t_gui_bar_item_hook
     struct t_gui_bar_item_hook *next_hook; /* next hook                     */
 };
 
+struct t_gui_bar_item_slot
+{
+    struct t_gui_bar *bar;                 /* bar using the item            */
+    int item;                              /* index of item in bar          */
+    int subitem;                           /* index of sub item in bar      */
+    struct t_gui_bar_item_slot *next_slot; /* next slot (same item name)    */
+};
+
 /* variables */
 
 extern struct t_gui_bar_item *gui_bar_items;
 extern struct t_gui_bar_item *last_gui_bar_item;
 extern char *gui_bar_item_names[];
 extern char *gui_bar_items_default_for_bars[][2];
+extern long long gui_bar_item_count_updates_requested;
+extern long long gui_bar_item_count_updates_done;
+extern long long gui_bar_item_count_conditions_evaluated;
+extern long long gui_bar_item_count_conditions_skipped;
 
 /* functions */
 
@@ -96,7 +108,8 @@ extern void gui_bar_item_get_vars (const char *item_name,
                                    char **suffix);
 extern char *gui_bar_item_get_value (struct t_gui_bar *bar,
                                      struct t_gui_window *window,
-                                     int item, int subitem);
+                                     int item, int subitem,
+                                     struct t_hashtable *extra_info);
 extern int gui_bar_item_count_lines (char *string);
 extern struct t_gui_bar_item *gui_bar_item_new (struct t_weechat_plugin *plugin,
                                                 const char *name,
@@ -108,7 +121,9 @@ extern struct t_gui_bar_item *gui_bar_item_new (struct t_weechat_plugin *plugin,
                                                                         struct t_hashtable *extra_info),
                                                 const void *build_callback_pointer,
                                                 void *build_callback_data);
+extern void gui_bar_item_index_invalidate ();
 extern void gui_bar_item_update (const char *name);
+extern void gui_bar_item_update_dirty ();
 extern void gui_bar_item_free (struct t_gui_bar_item *item);
 extern void gui_bar_item_free_all ();
 extern void gui_bar_item_free_all_plugin (struct t_weechat_plugin *plugin);
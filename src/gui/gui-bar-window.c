@@ -449,6 +449,9 @@ gui_bar_window_content_alloc (struct t_gui_bar_window *bar_window)
     bar_window->items_content = NULL;
     bar_window->items_num_lines = NULL;
     bar_window->items_refresh_needed = NULL;
+    bar_window->items_window_first_line = -1;
+    bar_window->items_window_lines = 0;
+    bar_window->items_window_max_length = 0;
     bar_window->screen_col_size = 0;
     bar_window->screen_lines = 0;
     bar_window->items_subcount = calloc (1,
@@ -583,6 +586,131 @@ gui_bar_window_content_free (struct t_gui_bar_window *bar_window)
     }
 }
 
+/*
+ * Checks if the item of a bar window can be built only with lines displayed
+ * (windowed item): the bar must have a vertical filling and only one item
+ * (without prefix/suffix); if the bar has an automatic size, it must be on
+ * left or right (the width is then given by the item).
+ *
+ * Returns:
+ *   1: item can be windowed
+ *   0: item must be fully built
+ */
+
+int
+gui_bar_window_content_can_window (struct t_gui_bar_window *bar_window)
+{
+    int position;
+
+    if ((bar_window->items_count != 1)
+        || (bar_window->items_subcount[0] != 1)
+        || (bar_window->height <= 0)
+        || (gui_bar_get_filling (bar_window->bar) != GUI_BAR_FILLING_VERTICAL)
+        || bar_window->bar->items_prefix[0][0]
+        || bar_window->bar->items_suffix[0][0])
+    {
+        return 0;
+    }
+
+    if (CONFIG_INTEGER(bar_window->bar->options[GUI_BAR_OPTION_SIZE]) == 0)
+    {
+        position = CONFIG_INTEGER(bar_window->bar->options[GUI_BAR_OPTION_POSITION]);
+        if ((position != GUI_BAR_POSITION_LEFT)
+            && (position != GUI_BAR_POSITION_RIGHT))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Clamps the vertical scroll of a bar window with a windowed item, using
+ * total number of lines in item.
+ */
+
+void
+gui_bar_window_content_window_clamp (struct t_gui_bar_window *bar_window)
+{
+    int max_scroll;
+
+    max_scroll = bar_window->items_num_lines[0][0] - bar_window->height;
+    if (max_scroll < 0)
+        max_scroll = 0;
+    if (bar_window->scroll_y > max_scroll)
+        bar_window->scroll_y = max_scroll;
+}
+
+/*
+ * Calls the item callback to get content of an item for a bar window.
+ *
+ * If the item can be windowed, the lines displayed (scroll and height of bar
+ * window) are sent to the callback in the hashtable "extra_info", and the
+ * callback can return only these lines: then it sets the total number of
+ * lines in the hashtable (and the max length of lines if asked by WeeChat).
+ */
+
+void
+gui_bar_window_content_build_item_value (struct t_gui_bar_window *bar_window,
+                                         struct t_gui_window *window,
+                                         int index_item, int index_subitem)
+{
+    struct t_hashtable *extra_info;
+    const char *ptr_total_lines, *ptr_max_length;
+    char str_value[32];
+    int auto_size;
+
+    extra_info = NULL;
+    if (gui_bar_window_content_can_window (bar_window))
+    {
+        extra_info = hashtable_new (32,
+                                    WEECHAT_HASHTABLE_STRING,
+                                    WEECHAT_HASHTABLE_STRING,
+                                    NULL, NULL);
+    }
+
+    if (extra_info)
+    {
+        auto_size = (CONFIG_INTEGER(bar_window->bar->options[GUI_BAR_OPTION_SIZE]) == 0);
+        snprintf (str_value, sizeof (str_value), "%d", bar_window->scroll_y);
+        hashtable_set (extra_info, "_window_first_line", str_value);
+        snprintf (str_value, sizeof (str_value), "%d", bar_window->height);
+        hashtable_set (extra_info, "_window_lines", str_value);
+        hashtable_set (extra_info, "_window_max_length",
+                       (auto_size) ? "1" : "0");
+    }
+
+    bar_window->items_content[index_item][index_subitem] =
+        gui_bar_item_get_value (bar_window->bar, window,
+                                index_item, index_subitem, extra_info);
+
+    ptr_total_lines = (extra_info) ?
+        hashtable_get (extra_info, "_window_total_lines") : NULL;
+    if (ptr_total_lines)
+    {
+        /* the item has built only lines displayed */
+        bar_window->items_window_first_line = bar_window->scroll_y;
+        bar_window->items_window_lines = bar_window->height;
+        bar_window->items_num_lines[index_item][index_subitem] =
+            atoi (ptr_total_lines);
+        ptr_max_length = hashtable_get (extra_info, "_window_max_length");
+        bar_window->items_window_max_length =
+            (ptr_max_length) ? atoi (ptr_max_length) : 0;
+    }
+    else
+    {
+        bar_window->items_window_first_line = -1;
+        bar_window->items_window_lines = 0;
+        bar_window->items_window_max_length = 0;
+        bar_window->items_num_lines[index_item][index_subitem] =
+            gui_bar_item_count_lines (bar_window->items_content[index_item][index_subitem]);
+    }
+
+    if (extra_info)
+        hashtable_free (extra_info);
+}
+
 /*
  * Builds content of an item for a bar window.
  */
@@ -592,6 +720,8 @@ gui_bar_window_content_build_item (struct t_gui_bar_window *bar_window,
                                    struct t_gui_window *window,
                                    int index_item, int index_subitem)
 {
+    int old_scroll_y;
+
     if (!bar_window)
         return;
 
@@ -602,17 +732,41 @@ gui_bar_window_content_build_item (struct t_gui_bar_window *bar_window,
             free (bar_window->items_content[index_item][index_subitem]);
             bar_window->items_content[index_item][index_subitem] = NULL;
         }
+
+        /* scroll after the end (for example "/bar scroll ... e")? */
+        if (bar_window->items_window_first_line >= 0)
+            gui_bar_window_content_window_clamp (bar_window);
+
         bar_window->items_num_lines[index_item][index_subitem] = 0;
 
         /* build item, but only if there's a buffer in window */
         if ((window && window->buffer)
             || (gui_current_window && gui_current_window->buffer))
         {
-            bar_window->items_content[index_item][index_subitem] =
-                gui_bar_item_get_value (bar_window->bar, window,
-                                        index_item, index_subitem);
-            bar_window->items_num_lines[index_item][index_subitem] =
-                gui_bar_item_count_lines (bar_window->items_content[index_item][index_subitem]);
+            gui_bar_window_content_build_item_value (bar_window, window,
+                                                     index_item,
+                                                     index_subitem);
+            /*
+             * if the windowed item has less lines than before, the scroll may
+             * be after the end: build again the lines displayed
+             */
+            if (bar_window->items_window_first_line >= 0)
+            {
+                old_scroll_y = bar_window->scroll_y;
+                gui_bar_window_content_window_clamp (bar_window);
+                if (bar_window->scroll_y != old_scroll_y)
+                {
+                    if (bar_window->items_content[index_item][index_subitem])
+                    {
+                        free (bar_window->items_content[index_item][index_subitem]);
+                        bar_window->items_content[index_item][index_subitem] = NULL;
+                    }
+                    gui_bar_window_content_build_item_value (bar_window,
+                                                             window,
+                                                             index_item,
+                                                             index_subitem);
+                }
+            }
             bar_window->items_refresh_needed[index_item][index_subitem] = 0;
         }
     }
@@ -656,8 +810,14 @@ gui_bar_window_content_get (struct t_gui_bar_window *bar_window,
     if (!bar_window)
         return NULL;
 
-    /* rebuild content if refresh is needed */
-    if (bar_window->items_refresh_needed[index_item][index_subitem])
+    /*
+     * rebuild content if refresh is needed, or if lines displayed have changed
+     * (scroll or size of bar window) for a windowed item
+     */
+    if (bar_window->items_refresh_needed[index_item][index_subitem]
+        || ((bar_window->items_window_first_line >= 0)
+            && ((bar_window->items_window_first_line != bar_window->scroll_y)
+                || (bar_window->items_window_lines != bar_window->height))))
     {
         gui_bar_window_content_build_item (bar_window, window,
                                            index_item, index_subitem);
@@ -1155,6 +1315,9 @@ gui_bar_window_new (struct t_gui_bar *bar, struct t_gui_window *window)
         new_bar_window->items_content = NULL;
         new_bar_window->items_num_lines = NULL;
         new_bar_window->items_refresh_needed = NULL;
+        new_bar_window->items_window_first_line = -1;
+        new_bar_window->items_window_lines = 0;
+        new_bar_window->items_window_max_length = 0;
         new_bar_window->screen_col_size = 0;
         new_bar_window->screen_lines = 0;
         new_bar_window->coords_count = 0;
@@ -1592,6 +1755,9 @@ gui_bar_window_hdata_bar_window_cb (const void *pointer, void *data,
         HDATA_VAR(struct t_gui_bar_window, items_content, POINTER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_bar_window, items_num_lines, POINTER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_bar_window, items_refresh_needed, POINTER, 0, NULL, NULL);
+        HDATA_VAR(struct t_gui_bar_window, items_window_first_line, INTEGER, 0, NULL, NULL);
+        HDATA_VAR(struct t_gui_bar_window, items_window_lines, INTEGER, 0, NULL, NULL);
+        HDATA_VAR(struct t_gui_bar_window, items_window_max_length, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_bar_window, screen_col_size, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_bar_window, screen_lines, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_bar_window, coords_count, INTEGER, 0, NULL, NULL);
@@ -1722,6 +1888,9 @@ gui_bar_window_print_log (struct t_gui_bar_window *bar_window)
             log_printf ("    items_content. . . . . . : 0x%lx", bar_window->items_content);
         }
     }
+    log_printf ("    items_window_first_line: %d", bar_window->items_window_first_line);
+    log_printf ("    items_window_lines . . : %d", bar_window->items_window_lines);
+    log_printf ("    items_window_max_length: %d", bar_window->items_window_max_length);
     log_printf ("    screen_col_size. . . . : %d", bar_window->screen_col_size);
     log_printf ("    screen_lines . . . . . : %d", bar_window->screen_lines);
     log_printf ("    coords_count . . . . . : %d", bar_window->coords_count);
@@ -49,6 +49,12 @@ struct t_gui_bar_window
     char ***items_content;          /* content for each (sub)item of bar    */
     int **items_num_lines;          /* number of lines for each (sub)item   */
     int **items_refresh_needed;     /* refresh needed for (sub)item?        */
+    int items_window_first_line;    /* first line built for the item, if    */
+                                    /* only lines displayed were built      */
+                                    /* (-1 if all lines were built)         */
+    int items_window_lines;         /* number of lines asked to the item    */
+    int items_window_max_length;    /* max length of all lines in the item  */
+                                    /* (only lines displayed were built)    */
     int screen_col_size;            /* size of columns on screen            */
                                     /* (for filling with columns)           */
     int screen_lines;               /* number of lines on screen            */
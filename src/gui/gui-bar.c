@@ -403,6 +403,40 @@ gui_bar_check_conditions (struct t_gui_bar *bar,
     return rc;
 }
 
+/*
+ * Checks if bar conditions may change when items of the bar are updated.
+ *
+ * Result of empty conditions and keywords "active", "inactive" and
+ * "nicklist" depends only on windows and buffers (any change on them
+ * triggers a full refresh of screen), so they are not evaluated again when
+ * an item is updated, unless the modifier "bar_condition_xxx" is hooked.
+ *
+ * Returns:
+ *   1: conditions must be evaluated again
+ *   0: conditions can not change with an update of items
+ */
+
+int
+gui_bar_conditions_depend_on_items (struct t_gui_bar *bar)
+{
+    const char *conditions;
+    char str_modifier[256];
+
+    conditions = CONFIG_STRING(bar->options[GUI_BAR_OPTION_CONDITIONS]);
+    if (conditions[0]
+        && (string_strcasecmp (conditions, "active") != 0)
+        && (string_strcasecmp (conditions, "inactive") != 0)
+        && (string_strcasecmp (conditions, "nicklist") != 0))
+    {
+        return 1;
+    }
+
+    snprintf (str_modifier, sizeof (str_modifier),
+              "bar_condition_%s", bar->name);
+
+    return (hook_search_modifier (str_modifier)) ? 1 : 0;
+}
+
 /*
  * Gets total bar size ("root" type) for a position.
  */
@@ -633,6 +667,9 @@ gui_bar_free_items_arrays (struct t_gui_bar *bar)
 {
     int i, j;
 
+    /* slots of items in bars have changed */
+    gui_bar_item_index_invalidate ();
+
     for (i = 0; i < bar->items_count; i++)
     {
         if (bar->items_array[i])
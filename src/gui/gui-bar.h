@@ -118,6 +118,7 @@ extern int gui_bar_search_position (const char *position);
 extern enum t_gui_bar_filling gui_bar_get_filling (struct t_gui_bar *bar);
 extern int gui_bar_check_conditions (struct t_gui_bar *bar,
                                      struct t_gui_window *window);
+extern int gui_bar_conditions_depend_on_items (struct t_gui_bar *bar);
 extern int gui_bar_root_get_size (struct t_gui_bar *bar,
                                   enum t_gui_bar_position position);
 extern struct t_gui_bar *gui_bar_search (const char *name);
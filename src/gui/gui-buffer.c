@@ -65,6 +65,11 @@
 struct t_gui_buffer *gui_buffers = NULL;           /* first buffer          */
 struct t_gui_buffer *last_gui_buffer = NULL;       /* last buffer           */
 int gui_buffers_count = 0;                         /* number of buffers     */
+struct t_hashtable *gui_buffers_pointers = NULL;   /* all buffers (to check */
+                                                   /* pointers quickly)     */
+struct t_gui_buffer *gui_buffer_main = NULL;       /* main buffer (cache    */
+                                                   /* for search of main   */
+                                                   /* buffer)              */
 
 /* history of last visited buffers */
 struct t_gui_buffer_visited *gui_buffers_visited = NULL;
@@ -89,7 +94,8 @@ char *gui_buffer_properties_get_integer[] =
   "prefix_max_length", "time_for_each_line", "nicklist",
   "nicklist_case_sensitive", "nicklist_max_length", "nicklist_display_groups",
   "nicklist_count", "nicklist_groups_count", "nicklist_nicks_count",
-  "nicklist_visible_count", "input", "input_get_unknown_commands",
+  "nicklist_visible_count", "nicklist_bulk_add", "input",
+  "input_get_unknown_commands",
   "input_get_empty", "input_size", "input_length", "input_pos",
   "input_1st_display", "num_history", "text_search", "text_search_exact",
   "text_search_regex", "text_search_where", "text_search_found",
@@ -109,7 +115,8 @@ char *gui_buffer_properties_set[] =
 { "hotlist", "unread", "display", "hidden", "print_hooks_enabled", "day_change",
   "clear", "filter", "number", "name", "short_name", "type", "notify", "title",
   "time_for_each_line", "nicklist", "nicklist_case_sensitive",
-  "nicklist_display_groups", "highlight_words", "highlight_words_add",
+  "nicklist_display_groups", "nicklist_bulk_add", "highlight_words",
+  "highlight_words_add",
   "highlight_words_del", "highlight_regex", "highlight_tags_restrict",
   "highlight_tags", "hotlist_max_level_nicks", "hotlist_max_level_nicks_add",
   "hotlist_max_level_nicks_del", "input", "input_pos",
@@ -192,6 +199,7 @@ gui_buffer_local_var_add (struct t_gui_buffer *buffer, const char *name,
 
     ptr_value = hashtable_get (buffer->local_variables, name);
     hashtable_set (buffer->local_variables, name, value);
+    gui_buffer_highlight_words_compiled_free (buffer);
     (void) hook_signal_send ((ptr_value) ?
                              "buffer_localvar_changed" : "buffer_localvar_added",
                              WEECHAT_HOOK_SIGNAL_POINTER, buffer);
@@ -213,6 +221,7 @@ gui_buffer_local_var_remove (struct t_gui_buffer *buffer, const char *name)
     if (ptr_value)
     {
         hashtable_remove (buffer->local_variables, name);
+        gui_buffer_highlight_words_compiled_free (buffer);
         (void) hook_signal_send ("buffer_localvar_removed",
                                  WEECHAT_HOOK_SIGNAL_POINTER, buffer);
     }
@@ -228,6 +237,7 @@ gui_buffer_local_var_remove_all (struct t_gui_buffer *buffer)
     if (buffer && buffer->local_variables)
     {
         hashtable_remove_all (buffer->local_variables);
+        gui_buffer_highlight_words_compiled_free (buffer);
         (void) hook_signal_send ("buffer_localvar_removed",
                                  WEECHAT_HOOK_SIGNAL_POINTER, buffer);
     }
@@ -681,6 +691,8 @@ gui_buffer_new (struct t_weechat_plugin *plugin,
     new_buffer->nicklist_groups_count = 0;
     new_buffer->nicklist_nicks_count = 0;
     new_buffer->nicklist_visible_count = 0;
+    new_buffer->nicklist_nicks = NULL;
+    new_buffer->nicklist_bulk_add = 0;
     new_buffer->nickcmp_callback = NULL;
     new_buffer->nickcmp_callback_pointer = NULL;
     new_buffer->nickcmp_callback_data = NULL;
@@ -731,6 +743,7 @@ gui_buffer_new (struct t_weechat_plugin *plugin,
 
     /* highlight */
     new_buffer->highlight_words = NULL;
+    new_buffer->highlight_words_compiled = NULL;
     new_buffer->highlight_regex = NULL;
     new_buffer->highlight_regex_compiled = NULL;
     new_buffer->highlight_tags_restrict = NULL;
@@ -768,6 +781,16 @@ gui_buffer_new (struct t_weechat_plugin *plugin,
 
     gui_buffers_count++;
 
+    if (!gui_buffers_pointers)
+    {
+        gui_buffers_pointers = hashtable_new (32,
+                                              WEECHAT_HASHTABLE_POINTER,
+                                              WEECHAT_HASHTABLE_POINTER,
+                                              NULL, NULL);
+    }
+    if (gui_buffers_pointers)
+        hashtable_set (gui_buffers_pointers, new_buffer, NULL);
+
     /* set notify level */
     new_buffer->notify = gui_buffer_notify_get (new_buffer);
 
@@ -869,6 +892,10 @@ gui_buffer_valid (struct t_gui_buffer *buffer)
     if (!buffer)
         return 1;
 
+    /* check pointer with the registry of buffers */
+    if (gui_buffers_pointers)
+        return (hashtable_has_key (gui_buffers_pointers, buffer)) ? 1 : 0;
+
     for (ptr_buffer = gui_buffers; ptr_buffer;
          ptr_buffer = ptr_buffer->next_buffer)
     {
@@ -1148,6 +1175,8 @@ gui_buffer_get_integer (struct t_gui_buffer *buffer, const char *property)
         return buffer->nicklist_max_length;
     else if (string_strcasecmp (property, "nicklist_display_groups") == 0)
         return buffer->nicklist_display_groups;
+    else if (string_strcasecmp (property, "nicklist_bulk_add") == 0)
+        return buffer->nicklist_bulk_add;
     else if (string_strcasecmp (property, "nicklist_count") == 0)
         return buffer->nicklist_count;
     else if (string_strcasecmp (property, "nicklist_groups_count") == 0)
@@ -1282,6 +1311,10 @@ gui_buffer_set_name (struct t_gui_buffer *buffer, const char *name)
     buffer->name = strdup (name);
     gui_buffer_build_full_name (buffer);
 
+    /* name is displayed in merged buffers if there is no short name */
+    if (!buffer->short_name)
+        gui_line_layout_changed ();
+
     gui_buffer_local_var_add (buffer, "name", name);
 
     (void) hook_signal_send ("buffer_renamed",
@@ -1308,6 +1341,7 @@ gui_buffer_set_short_name (struct t_gui_buffer *buffer, const char *short_name)
 
     if (buffer->mixed_lines)
         buffer->mixed_lines->buffer_max_length_refresh = 1;
+    gui_line_layout_changed ();
     gui_buffer_ask_chat_refresh (buffer, 1);
 
     (void) hook_signal_send ("buffer_renamed",
@@ -1366,6 +1400,7 @@ gui_buffer_set_time_for_each_line (struct t_gui_buffer *buffer,
         return;
 
     buffer->time_for_each_line = (time_for_each_line) ? 1 : 0;
+    gui_line_layout_changed ();
     gui_buffer_ask_chat_refresh (buffer, 2);
 }
 
@@ -1414,6 +1449,30 @@ gui_buffer_set_nicklist_display_groups (struct t_gui_buffer *buffer,
     gui_window_ask_refresh (1);
 }
 
+/*
+ * Sets flag "nicklist_bulk_add" for a buffer: when enabled, nicks are added
+ * at the end of their group, without sorting; when disabled, all nicks are
+ * sorted (this is faster than sorting on each add when many nicks are added
+ * at once).
+ */
+
+void
+gui_buffer_set_nicklist_bulk_add (struct t_gui_buffer *buffer, int bulk_add)
+{
+    if (!buffer)
+        return;
+
+    if (bulk_add)
+    {
+        buffer->nicklist_bulk_add = 1;
+    }
+    else if (buffer->nicklist_bulk_add)
+    {
+        buffer->nicklist_bulk_add = 0;
+        gui_nicklist_sort (buffer);
+    }
+}
+
 /*
  * Sets highlight words for a buffer.
  */
@@ -1429,6 +1488,94 @@ gui_buffer_set_highlight_words (struct t_gui_buffer *buffer,
         free (buffer->highlight_words);
     buffer->highlight_words = (new_highlight_words && new_highlight_words[0]) ?
         strdup (new_highlight_words) : NULL;
+    gui_buffer_highlight_words_compiled_free (buffer);
+}
+
+/*
+ * Frees compiled highlight words of a buffer (they will be compiled again on
+ * next use).
+ *
+ * This function must be called when highlight words or local variables of
+ * buffer are changed.
+ */
+
+void
+gui_buffer_highlight_words_compiled_free (struct t_gui_buffer *buffer)
+{
+    if (buffer && buffer->highlight_words_compiled)
+    {
+        string_highlight_free (buffer->highlight_words_compiled);
+        buffer->highlight_words_compiled = NULL;
+    }
+}
+
+/*
+ * Frees compiled highlight words of all buffers (called when global highlight
+ * words are changed).
+ */
+
+void
+gui_buffer_highlight_words_compiled_free_all ()
+{
+    struct t_gui_buffer *ptr_buffer;
+
+    for (ptr_buffer = gui_buffers; ptr_buffer;
+         ptr_buffer = ptr_buffer->next_buffer)
+    {
+        gui_buffer_highlight_words_compiled_free (ptr_buffer);
+    }
+}
+
+/*
+ * Adds highlight words in compiled highlight words, after replacement of
+ * local variables of buffer.
+ */
+
+void
+gui_buffer_highlight_words_compiled_add (struct t_gui_buffer *buffer,
+                                         const char *highlight_words)
+{
+    char *words;
+
+    if (!highlight_words || !highlight_words[0])
+        return;
+
+    words = gui_buffer_string_replace_local_var (buffer, highlight_words);
+    string_highlight_add_words (buffer->highlight_words_compiled,
+                                (words) ? words : highlight_words);
+    if (words)
+        free (words);
+}
+
+/*
+ * Gets compiled highlight words of a buffer: buffer highlight words and
+ * global highlight words (option weechat.look.highlight), with local
+ * variables replaced.
+ *
+ * Words are compiled on first call, then kept in buffer until highlight words
+ * or local variables are changed.
+ *
+ * Returns pointer to compiled highlight words, NULL if error.
+ */
+
+struct t_string_highlight *
+gui_buffer_get_highlight_words_compiled (struct t_gui_buffer *buffer)
+{
+    if (!buffer)
+        return NULL;
+
+    if (!buffer->highlight_words_compiled)
+    {
+        buffer->highlight_words_compiled = string_highlight_new ();
+        if (!buffer->highlight_words_compiled)
+            return NULL;
+        gui_buffer_highlight_words_compiled_add (
+            buffer, buffer->highlight_words);
+        gui_buffer_highlight_words_compiled_add (
+            buffer, CONFIG_STRING(config_look_highlight));
+    }
+
+    return buffer->highlight_words_compiled;
 }
 
 /*
@@ -2066,6 +2213,13 @@ gui_buffer_set (struct t_gui_buffer *buffer, const char *property,
         if (error && !error[0])
             gui_buffer_set_nicklist_display_groups (buffer, number);
     }
+    else if (string_strcasecmp (property, "nicklist_bulk_add") == 0)
+    {
+        error = NULL;
+        number = strtol (value, &error, 10);
+        if (error && !error[0])
+            gui_buffer_set_nicklist_bulk_add (buffer, number);
+    }
     else if (string_strcasecmp (property, "highlight_words") == 0)
     {
         gui_buffer_set_highlight_words (buffer, value);
@@ -2288,6 +2442,8 @@ gui_buffer_is_main (const char *plugin_name, const char *name)
 
 /*
  * Gets main buffer (weechat one, created at startup).
+ *
+ * The main buffer found is kept, so that next searches are fast.
  */
 
 struct t_gui_buffer *
@@ -2295,13 +2451,25 @@ gui_buffer_search_main ()
 {
     struct t_gui_buffer *ptr_buffer;
 
+    /* main buffer found in a previous search (if not renamed) */
+    if (gui_buffer_main
+        && !gui_buffer_main->plugin
+        && gui_buffer_main->name
+        && (strcmp (gui_buffer_main->name, GUI_BUFFER_MAIN) == 0))
+    {
+        return gui_buffer_main;
+    }
+
     for (ptr_buffer = gui_buffers; ptr_buffer;
          ptr_buffer = ptr_buffer->next_buffer)
     {
         if ((!ptr_buffer->plugin)
             && (ptr_buffer->name)
             && (strcmp (ptr_buffer->name, GUI_BUFFER_MAIN) == 0))
+        {
+            gui_buffer_main = ptr_buffer;
             return ptr_buffer;
+        }
     }
 
     /* buffer not found (should never occur!) */
@@ -2838,6 +3006,8 @@ gui_buffer_close (struct t_gui_buffer *buffer)
         gui_completion_free (buffer->completion);
     gui_nicklist_remove_all (buffer);
     gui_nicklist_remove_group (buffer, buffer->nicklist_root);
+    if (buffer->nicklist_nicks)
+        hashtable_free (buffer->nicklist_nicks);
     if (buffer->hotlist_max_level_nicks)
         hashtable_free (buffer->hotlist_max_level_nicks);
     gui_key_free_all (&buffer->keys, &buffer->last_key,
@@ -2867,6 +3037,7 @@ gui_buffer_close (struct t_gui_buffer *buffer)
     }
     if (buffer->highlight_words)
         free (buffer->highlight_words);
+    gui_buffer_highlight_words_compiled_free (buffer);
     if (buffer->highlight_regex)
         free (buffer->highlight_regex);
     if (buffer->highlight_regex_compiled)
@@ -2921,9 +3092,22 @@ gui_buffer_close (struct t_gui_buffer *buffer)
     if (gui_buffer_last_displayed == buffer)
         gui_buffer_last_displayed = NULL;
 
+    if (gui_buffer_main == buffer)
+        gui_buffer_main = NULL;
+
     if (gui_buffers_count > 0)
         gui_buffers_count--;
 
+    if (gui_buffers_pointers)
+    {
+        hashtable_remove (gui_buffers_pointers, buffer);
+        if (!gui_buffers)
+        {
+            hashtable_free (gui_buffers_pointers);
+            gui_buffers_pointers = NULL;
+        }
+    }
+
     (void) hook_signal_send ("buffer_closed",
                              WEECHAT_HOOK_SIGNAL_POINTER, buffer);
 
@@ -4237,6 +4421,8 @@ gui_buffer_hdata_buffer_cb (const void *pointer, void *data,
         HDATA_VAR(struct t_gui_buffer, nicklist_groups_count, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nicklist_nicks_count, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nicklist_visible_count, INTEGER, 0, NULL, NULL);
+        HDATA_VAR(struct t_gui_buffer, nicklist_nicks, HASHTABLE, 0, NULL, NULL);
+        HDATA_VAR(struct t_gui_buffer, nicklist_bulk_add, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nickcmp_callback, POINTER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nickcmp_callback_pointer, POINTER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, nickcmp_callback_data, POINTER, 0, NULL, NULL);
@@ -4270,6 +4456,7 @@ gui_buffer_hdata_buffer_cb (const void *pointer, void *data,
         HDATA_VAR(struct t_gui_buffer, text_search_found, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, text_search_input, STRING, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, highlight_words, STRING, 0, NULL, NULL);
+        HDATA_VAR(struct t_gui_buffer, highlight_words_compiled, POINTER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, highlight_regex, STRING, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, highlight_regex_compiled, POINTER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_buffer, highlight_tags_restrict, STRING, 0, NULL, NULL);
@@ -4289,6 +4476,7 @@ gui_buffer_hdata_buffer_cb (const void *pointer, void *data,
         HDATA_LIST(gui_buffers, WEECHAT_HDATA_LIST_CHECK_POINTERS);
         HDATA_LIST(last_gui_buffer, 0);
         HDATA_LIST(gui_buffer_last_displayed, 0);
+        HDATA_POINTERS(gui_buffers_pointers);
     }
     return hdata;
 }
@@ -4595,6 +4783,8 @@ gui_buffer_print_log ()
     log_printf ("gui_buffers . . . . . . . . . : 0x%lx", gui_buffers);
     log_printf ("last_gui_buffer . . . . . . . : 0x%lx", last_gui_buffer);
     log_printf ("gui_buffers_count . . . . . . : %d",    gui_buffers_count);
+    log_printf ("gui_buffers_pointers. . . . . : 0x%lx", gui_buffers_pointers);
+    log_printf ("gui_buffer_main . . . . . . . : 0x%lx", gui_buffer_main);
     log_printf ("gui_buffers_visited . . . . . : 0x%lx", gui_buffers_visited);
     log_printf ("last_gui_buffer_visited . . . : 0x%lx", last_gui_buffer_visited);
     log_printf ("gui_buffers_visited_index . . : %d",    gui_buffers_visited_index);
@@ -4647,6 +4837,8 @@ gui_buffer_print_log ()
         log_printf ("  nicklist_groups_count . : %d",    ptr_buffer->nicklist_groups_count);
         log_printf ("  nicklist_nicks_count. . : %d",    ptr_buffer->nicklist_nicks_count);
         log_printf ("  nicklist_visible_count. : %d",    ptr_buffer->nicklist_visible_count);
+        log_printf ("  nicklist_nicks. . . . . : 0x%lx", ptr_buffer->nicklist_nicks);
+        log_printf ("  nicklist_bulk_add . . . : %d",    ptr_buffer->nicklist_bulk_add);
         log_printf ("  nickcmp_callback. . . . : 0x%lx", ptr_buffer->nickcmp_callback);
         log_printf ("  nickcmp_callback_pointer: 0x%lx", ptr_buffer->nickcmp_callback_pointer);
         log_printf ("  nickcmp_callback_data . : 0x%lx", ptr_buffer->nickcmp_callback_data);
@@ -4689,6 +4881,7 @@ gui_buffer_print_log ()
         log_printf ("  text_search_found . . . : %d",    ptr_buffer->text_search_found);
         log_printf ("  text_search_input . . . : '%s'",  ptr_buffer->text_search_input);
         log_printf ("  highlight_words . . . . : '%s'",  ptr_buffer->highlight_words);
+        log_printf ("  highlight_words_compiled: 0x%lx", ptr_buffer->highlight_words_compiled);
         log_printf ("  highlight_regex . . . . : '%s'",  ptr_buffer->highlight_regex);
         log_printf ("  highlight_regex_compiled: 0x%lx", ptr_buffer->highlight_regex_compiled);
         log_printf ("  highlight_tags_restrict. . . : '%s'",  ptr_buffer->highlight_tags_restrict);
@@ -135,6 +135,9 @@ struct t_gui_buffer
     int nicklist_groups_count;         /* number of groups                  */
     int nicklist_nicks_count;          /* number of nicks                   */
     int nicklist_visible_count;        /* number of nicks/groups to display */
+    struct t_hashtable *nicklist_nicks; /* nicks by name (case insensitive) */
+    int nicklist_bulk_add;             /* 1 if nicks are added without      */
+                                       /* sort (sorted when set back to 0)  */
     int (*nickcmp_callback)(const void *pointer, /* called to compare nicks */
                             void *data,          /* (search in nicklist)    */
                             struct t_gui_buffer *buffer,
@@ -190,6 +193,9 @@ struct t_gui_buffer
 
     /* highlight settings for buffer */
     char *highlight_words;             /* list of words to highlight        */
+    struct t_string_highlight *highlight_words_compiled;
+                                       /* buffer + global highlight words   */
+                                       /* compiled (with local vars)        */
     char *highlight_regex;             /* regex for highlight               */
     regex_t *highlight_regex_compiled; /* compiled regex                    */
     char *highlight_tags_restrict;     /* restrict highlight to these tags  */
@@ -229,6 +235,8 @@ struct t_gui_buffer_visited
 extern struct t_gui_buffer *gui_buffers;
 extern struct t_gui_buffer *last_gui_buffer;
 extern int gui_buffers_count;
+extern struct t_hashtable *gui_buffers_pointers;
+extern struct t_gui_buffer *gui_buffer_main;
 extern struct t_gui_buffer_visited *gui_buffers_visited;
 extern struct t_gui_buffer_visited *last_gui_buffer_visited;
 extern int gui_buffers_visited_index;
@@ -287,6 +295,9 @@ extern void gui_buffer_set_title (struct t_gui_buffer *buffer,
                                   const char *new_title);
 extern void gui_buffer_set_highlight_words (struct t_gui_buffer *buffer,
                                             const char *new_highlight_words);
+extern void gui_buffer_highlight_words_compiled_free (struct t_gui_buffer *buffer);
+extern void gui_buffer_highlight_words_compiled_free_all ();
+extern struct t_string_highlight *gui_buffer_get_highlight_words_compiled (struct t_gui_buffer *buffer);
 extern void gui_buffer_set_highlight_regex (struct t_gui_buffer *buffer,
                                             const char *new_highlight_regex);
 extern void gui_buffer_set_highlight_tags_restrict (struct t_gui_buffer *buffer,
@@ -689,6 +689,7 @@ gui_chat_printf_date_tags (struct t_gui_buffer *buffer, time_t date,
         date = date_printed;
 
     at_least_one_message_printed = 0;
+    modifier_data = NULL;
 
     pos = vbuffer;
     while (pos)
@@ -698,25 +699,35 @@ gui_chat_printf_date_tags (struct t_gui_buffer *buffer, time_t date,
         if (pos_end)
             pos_end[0] = '\0';
 
-        /* call modifier for message printed ("weechat_print") */
+        /*
+         * call modifier for message printed ("weechat_print"), the modifier
+         * data is built only if there is a modifier (and only one time for
+         * all lines of message); the counter of modifiers is checked to not
+         * search in the list of modifier hooks for each line printed
+         */
         new_msg = NULL;
         msg_discarded = 0;
-        if (buffer)
+        if (buffer && (hook_modifier_print_count > 0))
         {
-            length = strlen (gui_buffer_get_plugin_name (buffer)) + 1 +
-                strlen (buffer->name) + 1 + ((tags) ? strlen (tags) : 0) + 1;
-            modifier_data = malloc (length);
+            if (!modifier_data)
+            {
+                length = strlen (gui_buffer_get_plugin_name (buffer)) + 1 +
+                    strlen (buffer->name) + 1 + ((tags) ? strlen (tags) : 0) + 1;
+                modifier_data = malloc (length);
+                if (modifier_data)
+                {
+                    snprintf (modifier_data, length, "%s;%s;%s",
+                              gui_buffer_get_plugin_name (buffer),
+                              buffer->name,
+                              (tags) ? tags : "");
+                }
+            }
             if (modifier_data)
             {
-                snprintf (modifier_data, length, "%s;%s;%s",
-                          gui_buffer_get_plugin_name (buffer),
-                          buffer->name,
-                          (tags) ? tags : "");
                 new_msg = hook_modifier_exec (NULL,
                                               "weechat_print",
                                               modifier_data,
                                               pos);
-                free (modifier_data);
                 if (new_msg)
                 {
                     if (!new_msg[0] && pos[0])
@@ -834,6 +845,9 @@ gui_chat_printf_date_tags (struct t_gui_buffer *buffer, time_t date,
         pos = (pos_end && pos_end[1]) ? pos_end + 1 : NULL;
     }
 
+    if (modifier_data)
+        free (modifier_data);
+
     if (gui_init_ok && at_least_one_message_printed)
         gui_buffer_ask_chat_refresh (buffer, 1);
 
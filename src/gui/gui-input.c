@@ -1777,6 +1777,7 @@ gui_input_zoom_merged_buffer (struct t_gui_buffer *buffer)
 
     gui_buffer_compute_num_displayed ();
 
+    gui_line_layout_changed ();
     gui_buffer_ask_chat_refresh (buffer, 2);
 
     (void) hook_signal_send ((buffer_was_zoomed) ?
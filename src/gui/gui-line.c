@@ -47,6 +47,10 @@
 #include "gui-window.h"
 
 
+int gui_line_layout_id = 1;            /* id of layout for lines, changed   */
+                                       /* when an option changes layout     */
+
+
 /*
  * Allocates structure "t_gui_lines" and initializes it.
  *
@@ -330,6 +334,123 @@ gui_line_get_align (struct t_gui_buffer *buffer, struct t_gui_line *line,
         + length_suffix;
 }
 
+/*
+ * Invalidates the rows cached in all lines: this function must be called when
+ * something changes the layout of lines on screen (options, buffer
+ * properties, merge of buffers, ...).
+ */
+
+void
+gui_line_layout_changed ()
+{
+    gui_line_layout_id++;
+    if (gui_line_layout_id <= 0)
+        gui_line_layout_id = 1;
+}
+
+/*
+ * Gets flags for rows cached in a line: first row of line displayed on
+ * screen and prefix replaced because nick is the same as previous line.
+ */
+
+int
+gui_line_rows_flags (struct t_gui_line *line, int first_row)
+{
+    int flags;
+
+    flags = (first_row) ? 1 : 0;
+
+    if (CONFIG_STRING(config_look_prefix_same_nick)
+        && CONFIG_STRING(config_look_prefix_same_nick)[0]
+        && gui_line_prefix_is_same_nick_as_previous (line))
+    {
+        flags |= 2;
+    }
+
+    return flags;
+}
+
+/*
+ * Gets number of rows on screen for time, prefix and message of a line,
+ * from cache.
+ *
+ * Argument "buffer" is the buffer displayed in window and "width" the width
+ * of chat area in window.
+ *
+ * Returns number of rows, -1 if rows are not in cache (or if cache is not
+ * valid any more).
+ */
+
+int
+gui_line_rows_get (struct t_gui_line *line, struct t_gui_buffer *buffer,
+                   int width, int first_row)
+{
+    struct t_gui_line_rows *ptr_rows;
+
+    if (!line || !buffer || !line->data->rows)
+        return -1;
+
+    ptr_rows = line->data->rows;
+
+    if ((ptr_rows->layout_id != gui_line_layout_id)
+        || (ptr_rows->buffer != buffer)
+        || (ptr_rows->lines != buffer->lines)
+        || (ptr_rows->width != width)
+        || (ptr_rows->prefix_max_length != buffer->lines->prefix_max_length)
+        || (ptr_rows->buffer_max_length != ((line->data->buffer->mixed_lines) ?
+                                            line->data->buffer->mixed_lines->buffer_max_length : 0))
+        || (ptr_rows->flags != gui_line_rows_flags (line, first_row)))
+    {
+        return -1;
+    }
+
+    return ptr_rows->count;
+}
+
+/*
+ * Sets number of rows on screen for time, prefix and message of a line in
+ * cache.
+ */
+
+void
+gui_line_rows_set (struct t_gui_line *line, struct t_gui_buffer *buffer,
+                   int width, int first_row, int count)
+{
+    if (!line || !buffer)
+        return;
+
+    if (!line->data->rows)
+    {
+        line->data->rows = malloc (sizeof (*line->data->rows));
+        if (!line->data->rows)
+            return;
+    }
+
+    line->data->rows->layout_id = gui_line_layout_id;
+    line->data->rows->buffer = buffer;
+    line->data->rows->lines = buffer->lines;
+    line->data->rows->width = width;
+    line->data->rows->prefix_max_length = buffer->lines->prefix_max_length;
+    line->data->rows->buffer_max_length = (line->data->buffer->mixed_lines) ?
+        line->data->buffer->mixed_lines->buffer_max_length : 0;
+    line->data->rows->flags = gui_line_rows_flags (line, first_row);
+    line->data->rows->count = count;
+}
+
+/*
+ * Frees rows cached in a line.
+ */
+
+void
+gui_line_rows_free (struct t_gui_line_data *line_data)
+{
+    if (line_data && line_data->rows)
+    {
+        free (line_data->rows);
+        line_data->rows = NULL;
+    }
+}
+
 /*
  * Checks if a line is displayed (no filter on line or filters disabled).
  *
@@ -429,9 +550,122 @@ gui_line_get_next_displayed (struct t_gui_line *line)
     return line;
 }
 
+/*
+ * Adds trigrams of a string in a search index.
+ *
+ * Trigrams are made of bytes, with ASCII upper case letters converted to
+ * lower case (like function string_strcasestr does), so the same index is
+ * used for a search with or without case.
+ */
+
+void
+gui_line_search_index_add (unsigned long long *search_index,
+                           const char *string)
+{
+    const unsigned char *ptr_string;
+    unsigned int trigram, hash;
+    int length, bit;
+
+    if (!search_index || !string)
+        return;
+
+    trigram = 0;
+    length = 0;
+    for (ptr_string = (const unsigned char *)string; ptr_string[0];
+         ptr_string++)
+    {
+        trigram = ((trigram << 8)
+                   | (((ptr_string[0] >= 'A') && (ptr_string[0] <= 'Z')) ?
+                      ptr_string[0] + ('a' - 'A') : ptr_string[0])) & 0xFFFFFF;
+        length++;
+        if (length >= 3)
+        {
+            hash = (trigram * 2654435761U) >> 16;
+            bit = hash % GUI_LINE_SEARCH_INDEX_BITS;
+            search_index[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+}
+
+/*
+ * Builds search index of a line: trigrams of prefix and message, without
+ * colors.
+ *
+ * If option weechat.look.buffer_search_index is off, the line is not indexed
+ * (and then always checked by a search).
+ */
+
+void
+gui_line_search_index_build (struct t_gui_line_data *line_data)
+{
+    char *prefix, *message;
+
+    if (!line_data)
+        return;
+
+    line_data->search_indexed = 0;
+    memset (line_data->search_index, 0, sizeof (line_data->search_index));
+
+    if (!CONFIG_BOOLEAN(config_look_buffer_search_index))
+        return;
+
+    if (line_data->prefix && line_data->prefix[0])
+    {
+        prefix = gui_color_decode (line_data->prefix, NULL);
+        if (!prefix)
+            return;
+        gui_line_search_index_add (line_data->search_index, prefix);
+        free (prefix);
+    }
+
+    if (line_data->message && line_data->message[0])
+    {
+        message = gui_color_decode (line_data->message, NULL);
+        if (!message)
+            return;
+        gui_line_search_index_add (line_data->search_index, message);
+        free (message);
+    }
+
+    line_data->search_indexed = 1;
+}
+
+/*
+ * Checks if a line may contain a string, using search index of line.
+ *
+ * Returns:
+ *   1: line may contain the string (or line is not indexed)
+ *   0: line does not contain the string
+ */
+
+int
+gui_line_search_index_match (struct t_gui_line_data *line_data,
+                             const char *string)
+{
+    unsigned long long search_index[GUI_LINE_SEARCH_INDEX_SIZE];
+    int i;
+
+    if (!line_data || !line_data->search_indexed || !string)
+        return 1;
+
+    memset (search_index, 0, sizeof (search_index));
+    gui_line_search_index_add (search_index, string);
+
+    for (i = 0; i < GUI_LINE_SEARCH_INDEX_SIZE; i++)
+    {
+        if ((line_data->search_index[i] & search_index[i]) != search_index[i])
+            return 0;
+    }
+
+    return 1;
+}
+
 /*
  * Searches for text in a line.
  *
+ * If the search is not a regex, the search index of line is used to skip
+ * lines which can not contain the text.
+ *
  * Returns:
  *   1: text found in line
  *   0: text not found in line
@@ -449,6 +683,12 @@ gui_line_search_text (struct t_gui_buffer *buffer, struct t_gui_line *line)
         return 0;
     }
 
+    if (!buffer->text_search_regex
+        && !gui_line_search_index_match (line->data, buffer->input_buffer))
+    {
+        return 0;
+    }
+
     rc = 0;
 
     if ((buffer->text_search_where & GUI_TEXT_SEARCH_IN_PREFIX)
@@ -699,7 +939,7 @@ int
 gui_line_has_highlight (struct t_gui_line *line)
 {
     int rc, i, no_highlight, action, length;
-    char *msg_no_color, *ptr_msg_no_color, *highlight_words;
+    char *msg_no_color, *ptr_msg_no_color;
     const char *ptr_nick;
 
     /*
@@ -804,24 +1044,9 @@ gui_line_has_highlight (struct t_gui_line *line)
      * there is highlight on line if one of buffer highlight words matches line
      * or one of global highlight words matches line
      */
-    highlight_words = gui_buffer_string_replace_local_var (line->data->buffer,
-                                                           line->data->buffer->highlight_words);
-    rc = string_has_highlight (ptr_msg_no_color,
-                               (highlight_words) ?
-                               highlight_words : line->data->buffer->highlight_words);
-    if (highlight_words)
-        free (highlight_words);
-
-    if (!rc)
-    {
-        highlight_words = gui_buffer_string_replace_local_var (line->data->buffer,
-                                                               CONFIG_STRING(config_look_highlight));
-        rc = string_has_highlight (ptr_msg_no_color,
-                                   (highlight_words) ?
-                                   highlight_words : CONFIG_STRING(config_look_highlight));
-        if (highlight_words)
-            free (highlight_words);
-    }
+    rc = string_has_highlight_compiled (
+        ptr_msg_no_color,
+        gui_buffer_get_highlight_words_compiled (line->data->buffer));
 
     if (!rc && config_highlight_regex)
     {
@@ -1006,6 +1231,15 @@ gui_line_remove_from_list (struct t_gui_buffer *buffer,
 
             if (ptr_scroll->text_search_start_line == line)
                 ptr_scroll->text_search_start_line = NULL;
+
+            /* continue search in progress on next line displayed */
+            if (ptr_scroll->text_search_next_line == line)
+            {
+                ptr_scroll->text_search_next_line =
+                    (ptr_scroll->buffer->text_search == GUI_TEXT_SEARCH_FORWARD) ?
+                    gui_line_get_next_displayed (line) :
+                    gui_line_get_prev_displayed (line);
+            }
         }
         /* remove line from coords */
         gui_window_coords_remove_line (ptr_win, line);
@@ -1040,6 +1274,7 @@ gui_line_remove_from_list (struct t_gui_buffer *buffer,
             string_shared_free (line->data->prefix);
         if (line->data->message)
             free (line->data->message);
+        gui_line_rows_free (line->data);
         free (line->data);
     }
 
@@ -1121,6 +1356,7 @@ gui_line_mixed_free_all (struct t_gui_buffer *buffer)
                                        buffer->mixed_lines->first_line,
                                        0);
         }
+        gui_line_layout_changed ();
     }
 }
 
@@ -1263,6 +1499,8 @@ gui_line_add (struct t_gui_buffer *buffer, time_t date,
     new_line->data->prefix_length = (prefix) ?
         gui_chat_strlen_screen (prefix) : 0;
     new_line->data->message = (message) ? strdup (message) : strdup ("");
+    new_line->data->rows = NULL;
+    gui_line_search_index_build (new_line->data);
 
     /* get notify level and max notify level for nick in buffer */
     notify_level = gui_line_get_notify_level (new_line);
@@ -1406,9 +1644,11 @@ gui_line_add_y (struct t_gui_buffer *buffer, int y, const char *message)
         new_line->data->tags_count = 0;
         new_line->data->tags_array = NULL;
         new_line->data->refresh_needed = 1;
+        new_line->data->search_indexed = 0;
         new_line->data->prefix = NULL;
         new_line->data->prefix_length = 0;
         new_line->data->message = NULL;
+        new_line->data->rows = NULL;
         new_line->data->highlight = 0;
 
         /* add line to lines list */
@@ -1451,6 +1691,7 @@ gui_line_add_y (struct t_gui_buffer *buffer, int y, const char *message)
         free (ptr_line->data->message);
     }
     ptr_line->data->message = (message) ? strdup (message) : strdup ("");
+    gui_line_search_index_build (ptr_line->data);
 
     /* check if line is filtered or not */
     ptr_line->data->displayed = gui_filter_check_line (ptr_line->data);
@@ -1478,6 +1719,9 @@ gui_line_clear (struct t_gui_line *line)
     if (line->data->message)
         free (line->data->message);
     line->data->message = strdup ("");
+
+    gui_line_rows_free (line->data);
+    gui_line_search_index_build (line->data);
 }
 
 /*
@@ -1571,6 +1815,8 @@ gui_line_mix_buffers (struct t_gui_buffer *buffer)
             ptr_buffer->lines = ptr_buffer->mixed_lines;
         }
     }
+
+    gui_line_layout_changed ();
 }
 
 /*
@@ -1705,8 +1951,10 @@ gui_line_hdata_line_data_update_cb (void *data,
 
     if (rc > 0)
     {
+        gui_line_rows_free (line_data);
         if (update_coords)
         {
+            gui_line_search_index_build (line_data);
             for (ptr_win = gui_windows; ptr_win; ptr_win = ptr_win->next_window)
             {
                 gui_window_coords_remove_line_data (ptr_win, line_data);
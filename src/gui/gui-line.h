@@ -25,8 +25,26 @@
 
 struct t_infolist;
 
+/* search index: trigrams of prefix/message, as bits in 64-bit integers */
+
+#define GUI_LINE_SEARCH_INDEX_SIZE 2
+#define GUI_LINE_SEARCH_INDEX_BITS (GUI_LINE_SEARCH_INDEX_SIZE * 64)
+
 /* line structures */
 
+struct t_gui_line_rows
+{
+    int layout_id;                     /* layout id when rows were computed */
+    struct t_gui_buffer *buffer;       /* buffer displayed in window        */
+    struct t_gui_lines *lines;         /* lines displayed (own/mixed lines) */
+    int width;                         /* width of chat area                */
+    int prefix_max_length;             /* max length for prefix align       */
+    int buffer_max_length;             /* max length for buffer name        */
+    int flags;                         /* first row, same nick as previous  */
+    int count;                         /* number of rows for time, prefix   */
+                                       /* and message                       */
+};
+
 struct t_gui_line_data
 {
     struct t_gui_buffer *buffer;       /* pointer to buffer                 */
@@ -39,9 +57,15 @@ struct t_gui_line_data
     char displayed;                    /* 1 if line is displayed            */
     char highlight;                    /* 1 if line has highlight           */
     char refresh_needed;               /* 1 if refresh asked (free buffer)  */
+    char search_indexed;               /* 1 if search_index is set          */
     char *prefix;                      /* prefix for line (may be NULL)     */
     int prefix_length;                 /* prefix length (on screen)         */
     char *message;                     /* line content (after prefix)       */
+    struct t_gui_line_rows *rows;      /* rows on screen (cache, may be     */
+                                       /* NULL)                             */
+    unsigned long long search_index[GUI_LINE_SEARCH_INDEX_SIZE];
+                                       /* trigrams of prefix and message    */
+                                       /* (without colors, lower case)      */
 };
 
 struct t_gui_line
@@ -66,6 +90,10 @@ struct t_gui_lines
     int prefix_max_length_refresh;     /* refresh asked for prefix max len. */
 };
 
+/* line variables */
+
+extern int gui_line_layout_id;
+
 /* line functions */
 
 extern struct t_gui_lines *gui_lines_alloc ();
@@ -76,11 +104,24 @@ extern void gui_line_get_prefix_for_display (struct t_gui_line *line,
 extern int gui_line_get_align (struct t_gui_buffer *buffer,
                                struct t_gui_line *line,
                                int with_suffix, int first_line);
+extern void gui_line_layout_changed ();
+extern int gui_line_rows_get (struct t_gui_line *line,
+                              struct t_gui_buffer *buffer, int width,
+                              int first_row);
+extern void gui_line_rows_set (struct t_gui_line *line,
+                               struct t_gui_buffer *buffer, int width,
+                               int first_row, int count);
+extern void gui_line_rows_free (struct t_gui_line_data *line_data);
 extern int gui_line_is_displayed (struct t_gui_line *line);
 extern struct t_gui_line *gui_line_get_first_displayed (struct t_gui_buffer *buffer);
 extern struct t_gui_line *gui_line_get_last_displayed (struct t_gui_buffer *buffer);
 extern struct t_gui_line *gui_line_get_prev_displayed (struct t_gui_line *line);
 extern struct t_gui_line *gui_line_get_next_displayed (struct t_gui_line *line);
+extern void gui_line_search_index_add (unsigned long long *search_index,
+                                       const char *string);
+extern void gui_line_search_index_build (struct t_gui_line_data *line_data);
+extern int gui_line_search_index_match (struct t_gui_line_data *line_data,
+                                        const char *string);
 extern int gui_line_search_text (struct t_gui_buffer *buffer,
                                  struct t_gui_line *line);
 extern int gui_line_match_regex (struct t_gui_line_data *line_data,
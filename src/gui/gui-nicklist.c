@@ -32,8 +32,10 @@
 #include <signal.h>
 #include <time.h>
 #include <ctype.h>
+#include <wctype.h>
 
 #include "../core/weechat.h"
+#include "../core/wee-arraylist.h"
 #include "../core/wee-config.h"
 #include "../core/wee-hashtable.h"
 #include "../core/wee-hdata.h"
@@ -117,6 +119,28 @@ gui_nicklist_send_hsignal (const char *signal, struct t_gui_buffer *buffer,
     (void) hook_hsignal_send (signal, gui_nicklist_hsignal);
 }
 
+/*
+ * Compares two nicks to sort them in nicklist (callback for arraylist
+ * "nicks_sorted" in groups).
+ *
+ * Returns:
+ *   < 0: nick1 < nick2
+ *     0: nick1 == nick2
+ *   > 0: nick1 > nick2
+ */
+
+int
+gui_nicklist_nick_cmp_cb (void *data, struct t_arraylist *arraylist,
+                          void *pointer1, void *pointer2)
+{
+    /* make C compiler happy */
+    (void) data;
+    (void) arraylist;
+
+    return string_strcasecmp (((struct t_gui_nick *)pointer1)->name,
+                              ((struct t_gui_nick *)pointer2)->name);
+}
+
 /*
  * Searches for position of a group (to keep nicklist sorted).
  */
@@ -277,6 +301,9 @@ gui_nicklist_add_group (struct t_gui_buffer *buffer,
     new_group->last_child = NULL;
     new_group->nicks = NULL;
     new_group->last_nick = NULL;
+    new_group->nicks_sorted = arraylist_new (32, 1, 1,
+                                             &gui_nicklist_nick_cmp_cb, NULL,
+                                             NULL, NULL);
     new_group->prev_group = NULL;
     new_group->next_group = NULL;
 
@@ -302,6 +329,164 @@ gui_nicklist_add_group (struct t_gui_buffer *buffer,
     return new_group;
 }
 
+/*
+ * Folds a char for the hashtable of nicks: the char is converted to lower
+ * case, including chars "[]\\^" (converted to "{}|~"), so that nicks equal
+ * for any IRC casemapping have the same hash.
+ */
+
+int
+gui_nicklist_fold_char (int c)
+{
+    if ((c >= 'A') && (c <= '^'))
+        return c + ('a' - 'A');
+
+    return (int)towlower ((wint_t)c);
+}
+
+/*
+ * Hashes a nick name (case insensitive) for the hashtable of nicks.
+ */
+
+unsigned long long
+gui_nicklist_hash_nick_cb (struct t_hashtable *hashtable, const void *key)
+{
+    const char *ptr_name;
+    unsigned long long hash;
+
+    /* make C compiler happy */
+    (void) hashtable;
+
+    /* variant of djb2 hash, on folded chars */
+    hash = 5381;
+    for (ptr_name = (const char *)key; ptr_name[0];
+         ptr_name = utf8_next_char (ptr_name))
+    {
+        hash = ((hash << 5) + hash) +
+            (unsigned long long)gui_nicklist_fold_char (
+                utf8_char_int (ptr_name));
+    }
+
+    return hash;
+}
+
+/*
+ * Compares two nick names (case insensitive) for the hashtable of nicks.
+ *
+ * Returns:
+ *   < 0: name1 < name2
+ *     0: name1 == name2
+ *   > 0: name1 > name2
+ */
+
+int
+gui_nicklist_keycmp_nick_cb (struct t_hashtable *hashtable,
+                             const void *key1, const void *key2)
+{
+    const char *ptr_name1, *ptr_name2;
+    int diff;
+
+    /* make C compiler happy */
+    (void) hashtable;
+
+    ptr_name1 = (const char *)key1;
+    ptr_name2 = (const char *)key2;
+
+    while (ptr_name1[0] && ptr_name2[0])
+    {
+        diff = gui_nicklist_fold_char (utf8_char_int (ptr_name1)) -
+            gui_nicklist_fold_char (utf8_char_int (ptr_name2));
+        if (diff != 0)
+            return (diff < 0) ? -1 : 1;
+        ptr_name1 = utf8_next_char (ptr_name1);
+        ptr_name2 = utf8_next_char (ptr_name2);
+    }
+
+    return (ptr_name1[0]) ? 1 : ((ptr_name2[0]) ? -1 : 0);
+}
+
+/*
+ * Adds a nick in hashtable of nicks of buffer.
+ *
+ * Nicks with same name (ignoring case) are chained with the pointer
+ * "next_same_name", the hashtable contains the first nick of the chain.
+ */
+
+void
+gui_nicklist_hashtable_add (struct t_gui_buffer *buffer,
+                            struct t_gui_nick *nick)
+{
+    struct t_gui_nick *ptr_nick;
+
+    nick->next_same_name = NULL;
+
+    if (!buffer->nicklist_nicks)
+    {
+        buffer->nicklist_nicks = hashtable_new (32,
+                                                WEECHAT_HASHTABLE_POINTER,
+                                                WEECHAT_HASHTABLE_POINTER,
+                                                &gui_nicklist_hash_nick_cb,
+                                                &gui_nicklist_keycmp_nick_cb);
+        if (!buffer->nicklist_nicks)
+            return;
+    }
+
+    ptr_nick = hashtable_get (buffer->nicklist_nicks, nick->name);
+    if (ptr_nick)
+    {
+        while (ptr_nick->next_same_name)
+        {
+            ptr_nick = ptr_nick->next_same_name;
+        }
+        ptr_nick->next_same_name = nick;
+    }
+    else
+    {
+        hashtable_set (buffer->nicklist_nicks, nick->name, nick);
+    }
+}
+
+/*
+ * Removes a nick from hashtable of nicks of buffer.
+ */
+
+void
+gui_nicklist_hashtable_remove (struct t_gui_buffer *buffer,
+                               struct t_gui_nick *nick)
+{
+    struct t_gui_nick *ptr_nick;
+
+    if (!buffer->nicklist_nicks)
+        return;
+
+    ptr_nick = hashtable_get (buffer->nicklist_nicks, nick->name);
+    if (!ptr_nick)
+        return;
+
+    if (ptr_nick == nick)
+    {
+        /* first nick of chain: the key is the name of nick, replace it */
+        hashtable_remove (buffer->nicklist_nicks, nick->name);
+        if (nick->next_same_name)
+        {
+            hashtable_set (buffer->nicklist_nicks,
+                           nick->next_same_name->name, nick->next_same_name);
+        }
+    }
+    else
+    {
+        while (ptr_nick->next_same_name
+               && (ptr_nick->next_same_name != nick))
+        {
+            ptr_nick = ptr_nick->next_same_name;
+        }
+        if (ptr_nick->next_same_name)
+            ptr_nick->next_same_name = nick->next_same_name;
+    }
+
+    nick->next_same_name = NULL;
+}
+
 /*
  * Searches for position of a nick (to keep nicklist sorted).
  */
@@ -311,10 +496,20 @@ gui_nicklist_find_pos_nick (struct t_gui_nick_group *group,
                             struct t_gui_nick *nick)
 {
     struct t_gui_nick *ptr_nick;
+    int index_insert;
 
     if (!group)
         return NULL;
 
+    if (group->nicks_sorted)
+    {
+        /* binary search in sorted nicks */
+        (void) arraylist_search (group->nicks_sorted, nick, NULL,
+                                 &index_insert);
+        return (index_insert >= 0) ?
+            arraylist_get (group->nicks_sorted, index_insert) : NULL;
+    }
+
     for (ptr_nick = group->nicks; ptr_nick; ptr_nick = ptr_nick->next_nick)
     {
         if (string_strcasecmp (nick->name, ptr_nick->name) < 0)
@@ -366,6 +561,231 @@ gui_nicklist_insert_nick_sorted (struct t_gui_nick_group *group,
         group->nicks = nick;
         group->last_nick = nick;
     }
+
+    if (group->nicks_sorted)
+        arraylist_add (group->nicks_sorted, nick);
+}
+
+/*
+ * Adds a nick at the end of group, without sorting (used when nicks are
+ * added in bulk mode, the group is sorted later by function
+ * gui_nicklist_sort).
+ */
+
+void
+gui_nicklist_append_nick (struct t_gui_nick_group *group,
+                          struct t_gui_nick *nick)
+{
+    nick->prev_nick = group->last_nick;
+    nick->next_nick = NULL;
+    if (group->last_nick)
+        group->last_nick->next_nick = nick;
+    else
+        group->nicks = nick;
+    group->last_nick = nick;
+}
+
+/*
+ * Removes a nick from arraylist of sorted nicks in group.
+ */
+
+void
+gui_nicklist_remove_nick_sorted (struct t_gui_nick_group *group,
+                                 struct t_gui_nick *nick)
+{
+    int index, size;
+
+    if (!group->nicks_sorted)
+        return;
+
+    /* index of first nick with the same name (ignoring case) */
+    (void) arraylist_search (group->nicks_sorted, nick, &index, NULL);
+    if (index < 0)
+        return;
+
+    size = arraylist_size (group->nicks_sorted);
+    while (index < size)
+    {
+        if (arraylist_get (group->nicks_sorted, index) == nick)
+        {
+            arraylist_remove (group->nicks_sorted, index);
+            return;
+        }
+        if (string_strcasecmp (
+                ((struct t_gui_nick *)arraylist_get (group->nicks_sorted,
+                                                     index))->name,
+                nick->name) != 0)
+            return;
+        index++;
+    }
+}
+
+/*
+ * Compares two nicks for qsort (sort of a group).
+ */
+
+int
+gui_nicklist_sort_cmp (const void *pointer1, const void *pointer2)
+{
+    const struct t_gui_nick *nick1, *nick2;
+    int rc;
+
+    nick1 = *((const struct t_gui_nick **)pointer1);
+    nick2 = *((const struct t_gui_nick **)pointer2);
+
+    rc = string_strcasecmp (nick1->name, nick2->name);
+
+    return (rc != 0) ? rc : strcmp (nick1->name, nick2->name);
+}
+
+/*
+ * Sorts nicks of a group and its children (recursively).
+ */
+
+void
+gui_nicklist_sort_group (struct t_gui_nick_group *group)
+{
+    struct t_gui_nick_group *ptr_group;
+    struct t_gui_nick *ptr_nick, **nicks;
+    int count, i;
+
+    for (ptr_group = group->children; ptr_group;
+         ptr_group = ptr_group->next_group)
+    {
+        gui_nicklist_sort_group (ptr_group);
+    }
+
+    count = 0;
+    for (ptr_nick = group->nicks; ptr_nick; ptr_nick = ptr_nick->next_nick)
+    {
+        count++;
+    }
+    if (count == 0)
+        return;
+
+    nicks = malloc (count * sizeof (*nicks));
+    if (!nicks)
+        return;
+
+    i = 0;
+    for (ptr_nick = group->nicks; ptr_nick; ptr_nick = ptr_nick->next_nick)
+    {
+        nicks[i++] = ptr_nick;
+    }
+
+    qsort (nicks, count, sizeof (*nicks), &gui_nicklist_sort_cmp);
+
+    /* link nicks again in sorted order */
+    if (group->nicks_sorted)
+        arraylist_clear (group->nicks_sorted);
+    group->nicks = NULL;
+    group->last_nick = NULL;
+    for (i = 0; i < count; i++)
+    {
+        gui_nicklist_append_nick (group, nicks[i]);
+        /* quick add in arraylist: nick is added at the end */
+        if (group->nicks_sorted)
+            arraylist_add (group->nicks_sorted, nicks[i]);
+    }
+
+    free (nicks);
+}
+
+/*
+ * Sorts all nicks in nicklist (used after nicks have been added in bulk mode).
+ */
+
+void
+gui_nicklist_sort (struct t_gui_buffer *buffer)
+{
+    if (!buffer || !buffer->nicklist_root)
+        return;
+
+    gui_nicklist_sort_group (buffer->nicklist_root);
+
+    gui_nicklist_send_signal ("nicklist_group_changed", buffer,
+                              buffer->nicklist_root->name);
+}
+
+/*
+ * Checks if a nick is in a group or one of its children (recursively).
+ *
+ * Returns:
+ *   1: nick is in group (or a child group)
+ *   0: nick is not in group
+ */
+
+int
+gui_nicklist_nick_in_group (struct t_gui_nick *nick,
+                            struct t_gui_nick_group *group)
+{
+    struct t_gui_nick_group *ptr_group;
+
+    for (ptr_group = nick->group; ptr_group; ptr_group = ptr_group->parent)
+    {
+        if (ptr_group == group)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Compares a nick name with a name, using nickcmp callback of buffer (if set).
+ *
+ * Returns:
+ *   0: names are equal
+ *   other value: names are different
+ */
+
+int
+gui_nicklist_nickcmp (struct t_gui_buffer *buffer, const char *nick1,
+                      const char *nick2)
+{
+    if (buffer && buffer->nickcmp_callback)
+    {
+        return (buffer->nickcmp_callback) (buffer->nickcmp_callback_pointer,
+                                           buffer->nickcmp_callback_data,
+                                           buffer,
+                                           nick1,
+                                           nick2);
+    }
+
+    return strcmp (nick1, nick2);
+}
+
+/*
+ * Searches for a nick in a group and its children (recursively), without
+ * using the hashtable of nicks.
+ *
+ * Returns pointer to nick found, NULL if not found.
+ */
+
+struct t_gui_nick *
+gui_nicklist_search_nick_in_group (struct t_gui_buffer *buffer,
+                                   struct t_gui_nick_group *group,
+                                   const char *name)
+{
+    struct t_gui_nick *ptr_nick;
+    struct t_gui_nick_group *ptr_group;
+
+    for (ptr_nick = group->nicks; ptr_nick; ptr_nick = ptr_nick->next_nick)
+    {
+        if (gui_nicklist_nickcmp (buffer, ptr_nick->name, name) == 0)
+            return ptr_nick;
+    }
+
+    /* search nick in child groups */
+    for (ptr_group = group->children; ptr_group;
+         ptr_group = ptr_group->next_group)
+    {
+        ptr_nick = gui_nicklist_search_nick_in_group (buffer, ptr_group, name);
+        if (ptr_nick)
+            return ptr_nick;
+    }
+
+    /* nick not found */
+    return NULL;
 }
 
 /*
@@ -380,40 +800,36 @@ gui_nicklist_search_nick (struct t_gui_buffer *buffer,
                           const char *name)
 {
     struct t_gui_nick *ptr_nick;
-    struct t_gui_nick_group *ptr_group;
 
-    if (!buffer && !from_group)
+    if ((!buffer && !from_group) || !name)
         return NULL;
 
     if (!from_group && !buffer->nicklist_root)
         return NULL;
 
-    for (ptr_nick = (from_group) ? from_group->nicks : buffer->nicklist_root->nicks;
-         ptr_nick; ptr_nick = ptr_nick->next_nick)
+    if (!buffer || !buffer->nicklist_nicks)
     {
-        if (buffer->nickcmp_callback)
-        {
-            if ((buffer->nickcmp_callback) (buffer->nickcmp_callback_pointer,
-                                            buffer->nickcmp_callback_data,
-                                            buffer,
-                                            ptr_nick->name,
-                                            name) == 0)
-                return ptr_nick;
-        }
-        else
-        {
-            if (strcmp (ptr_nick->name, name) == 0)
-                return ptr_nick;
-        }
+        return gui_nicklist_search_nick_in_group (
+            buffer,
+            (from_group) ? from_group : buffer->nicklist_root,
+            name);
     }
 
-    /* search nick in child groups */
-    for (ptr_group = (from_group) ? from_group->children : buffer->nicklist_root->children;
-         ptr_group; ptr_group = ptr_group->next_group)
+    /*
+     * search in hashtable: all nicks with the same name ignoring case are
+     * chained, the nickcmp callback (if set) is used to compare names
+     * (it must not consider as equal two names which differ by other chars
+     * than upper/lower case)
+     */
+    for (ptr_nick = hashtable_get (buffer->nicklist_nicks, name); ptr_nick;
+         ptr_nick = ptr_nick->next_same_name)
     {
-        ptr_nick = gui_nicklist_search_nick (buffer, ptr_group, name);
-        if (ptr_nick)
+        if ((gui_nicklist_nickcmp (buffer, ptr_nick->name, name) == 0)
+            && (!from_group || gui_nicklist_nick_in_group (ptr_nick,
+                                                           from_group)))
+        {
             return ptr_nick;
+        }
     }
 
     /* nick not found */
@@ -448,8 +864,13 @@ gui_nicklist_add_nick (struct t_gui_buffer *buffer,
     new_nick->prefix = (prefix) ? (char *)string_shared_get (prefix) : NULL;
     new_nick->prefix_color = (prefix_color) ? (char *)string_shared_get (prefix_color) : NULL;
     new_nick->visible = visible;
+    new_nick->next_same_name = NULL;
 
-    gui_nicklist_insert_nick_sorted (new_nick->group, new_nick);
+    if (buffer->nicklist_bulk_add)
+        gui_nicklist_append_nick (new_nick->group, new_nick);
+    else
+        gui_nicklist_insert_nick_sorted (new_nick->group, new_nick);
+    gui_nicklist_hashtable_add (buffer, new_nick);
 
     buffer->nicklist_count++;
     buffer->nicklist_nicks_count++;
@@ -484,7 +905,9 @@ gui_nicklist_remove_nick (struct t_gui_buffer *buffer,
     gui_nicklist_send_signal ("nicklist_nick_removing", buffer, nick_removed);
     gui_nicklist_send_hsignal ("nicklist_nick_removing", buffer, NULL, nick);
 
-    /* remove nick from list */
+    /* remove nick from hashtable, sorted nicks and list */
+    gui_nicklist_hashtable_remove (buffer, nick);
+    gui_nicklist_remove_nick_sorted (nick->group, nick);
     if (nick->prev_nick)
         (nick->prev_nick)->next_nick = nick->next_nick;
     if (nick->next_nick)
@@ -579,6 +1002,8 @@ gui_nicklist_remove_group (struct t_gui_buffer *buffer,
         string_shared_free (group->name);
     if (group->color)
         string_shared_free (group->color);
+    if (group->nicks_sorted)
+        arraylist_free (group->nicks_sorted);
 
     if (group->visible)
     {
@@ -1283,6 +1708,10 @@ gui_nicklist_print_log (struct t_gui_nick_group *group, int indent)
               "%%-%dslast_nick . : 0x%%lx",
               (indent * 2) + 6);
     log_printf (format, " ", group->last_nick);
+    snprintf (format, sizeof (format),
+              "%%-%dsnicks_sorted: 0x%%lx",
+              (indent * 2) + 6);
+    log_printf (format, " ", group->nicks_sorted);
     snprintf (format, sizeof (format),
               "%%-%dsprev_group. : 0x%%lx",
               (indent * 2) + 6);
@@ -1334,6 +1763,10 @@ gui_nicklist_print_log (struct t_gui_nick_group *group, int indent)
                   "%%-%dsvisible . . . . : %%d",
                   (indent * 2) + 6);
         log_printf (format, " ", ptr_nick->visible);
+        snprintf (format, sizeof (format),
+                  "%%-%dsnext_same_name. : 0x%%lx",
+                  (indent * 2) + 6);
+        log_printf (format, " ", ptr_nick->next_same_name);
         snprintf (format, sizeof (format),
                   "%%-%dsprev_nick . . . : 0x%%lx",
                   (indent * 2) + 6);
@@ -22,6 +22,8 @@
 
 struct t_gui_buffer;
 struct t_infolist;
+struct t_arraylist;
+struct t_hashtable;
 
 struct t_gui_nick_group
 {
@@ -34,6 +36,8 @@ struct t_gui_nick_group
     struct t_gui_nick_group *last_child; /* last child                      */
     struct t_gui_nick *nicks;          /* nicks for group                   */
     struct t_gui_nick *last_nick;      /* last nick for group               */
+    struct t_arraylist *nicks_sorted;  /* nicks sorted by name (to find     */
+                                       /* position of new nicks quickly)    */
     struct t_gui_nick_group *prev_group; /* link to previous group          */
     struct t_gui_nick_group *next_group; /* link to next group              */
 };
@@ -46,6 +50,8 @@ struct t_gui_nick
     char *prefix;                      /* prefix for nick (for admins, ..)  */
     char *prefix_color;                /* color for prefix                  */
     int visible;                       /* 1 if nick is displayed            */
+    struct t_gui_nick *next_same_name; /* next nick with same name ignoring */
+                                       /* case (in hashtable of nicks)      */
     struct t_gui_nick *prev_nick;      /* link to previous nick             */
     struct t_gui_nick *next_nick;      /* link to next nick                 */
 };
@@ -75,6 +81,7 @@ extern void gui_nicklist_remove_group (struct t_gui_buffer *buffer,
 extern void gui_nicklist_remove_nick (struct t_gui_buffer *buffer,
                                       struct t_gui_nick *nick);
 extern void gui_nicklist_remove_all (struct t_gui_buffer *buffer);
+extern void gui_nicklist_sort (struct t_gui_buffer *buffer);
 extern void gui_nicklist_get_next_item (struct t_gui_buffer *buffer,
                                         struct t_gui_nick_group **group,
                                         struct t_gui_nick **nick);
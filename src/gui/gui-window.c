@@ -32,6 +32,7 @@
 #include <signal.h>
 #include <time.h>
 #include <ctype.h>
+#include <sys/time.h>
 
 #include "../core/weechat.h"
 #include "../core/wee-config.h"
@@ -41,6 +42,7 @@
 #include "../core/wee-log.h"
 #include "../core/wee-string.h"
 #include "../core/wee-utf8.h"
+#include "../core/wee-util.h"
 #include "../plugins/plugin.h"
 #include "gui-window.h"
 #include "gui-bar.h"
@@ -70,6 +72,8 @@ int gui_window_cursor_y = 0;           /* cursor pos on screen              */
 int gui_window_bare_display = 0;       /* 1 for bare disp. (disable ncurses)*/
 struct t_hook *gui_window_bare_display_timer = NULL;
                                        /* timer for bare display            */
+struct t_hook *gui_window_search_timer = NULL;
+                                       /* timer for search in progress      */
 
 
 /*
@@ -407,6 +411,7 @@ gui_window_scroll_init (struct t_gui_window_scroll *window_scroll,
     window_scroll->start_col = 0;
     window_scroll->lines_after = 0;
     window_scroll->text_search_start_line = NULL;
+    window_scroll->text_search_next_line = NULL;
     window_scroll->prev_scroll = NULL;
     window_scroll->next_scroll = NULL;
 }
@@ -499,6 +504,9 @@ gui_window_scroll_switch (struct t_gui_window *window,
     if (ptr_scroll && (ptr_scroll == window->scroll))
         return;
 
+    /* stop search in progress in current scroll */
+    window->scroll->text_search_next_line = NULL;
+
     if (ptr_scroll)
     {
         /* scroll found, move it in first position */
@@ -1555,68 +1563,171 @@ gui_window_scroll_unread (struct t_gui_window *window)
 }
 
 /*
- * Searches for text in a buffer.
+ * Searches for text in lines of a buffer, starting with a given line, in the
+ * direction of search (backward or forward).
+ *
+ * The search is stopped after GUI_WINDOW_SEARCH_TIME_SLICE milliseconds
+ * and then continued in a timer, so that a search in a buffer with many
+ * lines does not block WeeChat.
  *
  * Returns:
  *   1: line has been found with text
  *   0: no line found with text
+ *  -1: search is not finished (it continues in a timer)
  */
 
 int
-gui_window_search_text (struct t_gui_window *window)
+gui_window_search_text_lines (struct t_gui_window *window,
+                              struct t_gui_line *line)
 {
-    struct t_gui_line *ptr_line;
+    struct timeval tv_start, tv_now;
+    int backward, count;
 
-    if (!window)
-        return 0;
+    window->scroll->text_search_next_line = NULL;
 
-    if (window->buffer->text_search == GUI_TEXT_SEARCH_BACKWARD)
+    backward = (window->buffer->text_search == GUI_TEXT_SEARCH_BACKWARD);
+
+    gettimeofday (&tv_start, NULL);
+    count = 0;
+
+    while (line)
     {
-        if (window->buffer->lines->first_line
-            && window->buffer->input_buffer && window->buffer->input_buffer[0])
+        if (gui_line_search_text (window->buffer, line))
         {
-            ptr_line = (window->scroll->start_line) ?
-                gui_line_get_prev_displayed (window->scroll->start_line) :
-                gui_line_get_last_displayed (window->buffer);
-            while (ptr_line)
+            window->scroll->start_line = line;
+            window->scroll->start_line_pos = 0;
+            window->scroll->first_line_displayed = (backward) ?
+                (line == gui_line_get_first_displayed (window->buffer)) :
+                (line == window->buffer->lines->first_line);
+            gui_buffer_ask_chat_refresh (window->buffer, 2);
+            return 1;
+        }
+        line = (backward) ?
+            gui_line_get_prev_displayed (line) :
+            gui_line_get_next_displayed (line);
+        count++;
+        if (line && (count % GUI_WINDOW_SEARCH_LINES_TIME == 0))
+        {
+            gettimeofday (&tv_now, NULL);
+            if (util_timeval_diff (&tv_start, &tv_now) >=
+                GUI_WINDOW_SEARCH_TIME_SLICE * 1000)
             {
-                if (gui_line_search_text (window->buffer, ptr_line))
+                window->scroll->text_search_next_line = line;
+                if (!gui_window_search_timer)
                 {
-                    window->scroll->start_line = ptr_line;
-                    window->scroll->start_line_pos = 0;
-                    window->scroll->first_line_displayed =
-                        (window->scroll->start_line == gui_line_get_first_displayed (window->buffer));
-                    gui_buffer_ask_chat_refresh (window->buffer, 2);
-                    return 1;
+                    gui_window_search_timer = hook_timer (
+                        NULL, 1, 0, 1,
+                        &gui_window_search_timer_cb, NULL, NULL);
                 }
-                ptr_line = gui_line_get_prev_displayed (ptr_line);
+                return -1;
             }
         }
     }
+
+    return 0;
+}
+
+/*
+ * Searches for text in a buffer.
+ *
+ * Returns:
+ *   1: line has been found with text
+ *   0: no line found with text
+ *  -1: search is not finished (it continues in a timer)
+ */
+
+int
+gui_window_search_text (struct t_gui_window *window)
+{
+    struct t_gui_line *ptr_line;
+
+    if (!window)
+        return 0;
+
+    window->scroll->text_search_next_line = NULL;
+
+    if (!window->buffer->lines->first_line
+        || !window->buffer->input_buffer || !window->buffer->input_buffer[0])
+    {
+        return 0;
+    }
+
+    if (window->buffer->text_search == GUI_TEXT_SEARCH_BACKWARD)
+    {
+        ptr_line = (window->scroll->start_line) ?
+            gui_line_get_prev_displayed (window->scroll->start_line) :
+            gui_line_get_last_displayed (window->buffer);
+        return gui_window_search_text_lines (window, ptr_line);
+    }
     else if (window->buffer->text_search == GUI_TEXT_SEARCH_FORWARD)
     {
-        if (window->buffer->lines->first_line
-            && window->buffer->input_buffer && window->buffer->input_buffer[0])
+        ptr_line = (window->scroll->start_line) ?
+            gui_line_get_next_displayed (window->scroll->start_line) :
+            gui_line_get_first_displayed (window->buffer);
+        return gui_window_search_text_lines (window, ptr_line);
+    }
+
+    return 0;
+}
+
+/*
+ * Displays that text was not found (alert if option
+ * weechat.look.search_text_not_found_alert is on).
+ */
+
+void
+gui_window_search_text_not_found (struct t_gui_window *window)
+{
+    if (CONFIG_BOOLEAN(config_look_search_text_not_found_alert)
+        && window->buffer->input_buffer && window->buffer->input_buffer[0])
+    {
+        fprintf (stderr, "\a");
+        fflush (stderr);
+    }
+    gui_buffer_ask_chat_refresh (window->buffer, 2);
+}
+
+/*
+ * Callback for timer of search: continues the searches in progress.
+ */
+
+int
+gui_window_search_timer_cb (const void *pointer, void *data,
+                            int remaining_calls)
+{
+    struct t_gui_window *ptr_win;
+    int rc;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+
+    if (remaining_calls == 0)
+        gui_window_search_timer = NULL;
+
+    for (ptr_win = gui_windows; ptr_win; ptr_win = ptr_win->next_window)
+    {
+        if (!ptr_win->scroll->text_search_next_line)
+            continue;
+        if (ptr_win->buffer->text_search == GUI_TEXT_SEARCH_DISABLED)
         {
-            ptr_line = (window->scroll->start_line) ?
-                gui_line_get_next_displayed (window->scroll->start_line) :
-                gui_line_get_first_displayed (window->buffer);
-            while (ptr_line)
-            {
-                if (gui_line_search_text (window->buffer, ptr_line))
-                {
-                    window->scroll->start_line = ptr_line;
-                    window->scroll->start_line_pos = 0;
-                    window->scroll->first_line_displayed =
-                        (window->scroll->start_line == window->buffer->lines->first_line);
-                    gui_buffer_ask_chat_refresh (window->buffer, 2);
-                    return 1;
-                }
-                ptr_line = gui_line_get_next_displayed (ptr_line);
-            }
+            ptr_win->scroll->text_search_next_line = NULL;
+            continue;
+        }
+        rc = gui_window_search_text_lines (
+            ptr_win, ptr_win->scroll->text_search_next_line);
+        if (rc == 1)
+        {
+            ptr_win->buffer->text_search_found = 1;
+            gui_input_search_signal (ptr_win->buffer);
+        }
+        else if ((rc == 0) && !ptr_win->buffer->text_search_found)
+        {
+            gui_window_search_text_not_found (ptr_win);
         }
     }
-    return 0;
+
+    return WEECHAT_RC_OK;
 }
 
 /*
@@ -1694,17 +1805,17 @@ gui_window_search_restart (struct t_gui_window *window)
         GUI_TEXT_SEARCH_BACKWARD : GUI_TEXT_SEARCH_FORWARD;
     window->buffer->text_search_found = 0;
     gui_input_search_compile_regex (window->buffer);
-    if (gui_window_search_text (window))
-        window->buffer->text_search_found = 1;
-    else
-    {
-        if (CONFIG_BOOLEAN(config_look_search_text_not_found_alert)
-            && window->buffer->input_buffer && window->buffer->input_buffer[0])
-        {
-            fprintf (stderr, "\a");
-            fflush (stderr);
-        }
-        gui_buffer_ask_chat_refresh (window->buffer, 2);
+    switch (gui_window_search_text (window))
+    {
+        case 1:
+            window->buffer->text_search_found = 1;
+            break;
+        case 0:
+            gui_window_search_text_not_found (window);
+            break;
+        default:
+            /* search is continued in a timer */
+            break;
     }
 }
 
@@ -1720,6 +1831,7 @@ gui_window_search_end (struct t_gui_window *window)
 
     window->buffer->text_search = GUI_TEXT_SEARCH_DISABLED;
     window->buffer->text_search = 0;
+    window->scroll->text_search_next_line = NULL;
     if (window->buffer->text_search_regex_compiled)
     {
         regfree (window->buffer->text_search_regex_compiled);
@@ -1892,6 +2004,7 @@ gui_window_hdata_window_scroll_cb (const void *pointer, void *data,
         HDATA_VAR(struct t_gui_window_scroll, start_col, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_window_scroll, lines_after, INTEGER, 0, NULL, NULL);
         HDATA_VAR(struct t_gui_window_scroll, text_search_start_line, POINTER, 0, NULL, "line");
+        HDATA_VAR(struct t_gui_window_scroll, text_search_next_line, POINTER, 0, NULL, "line");
         HDATA_VAR(struct t_gui_window_scroll, prev_scroll, POINTER, 0, NULL, hdata_name);
         HDATA_VAR(struct t_gui_window_scroll, next_scroll, POINTER, 0, NULL, hdata_name);
     }
@@ -2046,6 +2159,7 @@ gui_window_print_log ()
             log_printf ("    start_col . . . . . . : %d",    ptr_scroll->start_col);
             log_printf ("    lines_after . . . . . : %d",    ptr_scroll->lines_after);
             log_printf ("    text_search_start_line: 0x%lx", ptr_scroll->text_search_start_line);
+            log_printf ("    text_search_next_line : 0x%lx", ptr_scroll->text_search_next_line);
             log_printf ("    prev_scroll . . . . . : 0x%lx", ptr_scroll->prev_scroll);
             log_printf ("    next_scroll . . . . . : 0x%lx", ptr_scroll->next_scroll);
         }
@@ -24,6 +24,11 @@ struct t_infolist;
 struct t_gui_bar_window;
 struct t_gui_line_data;
 
+/* text search: time slice for a search in lines (in milliseconds) */
+
+#define GUI_WINDOW_SEARCH_TIME_SLICE     20
+#define GUI_WINDOW_SEARCH_LINES_TIME     1024
+
 /* window structures */
 
 struct t_gui_window_coords
@@ -97,6 +102,8 @@ struct t_gui_window_scroll
     int lines_after;                   /* number of lines after last line   */
                                        /* displayed (with scrolling)        */
     struct t_gui_line *text_search_start_line; /* starting line for search  */
+    struct t_gui_line *text_search_next_line;  /* next line to search (if   */
+                                       /* search is in progress in a timer) */
 
     struct t_gui_window_scroll *prev_scroll; /* link to prev. buf. scrolled */
     struct t_gui_window_scroll *next_scroll; /* link to next buf. scrolled  */
@@ -128,6 +135,7 @@ extern int gui_window_cursor_x;
 extern int gui_window_cursor_y;
 extern int gui_window_bare_display;
 extern struct t_hook *gui_window_bare_display_timer;
+extern struct t_hook *gui_window_search_timer;
 
 /* window functions */
 
@@ -190,7 +198,12 @@ extern void gui_window_search_start (struct t_gui_window *window,
 extern void gui_window_search_restart (struct t_gui_window *window);
 extern void gui_window_search_stop_here (struct t_gui_window *window);
 extern void gui_window_search_stop (struct t_gui_window *window);
+extern int gui_window_search_text_lines (struct t_gui_window *window,
+                                         struct t_gui_line *line);
 extern int gui_window_search_text (struct t_gui_window *window);
+extern void gui_window_search_text_not_found (struct t_gui_window *window);
+extern int gui_window_search_timer_cb (const void *pointer, void *data,
+                                       int remaining_calls);
 extern void gui_window_zoom (struct t_gui_window *window);
 extern struct t_hdata *gui_window_hdata_window_cb (const void *pointer,
                                                    void *data,
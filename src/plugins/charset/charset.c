@@ -41,6 +41,8 @@ WEECHAT_PLUGIN_PRIORITY(15000);
 
 #define CHARSET_CONFIG_NAME "charset"
 
+#define CHARSET_CACHE_MAX_NAMES 1024
+
 struct t_weechat_plugin *weechat_charset_plugin = NULL;
 #define weechat_plugin weechat_charset_plugin
 
@@ -53,6 +55,38 @@ struct t_config_section *charset_config_section_encode = NULL;
 const char *charset_terminal = NULL;
 const char *charset_internal = NULL;
 
+struct t_hashtable *charset_cache_decode = NULL; /* decode charset by name  */
+struct t_hashtable *charset_cache_encode = NULL; /* encode charset by name  */
+
+
+/*
+ * Clears cache of charsets (called when a charset is added/changed/removed).
+ */
+
+void
+charset_cache_clear ()
+{
+    if (charset_cache_decode)
+        weechat_hashtable_remove_all (charset_cache_decode);
+    if (charset_cache_encode)
+        weechat_hashtable_remove_all (charset_cache_encode);
+}
+
+/*
+ * Callback for changes on a charset option.
+ */
+
+void
+charset_config_change_cb (const void *pointer, void *data,
+                          struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) option;
+
+    charset_cache_clear ();
+}
 
 /*
  * Reloads charset configuration file.
@@ -70,6 +104,8 @@ charset_config_reload (const void *pointer, void *data,
     weechat_config_section_free_options (charset_config_section_decode);
     weechat_config_section_free_options (charset_config_section_encode);
 
+    charset_cache_clear ();
+
     return weechat_config_reload (config_file);
 }
 
@@ -121,6 +157,29 @@ charset_check_charset_decode_cb (const void *pointer, void *data,
     return charset_decode_is_allowed (value);
 }
 
+/*
+ * Callback called when an option is deleted in section "decode" or "encode".
+ */
+
+int
+charset_config_delete_option (const void *pointer, void *data,
+                              struct t_config_file *config_file,
+                              struct t_config_section *section,
+                              struct t_config_option *option)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) config_file;
+    (void) section;
+
+    weechat_config_option_free (option);
+
+    charset_cache_clear ();
+
+    return WEECHAT_CONFIG_OPTION_UNSET_OK_REMOVED;
+}
+
 /*
  * Sets a charset.
  */
@@ -166,7 +225,7 @@ charset_config_create_option (const void *pointer, void *data,
                         option_name, "string", NULL,
                         NULL, 0, 0, "", value, 0,
                         (section == charset_config_section_decode) ? &charset_check_charset_decode_cb : NULL, NULL, NULL,
-                        NULL, NULL, NULL,
+                        &charset_config_change_cb, NULL, NULL,
                         NULL, NULL, NULL);
                     rc = (ptr_option) ?
                         WEECHAT_CONFIG_OPTION_SET_OK_SAME_VALUE : WEECHAT_CONFIG_OPTION_SET_ERROR;
@@ -177,6 +236,8 @@ charset_config_create_option (const void *pointer, void *data,
         }
     }
 
+    charset_cache_clear ();
+
     if (rc == WEECHAT_CONFIG_OPTION_SET_ERROR)
     {
         weechat_printf (NULL,
@@ -231,7 +292,7 @@ charset_config_init ()
                                  charset_internal) != 0)) ?
         charset_terminal : "iso-8859-1", NULL, 0,
         &charset_check_charset_decode_cb, NULL, NULL,
-        NULL, NULL, NULL,
+        &charset_config_change_cb, NULL, NULL,
         NULL, NULL, NULL);
     charset_default_encode = weechat_config_new_option (
         charset_config_file, ptr_section,
@@ -240,7 +301,9 @@ charset_config_init ()
            "(if empty, default is UTF-8 because it is the WeeChat internal "
            "charset)"),
         NULL, 0, 0, "", NULL, 0,
-        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        NULL, NULL, NULL,
+        &charset_config_change_cb, NULL, NULL,
+        NULL, NULL, NULL);
 
     ptr_section = weechat_config_new_section (
         charset_config_file, "decode",
@@ -249,7 +312,7 @@ charset_config_init ()
         NULL, NULL, NULL,
         NULL, NULL, NULL,
         &charset_config_create_option, NULL, NULL,
-        NULL, NULL, NULL);
+        &charset_config_delete_option, NULL, NULL);
     if (!ptr_section)
     {
         weechat_config_free (charset_config_file);
@@ -266,7 +329,7 @@ charset_config_init ()
         NULL, NULL, NULL,
         NULL, NULL, NULL,
         &charset_config_create_option, NULL, NULL,
-        NULL, NULL, NULL);
+        &charset_config_delete_option, NULL, NULL);
     if (!ptr_section)
     {
         weechat_config_free (charset_config_file);
@@ -324,15 +387,15 @@ charset_check (const char *charset)
 }
 
 /*
- * Reads a charset in configuration file.
+ * Searches a charset in configuration file.
  *
  * First tries with all arguments, then removes one by one to find charset (from
  * specific to general charset).
  */
 
 const char *
-charset_get (struct t_config_section *section, const char *name,
-             struct t_config_option *default_charset)
+charset_search (struct t_config_section *section, const char *name,
+                struct t_config_option *default_charset)
 {
     char *option_name, *ptr_end;
     struct t_config_option *ptr_option;
@@ -378,6 +441,37 @@ charset_get (struct t_config_section *section, const char *name,
     return NULL;
 }
 
+/*
+ * Gets a charset for a name (for example "irc.freenode.#weechat").
+ *
+ * The charset found for a name is kept in cache (the cache is cleared when a
+ * charset is added, changed or removed), so that option names are built
+ * only one time for a name.
+ */
+
+const char *
+charset_get (struct t_hashtable *cache, struct t_config_section *section,
+             const char *name, struct t_config_option *default_charset)
+{
+    const char *charset;
+
+    if (!cache || !name)
+        return charset_search (section, name, default_charset);
+
+    charset = weechat_hashtable_get (cache, name);
+    if (charset)
+        return (charset[0]) ? charset : NULL;
+
+    /* not too many names in cache */
+    if (weechat_hashtable_get_integer (cache, "items_count") >= CHARSET_CACHE_MAX_NAMES)
+        weechat_hashtable_remove_all (cache);
+
+    charset = charset_search (section, name, default_charset);
+    weechat_hashtable_set (cache, name, (charset) ? charset : "");
+
+    return charset;
+}
+
 /*
  * Decodes a string with a charset to internal charset (UTF-8).
  */
@@ -394,7 +488,8 @@ charset_decode_cb (const void *pointer, void *data,
     (void) data;
     (void) modifier;
 
-    charset = charset_get (charset_config_section_decode, modifier_data,
+    charset = charset_get (charset_cache_decode,
+                           charset_config_section_decode, modifier_data,
                            charset_default_decode);
     if (weechat_charset_plugin->debug)
     {
@@ -425,7 +520,8 @@ charset_encode_cb (const void *pointer, void *data,
     (void) data;
     (void) modifier;
 
-    charset = charset_get (charset_config_section_encode, modifier_data,
+    charset = charset_get (charset_cache_encode,
+                           charset_config_section_encode, modifier_data,
                            charset_default_encode);
     if (weechat_charset_plugin->debug)
     {
@@ -602,6 +698,15 @@ weechat_plugin_init (struct t_weechat_plugin *plugin, int argc, char *argv[])
     if (weechat_charset_plugin->debug >= 1)
         charset_display_charsets ();
 
+    charset_cache_decode = weechat_hashtable_new (32,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  NULL, NULL);
+    charset_cache_encode = weechat_hashtable_new (32,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  WEECHAT_HASHTABLE_STRING,
+                                                  NULL, NULL);
+
     if (!charset_config_init ())
         return WEECHAT_RC_ERROR;
 
@@ -641,5 +746,16 @@ weechat_plugin_end (struct t_weechat_plugin *plugin)
 
     weechat_config_free (charset_config_file);
 
+    if (charset_cache_decode)
+    {
+        weechat_hashtable_free (charset_cache_decode);
+        charset_cache_decode = NULL;
+    }
+    if (charset_cache_encode)
+    {
+        weechat_hashtable_free (charset_cache_encode);
+        charset_cache_encode = NULL;
+    }
+
     return WEECHAT_RC_OK;
 }
@@ -28,76 +28,51 @@
 #include "irc.h"
 #include "irc-channel.h"
 #include "irc-config.h"
+#include "irc-message.h"
 #include "irc-server.h"
 
 
 /*
- * Parses an IRC message and returns:
- *   - tags (string)
- *   - message without tags (string)
- *   - nick (string)
- *   - host (string)
- *   - command (string)
- *   - channel (string)
- *   - arguments (string)
- *   - text (string)
- *   - pos_command (integer: command index in message)
- *   - pos_arguments (integer: arguments index in message)
- *   - pos_channel (integer: channel index in message)
- *   - pos_text (integer: text index in message)
+ * Parses an IRC message and returns positions of fields in message (without
+ * any allocation).
+ *
+ * Fields not found have position -1. Lengths are not set for arguments and
+ * text, which go until the end of message.
  *
  * Example:
  *   @time=2015-06-27T16:40:35.000Z :nick!user@host PRIVMSG #weechat :hello!
  *
- * Result:
- *               tags: "time=2015-06-27T16:40:35.000Z"
- *   msg_without_tags: ":nick!user@host PRIVMSG #weechat :hello!"
- *               nick: "nick"
- *               host: "nick!user@host"
- *            command: "PRIVMSG"
- *            channel: "#weechat"
- *          arguments: "#weechat :hello!"
- *               text: "hello!"
- *        pos_command: 47
- *      pos_arguments: 55
- *        pos_channel: 55
- *           pos_text: 65
+ * Result (position, length):
+ *                 tags: 1, 29       "time=2015-06-27T16:40:35.000Z"
+ *     msg_without_tags: 31          ":nick!user@host PRIVMSG #weechat :hello!"
+ *                 nick: 32, 4       "nick"
+ *                 host: 32, 14      "nick!user@host"
+ *              command: 47, 7       "PRIVMSG"
+ *              channel: 55, 8       "#weechat"
+ *            arguments: 55          "#weechat :hello!"
+ *                 text: 65          "hello!"
  */
 
 void
-irc_message_parse (struct t_irc_server *server, const char *message,
-                   char **tags, char **message_without_tags, char **nick,
-                   char **host, char **command, char **channel,
-                   char **arguments, char **text,
-                   int *pos_command, int *pos_arguments, int *pos_channel,
-                   int *pos_text)
+irc_message_parse_positions (struct t_irc_server *server, const char *message,
+                             struct t_irc_message_parsed *parsed)
 {
     const char *ptr_message, *pos, *pos2, *pos3, *pos4;
 
-    if (tags)
-        *tags = NULL;
-    if (message_without_tags)
-        *message_without_tags = NULL;
-    if (nick)
-        *nick = NULL;
-    if (host)
-        *host = NULL;
-    if (command)
-        *command = NULL;
-    if (channel)
-        *channel = NULL;
-    if (arguments)
-        *arguments = NULL;
-    if (text)
-        *text = NULL;
-    if (pos_command)
-        *pos_command = -1;
-    if (pos_arguments)
-        *pos_arguments = -1;
-    if (pos_channel)
-        *pos_channel = -1;
-    if (pos_text)
-        *pos_text = -1;
+    parsed->message = message;
+    parsed->pos_tags = -1;
+    parsed->length_tags = 0;
+    parsed->pos_message_without_tags = -1;
+    parsed->pos_nick = -1;
+    parsed->length_nick = 0;
+    parsed->pos_host = -1;
+    parsed->length_host = 0;
+    parsed->pos_command = -1;
+    parsed->length_command = 0;
+    parsed->pos_channel = -1;
+    parsed->length_channel = 0;
+    parsed->pos_arguments = -1;
+    parsed->pos_text = -1;
 
     if (!message)
         return;
@@ -120,11 +95,8 @@ irc_message_parse (struct t_irc_server *server, const char *message,
         pos = strchr (ptr_message, ' ');
         if (pos)
         {
-            if (tags)
-            {
-                *tags = weechat_strndup (ptr_message + 1,
-                                         pos - (ptr_message + 1));
-            }
+            parsed->pos_tags = 1;
+            parsed->length_tags = pos - (ptr_message + 1);
             ptr_message = pos + 1;
             while (ptr_message[0] == ' ')
             {
@@ -133,8 +105,7 @@ irc_message_parse (struct t_irc_server *server, const char *message,
         }
     }
 
-    if (message_without_tags)
-        *message_without_tags = strdup (ptr_message);
+    parsed->pos_message_without_tags = ptr_message - message;
 
     /* now we have: ptr_message --> ":nick!user@host PRIVMSG #weechat :hello!" */
     if (ptr_message[0] == ':')
@@ -148,18 +119,18 @@ irc_message_parse (struct t_irc_server *server, const char *message,
             pos2 = pos3;
         if (pos2 && (!pos || pos > pos2))
         {
-            if (nick)
-                *nick = weechat_strndup (ptr_message + 1, pos2 - (ptr_message + 1));
+            parsed->pos_nick = ptr_message + 1 - message;
+            parsed->length_nick = pos2 - (ptr_message + 1);
         }
         else if (pos)
         {
-            if (nick)
-                *nick = weechat_strndup (ptr_message + 1, pos - (ptr_message + 1));
+            parsed->pos_nick = ptr_message + 1 - message;
+            parsed->length_nick = pos - (ptr_message + 1);
         }
+        parsed->pos_host = ptr_message + 1 - message;
         if (pos)
         {
-            if (host)
-                *host = weechat_strndup (ptr_message + 1, pos - (ptr_message + 1));
+            parsed->length_host = pos - (ptr_message + 1);
             ptr_message = pos + 1;
             while (ptr_message[0] == ' ')
             {
@@ -168,8 +139,7 @@ irc_message_parse (struct t_irc_server *server, const char *message,
         }
         else
         {
-            if (host)
-                *host = strdup (ptr_message + 1);
+            parsed->length_host = strlen (ptr_message + 1);
             ptr_message += strlen (ptr_message);
         }
     }
@@ -177,23 +147,18 @@ irc_message_parse (struct t_irc_server *server, const char *message,
     /* now we have: ptr_message --> "PRIVMSG #weechat :hello!" */
     if (ptr_message[0])
     {
+        parsed->pos_command = ptr_message - message;
         pos = strchr (ptr_message, ' ');
         if (pos)
         {
-            if (command)
-                *command = weechat_strndup (ptr_message, pos - ptr_message);
-            if (pos_command)
-                *pos_command = ptr_message - message;
+            parsed->length_command = pos - ptr_message;
             pos++;
             while (pos[0] == ' ')
             {
                 pos++;
             }
             /* now we have: pos --> "#weechat :hello!" */
-            if (arguments)
-                *arguments = strdup (pos);
-            if (pos_arguments)
-                *pos_arguments = pos - message;
+            parsed->pos_arguments = pos - message;
             if ((pos[0] == ':')
                 && ((strncmp (ptr_message, "JOIN ", 5) == 0)
                     || (strncmp (ptr_message, "PART ", 5) == 0)))
@@ -202,25 +167,16 @@ irc_message_parse (struct t_irc_server *server, const char *message,
             }
             if (pos[0] == ':')
             {
-                if (text)
-                    *text = strdup (pos + 1);
-                if (pos_text)
-                    *pos_text = pos - message + 1;
+                parsed->pos_text = pos - message + 1;
             }
             else
             {
                 if (irc_channel_is_channel (server, pos))
                 {
                     pos2 = strchr (pos, ' ');
-                    if (channel)
-                    {
-                        if (pos2)
-                            *channel = weechat_strndup (pos, pos2 - pos);
-                        else
-                            *channel = strdup (pos);
-                    }
-                    if (pos_channel)
-                        *pos_channel = pos - message;
+                    parsed->pos_channel = pos - message;
+                    parsed->length_channel = (pos2) ?
+                        pos2 - pos : (int)strlen (pos);
                     if (pos2)
                     {
                         while (pos2[0] == ' ')
@@ -229,21 +185,17 @@ irc_message_parse (struct t_irc_server *server, const char *message,
                         }
                         if (pos2[0] == ':')
                             pos2++;
-                        if (text)
-                            *text = strdup (pos2);
-                        if (pos_text)
-                            *pos_text = pos2 - message;
+                        parsed->pos_text = pos2 - message;
                     }
                 }
                 else
                 {
                     pos2 = strchr (pos, ' ');
-                    if (nick && !*nick)
+                    if (parsed->pos_nick < 0)
                     {
-                        if (pos2)
-                            *nick = weechat_strndup (pos, pos2 - pos);
-                        else
-                            *nick = strdup (pos);
+                        parsed->pos_nick = pos - message;
+                        parsed->length_nick = (pos2) ?
+                            pos2 - pos : (int)strlen (pos);
                     }
                     if (pos2)
                     {
@@ -256,15 +208,9 @@ irc_message_parse (struct t_irc_server *server, const char *message,
                         if (irc_channel_is_channel (server, pos2))
                         {
                             pos4 = strchr (pos2, ' ');
-                            if (channel)
-                            {
-                                if (pos4)
-                                    *channel = weechat_strndup (pos2, pos4 - pos2);
-                                else
-                                    *channel = strdup (pos2);
-                            }
-                            if (pos_channel)
-                                *pos_channel = pos2 - message;
+                            parsed->pos_channel = pos2 - message;
+                            parsed->length_channel = (pos4) ?
+                                pos4 - pos2 : (int)strlen (pos2);
                             if (pos4)
                             {
                                 while (pos4[0] == ' ')
@@ -273,18 +219,13 @@ irc_message_parse (struct t_irc_server *server, const char *message,
                                 }
                                 if (pos4[0] == ':')
                                     pos4++;
-                                if (text)
-                                    *text = strdup (pos4);
-                                if (pos_text)
-                                    *pos_text = pos4 - message;
+                                parsed->pos_text = pos4 - message;
                             }
                         }
                         else
                         {
-                            if (channel)
-                                *channel = weechat_strndup (pos, pos3 - pos);
-                            if (pos_channel)
-                                *pos_channel = pos - message;
+                            parsed->pos_channel = pos - message;
+                            parsed->length_channel = pos3 - pos;
                             pos4 = strchr (pos3, ' ');
                             if (pos4)
                             {
@@ -294,10 +235,7 @@ irc_message_parse (struct t_irc_server *server, const char *message,
                                 }
                                 if (pos4[0] == ':')
                                     pos4++;
-                                if (text)
-                                    *text = strdup (pos4);
-                                if (pos_text)
-                                    *pos_text = pos4 - message;
+                                parsed->pos_text = pos4 - message;
                             }
                         }
                     }
@@ -306,14 +244,142 @@ irc_message_parse (struct t_irc_server *server, const char *message,
         }
         else
         {
-            if (command)
-                *command = strdup (ptr_message);
-            if (pos_command)
-                *pos_command = ptr_message - message;
+            parsed->length_command = strlen (ptr_message);
         }
     }
 }
 
+/*
+ * Returns a field of a parsed IRC message (see function
+ * irc_message_parse_positions) as a string.
+ *
+ * If length is -1, the field goes until the end of message.
+ *
+ * If buffer is not NULL and if the field fits in, the field is copied in
+ * buffer, otherwise a new string is allocated.
+ *
+ * Returns NULL if the field was not found in message.
+ *
+ * Note: result must be freed after use (if different from buffer).
+ */
+
+char *
+irc_message_parsed_get (const struct t_irc_message_parsed *parsed,
+                        int pos, int length, char *buffer, int buffer_size)
+{
+    if (!parsed || !parsed->message || (pos < 0))
+        return NULL;
+
+    if (length < 0)
+        length = strlen (parsed->message + pos);
+
+    if (buffer && (length < buffer_size))
+    {
+        memcpy (buffer, parsed->message + pos, length);
+        buffer[length] = '\0';
+        return buffer;
+    }
+
+    return weechat_strndup (parsed->message + pos, length);
+}
+
+/*
+ * Parses an IRC message and returns:
+ *   - tags (string)
+ *   - message without tags (string)
+ *   - nick (string)
+ *   - host (string)
+ *   - command (string)
+ *   - channel (string)
+ *   - arguments (string)
+ *   - text (string)
+ *   - pos_command (integer: command index in message)
+ *   - pos_arguments (integer: arguments index in message)
+ *   - pos_channel (integer: channel index in message)
+ *   - pos_text (integer: text index in message)
+ *
+ * Example:
+ *   @time=2015-06-27T16:40:35.000Z :nick!user@host PRIVMSG #weechat :hello!
+ *
+ * Result:
+ *               tags: "time=2015-06-27T16:40:35.000Z"
+ *   msg_without_tags: ":nick!user@host PRIVMSG #weechat :hello!"
+ *               nick: "nick"
+ *               host: "nick!user@host"
+ *            command: "PRIVMSG"
+ *            channel: "#weechat"
+ *          arguments: "#weechat :hello!"
+ *               text: "hello!"
+ *        pos_command: 47
+ *      pos_arguments: 55
+ *        pos_channel: 55
+ *           pos_text: 65
+ */
+
+void
+irc_message_parse (struct t_irc_server *server, const char *message,
+                   char **tags, char **message_without_tags, char **nick,
+                   char **host, char **command, char **channel,
+                   char **arguments, char **text,
+                   int *pos_command, int *pos_arguments, int *pos_channel,
+                   int *pos_text)
+{
+    struct t_irc_message_parsed parsed;
+
+    irc_message_parse_positions (server, message, &parsed);
+
+    if (tags)
+    {
+        *tags = irc_message_parsed_get (&parsed,
+                                        parsed.pos_tags, parsed.length_tags,
+                                        NULL, 0);
+    }
+    if (message_without_tags)
+    {
+        *message_without_tags = irc_message_parsed_get (
+            &parsed, parsed.pos_message_without_tags, -1, NULL, 0);
+    }
+    if (nick)
+    {
+        *nick = irc_message_parsed_get (&parsed,
+                                        parsed.pos_nick, parsed.length_nick,
+                                        NULL, 0);
+    }
+    if (host)
+    {
+        *host = irc_message_parsed_get (&parsed,
+                                        parsed.pos_host, parsed.length_host,
+                                        NULL, 0);
+    }
+    if (command)
+    {
+        *command = irc_message_parsed_get (&parsed,
+                                           parsed.pos_command,
+                                           parsed.length_command,
+                                           NULL, 0);
+    }
+    if (channel)
+    {
+        *channel = irc_message_parsed_get (&parsed,
+                                           parsed.pos_channel,
+                                           parsed.length_channel,
+                                           NULL, 0);
+    }
+    if (arguments)
+        *arguments = irc_message_parsed_get (&parsed, parsed.pos_arguments,
+                                             -1, NULL, 0);
+    if (text)
+        *text = irc_message_parsed_get (&parsed, parsed.pos_text, -1, NULL, 0);
+    if (pos_command)
+        *pos_command = parsed.pos_command;
+    if (pos_arguments)
+        *pos_arguments = parsed.pos_arguments;
+    if (pos_channel)
+        *pos_channel = parsed.pos_channel;
+    if (pos_text)
+        *pos_text = parsed.pos_text;
+}
+
 /*
  * Parses an IRC message and returns hashtable with keys:
  *   - tags
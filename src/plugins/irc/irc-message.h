@@ -23,6 +23,35 @@
 struct t_irc_server;
 struct t_irc_channel;
 
+/*
+ * parsed IRC message: positions of fields in the message (the message is not
+ * copied), -1 if the field is not in message
+ */
+
+struct t_irc_message_parsed
+{
+    const char *message;               /* IRC message (not a copy)          */
+    int pos_tags;                      /* tags (after "@")                  */
+    int length_tags;                   /* length of tags                    */
+    int pos_message_without_tags;      /* message without tags              */
+    int pos_nick;                      /* nick                              */
+    int length_nick;                   /* length of nick                    */
+    int pos_host;                      /* host (nick!user@host)             */
+    int length_host;                   /* length of host                    */
+    int pos_command;                   /* command (PRIVMSG, JOIN, ...)      */
+    int length_command;                /* length of command                 */
+    int pos_channel;                   /* channel                           */
+    int length_channel;                /* length of channel                 */
+    int pos_arguments;                 /* arguments (until end of message)  */
+    int pos_text;                      /* text (until end of message)       */
+};
+
+extern void irc_message_parse_positions (struct t_irc_server *server,
+                                         const char *message,
+                                         struct t_irc_message_parsed *parsed);
+extern char *irc_message_parsed_get (const struct t_irc_message_parsed *parsed,
+                                     int pos, int length,
+                                     char *buffer, int buffer_size);
 extern void irc_message_parse (struct t_irc_server *server, const char *message,
                                char **tags, char **message_without_tags,
                                char **nick, char **host, char **command,
@@ -443,6 +443,191 @@ irc_nick_nicklist_set_color_all ()
     }
 }
 
+/*
+ * Hashes a nick (case insensitive): djb2 hash, with chars in range converted
+ * to lower case (see function irc_server_strcasecmp).
+ */
+
+unsigned long long
+irc_nick_hash_nick_range (const char *nickname, int range)
+{
+    unsigned long long hash;
+    unsigned char c;
+
+    /* variant of djb2 hash */
+    hash = 5381;
+    while ((c = (unsigned char)(nickname++)[0]))
+    {
+        if ((c >= 'A') && (c < 'A' + range))
+            c += ('a' - 'A');
+        hash = ((hash << 5) + hash) + c;
+    }
+
+    return hash;
+}
+
+/*
+ * Callbacks for hashtable of nicks in a channel (one hash/compare callback
+ * for each casemapping).
+ */
+
+unsigned long long
+irc_nick_hash_key_rfc1459_cb (struct t_hashtable *hashtable, const void *key)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return irc_nick_hash_nick_range ((const char *)key, 30);
+}
+
+int
+irc_nick_keycmp_rfc1459_cb (struct t_hashtable *hashtable,
+                            const void *key1, const void *key2)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return weechat_strcasecmp_range ((const char *)key1, (const char *)key2,
+                                     30);
+}
+
+unsigned long long
+irc_nick_hash_key_strict_rfc1459_cb (struct t_hashtable *hashtable,
+                                     const void *key)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return irc_nick_hash_nick_range ((const char *)key, 29);
+}
+
+int
+irc_nick_keycmp_strict_rfc1459_cb (struct t_hashtable *hashtable,
+                                   const void *key1, const void *key2)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return weechat_strcasecmp_range ((const char *)key1, (const char *)key2,
+                                     29);
+}
+
+unsigned long long
+irc_nick_hash_key_ascii_cb (struct t_hashtable *hashtable, const void *key)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return irc_nick_hash_nick_range ((const char *)key, 26);
+}
+
+int
+irc_nick_keycmp_ascii_cb (struct t_hashtable *hashtable,
+                          const void *key1, const void *key2)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+
+    return weechat_strcasecmp ((const char *)key1, (const char *)key2);
+}
+
+/*
+ * Creates the hashtable of nicks for a channel: keys are nick names (pointer
+ * to name in nick, compared according to server casemapping), values are
+ * pointers to nicks.
+ *
+ * Returns pointer to hashtable, NULL if error.
+ */
+
+struct t_hashtable *
+irc_nick_hashtable_new (struct t_irc_server *server)
+{
+    switch ((server) ? server->casemapping : IRC_SERVER_CASEMAPPING_RFC1459)
+    {
+        case IRC_SERVER_CASEMAPPING_STRICT_RFC1459:
+            return weechat_hashtable_new (
+                32,
+                WEECHAT_HASHTABLE_POINTER,
+                WEECHAT_HASHTABLE_POINTER,
+                &irc_nick_hash_key_strict_rfc1459_cb,
+                &irc_nick_keycmp_strict_rfc1459_cb);
+        case IRC_SERVER_CASEMAPPING_ASCII:
+            return weechat_hashtable_new (
+                32,
+                WEECHAT_HASHTABLE_POINTER,
+                WEECHAT_HASHTABLE_POINTER,
+                &irc_nick_hash_key_ascii_cb,
+                &irc_nick_keycmp_ascii_cb);
+        default:
+            break;
+    }
+    return weechat_hashtable_new (32,
+                                  WEECHAT_HASHTABLE_POINTER,
+                                  WEECHAT_HASHTABLE_POINTER,
+                                  &irc_nick_hash_key_rfc1459_cb,
+                                  &irc_nick_keycmp_rfc1459_cb);
+}
+
+/*
+ * Adds a nick in hashtable of nicks of channel.
+ */
+
+void
+irc_nick_hashtable_add (struct t_irc_server *server,
+                        struct t_irc_channel *channel,
+                        struct t_irc_nick *nick)
+{
+    if (!channel->nicks_hashtable)
+    {
+        channel->nicks_hashtable = irc_nick_hashtable_new (server);
+        if (!channel->nicks_hashtable)
+            return;
+    }
+
+    weechat_hashtable_set (channel->nicks_hashtable, nick->name, nick);
+}
+
+/*
+ * Removes a nick from hashtable of nicks of channel.
+ */
+
+void
+irc_nick_hashtable_remove (struct t_irc_channel *channel,
+                           struct t_irc_nick *nick)
+{
+    if (!channel->nicks_hashtable || !nick->name)
+        return;
+
+    if (weechat_hashtable_get (channel->nicks_hashtable, nick->name) == nick)
+        weechat_hashtable_remove (channel->nicks_hashtable, nick->name);
+}
+
+/*
+ * Rebuilds the hashtable of nicks of a channel (this must be called when the
+ * casemapping of server changes).
+ */
+
+void
+irc_nick_hashtable_rebuild (struct t_irc_server *server,
+                            struct t_irc_channel *channel)
+{
+    struct t_irc_nick *ptr_nick;
+
+    if (!channel)
+        return;
+
+    if (channel->nicks_hashtable)
+    {
+        weechat_hashtable_free (channel->nicks_hashtable);
+        channel->nicks_hashtable = NULL;
+    }
+
+    for (ptr_nick = channel->nicks; ptr_nick; ptr_nick = ptr_nick->next_nick)
+    {
+        irc_nick_hashtable_add (server, channel, ptr_nick);
+    }
+}
+
 /*
  * Adds a new nick in channel.
  *
@@ -530,6 +715,8 @@ irc_nick_new (struct t_irc_server *server, struct t_irc_channel *channel,
 
     channel->nicks_count++;
 
+    irc_nick_hashtable_add (server, channel, new_nick);
+
     channel->nick_completion_reset = 1;
 
     /* add nick to buffer nicklist */
@@ -558,9 +745,12 @@ irc_nick_change (struct t_irc_server *server, struct t_irc_channel *channel,
         irc_channel_nick_speaking_rename (channel, nick->name, new_nick);
 
     /* change nickname */
+    irc_nick_hashtable_remove (channel, nick);
     if (nick->name)
         free (nick->name);
     nick->name = strdup (new_nick);
+    if (nick->name)
+        irc_nick_hashtable_add (server, channel, nick);
     if (nick->color)
         free (nick->color);
     if (nick_is_me)
@@ -633,6 +823,8 @@ irc_nick_free (struct t_irc_server *server, struct t_irc_channel *channel,
 
     channel->nicks_count--;
 
+    irc_nick_hashtable_remove (channel, nick);
+
     /* free data */
     if (nick->name)
         free (nick->name);
@@ -665,6 +857,13 @@ irc_nick_free_all (struct t_irc_server *server, struct t_irc_channel *channel)
     if (!channel)
         return;
 
+    /* free hashtable first: no need to remove nicks one by one from it */
+    if (channel->nicks_hashtable)
+    {
+        weechat_hashtable_free (channel->nicks_hashtable);
+        channel->nicks_hashtable = NULL;
+    }
+
     /* remove all nicks for the channel */
     while (channel->nicks)
     {
@@ -693,6 +892,10 @@ irc_nick_search (struct t_irc_server *server, struct t_irc_channel *channel,
     if (!channel || !nickname)
         return NULL;
 
+    if (channel->nicks_hashtable)
+        return weechat_hashtable_get (channel->nicks_hashtable, nickname);
+
+    /* no hashtable (memory error?): search in list of nicks */
     for (ptr_nick = channel->nicks; ptr_nick;
          ptr_nick = ptr_nick->next_nick)
     {
@@ -59,6 +59,9 @@ extern const char *irc_nick_get_prefix_color_name (struct t_irc_server *server,
                                                    char prefix);
 extern void irc_nick_nicklist_set_prefix_color_all ();
 extern void irc_nick_nicklist_set_color_all ();
+extern struct t_hashtable *irc_nick_hashtable_new (struct t_irc_server *server);
+extern void irc_nick_hashtable_rebuild (struct t_irc_server *server,
+                                        struct t_irc_channel *channel);
 extern struct t_irc_nick *irc_nick_new (struct t_irc_server *server,
                                         struct t_irc_channel *channel,
                                         const char *nickname,
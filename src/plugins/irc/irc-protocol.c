@@ -2804,6 +2804,7 @@ IRC_PROTOCOL_CALLBACK(005)
     char *pos, *pos2, *pos_start, *error, *isupport2;
     int length_isupport, length, casemapping;
     long value;
+    struct t_irc_channel *ptr_channel;
 
     IRC_PROTOCOL_MIN_ARGS(4);
 
@@ -2849,8 +2850,15 @@ IRC_PROTOCOL_CALLBACK(005)
         if (pos2)
             pos2[0] = '\0';
         casemapping = irc_server_search_casemapping (pos);
-        if (casemapping >= 0)
+        if ((casemapping >= 0) && (casemapping != server->casemapping))
+        {
             server->casemapping = casemapping;
+            for (ptr_channel = server->channels; ptr_channel;
+                 ptr_channel = ptr_channel->next_channel)
+            {
+                irc_nick_hashtable_rebuild (server, ptr_channel);
+            }
+        }
         if (pos2)
             pos2[0] = ' ';
     }
@@ -4654,6 +4662,14 @@ IRC_PROTOCOL_CALLBACK(353)
         if (str_nicks)
             str_nicks[0] = '\0';
     }
+    else if (ptr_channel->nicks)
+    {
+        /*
+         * add nicks without sorting them in nicklist: nicklist will be
+         * sorted only once, on end of names (message 366)
+         */
+        weechat_buffer_set (ptr_channel->buffer, "nicklist_bulk_add", "1");
+    }
 
     for (i = args; i < argc; i++)
     {
@@ -4889,6 +4905,11 @@ IRC_PROTOCOL_CALLBACK(366)
     IRC_PROTOCOL_MIN_ARGS(5);
 
     ptr_channel = irc_channel_search (server, argv[3]);
+
+    /* end of names: sort nicks added by message 353 */
+    if (ptr_channel)
+        weechat_buffer_set (ptr_channel->buffer, "nicklist_bulk_add", "0");
+
     if (ptr_channel && ptr_channel->nicks)
     {
         /* display users on channel */
@@ -6110,23 +6131,24 @@ irc_protocol_get_message_tag_time (struct t_hashtable *tags)
 /*
  * Executes action when an IRC message is received.
  *
- * Argument "irc_message" is the full message without optional tags.
+ * Argument "parsed" is the full message (with optional tags), already parsed
+ * by function irc_message_parse_positions: tags, nick and host are read from
+ * positions in message (the message is not parsed again).
  */
 
 void
 irc_protocol_recv_command (struct t_irc_server *server,
-                           const char *irc_message,
+                           const struct t_irc_message_parsed *parsed,
                            const char *msg_command,
                            const char *msg_channel)
 {
     int i, cmd_found, return_code, argc, decode_color, keep_trailing_spaces;
     int message_ignored;
-    char *message_colors_decoded, *pos_space, *tags;
+    char *message_colors_decoded, *pos, *tags, str_tags[512];
     struct t_irc_channel *ptr_channel;
     t_irc_recv_func *cmd_recv_func;
-    const char *cmd_name, *ptr_msg_after_tags;
+    const char *irc_message, *cmd_name, *ptr_msg_after_tags;
     time_t date;
-    const char *nick1, *address1, *host1;
     char *nick, *address, *address_color, *host, *host_no_color, *host_color;
     char **argv, **argv_eol;
     struct t_hashtable *hash_tags;
@@ -6284,66 +6306,59 @@ irc_protocol_recv_command (struct t_irc_server *server,
           { NULL, 0, 0, NULL }
         };
 
-    if (!msg_command)
+    if (!parsed || !parsed->message || !msg_command)
         return;
 
+    irc_message = parsed->message;
+
     message_colors_decoded = NULL;
     argv = NULL;
     argv_eol = NULL;
     hash_tags = NULL;
     date = 0;
 
-    ptr_msg_after_tags = irc_message;
-
     /* get tags as hashtable */
-    if (irc_message && (irc_message[0] == '@'))
+    if (parsed->pos_tags >= 0)
     {
-        pos_space = strchr (irc_message, ' ');
-        if (pos_space)
+        tags = irc_message_parsed_get (parsed,
+                                       parsed->pos_tags, parsed->length_tags,
+                                       str_tags, sizeof (str_tags));
+        if (tags)
         {
-            tags = weechat_strndup (irc_message + 1,
-                                    pos_space - (irc_message + 1));
-            if (tags)
-            {
-                hash_tags = irc_protocol_get_message_tags (tags);
-                if (hash_tags)
-                    date = irc_protocol_get_message_tag_time (hash_tags);
+            hash_tags = irc_protocol_get_message_tags (tags);
+            if (hash_tags)
+                date = irc_protocol_get_message_tag_time (hash_tags);
+            if (tags != str_tags)
                 free (tags);
-            }
-            ptr_msg_after_tags = pos_space;
-            while (ptr_msg_after_tags[0] == ' ')
-            {
-                ptr_msg_after_tags++;
-            }
         }
-        else
-            ptr_msg_after_tags = NULL;
     }
 
+    /* message with only tags (no space after tags) is ignored */
+    ptr_msg_after_tags = ((irc_message[0] == '@') && (parsed->pos_tags < 0)) ?
+        NULL : irc_message + parsed->pos_message_without_tags;
+
     /* get nick/host/address from IRC message */
-    nick1 = NULL;
-    address1 = NULL;
-    host1 = NULL;
+    nick = NULL;
+    address = NULL;
+    host = NULL;
     if (ptr_msg_after_tags && (ptr_msg_after_tags[0] == ':'))
     {
-        nick1 = irc_message_get_nick_from_host (ptr_msg_after_tags);
-        address1 = irc_message_get_address_from_host (ptr_msg_after_tags);
-        host1 = ptr_msg_after_tags + 1;
+        host = irc_message_parsed_get (parsed,
+                                       parsed->pos_host, parsed->length_host,
+                                       NULL, 0);
+        if (host)
+        {
+            /* host is "nick!address" or just "nick" */
+            pos = strchr (host, '!');
+            nick = (pos) ? weechat_strndup (host, pos - host) : strdup (host);
+            address = strdup ((pos) ? pos + 1 : host);
+        }
     }
-    nick = (nick1) ? strdup (nick1) : NULL;
-    address = (address1) ? strdup (address1) : NULL;
     address_color = (address) ?
         irc_color_decode (
             address,
             weechat_config_boolean (irc_config_network_colors_receive)) :
         NULL;
-    host = (host1) ? strdup (host1) : NULL;
-    if (host)
-    {
-        pos_space = strchr (host, ' ');
-        if (pos_space)
-            pos_space[0] = '\0';
-    }
     host_no_color = (host) ? irc_color_decode (host, 0) : NULL;
     host_color = (host) ?
         irc_color_decode (
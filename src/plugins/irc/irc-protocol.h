@@ -67,6 +67,7 @@
     }
 
 struct t_irc_server;
+struct t_irc_message_parsed;
 
 typedef int (t_irc_recv_func)(struct t_irc_server *server,
                               time_t date, const char *nick,
@@ -86,7 +87,7 @@ struct t_irc_protocol_msg
 extern const char *irc_protocol_tags (const char *command, const char *tags,
                                       const char *nick, const char *address);
 extern void irc_protocol_recv_command (struct t_irc_server *server,
-                                       const char *irc_message,
+                                       const struct t_irc_message_parsed *parsed,
                                        const char *msg_command,
                                        const char *msg_channel);
 
@@ -2857,11 +2857,12 @@ void
 irc_server_msgq_flush ()
 {
     struct t_irc_message *next;
+    struct t_irc_message_parsed parsed;
     char *ptr_data, *new_msg, *new_msg2, *ptr_msg, *ptr_msg2, *pos;
-    char *nick, *host, *command, *channel, *arguments;
-    char *msg_decoded, *msg_decoded_without_color;
+    char *command, *channel, *msg_decoded, *msg_decoded_without_color;
     char str_modifier[128], modifier_data[256];
-    int pos_channel, pos_text, pos_decode;
+    char str_command[64], str_channel[256];
+    int pos_decode;
 
     while (irc_recv_msgq)
     {
@@ -2881,19 +2882,28 @@ irc_server_msgq_flush ()
                     irc_raw_print (irc_recv_msgq->server, IRC_RAW_FLAG_RECV,
                                    ptr_data);
 
-                    irc_message_parse (irc_recv_msgq->server,
-                                       ptr_data, NULL, NULL, NULL, NULL,
-                                       &command, NULL, NULL, NULL, NULL, NULL,
-                                       NULL, NULL);
-                    snprintf (str_modifier, sizeof (str_modifier),
-                              "irc_in_%s",
-                              (command) ? command : "unknown");
+                    /*
+                     * parse message only once: the result is reused below,
+                     * unless the message is changed by a modifier
+                     */
+                    irc_message_parse_positions (irc_recv_msgq->server,
+                                                 ptr_data, &parsed);
+                    if (parsed.pos_command >= 0)
+                    {
+                        snprintf (str_modifier, sizeof (str_modifier),
+                                  "irc_in_%.*s",
+                                  parsed.length_command,
+                                  ptr_data + parsed.pos_command);
+                    }
+                    else
+                    {
+                        snprintf (str_modifier, sizeof (str_modifier),
+                                  "irc_in_unknown");
+                    }
                     new_msg = weechat_hook_modifier_exec (
                         str_modifier,
                         irc_recv_msgq->server->name,
                         ptr_data);
-                    if (command)
-                        free (command);
 
                     /* no changes in new message */
                     if (new_msg && (strcmp (ptr_data, new_msg) == 0))
@@ -2922,17 +2932,30 @@ irc_server_msgq_flush ()
                                     ptr_msg);
                             }
 
-                            irc_message_parse (irc_recv_msgq->server, ptr_msg,
-                                               NULL, NULL, &nick, &host,
-                                               &command, &channel, &arguments,
-                                               NULL, NULL, NULL,
-                                               &pos_channel, &pos_text);
+                            /* message changed or split: parse it again */
+                            if (new_msg || pos || (ptr_msg != ptr_data))
+                            {
+                                irc_message_parse_positions (
+                                    irc_recv_msgq->server, ptr_msg, &parsed);
+                            }
+
+                            command = irc_message_parsed_get (
+                                &parsed,
+                                parsed.pos_command, parsed.length_command,
+                                str_command, sizeof (str_command));
+                            channel = irc_message_parsed_get (
+                                &parsed,
+                                parsed.pos_channel, parsed.length_channel,
+                                str_channel, sizeof (str_channel));
 
                             msg_decoded = NULL;
                             if (weechat_config_boolean (irc_config_network_channel_encode))
-                                pos_decode = (pos_channel >= 0) ? pos_channel : pos_text;
+                            {
+                                pos_decode = (parsed.pos_channel >= 0) ?
+                                    parsed.pos_channel : parsed.pos_text;
+                            }
                             else
-                                pos_decode = pos_text;
+                                pos_decode = parsed.pos_text;
                             if (pos_decode >= 0)
                             {
                                 /* convert charset for message */
@@ -2948,14 +2971,20 @@ irc_server_msgq_flush ()
                                 }
                                 else
                                 {
-                                    if (nick && (!host || (strcmp (nick, host) != 0)))
+                                    if ((parsed.pos_nick >= 0)
+                                        && ((parsed.pos_host < 0)
+                                            || (parsed.length_nick != parsed.length_host)
+                                            || (strncmp (ptr_msg + parsed.pos_nick,
+                                                         ptr_msg + parsed.pos_host,
+                                                         parsed.length_nick) != 0)))
                                     {
                                         snprintf (modifier_data,
                                                   sizeof (modifier_data),
-                                                  "%s.%s.%s",
+                                                  "%s.%s.%.*s",
                                                   weechat_plugin->name,
                                                   irc_recv_msgq->server->name,
-                                                  nick);
+                                                  parsed.length_nick,
+                                                  ptr_msg + parsed.pos_nick);
                                     }
                                     else
                                     {
@@ -3003,16 +3032,33 @@ irc_server_msgq_flush ()
                                 /* parse and execute command */
                                 if (irc_redirect_message (irc_recv_msgq->server,
                                                           ptr_msg2, command,
-                                                          arguments))
+                                                          (parsed.pos_arguments >= 0) ?
+                                                          ptr_msg + parsed.pos_arguments : NULL))
                                 {
                                     /* message redirected, we'll not display it! */
                                 }
                                 else
                                 {
-                                    /* message not redirected, display it */
+                                    /*
+                                     * message not redirected, display it
+                                     * (parse it again only if it was
+                                     * changed by charset, colors or
+                                     * modifier)
+                                     */
+                                    if ((ptr_msg2 != ptr_msg)
+                                        && (strcmp (ptr_msg2, ptr_msg) != 0))
+                                    {
+                                        irc_message_parse_positions (
+                                            irc_recv_msgq->server,
+                                            ptr_msg2, &parsed);
+                                    }
+                                    else
+                                    {
+                                        parsed.message = ptr_msg2;
+                                    }
                                     irc_protocol_recv_command (
                                         irc_recv_msgq->server,
-                                        ptr_msg2,
+                                        &parsed,
                                         command,
                                         channel);
                                 }
@@ -3020,16 +3066,10 @@ irc_server_msgq_flush ()
 
                             if (new_msg2)
                                 free (new_msg2);
-                            if (nick)
-                                free (nick);
-                            if (host)
-                                free (host);
-                            if (command)
+                            if (command && (command != str_command))
                                 free (command);
-                            if (channel)
+                            if (channel && (channel != str_channel))
                                 free (channel);
-                            if (arguments)
-                                free (arguments);
                             if (msg_decoded)
                                 free (msg_decoded);
                             if (msg_decoded_without_color)
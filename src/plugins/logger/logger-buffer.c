@@ -30,10 +30,13 @@
 #include "../weechat-plugin.h"
 #include "logger.h"
 #include "logger-buffer.h"
+#include "logger-writer.h"
 
 
 struct t_logger_buffer *logger_buffers = NULL;
 struct t_logger_buffer *last_logger_buffer = NULL;
+struct t_hashtable *logger_buffers_hashtable = NULL; /* buffer -> logger    */
+                                                     /* buffer (fast search)*/
 
 
 /*
@@ -85,6 +88,17 @@ logger_buffer_add (struct t_gui_buffer *buffer, int log_level)
                                   weechat_buffer_get_string (buffer, "name"));
     }
 
+    if (!logger_buffers_hashtable)
+    {
+        logger_buffers_hashtable = weechat_hashtable_new (
+            32,
+            WEECHAT_HASHTABLE_POINTER,
+            WEECHAT_HASHTABLE_POINTER,
+            NULL, NULL);
+        if (!logger_buffers_hashtable)
+            return NULL;
+    }
+
     new_logger_buffer = malloc (sizeof (*new_logger_buffer));
     if (new_logger_buffer)
     {
@@ -103,6 +117,9 @@ logger_buffer_add (struct t_gui_buffer *buffer, int log_level)
         else
             logger_buffers = new_logger_buffer;
         last_logger_buffer = new_logger_buffer;
+
+        weechat_hashtable_set (logger_buffers_hashtable,
+                               buffer, new_logger_buffer);
     }
 
     return new_logger_buffer;
@@ -117,17 +134,10 @@ logger_buffer_add (struct t_gui_buffer *buffer, int log_level)
 struct t_logger_buffer *
 logger_buffer_search_buffer (struct t_gui_buffer *buffer)
 {
-    struct t_logger_buffer *ptr_logger_buffer;
-
-    for (ptr_logger_buffer = logger_buffers; ptr_logger_buffer;
-         ptr_logger_buffer = ptr_logger_buffer->next_buffer)
-    {
-        if (ptr_logger_buffer->buffer == buffer)
-            return ptr_logger_buffer;
-    }
+    if (!buffer || !logger_buffers_hashtable)
+        return NULL;
 
-    /* logger buffer not found */
-    return NULL;
+    return weechat_hashtable_get (logger_buffers_hashtable, buffer);
 }
 
 /*
@@ -187,16 +197,29 @@ logger_buffer_free (struct t_logger_buffer *logger_buffer)
     if (logger_buffer->next_buffer)
         (logger_buffer->next_buffer)->prev_buffer = logger_buffer->prev_buffer;
 
+    if (logger_buffers_hashtable
+        && (weechat_hashtable_get (logger_buffers_hashtable,
+                                   ptr_buffer) == logger_buffer))
+    {
+        weechat_hashtable_remove (logger_buffers_hashtable, ptr_buffer);
+    }
+
     /* free data */
     if (logger_buffer->log_filename)
         free (logger_buffer->log_filename);
     if (logger_buffer->log_file)
-        fclose (logger_buffer->log_file);
+        logger_writer_file_close (logger_buffer->log_file);
 
     free (logger_buffer);
 
     logger_buffers = new_logger_buffers;
 
+    if (!logger_buffers && logger_buffers_hashtable)
+    {
+        weechat_hashtable_free (logger_buffers_hashtable);
+        logger_buffers_hashtable = NULL;
+    }
+
     if (weechat_logger_plugin->debug)
     {
         weechat_printf_date_tags (
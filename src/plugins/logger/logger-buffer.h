@@ -20,15 +20,14 @@
 #ifndef WEECHAT_PLUGIN_LOGGER_BUFFER_H
 #define WEECHAT_PLUGIN_LOGGER_BUFFER_H
 
-#include <stdio.h>
-
 struct t_infolist;
+struct t_logger_writer_file;
 
 struct t_logger_buffer
 {
     struct t_gui_buffer *buffer;          /* pointer to buffer              */
     char *log_filename;                   /* log filename                   */
-    FILE *log_file;                       /* log file                       */
+    struct t_logger_writer_file *log_file; /* log file (written by thread)  */
     int log_enabled;                      /* log enabled ?                  */
     int log_level;                        /* log level (0..9)               */
     int write_start_info_line;            /* 1 if start info line must be   */
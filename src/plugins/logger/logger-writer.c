@@ -0,0 +1,594 @@
+/*
+ * logger-writer.c - write of log files in a separate thread
+ *
+ * Copyright (C) 2003-2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lines are formatted by the main thread and added in a list of chunks for
+ * each file; a writer thread writes the chunks with writev (so that the main
+ * loop is never blocked by a slow disk).
+ *
+ * The writer thread never calls the WeeChat API: errors are saved and
+ * displayed later by the main thread.
+ *
+ * If the thread can not be created, data is written by the main thread
+ * (same behavior as before, with a single writev per file).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "../weechat-plugin.h"
+#include "logger.h"
+#include "logger-writer.h"
+
+
+pthread_t logger_writer_thread;        /* thread writing log files          */
+int logger_writer_thread_running = 0;  /* 1 if thread is running            */
+pthread_mutex_t logger_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t logger_writer_cond_work = PTHREAD_COND_INITIALIZER;
+pthread_cond_t logger_writer_cond_done = PTHREAD_COND_INITIALIZER;
+
+/* all variables below are protected by the mutex */
+
+struct t_logger_writer_file *logger_writer_files = NULL; /* files         */
+struct t_logger_writer_chunk *logger_writer_free_chunks = NULL; /* chunks   */
+                                       /* not used (ready for re-use)       */
+int logger_writer_free_chunks_count = 0; /* number of free chunks           */
+int logger_writer_pending = 0;         /* bytes waiting to be written       */
+int logger_writer_work = 0;            /* 1 if data must be written now     */
+int logger_writer_busy = 0;            /* 1 if data is being written        */
+int logger_writer_fsync_count = 0;     /* number of fsync done (stats)      */
+int logger_writer_quit = 0;            /* 1 if thread must stop             */
+char *logger_writer_error_filename = NULL; /* file with a write error       */
+int logger_writer_error_errno = 0;     /* errno of write error              */
+
+
+/*
+ * Displays the write error saved by the writer thread (if any).
+ *
+ * This function must be called by the main thread, without the mutex locked.
+ */
+
+void
+logger_writer_display_error ()
+{
+    char *filename;
+    int error;
+
+    pthread_mutex_lock (&logger_writer_mutex);
+    filename = logger_writer_error_filename;
+    error = logger_writer_error_errno;
+    logger_writer_error_filename = NULL;
+    logger_writer_error_errno = 0;
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    if (filename)
+    {
+        weechat_printf_date_tags (
+            NULL, 0, "no_log",
+            _("%s%s: unable to write log file \"%s\": %s"),
+            weechat_prefix ("error"), LOGGER_PLUGIN_NAME,
+            filename, strerror (error));
+        free (filename);
+    }
+}
+
+/*
+ * Gets a new chunk (a free chunk is re-used if possible).
+ *
+ * The mutex must be locked.
+ *
+ * Returns pointer to new chunk, NULL if error.
+ */
+
+struct t_logger_writer_chunk *
+logger_writer_chunk_new (int size)
+{
+    struct t_logger_writer_chunk *new_chunk;
+
+    if ((size <= LOGGER_WRITER_CHUNK_SIZE) && logger_writer_free_chunks)
+    {
+        new_chunk = logger_writer_free_chunks;
+        logger_writer_free_chunks = new_chunk->next_chunk;
+        logger_writer_free_chunks_count--;
+        new_chunk->size = 0;
+        new_chunk->next_chunk = NULL;
+        return new_chunk;
+    }
+
+    new_chunk = malloc (sizeof (*new_chunk));
+    if (!new_chunk)
+        return NULL;
+
+    if (size < LOGGER_WRITER_CHUNK_SIZE)
+        size = LOGGER_WRITER_CHUNK_SIZE;
+    new_chunk->data = malloc (size);
+    if (!new_chunk->data)
+    {
+        free (new_chunk);
+        return NULL;
+    }
+    new_chunk->size = 0;
+    new_chunk->alloc = size;
+    new_chunk->next_chunk = NULL;
+
+    return new_chunk;
+}
+
+/*
+ * Frees a list of chunks (chunks are kept for re-use, up to a limit).
+ *
+ * The mutex must be locked.
+ */
+
+void
+logger_writer_chunk_free_list (struct t_logger_writer_chunk *chunks)
+{
+    struct t_logger_writer_chunk *next_chunk;
+
+    while (chunks)
+    {
+        next_chunk = chunks->next_chunk;
+        if ((chunks->alloc == LOGGER_WRITER_CHUNK_SIZE)
+            && (logger_writer_free_chunks_count < LOGGER_WRITER_MAX_FREE))
+        {
+            chunks->next_chunk = logger_writer_free_chunks;
+            logger_writer_free_chunks = chunks;
+            logger_writer_free_chunks_count++;
+        }
+        else
+        {
+            free (chunks->data);
+            free (chunks);
+        }
+        chunks = next_chunk;
+    }
+}
+
+/*
+ * Writes chunks of a file with writev.
+ *
+ * This function is called without the mutex locked, by the writer thread
+ * (or the main thread if the writer thread is not running).
+ *
+ * Returns 0 if OK, errno value if error.
+ */
+
+int
+logger_writer_write_chunks (struct t_logger_writer_file *file)
+{
+    struct t_logger_writer_chunk *ptr_chunk;
+    struct iovec iov[LOGGER_WRITER_MAX_IOV];
+    int count;
+    ssize_t num_written;
+
+    ptr_chunk = file->writing;
+    while (ptr_chunk)
+    {
+        count = 0;
+        while (ptr_chunk && (count < LOGGER_WRITER_MAX_IOV))
+        {
+            iov[count].iov_base = ptr_chunk->data;
+            iov[count].iov_len = ptr_chunk->size;
+            count++;
+            ptr_chunk = ptr_chunk->next_chunk;
+        }
+        while (count > 0)
+        {
+            num_written = writev (file->fd, iov, count);
+            if (num_written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return errno;
+            }
+            /* skip data written (partial write is possible) */
+            while ((count > 0) && (num_written >= (ssize_t)iov[0].iov_len))
+            {
+                num_written -= iov[0].iov_len;
+                memmove (iov, iov + 1, (count - 1) * sizeof (iov[0]));
+                count--;
+            }
+            if (count > 0)
+            {
+                iov[0].iov_base = (char *)iov[0].iov_base + num_written;
+                iov[0].iov_len -= num_written;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Writes all data waiting in files, then closes files for which a close was
+ * requested.
+ *
+ * The mutex must be locked when this function is called; it is unlocked
+ * during the write in files.
+ */
+
+void
+logger_writer_process ()
+{
+    struct t_logger_writer_file *ptr_file, *next_file;
+    int error, fsync_count;
+
+    logger_writer_work = 0;
+    logger_writer_busy = 1;
+    for (ptr_file = logger_writer_files; ptr_file;
+         ptr_file = ptr_file->next_file)
+    {
+        ptr_file->writing = ptr_file->chunks;
+        ptr_file->chunks = NULL;
+        ptr_file->last_chunk = NULL;
+        ptr_file->fsync_writing = ptr_file->fsync_requested;
+        ptr_file->fsync_requested = 0;
+    }
+    logger_writer_pending = 0;
+
+    /*
+     * files are added at the beginning of list and removed only by this
+     * function, so the list can be read without the mutex
+     */
+    ptr_file = logger_writer_files;
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    fsync_count = 0;
+    for (; ptr_file; ptr_file = ptr_file->next_file)
+    {
+        if (!ptr_file->writing)
+            continue;
+        error = logger_writer_write_chunks (ptr_file);
+        if ((error == 0) && ptr_file->fsync_writing)
+        {
+            fsync (ptr_file->fd);
+            fsync_count++;
+        }
+        if (error != 0)
+        {
+            pthread_mutex_lock (&logger_writer_mutex);
+            if (!logger_writer_error_filename)
+            {
+                logger_writer_error_filename = strdup (ptr_file->filename);
+                logger_writer_error_errno = error;
+            }
+            pthread_mutex_unlock (&logger_writer_mutex);
+        }
+    }
+
+    pthread_mutex_lock (&logger_writer_mutex);
+
+    logger_writer_fsync_count += fsync_count;
+
+    ptr_file = logger_writer_files;
+    while (ptr_file)
+    {
+        next_file = ptr_file->next_file;
+        if (ptr_file->writing)
+        {
+            logger_writer_chunk_free_list (ptr_file->writing);
+            ptr_file->writing = NULL;
+        }
+        if (ptr_file->close_requested && !ptr_file->chunks)
+        {
+            close (ptr_file->fd);
+            if (ptr_file->prev_file)
+                (ptr_file->prev_file)->next_file = ptr_file->next_file;
+            else
+                logger_writer_files = ptr_file->next_file;
+            if (ptr_file->next_file)
+                (ptr_file->next_file)->prev_file = ptr_file->prev_file;
+            free (ptr_file->filename);
+            free (ptr_file);
+        }
+        ptr_file = next_file;
+    }
+
+    logger_writer_busy = 0;
+    pthread_cond_broadcast (&logger_writer_cond_done);
+}
+
+/*
+ * Asks the writer thread to write data now.
+ *
+ * The mutex must be locked.
+ */
+
+void
+logger_writer_wakeup ()
+{
+    logger_writer_work = 1;
+    if (logger_writer_thread_running)
+        pthread_cond_signal (&logger_writer_cond_work);
+    else
+        logger_writer_process ();
+}
+
+/*
+ * Main function of the writer thread.
+ */
+
+void *
+logger_writer_thread_run (void *arg)
+{
+    sigset_t signals;
+
+    /* make C compiler happy */
+    (void) arg;
+
+    /* signals are handled by the main thread */
+    sigfillset (&signals);
+    pthread_sigmask (SIG_BLOCK, &signals, NULL);
+
+    pthread_mutex_lock (&logger_writer_mutex);
+    while (1)
+    {
+        while (!logger_writer_work && !logger_writer_quit)
+        {
+            pthread_cond_wait (&logger_writer_cond_work, &logger_writer_mutex);
+        }
+        if (!logger_writer_work)
+            break;
+        logger_writer_process ();
+    }
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    return NULL;
+}
+
+/*
+ * Creates a new file for the writer, with a file descriptor opened by the
+ * caller.
+ *
+ * Returns pointer to new file, NULL if error.
+ */
+
+struct t_logger_writer_file *
+logger_writer_file_new (int fd, const char *filename)
+{
+    struct t_logger_writer_file *new_file;
+
+    new_file = malloc (sizeof (*new_file));
+    if (!new_file)
+        return NULL;
+
+    new_file->fd = fd;
+    new_file->filename = strdup ((filename) ? filename : "");
+    if (!new_file->filename)
+    {
+        free (new_file);
+        return NULL;
+    }
+    new_file->chunks = NULL;
+    new_file->last_chunk = NULL;
+    new_file->writing = NULL;
+    new_file->close_requested = 0;
+    new_file->fsync_requested = 0;
+    new_file->fsync_writing = 0;
+
+    pthread_mutex_lock (&logger_writer_mutex);
+    new_file->prev_file = NULL;
+    new_file->next_file = logger_writer_files;
+    if (logger_writer_files)
+        logger_writer_files->prev_file = new_file;
+    logger_writer_files = new_file;
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    return new_file;
+}
+
+/*
+ * Closes a file: data waiting is written, then the file is closed and freed
+ * by the writer.
+ *
+ * The file must not be used any more after call to this function.
+ */
+
+void
+logger_writer_file_close (struct t_logger_writer_file *file)
+{
+    if (!file)
+        return;
+
+    pthread_mutex_lock (&logger_writer_mutex);
+    file->close_requested = 1;
+    logger_writer_wakeup ();
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    logger_writer_display_error ();
+}
+
+/*
+ * Adds a line in a file (a new line is added after the line).
+ *
+ * If flush == 1, the writer thread writes the line immediately, otherwise
+ * the line is written on next flush (or when too much data is waiting).
+ *
+ * If fsync == 1, fsync is called on file after the line is written (whatever
+ * the fsync argument of the next flush is).
+ */
+
+void
+logger_writer_write_line (struct t_logger_writer_file *file,
+                          const char *line, int flush, int fsync)
+{
+    struct t_logger_writer_chunk *ptr_chunk;
+    int length;
+
+    if (!file || !line)
+        return;
+
+    length = strlen (line);
+
+    pthread_mutex_lock (&logger_writer_mutex);
+
+    ptr_chunk = file->last_chunk;
+    if (!ptr_chunk || (ptr_chunk->size + length + 1 > ptr_chunk->alloc))
+    {
+        ptr_chunk = logger_writer_chunk_new (length + 1);
+        if (!ptr_chunk)
+        {
+            pthread_mutex_unlock (&logger_writer_mutex);
+            return;
+        }
+        if (file->last_chunk)
+            file->last_chunk->next_chunk = ptr_chunk;
+        else
+            file->chunks = ptr_chunk;
+        file->last_chunk = ptr_chunk;
+    }
+    memcpy (ptr_chunk->data + ptr_chunk->size, line, length);
+    ptr_chunk->data[ptr_chunk->size + length] = '\n';
+    ptr_chunk->size += length + 1;
+    logger_writer_pending += length + 1;
+    if (fsync)
+        file->fsync_requested = 1;
+
+    if (flush || (logger_writer_pending >= LOGGER_WRITER_MAX_PENDING))
+        logger_writer_wakeup ();
+
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    logger_writer_display_error ();
+}
+
+/*
+ * Writes all data waiting in files.
+ *
+ * If fsync == 1, fsync is called on files with data waiting, after write
+ * (if fsync == 0, fsync is still called on files for which it has been
+ * requested when lines were added).
+ * If wait == 1, this function returns when all data has been written.
+ */
+
+void
+logger_writer_flush (int fsync, int wait)
+{
+    struct t_logger_writer_file *ptr_file;
+
+    pthread_mutex_lock (&logger_writer_mutex);
+
+    if (fsync)
+    {
+        for (ptr_file = logger_writer_files; ptr_file;
+             ptr_file = ptr_file->next_file)
+        {
+            if (ptr_file->chunks)
+                ptr_file->fsync_requested = 1;
+        }
+    }
+    logger_writer_wakeup ();
+    if (wait && logger_writer_thread_running)
+    {
+        while (logger_writer_work || logger_writer_busy)
+        {
+            pthread_cond_wait (&logger_writer_cond_done, &logger_writer_mutex);
+        }
+    }
+
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    logger_writer_display_error ();
+}
+
+/*
+ * Starts the writer thread.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (the main thread will write in files)
+ */
+
+int
+logger_writer_init ()
+{
+    logger_writer_quit = 0;
+
+    if (pthread_create (&logger_writer_thread, NULL,
+                        &logger_writer_thread_run, NULL) != 0)
+    {
+        logger_writer_thread_running = 0;
+        return 0;
+    }
+
+    logger_writer_thread_running = 1;
+
+    return 1;
+}
+
+/*
+ * Stops the writer thread: all data waiting is written, then all files are
+ * closed.
+ */
+
+void
+logger_writer_end ()
+{
+    struct t_logger_writer_file *ptr_file;
+    struct t_logger_writer_chunk *ptr_chunk;
+
+    pthread_mutex_lock (&logger_writer_mutex);
+    logger_writer_quit = 1;
+    logger_writer_work = 1;
+    if (logger_writer_thread_running)
+        pthread_cond_signal (&logger_writer_cond_work);
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    if (logger_writer_thread_running)
+    {
+        pthread_join (logger_writer_thread, NULL);
+        logger_writer_thread_running = 0;
+    }
+
+    pthread_mutex_lock (&logger_writer_mutex);
+
+    /* write data waiting (if thread was not running) and close all files */
+    for (ptr_file = logger_writer_files; ptr_file;
+         ptr_file = ptr_file->next_file)
+    {
+        ptr_file->close_requested = 1;
+    }
+    logger_writer_process ();
+
+    /* free chunks kept for re-use */
+    while (logger_writer_free_chunks)
+    {
+        ptr_chunk = logger_writer_free_chunks->next_chunk;
+        free (logger_writer_free_chunks->data);
+        free (logger_writer_free_chunks);
+        logger_writer_free_chunks = ptr_chunk;
+    }
+    logger_writer_free_chunks_count = 0;
+
+    pthread_mutex_unlock (&logger_writer_mutex);
+
+    logger_writer_display_error ();
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2003-2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEECHAT_PLUGIN_LOGGER_WRITER_H
+#define WEECHAT_PLUGIN_LOGGER_WRITER_H
+
+#define LOGGER_WRITER_CHUNK_SIZE    8192
+#define LOGGER_WRITER_MAX_PENDING   (256 * 1024)
+#define LOGGER_WRITER_MAX_FREE      64
+#define LOGGER_WRITER_MAX_IOV       64
+
+struct t_logger_writer_chunk
+{
+    char *data;                        /* data to write                     */
+    int size;                          /* size of data                      */
+    int alloc;                         /* allocated size for data           */
+    struct t_logger_writer_chunk *next_chunk; /* next chunk for file        */
+};
+
+struct t_logger_writer_file
+{
+    int fd;                            /* file descriptor                   */
+    char *filename;                    /* filename (for error messages)     */
+    struct t_logger_writer_chunk *chunks; /* data waiting to be written     */
+    struct t_logger_writer_chunk *last_chunk; /* last chunk (for append)    */
+    struct t_logger_writer_chunk *writing; /* chunks being written (owned   */
+                                       /* by the writer thread)             */
+    int close_requested;               /* 1 if file must be closed after    */
+                                       /* data is written                   */
+    int fsync_requested;               /* 1 if fsync must be called after   */
+                                       /* write of data waiting             */
+    int fsync_writing;                 /* 1 if fsync must be called after   */
+                                       /* write of chunks being written     */
+    struct t_logger_writer_file *prev_file; /* link to previous file        */
+    struct t_logger_writer_file *next_file; /* link to next file            */
+};
+
+extern int logger_writer_thread_running;
+extern int logger_writer_fsync_count;
+
+extern struct t_logger_writer_file *logger_writer_file_new (int fd,
+                                                            const char *filename);
+extern void logger_writer_file_close (struct t_logger_writer_file *file);
+extern void logger_writer_write_line (struct t_logger_writer_file *file,
+                                      const char *line, int flush,
+                                      int fsync);
+extern void logger_writer_flush (int fsync, int wait);
+extern int logger_writer_init ();
+extern void logger_writer_end ();
+
+#endif /* WEECHAT_PLUGIN_LOGGER_WRITER_H */
@@ -43,6 +43,7 @@
 #include "logger-config.h"
 #include "logger-info.h"
 #include "logger-tail.h"
+#include "logger-writer.h"
 
 
 WEECHAT_PLUGIN_NAME(LOGGER_PLUGIN_NAME);
@@ -55,6 +56,10 @@ WEECHAT_PLUGIN_PRIORITY(14000);
 struct t_weechat_plugin *weechat_logger_plugin = NULL;
 
 struct t_hook *logger_timer = NULL;    /* timer to flush log files          */
+char *logger_charset = NULL;           /* terminal charset (NULL if UTF-8)  */
+time_t logger_last_time_date = 0;      /* date of last time formatted       */
+char *logger_last_time_format = NULL;  /* format of last time formatted     */
+char logger_last_time[256];            /* last time formatted               */
 
 
 /*
@@ -510,6 +515,69 @@ logger_set_log_filename (struct t_logger_buffer *logger_buffer)
     logger_buffer->log_filename = log_filename;
 }
 
+/*
+ * Formats a date with the time format of log files.
+ *
+ * The last date formatted is kept, so that many lines displayed in the same
+ * second are formatted only once.
+ */
+
+const char *
+logger_format_time (time_t date)
+{
+    const char *time_format;
+    struct tm *date_tmp;
+
+    time_format = weechat_config_string (logger_config_file_time_format);
+
+    if (logger_last_time_format
+        && (date == logger_last_time_date)
+        && (strcmp (time_format, logger_last_time_format) == 0))
+    {
+        return logger_last_time;
+    }
+
+    logger_last_time[0] = '\0';
+    date_tmp = localtime (&date);
+    if (date_tmp)
+    {
+        if (strftime (logger_last_time, sizeof (logger_last_time) - 1,
+                      time_format, date_tmp) == 0)
+            logger_last_time[0] = '\0';
+    }
+
+    if (logger_last_time_format)
+        free (logger_last_time_format);
+    logger_last_time_format = strdup (time_format);
+    logger_last_time_date = date;
+
+    return logger_last_time;
+}
+
+/*
+ * Adds a line in log file, converted to terminal charset.
+ *
+ * The line is written by the writer thread (immediately if no flush delay
+ * is set, otherwise on next flush), then the file is synchronized with the
+ * storage device if option logger.file.fsync is on.
+ */
+
+void
+logger_write_string (struct t_logger_buffer *logger_buffer, const char *string)
+{
+    char *message;
+
+    message = (logger_charset) ?
+        weechat_iconv_from_internal (logger_charset, string) : NULL;
+    logger_writer_write_line (logger_buffer->log_file,
+                              (message) ? message : string,
+                              (logger_timer) ? 0 : 1,
+                              weechat_config_boolean (logger_config_file_fsync));
+    if (message)
+        free (message);
+    logger_buffer->flush_needed = (logger_timer) ? 1 : 0;
+}
+
 /*
  * Writes a line to log file.
  */
@@ -518,13 +586,8 @@ void
 logger_write_line (struct t_logger_buffer *logger_buffer,
                    const char *format, ...)
 {
-    char *message, buf_time[256], buf_beginning[1024];
-    const char *charset;
-    time_t seconds;
-    struct tm *date_tmp;
-    int log_level;
-
-    charset = weechat_info_get ("charset_terminal", "");
+    char buf_beginning[1024];
+    int log_level, fd;
 
     if (!logger_buffer->log_file)
     {
@@ -553,8 +616,18 @@ logger_write_line (struct t_logger_buffer *logger_buffer,
             return;
         }
 
-        logger_buffer->log_file =
-            fopen (logger_buffer->log_filename, "a");
+        fd = open (logger_buffer->log_filename,
+                   O_WRONLY | O_APPEND | O_CREAT, 0666);
+        if (fd >= 0)
+        {
+            logger_buffer->log_file =
+                logger_writer_file_new (fd, logger_buffer->log_filename);
+            if (!logger_buffer->log_file)
+            {
+                close (fd);
+                errno = ENOMEM;
+            }
+        }
         if (!logger_buffer->log_file)
         {
             weechat_printf_date_tags (
@@ -569,26 +642,10 @@ logger_write_line (struct t_logger_buffer *logger_buffer,
         if (weechat_config_boolean (logger_config_file_info_lines)
             && logger_buffer->write_start_info_line)
         {
-            buf_time[0] = '\0';
-            seconds = time (NULL);
-            date_tmp = localtime (&seconds);
-            if (date_tmp)
-            {
-                if (strftime (buf_time, sizeof (buf_time) - 1,
-                              weechat_config_string (logger_config_file_time_format),
-                              date_tmp) == 0)
-                    buf_time[0] = '\0';
-            }
             snprintf (buf_beginning, sizeof (buf_beginning),
                       _("%s\t****  Beginning of log  ****"),
-                      buf_time);
-            message = (charset) ?
-                weechat_iconv_from_internal (charset, buf_beginning) : NULL;
-            fprintf (logger_buffer->log_file,
-                     "%s\n", (message) ? message : buf_beginning);
-            if (message)
-                free (message);
-            logger_buffer->flush_needed = 1;
+                      logger_format_time (time (NULL)));
+            logger_write_string (logger_buffer, buf_beginning);
         }
         logger_buffer->write_start_info_line = 0;
     }
@@ -596,20 +653,7 @@ logger_write_line (struct t_logger_buffer *logger_buffer,
     weechat_va_format (format);
     if (vbuffer)
     {
-        message = (charset) ?
-            weechat_iconv_from_internal (charset, vbuffer) : NULL;
-        fprintf (logger_buffer->log_file,
-                 "%s\n", (message) ? message : vbuffer);
-        if (message)
-            free (message);
-        logger_buffer->flush_needed = 1;
-        if (!logger_timer)
-        {
-            fflush (logger_buffer->log_file);
-            if (weechat_config_boolean (logger_config_file_fsync))
-                fsync (fileno (logger_buffer->log_file));
-            logger_buffer->flush_needed = 0;
-        }
+        logger_write_string (logger_buffer, vbuffer);
         free (vbuffer);
     }
 }
@@ -621,10 +665,6 @@ logger_write_line (struct t_logger_buffer *logger_buffer,
 void
 logger_stop (struct t_logger_buffer *logger_buffer, int write_info_line)
 {
-    time_t seconds;
-    struct tm *date_tmp;
-    char buf_time[256];
-
     if (!logger_buffer)
         return;
 
@@ -632,21 +672,11 @@ logger_stop (struct t_logger_buffer *logger_buffer, int write_info_line)
     {
         if (write_info_line && weechat_config_boolean (logger_config_file_info_lines))
         {
-            buf_time[0] = '\0';
-            seconds = time (NULL);
-            date_tmp = localtime (&seconds);
-            if (date_tmp)
-            {
-                if (strftime (buf_time, sizeof (buf_time) - 1,
-                              weechat_config_string (logger_config_file_time_format),
-                              date_tmp) == 0)
-                    buf_time[0] = '\0';
-            }
             logger_write_line (logger_buffer,
                                _("%s\t****  End of log  ****"),
-                               buf_time);
+                               logger_format_time (time (NULL)));
         }
-        fclose (logger_buffer->log_file);
+        logger_writer_file_close (logger_buffer->log_file);
         logger_buffer->log_file = NULL;
     }
     logger_buffer_free (logger_buffer);
@@ -706,7 +736,7 @@ logger_start_buffer (struct t_gui_buffer *buffer, int write_info_line)
                 {
                     if (ptr_logger_buffer->log_file)
                     {
-                        fclose (ptr_logger_buffer->log_file);
+                        logger_writer_file_close (ptr_logger_buffer->log_file);
                         ptr_logger_buffer->log_file = NULL;
                     }
                 }
@@ -826,10 +856,12 @@ logger_set_buffer (struct t_gui_buffer *buffer, const char *value)
 
 /*
  * Flushes all log files.
+ *
+ * If wait == 1, this function returns when all data has been written.
  */
 
 void
-logger_flush ()
+logger_flush (int wait)
 {
     struct t_logger_buffer *ptr_logger_buffer;
 
@@ -845,12 +877,12 @@ logger_flush ()
                                           LOGGER_PLUGIN_NAME,
                                           ptr_logger_buffer->log_filename);
             }
-            fflush (ptr_logger_buffer->log_file);
-            if (weechat_config_boolean (logger_config_file_fsync))
-                fsync (fileno (ptr_logger_buffer->log_file));
             ptr_logger_buffer->flush_needed = 0;
         }
     }
+
+    logger_writer_flush (weechat_config_boolean (logger_config_file_fsync),
+                         wait);
 }
 
 /*
@@ -883,7 +915,7 @@ logger_command_cb (const void *pointer, void *data,
 
     if (weechat_strcasecmp (argv[1], "flush") == 0)
     {
-        logger_flush ();
+        logger_flush (1);
         return WEECHAT_RC_OK;
     }
 
@@ -1031,6 +1063,9 @@ logger_backlog (struct t_gui_buffer *buffer, const char *filename, int lines)
 
     weechat_buffer_set (buffer, "print_hooks_enabled", "0");
 
+    /* write data waiting, so that end of log file is up-to-date */
+    logger_writer_flush (0, 1);
+
     num_lines = 0;
     last_lines = logger_tail_file (filename, lines);
     ptr_lines = last_lines;
@@ -1307,8 +1342,6 @@ logger_print_cb (const void *pointer, void *data,
                  const char *prefix, const char *message)
 {
     struct t_logger_buffer *ptr_logger_buffer;
-    struct tm *date_tmp;
-    char buf_time[256];
     int line_log_level, prefix_is_nick;
 
     /* make C compiler happy */
@@ -1327,19 +1360,9 @@ logger_print_cb (const void *pointer, void *data,
             && (date > 0)
             && (line_log_level <= ptr_logger_buffer->log_level))
         {
-            buf_time[0] = '\0';
-            date_tmp = localtime (&date);
-            if (date_tmp)
-            {
-                if (strftime (buf_time, sizeof (buf_time) - 1,
-                              weechat_config_string (logger_config_file_time_format),
-                              date_tmp) == 0)
-                    buf_time[0] = '\0';
-            }
-
             logger_write_line (ptr_logger_buffer,
                                "%s\t%s%s%s\t%s",
-                               buf_time,
+                               logger_format_time (date),
                                (prefix && prefix_is_nick) ? weechat_config_string (logger_config_file_nick_prefix) : "",
                                (prefix) ? prefix : "",
                                (prefix && prefix_is_nick) ? weechat_config_string (logger_config_file_nick_suffix) : "",
@@ -1362,7 +1385,7 @@ logger_timer_cb (const void *pointer, void *data, int remaining_calls)
     (void) data;
     (void) remaining_calls;
 
-    logger_flush ();
+    logger_flush (0);
 
     return WEECHAT_RC_OK;
 }
@@ -1374,12 +1397,18 @@ logger_timer_cb (const void *pointer, void *data, int remaining_calls)
 int
 weechat_plugin_init (struct t_weechat_plugin *plugin, int argc, char *argv[])
 {
+    const char *charset;
+
     /* make C compiler happy */
     (void) argc;
     (void) argv;
 
     weechat_plugin = plugin;
 
+    charset = weechat_info_get ("charset_terminal", "");
+    logger_charset = (charset && (weechat_strcasecmp (charset, "UTF-8") != 0)) ?
+        strdup (charset) : NULL;
+
     if (!logger_config_init ())
         return WEECHAT_RC_ERROR;
 
@@ -1427,6 +1456,8 @@ weechat_plugin_init (struct t_weechat_plugin *plugin, int argc, char *argv[])
         " || disable",
         &logger_command_cb, NULL, NULL);
 
+    logger_writer_init ();
+
     logger_start_buffer_all (1);
 
     weechat_hook_signal ("buffer_opened",
@@ -1471,7 +1502,20 @@ weechat_plugin_end (struct t_weechat_plugin *plugin)
 
     logger_stop_all (1);
 
+    logger_writer_end ();
+
     logger_config_free ();
 
+    if (logger_charset)
+    {
+        free (logger_charset);
+        logger_charset = NULL;
+    }
+    if (logger_last_time_format)
+    {
+        free (logger_last_time_format);
+        logger_last_time_format = NULL;
+    }
+
     return WEECHAT_RC_OK;
 }
@@ -307,8 +307,108 @@ XS (weechat_perl_output)
     weechat_string_dyn_concat (perl_buffer_output, ptr_msg);
 }
 
+/*
+ * Releases a perl object kept in a callable (callback called by plugin-script
+ * functions).
+ */
+
+void
+weechat_perl_callable_free_cb (struct t_plugin_script_callable *callable,
+                               void *object)
+{
+#ifdef MULTIPLICITY
+    void *old_context;
+
+    old_context = PERL_GET_CONTEXT;
+    if (callable->script->interpreter)
+        PERL_SET_CONTEXT (callable->script->interpreter);
+#else
+    /* make C compiler happy */
+    (void) callable;
+#endif /* MULTIPLICITY */
+
+    SvREFCNT_dec ((SV *)object);
+
+#ifdef MULTIPLICITY
+    PERL_SET_CONTEXT (old_context);
+#endif /* MULTIPLICITY */
+}
+
+/*
+ * Builds the full name of a perl function: "package::function" if all
+ * scripts share the same interpreter, function otherwise.
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+weechat_perl_function_name (struct t_plugin_script *script,
+                            const char *function)
+{
+#ifdef MULTIPLICITY
+    /* make C compiler happy */
+    (void) script;
+
+    return strdup (function);
+#else
+    char *func;
+    int length;
+
+    length = strlen ((script->interpreter) ? script->interpreter : perl_main) +
+        strlen (function) + 3;
+    func = (char *) malloc (length);
+    if (!func)
+        return NULL;
+    snprintf (func, length, "%s::%s",
+              (char *) ((script->interpreter) ? script->interpreter : perl_main),
+              function);
+    return func;
+#endif /* MULTIPLICITY */
+}
+
+/*
+ * Resolves the function of a callable: the glob and the sub are kept in
+ * callable, so the function is searched by name only on first call (or if the
+ * sub has been redefined in script).
+ *
+ * Returns the sub, NULL if not found.
+ */
+
+CV *
+weechat_perl_callable_resolve (struct t_plugin_script_callable *callable,
+                               const char *function)
+{
+    char *func;
+    GV *gv;
+
+    if (callable->function)
+    {
+        if (GvCV((GV *)callable->scope) == (CV *)callable->function)
+            return (CV *)callable->function;
+        /* sub redefined (or removed): release all cached objects */
+        plugin_script_callable_reset (callable);
+    }
+
+    func = weechat_perl_function_name (callable->script, function);
+    if (!func)
+        return NULL;
+    gv = gv_fetchpv (func, 0, SVt_PVCV);
+    free (func);
+    if (!gv || !GvCV(gv))
+        return NULL;
+
+    callable->scope = SvREFCNT_inc ((SV *)gv);
+    callable->function = SvREFCNT_inc ((SV *)GvCV(gv));
+
+    return (CV *)callable->function;
+}
+
 /*
  * Executes a perl function.
+ *
+ * The sub is kept in a callable, so that it is not searched by name on each
+ * call (arguments are not cached: they are aliased in @_ and the function can
+ * modify them).
  */
 
 void *
@@ -319,10 +419,12 @@ weechat_perl_exec (struct t_plugin_script *script,
     char *func;
     unsigned int count;
     void *ret_value;
-    int *ret_i, mem_err, length, i, argc;
+    int *ret_i, mem_err, i, argc;
     SV *ret_s;
     HV *hash;
+    CV *cv;
     struct t_plugin_script *old_perl_current_script;
+    struct t_plugin_script_callable *callable;
 #ifdef MULTIPLICITY
     void *old_context;
 #endif /* MULTIPLICITY */
@@ -331,22 +433,31 @@ weechat_perl_exec (struct t_plugin_script *script,
     perl_current_script = script;
 
 #ifdef MULTIPLICITY
-    (void) length;
-    func = (char *) function;
     old_context = PERL_GET_CONTEXT;
     if (script->interpreter)
         PERL_SET_CONTEXT (script->interpreter);
-#else
-    length = strlen ((script->interpreter) ? script->interpreter : perl_main) +
-        strlen (function) + 3;
-    func = (char *) malloc (length);
-    if (!func)
-        return NULL;
-    snprintf (func, length, "%s::%s",
-              (char *) ((script->interpreter) ? script->interpreter : perl_main),
-              function);
 #endif /* MULTIPLICITY */
 
+    callable = plugin_script_callable_get (weechat_perl_plugin, script,
+                                           function,
+                                           &weechat_perl_callable_free_cb);
+    cv = (callable) ? weechat_perl_callable_resolve (callable, function) : NULL;
+
+    /* sub not found: call it by name, so that perl reports the error */
+    func = NULL;
+    if (!cv)
+    {
+        func = weechat_perl_function_name (script, function);
+        if (!func)
+        {
+            perl_current_script = old_perl_current_script;
+#ifdef MULTIPLICITY
+            PERL_SET_CONTEXT (old_context);
+#endif /* MULTIPLICITY */
+            return NULL;
+        }
+    }
+
     dSP;
     ENTER;
     SAVETMPS;
@@ -373,7 +484,10 @@ weechat_perl_exec (struct t_plugin_script *script,
         }
     }
     PUTBACK;
-    count = call_pv (func, G_EVAL | G_SCALAR);
+    if (cv)
+        count = call_sv ((SV *)cv, G_EVAL | G_SCALAR);
+    else
+        count = call_pv (func, G_EVAL | G_SCALAR);
 
     ret_value = NULL;
     mem_err = 1;
@@ -465,9 +579,9 @@ weechat_perl_exec (struct t_plugin_script *script,
     perl_current_script = old_perl_current_script;
 #ifdef MULTIPLICITY
     PERL_SET_CONTEXT (old_context);
-#else
-    free (func);
 #endif /* MULTIPLICITY */
+    if (func)
+        free (func);
 
     if (!ret_value && (mem_err == 1))
     {
@@ -478,6 +478,198 @@ plugin_script_get_function_and_data (void *callback_data,
     }
 }
 
+/*
+ * Releases interpreter objects kept in a callable: function (and its name and
+ * scope), prebuilt arguments and cached arguments.
+ *
+ * This is called when the function has been redefined in the script (the
+ * callable is then resolved again on next call).
+ */
+
+void
+plugin_script_callable_reset (struct t_plugin_script_callable *callable)
+{
+    int i;
+
+    if (!callable)
+        return;
+
+    for (i = 0; i < WEECHAT_SCRIPT_CALLABLE_MAX_ARGS; i++)
+    {
+        if (callable->arg_string[i])
+        {
+            free (callable->arg_string[i]);
+            callable->arg_string[i] = NULL;
+        }
+        if (callable->arg_object[i])
+        {
+            if (callable->callback_free)
+                (callable->callback_free) (callable, callable->arg_object[i]);
+            callable->arg_object[i] = NULL;
+        }
+    }
+    if (callable->args)
+    {
+        if (callable->callback_free)
+            (callable->callback_free) (callable, callable->args);
+        callable->args = NULL;
+    }
+    if (callable->function)
+    {
+        if (callable->callback_free)
+            (callable->callback_free) (callable, callable->function);
+        callable->function = NULL;
+    }
+    if (callable->scope)
+    {
+        if (callable->callback_free)
+            (callable->callback_free) (callable, callable->scope);
+        callable->scope = NULL;
+    }
+    if (callable->function_name)
+    {
+        if (callable->callback_free)
+            (callable->callback_free) (callable, callable->function_name);
+        callable->function_name = NULL;
+    }
+}
+
+/*
+ * Frees a callable (callback called when a callable is removed from the
+ * hashtable "callables" of a script).
+ */
+
+void
+plugin_script_callable_free_value_cb (struct t_hashtable *hashtable,
+                                      const void *key, void *value)
+{
+    /* make C compiler happy */
+    (void) hashtable;
+    (void) key;
+
+    plugin_script_callable_reset ((struct t_plugin_script_callable *)value);
+    free (value);
+}
+
+/*
+ * Gets the callable for a function of a script: it is created if not found
+ * (with no function resolved: the language plugin resolves the function in
+ * interpreter on first call and keeps it in the callable, so that next calls
+ * do not have to search the function by name).
+ *
+ * The callback "callback_free" is called to release the interpreter objects
+ * kept in callable (it can be NULL if objects do not need to be released).
+ *
+ * Returns pointer to callable, NULL if error.
+ */
+
+struct t_plugin_script_callable *
+plugin_script_callable_get (struct t_weechat_plugin *weechat_plugin,
+                            struct t_plugin_script *script,
+                            const char *function,
+                            void (*callback_free)(struct t_plugin_script_callable *callable,
+                                                  void *object))
+{
+    struct t_plugin_script_callable *callable;
+
+    if (!script || !function || !function[0])
+        return NULL;
+
+    if (!script->callables)
+    {
+        script->callables = weechat_hashtable_new (
+            32,
+            WEECHAT_HASHTABLE_STRING,
+            WEECHAT_HASHTABLE_POINTER,
+            NULL, NULL);
+        if (!script->callables)
+            return NULL;
+        weechat_hashtable_set_pointer (script->callables,
+                                       "callback_free_value",
+                                       &plugin_script_callable_free_value_cb);
+    }
+
+    callable = weechat_hashtable_get (script->callables, function);
+    if (callable)
+        return callable;
+
+    callable = calloc (1, sizeof (*callable));
+    if (!callable)
+        return NULL;
+    callable->script = script;
+    callable->callback_free = callback_free;
+    if (!weechat_hashtable_set (script->callables, function, callable))
+    {
+        free (callable);
+        return NULL;
+    }
+
+    return callable;
+}
+
+/*
+ * Gets the interpreter object cached for argument with the given index, if
+ * the argument is the same string as on previous call (for example a pointer
+ * converted to string, or the data of callback).
+ *
+ * Returns the cached object, NULL if the string is not cached.
+ */
+
+void *
+plugin_script_callable_arg_get (struct t_plugin_script_callable *callable,
+                                int index, const char *string)
+{
+    if (!callable || !string
+        || (index < 0) || (index >= WEECHAT_SCRIPT_CALLABLE_MAX_ARGS)
+        || !callable->arg_string[index])
+    {
+        return NULL;
+    }
+
+    return (strcmp (callable->arg_string[index], string) == 0) ?
+        callable->arg_object[index] : NULL;
+}
+
+/*
+ * Caches the interpreter object built for argument with the given index
+ * (the previous object for this index is released).
+ *
+ * Only short strings are cached: a long string (like a message) is rarely the
+ * same on next call.
+ *
+ * Returns:
+ *   1: object cached (the caller must add a reference on object for the cache)
+ *   0: object not cached
+ */
+
+int
+plugin_script_callable_arg_set (struct t_plugin_script_callable *callable,
+                                int index, const char *string, void *object)
+{
+    char *new_string;
+
+    if (!callable || !string || !object
+        || (index < 0) || (index >= WEECHAT_SCRIPT_CALLABLE_MAX_ARGS)
+        || (strlen (string) >= WEECHAT_SCRIPT_CALLABLE_MAX_STRING))
+    {
+        return 0;
+    }
+
+    new_string = strdup (string);
+    if (!new_string)
+        return 0;
+
+    if (callable->arg_string[index])
+        free (callable->arg_string[index]);
+    if (callable->arg_object[index] && callable->callback_free)
+        (callable->callback_free) (callable, callable->arg_object[index]);
+
+    callable->arg_string[index] = new_string;
+    callable->arg_object[index] = object;
+
+    return 1;
+}
+
 /*
  * Auto-loads all scripts in a directory.
  */
@@ -730,6 +922,7 @@ plugin_script_alloc (const char *filename, const char *name,
         strdup (shutdown_func) : NULL;
     new_script->charset = (charset) ? strdup (charset) : NULL;
     new_script->unloading = 0;
+    new_script->callables = NULL;
     new_script->prev_script = NULL;
     new_script->next_script = NULL;
 
@@ -1069,6 +1262,13 @@ plugin_script_remove (struct t_weechat_plugin *weechat_plugin,
     /* remove all hooks created by this script */
     weechat_unhook_all (script->name);
 
+    /* release functions kept by the interpreter (script is still loaded) */
+    if (script->callables)
+    {
+        weechat_hashtable_free (script->callables);
+        script->callables = NULL;
+    }
+
     /* remove script from list */
     if (script->prev_script)
         (script->prev_script)->next_script = script->next_script;
@@ -1827,6 +2027,11 @@ plugin_script_print_log (struct t_weechat_plugin *weechat_plugin,
         weechat_log_printf ("  shutdown_func . . . : '%s'",  ptr_script->shutdown_func);
         weechat_log_printf ("  charset . . . . . . : '%s'",  ptr_script->charset);
         weechat_log_printf ("  unloading . . . . . : %d",    ptr_script->unloading);
+        weechat_log_printf ("  callables . . . . . : 0x%lx (%d)",
+                            ptr_script->callables,
+                            (ptr_script->callables) ?
+                            weechat_hashtable_get_integer (ptr_script->callables,
+                                                           "items_count") : 0);
         weechat_log_printf ("  prev_script . . . . : 0x%lx", ptr_script->prev_script);
         weechat_log_printf ("  next_script . . . . : 0x%lx", ptr_script->next_script);
     }
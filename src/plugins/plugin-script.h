@@ -37,6 +37,10 @@ enum t_weechat_script_exec_type
 
 #define WEECHAT_SCRIPT_EVAL_NAME "__eval__"
 
+/* arguments cached for a callable (function called by WeeChat) */
+#define WEECHAT_SCRIPT_CALLABLE_MAX_ARGS 16
+#define WEECHAT_SCRIPT_CALLABLE_MAX_STRING 128
+
 #define WEECHAT_SCRIPT_MSG_NOT_INIT(__current_script,                   \
                                     __function)                         \
     weechat_printf (NULL,                                               \
@@ -68,10 +72,26 @@ struct t_plugin_script
     char *shutdown_func;                 /* function when script is unloaded*/
     char *charset;                       /* script charset                  */
     int unloading;                       /* script is being unloaded        */
+    struct t_hashtable *callables;       /* functions called by WeeChat     */
+                                         /* (name -> plugin_script_callable)*/
     struct t_plugin_script *prev_script; /* link to previous script         */
     struct t_plugin_script *next_script; /* link to next script             */
 };
 
+struct t_plugin_script_callable
+{
+    struct t_plugin_script *script;      /* script                          */
+    void *function_name;                 /* function name (interpreter obj.)*/
+    void *scope;                         /* scope where function is defined */
+    void *function;                      /* function in interpreter         */
+    void *args;                          /* prebuilt arguments (or NULL)    */
+    char *arg_string[WEECHAT_SCRIPT_CALLABLE_MAX_ARGS]; /* cached args    */
+    void *arg_object[WEECHAT_SCRIPT_CALLABLE_MAX_ARGS]; /* (interpreter   */
+                                                        /* objects)       */
+    void (*callback_free) (struct t_plugin_script_callable *callable,
+                           void *object); /* release an interpreter object  */
+};
+
 struct t_plugin_script_data
 {
     /* variables */
@@ -136,6 +156,17 @@ extern char *plugin_script_build_function_and_data (const char *function,
 extern void plugin_script_get_function_and_data (void *callback_data,
                                                  const char **function,
                                                  const char **data);
+extern struct t_plugin_script_callable *plugin_script_callable_get (struct t_weechat_plugin *weechat_plugin,
+                                                                   struct t_plugin_script *script,
+                                                                   const char *function,
+                                                                   void (*callback_free)(struct t_plugin_script_callable *callable,
+                                                                                         void *object));
+extern void plugin_script_callable_reset (struct t_plugin_script_callable *callable);
+extern void *plugin_script_callable_arg_get (struct t_plugin_script_callable *callable,
+                                             int index, const char *string);
+extern int plugin_script_callable_arg_set (struct t_plugin_script_callable *callable,
+                                           int index, const char *string,
+                                           void *object);
 extern void plugin_script_auto_load (struct t_weechat_plugin *weechat_plugin,
                                      void (*callback)(void *data,
                                                       const char *filename));
@@ -77,6 +77,20 @@ PyThreadState *python_current_interpreter = NULL;
 char *python2_bin = NULL;
 char **python_buffer_output = NULL;
 
+/*
+ * calls of python functions running (the last one is the most recent):
+ * references taken by a call are released by the unload of its script
+ * if the script is unloaded during the call
+ */
+struct t_python_exec_call
+{
+    struct t_plugin_script *script;    /* script of function called         */
+    PyObject *function;                /* function (reference taken)        */
+    PyObject *args;                    /* tuple with arguments (or NULL)    */
+    struct t_python_exec_call *prev_call; /* link to previous call          */
+};
+struct t_python_exec_call *python_exec_calls = NULL;
+
 /* outputs subroutines */
 static PyObject *weechat_python_output (PyObject *self, PyObject *args);
 static PyMethodDef weechat_python_output_funcs[] = {
@@ -428,8 +442,175 @@ weechat_python_output (PyObject *self, PyObject *args)
     return Py_None;
 }
 
+/*
+ * Releases a python object kept in a callable (callback called by
+ * plugin-script functions).
+ */
+
+void
+weechat_python_callable_free_cb (struct t_plugin_script_callable *callable,
+                                 void *object)
+{
+    PyThreadState *old_interpreter;
+
+    if (callable->script->interpreter)
+    {
+        old_interpreter = PyThreadState_Swap (callable->script->interpreter);
+        Py_XDECREF((PyObject *)object);
+        PyThreadState_Swap (old_interpreter);
+    }
+    else
+    {
+        Py_XDECREF((PyObject *)object);
+    }
+}
+
+/*
+ * Resolves the function of a callable in the module "__main__" of script.
+ *
+ * The function is searched by name only on first call (or if the function
+ * has been redefined in script): next calls just check that the name is still
+ * bound to the same object, with an interned string (so hash is not computed
+ * again).
+ *
+ * Returns the function (borrowed reference), NULL if not found or not
+ * callable.
+ */
+
+PyObject *
+weechat_python_callable_resolve (struct t_plugin_script_callable *callable,
+                                 const char *function)
+{
+    PyObject *evMain, *evDict, *evFunc;
+
+    if (callable->function)
+    {
+        evFunc = PyDict_GetItem ((PyObject *)callable->scope,
+                                 (PyObject *)callable->function_name);
+        if (evFunc == (PyObject *)callable->function)
+            return evFunc;
+        /* function redefined (or removed): release all cached objects */
+        plugin_script_callable_reset (callable);
+    }
+
+    if (!callable->scope)
+    {
+        evMain = PyImport_AddModule ((char *) "__main__");
+        evDict = (evMain) ? PyModule_GetDict (evMain) : NULL;
+        if (!evDict)
+            return NULL;
+        Py_INCREF(evDict);
+        callable->scope = evDict;
+    }
+
+    if (!callable->function_name)
+    {
+#if PY_MAJOR_VERSION >= 3
+        callable->function_name = PyUnicode_InternFromString (function);
+#else
+        callable->function_name = PyString_InternFromString (function);
+#endif /* PY_MAJOR_VERSION >= 3 */
+        if (!callable->function_name)
+        {
+            PyErr_Clear ();
+            return NULL;
+        }
+    }
+
+    evFunc = PyDict_GetItem ((PyObject *)callable->scope,
+                             (PyObject *)callable->function_name);
+    if (!evFunc || !PyCallable_Check (evFunc))
+        return NULL;
+
+    Py_INCREF(evFunc);
+    callable->function = evFunc;
+
+    return evFunc;
+}
+
+/*
+ * Builds a python object for an argument of a function.
+ *
+ * Arguments with format "s" (string) are cached in callable: pointers (as
+ * strings) and data of callback are often the same from one call to another,
+ * so the same python string is used for them.
+ *
+ * Returns a new reference, NULL if error.
+ */
+
+PyObject *
+weechat_python_callable_arg (struct t_plugin_script_callable *callable,
+                             int index, char format, void *arg)
+{
+    PyObject *object;
+
+    if (format == 'O')
+    {
+        object = (arg) ? (PyObject *)arg : Py_None;
+        Py_INCREF(object);
+        return object;
+    }
+
+    if (!arg)
+    {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    object = plugin_script_callable_arg_get (callable, index,
+                                             (const char *)arg);
+    if (object)
+    {
+        Py_INCREF(object);
+        return object;
+    }
+
+#if PY_MAJOR_VERSION >= 3
+    object = PyUnicode_FromString ((const char *)arg);
+#else
+    object = PyString_FromString ((const char *)arg);
+#endif /* PY_MAJOR_VERSION >= 3 */
+    if (object
+        && plugin_script_callable_arg_set (callable, index,
+                                           (const char *)arg, object))
+    {
+        /* reference kept by the cache */
+        Py_INCREF(object);
+    }
+
+    return object;
+}
+
+/*
+ * Releases references taken by calls of python functions running in a script
+ * (called when the script is unloaded by one of its functions).
+ *
+ * The interpreter of script must be the current one.
+ */
+
+void
+weechat_python_exec_calls_release (struct t_plugin_script *script)
+{
+    struct t_python_exec_call *ptr_call;
+
+    for (ptr_call = python_exec_calls; ptr_call;
+         ptr_call = ptr_call->prev_call)
+    {
+        if (ptr_call->script != script)
+            continue;
+        Py_XDECREF(ptr_call->args);
+        ptr_call->args = NULL;
+        Py_XDECREF(ptr_call->function);
+        ptr_call->function = NULL;
+    }
+}
+
 /*
  * Executes a python function.
+ *
+ * The function and arguments are kept in a callable, so that the function is
+ * not searched by name on each call, and the tuple with arguments is reused
+ * (if the function did not keep a reference on it).
  */
 
 void *
@@ -438,9 +619,11 @@ weechat_python_exec (struct t_plugin_script *script,
                      char *format, void **argv)
 {
     struct t_plugin_script *old_python_current_script;
+    struct t_plugin_script_callable *callable;
+    struct t_python_exec_call exec_call;
     PyThreadState *old_interpreter;
-    PyObject *evMain, *evDict, *evFunc, *rc;
-    void *argv2[16], *ret_value, *ret_temp;
+    PyObject *evFunc, *args, *arg, *old_arg, *rc;
+    void *ret_value, *ret_temp;
     int i, argc, *ret_int;
 
     ret_value = NULL;
@@ -456,11 +639,13 @@ weechat_python_exec (struct t_plugin_script *script,
         PyThreadState_Swap (script->interpreter);
     }
 
-    evMain = PyImport_AddModule ((char *) "__main__");
-    evDict = PyModule_GetDict (evMain);
-    evFunc = PyDict_GetItemString (evDict, function);
+    callable = plugin_script_callable_get (weechat_python_plugin, script,
+                                           function,
+                                           &weechat_python_callable_free_cb);
+    evFunc = (callable) ?
+        weechat_python_callable_resolve (callable, function) : NULL;
 
-    if ( !(evFunc && PyCallable_Check (evFunc)) )
+    if (!evFunc)
     {
         weechat_printf (NULL,
                         weechat_gettext ("%s%s: unable to run function \"%s\""),
@@ -469,27 +654,89 @@ weechat_python_exec (struct t_plugin_script *script,
         goto end;
     }
 
+    /* keep the function alive if it is redefined during the call */
+    Py_INCREF(evFunc);
+    exec_call.script = script;
+    exec_call.function = evFunc;
+    exec_call.args = NULL;
+    exec_call.prev_call = python_exec_calls;
+    python_exec_calls = &exec_call;
+
+    argc = 0;
     if (argv && argv[0])
     {
         argc = strlen (format);
-        for (i = 0; i < 16; i++)
+        if (argc > WEECHAT_SCRIPT_CALLABLE_MAX_ARGS)
+            argc = WEECHAT_SCRIPT_CALLABLE_MAX_ARGS;
+    }
+
+    rc = NULL;
+    args = NULL;
+    if (argc > 0)
+    {
+        /* take the prebuilt tuple (a nested call will build another one) */
+        args = (PyObject *)callable->args;
+        callable->args = NULL;
+        if (args && (PyTuple_GET_SIZE(args) != argc))
         {
-            argv2[i] = (i < argc) ? argv[i] : NULL;
+            Py_DECREF(args);
+            args = NULL;
+        }
+        if (!args)
+            args = PyTuple_New (argc);
+        exec_call.args = args;
+        if (args)
+        {
+            for (i = 0; i < argc; i++)
+            {
+                arg = weechat_python_callable_arg (callable, i, format[i],
+                                                   argv[i]);
+                if (!arg)
+                    break;
+                old_arg = PyTuple_GET_ITEM(args, i);
+                PyTuple_SET_ITEM(args, i, arg);
+                Py_XDECREF(old_arg);
+            }
+            if (i == argc)
+                rc = PyObject_Call (evFunc, args, NULL);
         }
-        rc = PyObject_CallFunction (evFunc, format,
-                                    argv2[0], argv2[1],
-                                    argv2[2], argv2[3],
-                                    argv2[4], argv2[5],
-                                    argv2[6], argv2[7],
-                                    argv2[8], argv2[9],
-                                    argv2[10], argv2[11],
-                                    argv2[12], argv2[13],
-                                    argv2[14], argv2[15]);
     }
     else
     {
-        rc = PyObject_CallFunction (evFunc, NULL);
+        rc = PyObject_CallObject (evFunc, NULL);
+    }
+
+    python_exec_calls = exec_call.prev_call;
+
+    /*
+     * if the script has been unloaded by the function itself, the references
+     * have already been released by weechat_python_unload (with interpreter
+     * of script still alive) and exec_call.function/args are NULL
+     */
+    args = exec_call.args;
+    if (args)
+    {
+        /*
+         * keep the tuple for next call if nobody else has a reference
+         * on it (arguments are released now)
+         */
+        if ((Py_REFCNT(args) == 1) && !callable->args)
+        {
+            for (i = 0; i < argc; i++)
+            {
+                old_arg = PyTuple_GET_ITEM(args, i);
+                Py_INCREF(Py_None);
+                PyTuple_SET_ITEM(args, i, Py_None);
+                Py_XDECREF(old_arg);
+            }
+            callable->args = args;
+        }
+        else
+        {
+            Py_DECREF(args);
+        }
     }
+    Py_XDECREF(exec_call.function);
 
     weechat_python_output_flush ();
 
@@ -987,6 +1234,10 @@ weechat_python_unload (struct t_plugin_script *script)
             python_current_script->prev_script : python_current_script->next_script;
     }
 
+    if (interpreter)
+        PyThreadState_Swap (interpreter);
+    weechat_python_exec_calls_release (script);
+
     plugin_script_remove (weechat_python_plugin, &python_scripts, &last_python_script,
                           script);
 
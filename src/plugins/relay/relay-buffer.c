@@ -45,7 +45,8 @@ relay_buffer_refresh (const char *hotlist)
 {
     struct t_relay_client *ptr_client, *client_selected;
     char str_color[256], str_status[64], str_date_start[128], str_date_end[128];
-    char *str_recv, *str_sent;
+    char str_queue[256], str_line[1024];
+    char *str_recv, *str_sent, *str_queue_bytes, *str_drain_rate;
     int i, length, line;
     struct tm *date_tmp;
 
@@ -129,13 +130,35 @@ relay_buffer_refresh (const char *hotlist)
                               (str_recv) ? str_recv : "?",
                               (str_sent) ? str_sent : "?");
 
-            /* second line with start/end time */
+            /* out queue: number of messages/bytes and drain rate */
+            str_queue[0] = '\0';
+            if ((ptr_client->outqueue_count > 0)
+                || (ptr_client->outqueue_drain_rate > 0))
+            {
+                str_queue_bytes = weechat_string_format_size (
+                    ptr_client->outqueue_bytes);
+                str_drain_rate = weechat_string_format_size (
+                    ptr_client->outqueue_drain_rate);
+                snprintf (str_queue, sizeof (str_queue),
+                          _(", queue: %d messages (%s), drain: %s/s"),
+                          ptr_client->outqueue_count,
+                          (str_queue_bytes) ? str_queue_bytes : "?",
+                          (str_drain_rate) ? str_drain_rate : "?");
+                if (str_queue_bytes)
+                    free (str_queue_bytes);
+                if (str_drain_rate)
+                    free (str_drain_rate);
+            }
+
+            /* second line with start/end time and out queue */
+            snprintf (str_line, sizeof (str_line),
+                      _("%s%-26s started on: %s, ended on: %s"),
+                      weechat_color (str_color),
+                      " ",
+                      str_date_start,
+                      str_date_end);
             weechat_printf_y (relay_buffer, (line * 2) + 3,
-                              _("%s%-26s started on: %s, ended on: %s"),
-                              weechat_color (str_color),
-                              " ",
-                              str_date_start,
-                              str_date_end);
+                              "%s%s", str_line, str_queue);
 
             if (str_recv)
                 free (str_recv);
@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #ifdef HAVE_GNUTLS
 #include <gnutls/gnutls.h>
@@ -549,6 +550,10 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
 
     client = (struct t_relay_client *)pointer;
 
+    /* socket is writable: send messages waiting in out queue */
+    if (client->outqueue)
+        relay_client_outqueue_send (client);
+
     if (client->status != RELAY_STATUS_CONNECTED)
         return WEECHAT_RC_OK;
 
@@ -688,8 +693,25 @@ relay_client_recv_cb (const void *pointer, void *data, int fd)
     return WEECHAT_RC_OK;
 }
 
+/*
+ * Enables or disables the watch of socket for write.
+ */
+
+void
+relay_client_set_write (struct t_relay_client *client, int enable)
+{
+    if (!client->hook_fd || (client->hook_fd_write == enable))
+        return;
+
+    weechat_hook_set (client->hook_fd, "flag_write", (enable) ? "1" : "0");
+    client->hook_fd_write = enable;
+}
+
 /*
  * Adds a message in out queue.
+ *
+ * The socket is watched for write while the out queue is not empty, so that
+ * messages are sent as soon as the socket can accept more data.
  */
 
 void
@@ -744,6 +766,11 @@ relay_client_outqueue_add (struct t_relay_client *client,
         else
             client->outqueue = new_outqueue;
         client->last_outqueue = new_outqueue;
+
+        client->outqueue_count++;
+        client->outqueue_bytes += data_size;
+
+        relay_client_set_write (client, 1);
     }
 }
 
@@ -774,6 +801,9 @@ relay_client_outqueue_free (struct t_relay_client *client,
     if (outqueue->next_outqueue)
         (outqueue->next_outqueue)->prev_outqueue = outqueue->prev_outqueue;
 
+    client->outqueue_count--;
+    client->outqueue_bytes -= outqueue->data_size;
+
     /* free data */
     if (outqueue->data)
         free (outqueue->data);
@@ -798,6 +828,227 @@ relay_client_outqueue_free_all (struct t_relay_client *client)
     {
         relay_client_outqueue_free (client, client->outqueue);
     }
+#ifdef HAVE_GNUTLS
+    client->outqueue_pending = NULL;
+    client->outqueue_pending_size = 0;
+#endif /* HAVE_GNUTLS */
+}
+
+/*
+ * Removes data sent from out queue: messages fully sent are removed and the
+ * first message not fully sent is truncated.
+ *
+ * Raw messages are displayed as soon as some bytes of message are sent (so
+ * that they are displayed only one time, even if message is sent in many
+ * chunks).
+ */
+
+void
+relay_client_outqueue_remove_sent (struct t_relay_client *client,
+                                   int num_sent)
+{
+    struct t_relay_client_outqueue *ptr_outqueue;
+    int i;
+
+    while (client->outqueue && (num_sent > 0))
+    {
+        ptr_outqueue = client->outqueue;
+        for (i = 0; i < 2; i++)
+        {
+            if (ptr_outqueue->raw_message[i])
+            {
+                relay_raw_print (client,
+                                 ptr_outqueue->raw_msg_type[i],
+                                 ptr_outqueue->raw_flags[i],
+                                 ptr_outqueue->raw_message[i],
+                                 ptr_outqueue->raw_size[i]);
+                ptr_outqueue->raw_flags[i] = 0;
+                free (ptr_outqueue->raw_message[i]);
+                ptr_outqueue->raw_message[i] = NULL;
+                ptr_outqueue->raw_size[i] = 0;
+            }
+        }
+        if (num_sent >= ptr_outqueue->data_size)
+        {
+            /* whole message sent, remove it from outqueue */
+            num_sent -= ptr_outqueue->data_size;
+            relay_client_outqueue_free (client, ptr_outqueue);
+        }
+        else
+        {
+            /* message partially sent, keep only data not sent */
+            memmove (ptr_outqueue->data, ptr_outqueue->data + num_sent,
+                     ptr_outqueue->data_size - num_sent);
+            ptr_outqueue->data_size -= num_sent;
+            client->outqueue_bytes -= num_sent;
+            num_sent = 0;
+        }
+    }
+}
+
+/*
+ * Sends messages of out queue to client.
+ *
+ * Messages are sent by batches: without SSL, many messages are sent with a
+ * single call to writev; with SSL, small messages are merged in a single TLS
+ * record.
+ *
+ * This function is called when the socket is writable (write is watched
+ * while the out queue is not empty), and each second by the timer (as a
+ * fallback).
+ */
+
+void
+relay_client_outqueue_send (struct t_relay_client *client)
+{
+    struct t_relay_client_outqueue *ptr_outqueue;
+    struct iovec iov[RELAY_CLIENT_OUTQUEUE_MAX_IOV];
+    int num_sent, count, size, total_sent;
+#ifdef HAVE_GNUTLS
+    const char *ptr_data;
+#endif /* HAVE_GNUTLS */
+
+    if (!client || (client->sock < 0))
+        return;
+
+    total_sent = 0;
+
+    while (client->outqueue)
+    {
+#ifdef HAVE_GNUTLS
+        if (client->ssl)
+        {
+            if (client->outqueue_pending)
+            {
+                /* previous TLS record was interrupted: send same data */
+                ptr_data = client->outqueue_pending;
+                size = client->outqueue_pending_size;
+            }
+            else
+            {
+                ptr_data = client->outqueue->data;
+                size = client->outqueue->data_size;
+                if (client->outqueue->next_outqueue
+                    && (size + client->outqueue->next_outqueue->data_size <=
+                        RELAY_CLIENT_OUTQUEUE_BATCH_SIZE))
+                {
+                    /* merge small messages in a single TLS record */
+                    if (!client->outqueue_batch)
+                        client->outqueue_batch = malloc (RELAY_CLIENT_OUTQUEUE_BATCH_SIZE);
+                    if (client->outqueue_batch)
+                    {
+                        size = 0;
+                        for (ptr_outqueue = client->outqueue; ptr_outqueue;
+                             ptr_outqueue = ptr_outqueue->next_outqueue)
+                        {
+                            if (size + ptr_outqueue->data_size > RELAY_CLIENT_OUTQUEUE_BATCH_SIZE)
+                                break;
+                            memcpy (client->outqueue_batch + size,
+                                    ptr_outqueue->data,
+                                    ptr_outqueue->data_size);
+                            size += ptr_outqueue->data_size;
+                        }
+                        ptr_data = client->outqueue_batch;
+                    }
+                }
+            }
+            num_sent = gnutls_record_send (client->gnutls_sess,
+                                           ptr_data, size);
+            if ((num_sent == GNUTLS_E_AGAIN)
+                || (num_sent == GNUTLS_E_INTERRUPTED))
+            {
+                client->outqueue_pending = ptr_data;
+                client->outqueue_pending_size = size;
+            }
+            else
+            {
+                client->outqueue_pending = NULL;
+                client->outqueue_pending_size = 0;
+            }
+        }
+        else
+#endif /* HAVE_GNUTLS */
+        {
+            count = 0;
+            size = 0;
+            for (ptr_outqueue = client->outqueue;
+                 ptr_outqueue && (count < RELAY_CLIENT_OUTQUEUE_MAX_IOV);
+                 ptr_outqueue = ptr_outqueue->next_outqueue)
+            {
+                iov[count].iov_base = ptr_outqueue->data;
+                iov[count].iov_len = ptr_outqueue->data_size;
+                size += ptr_outqueue->data_size;
+                count++;
+            }
+            num_sent = writev (client->sock, iov, count);
+        }
+        if (num_sent >= 0)
+        {
+            if (num_sent > 0)
+            {
+                client->bytes_sent += num_sent;
+                client->outqueue_bytes_drained += num_sent;
+                total_sent += num_sent;
+            }
+            relay_client_outqueue_remove_sent (client, num_sent);
+            /*
+             * with SSL, a partial send is normal (data is sent by records of
+             * at most 16 KB), but without SSL it means that the socket is
+             * full: we will retry when it is writable
+             */
+            if ((num_sent == 0) || ((num_sent < size) && !client->ssl))
+                break;
+        }
+        else
+        {
+#ifdef HAVE_GNUTLS
+            if (client->ssl)
+            {
+                if ((num_sent == GNUTLS_E_AGAIN)
+                    || (num_sent == GNUTLS_E_INTERRUPTED))
+                {
+                    /* we will retry later this client's queue */
+                    break;
+                }
+                weechat_printf_date_tags (
+                    NULL, 0, "relay_client",
+                    _("%s%s: sending data to client %s%s%s: error %d %s"),
+                    weechat_prefix ("error"),
+                    RELAY_PLUGIN_NAME,
+                    RELAY_COLOR_CHAT_CLIENT,
+                    client->desc,
+                    RELAY_COLOR_CHAT,
+                    num_sent,
+                    gnutls_strerror (num_sent));
+            }
+            else
+#endif /* HAVE_GNUTLS */
+            {
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                {
+                    /* we will retry later this client's queue */
+                    break;
+                }
+                weechat_printf_date_tags (
+                    NULL, 0, "relay_client",
+                    _("%s%s: sending data to client %s%s%s: error %d %s"),
+                    weechat_prefix ("error"),
+                    RELAY_PLUGIN_NAME,
+                    RELAY_COLOR_CHAT_CLIENT,
+                    client->desc,
+                    RELAY_COLOR_CHAT,
+                    errno,
+                    strerror (errno));
+            }
+            relay_client_set_status (client, RELAY_STATUS_DISCONNECTED);
+            return;
+        }
+    }
+
+    relay_client_set_write (client, (client->outqueue) ? 1 : 0);
+
+    if (total_sent > 0)
+        relay_buffer_refresh (NULL);
 }
 
 /*
@@ -1020,8 +1271,7 @@ int
 relay_client_timer_cb (const void *pointer, void *data, int remaining_calls)
 {
     struct t_relay_client *ptr_client, *ptr_next_client;
-    int num_sent, i, purge_delay;
-    char *buf;
+    int purge_delay, refresh;
     time_t current_time;
 
     /* make C compiler happy */
@@ -1033,6 +1283,8 @@ relay_client_timer_cb (const void *pointer, void *data, int remaining_calls)
 
     current_time = time (NULL);
 
+    refresh = 0;
+
     ptr_client = relay_clients;
     while (ptr_client)
     {
@@ -1047,140 +1299,31 @@ relay_client_timer_cb (const void *pointer, void *data, int remaining_calls)
                 relay_buffer_refresh (NULL);
             }
         }
-        else if (ptr_client->sock >= 0)
+        else
         {
-            while (ptr_client->outqueue)
+            /* drain rate of out queue during last second */
+            if ((ptr_client->outqueue_drain_rate != ptr_client->outqueue_bytes_drained)
+                || ptr_client->outqueue)
             {
-#ifdef HAVE_GNUTLS
-                if (ptr_client->ssl)
-                {
-                    num_sent = gnutls_record_send (ptr_client->gnutls_sess,
-                                                   ptr_client->outqueue->data,
-                                                   ptr_client->outqueue->data_size);
-                }
-                else
-#endif /* HAVE_GNUTLS */
-                {
-                    num_sent = send (ptr_client->sock,
-                                     ptr_client->outqueue->data,
-                                     ptr_client->outqueue->data_size, 0);
-                }
-                if (num_sent >= 0)
-                {
-                    for (i = 0; i < 2; i++)
-                    {
-                        if (ptr_client->outqueue->raw_message[i])
-                        {
-                            /*
-                             * print raw message and remove it from outqueue
-                             * (so that it is displayed only one time, even if
-                             * message is sent in many chunks)
-                             */
-                            relay_raw_print (
-                                ptr_client,
-                                ptr_client->outqueue->raw_msg_type[i],
-                                ptr_client->outqueue->raw_flags[i],
-                                ptr_client->outqueue->raw_message[i],
-                                ptr_client->outqueue->raw_size[i]);
-                            ptr_client->outqueue->raw_flags[i] = 0;
-                            free (ptr_client->outqueue->raw_message[i]);
-                            ptr_client->outqueue->raw_message[i] = NULL;
-                            ptr_client->outqueue->raw_size[i] = 0;
-                        }
-                    }
-                    if (num_sent > 0)
-                    {
-                        ptr_client->bytes_sent += num_sent;
-                        relay_buffer_refresh (NULL);
-                    }
-                    if (num_sent == ptr_client->outqueue->data_size)
-                    {
-                        /* whole data sent, remove outqueue */
-                        relay_client_outqueue_free (ptr_client,
-                                                    ptr_client->outqueue);
-                    }
-                    else
-                    {
-                        /*
-                         * some data was not sent, update outqueue and stop
-                         * sending data from outqueue
-                         */
-                        if (num_sent > 0)
-                        {
-                            buf = malloc (ptr_client->outqueue->data_size - num_sent);
-                            if (buf)
-                            {
-                                memcpy (buf,
-                                        ptr_client->outqueue->data + num_sent,
-                                        ptr_client->outqueue->data_size - num_sent);
-                                free (ptr_client->outqueue->data);
-                                ptr_client->outqueue->data = buf;
-                                ptr_client->outqueue->data_size = ptr_client->outqueue->data_size - num_sent;
-                            }
-                        }
-                        break;
-                    }
-                }
-                else if (num_sent < 0)
-                {
-#ifdef HAVE_GNUTLS
-                    if (ptr_client->ssl)
-                    {
-                        if ((num_sent == GNUTLS_E_AGAIN)
-                            || (num_sent == GNUTLS_E_INTERRUPTED))
-                        {
-                            /* we will retry later this client's queue */
-                            break;
-                        }
-                        else
-                        {
-                            weechat_printf_date_tags (
-                                NULL, 0, "relay_client",
-                                _("%s%s: sending data to client %s%s%s: "
-                                  "error %d %s"),
-                                weechat_prefix ("error"),
-                                RELAY_PLUGIN_NAME,
-                                RELAY_COLOR_CHAT_CLIENT,
-                                ptr_client->desc,
-                                RELAY_COLOR_CHAT,
-                                num_sent,
-                                gnutls_strerror (num_sent));
-                            relay_client_set_status (ptr_client,
-                                                     RELAY_STATUS_DISCONNECTED);
-                        }
-                    }
-                    else
-#endif /* HAVE_GNUTLS */
-                    {
-                        if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-                        {
-                            /* we will retry later this client's queue */
-                            break;
-                        }
-                        else
-                        {
-                            weechat_printf_date_tags (
-                                NULL, 0, "relay_client",
-                                _("%s%s: sending data to client %s%s%s: "
-                                  "error %d %s"),
-                                weechat_prefix ("error"),
-                                RELAY_PLUGIN_NAME,
-                                RELAY_COLOR_CHAT_CLIENT,
-                                ptr_client->desc,
-                                RELAY_COLOR_CHAT,
-                                errno,
-                                strerror (errno));
-                            relay_client_set_status (ptr_client,
-                                                     RELAY_STATUS_DISCONNECTED);
-                        }
-                    }
-                }
+                refresh = 1;
             }
+            ptr_client->outqueue_drain_rate = ptr_client->outqueue_bytes_drained;
+            ptr_client->outqueue_bytes_drained = 0;
+
+            /*
+             * send out queue (it is normally sent as soon as the socket is
+             * writable, this is a fallback)
+             */
+            if ((ptr_client->sock >= 0) && ptr_client->outqueue)
+                relay_client_outqueue_send (ptr_client);
         }
 
         ptr_client = ptr_next_client;
     }
 
+    if (refresh)
+        relay_buffer_refresh (NULL);
+
     return WEECHAT_RC_OK;
 }
 
@@ -1222,6 +1365,7 @@ relay_client_new (int sock, const char *address, struct t_relay_server *server)
         new_client->start_time = time (NULL);
         new_client->end_time = 0;
         new_client->hook_fd = NULL;
+        new_client->hook_fd_write = 0;
         new_client->last_activity = new_client->start_time;
         new_client->bytes_recv = 0;
         new_client->bytes_sent = 0;
@@ -1312,6 +1456,15 @@ relay_client_new (int sock, const char *address, struct t_relay_server *server)
 
         new_client->outqueue = NULL;
         new_client->last_outqueue = NULL;
+        new_client->outqueue_count = 0;
+        new_client->outqueue_bytes = 0;
+        new_client->outqueue_bytes_drained = 0;
+        new_client->outqueue_drain_rate = 0;
+#ifdef HAVE_GNUTLS
+        new_client->outqueue_batch = NULL;
+        new_client->outqueue_pending = NULL;
+        new_client->outqueue_pending_size = 0;
+#endif /* HAVE_GNUTLS */
 
         new_client->prev_client = NULL;
         new_client->next_client = relay_clients;
@@ -1403,6 +1556,7 @@ relay_client_new_with_infolist (struct t_infolist *infolist)
         }
         else
             new_client->hook_fd = NULL;
+        new_client->hook_fd_write = 0;
         new_client->last_activity = weechat_infolist_time (infolist, "last_activity");
         sscanf (weechat_infolist_string (infolist, "bytes_recv"),
                 "%llu", &(new_client->bytes_recv));
@@ -1435,6 +1589,15 @@ relay_client_new_with_infolist (struct t_infolist *infolist)
 
         new_client->outqueue = NULL;
         new_client->last_outqueue = NULL;
+        new_client->outqueue_count = 0;
+        new_client->outqueue_bytes = 0;
+        new_client->outqueue_bytes_drained = 0;
+        new_client->outqueue_drain_rate = 0;
+#ifdef HAVE_GNUTLS
+        new_client->outqueue_batch = NULL;
+        new_client->outqueue_pending = NULL;
+        new_client->outqueue_pending_size = 0;
+#endif /* HAVE_GNUTLS */
 
         new_client->prev_client = NULL;
         new_client->next_client = relay_clients;
@@ -1485,6 +1648,7 @@ relay_client_set_status (struct t_relay_client *client,
             weechat_unhook (client->hook_fd);
             client->hook_fd = NULL;
         }
+        client->hook_fd_write = 0;
         switch (client->protocol)
         {
             case RELAY_PROTOCOL_WEECHAT:
@@ -1600,6 +1764,10 @@ relay_client_free (struct t_relay_client *client)
         }
     }
     relay_client_outqueue_free_all (client);
+#ifdef HAVE_GNUTLS
+    if (client->outqueue_batch)
+        free (client->outqueue_batch);
+#endif /* HAVE_GNUTLS */
 
     free (client);
 
@@ -1717,6 +1885,8 @@ relay_client_add_to_infolist (struct t_infolist *infolist,
         return 0;
     if (!weechat_infolist_new_var_pointer (ptr_item, "hook_fd", client->hook_fd))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "hook_fd_write", client->hook_fd_write))
+        return 0;
     if (!weechat_infolist_new_var_time (ptr_item, "last_activity", client->last_activity))
         return 0;
     snprintf (value, sizeof (value), "%llu", client->bytes_recv);
@@ -1731,6 +1901,14 @@ relay_client_add_to_infolist (struct t_infolist *infolist,
         return 0;
     if (!weechat_infolist_new_var_string (ptr_item, "partial_message", client->partial_message))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "outqueue_count", client->outqueue_count))
+        return 0;
+    snprintf (value, sizeof (value), "%llu", client->outqueue_bytes);
+    if (!weechat_infolist_new_var_string (ptr_item, "outqueue_bytes", value))
+        return 0;
+    snprintf (value, sizeof (value), "%llu", client->outqueue_drain_rate);
+    if (!weechat_infolist_new_var_string (ptr_item, "outqueue_drain_rate", value))
+        return 0;
 
     switch (client->protocol)
     {
@@ -1788,6 +1966,7 @@ relay_client_print_log ()
         weechat_log_printf ("  start_time. . . . . . : %lld",  (long long)ptr_client->start_time);
         weechat_log_printf ("  end_time. . . . . . . : %lld",  (long long)ptr_client->end_time);
         weechat_log_printf ("  hook_fd . . . . . . . : 0x%lx", ptr_client->hook_fd);
+        weechat_log_printf ("  hook_fd_write . . . . : %d",   ptr_client->hook_fd_write);
         weechat_log_printf ("  last_activity . . . . : %lld",  (long long)ptr_client->last_activity);
         weechat_log_printf ("  bytes_recv. . . . . . : %llu",  ptr_client->bytes_recv);
         weechat_log_printf ("  bytes_sent. . . . . . : %llu",  ptr_client->bytes_sent);
@@ -1812,6 +1991,15 @@ relay_client_print_log ()
         }
         weechat_log_printf ("  outqueue. . . . . . . : 0x%lx", ptr_client->outqueue);
         weechat_log_printf ("  last_outqueue . . . . : 0x%lx", ptr_client->last_outqueue);
+        weechat_log_printf ("  outqueue_count. . . . : %d",   ptr_client->outqueue_count);
+        weechat_log_printf ("  outqueue_bytes. . . . : %llu", ptr_client->outqueue_bytes);
+        weechat_log_printf ("  outqueue_bytes_drained: %llu", ptr_client->outqueue_bytes_drained);
+        weechat_log_printf ("  outqueue_drain_rate . : %llu", ptr_client->outqueue_drain_rate);
+#ifdef HAVE_GNUTLS
+        weechat_log_printf ("  outqueue_batch. . . . : 0x%lx", ptr_client->outqueue_batch);
+        weechat_log_printf ("  outqueue_pending. . . : 0x%lx", ptr_client->outqueue_pending);
+        weechat_log_printf ("  outqueue_pending_size : %d",   ptr_client->outqueue_pending_size);
+#endif /* HAVE_GNUTLS */
         weechat_log_printf ("  prev_client . . . . . : 0x%lx", ptr_client->prev_client);
         weechat_log_printf ("  next_client . . . . . : 0x%lx", ptr_client->next_client);
     }
@@ -68,6 +68,12 @@ enum t_relay_client_msg_type
     ((client->status == RELAY_STATUS_AUTH_FAILED) ||                    \
      (client->status == RELAY_STATUS_DISCONNECTED))
 
+/* max number of messages of out queue sent with a single writev */
+#define RELAY_CLIENT_OUTQUEUE_MAX_IOV   64
+
+/* max size of messages of out queue merged in a single TLS record */
+#define RELAY_CLIENT_OUTQUEUE_BATCH_SIZE 16384
+
 /* output queue of messages to client */
 
 struct t_relay_client_outqueue
@@ -108,6 +114,7 @@ struct t_relay_client
     time_t start_time;                 /* time of client connection         */
     time_t end_time;                   /* time of client disconnection      */
     struct t_hook *hook_fd;            /* hook for socket or child pipe     */
+    int hook_fd_write;                 /* 1 if hook_fd waits for write      */
     time_t last_activity;              /* time of last byte received/sent   */
     unsigned long long bytes_recv;     /* bytes received from client        */
     unsigned long long bytes_sent;     /* bytes sent to client              */
@@ -117,6 +124,19 @@ struct t_relay_client
     void *protocol_data;               /* data depending on protocol used   */
     struct t_relay_client_outqueue *outqueue; /* queue for outgoing msgs    */
     struct t_relay_client_outqueue *last_outqueue; /* last outgoing msg     */
+    int outqueue_count;                /* number of msgs in out queue       */
+    unsigned long long outqueue_bytes; /* bytes waiting in out queue        */
+    unsigned long long outqueue_bytes_drained; /* bytes sent from out queue */
+                                       /* during current second             */
+    unsigned long long outqueue_drain_rate; /* bytes sent from out queue    */
+                                       /* during last second (bytes/sec)    */
+#ifdef HAVE_GNUTLS
+    char *outqueue_batch;              /* msgs merged in one TLS record     */
+    const char *outqueue_pending;      /* data to send again (TLS record    */
+                                       /* interrupted, it must be resent    */
+                                       /* with exactly same data)           */
+    int outqueue_pending_size;         /* size of data to send again        */
+#endif /* HAVE_GNUTLS */
     struct t_relay_client *prev_client;/* link to previous client           */
     struct t_relay_client *next_client;/* link to next client               */
 };
@@ -134,6 +154,7 @@ extern int relay_client_status_search (const char *name);
 extern int relay_client_count_active_by_port (int server_port);
 extern void relay_client_set_desc (struct t_relay_client *client);
 extern int relay_client_recv_cb (const void *pointer, void *data, int fd);
+extern void relay_client_outqueue_send (struct t_relay_client *client);
 extern int relay_client_send (struct t_relay_client *client,
                               enum t_relay_client_msg_type msg_type,
                               const char *data,
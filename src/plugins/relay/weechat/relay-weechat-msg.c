@@ -65,6 +65,10 @@ relay_weechat_msg_new (const char *id)
     }
     new_msg->data_alloc = RELAY_WEECHAT_MSG_INITIAL_ALLOC;
     new_msg->data_size = 0;
+    new_msg->data_compressed = NULL;
+    new_msg->data_compressed_size = 0;
+    new_msg->compression_level = 0;
+    new_msg->compression_time = 0;
 
     /* add size and compression flag (they will be set later) */
     relay_weechat_msg_add_int (new_msg, 0);
@@ -76,6 +80,23 @@ relay_weechat_msg_new (const char *id)
     return new_msg;
 }
 
+/*
+ * Frees compressed message (called when message is changed).
+ */
+
+void
+relay_weechat_msg_reset_compressed (struct t_relay_weechat_msg *msg)
+{
+    if (msg->data_compressed)
+    {
+        free (msg->data_compressed);
+        msg->data_compressed = NULL;
+    }
+    msg->data_compressed_size = 0;
+    msg->compression_level = 0;
+    msg->compression_time = 0;
+}
+
 /*
  * Adds some bytes to a message.
  */
@@ -89,6 +110,9 @@ relay_weechat_msg_add_bytes (struct t_relay_weechat_msg *msg,
     if (!msg || !msg->data)
         return;
 
+    if (msg->compression_level > 0)
+        relay_weechat_msg_reset_compressed (msg);
+
     while (msg->data_size + size > msg->data_alloc)
     {
         msg->data_alloc *= 2;
@@ -119,6 +143,10 @@ relay_weechat_msg_set_bytes (struct t_relay_weechat_msg *msg,
     if (!msg || !msg->data || (position + size) > msg->data_size)
         return;
 
+    /* size and compression flag are not part of compressed data */
+    if ((msg->compression_level > 0) && (position + size > 5))
+        relay_weechat_msg_reset_compressed (msg);
+
     memcpy (msg->data + position, buffer, size);
 }
 
@@ -1010,8 +1038,68 @@ relay_weechat_msg_add_nicklist (struct t_relay_weechat_msg *msg,
     relay_weechat_msg_set_bytes (msg, pos_count, &count32, 4);
 }
 
+/*
+ * Compresses a message with zlib (if not already done with this level).
+ *
+ * The compressed message is kept in the message, so that a message sent to
+ * many clients is compressed only once.
+ *
+ * Returns:
+ *   1: compressed message is available (and smaller than message)
+ *   0: compression failed or compressed message is not smaller
+ */
+
+int
+relay_weechat_msg_compress (struct t_relay_weechat_msg *msg, int level)
+{
+    uint32_t size32;
+    int rc;
+    Bytef *dest;
+    uLongf dest_size;
+    struct timeval tv1, tv2;
+
+    if (!msg || !msg->data || (level <= 0))
+        return 0;
+
+    if (msg->compression_level == level)
+        return (msg->data_compressed) ? 1 : 0;
+
+    relay_weechat_msg_reset_compressed (msg);
+    msg->compression_level = level;
+
+    dest_size = compressBound (msg->data_size - 5);
+    dest = malloc (dest_size + 5);
+    if (!dest)
+        return 0;
+
+    gettimeofday (&tv1, NULL);
+    rc = compress2 (dest + 5, &dest_size,
+                    (Bytef *)(msg->data + 5), msg->data_size - 5,
+                    level);
+    gettimeofday (&tv2, NULL);
+    msg->compression_time = weechat_util_timeval_diff (&tv1, &tv2);
+    if ((rc != Z_OK) || ((int)dest_size + 5 >= msg->data_size))
+    {
+        free (dest);
+        return 0;
+    }
+
+    /* set size and compression flag */
+    size32 = htonl ((uint32_t)(dest_size + 5));
+    memcpy (dest, &size32, 4);
+    dest[4] = RELAY_WEECHAT_COMPRESSION_ZLIB;
+
+    msg->data_compressed = (char *)dest;
+    msg->data_compressed_size = dest_size + 5;
+
+    return 1;
+}
+
 /*
  * Sends a message.
+ *
+ * The message is not changed (except size and compression flag), so the same
+ * message can be sent to many clients: it is built and compressed only once.
  */
 
 void
@@ -1020,57 +1108,33 @@ relay_weechat_msg_send (struct t_relay_client *client,
 {
     uint32_t size32;
     char compression, raw_message[1024];
-    int rc;
-    Bytef *dest;
-    uLongf dest_size;
-    struct timeval tv1, tv2;
-    long long time_diff;
 
-    if (weechat_config_integer (relay_config_network_compression_level) > 0)
+    switch (RELAY_WEECHAT_DATA(client, compression))
     {
-        switch (RELAY_WEECHAT_DATA(client, compression))
-        {
-            case RELAY_WEECHAT_COMPRESSION_ZLIB:
-                dest_size = compressBound (msg->data_size - 5);
-                dest = malloc (dest_size + 5);
-                if (dest)
-                {
-                    gettimeofday (&tv1, NULL);
-                    rc = compress2 (dest + 5, &dest_size,
-                                    (Bytef *)(msg->data + 5), msg->data_size - 5,
-                                    weechat_config_integer (relay_config_network_compression_level));
-                    gettimeofday (&tv2, NULL);
-                    time_diff = weechat_util_timeval_diff (&tv1, &tv2);
-                    if ((rc == Z_OK) && ((int)dest_size + 5 < msg->data_size))
-                    {
-                        /* set size and compression flag */
-                        size32 = htonl ((uint32_t)(dest_size + 5));
-                        memcpy (dest, &size32, 4);
-                        dest[4] = RELAY_WEECHAT_COMPRESSION_ZLIB;
-
-                        /* display message in raw buffer */
-                        snprintf (raw_message, sizeof (raw_message),
-                                  "obj: %d/%d bytes (%d%%, %.2fms), id: %s",
-                                  (int)dest_size + 5,
-                                  msg->data_size,
-                                  100 - ((((int)dest_size + 5) * 100) / msg->data_size),
-                                  ((float)time_diff) / 1000,
-                                  msg->id);
-
-                        /* send compressed data */
-                        relay_client_send (client, RELAY_CLIENT_MSG_STANDARD,
-                                           (const char *)dest, dest_size + 5,
-                                           raw_message);
-
-                        free (dest);
-                        return;
-                    }
-                    free (dest);
-                }
-                break;
-            default:
-                break;
-        }
+        case RELAY_WEECHAT_COMPRESSION_ZLIB:
+            if (relay_weechat_msg_compress (
+                    msg,
+                    weechat_config_integer (relay_config_network_compression_level)))
+            {
+                /* display message in raw buffer */
+                snprintf (raw_message, sizeof (raw_message),
+                          "obj: %d/%d bytes (%d%%, %.2fms), id: %s",
+                          msg->data_compressed_size,
+                          msg->data_size,
+                          100 - ((msg->data_compressed_size * 100) / msg->data_size),
+                          ((float)msg->compression_time) / 1000,
+                          msg->id);
+
+                /* send compressed data */
+                relay_client_send (client, RELAY_CLIENT_MSG_STANDARD,
+                                   msg->data_compressed,
+                                   msg->data_compressed_size,
+                                   raw_message);
+                return;
+            }
+            break;
+        default:
+            break;
     }
 
     /* compression failed (or not asked), send uncompressed message */
@@ -1102,6 +1166,8 @@ relay_weechat_msg_free (struct t_relay_weechat_msg *msg)
         free (msg->id);
     if (msg->data)
         free (msg->data);
+    if (msg->data_compressed)
+        free (msg->data_compressed);
 
     free (msg);
 }
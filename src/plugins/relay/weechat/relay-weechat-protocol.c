@@ -457,6 +457,10 @@ RELAY_WEECHAT_PROTOCOL_CALLBACK(input)
 
 /*
  * Callback for signals "buffer_*".
+ *
+ * This callback is called once for all clients: the message is built and
+ * compressed only once, then sent to all clients synchronized with the
+ * buffer.
  */
 
 int
@@ -472,236 +476,65 @@ relay_weechat_protocol_signal_buffer_cb (const void *pointer, void *data,
     struct t_gui_buffer *ptr_buffer;
     struct t_relay_weechat_msg *msg;
     char cmd_hdata[64], str_signal[128];
+    const char *keys;
+    int flags, buffer_closing;
 
     /* make C compiler happy */
+    (void) pointer;
     (void) data;
     (void) type_data;
 
-    ptr_client = (struct t_relay_client *)pointer;
-    if (!ptr_client || !relay_client_valid (ptr_client))
+    if (!signal_data)
         return WEECHAT_RC_OK;
 
-    snprintf (str_signal, sizeof (str_signal), "_%s", signal);
+    ptr_buffer = (struct t_gui_buffer *)signal_data;
+    ptr_line_data = NULL;
+    flags = RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
+        RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER;
+    keys = NULL;
+    buffer_closing = 0;
 
     if (strcmp (signal, "buffer_opened") == 0)
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,short_name,"
-                                             "nicklist,title,local_variables,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        keys = "number,full_name,short_name,nicklist,title,local_variables,"
+            "prev_buffer,next_buffer";
     }
     else if (strcmp (signal, "buffer_type_changed") == 0)
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,type");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        keys = "number,full_name,type";
     }
-    else if (strcmp (signal, "buffer_moved") == 0)
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
-    }
-    else if ((strcmp (signal, "buffer_merged") == 0)
-             || (strcmp (signal, "buffer_unmerged") == 0))
-    {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
-    }
-    else if ((strcmp (signal, "buffer_hidden") == 0)
+    else if ((strcmp (signal, "buffer_moved") == 0)
+             || (strcmp (signal, "buffer_merged") == 0)
+             || (strcmp (signal, "buffer_unmerged") == 0)
+             || (strcmp (signal, "buffer_hidden") == 0)
              || (strcmp (signal, "buffer_unhidden") == 0))
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,"
-                                             "prev_buffer,next_buffer");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        keys = "number,full_name,prev_buffer,next_buffer";
     }
     else if (strcmp (signal, "buffer_renamed") == 0)
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,short_name,"
-                                             "local_variables");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        keys = "number,full_name,short_name,local_variables";
     }
     else if (strcmp (signal, "buffer_title_changed") == 0)
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,title");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        keys = "number,full_name,title";
     }
     else if (strncmp (signal, "buffer_localvar_", 16) == 0)
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
-
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name,local_variables");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        keys = "number,full_name,local_variables";
     }
     else if (strcmp (signal, "buffer_cleared") == 0)
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer || relay_weechat_is_relay_buffer (ptr_buffer))
+        if (relay_weechat_is_relay_buffer (ptr_buffer))
             return WEECHAT_RC_OK;
 
         /* send signal only if sync with flag "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        flags = RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER;
+        keys = "number,full_name";
     }
     else if (strcmp (signal, "buffer_line_added") == 0)
     {
         ptr_line = (struct t_gui_line *)signal_data;
-        if (!ptr_line)
-            return WEECHAT_RC_OK;
 
         ptr_hdata_line = weechat_hdata_get ("line");
         if (!ptr_hdata_line)
@@ -721,56 +554,71 @@ relay_weechat_protocol_signal_buffer_cb (const void *pointer, void *data,
             return WEECHAT_RC_OK;
 
         /* send signal only if sync with flag "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
-        {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
-            {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "line_data:0x%lx",
-                          (long unsigned int)ptr_line_data);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "buffer,date,date_printed,"
-                                             "displayed,highlight,tags_array,"
-                                             "prefix,message");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
-            }
-        }
+        flags = RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER;
+        keys = "buffer,date,date_printed,displayed,highlight,tags_array,"
+            "prefix,message";
     }
     else if (strcmp (signal, "buffer_closing") == 0)
     {
-        ptr_buffer = (struct t_gui_buffer *)signal_data;
-        if (!ptr_buffer)
-            return WEECHAT_RC_OK;
+        keys = "number,full_name";
+        buffer_closing = 1;
+    }
+
+    if (!keys)
+        return WEECHAT_RC_OK;
 
-        /* send signal only if sync with flag "buffers" or "buffer" */
-        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer,
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
-                                            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER))
+    snprintf (str_signal, sizeof (str_signal), "_%s", signal);
+    if (ptr_line_data)
+    {
+        snprintf (cmd_hdata, sizeof (cmd_hdata),
+                  "line_data:0x%lx", (long unsigned int)ptr_line_data);
+    }
+    else
+    {
+        snprintf (cmd_hdata, sizeof (cmd_hdata),
+                  "buffer:0x%lx", (long unsigned int)ptr_buffer);
+    }
+
+    /* message is built on first client synchronized with buffer */
+    msg = NULL;
+
+    for (ptr_client = relay_clients; ptr_client;
+         ptr_client = ptr_client->next_client)
+    {
+        if ((ptr_client->protocol != RELAY_PROTOCOL_WEECHAT)
+            || !ptr_client->protocol_data
+            || !RELAY_WEECHAT_DATA(ptr_client, signal_buffer))
         {
-            msg = relay_weechat_msg_new (str_signal);
-            if (msg)
+            continue;
+        }
+
+        if (relay_weechat_protocol_is_sync (ptr_client, ptr_buffer, flags))
+        {
+            if (!msg)
             {
-                snprintf (cmd_hdata, sizeof (cmd_hdata),
-                          "buffer:0x%lx", (long unsigned int)ptr_buffer);
-                relay_weechat_msg_add_hdata (msg, cmd_hdata,
-                                             "number,full_name");
-                relay_weechat_msg_send (ptr_client, msg);
-                relay_weechat_msg_free (msg);
+                msg = relay_weechat_msg_new (str_signal);
+                if (msg)
+                    relay_weechat_msg_add_hdata (msg, cmd_hdata, keys);
             }
+            if (msg)
+                relay_weechat_msg_send (ptr_client, msg);
         }
 
-        /* remove buffer from hashtables */
-        weechat_hashtable_remove (
-            RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
-            weechat_buffer_get_string (ptr_buffer, "full_name"));
-        weechat_hashtable_remove (
-            RELAY_WEECHAT_DATA(ptr_client, buffers_nicklist),
-            ptr_buffer);
+        if (buffer_closing)
+        {
+            /* remove buffer from hashtables */
+            weechat_hashtable_remove (
+                RELAY_WEECHAT_DATA(ptr_client, buffers_sync),
+                weechat_buffer_get_string (ptr_buffer, "full_name"));
+            weechat_hashtable_remove (
+                RELAY_WEECHAT_DATA(ptr_client, buffers_nicklist),
+                ptr_buffer);
+        }
     }
 
+    if (msg)
+        relay_weechat_msg_free (msg);
+
     return WEECHAT_RC_OK;
 }
 
@@ -43,6 +43,11 @@
 char *relay_weechat_compression_string[] = /* strings for compressions      */
 { "off", "zlib" };
 
+struct t_hook *relay_weechat_hook_signal_buffer = NULL; /* signals "buffer_*"*/
+                                       /* (one hook for all clients)        */
+int relay_weechat_signal_buffer_clients = 0; /* number of clients using the */
+                                       /* hook of signals "buffer_*"        */
+
 
 /*
  * Searches for a compression.
@@ -73,10 +78,22 @@ relay_weechat_compression_search (const char *compression)
 void
 relay_weechat_hook_signals (struct t_relay_client *client)
 {
-    RELAY_WEECHAT_DATA(client, hook_signal_buffer) =
-        weechat_hook_signal ("buffer_*",
-                             &relay_weechat_protocol_signal_buffer_cb,
-                             client, NULL);
+    /*
+     * signals "buffer_*" are hooked only once for all clients, so that
+     * messages are built and compressed only once for all clients
+     */
+    if (!RELAY_WEECHAT_DATA(client, signal_buffer))
+    {
+        RELAY_WEECHAT_DATA(client, signal_buffer) = 1;
+        relay_weechat_signal_buffer_clients++;
+        if (!relay_weechat_hook_signal_buffer)
+        {
+            relay_weechat_hook_signal_buffer =
+                weechat_hook_signal ("buffer_*",
+                                     &relay_weechat_protocol_signal_buffer_cb,
+                                     NULL, NULL);
+        }
+    }
     RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) =
         weechat_hook_hsignal ("nicklist_*",
                               &relay_weechat_protocol_hsignal_nicklist_cb,
@@ -88,17 +105,35 @@ relay_weechat_hook_signals (struct t_relay_client *client)
 }
 
 /*
- * Unhooks signals for a client.
+ * Stops sending signals "buffer_*" to a client (the hook is removed if no
+ * more clients are using it).
  */
 
 void
-relay_weechat_unhook_signals (struct t_relay_client *client)
+relay_weechat_unhook_signal_buffer (struct t_relay_client *client)
 {
-    if (RELAY_WEECHAT_DATA(client, hook_signal_buffer))
+    if (!RELAY_WEECHAT_DATA(client, signal_buffer))
+        return;
+
+    RELAY_WEECHAT_DATA(client, signal_buffer) = 0;
+    relay_weechat_signal_buffer_clients--;
+    if ((relay_weechat_signal_buffer_clients <= 0)
+        && relay_weechat_hook_signal_buffer)
     {
-        weechat_unhook (RELAY_WEECHAT_DATA(client, hook_signal_buffer));
-        RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
+        weechat_unhook (relay_weechat_hook_signal_buffer);
+        relay_weechat_hook_signal_buffer = NULL;
+        relay_weechat_signal_buffer_clients = 0;
     }
+}
+
+/*
+ * Unhooks signals for a client.
+ */
+
+void
+relay_weechat_unhook_signals (struct t_relay_client *client)
+{
+    relay_weechat_unhook_signal_buffer (client);
     if (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist))
     {
         weechat_unhook (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist));
@@ -181,7 +216,7 @@ relay_weechat_alloc (struct t_relay_client *client)
                                    WEECHAT_HASHTABLE_STRING,
                                    WEECHAT_HASHTABLE_INTEGER,
                                    NULL, NULL);
-        RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
+        RELAY_WEECHAT_DATA(client, signal_buffer) = 0;
         RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) = NULL;
         RELAY_WEECHAT_DATA(client, hook_signal_upgrade) = NULL;
         RELAY_WEECHAT_DATA(client, buffers_nicklist) =
@@ -244,7 +279,7 @@ relay_weechat_alloc_with_infolist (struct t_relay_client *client,
                                    &value);
             index++;
         }
-        RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
+        RELAY_WEECHAT_DATA(client, signal_buffer) = 0;
         RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) = NULL;
         RELAY_WEECHAT_DATA(client, hook_signal_upgrade) = NULL;
         RELAY_WEECHAT_DATA(client, buffers_nicklist) =
@@ -259,7 +294,7 @@ relay_weechat_alloc_with_infolist (struct t_relay_client *client,
 
         if (RELAY_CLIENT_HAS_ENDED(client))
         {
-            RELAY_WEECHAT_DATA(client, hook_signal_buffer) = NULL;
+            RELAY_WEECHAT_DATA(client, signal_buffer) = 0;
             RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist) = NULL;
             RELAY_WEECHAT_DATA(client, hook_signal_upgrade) = NULL;
         }
@@ -282,8 +317,7 @@ relay_weechat_free (struct t_relay_client *client)
     {
         if (RELAY_WEECHAT_DATA(client, buffers_sync))
             weechat_hashtable_free (RELAY_WEECHAT_DATA(client, buffers_sync));
-        if (RELAY_WEECHAT_DATA(client, hook_signal_buffer))
-            weechat_unhook (RELAY_WEECHAT_DATA(client, hook_signal_buffer));
+        relay_weechat_unhook_signal_buffer (client);
         if (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist))
             weechat_unhook (RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist));
         if (RELAY_WEECHAT_DATA(client, hook_signal_upgrade))
@@ -337,7 +371,7 @@ relay_weechat_print_log (struct t_relay_client *client)
                             RELAY_WEECHAT_DATA(client, buffers_sync),
                             weechat_hashtable_get_string (RELAY_WEECHAT_DATA(client, buffers_sync),
                                                           "keys_values"));
-        weechat_log_printf ("    hook_signal_buffer . . : 0x%lx", RELAY_WEECHAT_DATA(client, hook_signal_buffer));
+        weechat_log_printf ("    signal_buffer. . . . . : %d",   RELAY_WEECHAT_DATA(client, signal_buffer));
         weechat_log_printf ("    hook_hsignal_nicklist. : 0x%lx", RELAY_WEECHAT_DATA(client, hook_hsignal_nicklist));
         weechat_log_printf ("    hook_signal_upgrade. . : 0x%lx", RELAY_WEECHAT_DATA(client, hook_signal_upgrade));
         weechat_log_printf ("    buffers_nicklist . . . : 0x%lx (hashtable: '%s')",
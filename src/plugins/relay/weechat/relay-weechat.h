@@ -41,13 +41,17 @@ struct t_relay_weechat_data
     /* sync of buffers */
     struct t_hashtable *buffers_sync;  /* buffers synchronized (events      */
                                        /* received for these buffers)       */
-    struct t_hook *hook_signal_buffer;    /* hook for signals "buffer_*"    */
+    int signal_buffer;                    /* 1 if client receives signals   */
+                                          /* "buffer_*" (shared hook)       */
     struct t_hook *hook_hsignal_nicklist; /* hook for hsignals "nicklist_*" */
     struct t_hook *hook_signal_upgrade;   /* hook for signals "upgrade*"    */
     struct t_hashtable *buffers_nicklist; /* send nicklist for these buffers*/
     struct t_hook *hook_timer_nicklist;   /* timer for sending nicklist     */
 };
 
+extern struct t_hook *relay_weechat_hook_signal_buffer;
+extern int relay_weechat_signal_buffer_clients;
+
 extern int relay_weechat_compression_search (const char *compression);
 extern void relay_weechat_hook_signals (struct t_relay_client *client);
 extern void relay_weechat_unhook_signals (struct t_relay_client *client);
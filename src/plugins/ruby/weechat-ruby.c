@@ -454,6 +454,10 @@ weechat_ruby_output (VALUE self, VALUE str)
 
 /*
  * Executes a ruby function.
+ *
+ * The symbol of function is kept in a callable, so that the name is not
+ * interned on each call (symbols created by rb_intern are never released, so
+ * nothing has to be freed in callable).
  */
 
 void *
@@ -464,14 +468,29 @@ weechat_ruby_exec (struct t_plugin_script *script,
     VALUE rc, err;
     int ruby_error, i, argc, *ret_i;
     VALUE argv2[16];
+    ID function_id;
     void *ret_value;
     struct t_plugin_script *old_ruby_current_script;
+    struct t_plugin_script_callable *callable;
 
     ret_value = NULL;
 
     old_ruby_current_script = ruby_current_script;
     ruby_current_script = script;
 
+    callable = plugin_script_callable_get (weechat_ruby_plugin, script,
+                                           function, NULL);
+    if (callable)
+    {
+        if (!callable->function)
+            callable->function = (void *)rb_intern (function);
+        function_id = (ID)callable->function;
+    }
+    else
+    {
+        function_id = rb_intern (function);
+    }
+
     argc = 0;
     if (format && format[0])
     {
@@ -495,14 +514,12 @@ weechat_ruby_exec (struct t_plugin_script *script,
 
     if (argc > 0)
     {
-        rc = rb_protect_funcall ((VALUE) script->interpreter,
-                                 rb_intern (function),
+        rc = rb_protect_funcall ((VALUE) script->interpreter, function_id,
                                  &ruby_error, argc, argv2);
     }
     else
     {
-        rc = rb_protect_funcall ((VALUE) script->interpreter,
-                                 rb_intern (function),
+        rc = rb_protect_funcall ((VALUE) script->interpreter, function_id,
                                  &ruby_error, 0, NULL);
     }
 
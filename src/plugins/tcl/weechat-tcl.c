@@ -190,8 +190,29 @@ weechat_tcl_dict_to_hashtable (Tcl_Interp *interp, Tcl_Obj *dict,
     return hashtable;
 }
 
+/*
+ * Releases a tcl object kept in a callable (callback called by plugin-script
+ * functions).
+ */
+
+void
+weechat_tcl_callable_free_cb (struct t_plugin_script_callable *callable,
+                              void *object)
+{
+    /* make C compiler happy */
+    (void) callable;
+
+    Tcl_DecrRefCount ((Tcl_Obj *)object);
+}
+
 /*
  * Executes a tcl function.
+ *
+ * The name of function is kept in a callable: tcl caches the command found in
+ * this object (and checks itself if the command has been redefined), so the
+ * command is not searched on each call. Arguments with format "s" (string)
+ * are cached too (pointers and data of callback are often the same from one
+ * call to another).
  */
 
 void *
@@ -199,61 +220,90 @@ weechat_tcl_exec (struct t_plugin_script *script,
                   int ret_type, const char *function,
                   const char *format, void **argv)
 {
-    int argc, i, llength;
+    int argc, objc, i, j, rc;
     int *ret_i;
     char *ret_cv;
     void *ret_val;
-    Tcl_Obj *cmdlist;
+    Tcl_Obj *objv[WEECHAT_SCRIPT_CALLABLE_MAX_ARGS + 1], *obj;
     Tcl_Interp *interp;
+    struct t_plugin_script_callable *callable;
     struct t_plugin_script *old_tcl_script;
 
+    if (!function || !function[0])
+        return NULL;
+
+    callable = plugin_script_callable_get (weechat_tcl_plugin, script,
+                                           function,
+                                           &weechat_tcl_callable_free_cb);
+    if (!callable)
+        return NULL;
+
     old_tcl_script = tcl_current_script;
     tcl_current_script = script;
     interp = (Tcl_Interp*)script->interpreter;
 
-    if (function && function[0])
+    if (!callable->function_name)
     {
-        cmdlist = Tcl_NewListObj (0, NULL);
-        Tcl_IncrRefCount (cmdlist); /* +1 */
-        Tcl_ListObjAppendElement (interp, cmdlist, Tcl_NewStringObj (function,-1));
-    }
-    else
-    {
-        tcl_current_script = old_tcl_script;
-        return NULL;
+        obj = Tcl_NewStringObj (function, -1);
+        Tcl_IncrRefCount (obj);
+        callable->function_name = obj;
     }
+    objc = 0;
+    objv[objc] = (Tcl_Obj *)callable->function_name;
+    Tcl_IncrRefCount (objv[objc]);
+    objc++;
 
     if (format && format[0])
     {
         argc = strlen (format);
+        if (argc > WEECHAT_SCRIPT_CALLABLE_MAX_ARGS)
+            argc = WEECHAT_SCRIPT_CALLABLE_MAX_ARGS;
         for (i = 0; i < argc; i++)
         {
             switch (format[i])
             {
                 case 's': /* string */
-                    Tcl_ListObjAppendElement (interp, cmdlist,
-                                              Tcl_NewStringObj (argv[i], -1));
+                    obj = plugin_script_callable_arg_get (callable, i,
+                                                          argv[i]);
+                    if (!obj)
+                    {
+                        obj = Tcl_NewStringObj (argv[i], -1);
+                        if (plugin_script_callable_arg_set (callable, i,
+                                                            argv[i], obj))
+                        {
+                            /* reference kept by the cache */
+                            Tcl_IncrRefCount (obj);
+                        }
+                    }
                     break;
                 case 'i': /* integer */
-                    Tcl_ListObjAppendElement (interp, cmdlist,
-                                              Tcl_NewIntObj (*((int *)argv[i])));
+                    obj = Tcl_NewIntObj (*((int *)argv[i]));
                     break;
                 case 'h': /* hash */
-                    Tcl_ListObjAppendElement (interp, cmdlist,
-                                              weechat_tcl_hashtable_to_dict (interp, argv[i]));
+                    obj = weechat_tcl_hashtable_to_dict (interp, argv[i]);
                     break;
+                default:
+                    obj = NULL;
+                    break;
+            }
+            if (obj)
+            {
+                Tcl_IncrRefCount (obj);
+                objv[objc++] = obj;
             }
         }
     }
 
-    if (Tcl_ListObjLength (interp, cmdlist, &llength) != TCL_OK)
-        llength = 0;
+    rc = Tcl_EvalObjv (interp, objc, objv, 0);
+
+    /* decrement ref count of arguments */
+    for (j = 0; j < objc; j++)
+    {
+        Tcl_DecrRefCount (objv[j]);
+    }
 
-    if (Tcl_EvalObjEx (interp, cmdlist, TCL_EVAL_DIRECT) == TCL_OK)
+    if (rc == TCL_OK)
     {
-        /* remove elements, decrement their ref count */
-        Tcl_ListObjReplace (interp, cmdlist, 0, llength, 0, NULL);
-        Tcl_DecrRefCount (cmdlist);  /* -1 */
         ret_val = NULL;
         if (ret_type == WEECHAT_SCRIPT_EXEC_STRING)
         {
@@ -308,9 +358,6 @@ weechat_tcl_exec (struct t_plugin_script *script,
         return NULL;
     }
 
-    /* remove elements, decrement their ref count */
-    Tcl_ListObjReplace (interp, cmdlist, 0, llength, 0, NULL);
-    Tcl_DecrRefCount (cmdlist);  /* -1 */
     weechat_printf (NULL,
                     weechat_gettext ("%s%s: unable to run function \"%s\": %s"),
                     weechat_prefix ("error"), TCL_PLUGIN_NAME, function,
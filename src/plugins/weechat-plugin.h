@@ -54,6 +54,7 @@ struct t_weelist;
 struct t_weelist_item;
 struct t_arraylist;
 struct t_hashtable;
+struct t_eval_compiled;
 struct t_hdata;
 struct timeval;
 
@@ -67,7 +68,7 @@ struct timeval;
  * please change the date with current one; for a second change at same
  * date, increment the 01, otherwise please keep 01.
  */
-#define WEECHAT_PLUGIN_API_VERSION "20180520-01"
+#define WEECHAT_PLUGIN_API_VERSION "20180610-01"
 
 /* macros for defining plugin infos */
 #define WEECHAT_PLUGIN_NAME(__name)                                     \
@@ -334,6 +335,12 @@ struct t_weechat_plugin
                                      struct t_hashtable *pointers,
                                      struct t_hashtable *extra_vars,
                                      struct t_hashtable *options);
+    struct t_eval_compiled *(*string_eval_compile) (const char *expr,
+                                                    struct t_hashtable *options);
+    char *(*string_eval_exec) (struct t_eval_compiled *compiled,
+                               struct t_hashtable *pointers,
+                               struct t_hashtable *extra_vars);
+    void (*string_eval_free) (struct t_eval_compiled *compiled);
     char **(*string_dyn_alloc) (int size_alloc);
     int (*string_dyn_copy) (char **string, const char *new_string);
     int (*string_dyn_concat) (char **string, const char *add);
@@ -1232,6 +1239,13 @@ extern int weechat_plugin_end (struct t_weechat_plugin *plugin);
                                        __extra_vars, __options)         \
     (weechat_plugin->string_eval_expression)(__expr, __pointers,        \
                                              __extra_vars, __options)
+#define weechat_string_eval_compile(__expr, __options)                  \
+    (weechat_plugin->string_eval_compile)(__expr, __options)
+#define weechat_string_eval_exec(__compiled, __pointers, __extra_vars)  \
+    (weechat_plugin->string_eval_exec)(__compiled, __pointers,          \
+                                       __extra_vars)
+#define weechat_string_eval_free(__compiled)                            \
+    (weechat_plugin->string_eval_free)(__compiled)
 #define weechat_string_dyn_alloc(__size_alloc)                          \
     (weechat_plugin->string_dyn_alloc)(__size_alloc)
 #define weechat_string_dyn_copy(__string, __new_string)                 \
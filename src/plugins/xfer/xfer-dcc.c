@@ -19,6 +19,10 @@
  * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -26,7 +30,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
-#include <poll.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <fcntl.h>
@@ -34,155 +37,357 @@
 #include <netdb.h>
 #include <errno.h>
 #include <gcrypt.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #include "../weechat-plugin.h"
 #include "xfer.h"
+#include "xfer-dcc.h"
 #include "xfer-config.h"
 #include "xfer-file.h"
 #include "xfer-network.h"
 
 
 /*
- * Child process for sending file with DCC protocol.
+ * Enables or disables the watch of socket for write.
  */
 
 void
-xfer_dcc_send_file_child (struct t_xfer *xfer)
+xfer_dcc_set_write (struct t_xfer *xfer, int enable)
 {
-    int num_read, num_sent, blocksize;
-    static char buffer[XFER_BLOCKSIZE_MAX];
-    uint32_t ack;
-    time_t last_sent, new_time, last_second, sent_ok;
-    unsigned long long sent_last_second;
+    if (!xfer->hook_fd || (xfer->hook_fd_write == enable))
+        return;
+
+    weechat_hook_set (xfer->hook_fd, "flag_write", (enable) ? "1" : "0");
+    xfer->hook_fd_write = enable;
+}
+
+/*
+ * Adds tokens for the speed limit (token bucket): tokens are added at the
+ * rate of speed limit, and the bucket contains at most one second of data.
+ *
+ * Returns the speed limit in bytes by second, 0 if there is no limit.
+ */
+
+long long
+xfer_dcc_speed_limit_refill (struct t_xfer *xfer)
+{
+    struct timeval tv_now;
+    long long limit, diff, tokens;
+
+    limit = (long long)weechat_config_integer (xfer_config_network_speed_limit) * 1024;
+    if (limit <= 0)
+        return 0;
+
+    gettimeofday (&tv_now, NULL);
+
+    if (xfer->speed_last_refill.tv_sec == 0)
+    {
+        /* first refill: allow one block */
+        xfer->speed_tokens = (xfer->blocksize < limit) ? xfer->blocksize : limit;
+        xfer->speed_last_refill = tv_now;
+        return limit;
+    }
+
+    diff = weechat_util_timeval_diff (&xfer->speed_last_refill, &tv_now);
+    if (diff > 1000000)
+        diff = 1000000;
+    tokens = (diff * limit) / 1000000;
+    if (tokens > 0)
+    {
+        xfer->speed_tokens += tokens;
+        if (xfer->speed_tokens > limit)
+            xfer->speed_tokens = limit;
+        xfer->speed_last_refill = tv_now;
+    }
+
+    return limit;
+}
+
+/*
+ * Callback for timer used when sending a file: called when tokens are
+ * available again (speed limit) or when no ACK was received after the end of
+ * the send.
+ */
+
+int
+xfer_dcc_send_file_timer_cb (const void *pointer, void *data,
+                             int remaining_calls)
+{
+    struct t_xfer *xfer;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) remaining_calls;
+
+    xfer = (struct t_xfer *)pointer;
+
+    /* timer is removed after this call */
+    xfer->hook_timer_transfer = NULL;
 
-    /* empty file? just return immediately */
     if (xfer->pos >= xfer->size)
     {
-        xfer_network_write_pipe (xfer, XFER_STATUS_DONE,
-                                 XFER_NO_ERROR);
-        return;
+        /*
+         * the file was sent some seconds ago, and the receiver did not send
+         * the final ACK: consider it's OK
+         */
+        xfer_network_set_status (xfer, XFER_STATUS_DONE, XFER_NO_ERROR);
+        return WEECHAT_RC_OK;
     }
 
-    blocksize = xfer->blocksize;
-    if (weechat_config_integer (xfer_config_network_speed_limit) > 0)
+    xfer_dcc_send_file_blocks (xfer);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Sends blocks of file to receiver (with sendfile if available, so that data
+ * is not copied in WeeChat memory).
+ *
+ * Blocks are sent until the socket is full, the receiver must send an ACK
+ * (if fast send is disabled) or the speed limit is reached; the watch of
+ * socket for write is then updated.
+ */
+
+void
+xfer_dcc_send_file_blocks (struct t_xfer *xfer)
+{
+    long long limit, size, delay;
+    ssize_t num_sent;
+    int i, socket_full;
+#ifdef HAVE_SYS_SENDFILE_H
+    off_t offset;
+#else
+    static char buffer[XFER_BLOCKSIZE_MAX];
+    ssize_t num_read;
+#endif /* HAVE_SYS_SENDFILE_H */
+
+    if (xfer->hook_timer_transfer)
     {
-        if (blocksize > weechat_config_integer (xfer_config_network_speed_limit) * 1024)
-            blocksize = weechat_config_integer (xfer_config_network_speed_limit) * 1024;
+        weechat_unhook (xfer->hook_timer_transfer);
+        xfer->hook_timer_transfer = NULL;
     }
 
-    last_sent = time (NULL);
-    last_second = time (NULL);
-    sent_ok = 0;
-    sent_last_second = 0;
-    while (1)
+    limit = xfer_dcc_speed_limit_refill (xfer);
+
+    socket_full = 0;
+    for (i = 0; i < XFER_DCC_MAX_LOOPS; i++)
     {
-        /* read DCC ACK (sent by receiver) */
-        if (xfer->pos > xfer->ack)
+        if ((xfer->pos >= xfer->size)
+            || (!xfer->fast_send && (xfer->pos > xfer->ack))
+            || ((limit > 0) && (xfer->speed_tokens <= 0)))
         {
-            /* we should receive ACK for packets sent previously */
-            while (1)
-            {
-                num_read = recv (xfer->sock, (char *) &ack, 4, MSG_PEEK);
-                if ((num_read < 1) &&
-                    ((num_read != -1) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))))
-                {
-                    xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                             XFER_ERROR_SEND_BLOCK);
-                    return;
-                }
-                if (num_read == 4)
-                {
-                    recv (xfer->sock, (char *) &ack, 4, 0);
-                    xfer->ack = ntohl (ack);
+            break;
+        }
 
-                    /* DCC send OK? */
-                    if ((xfer->pos >= xfer->size)
-                        && (xfer->ack >= xfer->size))
-                    {
-                        xfer_network_write_pipe (xfer, XFER_STATUS_DONE,
-                                                 XFER_NO_ERROR);
-                        return;
-                    }
-                }
-                else
-                    break;
+        size = xfer->size - xfer->pos;
+        if (size > xfer->blocksize)
+            size = xfer->blocksize;
+        if ((limit > 0) && (size > xfer->speed_tokens))
+            size = xfer->speed_tokens;
+
+#ifdef HAVE_SYS_SENDFILE_H
+        offset = (off_t)xfer->pos;
+        num_sent = sendfile (xfer->sock, xfer->file, &offset, size);
+#else
+        num_read = pread (xfer->file, buffer, size, (off_t)xfer->pos);
+        if (num_read <= 0)
+        {
+            if ((num_read < 0) && (errno == EINTR))
+                continue;
+            xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                     XFER_ERROR_READ_LOCAL);
+            return;
+        }
+        num_sent = send (xfer->sock, buffer, num_read, 0);
+#endif /* HAVE_SYS_SENDFILE_H */
+        if (num_sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                socket_full = 1;
+                break;
             }
+            xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                     XFER_ERROR_SEND_BLOCK);
+            return;
+        }
+        if (num_sent == 0)
+        {
+            /* end of file reached before the expected size */
+            xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                     XFER_ERROR_READ_LOCAL);
+            return;
         }
+        xfer->pos += (unsigned long long)num_sent;
+        if (limit > 0)
+            xfer->speed_tokens -= num_sent;
+    }
+
+    if (xfer->pos >= xfer->size)
+    {
+        /* file sent: wait for the final ACK (with a timeout) */
+        xfer_dcc_set_write (xfer, 0);
+        xfer->last_refresh = 0;
+        xfer_network_progress (xfer);
+        xfer->hook_timer_transfer = weechat_hook_timer (
+            XFER_DCC_SEND_DONE_DELAY, 0, 1,
+            &xfer_dcc_send_file_timer_cb, xfer, NULL);
+        return;
+    }
+
+    if (socket_full || (i == XFER_DCC_MAX_LOOPS))
+    {
+        /* socket full or more blocks to send: wait until it's writable */
+        xfer_dcc_set_write (xfer, 1);
+    }
+    else
+    {
+        /* ACK needed or speed limit reached */
+        xfer_dcc_set_write (xfer, 0);
+        if ((limit > 0) && (xfer->speed_tokens <= 0)
+            && (xfer->fast_send || (xfer->pos <= xfer->ack)))
+        {
+            delay = (((xfer->blocksize < limit) ? xfer->blocksize : limit)
+                     - xfer->speed_tokens) * 1000 / limit;
+            xfer->hook_timer_transfer = weechat_hook_timer (
+                (delay > 0) ? delay : 1, 0, 1,
+                &xfer_dcc_send_file_timer_cb, xfer, NULL);
+        }
+    }
+
+    xfer_network_progress (xfer);
+}
+
+/*
+ * Reads ACKs sent by receiver (4 bytes: position received, in network byte
+ * order).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error or end of transfer (xfer is closed)
+ */
 
-        /* send a block to receiver */
-        if ((xfer->pos < xfer->size) &&
-             (xfer->fast_send || (xfer->pos <= xfer->ack)))
+int
+xfer_dcc_send_file_read_ack (struct t_xfer *xfer)
+{
+    unsigned char buffer[4 + 4096];
+    uint32_t ack;
+    ssize_t num_read;
+    int length, complete;
+
+    while (1)
+    {
+        memcpy (buffer, xfer->ack_buffer, xfer->ack_buffer_size);
+        num_read = recv (xfer->sock, buffer + xfer->ack_buffer_size,
+                         sizeof (buffer) - xfer->ack_buffer_size, 0);
+        if (num_read < 0)
         {
-            if ((weechat_config_integer (xfer_config_network_speed_limit) > 0)
-                && (sent_last_second >= (unsigned long long)weechat_config_integer (xfer_config_network_speed_limit) * 1024))
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                break;
+            xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                     XFER_ERROR_READ_ACK);
+            return 0;
+        }
+        if (num_read == 0)
+        {
+            /* connection closed by receiver */
+            if (xfer->pos >= xfer->size)
             {
-                /* we're sending too fast (according to speed limit set by user) */
-                usleep (100);
+                xfer_network_set_status (xfer, XFER_STATUS_DONE,
+                                         XFER_NO_ERROR);
             }
             else
             {
-                lseek (xfer->file, xfer->pos, SEEK_SET);
-                num_read = read (xfer->file, buffer, blocksize);
-                if (num_read < 1)
-                {
-                    xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                             XFER_ERROR_READ_LOCAL);
-                    return;
-                }
-                num_sent = send (xfer->sock, buffer, num_read, 0);
-                if (num_sent < 0)
-                {
-                    /*
-                     * socket is temporarily not available (receiver can't
-                     * receive amount of data we sent ?!)
-                     */
-                    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-                        usleep (1000);
-                    else
-                    {
-                        xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                                 XFER_ERROR_SEND_BLOCK);
-                        return;
-                    }
-                }
-                if (num_sent > 0)
-                {
-                    xfer->pos += (unsigned long long) num_sent;
-                    sent_last_second += (unsigned long long) num_sent;
-                    new_time = time (NULL);
-                    if ((last_sent != new_time)
-                        || ((sent_ok == 0) && (xfer->pos >= xfer->size)))
-                    {
-                        last_sent = new_time;
-                        xfer_network_write_pipe (xfer, XFER_STATUS_ACTIVE,
-                                                 XFER_NO_ERROR);
-                        if (xfer->pos >= xfer->size)
-                            sent_ok = new_time;
-                    }
-                }
+                xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                         XFER_ERROR_READ_ACK);
             }
+            return 0;
         }
-        else
-            usleep (1000);
 
-        new_time = time (NULL);
-        if (new_time > last_second)
+        /* only the last complete ACK is used */
+        length = xfer->ack_buffer_size + num_read;
+        complete = length - (length % 4);
+        if (complete >= 4)
         {
-            last_second = new_time;
-            sent_last_second = 0;
+            memcpy (&ack, buffer + complete - 4, 4);
+            xfer->ack = ntohl (ack);
         }
+        xfer->ack_buffer_size = length - complete;
+        memcpy (xfer->ack_buffer, buffer + complete, xfer->ack_buffer_size);
+    }
 
-        /*
-         * if send if OK since 2 seconds or more, and that no ACK was received,
-         * then consider it's OK
-         */
-        if ((sent_ok != 0) && (new_time > sent_ok + 2))
-        {
-            xfer_network_write_pipe (xfer, XFER_STATUS_DONE,
-                                     XFER_NO_ERROR);
-            return;
-        }
+    /* DCC send OK? */
+    if ((xfer->pos >= xfer->size) && (xfer->ack >= xfer->size))
+    {
+        xfer_network_set_status (xfer, XFER_STATUS_DONE, XFER_NO_ERROR);
+        return 0;
     }
+
+    return 1;
+}
+
+/*
+ * Callback for socket when sending a file: reads ACKs and sends next blocks.
+ */
+
+int
+xfer_dcc_send_file_fd_cb (const void *pointer, void *data, int fd)
+{
+    struct t_xfer *xfer;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) fd;
+
+    xfer = (struct t_xfer *)pointer;
+
+    if (!xfer_dcc_send_file_read_ack (xfer))
+        return WEECHAT_RC_OK;
+
+    if (xfer->pos < xfer->size)
+        xfer_dcc_send_file_blocks (xfer);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Starts sending a file with DCC protocol (socket is connected to receiver
+ * and local file is opened).
+ */
+
+void
+xfer_dcc_send_file_start (struct t_xfer *xfer)
+{
+    /* empty file? just return immediately */
+    if (xfer->pos >= xfer->size)
+    {
+        xfer_network_set_status (xfer, XFER_STATUS_DONE, XFER_NO_ERROR);
+        return;
+    }
+
+    xfer->ack_buffer_size = 0;
+    xfer->speed_tokens = 0;
+    xfer->speed_last_refill.tv_sec = 0;
+    xfer->speed_last_refill.tv_usec = 0;
+    xfer->last_refresh = time (NULL);
+
+    xfer->hook_fd = weechat_hook_fd (xfer->sock,
+                                     1, 1, 0,
+                                     &xfer_dcc_send_file_fd_cb,
+                                     xfer, NULL);
+    if (!xfer->hook_fd)
+    {
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_SEND_BLOCK);
+        return;
+    }
+    xfer->hook_fd_write = 1;
 }
 
 /*
@@ -230,290 +435,454 @@ xfer_dcc_recv_file_send_ack (struct t_xfer *xfer)
 }
 
 /*
- * Reads a resumed xfer from disk for hashing.
- *
- * Returns:
- *   1: OK
- *   0: error
+ * Callback for connection to sender.
  */
 
 int
-xfer_dcc_resume_hash (struct t_xfer *xfer)
+xfer_dcc_recv_file_connect_cb (const void *pointer, void *data,
+                               int status, int gnutls_rc,
+                               int sock, const char *error,
+                               const char *ip_address)
 {
-    char *buf;
-    unsigned long long total_read;
-    ssize_t length_buf, to_read, num_read;
-    int ret, fd;
+    struct t_xfer *xfer;
+    int flags, splice_pipe[2];
 
-    total_read = 0;
-    ret = 1;
-    fd = 0;
+    /* make C compiler happy */
+    (void) data;
+    (void) gnutls_rc;
+    (void) ip_address;
 
-    length_buf = 1024 * 1024;
-    buf = malloc (length_buf);
-    if (!buf)
-        return 0;
+    xfer = (struct t_xfer *)pointer;
+
+    weechat_unhook (xfer->hook_connect);
+    xfer->hook_connect = NULL;
 
-    while (fd <= 0)
+    if (status != WEECHAT_HOOK_CONNECT_OK)
     {
-        fd = open (xfer->local_filename, O_RDONLY);
-        if (fd < 0)
+        if (error && error[0])
         {
-            if (errno == EINTR)
-                continue;
-            fd = 0;
-            ret = 0;
-            break;
+            weechat_printf (NULL,
+                            _("%s%s: error: %s"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME, error);
         }
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_CONNECT_SENDER);
+        return WEECHAT_RC_OK;
     }
 
-    if (fd)
+    xfer->sock = sock;
+
+    /* set TCP_NODELAY to be more aggressive with acks */
+    flags = 1;
+    setsockopt (xfer->sock, IPPROTO_TCP, TCP_NODELAY, &flags, sizeof (flags));
+
+    /* make socket non-blocking */
+    flags = fcntl (xfer->sock, F_GETFL);
+    if (flags == -1)
+        flags = 0;
+    fcntl (xfer->sock, F_SETFL, flags | O_NONBLOCK);
+
+#ifdef HAVE_SPLICE
+    /*
+     * create a pipe to move data from socket to file with splice (not
+     * possible if data must be hashed)
+     */
+    if (!xfer->hash_handle && (pipe (splice_pipe) == 0))
     {
-        while (total_read < xfer->start_resume)
-        {
-            to_read = xfer->start_resume - total_read;
-            if (to_read > length_buf)
-                num_read = read (fd, buf, length_buf);
-            else
-                num_read = read (fd, buf, to_read);
-            if (num_read > 0)
-            {
-                gcry_md_write (*xfer->hash_handle, buf, num_read);
-                total_read += num_read;
-            }
-            else if (num_read < 0)
-            {
-                if (errno == EINTR)
-                    continue;
-                ret = 0;
-                break;
-            }
-        }
+        xfer->splice_read = splice_pipe[0];
+        xfer->splice_write = splice_pipe[1];
+    }
+#else
+    /* make C compiler happy */
+    (void) splice_pipe;
+#endif /* HAVE_SPLICE */
+
+    xfer->hook_fd = weechat_hook_fd (xfer->sock,
+                                     1, 0, 0,
+                                     &xfer_dcc_recv_file_fd_cb,
+                                     xfer, NULL);
+    if (!xfer->hook_fd)
+    {
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_RECV_BLOCK);
+        return WEECHAT_RC_OK;
+    }
 
-        while (close (fd) < 0)
-        {
-            if (errno != EINTR)
-                break;
-        }
+    /* connection is OK, change DCC status */
+    xfer->pos_last_ack = 0;
+    xfer->last_refresh = time (NULL);
+    xfer_network_set_status (xfer, XFER_STATUS_ACTIVE, XFER_NO_ERROR);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Connects to sender.
+ */
+
+void
+xfer_dcc_recv_file_connect (struct t_xfer *xfer)
+{
+    xfer->hook_connect = weechat_hook_connect (xfer->proxy,
+                                               xfer->remote_address_str,
+                                               xfer->port, 1, 0, NULL, NULL,
+                                               0, "NONE", NULL,
+                                               &xfer_dcc_recv_file_connect_cb,
+                                               xfer, NULL);
+    if (!xfer->hook_connect)
+    {
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_CONNECT_SENDER);
+    }
+}
+
+/*
+ * Callback for timer used to hash the part of file already received (when
+ * resuming a file): the file is hashed by chunks, so that WeeChat is not
+ * blocked with a big file.
+ */
+
+int
+xfer_dcc_resume_hash_timer_cb (const void *pointer, void *data,
+                               int remaining_calls)
+{
+    struct t_xfer *xfer;
+    char *buf;
+    unsigned long long to_read;
+    ssize_t num_read;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) remaining_calls;
+
+    xfer = (struct t_xfer *)pointer;
+
+    buf = malloc (XFER_DCC_HASH_SIZE);
+    if (!buf)
+        return WEECHAT_RC_OK;
+
+    to_read = xfer->start_resume - xfer->hash_pos;
+    if (to_read > XFER_DCC_HASH_SIZE)
+        to_read = XFER_DCC_HASH_SIZE;
+    num_read = pread (xfer->file, buf, to_read, (off_t)xfer->hash_pos);
+    if (num_read > 0)
+    {
+        gcry_md_write (*xfer->hash_handle, buf, num_read);
+        xfer->hash_pos += num_read;
     }
 
     free (buf);
 
-    return ret;
+    if ((num_read < 0) && (errno == EINTR))
+        return WEECHAT_RC_OK;
+
+    if (num_read <= 0)
+    {
+        gcry_md_close (*xfer->hash_handle);
+        free (xfer->hash_handle);
+        xfer->hash_handle = NULL;
+        xfer_network_set_status (xfer, XFER_STATUS_HASHING,
+                                 XFER_ERROR_HASH_RESUME_ERROR);
+    }
+    else if (xfer->hash_pos < xfer->start_resume)
+    {
+        return WEECHAT_RC_OK;
+    }
+
+    /* hash done (or error): connect to sender */
+    weechat_unhook (xfer->hook_timer_transfer);
+    xfer->hook_timer_transfer = NULL;
+    xfer_network_set_status (xfer, XFER_STATUS_CONNECTING, XFER_NO_ERROR);
+    xfer_dcc_recv_file_connect (xfer);
+
+    return WEECHAT_RC_OK;
 }
 
 /*
- * Child process for receiving file with DCC protocol.
+ * Writes data received in local file (and adds it to the hash).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (xfer is closed)
  */
 
-void
-xfer_dcc_recv_file_child (struct t_xfer *xfer)
+int
+xfer_dcc_recv_file_write (struct t_xfer *xfer, const char *buffer, int size)
 {
-    int flags, num_read, ready;
-    static char buffer[XFER_BLOCKSIZE_MAX];
-    time_t last_sent, new_time;
-    unsigned long long pos_last_ack;
-    struct pollfd poll_fd;
     ssize_t written, total_written;
-    unsigned char *bin_hash;
-    char hash[9];
 
-    /* if resuming, hash the portion of the file we have */
-    if ((xfer->start_resume > 0) && xfer->hash_handle)
+    total_written = 0;
+    while (total_written < size)
     {
-        xfer_network_write_pipe (xfer, XFER_STATUS_HASHING,
-                                 XFER_NO_ERROR);
-        if (!xfer_dcc_resume_hash (xfer))
+        written = write (xfer->file,
+                         buffer + total_written,
+                         size - total_written);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                     XFER_ERROR_WRITE_LOCAL);
+            return 0;
+        }
+        if (xfer->hash_handle)
         {
-            gcry_md_close (*xfer->hash_handle);
-            free (xfer->hash_handle);
-            xfer->hash_handle = NULL;
-            xfer_network_write_pipe (xfer, XFER_STATUS_HASHING,
-                                     XFER_ERROR_HASH_RESUME_ERROR);
+            gcry_md_write (*xfer->hash_handle,
+                           buffer + total_written,
+                           written);
         }
-        xfer_network_write_pipe (xfer, XFER_STATUS_CONNECTING,
-                                 XFER_NO_ERROR);
+        total_written += written;
     }
 
-    /* first connect to sender (blocking) */
-    xfer->sock = weechat_network_connect_to (xfer->proxy,
-                                             xfer->remote_address,
-                                             xfer->remote_address_length);
-    if (xfer->sock == -1)
+    return 1;
+}
+
+/*
+ * Receives data from socket and writes it in local file (copy in a buffer).
+ *
+ * Returns:
+ *   > 0: number of bytes received
+ *     0: connection closed by sender
+ *    -1: no data available on socket
+ *    -2: error (xfer is closed)
+ */
+
+ssize_t
+xfer_dcc_recv_file_copy (struct t_xfer *xfer)
+{
+    static char buffer[XFER_BLOCKSIZE_MAX];
+    ssize_t num_read;
+
+    while (1)
     {
-        xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                 XFER_ERROR_CONNECT_SENDER);
-        return;
+        num_read = recv (xfer->sock, buffer, sizeof (buffer), 0);
+        if ((num_read >= 0) || (errno != EINTR))
+            break;
+    }
+    if (num_read < 0)
+    {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            return -1;
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_RECV_BLOCK);
+        return -2;
     }
+    if ((num_read > 0) && !xfer_dcc_recv_file_write (xfer, buffer, num_read))
+        return -2;
 
-    /* set TCP_NODELAY to be more aggressive with acks */
-    flags = 1;
-    setsockopt (xfer->sock, IPPROTO_TCP, TCP_NODELAY, &flags, sizeof (flags));
+    return num_read;
+}
 
-    /* connection is OK, change DCC status (inform parent process) */
-    xfer_network_write_pipe (xfer, XFER_STATUS_ACTIVE,
-                             XFER_NO_ERROR);
+/*
+ * Receives data from socket and moves it to local file with splice (data is
+ * not copied in WeeChat memory).
+ *
+ * Returns:
+ *   > 0: number of bytes received
+ *     0: connection closed by sender
+ *    -1: no data available on socket
+ *    -2: error (xfer is closed)
+ */
 
-    /* make socket non-blocking */
-    flags = fcntl (xfer->sock, F_GETFL);
-    if (flags == -1)
-        flags = 0;
-    fcntl (xfer->sock, F_SETFL, flags | O_NONBLOCK);
+ssize_t
+xfer_dcc_recv_file_splice (struct t_xfer *xfer)
+{
+#ifdef HAVE_SPLICE
+    static char buffer[XFER_DCC_SPLICE_SIZE];
+    ssize_t num_read, num_written, total_written;
+    size_t size;
 
-    last_sent = time (NULL);
-    pos_last_ack = 0;
+    size = XFER_DCC_SPLICE_SIZE;
+    if (xfer->size - xfer->pos < size)
+        size = xfer->size - xfer->pos;
 
     while (1)
     {
-        /* wait until there is something to read on socket (or error) */
-        poll_fd.fd = xfer->sock;
-        poll_fd.events = POLLIN;
-        poll_fd.revents = 0;
-        ready = poll (&poll_fd, 1, -1);
-        if (ready <= 0)
+        num_read = splice (xfer->sock, NULL, xfer->splice_write, NULL, size,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if ((num_read >= 0) || (errno != EINTR))
+            break;
+    }
+    if (num_read < 0)
+    {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            return -1;
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_RECV_BLOCK);
+        return -2;
+    }
+
+    total_written = 0;
+    while (total_written < num_read)
+    {
+        num_written = splice (xfer->splice_read, NULL, xfer->file, NULL,
+                              num_read - total_written, SPLICE_F_MOVE);
+        if (num_written > 0)
         {
-            if ((errno == EINTR) || (errno == EAGAIN))
-                continue;
-            else
-            {
-                xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                         XFER_ERROR_RECV_BLOCK);
-                return;
-            }
+            total_written += num_written;
+            continue;
         }
-
-        /* read maximum data on socket (until nothing is available) */
-        while (1)
+        if ((num_written < 0) && (errno == EINTR))
+            continue;
+        if ((num_written < 0) && (errno == EINVAL))
         {
-            num_read = recv (xfer->sock, buffer, sizeof (buffer), 0);
-            if (num_read == -1)
+            /*
+             * file system does not support splice: copy data waiting in
+             * pipe and stop using splice
+             */
+            while (total_written < num_read)
             {
-                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+                num_written = read (xfer->splice_read, buffer,
+                                    num_read - total_written);
+                if ((num_written <= 0)
+                    || !xfer_dcc_recv_file_write (xfer, buffer, num_written))
                 {
-                    xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                             XFER_ERROR_RECV_BLOCK);
-                    return;
-                }
-                /*
-                 * no more data available on socket: exit loop, send ACK, and
-                 * wait for new data on socket
-                 */
-                break;
-            }
-            else
-            {
-                if ((num_read == 0) && (xfer->pos < xfer->size))
-                {
-                    xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                             XFER_ERROR_RECV_BLOCK);
-                    return;
-                }
-
-                /* bytes received, write to disk */
-                total_written = 0;
-                while (total_written < num_read)
-                {
-                    written = write (xfer->file,
-                                     buffer + total_written,
-                                     num_read - total_written);
-                    if (written < 0)
+                    if (num_written <= 0)
                     {
-                        if (errno == EINTR)
-                            continue;
-                        xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
+                        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
                                                  XFER_ERROR_WRITE_LOCAL);
-                        return;
-                    }
-                    else
-                    {
-                        if (xfer->hash_handle)
-                        {
-                            gcry_md_write (*xfer->hash_handle,
-                                           buffer + total_written,
-                                           written);
-                        }
-                        total_written += written;
                     }
+                    return -2;
                 }
+                total_written += num_written;
+            }
+            xfer_network_close_pipe (xfer);
+            break;
+        }
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_WRITE_LOCAL);
+        return -2;
+    }
 
-                xfer->pos += (unsigned long long) num_read;
+    return num_read;
+#else
+    return xfer_dcc_recv_file_copy (xfer);
+#endif /* HAVE_SPLICE */
+}
 
-                /* file received OK? */
-                if (xfer->pos >= xfer->size)
-                {
-                    /* check hash and report result to pipe */
-                    if (xfer->hash_handle)
-                    {
-                        gcry_md_final (*xfer->hash_handle);
-                        bin_hash = gcry_md_read (*xfer->hash_handle, 0);
-                        if (bin_hash)
-                        {
-                            snprintf (hash, sizeof (hash), "%.2X%.2X%.2X%.2X",
-                                      bin_hash[0], bin_hash[1], bin_hash[2],
-                                      bin_hash[3]);
-                            if (weechat_strcasecmp (hash,
-                                                    xfer->hash_target) == 0)
-                            {
-                                xfer_network_write_pipe (xfer,
-                                                         XFER_STATUS_HASHED,
-                                                         XFER_NO_ERROR);
-                            }
-                            else
-                            {
-                                xfer_network_write_pipe (xfer,
-                                                         XFER_STATUS_HASHED,
-                                                         XFER_ERROR_HASH_MISMATCH);
-                            }
-                        }
-                    }
+/*
+ * Ends the receive of a file: checks hash, sends the final ACK and sets
+ * status "done".
+ */
+
+void
+xfer_dcc_recv_file_end (struct t_xfer *xfer)
+{
+    unsigned char *bin_hash;
+    char hash[9];
+
+    /* check hash */
+    if (xfer->hash_handle)
+    {
+        gcry_md_final (*xfer->hash_handle);
+        bin_hash = gcry_md_read (*xfer->hash_handle, 0);
+        if (bin_hash)
+        {
+            snprintf (hash, sizeof (hash), "%.2X%.2X%.2X%.2X",
+                      bin_hash[0], bin_hash[1], bin_hash[2], bin_hash[3]);
+            xfer_network_set_status (
+                xfer, XFER_STATUS_HASHED,
+                (weechat_strcasecmp (hash, xfer->hash_target) == 0) ?
+                XFER_NO_ERROR : XFER_ERROR_HASH_MISMATCH);
+        }
+    }
 
-                    fsync (xfer->file);
+    fsync (xfer->file);
 
-                    /*
-                     * extra delay before sending ACK, otherwise the send of ACK
-                     * may fail
-                     */
-                    usleep (100000);
+    /* send ACK to sender without checking return code (file OK) */
+    xfer_dcc_recv_file_send_ack (xfer);
 
-                    /* send ACK to sender without checking return code (file OK) */
-                    xfer_dcc_recv_file_send_ack (xfer);
+    xfer_network_set_status (xfer, XFER_STATUS_DONE, XFER_NO_ERROR);
+}
 
-                    /* set status done and return */
-                    xfer_network_write_pipe (xfer, XFER_STATUS_DONE,
-                                             XFER_NO_ERROR);
-                    return;
-                }
+/*
+ * Callback for socket when receiving a file: reads data available on socket,
+ * writes it in local file and sends ACK to sender.
+ */
 
-                /* update status of DCC (parent process) */
-                new_time = time (NULL);
-                if (last_sent != new_time)
-                {
-                    last_sent = new_time;
-                    xfer_network_write_pipe (xfer, XFER_STATUS_ACTIVE,
-                                             XFER_NO_ERROR);
-                }
-            }
+int
+xfer_dcc_recv_file_fd_cb (const void *pointer, void *data, int fd)
+{
+    struct t_xfer *xfer;
+    ssize_t num_read;
+    int i;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) fd;
+
+    xfer = (struct t_xfer *)pointer;
+
+    for (i = 0; i < XFER_DCC_MAX_LOOPS; i++)
+    {
+        num_read = (xfer->splice_read >= 0) ?
+            xfer_dcc_recv_file_splice (xfer) : xfer_dcc_recv_file_copy (xfer);
+        if (num_read == -2)
+            return WEECHAT_RC_OK;
+        if (num_read == -1)
+            break;
+        if ((num_read == 0) && (xfer->pos < xfer->size))
+        {
+            /* connection closed by sender before end of file */
+            xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                     XFER_ERROR_RECV_BLOCK);
+            return WEECHAT_RC_OK;
         }
 
-        /* send ACK to sender (if needed) */
-        if (xfer->send_ack && (xfer->pos > pos_last_ack))
+        xfer->pos += (unsigned long long)num_read;
+
+        /* file received OK? */
+        if (xfer->pos >= xfer->size)
         {
-            switch (xfer_dcc_recv_file_send_ack (xfer))
-            {
-                case 0:
-                    /* send error, socket down? */
-                    xfer_network_write_pipe (xfer, XFER_STATUS_FAILED,
-                                             XFER_ERROR_SEND_ACK);
-                    return;
-                case 1:
-                    /* send error, not fatal (buffer full?): disable ACKs */
-                    xfer->send_ack = 0;
-                    break;
-                case 2:
-                    /* send OK: save position in file as last ACK sent */
-                    pos_last_ack = xfer->pos;
-                    break;
-            }
+            xfer_dcc_recv_file_end (xfer);
+            return WEECHAT_RC_OK;
         }
     }
+
+    /* send ACK to sender (if needed) */
+    if (xfer->send_ack && (xfer->pos > xfer->pos_last_ack))
+    {
+        switch (xfer_dcc_recv_file_send_ack (xfer))
+        {
+            case 0:
+                /* send error, socket down? */
+                xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                         XFER_ERROR_SEND_ACK);
+                return WEECHAT_RC_OK;
+            case 1:
+                /* send error, not fatal (buffer full?): disable ACKs */
+                xfer->send_ack = 0;
+                break;
+            case 2:
+                /* send OK: save position in file as last ACK sent */
+                xfer->pos_last_ack = xfer->pos;
+                break;
+        }
+    }
+
+    xfer_network_progress (xfer);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Starts receiving a file with DCC protocol (local file is opened): hashes
+ * the part of file already received (if resuming), then connects to sender.
+ */
+
+void
+xfer_dcc_recv_file_start (struct t_xfer *xfer)
+{
+    /* if resuming, hash the portion of the file we have */
+    if ((xfer->start_resume > 0) && xfer->hash_handle)
+    {
+        xfer_network_set_status (xfer, XFER_STATUS_HASHING, XFER_NO_ERROR);
+        xfer->hash_pos = 0;
+        xfer->hook_timer_transfer = weechat_hook_timer (
+            1, 0, 0,
+            &xfer_dcc_resume_hash_timer_cb, xfer, NULL);
+        return;
+    }
+
+    xfer_dcc_recv_file_connect (xfer);
 }
@@ -20,7 +20,16 @@
 #ifndef WEECHAT_PLUGIN_XFER_DCC_H
 #define WEECHAT_PLUGIN_XFER_DCC_H
 
-extern void xfer_dcc_send_file_child (struct t_xfer *xfer);
-extern void xfer_dcc_recv_file_child (struct t_xfer *xfer);
+#define XFER_DCC_MAX_LOOPS        64       /* max blocks sent/received by */
+                                           /* call of fd callback         */
+#define XFER_DCC_SPLICE_SIZE      65536    /* max bytes moved by splice   */
+#define XFER_DCC_HASH_SIZE        (1024 * 1024) /* bytes hashed by timer  */
+#define XFER_DCC_SEND_DONE_DELAY  3000     /* delay to wait final ACK     */
+                                           /* after end of send (in ms)   */
+
+extern void xfer_dcc_send_file_blocks (struct t_xfer *xfer);
+extern void xfer_dcc_send_file_start (struct t_xfer *xfer);
+extern int xfer_dcc_recv_file_fd_cb (const void *pointer, void *data, int fd);
+extern void xfer_dcc_recv_file_start (struct t_xfer *xfer);
 
 #endif /* WEECHAT_PLUGIN_XFER_DCC_H */
@@ -26,10 +26,8 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
-#include <signal.h>
 #include <time.h>
 #include <netdb.h>
 
@@ -43,216 +41,159 @@
 
 
 /*
- * Creates pipe for communication with child process.
- *
- * Returns:
- *   1: OK
- *   0: error
+ * Closes pipe used to move data with splice.
  */
 
-int
-xfer_network_create_pipe (struct t_xfer *xfer)
+void
+xfer_network_close_pipe (struct t_xfer *xfer)
 {
-    int child_pipe[2];
-
-    if (pipe (child_pipe) < 0)
+    if (xfer->splice_read != -1)
     {
-        weechat_printf (NULL,
-                        _("%s%s: unable to create pipe: error %d %s"),
-                        weechat_prefix ("error"), XFER_PLUGIN_NAME,
-                        errno, strerror (errno));
-        xfer_close (xfer, XFER_STATUS_FAILED);
-        xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-        return 0;
+        close (xfer->splice_read);
+        xfer->splice_read = -1;
+    }
+    if (xfer->splice_write != -1)
+    {
+        close (xfer->splice_write);
+        xfer->splice_write = -1;
     }
-
-    xfer->child_read = child_pipe[0];
-    xfer->child_write = child_pipe[1];
-
-    return 1;
 }
 
 /*
- * Writes data into pipe.
+ * Sets new status of a file transfer, displays error (if any) and refreshes
+ * xfer buffer.
+ *
+ * If status is "done" or "failed", the xfer is closed: caller must not use
+ * hooks of xfer after this call.
  */
 
 void
-xfer_network_write_pipe (struct t_xfer *xfer, int status, int error)
+xfer_network_set_status (struct t_xfer *xfer, int status, int error)
 {
-    char buffer[1 + 1 + 32 + 1];   /* status + error + pos + \0 */
-    int num_written;
+    xfer->last_activity = time (NULL);
+    xfer_file_calculate_speed (xfer, 0);
 
-    snprintf (buffer, sizeof (buffer), "%c%c%032llu",
-              status + '0', error + '0', xfer->pos);
-    num_written = write (xfer->child_write, buffer, sizeof (buffer));
-    (void) num_written;
+    /* display error */
+    switch (error)
+    {
+        /* errors for sender */
+        case XFER_ERROR_READ_LOCAL:
+            weechat_printf (NULL,
+                            _("%s%s: unable to read local file"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            break;
+        case XFER_ERROR_SEND_BLOCK:
+            weechat_printf (NULL,
+                            _("%s%s: unable to send block to receiver"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            break;
+        case XFER_ERROR_READ_ACK:
+            weechat_printf (NULL,
+                            _("%s%s: unable to read ACK from receiver"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            break;
+        /* errors for receiver */
+        case XFER_ERROR_CONNECT_SENDER:
+            weechat_printf (NULL,
+                            _("%s%s: unable to connect to sender"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            break;
+        case XFER_ERROR_RECV_BLOCK:
+            weechat_printf (NULL,
+                            _("%s%s: unable to receive block from sender"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            break;
+        case XFER_ERROR_WRITE_LOCAL:
+            weechat_printf (NULL,
+                            _("%s%s: unable to write local file"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            break;
+        case XFER_ERROR_SEND_ACK:
+            weechat_printf (NULL,
+                            _("%s%s: unable to send ACK to sender"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            break;
+        case XFER_ERROR_HASH_MISMATCH:
+            weechat_printf (NULL,
+                            _("%s%s: wrong CRC32 for file %s"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME,
+                            xfer->filename);
+            xfer->hash_status = XFER_HASH_STATUS_MISMATCH;
+            break;
+        case XFER_ERROR_HASH_RESUME_ERROR:
+            weechat_printf (NULL,
+                            _("%s%s: CRC32 error while resuming"),
+                            weechat_prefix ("error"), XFER_PLUGIN_NAME);
+            xfer->hash_status = XFER_HASH_STATUS_RESUME_ERROR;
+            break;
+    }
+
+    /* set new status */
+    switch (status)
+    {
+        case XFER_STATUS_CONNECTING:
+            xfer->status = XFER_STATUS_CONNECTING;
+            xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
+            break;
+        case XFER_STATUS_ACTIVE:
+            if (xfer->status == XFER_STATUS_CONNECTING)
+            {
+                /* connection successful, init transfer times */
+                xfer->status = XFER_STATUS_ACTIVE;
+                xfer->start_transfer = time (NULL);
+                xfer->last_check_time = time (NULL);
+                xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
+            }
+            else
+                xfer_buffer_refresh (WEECHAT_HOTLIST_LOW);
+            break;
+        case XFER_STATUS_DONE:
+            xfer_close (xfer, XFER_STATUS_DONE);
+            xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
+            break;
+        case XFER_STATUS_FAILED:
+            xfer_close (xfer, XFER_STATUS_FAILED);
+            xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
+            break;
+        case XFER_STATUS_HASHING:
+            xfer->status = XFER_STATUS_HASHING;
+            xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
+            break;
+        case XFER_STATUS_HASHED:
+            if (error == XFER_NO_ERROR)
+                xfer->hash_status = XFER_HASH_STATUS_MATCH;
+            xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
+            break;
+    }
 }
 
 /*
- * Reads data from child via pipe.
+ * Reports progress of an active file transfer (at most once per second).
  */
 
-int
-xfer_network_child_read_cb (const void *pointer, void *data, int fd)
+void
+xfer_network_progress (struct t_xfer *xfer)
 {
-    struct t_xfer *xfer;
-    char bufpipe[1 + 1 + 32 + 1];
-    int num_read;
+    time_t time_now;
 
-    /* make C compiler happy */
-    (void) data;
-    (void) fd;
-
-    xfer = (struct t_xfer *)pointer;
-
-    num_read = read (xfer->child_read, bufpipe, sizeof (bufpipe));
-    if (num_read > 0)
+    time_now = time (NULL);
+    xfer->last_activity = time_now;
+    if (time_now != xfer->last_refresh)
     {
-        sscanf (bufpipe + 2, "%llu", &xfer->pos);
-        xfer->last_activity = time (NULL);
-        xfer_file_calculate_speed (xfer, 0);
-
-        /* read error code */
-        switch (bufpipe[1] - '0')
-        {
-            /* errors for sender */
-            case XFER_ERROR_READ_LOCAL:
-                weechat_printf (NULL,
-                                _("%s%s: unable to read local file"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                break;
-            case XFER_ERROR_SEND_BLOCK:
-                weechat_printf (NULL,
-                                _("%s%s: unable to send block to receiver"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                break;
-            case XFER_ERROR_READ_ACK:
-                weechat_printf (NULL,
-                                _("%s%s: unable to read ACK from receiver"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                break;
-            /* errors for receiver */
-            case XFER_ERROR_CONNECT_SENDER:
-                weechat_printf (NULL,
-                                _("%s%s: unable to connect to sender"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                break;
-            case XFER_ERROR_RECV_BLOCK:
-                weechat_printf (NULL,
-                                _("%s%s: unable to receive block from sender"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                break;
-            case XFER_ERROR_WRITE_LOCAL:
-                weechat_printf (NULL,
-                                _("%s%s: unable to write local file"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                break;
-            case XFER_ERROR_SEND_ACK:
-                weechat_printf (NULL,
-                                _("%s%s: unable to send ACK to sender"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                break;
-            case XFER_ERROR_HASH_MISMATCH:
-                weechat_printf (NULL,
-                                _("%s%s: wrong CRC32 for file %s"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME,
-                                xfer->filename);
-                xfer->hash_status = XFER_HASH_STATUS_MISMATCH;
-                break;
-            case XFER_ERROR_HASH_RESUME_ERROR:
-                weechat_printf (NULL,
-                                _("%s%s: CRC32 error while resuming"),
-                                weechat_prefix ("error"), XFER_PLUGIN_NAME);
-                xfer->hash_status = XFER_HASH_STATUS_RESUME_ERROR;
-                break;
-        }
-
-        /* read new DCC status */
-        switch (bufpipe[0] - '0')
-        {
-            case XFER_STATUS_CONNECTING:
-                xfer->status = XFER_STATUS_CONNECTING;
-                xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-                break;
-            case XFER_STATUS_ACTIVE:
-                if (xfer->status == XFER_STATUS_CONNECTING)
-                {
-                    /* connection was successful by child, init transfer times */
-                    xfer->status = XFER_STATUS_ACTIVE;
-                    xfer->start_transfer = time (NULL);
-                    xfer->last_check_time = time (NULL);
-                    xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-                }
-                else
-                    xfer_buffer_refresh (WEECHAT_HOTLIST_LOW);
-                break;
-            case XFER_STATUS_DONE:
-                xfer_close (xfer, XFER_STATUS_DONE);
-                xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-                break;
-            case XFER_STATUS_FAILED:
-                xfer_close (xfer, XFER_STATUS_FAILED);
-                xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-                break;
-            case XFER_STATUS_HASHING:
-                xfer->status = XFER_STATUS_HASHING;
-                xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-                break;
-            case XFER_STATUS_HASHED:
-                if (bufpipe[1] - '0' == XFER_NO_ERROR)
-                    xfer->hash_status = XFER_HASH_STATUS_MATCH;
-                xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-                break;
-        }
+        xfer->last_refresh = time_now;
+        xfer_network_set_status (xfer, XFER_STATUS_ACTIVE, XFER_NO_ERROR);
     }
-
-    return WEECHAT_RC_OK;
 }
 
 /*
- * Forks process for sending file.
+ * Starts sending a file (the socket is connected to receiver).
  */
 
 void
-xfer_network_send_file_fork (struct t_xfer *xfer)
+xfer_network_send_file_start (struct t_xfer *xfer)
 {
-    pid_t pid;
-    int rc;
-
-    if (!xfer_network_create_pipe (xfer))
-        return;
-
     xfer->file = open (xfer->local_filename, O_RDONLY | O_NONBLOCK, 0644);
 
-    switch (pid = fork ())
-    {
-        case -1:  /* fork failed */
-            weechat_printf (NULL,
-                            _("%s%s: unable to fork (%s)"),
-                            weechat_prefix ("error"),
-                            XFER_PLUGIN_NAME,
-                            strerror (errno));
-            xfer_close (xfer, XFER_STATUS_FAILED);
-            xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-            return;
-        case 0:  /* child process */
-            rc = setuid (getuid ());
-            (void) rc;
-            close (xfer->child_read);
-            switch (xfer->protocol)
-            {
-                case XFER_NO_PROTOCOL:
-                    _exit (EXIT_SUCCESS);
-                    break;
-                case XFER_PROTOCOL_DCC:
-                    xfer_dcc_send_file_child (xfer);
-                    break;
-                case XFER_NUM_PROTOCOLS:
-                    break;
-            }
-            _exit (EXIT_SUCCESS);
-    }
-
     weechat_printf (NULL,
                     _("%s: sending file to %s (%s, %s.%s), "
                       "name: %s (local filename: %s), %llu bytes (protocol: %s)"),
@@ -266,101 +207,65 @@ xfer_network_send_file_fork (struct t_xfer *xfer)
                     xfer->size,
                     xfer_protocol_string[xfer->protocol]);
 
-    /* parent process */
-    xfer->child_pid = pid;
-    close (xfer->child_write);
-    xfer->child_write = -1;
-    xfer->hook_fd = weechat_hook_fd (xfer->child_read,
-                                     1, 0, 0,
-                                     &xfer_network_child_read_cb,
-                                     xfer, NULL);
+    if (xfer->file < 0)
+    {
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_READ_LOCAL);
+        return;
+    }
+
+    switch (xfer->protocol)
+    {
+        case XFER_NO_PROTOCOL:
+            break;
+        case XFER_PROTOCOL_DCC:
+            xfer_dcc_send_file_start (xfer);
+            break;
+        case XFER_NUM_PROTOCOLS:
+            break;
+    }
 }
 
 /*
- * Forks process for receiving file.
+ * Starts receiving a file: opens local file and connects to sender.
  */
 
 void
-xfer_network_recv_file_fork (struct t_xfer *xfer)
+xfer_network_recv_file_start (struct t_xfer *xfer)
 {
-    pid_t pid;
-    int rc;
-
-    if (!xfer_network_create_pipe (xfer))
-        return;
-
+    /*
+     * the file is not opened with O_APPEND when resuming (this is not
+     * allowed by splice): the position is set at the end of file
+     */
     if (xfer->start_resume > 0)
-        xfer->file = open (xfer->local_filename,
-                           O_APPEND | O_WRONLY | O_NONBLOCK);
+    {
+        xfer->file = open (xfer->local_filename, O_RDWR | O_NONBLOCK);
+        if (xfer->file >= 0)
+            lseek (xfer->file, 0, SEEK_END);
+    }
     else
+    {
         xfer->file = open (xfer->local_filename,
                            O_CREAT | O_TRUNC | O_WRONLY | O_NONBLOCK,
                            0644);
-
-    switch (pid = fork ())
-    {
-        case -1:  /* fork failed */
-            weechat_printf (NULL,
-                            _("%s%s: unable to fork (%s)"),
-                            weechat_prefix ("error"),
-                            XFER_PLUGIN_NAME,
-                            strerror (errno));
-            xfer_close (xfer, XFER_STATUS_FAILED);
-            xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-            return;
-        case 0:  /* child process */
-            rc = setuid (getuid ());
-            (void) rc;
-            close (xfer->child_read);
-            switch (xfer->protocol)
-            {
-                case XFER_NO_PROTOCOL:
-                    _exit (EXIT_SUCCESS);
-                    break;
-                case XFER_PROTOCOL_DCC:
-                    xfer_dcc_recv_file_child (xfer);
-                    break;
-                case XFER_NUM_PROTOCOLS:
-                    break;
-            }
-            _exit (EXIT_SUCCESS);
     }
 
-    /* parent process */
-    xfer->child_pid = pid;
-    close (xfer->child_write);
-    xfer->child_write = -1;
-    xfer->hook_fd = weechat_hook_fd (xfer->child_read,
-                                     1, 0, 0,
-                                     &xfer_network_child_read_cb,
-                                     xfer, NULL);
-}
-
-/*
- * Kills child process and closes pipe.
- */
-
-void
-xfer_network_child_kill (struct t_xfer *xfer)
-{
-    /* kill process */
-    if (xfer->child_pid > 0)
+    if (xfer->file < 0)
     {
-        kill (xfer->child_pid, SIGKILL);
-        waitpid (xfer->child_pid, NULL, 0);
-        xfer->child_pid = 0;
+        xfer_network_set_status (xfer, XFER_STATUS_FAILED,
+                                 XFER_ERROR_WRITE_LOCAL);
+        return;
     }
 
-    /* close pipe used with child */
-    if (xfer->child_read != -1)
-    {
-        close (xfer->child_read);
-        xfer->child_read = -1;
-    }
-    if (xfer->child_write != -1)
+    switch (xfer->protocol)
     {
-        close (xfer->child_write);
-        xfer->child_write = -1;
+        case XFER_NO_PROTOCOL:
+            break;
+        case XFER_PROTOCOL_DCC:
+            xfer_dcc_recv_file_start (xfer);
+            break;
+        case XFER_NUM_PROTOCOLS:
+            break;
     }
 }
 
@@ -435,7 +340,7 @@ xfer_network_fd_cb (const void *pointer, void *data, int fd)
             xfer->status = XFER_STATUS_ACTIVE;
             xfer->start_transfer = time (NULL);
             xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
-            xfer_network_send_file_fork (xfer);
+            xfer_network_send_file_start (xfer);
         }
     }
 
@@ -514,6 +419,9 @@ xfer_network_timer_cb (const void *pointer, void *data, int remaining_calls)
 
     xfer = (struct t_xfer *)pointer;
 
+    /* timer is removed after this call */
+    xfer->hook_timer = NULL;
+
     if ((xfer->status == XFER_STATUS_WAITING)
         || (xfer->status == XFER_STATUS_CONNECTING))
     {
@@ -724,7 +632,7 @@ xfer_network_connect (struct t_xfer *xfer)
                                                    xfer, NULL);
     }
 
-    /* for file receiving, connection is made in child process (blocking) */
+    /* for file receiving, connection is made by xfer_dcc_recv_file_start */
 
     return 1;
 }
@@ -742,11 +650,11 @@ xfer_network_connect_init (struct t_xfer *xfer)
     }
     else
     {
-        /* for a file: launch child process */
-        if (XFER_IS_FILE(xfer->type))
-            xfer_network_recv_file_fork (xfer);
-
         xfer->status = XFER_STATUS_CONNECTING;
+
+        /* for a file: open local file and connect to sender */
+        if (XFER_IS_FILE(xfer->type))
+            xfer_network_recv_file_start (xfer);
     }
     xfer_buffer_refresh (WEECHAT_HOTLIST_MESSAGE);
 }
@@ -20,10 +20,13 @@
 #ifndef WEECHAT_PLUGIN_XFER_NETWORK_H
 #define WEECHAT_PLUGIN_XFER_NETWORK_H
 
-extern void xfer_network_write_pipe (struct t_xfer *xfer, int status,
+extern void xfer_network_close_pipe (struct t_xfer *xfer);
+extern void xfer_network_set_status (struct t_xfer *xfer, int status,
                                      int error);
+extern void xfer_network_progress (struct t_xfer *xfer);
+extern void xfer_network_send_file_start (struct t_xfer *xfer);
+extern void xfer_network_recv_file_start (struct t_xfer *xfer);
 extern void xfer_network_connect_init (struct t_xfer *xfer);
-extern void xfer_network_child_kill (struct t_xfer *xfer);
 extern int xfer_network_connect (struct t_xfer *xfer);
 extern void xfer_network_accept (struct t_xfer *xfer);
 
@@ -302,12 +302,18 @@ xfer_close (struct t_xfer *xfer, enum t_xfer_status status)
         {
             weechat_unhook (xfer->hook_fd);
             xfer->hook_fd = NULL;
+            xfer->hook_fd_write = 0;
         }
         if (xfer->hook_timer)
         {
             weechat_unhook (xfer->hook_timer);
             xfer->hook_timer = NULL;
         }
+        if (xfer->hook_timer_transfer)
+        {
+            weechat_unhook (xfer->hook_timer_transfer);
+            xfer->hook_timer_transfer = NULL;
+        }
         if (xfer->hook_connect)
         {
             weechat_unhook (xfer->hook_connect);
@@ -324,7 +330,7 @@ xfer_close (struct t_xfer *xfer, enum t_xfer_status status)
                             xfer->remote_nick,
                             xfer->remote_address_str,
                             (xfer->status == XFER_STATUS_DONE) ? _("OK") : _("FAILED"));
-            xfer_network_child_kill (xfer);
+            xfer_network_close_pipe (xfer);
         }
     }
     if (xfer->status == XFER_STATUS_ABORTED)
@@ -489,11 +495,12 @@ xfer_alloc ()
     new_xfer->start_time = time_now;
     new_xfer->start_transfer = time_now;
     new_xfer->sock = -1;
-    new_xfer->child_pid = 0;
-    new_xfer->child_read = -1;
-    new_xfer->child_write = -1;
+    new_xfer->splice_read = -1;
+    new_xfer->splice_write = -1;
     new_xfer->hook_fd = NULL;
+    new_xfer->hook_fd_write = 0;
     new_xfer->hook_timer = NULL;
+    new_xfer->hook_timer_transfer = NULL;
     new_xfer->hook_connect = NULL;
     new_xfer->unterminated_message = NULL;
     new_xfer->file = -1;
@@ -501,6 +508,13 @@ xfer_alloc ()
     new_xfer->filename_suffix = -1;
     new_xfer->pos = 0;
     new_xfer->ack = 0;
+    new_xfer->ack_buffer_size = 0;
+    new_xfer->pos_last_ack = 0;
+    new_xfer->hash_pos = 0;
+    new_xfer->speed_tokens = 0;
+    new_xfer->speed_last_refill.tv_sec = 0;
+    new_xfer->speed_last_refill.tv_usec = 0;
+    new_xfer->last_refresh = 0;
     new_xfer->send_ack = weechat_config_boolean (xfer_config_network_send_ack);
     new_xfer->start_resume = 0;
     new_xfer->last_check_time = time_now;
@@ -1633,16 +1647,18 @@ xfer_add_to_infolist (struct t_infolist *infolist, struct t_xfer *xfer)
         return 0;
     if (!weechat_infolist_new_var_integer (ptr_item, "sock", xfer->sock))
         return 0;
-    if (!weechat_infolist_new_var_integer (ptr_item, "child_pid", xfer->child_pid))
+    if (!weechat_infolist_new_var_integer (ptr_item, "splice_read", xfer->splice_read))
         return 0;
-    if (!weechat_infolist_new_var_integer (ptr_item, "child_read", xfer->child_read))
-        return 0;
-    if (!weechat_infolist_new_var_integer (ptr_item, "child_write", xfer->child_write))
+    if (!weechat_infolist_new_var_integer (ptr_item, "splice_write", xfer->splice_write))
         return 0;
     if (!weechat_infolist_new_var_pointer (ptr_item, "hook_fd", xfer->hook_fd))
         return 0;
+    if (!weechat_infolist_new_var_integer (ptr_item, "hook_fd_write", xfer->hook_fd_write))
+        return 0;
     if (!weechat_infolist_new_var_pointer (ptr_item, "hook_timer", xfer->hook_timer))
         return 0;
+    if (!weechat_infolist_new_var_pointer (ptr_item, "hook_timer_transfer", xfer->hook_timer_transfer))
+        return 0;
     if (!weechat_infolist_new_var_pointer (ptr_item, "hook_connect", xfer->hook_connect))
         return 0;
     if (!weechat_infolist_new_var_string (ptr_item, "unterminated_message", xfer->unterminated_message))
@@ -1659,6 +1675,15 @@ xfer_add_to_infolist (struct t_infolist *infolist, struct t_xfer *xfer)
     snprintf (value, sizeof (value), "%llu", xfer->ack);
     if (!weechat_infolist_new_var_string (ptr_item, "ack", value))
         return 0;
+    snprintf (value, sizeof (value), "%llu", xfer->pos_last_ack);
+    if (!weechat_infolist_new_var_string (ptr_item, "pos_last_ack", value))
+        return 0;
+    snprintf (value, sizeof (value), "%llu", xfer->hash_pos);
+    if (!weechat_infolist_new_var_string (ptr_item, "hash_pos", value))
+        return 0;
+    snprintf (value, sizeof (value), "%lld", xfer->speed_tokens);
+    if (!weechat_infolist_new_var_string (ptr_item, "speed_tokens", value))
+        return 0;
     snprintf (value, sizeof (value), "%llu", xfer->start_resume);
     if (!weechat_infolist_new_var_string (ptr_item, "start_resume", value))
         return 0;
@@ -1730,11 +1755,12 @@ xfer_print_log ()
         weechat_log_printf ("  start_time. . . . . . . : %lld",  (long long)ptr_xfer->start_time);
         weechat_log_printf ("  start_transfer. . . . . : %lld",  (long long)ptr_xfer->start_transfer);
         weechat_log_printf ("  sock. . . . . . . . . . : %d",    ptr_xfer->sock);
-        weechat_log_printf ("  child_pid . . . . . . . : %d",    ptr_xfer->child_pid);
-        weechat_log_printf ("  child_read. . . . . . . : %d",    ptr_xfer->child_read);
-        weechat_log_printf ("  child_write . . . . . . : %d",    ptr_xfer->child_write);
+        weechat_log_printf ("  splice_read . . . . . . : %d",    ptr_xfer->splice_read);
+        weechat_log_printf ("  splice_write. . . . . . : %d",    ptr_xfer->splice_write);
         weechat_log_printf ("  hook_fd . . . . . . . . : 0x%lx", ptr_xfer->hook_fd);
+        weechat_log_printf ("  hook_fd_write . . . . . : %d",    ptr_xfer->hook_fd_write);
         weechat_log_printf ("  hook_timer. . . . . . . : 0x%lx", ptr_xfer->hook_timer);
+        weechat_log_printf ("  hook_timer_transfer . . : 0x%lx", ptr_xfer->hook_timer_transfer);
         weechat_log_printf ("  hook_connect. . . . . . : 0x%lx", ptr_xfer->hook_connect);
         weechat_log_printf ("  unterminated_message. . : '%s'",  ptr_xfer->unterminated_message);
         weechat_log_printf ("  file. . . . . . . . . . : %d",    ptr_xfer->file);
@@ -1742,6 +1768,11 @@ xfer_print_log ()
         weechat_log_printf ("  filename_suffix . . . . : %d",    ptr_xfer->filename_suffix);
         weechat_log_printf ("  pos . . . . . . . . . . : %llu",  ptr_xfer->pos);
         weechat_log_printf ("  ack . . . . . . . . . . : %llu",  ptr_xfer->ack);
+        weechat_log_printf ("  ack_buffer_size . . . . : %d",    ptr_xfer->ack_buffer_size);
+        weechat_log_printf ("  pos_last_ack. . . . . . : %llu",  ptr_xfer->pos_last_ack);
+        weechat_log_printf ("  hash_pos. . . . . . . . : %llu",  ptr_xfer->hash_pos);
+        weechat_log_printf ("  speed_tokens. . . . . . : %lld",  ptr_xfer->speed_tokens);
+        weechat_log_printf ("  last_refresh. . . . . . : %lld",  (long long)ptr_xfer->last_refresh);
         weechat_log_printf ("  start_resume. . . . . . : %llu",  ptr_xfer->start_resume);
         weechat_log_printf ("  last_check_time . . . . : %lld",  (long long)ptr_xfer->last_check_time);
         weechat_log_printf ("  last_check_pos. . . . . : %llu",  ptr_xfer->last_check_pos);
@@ -22,6 +22,7 @@
 
 #include <unistd.h>
 #include <time.h>
+#include <sys/time.h>
 #include <gcrypt.h>
 #include <sys/socket.h>
 
@@ -161,18 +162,27 @@ struct t_xfer
     time_t start_time;                 /* time when xfer started            */
     time_t start_transfer;             /* time when xfer transfer started   */
     int sock;                          /* socket for connection             */
-    pid_t child_pid;                   /* pid of child process (send/recv)  */
-    int child_read;                    /* to read into child pipe           */
-    int child_write;                   /* to write into child pipe          */
-    struct t_hook *hook_fd;            /* hook for socket or child pipe     */
+    int splice_read;                   /* pipe for splice (read)            */
+    int splice_write;                  /* pipe for splice (write)           */
+    struct t_hook *hook_fd;            /* hook for socket                   */
+    int hook_fd_write;                 /* 1 if hook_fd waits for write      */
     struct t_hook *hook_timer;         /* timeout for receiver accept       */
-    struct t_hook *hook_connect;       /* hook for connection to chat recv  */
+    struct t_hook *hook_timer_transfer; /* timer used during file transfer  */
+                                       /* (hash, speed limit, end of send)  */
+    struct t_hook *hook_connect;       /* hook for connection to remote host*/
     char *unterminated_message;        /* beginning of a message            */
     int file;                          /* local file (read or write)        */
     char *local_filename;              /* local filename (with path)        */
     int filename_suffix;               /* suffix (like .1) if renaming file */
     unsigned long long pos;            /* number of bytes received/sent     */
     unsigned long long ack;            /* number of bytes received OK       */
+    unsigned char ack_buffer[4];       /* partial ACK received (send file)  */
+    int ack_buffer_size;               /* number of bytes in ack_buffer     */
+    unsigned long long pos_last_ack;   /* position of last ACK (recv file)  */
+    unsigned long long hash_pos;       /* position in file (resume hash)    */
+    long long speed_tokens;            /* bytes allowed by speed limit      */
+    struct timeval speed_last_refill;  /* last time tokens were added       */
+    time_t last_refresh;               /* last refresh of xfer buffer       */
     unsigned long long start_resume;   /* start of resume (in bytes)        */
     time_t last_check_time;            /* last time we checked bytes snt/rcv*/
     unsigned long long last_check_pos; /* bytes sent/recv at last check     */
@@ -205,6 +215,7 @@ extern void xfer_set_remote_address (struct t_xfer *xfer,
 extern void xfer_set_local_address (struct t_xfer *xfer,
                                     const struct sockaddr *address,
                                     socklen_t length, const char *address_str);
+extern struct t_xfer *xfer_alloc ();
 extern void xfer_free (struct t_xfer *xfer);
 extern int xfer_add_to_infolist (struct t_infolist *infolist,
                                  struct t_xfer *xfer);
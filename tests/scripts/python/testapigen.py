@@ -27,6 +27,7 @@ This script can be run in WeeChat or as a standalone script
 It uses the following scripts:
 - unparse.py: convert Python code to other languages (including Python itself)
 - testapi.py: the WeeChat scripting API tests
+- testbench.py: the benchmark of callbacks in scripts
 """
 
 from __future__ import print_function
@@ -91,7 +92,8 @@ class WeechatScript(object):  # pylint: disable=too-many-instance-attributes
         self.output_dir = os.path.realpath(output_dir)
         self.language = language
         self.extension = extension
-        self.script_name = 'testapi.%s' % extension
+        self.script_name = '%s.%s' % (
+            os.path.splitext(os.path.basename(source_script))[0], extension)
         self.script_path = os.path.join(self.output_dir, self.script_name)
         self.comment_char = comment_char
         self.weechat_module = weechat_module
@@ -400,7 +402,8 @@ if __name__ == '__main__':
             SCRIPT_COMMAND,
             'Generate scripting API test scripts',
             'source_script output_dir',
-            'source_script: path to source script (testapi.py)\n'
+            'source_script: path to source script (testapi.py or '
+            'testbench.py)\n'
             '   output_dir: output directory for scripts',
             '',
             'testapigen_cmd_cb', '')
@@ -0,0 +1,42 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""
+This script is used to measure the speed of callbacks in scripts
+(it can not be run directly and can not be loaded in WeeChat).
+
+It is parsed by testapigen.py, like testapi.py, to generate scripts in all
+supported languages (Python, Perl, Ruby, ...).
+The signal "test_bench_signal" is then sent many times by the unit tests.
+"""
+
+# pylint: disable=unused-argument
+
+import weechat  # pylint: disable=import-error
+
+
+def bench_signal_cb(data, signal, signal_data):
+    """Callback for the benchmark signal."""
+    return weechat.WEECHAT_RC_OK
+
+
+def weechat_init():
+    """Main function."""
+    weechat.register('SCRIPT_NAME', 'SCRIPT_AUTHOR', 'SCRIPT_VERSION',
+                     'SCRIPT_LICENSE', 'SCRIPT_DESCRIPTION', '', '')
+    weechat.hook_signal('test_bench_signal', 'bench_signal_cb', 'data')
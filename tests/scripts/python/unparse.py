@@ -200,6 +200,13 @@ class UnparsePython(object):
                 comparator,
             )
 
+    def _ast_constant(self, node):
+        """Add an AST Constant in output (Python >= 3.8)."""
+        if isinstance(node.value, str):
+            self._ast_str(node)
+        else:
+            self._ast_num(node)
+
     def _ast_dict(self, node):
         """Add an AST Dict in output."""
         self.add(
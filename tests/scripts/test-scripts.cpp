@@ -36,6 +36,8 @@ extern "C"
 #include "src/plugins/plugin.h"
 }
 
+#define SCRIPTS_TEST_BENCHMARK_CALLBACKS 100000
+
 extern void run_cmd (const char *command);
 
 struct t_hook *api_hook_print = NULL;
@@ -111,6 +113,53 @@ TEST_GROUP(Scripts)
     {
         unhook (api_hook_print);
     }
+
+    /*
+     * Generates scripts in all languages from a python source script (in
+     * directory with test scripts), using script testapigen.py.
+     */
+
+    void generate_scripts (const char *test_scripts_dir,
+                           const char *source_script,
+                           const char *output_dir)
+    {
+        char path_testapigen[PATH_MAX], path_source[PATH_MAX];
+        char str_command[4096];
+
+        snprintf (path_testapigen, sizeof (path_testapigen),
+                  "%s%s%s",
+                  test_scripts_dir,
+                  DIR_SEPARATOR,
+                  "testapigen.py");
+        snprintf (path_source, sizeof (path_source),
+                  "%s%s%s",
+                  test_scripts_dir,
+                  DIR_SEPARATOR,
+                  source_script);
+
+        api_tests_ok = 0;
+        api_tests_errors = 0;
+
+        /* load generator script */
+        snprintf (str_command, sizeof (str_command),
+                  "/script load %s", path_testapigen);
+        run_cmd (str_command);
+
+        /* generate scripts */
+        snprintf (str_command, sizeof (str_command),
+                  "/testapigen %s %s",
+                  path_source,
+                  output_dir);
+        run_cmd (str_command);
+
+        /* check that there was no errors in script generation */
+        LONGS_EQUAL(0, api_tests_errors);
+
+        /* unload generator script */
+        snprintf (str_command, sizeof (str_command),
+                  "/script unload testapigen.py");
+        run_cmd (str_command);
+    }
 };
 
 /*
@@ -119,7 +168,6 @@ TEST_GROUP(Scripts)
 
 TEST(Scripts, API)
 {
-    char path_testapigen[PATH_MAX], path_testapi[PATH_MAX];
     char *path_testapi_output_dir, str_command[4096];
     char *test_scripts_dir;
     struct timeval time_start, time_end;
@@ -145,43 +193,12 @@ TEST(Scripts, API)
         (ptr_test_scripts_dir) ?
         ptr_test_scripts_dir : "../tests/scripts/python");
 
-    /* build paths for scripting API tests */
-    snprintf (path_testapigen, sizeof (path_testapigen),
-              "%s%s%s",
-              test_scripts_dir,
-              DIR_SEPARATOR,
-              "testapigen.py");
-    snprintf (path_testapi, sizeof (path_testapi),
-              "%s%s%s",
-              test_scripts_dir,
-              DIR_SEPARATOR,
-              "testapi.py");
     path_testapi_output_dir = string_eval_path_home ("%h/testapi",
                                                      NULL, NULL, NULL);
     CHECK(path_testapi_output_dir);
 
-    api_tests_ok = 0;
-    api_tests_errors = 0;
-
-    /* load generator script */
-    snprintf (str_command, sizeof (str_command),
-              "/script load %s", path_testapigen);
-    run_cmd (str_command);
-
     /* generate scripts to test API */
-    snprintf (str_command, sizeof (str_command),
-              "/testapigen %s %s",
-              path_testapi,
-              path_testapi_output_dir);
-    run_cmd (str_command);
-
-    /* check that there was no errors in script generation */
-    LONGS_EQUAL(0, api_tests_errors);
-
-    /* unload generator scritp */
-    snprintf (str_command, sizeof (str_command),
-              "/script unload testapigen.py");
-    run_cmd (str_command);
+    generate_scripts (test_scripts_dir, "testapi.py", path_testapi_output_dir);
 
     /* test the scripting API */
     for (i = 0; languages[i][0]; i++)
@@ -267,3 +284,103 @@ TEST(Scripts, API)
 
     printf ("TEST(Scripts, API)");
 }
+
+/*
+ * Tests scripting API: speed of callbacks (benchmark).
+ *
+ * A signal is sent many times and received by a callback in script, for each
+ * language (languages without plugin loaded are skipped).
+ */
+
+TEST(Scripts, Benchmark)
+{
+    char *path_testbench_output_dir, str_command[4096];
+    char *test_scripts_dir;
+    struct timeval time_start, time_end;
+    long long diff;
+    const char *ptr_test_scripts_dir;
+    const char *languages[][2] = {
+        { "python",     "py"  },
+        { "perl",       "pl"  },
+        { "ruby",       "rb"  },
+        { "lua",        "lua" },
+        { "tcl",        "tcl" },
+        { "guile",      "scm" },
+        { "javascript", "js"  },
+        { "php",        "php" },
+        { NULL,         NULL  }
+    };
+    int i, j, rc, count_ok;
+
+    printf ("...\n");
+
+    ptr_test_scripts_dir = getenv ("WEECHAT_TESTS_SCRIPTS_DIR");
+    test_scripts_dir = strdup (
+        (ptr_test_scripts_dir) ?
+        ptr_test_scripts_dir : "../tests/scripts/python");
+
+    path_testbench_output_dir = string_eval_path_home ("%h/testapi",
+                                                       NULL, NULL, NULL);
+    CHECK(path_testbench_output_dir);
+
+    /* generate scripts for benchmark */
+    generate_scripts (test_scripts_dir, "testbench.py",
+                      path_testbench_output_dir);
+
+    printf ("\n");
+    printf ("scripts benchmark (%d callbacks of signal):\n",
+            SCRIPTS_TEST_BENCHMARK_CALLBACKS);
+
+    for (i = 0; languages[i][0]; i++)
+    {
+        if (!plugin_search (languages[i][0]))
+        {
+            printf ("  %-10s : plugin not loaded\n", languages[i][0]);
+            continue;
+        }
+
+        api_tests_other = 0;
+
+        /* load script */
+        snprintf (str_command, sizeof (str_command),
+                  "/script load -q %s/testbench.%s",
+                  path_testbench_output_dir,
+                  languages[i][1]);
+        run_cmd (str_command);
+
+        /* send signal, received by script */
+        count_ok = 0;
+        gettimeofday (&time_start, NULL);
+        for (j = 0; j < SCRIPTS_TEST_BENCHMARK_CALLBACKS; j++)
+        {
+            rc = hook_signal_send ("test_bench_signal",
+                                   WEECHAT_HOOK_SIGNAL_POINTER,
+                                   api_hook_print);
+            if (rc == WEECHAT_RC_OK)
+                count_ok++;
+        }
+        gettimeofday (&time_end, NULL);
+        diff = util_timeval_diff (&time_start, &time_end);
+
+        printf ("  %-10s : %lld ms (%lld callbacks/s)\n",
+                languages[i][0],
+                diff / 1000,
+                (diff > 0) ?
+                (long long)SCRIPTS_TEST_BENCHMARK_CALLBACKS * 1000000LL / diff : 0);
+
+        /* unload script */
+        snprintf (str_command, sizeof (str_command),
+                  "/script unload -q testbench.%s",
+                  languages[i][1]);
+        run_cmd (str_command);
+
+        /* check that all callbacks were called without error */
+        LONGS_EQUAL(SCRIPTS_TEST_BENCHMARK_CALLBACKS, count_ok);
+        LONGS_EQUAL(0, api_tests_other);
+    }
+
+    free (path_testbench_output_dir);
+    free (test_scripts_dir);
+
+    printf ("TEST(Scripts, Benchmark)");
+}
@@ -20,6 +20,7 @@
  */
 
 #include <iostream>
+#include <dlfcn.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -55,15 +56,22 @@ extern "C"
 /* import tests from libs */
 IMPORT_TEST_GROUP(Plugins);
 IMPORT_TEST_GROUP(Arraylist);
+IMPORT_TEST_GROUP(ConfigFile);
 IMPORT_TEST_GROUP(Eval);
 IMPORT_TEST_GROUP(Hashtable);
+IMPORT_TEST_GROUP(Hook);
 IMPORT_TEST_GROUP(Hdata);
 IMPORT_TEST_GROUP(Infolist);
 IMPORT_TEST_GROUP(List);
 IMPORT_TEST_GROUP(String);
+IMPORT_TEST_GROUP(UpgradeFile);
 IMPORT_TEST_GROUP(Url);
 IMPORT_TEST_GROUP(Utf8);
 IMPORT_TEST_GROUP(Util);
+IMPORT_TEST_GROUP(BarItem);
+IMPORT_TEST_GROUP(Chat);
+IMPORT_TEST_GROUP(Line);
+IMPORT_TEST_GROUP(Nicklist);
 IMPORT_TEST_GROUP(Scripts);
 
 struct t_gui_buffer *ptr_core_buffer = NULL;
@@ -155,7 +163,8 @@ int
 main (int argc, char *argv[])
 {
     int rc, length, weechat_argc;
-    char *weechat_tests_args, *args, **weechat_argv;
+    char *weechat_tests_args, *args, **weechat_argv, *tests_plugins_lib;
+    void *handle;
 
     /* setup environment: English language, no specific timezone */
     setenv ("LC_ALL", LOCALE_TESTS, 1);
@@ -215,6 +224,19 @@ main (int argc, char *argv[])
         plugin_auto_load (0, NULL, 0, 1, 0);
     }
 
+    /* load tests of plugins (they need symbols of plugins loaded above) */
+    tests_plugins_lib = getenv ("WEECHAT_TESTS_PLUGINS_LIB");
+    if (tests_plugins_lib && tests_plugins_lib[0])
+    {
+        handle = dlopen (tests_plugins_lib, RTLD_GLOBAL | RTLD_NOW);
+        if (!handle)
+        {
+            gui_chat_printf (NULL,
+                             "WARNING: unable to load tests of plugins: %s",
+                             dlerror ());
+        }
+    }
+
     /* display WeeChat version and directories */
     run_cmd ("/command core version");
     run_cmd ("/debug dirs");
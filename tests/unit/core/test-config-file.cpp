@@ -0,0 +1,377 @@
+/*
+ * test-config-file.cpp - test configuration file functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "src/core/wee-config-file.h"
+#include "src/core/wee-hashtable.h"
+}
+
+#define TEST_CONFIG_NAME "test_config_file"
+
+TEST_GROUP(ConfigFile)
+{
+    struct t_config_file *config;
+    struct t_config_section *section1, *section2;
+
+    /*
+     * Creates a new section (without callbacks) in configuration file.
+     */
+
+    struct t_config_section *
+    new_section (const char *name)
+    {
+        return config_file_new_section (config, name, 1, 1,
+                                        NULL, NULL, NULL,
+                                        NULL, NULL, NULL,
+                                        NULL, NULL, NULL,
+                                        NULL, NULL, NULL,
+                                        NULL, NULL, NULL);
+    }
+
+    /*
+     * Creates a new option of type string (without callbacks).
+     *
+     * If ptr_config is NULL, the option is not searched before being added
+     * in section, so two options with same name can be added.
+     */
+
+    struct t_config_option *
+    new_option (struct t_config_file *ptr_config,
+                struct t_config_section *ptr_section,
+                const char *name)
+    {
+        return config_file_new_option (ptr_config, ptr_section, name,
+                                       "string", "test option",
+                                       NULL, 0, 0, "", "", 0,
+                                       NULL, NULL, NULL,
+                                       NULL, NULL, NULL,
+                                       NULL, NULL, NULL);
+    }
+
+    /*
+     * Checks that options of a section are sorted by name and returns the
+     * names of options, separated by commas.
+     */
+
+    void
+    options_names (struct t_config_section *ptr_section, char *names,
+                   int size)
+    {
+        struct t_config_option *ptr_option;
+
+        names[0] = '\0';
+        for (ptr_option = ptr_section->options; ptr_option;
+             ptr_option = ptr_option->next_option)
+        {
+            if (ptr_option->prev_option)
+            {
+                POINTERS_EQUAL(ptr_option->prev_option->next_option,
+                               ptr_option);
+                CHECK(strcasecmp (ptr_option->prev_option->name,
+                                  ptr_option->name) <= 0);
+                strncat (names, ",", size - strlen (names) - 1);
+            }
+            else
+            {
+                POINTERS_EQUAL(ptr_section->options, ptr_option);
+            }
+            if (!ptr_option->next_option)
+                POINTERS_EQUAL(ptr_section->last_option, ptr_option);
+            strncat (names, ptr_option->name, size - strlen (names) - 1);
+        }
+    }
+
+    void setup ()
+    {
+        config = config_file_new (NULL, TEST_CONFIG_NAME, NULL, NULL, NULL);
+        CHECK(config);
+        section1 = new_section ("section1");
+        CHECK(section1);
+        section2 = new_section ("section2");
+        CHECK(section2);
+    }
+
+    void teardown ()
+    {
+        config_file_free (config);
+        config = NULL;
+    }
+};
+
+/*
+ * Tests functions:
+ *   config_file_search_section
+ *   config_file_search_option
+ *   config_file_search_with_string
+ */
+
+TEST(ConfigFile, Search)
+{
+    struct t_config_file *ptr_config;
+    struct t_config_section *ptr_section;
+    struct t_config_option *option1, *option2, *ptr_option;
+    char *pos_option_name;
+
+    option1 = new_option (config, section1, "option1");
+    CHECK(option1);
+    option2 = new_option (config, section2, "Option2");
+    CHECK(option2);
+
+    /* option with same name (case insensitive) is rejected */
+    POINTERS_EQUAL(NULL, new_option (config, section1, "OPTION1"));
+
+    /* search section */
+    POINTERS_EQUAL(NULL, config_file_search_section (NULL, "section1"));
+    POINTERS_EQUAL(NULL, config_file_search_section (config, NULL));
+    POINTERS_EQUAL(NULL, config_file_search_section (config, "xxx"));
+    POINTERS_EQUAL(section1, config_file_search_section (config, "section1"));
+    POINTERS_EQUAL(section1, config_file_search_section (config, "SECTION1"));
+    POINTERS_EQUAL(section2, config_file_search_section (config, "Section2"));
+
+    /* search option in section */
+    POINTERS_EQUAL(NULL, config_file_search_option (config, section1, NULL));
+    POINTERS_EQUAL(NULL, config_file_search_option (config, section1, "xxx"));
+    POINTERS_EQUAL(NULL,
+                   config_file_search_option (config, section1, "option2"));
+    POINTERS_EQUAL(option1,
+                   config_file_search_option (config, section1, "option1"));
+    POINTERS_EQUAL(option1,
+                   config_file_search_option (config, section1, "OPTION1"));
+    POINTERS_EQUAL(option2,
+                   config_file_search_option (config, section2, "option2"));
+    POINTERS_EQUAL(option2,
+                   config_file_search_option (config, section2, "OpTiOn2"));
+
+    /* search option in all sections */
+    POINTERS_EQUAL(NULL, config_file_search_option (NULL, NULL, "option1"));
+    POINTERS_EQUAL(option1, config_file_search_option (config, NULL, "Option1"));
+    POINTERS_EQUAL(option2, config_file_search_option (config, NULL, "OPTION2"));
+
+    /* search with full name of option */
+    config_file_search_with_string (TEST_CONFIG_NAME ".section1.option1",
+                                    &ptr_config, &ptr_section, &ptr_option,
+                                    &pos_option_name);
+    POINTERS_EQUAL(config, ptr_config);
+    POINTERS_EQUAL(section1, ptr_section);
+    POINTERS_EQUAL(option1, ptr_option);
+    STRCMP_EQUAL("option1", pos_option_name);
+
+    config_file_search_with_string ("TEST_CONFIG_FILE.SECTION2.OPTION2",
+                                    &ptr_config, &ptr_section, &ptr_option,
+                                    &pos_option_name);
+    POINTERS_EQUAL(config, ptr_config);
+    POINTERS_EQUAL(section2, ptr_section);
+    POINTERS_EQUAL(option2, ptr_option);
+    STRCMP_EQUAL("OPTION2", pos_option_name);
+
+    config_file_search_with_string (TEST_CONFIG_NAME ".section1.option2",
+                                    &ptr_config, &ptr_section, &ptr_option,
+                                    &pos_option_name);
+    POINTERS_EQUAL(config, ptr_config);
+    POINTERS_EQUAL(section1, ptr_section);
+    POINTERS_EQUAL(NULL, ptr_option);
+
+    config_file_search_with_string (TEST_CONFIG_NAME ".xxx.option1",
+                                    &ptr_config, &ptr_section, &ptr_option,
+                                    NULL);
+    POINTERS_EQUAL(config, ptr_config);
+    POINTERS_EQUAL(NULL, ptr_section);
+    POINTERS_EQUAL(NULL, ptr_option);
+}
+
+/*
+ * Tests functions:
+ *   config_file_option_rename
+ */
+
+TEST(ConfigFile, SearchAfterRename)
+{
+    struct t_config_option *option1, *option2;
+    char names[256];
+
+    option1 = new_option (config, section1, "aaa");
+    CHECK(option1);
+    option2 = new_option (config, section1, "mmm");
+    CHECK(option2);
+
+    /* rename to a name after the other option */
+    config_file_option_rename (option1, "zzz");
+    STRCMP_EQUAL("zzz", option1->name);
+    POINTERS_EQUAL(NULL, config_file_search_option (config, section1, "aaa"));
+    POINTERS_EQUAL(option1, config_file_search_option (config, section1, "zzz"));
+    POINTERS_EQUAL(option1, config_file_search_option (config, section1, "ZZZ"));
+    POINTERS_EQUAL(option2, config_file_search_option (config, section1, "mmm"));
+    options_names (section1, names, sizeof (names));
+    STRCMP_EQUAL("mmm,zzz", names);
+
+    /* rename to a name before the other option */
+    config_file_option_rename (option1, "Bbb");
+    POINTERS_EQUAL(NULL, config_file_search_option (config, section1, "zzz"));
+    POINTERS_EQUAL(option1, config_file_search_option (config, section1, "bbb"));
+    options_names (section1, names, sizeof (names));
+    STRCMP_EQUAL("Bbb,mmm", names);
+
+    /* rename with only a change of case is ignored (name already exists) */
+    config_file_option_rename (option1, "BBB");
+    STRCMP_EQUAL("Bbb", option1->name);
+    POINTERS_EQUAL(option1, config_file_search_option (config, section1, "bbb"));
+
+    /* rename to the name of another option is not allowed */
+    config_file_option_rename (option1, "MMM");
+    STRCMP_EQUAL("Bbb", option1->name);
+    POINTERS_EQUAL(option1, config_file_search_option (config, section1, "bbb"));
+    POINTERS_EQUAL(option2, config_file_search_option (config, section1, "mmm"));
+    options_names (section1, names, sizeof (names));
+    STRCMP_EQUAL("Bbb,mmm", names);
+}
+
+/*
+ * Tests functions:
+ *   config_file_option_free
+ *   config_file_section_free
+ */
+
+TEST(ConfigFile, SearchAfterFree)
+{
+    struct t_config_option *option1, *option2, *option3, *dup1, *dup2;
+    char names[256];
+
+    option1 = new_option (config, section1, "option1");
+    option2 = new_option (config, section1, "option2");
+    option3 = new_option (config, section2, "option3");
+    CHECK(option1);
+    CHECK(option2);
+    CHECK(option3);
+
+    /* free an option */
+    config_file_option_free (option1, 0);
+    POINTERS_EQUAL(NULL,
+                   config_file_search_option (config, section1, "option1"));
+    POINTERS_EQUAL(option2,
+                   config_file_search_option (config, section1, "option2"));
+    options_names (section1, names, sizeof (names));
+    STRCMP_EQUAL("option2", names);
+
+    /* option can be created again after free */
+    option1 = new_option (config, section1, "option1");
+    CHECK(option1);
+    POINTERS_EQUAL(option1,
+                   config_file_search_option (config, section1, "option1"));
+
+    /*
+     * two options with same name (not checked without config file): the first
+     * one is found, then the other one when the first one is freed
+     */
+    dup1 = new_option (NULL, section1, "dup");
+    dup2 = new_option (NULL, section1, "DUP");
+    CHECK(dup1);
+    CHECK(dup2);
+    POINTERS_EQUAL(dup1, config_file_search_option (config, section1, "dup"));
+    config_file_option_free (dup1, 0);
+    POINTERS_EQUAL(dup2, config_file_search_option (config, section1, "dup"));
+    config_file_option_free (dup2, 0);
+    POINTERS_EQUAL(NULL, config_file_search_option (config, section1, "dup"));
+
+    /* same with the last option freed first */
+    dup1 = new_option (NULL, section1, "dup");
+    dup2 = new_option (NULL, section1, "DUP");
+    config_file_option_free (dup2, 0);
+    POINTERS_EQUAL(dup1, config_file_search_option (config, section1, "dup"));
+    config_file_option_free (dup1, 0);
+    POINTERS_EQUAL(NULL, config_file_search_option (config, section1, "dup"));
+
+    /* free a section */
+    config_file_section_free (section1);
+    section1 = NULL;
+    POINTERS_EQUAL(NULL, config_file_search_section (config, "section1"));
+    POINTERS_EQUAL(section2, config_file_search_section (config, "section2"));
+    POINTERS_EQUAL(NULL, config_file_search_option (config, NULL, "option1"));
+    POINTERS_EQUAL(NULL, config_file_search_option (config, NULL, "option2"));
+    POINTERS_EQUAL(option3, config_file_search_option (config, NULL, "option3"));
+
+    /* section can be created again after free */
+    section1 = new_section ("section1");
+    CHECK(section1);
+    POINTERS_EQUAL(section1, config_file_search_section (config, "section1"));
+    POINTERS_EQUAL(NULL,
+                   config_file_search_option (config, section1, "option1"));
+}
+
+/*
+ * Tests functions:
+ *   config_file_option_find_pos
+ *   config_file_option_insert_in_section
+ */
+
+TEST(ConfigFile, OptionsSorted)
+{
+    struct t_config_option *ptr_option;
+    const char *names_in_order[] = { "a1", "b2", "c3", "d4", "e5", NULL };
+    const char *names_out_of_order[] = { "m", "C", "x", "a", "Z", "k",
+                                         "b", NULL };
+    char names[256];
+    int i;
+
+    /* options added in order (append to end of list) */
+    for (i = 0; names_in_order[i]; i++)
+    {
+        CHECK(new_option (config, section1, names_in_order[i]));
+    }
+    options_names (section1, names, sizeof (names));
+    STRCMP_EQUAL("a1,b2,c3,d4,e5", names);
+
+    /* options added out of order */
+    for (i = 0; names_out_of_order[i]; i++)
+    {
+        CHECK(new_option (config, section2, names_out_of_order[i]));
+    }
+    options_names (section2, names, sizeof (names));
+    STRCMP_EQUAL("a,b,C,k,m,x,Z", names);
+
+    /* insert before first, between two options, equal to last and after it */
+    CHECK(new_option (config, section1, "A0"));
+    CHECK(new_option (config, section1, "c"));
+    CHECK(new_option (config, section1, "e"));
+    CHECK(new_option (config, section1, "F6"));
+    options_names (section1, names, sizeof (names));
+    STRCMP_EQUAL("A0,a1,b2,c,c3,d4,e,e5,F6", names);
+
+    /* all options are found */
+    for (ptr_option = section1->options; ptr_option;
+         ptr_option = ptr_option->next_option)
+    {
+        POINTERS_EQUAL(ptr_option,
+                       config_file_search_option (config, section1,
+                                                  ptr_option->name));
+    }
+    for (ptr_option = section2->options; ptr_option;
+         ptr_option = ptr_option->next_option)
+    {
+        POINTERS_EQUAL(ptr_option,
+                       config_file_search_option (config, section2,
+                                                  ptr_option->name));
+    }
+}
@@ -26,20 +26,38 @@ extern "C"
 #include <stdio.h>
 #include <string.h>
 #include <regex.h>
+#include <sys/time.h>
 #include "src/core/wee-eval.h"
 #include "src/core/wee-config.h"
 #include "src/core/wee-config-file.h"
 #include "src/core/wee-hashtable.h"
 #include "src/core/wee-string.h"
+#include "src/core/wee-util.h"
 #include "src/core/wee-version.h"
 #include "src/gui/gui-color.h"
 #include "src/plugins/plugin.h"
 }
 
+/*
+ * checks result of expression with cache (eval_expression), interpreted
+ * (eval_expression_interpreted) and compiled (eval_compile + eval_exec)
+ */
 #define WEE_CHECK_EVAL(__result, __expr)                                \
     value = eval_expression (__expr, pointers, extra_vars, options);    \
     STRCMP_EQUAL(__result, value);                                      \
-    free (value);
+    free (value);                                                       \
+    value = eval_expression_interpreted (__expr, pointers, extra_vars,  \
+                                         options);                      \
+    STRCMP_EQUAL(__result, value);                                      \
+    free (value);                                                       \
+    compiled = eval_compile (__expr, options);                          \
+    CHECK(compiled);                                                    \
+    value = eval_exec (compiled, pointers, extra_vars);                 \
+    STRCMP_EQUAL(__result, value);                                      \
+    free (value);                                                       \
+    eval_compiled_free (compiled);
+
+#define EVAL_TEST_BENCHMARK_COUNT 20000
 
 TEST_GROUP(Eval)
 {
@@ -72,6 +90,7 @@ TEST(Eval, Boolean)
 TEST(Eval, EvalCondition)
 {
     struct t_hashtable *pointers, *extra_vars, *options;
+    struct t_eval_compiled *compiled;
     char *value;
 
     pointers = NULL;
@@ -222,6 +241,7 @@ TEST(Eval, EvalExpression)
 {
     struct t_hashtable *pointers, *extra_vars, *options;
     struct t_config_option *ptr_option;
+    struct t_eval_compiled *compiled;
     char *value, str_value[256];
 
     pointers = NULL;
@@ -426,6 +446,7 @@ TEST(Eval, EvalExpression)
 TEST(Eval, EvalReplaceRegex)
 {
     struct t_hashtable *pointers, *extra_vars, *options;
+    struct t_eval_compiled *compiled;
     char *value;
     regex_t regex;
 
@@ -511,3 +532,314 @@ TEST(Eval, EvalReplaceRegex)
     hashtable_free (extra_vars);
     hashtable_free (options);
 }
+
+/*
+ * Tests functions:
+ *   eval_compile
+ *   eval_exec
+ *   eval_compiled_free
+ *
+ * Compares the compiled expressions with the interpreter, on expressions
+ * with a result which depends on the evaluation (parentheses followed by
+ * text, missing parenthesis, extra vars with name of a variable,
+ * recursion).
+ */
+
+TEST(Eval, EvalCompile)
+{
+    const char *expressions[] = {
+        "", " ", "abc", "(abc) def", "(1) && (0) x", "((1)", "(1 || 0",
+        "(${test}) == value", "(${test}) x == value x", "a == (b) c",
+        "${test}==${test}", "${if:${test}?yes:no}", "${if:?:}", "${if:}",
+        "${if:1?${if:0?a:b}}", "${if:0?a}", "x${if:(1) y?a:b}x",
+        "${eval:${test}}", "${eval:\\${test\\}}", "${info:version}",
+        "${info:${test}}", "${${test}}", "${buffer[gui_buffers].number}",
+        "${buffer[0x0].number}", "${buffer.local_variables.plugin}",
+        "${buffer.local_variables}", "${sec.data.not_found}",
+        "${weechat.look.scroll_amount}", "${env:HOME_NOT_FOUND}",
+        "${esc:a\\tb}", "${\\x41}", "${hide:-,abc}", "${cut:1,+,abc}",
+        "${cutscr:2,+,abc}", "${re:0}", "${plugin}", "${name}",
+        "abc =~ ^A", "abc =~ ${test}", "abc !~ (", "abc =~ (",
+        "${test} =~ val", "x =* *${test}*", "1 < 2 < 3", "0 || 1 && 0",
+        "\\${test}", "${test", "${test}}", "a\\b", "${}",
+        NULL,
+    };
+    const char *extra_names[] = {
+        "info:version", "esc:a\\tb", "weechat.look.scroll_amount",
+        "buffer.number", "if:0?a:b", NULL,
+    };
+    struct t_hashtable *extra_vars, *options;
+    struct t_eval_compiled *compiled;
+    char *value, *value2, expr[1024];
+    int i, j, condition;
+
+    extra_vars = hashtable_new (32,
+                                WEECHAT_HASHTABLE_STRING,
+                                WEECHAT_HASHTABLE_STRING,
+                                NULL, NULL);
+    CHECK(extra_vars);
+    hashtable_set (extra_vars, "test", "value");
+
+    options = hashtable_new (32,
+                             WEECHAT_HASHTABLE_STRING,
+                             WEECHAT_HASHTABLE_STRING,
+                             NULL, NULL);
+    CHECK(options);
+
+    POINTERS_EQUAL(NULL, eval_compile (NULL, NULL));
+    POINTERS_EQUAL(NULL, eval_exec (NULL, NULL, NULL));
+    eval_compiled_free (NULL);
+
+    for (condition = 0; condition < 2; condition++)
+    {
+        if (condition)
+            hashtable_set (options, "type", "condition");
+        for (j = 0; j < 2; j++)
+        {
+            /* second pass: extra vars with name of other variables */
+            if (j == 1)
+            {
+                for (i = 0; extra_names[i]; i++)
+                {
+                    hashtable_set (extra_vars, extra_names[i], "extra");
+                }
+            }
+            for (i = 0; expressions[i]; i++)
+            {
+                value = eval_expression_interpreted (expressions[i], NULL,
+                                                     extra_vars, options);
+                compiled = eval_compile (expressions[i], options);
+                CHECK(compiled);
+                value2 = eval_exec (compiled, NULL, extra_vars);
+                eval_compiled_free (compiled);
+                if (!value || !value2 || (strcmp (value, value2) != 0))
+                {
+                    snprintf (expr, sizeof (expr),
+                              "expression \"%s\" (condition: %d): "
+                              "interpreted: \"%s\", compiled: \"%s\"",
+                              expressions[i], condition,
+                              (value) ? value : "(null)",
+                              (value2) ? value2 : "(null)");
+                    POINTERS_EQUAL(value, value2);
+                    FAIL(expr);
+                }
+                free (value);
+                free (value2);
+            }
+        }
+        for (i = 0; extra_names[i]; i++)
+        {
+            hashtable_remove (extra_vars, extra_names[i]);
+        }
+    }
+
+    /* recursion limit (values of ternary operator are evaluated) */
+    hashtable_remove (options, "type");
+    expr[0] = '\0';
+    for (i = 0; i < 40; i++)
+    {
+        strcat (expr, "${if:1?");
+    }
+    strcat (expr, "abc");
+    for (i = 0; i < 40; i++)
+    {
+        strcat (expr, "}");
+    }
+    value = eval_expression_interpreted (expr, NULL, NULL, options);
+    compiled = eval_compile (expr, options);
+    CHECK(compiled);
+    value2 = eval_exec (compiled, NULL, NULL);
+    STRCMP_EQUAL(value, value2);
+    STRCMP_EQUAL("", value2);
+    free (value);
+    free (value2);
+    eval_compiled_free (compiled);
+
+    hashtable_free (extra_vars);
+    hashtable_free (options);
+}
+
+/*
+ * Tests functions:
+ *   eval_expression (cache of compiled expressions)
+ */
+
+TEST(Eval, EvalCache)
+{
+    struct t_hashtable *pointers, *options;
+    regex_t regex;
+    char *value, expr[128];
+    int i, count;
+
+    options = hashtable_new (32,
+                             WEECHAT_HASHTABLE_STRING,
+                             WEECHAT_HASHTABLE_STRING,
+                             NULL, NULL);
+    CHECK(options);
+
+    /* expression without variables is not kept in cache */
+    count = eval_cache_count;
+    value = eval_expression ("test_cache", NULL, NULL, NULL);
+    STRCMP_EQUAL("test_cache", value);
+    free (value);
+    LONGS_EQUAL(count, eval_cache_count);
+
+    /* expression compiled once */
+    eval_cache_free_all ();
+    LONGS_EQUAL(0, eval_cache_count);
+    value = eval_expression ("${buffer.number}", NULL, NULL, NULL);
+    STRCMP_EQUAL("1", value);
+    free (value);
+    LONGS_EQUAL(1, eval_cache_count);
+    value = eval_expression ("${buffer.number}", NULL, NULL, NULL);
+    STRCMP_EQUAL("1", value);
+    free (value);
+    LONGS_EQUAL(1, eval_cache_count);
+
+    /* regex replacement (like in triggers) is not kept in cache */
+    pointers = hashtable_new (32,
+                              WEECHAT_HASHTABLE_STRING,
+                              WEECHAT_HASHTABLE_POINTER,
+                              NULL, NULL);
+    CHECK(pointers);
+    LONGS_EQUAL(0, string_regcomp (&regex, "(password=)(\\S+)",
+                                   REG_EXTENDED | REG_ICASE));
+    hashtable_set (pointers, "regex", &regex);
+    hashtable_set (options, "regex_replace", "${re:1}${hide:*,${re:2}}");
+    for (i = 0; i < 10; i++)
+    {
+        snprintf (expr, sizeof (expr), "password=secret%d", i);
+        value = eval_expression (expr, pointers, NULL, options);
+        STRCMP_EQUAL("password=*******", value);
+        free (value);
+    }
+    LONGS_EQUAL(1, eval_cache_count);
+    hashtable_remove (pointers, "regex");
+    value = eval_expression ("password=secret ${buffer.number}", pointers,
+                             NULL, options);
+    free (value);
+    LONGS_EQUAL(1, eval_cache_count);
+    hashtable_remove (options, "regex_replace");
+    hashtable_set (options, "regex", "(password=)(\\S+)");
+    value = eval_expression ("password=secret ${buffer.number}", NULL,
+                             NULL, options);
+    free (value);
+    LONGS_EQUAL(1, eval_cache_count);
+    hashtable_remove (options, "regex");
+    regfree (&regex);
+    hashtable_free (pointers);
+
+    /* same expression with other options: compiled again */
+    hashtable_set (options, "type", "condition");
+    value = eval_expression ("${buffer.number}", NULL, NULL, options);
+    STRCMP_EQUAL("1", value);
+    free (value);
+    LONGS_EQUAL(1, eval_cache_count);
+    hashtable_set (options, "prefix", "%(");
+    value = eval_expression ("${buffer.number}", NULL, NULL, options);
+    STRCMP_EQUAL("1", value);
+    free (value);
+    LONGS_EQUAL(1, eval_cache_count);
+
+    /* least recently used expressions are removed */
+    for (i = 0; i < EVAL_CACHE_MAX_SIZE + 10; i++)
+    {
+        snprintf (expr, sizeof (expr), "${buffer.number} == %d", i);
+        value = eval_expression (expr, NULL, NULL, options);
+        free (value);
+    }
+    LONGS_EQUAL(EVAL_CACHE_MAX_SIZE, eval_cache_count);
+
+    eval_cache_free_all ();
+    LONGS_EQUAL(0, eval_cache_count);
+
+    hashtable_free (options);
+}
+
+/*
+ * Tests functions:
+ *   eval_expression (benchmark)
+ *
+ * Compares the interpreter with compiled expressions (cache), on a format
+ * like the ones used by buflist and a condition like the ones used by
+ * triggers.
+ */
+
+TEST(Eval, EvalBenchmark)
+{
+    const char *format = "${color:green}${format_number}${indent}"
+        "${if:${buffer.local_variables.type}==private?${color:cyan}:}"
+        "${cut:20,+,${buffer.short_name}}"
+        "${if:${buffer.hotlist}?${color:yellow}(${buffer.num_displayed})}";
+    const char *condition = "${buffer.number} > 0 "
+        "&& ${buffer.full_name} =~ ^core\\. "
+        "&& (${buffer.local_variables.type} != private "
+        "|| ${weechat.look.scroll_amount} >= 3)";
+    struct t_hashtable *extra_vars, *options;
+    struct timeval time1, time2;
+    long long time_interpreted[2], time_compiled[2];
+    char *value, *value2;
+    int i, j;
+
+    extra_vars = hashtable_new (32,
+                                WEECHAT_HASHTABLE_STRING,
+                                WEECHAT_HASHTABLE_STRING,
+                                NULL, NULL);
+    CHECK(extra_vars);
+    hashtable_set (extra_vars, "format_number", "1.");
+    hashtable_set (extra_vars, "indent", "  ");
+
+    options = hashtable_new (32,
+                             WEECHAT_HASHTABLE_STRING,
+                             WEECHAT_HASHTABLE_STRING,
+                             NULL, NULL);
+    CHECK(options);
+
+    for (j = 0; j < 2; j++)
+    {
+        if (j == 1)
+            hashtable_set (options, "type", "condition");
+
+        value = eval_expression_interpreted ((j == 0) ? format : condition,
+                                             NULL, extra_vars, options);
+        value2 = eval_expression ((j == 0) ? format : condition,
+                                  NULL, extra_vars, options);
+        STRCMP_EQUAL(value, value2);
+        free (value);
+        free (value2);
+
+        gettimeofday (&time1, NULL);
+        for (i = 0; i < EVAL_TEST_BENCHMARK_COUNT; i++)
+        {
+            value = eval_expression_interpreted (
+                (j == 0) ? format : condition, NULL, extra_vars, options);
+            free (value);
+        }
+        gettimeofday (&time2, NULL);
+        time_interpreted[j] = util_timeval_diff (&time1, &time2);
+
+        gettimeofday (&time1, NULL);
+        for (i = 0; i < EVAL_TEST_BENCHMARK_COUNT; i++)
+        {
+            value = eval_expression ((j == 0) ? format : condition,
+                                     NULL, extra_vars, options);
+            free (value);
+        }
+        gettimeofday (&time2, NULL);
+        time_compiled[j] = util_timeval_diff (&time1, &time2);
+    }
+
+    printf ("\n");
+    printf ("eval benchmark (%d evaluations):\n", EVAL_TEST_BENCHMARK_COUNT);
+    printf ("  format, interpreted  . . : %lld ms\n",
+            time_interpreted[0] / 1000);
+    printf ("  format, compiled . . . . : %lld ms\n",
+            time_compiled[0] / 1000);
+    printf ("  condition, interpreted . : %lld ms\n",
+            time_interpreted[1] / 1000);
+    printf ("  condition, compiled  . . : %lld ms\n",
+            time_compiled[1] / 1000);
+
+    hashtable_free (extra_vars);
+    hashtable_free (options);
+}
@@ -23,8 +23,12 @@
 
 extern "C"
 {
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include "src/core/wee-hashtable.h"
+#include "src/core/wee-util.h"
 #include "src/plugins/plugin.h"
 }
 
@@ -114,8 +118,11 @@ TEST(Hashtable, New)
                                &test_hashtable_keycmp_cb);
     CHECK(hashtable);
     LONGS_EQUAL(32, hashtable->size);
+    LONGS_EQUAL(32, hashtable->size_min);
     CHECK(hashtable->htable);
     LONGS_EQUAL(0, hashtable->items_count);
+    LONGS_EQUAL(0, hashtable->deleted_count);
+    LONGS_EQUAL(0, hashtable->map_running);
     LONGS_EQUAL(HASHTABLE_STRING, hashtable->type_keys);
     LONGS_EQUAL(HASHTABLE_INTEGER, hashtable->type_values);
     POINTERS_EQUAL(&test_hashtable_hash_key_cb, hashtable->callback_hash_key);
@@ -123,6 +130,21 @@ TEST(Hashtable, New)
     POINTERS_EQUAL(NULL, hashtable->callback_free_key);
     POINTERS_EQUAL(NULL, hashtable->callback_free_value);
     hashtable_free (hashtable);
+
+    /* size is rounded to a power of 2 */
+    hashtable = hashtable_new (1,
+                               WEECHAT_HASHTABLE_STRING,
+                               WEECHAT_HASHTABLE_STRING,
+                               NULL, NULL);
+    LONGS_EQUAL(HASHTABLE_MIN_SIZE, hashtable->size);
+    hashtable_free (hashtable);
+    hashtable = hashtable_new (100,
+                               WEECHAT_HASHTABLE_STRING,
+                               WEECHAT_HASHTABLE_STRING,
+                               NULL, NULL);
+    LONGS_EQUAL(128, hashtable->size);
+    LONGS_EQUAL(128, hashtable->size_min);
+    hashtable_free (hashtable);
 }
 
 /*
@@ -168,8 +190,7 @@ TEST(Hashtable, SetGetRemove)
     LONGS_EQUAL(strlen (str_key) + 1, item->key_size);
     POINTERS_EQUAL(NULL, item->value);
     LONGS_EQUAL(0, item->value_size);
-    POINTERS_EQUAL(NULL, item->prev_item);
-    POINTERS_EQUAL(NULL, item->next_item);
+    CHECK(item->hash == HASHTABLE_TEST_KEY_HASH + 1);
 
     /* set a string value for the same key */
     item = hashtable_set (hashtable, str_key, str_value);
@@ -179,15 +200,13 @@ TEST(Hashtable, SetGetRemove)
     LONGS_EQUAL(strlen (str_key) + 1, item->key_size);
     STRCMP_EQUAL(str_value, (const char *)item->value);
     LONGS_EQUAL(strlen (str_value) + 1, item->value_size);
-    POINTERS_EQUAL(NULL, item->prev_item);
-    POINTERS_EQUAL(NULL, item->next_item);
 
     /* get item */
     item = hashtable_get_item (hashtable, str_key, &hash);
     CHECK(item);
     STRCMP_EQUAL(str_key, (const char *)item->key);
     STRCMP_EQUAL(str_value, (const char *)item->value);
-    LONGS_EQUAL(2, hash);
+    CHECK(hash == HASHTABLE_TEST_KEY_HASH + 1);
 
     /* get value */
     ptr_value = (const char *)hashtable_get (hashtable, str_key);
@@ -203,6 +222,7 @@ TEST(Hashtable, SetGetRemove)
     /* delete an item */
     hashtable_remove (hashtable, str_key);
     LONGS_EQUAL(0, hashtable->items_count);
+    LONGS_EQUAL(0, hashtable_has_key (hashtable, str_key));
 
     /* add an item with size in hashtable */
     item = hashtable_set_with_size (hashtable,
@@ -229,40 +249,25 @@ TEST(Hashtable, SetGetRemove)
     LONGS_EQUAL(hashtable->items_count, hashtable2->items_count);
     for (i = 0; i < hashtable->size; i++)
     {
-        if (hashtable->htable[i])
+        ptr_item = &hashtable->htable[i];
+        if (!hashtable_item_is_used (ptr_item))
+            continue;
+        ptr_item2 = hashtable_get_item (hashtable2, ptr_item->key, NULL);
+        CHECK(ptr_item2);
+        CHECK(ptr_item2 != ptr_item);
+        CHECK(ptr_item2->hash == ptr_item->hash);
+        LONGS_EQUAL(ptr_item->key_size, ptr_item2->key_size);
+        LONGS_EQUAL(ptr_item->value_size, ptr_item2->value_size);
+        STRCMP_EQUAL((const char *)ptr_item->key,
+                     (const char *)ptr_item2->key);
+        if (ptr_item->value)
         {
-            ptr_item = hashtable->htable[i];
-            ptr_item2 = hashtable2->htable[i];
-            while (ptr_item && ptr_item2)
-            {
-                LONGS_EQUAL(ptr_item->key_size, ptr_item2->key_size);
-                LONGS_EQUAL(ptr_item->value_size, ptr_item2->value_size);
-                if (ptr_item->key)
-                {
-                    STRCMP_EQUAL((const char *)ptr_item->key,
-                                 (const char *)ptr_item2->key);
-                }
-                else
-                {
-                    POINTERS_EQUAL(ptr_item->key, ptr_item2->key);
-                }
-                if (ptr_item->value)
-                {
-                    STRCMP_EQUAL((const char *)ptr_item->value,
-                                 (const char *)ptr_item2->value);
-                }
-                else
-                {
-                    POINTERS_EQUAL(ptr_item->value, ptr_item2->value);
-                }
-                ptr_item = ptr_item->next_item;
-                ptr_item2 = ptr_item2->next_item;
-                CHECK((ptr_item && ptr_item2) || (!ptr_item && !ptr_item2));
-            }
+            STRCMP_EQUAL((const char *)ptr_item->value,
+                         (const char *)ptr_item2->value);
         }
         else
         {
-            POINTERS_EQUAL(hashtable->htable[i], hashtable2->htable[i]);
+            POINTERS_EQUAL(ptr_item->value, ptr_item2->value);
         }
     }
 
@@ -276,24 +281,24 @@ TEST(Hashtable, SetGetRemove)
 
     /*
      * create a hashtable with size 8, and add 6 items,
-     * to check if many items with same hashed key work fine,
+     * to check if many items with same position work fine,
      * the expected htable inside hashtable is:
      *   +-----+
-     *   |   0 |
+     *   |   0 | "weechat"
      *   +-----+
-     *   |   1 |
+     *   |   1 | "chat"
      *   +-----+
-     *   |   2 | --> "extensible"
+     *   |   2 | "fast"
      *   +-----+
-     *   |   3 | --> "fast" --> "light"
+     *   |   3 | "light"
      *   +-----+
      *   |   4 |
      *   +-----+
-     *   |   5 | --> "chat"
+     *   |   5 |
      *   +-----+
-     *   |   6 | --> "client"
+     *   |   6 | "extensible"
      *   +-----+
-     *   |   7 | --> "weechat"
+     *   |   7 | "client"
      *   +-----+
      */
     hashtable = hashtable_new (8,
@@ -306,32 +311,253 @@ TEST(Hashtable, SetGetRemove)
 
     item = hashtable_set (hashtable, "weechat", NULL);
     CHECK(item);
-    POINTERS_EQUAL(item, hashtable->htable[7]);
+    POINTERS_EQUAL(item, &hashtable->htable[0]);
 
     item = hashtable_set (hashtable, "fast", NULL);
     CHECK(item);
-    POINTERS_EQUAL(item, hashtable->htable[3]);
+    POINTERS_EQUAL(item, &hashtable->htable[2]);
 
     item = hashtable_set (hashtable, "light", NULL);
     CHECK(item);
-    POINTERS_EQUAL(item, hashtable->htable[3]->next_item);
+    POINTERS_EQUAL(item, &hashtable->htable[3]);
 
     item = hashtable_set (hashtable, "extensible", NULL);
     CHECK(item);
-    POINTERS_EQUAL(item, hashtable->htable[2]);
+    POINTERS_EQUAL(item, &hashtable->htable[6]);
 
     item = hashtable_set (hashtable, "chat", NULL);
     CHECK(item);
-    POINTERS_EQUAL(item, hashtable->htable[5]);
+    POINTERS_EQUAL(item, &hashtable->htable[1]);
 
     item = hashtable_set (hashtable, "client", NULL);
     CHECK(item);
-    POINTERS_EQUAL(item, hashtable->htable[6]);
+    POINTERS_EQUAL(item, &hashtable->htable[7]);
+
+    LONGS_EQUAL(8, hashtable->size);
+    LONGS_EQUAL(6, hashtable->items_count);
+
+    /*
+     * remove "fast": its slot is marked as deleted (because next slot is
+     * used), and "light" must still be found
+     */
+    hashtable_remove (hashtable, "fast");
+    LONGS_EQUAL(5, hashtable->items_count);
+    LONGS_EQUAL(1, hashtable->deleted_count);
+    LONGS_EQUAL(0, hashtable_item_is_used (&hashtable->htable[2]));
+    POINTERS_EQUAL(&hashtable->htable[3],
+                   hashtable_get_item (hashtable, "light", NULL));
+
+    /* add "fast" again: the deleted slot is used */
+    item = hashtable_set (hashtable, "fast", NULL);
+    POINTERS_EQUAL(item, &hashtable->htable[2]);
+    LONGS_EQUAL(6, hashtable->items_count);
+    LONGS_EQUAL(0, hashtable->deleted_count);
+
+    /* remove "light": its slot is free (because next slot is free) */
+    hashtable_remove (hashtable, "light");
+    LONGS_EQUAL(5, hashtable->items_count);
+    LONGS_EQUAL(0, hashtable->deleted_count);
+    POINTERS_EQUAL(NULL, hashtable->htable[3].key);
 
     /* free hashtable */
     hashtable_free (hashtable);
 }
 
+/*
+ * Tests functions:
+ *   hashtable_set (with automatic grow of hashtable)
+ *   hashtable_remove (with automatic shrink of hashtable)
+ *   hashtable_remove_all
+ */
+
+TEST(Hashtable, GrowShrink)
+{
+    struct t_hashtable *hashtable;
+    char key[64];
+    int i, value;
+
+    hashtable = hashtable_new (8,
+                               WEECHAT_HASHTABLE_STRING,
+                               WEECHAT_HASHTABLE_INTEGER,
+                               NULL,
+                               NULL);
+    LONGS_EQUAL(8, hashtable->size);
+
+    /* 6 items: no grow */
+    for (i = 0; i < 6; i++)
+    {
+        snprintf (key, sizeof (key), "key%d", i);
+        hashtable_set (hashtable, key, &i);
+    }
+    LONGS_EQUAL(8, hashtable->size);
+    LONGS_EQUAL(6, hashtable->items_count);
+
+    /* 7th item: the hashtable grows */
+    i = 6;
+    hashtable_set (hashtable, "key6", &i);
+    LONGS_EQUAL(16, hashtable->size);
+    LONGS_EQUAL(7, hashtable->items_count);
+
+    /* add many items */
+    for (i = 7; i < 10000; i++)
+    {
+        snprintf (key, sizeof (key), "key%d", i);
+        hashtable_set (hashtable, key, &i);
+        CHECK((hashtable->items_count + hashtable->deleted_count) * 4
+              <= hashtable->size * 3);
+    }
+    LONGS_EQUAL(10000, hashtable->items_count);
+    LONGS_EQUAL(16384, hashtable->size);
+
+    /* check that all items are found after grow */
+    for (i = 0; i < 10000; i++)
+    {
+        snprintf (key, sizeof (key), "key%d", i);
+        value = *((int *)hashtable_get (hashtable, key));
+        LONGS_EQUAL(i, value);
+    }
+
+    /* replace value of an existing key: no new item */
+    i = -1;
+    hashtable_set (hashtable, "key0", &i);
+    LONGS_EQUAL(10000, hashtable->items_count);
+    LONGS_EQUAL(-1, *((int *)hashtable_get (hashtable, "key0")));
+
+    /* remove most items: the hashtable shrinks */
+    for (i = 0; i < 9990; i++)
+    {
+        snprintf (key, sizeof (key), "key%d", i);
+        hashtable_remove (hashtable, key);
+    }
+    LONGS_EQUAL(10, hashtable->items_count);
+    CHECK(hashtable->size < 16384);
+    CHECK(hashtable->size >= 8);
+    for (i = 9990; i < 10000; i++)
+    {
+        snprintf (key, sizeof (key), "key%d", i);
+        value = *((int *)hashtable_get (hashtable, key));
+        LONGS_EQUAL(i, value);
+    }
+
+    /* remove all items: the hashtable goes back to its initial size */
+    hashtable_remove_all (hashtable);
+    LONGS_EQUAL(0, hashtable->items_count);
+    LONGS_EQUAL(0, hashtable->deleted_count);
+    LONGS_EQUAL(8, hashtable->size);
+
+    /* add/remove many times the same keys: deleted slots are reused */
+    for (i = 0; i < 1000; i++)
+    {
+        snprintf (key, sizeof (key), "key%d", i % 5);
+        hashtable_set (hashtable, key, &i);
+        snprintf (key, sizeof (key), "key%d", (i + 2) % 5);
+        hashtable_remove (hashtable, key);
+        CHECK(hashtable->items_count + hashtable->deleted_count
+              < hashtable->size);
+    }
+    LONGS_EQUAL(8, hashtable->size);
+
+    hashtable_free (hashtable);
+}
+
+/*
+ * Benchmark of hashtable: set/get/remove of many items in a hashtable
+ * created with a small size.
+ */
+
+TEST(Hashtable, Benchmark)
+{
+    struct t_hashtable *hashtable;
+    char **keys;
+    struct timeval tv1, tv2, tv3, tv4;
+    int i, count, found;
+
+    count = 100000;
+    keys = (char **)malloc (count * sizeof (*keys));
+    CHECK(keys);
+    for (i = 0; i < count; i++)
+    {
+        keys[i] = (char *)malloc (32);
+        snprintf (keys[i], 32, "nick_%d", i);
+    }
+
+    hashtable = hashtable_new (32,
+                               WEECHAT_HASHTABLE_STRING,
+                               WEECHAT_HASHTABLE_POINTER,
+                               NULL,
+                               NULL);
+
+    gettimeofday (&tv1, NULL);
+    for (i = 0; i < count; i++)
+    {
+        hashtable_set (hashtable, keys[i], keys[i]);
+    }
+    gettimeofday (&tv2, NULL);
+    found = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (hashtable_get (hashtable, keys[i]) == keys[i])
+            found++;
+        if (hashtable_get (hashtable, "unknown_key"))
+            found--;
+    }
+    gettimeofday (&tv3, NULL);
+    for (i = 0; i < count; i++)
+    {
+        hashtable_remove (hashtable, keys[i]);
+    }
+    gettimeofday (&tv4, NULL);
+
+    LONGS_EQUAL(count, found);
+    LONGS_EQUAL(0, hashtable->items_count);
+
+    printf ("    hashtable: %d items: set: %lld ms, get: %lld ms, "
+            "remove: %lld ms\n",
+            count,
+            util_timeval_diff (&tv1, &tv2) / 1000,
+            util_timeval_diff (&tv2, &tv3) / 1000,
+            util_timeval_diff (&tv3, &tv4) / 1000);
+
+    hashtable_free (hashtable);
+    for (i = 0; i < count; i++)
+    {
+        free (keys[i]);
+    }
+    free (keys);
+}
+
+/*
+ * Test callback for hashtable_map: counts items.
+ */
+
+void
+test_hashtable_map_cb (void *data, struct t_hashtable *hashtable,
+                       const void *key, const void *value)
+{
+    /* make C++ compiler happy */
+    (void) hashtable;
+    (void) key;
+    (void) value;
+
+    (*((int *)data))++;
+}
+
+/*
+ * Test callback for hashtable_map: removes items (data is the expected size
+ * of hashtable, which must not change during map).
+ */
+
+void
+test_hashtable_map_remove_cb (void *data, struct t_hashtable *hashtable,
+                              const void *key, const void *value)
+{
+    /* make C++ compiler happy */
+    (void) value;
+
+    hashtable_remove (hashtable, key);
+    LONGS_EQUAL(*((int *)data), hashtable->size);
+}
+
 /*
  * Tests functions:
  *   hashtable_map
@@ -340,7 +566,38 @@ TEST(Hashtable, SetGetRemove)
 
 TEST(Hashtable, Map)
 {
-    /* TODO: write tests */
+    struct t_hashtable *hashtable;
+    char key[64];
+    int i, count, size;
+
+    hashtable = hashtable_new (8,
+                               WEECHAT_HASHTABLE_STRING,
+                               WEECHAT_HASHTABLE_INTEGER,
+                               NULL,
+                               NULL);
+    for (i = 0; i < 1000; i++)
+    {
+        snprintf (key, sizeof (key), "key%d", i);
+        hashtable_set (hashtable, key, &i);
+    }
+    size = hashtable->size;
+
+    /* count items */
+    count = 0;
+    hashtable_map (hashtable, &test_hashtable_map_cb, &count);
+    LONGS_EQUAL(1000, count);
+    LONGS_EQUAL(0, hashtable->map_running);
+
+    /*
+     * remove all items in callback: hashtable is not resized during map
+     * (checked in callback), but it shrinks at the end of map
+     */
+    hashtable_map (hashtable, &test_hashtable_map_remove_cb, &size);
+    LONGS_EQUAL(0, hashtable->items_count);
+    LONGS_EQUAL(8, hashtable->size);
+    LONGS_EQUAL(0, hashtable->map_running);
+
+    hashtable_free (hashtable);
 }
 
 /*
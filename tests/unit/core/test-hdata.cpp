@@ -23,11 +23,110 @@
 
 extern "C"
 {
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/time.h>
 #include "src/core/wee-hdata.h"
+#include "src/core/wee-hashtable.h"
+#include "src/core/wee-hook.h"
+#include "src/core/wee-util.h"
+#include "src/gui/gui-buffer.h"
+#include "src/plugins/weechat-plugin.h"
 }
 
+#define HDATA_TEST_BENCHMARK_ITEMS 2000
+#define HDATA_TEST_BENCHMARK_CHECKS 2000
+
+struct t_test_hdata_item
+{
+    int number;
+    struct t_test_hdata_item *prev_item;
+    struct t_test_hdata_item *next_item;
+};
+
+struct t_test_hdata_item *test_hdata_items = NULL;
+struct t_test_hdata_item *last_test_hdata_item = NULL;
+struct t_hashtable *test_hdata_items_pointers = NULL;
+
 TEST_GROUP(Hdata)
 {
+    /*
+     * Creates a list with "count" items (and the registry of pointers if
+     * "registry" is 1).
+     */
+
+    struct t_test_hdata_item *create_items (int count, int registry)
+    {
+        struct t_test_hdata_item *items;
+        int i;
+
+        items = (struct t_test_hdata_item *)calloc (count, sizeof (*items));
+        if (!items)
+            return NULL;
+
+        if (registry)
+        {
+            test_hdata_items_pointers = hashtable_new (32,
+                                                       WEECHAT_HASHTABLE_POINTER,
+                                                       WEECHAT_HASHTABLE_POINTER,
+                                                       NULL, NULL);
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            items[i].number = i;
+            items[i].prev_item = (i > 0) ? &items[i - 1] : NULL;
+            items[i].next_item = (i < count - 1) ? &items[i + 1] : NULL;
+            if (test_hdata_items_pointers)
+                hashtable_set (test_hdata_items_pointers, &items[i], NULL);
+        }
+        test_hdata_items = &items[0];
+        last_test_hdata_item = &items[count - 1];
+
+        return items;
+    }
+
+    /*
+     * Frees list of items and registry of pointers.
+     */
+
+    void free_items (struct t_test_hdata_item *items)
+    {
+        test_hdata_items = NULL;
+        last_test_hdata_item = NULL;
+        if (test_hdata_items_pointers)
+        {
+            hashtable_free (test_hdata_items_pointers);
+            test_hdata_items_pointers = NULL;
+        }
+        free (items);
+    }
+
+    /*
+     * Gets (or creates) the hdata "test_item".
+     */
+
+    struct t_hdata *get_hdata ()
+    {
+        struct t_hdata *hdata;
+
+        hdata = (struct t_hdata *)hashtable_get (weechat_hdata, "test_item");
+        if (hdata)
+            return hdata;
+
+        hdata = hdata_new (NULL, "test_item", "prev_item", "next_item",
+                           0, 0, NULL, NULL);
+        if (hdata)
+        {
+            HDATA_VAR(struct t_test_hdata_item, number, INTEGER, 0, NULL, NULL);
+            HDATA_VAR(struct t_test_hdata_item, prev_item, POINTER, 0, NULL, "test_item");
+            HDATA_VAR(struct t_test_hdata_item, next_item, POINTER, 0, NULL, "test_item");
+            HDATA_LIST(test_hdata_items, WEECHAT_HDATA_LIST_CHECK_POINTERS);
+            HDATA_LIST(last_test_hdata_item, 0);
+            HDATA_POINTERS(test_hdata_items_pointers);
+        }
+        return hdata;
+    }
 };
 
 /*
@@ -62,12 +161,131 @@ TEST(Hdata, Get)
 
 /*
  * Tests functions:
+ *   hdata_new_pointers
  *   hdata_check_pointer
  */
 
 TEST(Hdata, Check)
 {
-    /* TODO: write tests */
+    struct t_hdata *hdata, *hdata_buffer;
+    struct t_test_hdata_item *items, other_item;
+    struct t_gui_buffer *buffer;
+    int registry;
+
+    hdata = get_hdata ();
+    CHECK(hdata);
+    POINTERS_EQUAL(&test_hdata_items_pointers, hdata->hash_pointers);
+
+    other_item.number = -1;
+    other_item.prev_item = NULL;
+    other_item.next_item = NULL;
+
+    /* same checks without registry (walk in lists), then with registry */
+    for (registry = 0; registry < 2; registry++)
+    {
+        items = create_items (10, registry);
+        CHECK(items);
+
+        LONGS_EQUAL(0, hdata_check_pointer (NULL, NULL, &items[0]));
+        LONGS_EQUAL(0, hdata_check_pointer (hdata, NULL, NULL));
+
+        /* all lists with flag "check_pointers" */
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, NULL, &items[0]));
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, NULL, &items[5]));
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, NULL, &items[9]));
+        LONGS_EQUAL(0, hdata_check_pointer (hdata, NULL, &other_item));
+
+        /* given list (with flag "check_pointers") */
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, test_hdata_items,
+                                            &items[0]));
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, test_hdata_items,
+                                            &items[9]));
+        LONGS_EQUAL(0, hdata_check_pointer (hdata, test_hdata_items,
+                                            &other_item));
+
+        /* given list starting in the middle of list */
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, &items[5], &items[5]));
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, &items[5], &items[7]));
+        LONGS_EQUAL(0, hdata_check_pointer (hdata, &items[5], &items[2]));
+        LONGS_EQUAL(0, hdata_check_pointer (hdata, &items[5],
+                                            &other_item));
+
+        /* item removed from list (and from registry) */
+        items[8].next_item = NULL;
+        last_test_hdata_item = &items[8];
+        if (test_hdata_items_pointers)
+            hashtable_remove (test_hdata_items_pointers, &items[9]);
+        LONGS_EQUAL(0, hdata_check_pointer (hdata, NULL, &items[9]));
+        LONGS_EQUAL(0, hdata_check_pointer (hdata, test_hdata_items,
+                                            &items[9]));
+        LONGS_EQUAL(1, hdata_check_pointer (hdata, NULL, &items[8]));
+
+        free_items (items);
+    }
+
+    /* empty list */
+    LONGS_EQUAL(0, hdata_check_pointer (hdata, NULL, &other_item));
+
+    /* registry of buffers */
+    hdata_buffer = hook_hdata_get (NULL, "buffer");
+    CHECK(hdata_buffer);
+    POINTERS_EQUAL(&gui_buffers_pointers, hdata_buffer->hash_pointers);
+    CHECK(gui_buffers_pointers);
+    LONGS_EQUAL(gui_buffers_count, gui_buffers_pointers->items_count);
+    LONGS_EQUAL(1, hdata_check_pointer (hdata_buffer, NULL, gui_buffers));
+    LONGS_EQUAL(1, hdata_check_pointer (hdata_buffer, gui_buffers,
+                                        gui_buffers));
+    LONGS_EQUAL(0, hdata_check_pointer (hdata_buffer, NULL, &other_item));
+    LONGS_EQUAL(0, hdata_check_pointer (hdata_buffer, gui_buffers,
+                                        &other_item));
+    buffer = gui_buffer_new (NULL, "test_hdata", NULL, NULL, NULL,
+                             NULL, NULL, NULL);
+    CHECK(buffer);
+    LONGS_EQUAL(1, hdata_check_pointer (hdata_buffer, NULL, buffer));
+    LONGS_EQUAL(1, hdata_check_pointer (hdata_buffer, gui_buffers, buffer));
+    gui_buffer_close (buffer);
+    LONGS_EQUAL(0, hdata_check_pointer (hdata_buffer, NULL, buffer));
+    LONGS_EQUAL(0, hdata_check_pointer (hdata_buffer, gui_buffers, buffer));
+}
+
+/*
+ * Benchmark of function hdata_check_pointer: checks of pointers at the end
+ * of a long list, without and with registry of pointers.
+ */
+
+TEST(Hdata, CheckBenchmark)
+{
+    struct t_hdata *hdata;
+    struct t_test_hdata_item *items;
+    struct timeval tv1, tv2;
+    long long time_diff[2];
+    int registry, i, found;
+
+    hdata = get_hdata ();
+    CHECK(hdata);
+
+    for (registry = 0; registry < 2; registry++)
+    {
+        items = create_items (HDATA_TEST_BENCHMARK_ITEMS, registry);
+        CHECK(items);
+        found = 0;
+        gettimeofday (&tv1, NULL);
+        for (i = 0; i < HDATA_TEST_BENCHMARK_CHECKS; i++)
+        {
+            found += hdata_check_pointer (
+                hdata, NULL,
+                &items[HDATA_TEST_BENCHMARK_ITEMS - 1 - (i % 10)]);
+        }
+        gettimeofday (&tv2, NULL);
+        LONGS_EQUAL(HDATA_TEST_BENCHMARK_CHECKS, found);
+        time_diff[registry] = util_timeval_diff (&tv1, &tv2);
+        free_items (items);
+    }
+
+    printf ("hdata_check_pointer benchmark (%d checks, %d items):\n",
+            HDATA_TEST_BENCHMARK_CHECKS, HDATA_TEST_BENCHMARK_ITEMS);
+    printf ("  walk in list: %lld us\n", time_diff[0]);
+    printf ("  registry    : %lld us\n", time_diff[1]);
 }
 
 /*
@@ -0,0 +1,1127 @@
+/*
+ * test-hook.cpp - test hook functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "src/core/wee-hook.h"
+#include "src/core/wee-proxy.h"
+#include "src/core/wee-util.h"
+#include "src/plugins/plugin.h"
+}
+
+#define HOOK_TEST_MAX_HOOKS 1000
+#define HOOK_TEST_FD_PIPES 500
+#define HOOK_TEST_PROCESSES 50
+#define HOOK_TEST_CONNECTIONS 60
+#define HOOK_TEST_TIMERS 1000
+
+char hook_test_calls[1024];
+int hook_test_count = 0;
+
+/* result of last connect hook */
+int hook_test_connect_status = -1;
+int hook_test_connect_sock = -1;
+char hook_test_connect_ip[64];
+
+/* fake proxy (socks5 or http) */
+int hook_test_proxy_sock = -1;
+struct t_hook *hook_test_proxy_hook = NULL;
+char hook_test_proxy_data[1024];
+int hook_test_proxy_length = 0;
+int hook_test_proxy_step = 0;
+char hook_test_proxy_target[256];
+
+TEST_GROUP(Hook)
+{
+    /*
+     * Callback for signals: adds the id of hook (given in pointer) to the
+     * list of calls.
+     */
+
+    static int
+    test_signal_cb (const void *pointer, void *data, const char *signal,
+                    const char *type_data, void *signal_data)
+    {
+        /* make C++ compiler happy */
+        (void) data;
+        (void) signal;
+        (void) type_data;
+        (void) signal_data;
+
+        if (hook_test_calls[0])
+            strcat (hook_test_calls, ",");
+        strcat (hook_test_calls, (const char *)pointer);
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for signals: same as test_signal_cb, and eats the signal.
+     */
+
+    static int
+    test_signal_eat_cb (const void *pointer, void *data, const char *signal,
+                        const char *type_data, void *signal_data)
+    {
+        test_signal_cb (pointer, data, signal, type_data, signal_data);
+
+        return WEECHAT_RC_OK_EAT;
+    }
+
+    /*
+     * Callback for signals: counts calls (for benchmark).
+     */
+
+    static int
+    test_signal_count_cb (const void *pointer, void *data, const char *signal,
+                          const char *type_data, void *signal_data)
+    {
+        /* make C++ compiler happy */
+        (void) pointer;
+        (void) data;
+        (void) signal;
+        (void) type_data;
+        (void) signal_data;
+
+        hook_test_count++;
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for timers: adds the id of hook (given in pointer) to the
+     * list of calls.
+     */
+
+    static int
+    test_timer_cb (const void *pointer, void *data, int remaining_calls)
+    {
+        /* make C++ compiler happy */
+        (void) data;
+        (void) remaining_calls;
+
+        if (hook_test_calls[0])
+            strcat (hook_test_calls, ",");
+        strcat (hook_test_calls, (const char *)pointer);
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for timers: counts calls (for benchmark).
+     */
+
+    static int
+    test_timer_count_cb (const void *pointer, void *data, int remaining_calls)
+    {
+        /* make C++ compiler happy */
+        (void) pointer;
+        (void) data;
+        (void) remaining_calls;
+
+        hook_test_count++;
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Checks that heap of timers is valid: each timer is executed before its
+     * children and knows its index in heap.
+     */
+
+    static int
+    test_timer_heap_valid ()
+    {
+        int i;
+
+        for (i = 0; i < hook_timer_heap_count; i++)
+        {
+            if (HOOK_TIMER(hook_timer_heap[i], heap_index) != i)
+                return 0;
+            if ((i > 0)
+                && (HOOK_TIMER(hook_timer_heap[(i - 1) / 2], next_exec_monotonic) >
+                    HOOK_TIMER(hook_timer_heap[i], next_exec_monotonic)))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    /*
+     * Callback for fd: adds the id of hook (given in pointer) to the list of
+     * calls, and reads data available on fd (if hook is on a read fd).
+     */
+
+    static int
+    test_fd_cb (const void *pointer, void *data, int fd)
+    {
+        char buffer[64];
+
+        /* make C++ compiler happy */
+        (void) data;
+
+        if (hook_test_calls[0])
+            strcat (hook_test_calls, ",");
+        strcat (hook_test_calls, (const char *)pointer);
+
+        if (strncmp ((const char *)pointer, "read", 4) == 0)
+            (void) read (fd, buffer, sizeof (buffer));
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for fd: counts calls (for benchmark).
+     */
+
+    static int
+    test_fd_count_cb (const void *pointer, void *data, int fd)
+    {
+        /* make C++ compiler happy */
+        (void) pointer;
+        (void) data;
+        (void) fd;
+
+        hook_test_count++;
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for process: counts ended processes and saves the last
+     * return code (for benchmark).
+     */
+
+    static int
+    test_process_cb (const void *pointer, void *data, const char *command,
+                     int return_code, const char *out, const char *err)
+    {
+        /* make C++ compiler happy */
+        (void) data;
+        (void) command;
+        (void) out;
+        (void) err;
+
+        if (return_code != WEECHAT_HOOK_PROCESS_RUNNING)
+        {
+            *((int *)pointer) = return_code;
+            hook_test_count++;
+        }
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for connect: saves status, socket and IP address, and counts
+     * calls.
+     */
+
+    static int
+    test_connect_cb (const void *pointer, void *data, int status,
+                     int gnutls_rc, int sock, const char *error,
+                     const char *ip_address)
+    {
+        /* make C++ compiler happy */
+        (void) pointer;
+        (void) data;
+        (void) gnutls_rc;
+        (void) error;
+
+        hook_test_connect_status = status;
+        hook_test_connect_sock = sock;
+        snprintf (hook_test_connect_ip, sizeof (hook_test_connect_ip),
+                  "%s", (ip_address) ? ip_address : "");
+        hook_test_count++;
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for connect: closes the socket and counts successful
+     * connections (for benchmark).
+     */
+
+    static int
+    test_connect_close_cb (const void *pointer, void *data, int status,
+                           int gnutls_rc, int sock, const char *error,
+                           const char *ip_address)
+    {
+        /* make C++ compiler happy */
+        (void) pointer;
+        (void) data;
+        (void) gnutls_rc;
+        (void) error;
+        (void) ip_address;
+
+        if (sock >= 0)
+            close (sock);
+        if (status == WEECHAT_HOOK_CONNECT_OK)
+            hook_test_count++;
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for fake proxy: reads data sent by client and replies (the
+     * type of proxy is given in pointer: "socks5" or "http").
+     */
+
+    static int
+    test_proxy_read_cb (const void *pointer, void *data, int fd)
+    {
+        int num_read, length;
+        ssize_t num_sent;
+        char *pos;
+        unsigned char *ptr_data;
+
+        /* make C++ compiler happy */
+        (void) data;
+
+        num_read = recv (fd, hook_test_proxy_data + hook_test_proxy_length,
+                         sizeof (hook_test_proxy_data) - hook_test_proxy_length - 1,
+                         0);
+        if (num_read <= 0)
+            return WEECHAT_RC_OK;
+        hook_test_proxy_length += num_read;
+        hook_test_proxy_data[hook_test_proxy_length] = '\0';
+        ptr_data = (unsigned char *)hook_test_proxy_data;
+
+        if (strcmp ((const char *)pointer, "http") == 0)
+        {
+            pos = strstr (hook_test_proxy_data, "\r\n\r\n");
+            if (pos)
+            {
+                pos = strchr (hook_test_proxy_data, '\r');
+                snprintf (hook_test_proxy_target,
+                          sizeof (hook_test_proxy_target), "%.*s",
+                          (int)(pos - hook_test_proxy_data),
+                          hook_test_proxy_data);
+                num_sent = send (fd, "HTTP/1.0 200 Connection established"
+                                 "\r\n\r\n", 39, 0);
+                (void) num_sent;
+                hook_test_proxy_length = 0;
+            }
+            return WEECHAT_RC_OK;
+        }
+
+        /* socks5: method, then connect */
+        if ((hook_test_proxy_step == 0) && (hook_test_proxy_length >= 3))
+        {
+            num_sent = send (fd, "\x05\x00", 2, 0);
+            (void) num_sent;
+            hook_test_proxy_length = 0;
+            hook_test_proxy_step = 1;
+        }
+        else if ((hook_test_proxy_step == 1) && (hook_test_proxy_length >= 5))
+        {
+            length = ptr_data[4];
+            if (hook_test_proxy_length >= 5 + length + 2)
+            {
+                snprintf (hook_test_proxy_target,
+                          sizeof (hook_test_proxy_target), "%.*s:%d",
+                          length, hook_test_proxy_data + 5,
+                          (ptr_data[5 + length] << 8) | ptr_data[5 + length + 1]);
+                num_sent = send (fd,
+                                 "\x05\x00\x00\x01\x7f\x00\x00\x01\x00\x50",
+                                 10, 0);
+                (void) num_sent;
+                hook_test_proxy_length = 0;
+                hook_test_proxy_step = 2;
+            }
+        }
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Callback for fake proxy: accepts connection of client.
+     */
+
+    static int
+    test_proxy_accept_cb (const void *pointer, void *data, int fd)
+    {
+        /* make C++ compiler happy */
+        (void) data;
+
+        hook_test_proxy_sock = accept (fd, NULL, NULL);
+        if (hook_test_proxy_sock >= 0)
+        {
+            hook_test_proxy_hook = hook_fd (NULL, hook_test_proxy_sock,
+                                            1, 0, 0,
+                                            &test_proxy_read_cb,
+                                            pointer, NULL);
+        }
+
+        return WEECHAT_RC_OK;
+    }
+
+    /*
+     * Creates a socket listening on 127.0.0.1 (random port).
+     *
+     * Returns the socket, and the port in *port.
+     */
+
+    static int
+    test_listen (int *port)
+    {
+        struct sockaddr_in addr;
+        socklen_t length;
+        int sock;
+
+        sock = socket (AF_INET, SOCK_STREAM, 0);
+        if (sock < 0)
+            return -1;
+        memset (&addr, 0, sizeof (addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr ("127.0.0.1");
+        addr.sin_port = 0;
+        length = sizeof (addr);
+        if ((bind (sock, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+            || (listen (sock, 128) < 0)
+            || (getsockname (sock, (struct sockaddr *)&addr, &length) < 0))
+        {
+            close (sock);
+            return -1;
+        }
+        *port = ntohs (addr.sin_port);
+        return sock;
+    }
+
+    /*
+     * Runs the main loop (timers and fd) until the number of connect
+     * callbacks called reaches "count" (or until 5 seconds elapsed).
+     */
+
+    static void
+    test_wait_connect (int count)
+    {
+        struct timeval tv_start, tv_now;
+
+        gettimeofday (&tv_start, NULL);
+        while (hook_test_count < count)
+        {
+            hook_timer_exec ();
+            hook_fd_exec ();
+            gettimeofday (&tv_now, NULL);
+            if (util_timeval_diff (&tv_start, &tv_now) > 5000000LL)
+                break;
+        }
+    }
+};
+
+/*
+ * Tests functions:
+ *   hook_signal
+ *   hook_signal_send
+ */
+
+TEST(Hook, Signal)
+{
+    struct t_hook *hooks[8];
+    int i, rc;
+
+    hooks[0] = hook_signal (NULL, "test_hook_signal",
+                            &test_signal_cb, "exact", NULL);
+    hooks[1] = hook_signal (NULL, "test_hook_*",
+                            &test_signal_cb, "prefix", NULL);
+    hooks[2] = hook_signal (NULL, "2000|test_hook_SIGNAL",
+                            &test_signal_cb, "exact_prio", NULL);
+    hooks[3] = hook_signal (NULL, "*hook_signal",
+                            &test_signal_cb, "suffix", NULL);
+    hooks[4] = hook_signal (NULL, "test*signal",
+                            &test_signal_cb, "middle", NULL);
+    hooks[5] = hook_signal (NULL, "500|test_h*",
+                            &test_signal_cb, "prefix_low", NULL);
+    hooks[6] = hook_signal (NULL, "test_hook_signal2",
+                            &test_signal_cb, "other", NULL);
+    hooks[7] = NULL;
+
+    /* all hooks are called by priority, then creation order */
+    hook_test_calls[0] = '\0';
+    rc = hook_signal_send ("test_hook_signal", WEECHAT_HOOK_SIGNAL_STRING,
+                           NULL);
+    LONGS_EQUAL(WEECHAT_RC_OK, rc);
+    STRCMP_EQUAL("exact_prio,exact,prefix,suffix,middle,prefix_low",
+                 hook_test_calls);
+
+    /* signal name is case insensitive */
+    hook_test_calls[0] = '\0';
+    hook_signal_send ("TEST_Hook_Signal", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    STRCMP_EQUAL("exact_prio,exact,prefix,suffix,middle,prefix_low",
+                 hook_test_calls);
+
+    /* only prefix masks */
+    hook_test_calls[0] = '\0';
+    hook_signal_send ("test_hook_xyz", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    STRCMP_EQUAL("prefix,prefix_low", hook_test_calls);
+
+    /* prefix masks and other exact name */
+    hook_test_calls[0] = '\0';
+    hook_signal_send ("test_hook_signal2", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    STRCMP_EQUAL("prefix,other,prefix_low", hook_test_calls);
+
+    /* prefix mask matches exact prefix */
+    hook_test_calls[0] = '\0';
+    hook_signal_send ("test_h", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    STRCMP_EQUAL("prefix_low", hook_test_calls);
+
+    /* no hook */
+    hook_test_calls[0] = '\0';
+    hook_signal_send ("test_", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    STRCMP_EQUAL("", hook_test_calls);
+    rc = hook_signal_send (NULL, WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    LONGS_EQUAL(WEECHAT_RC_OK, rc);
+
+    /* remove some hooks */
+    unhook (hooks[1]);
+    unhook (hooks[4]);
+    hook_test_calls[0] = '\0';
+    hook_signal_send ("test_hook_signal", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    STRCMP_EQUAL("exact_prio,exact,suffix,prefix_low", hook_test_calls);
+    hooks[1] = NULL;
+    hooks[4] = NULL;
+
+    for (i = 0; i < 8; i++)
+    {
+        if (hooks[i])
+            unhook (hooks[i]);
+    }
+
+    hook_test_calls[0] = '\0';
+    hook_signal_send ("test_hook_signal", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    STRCMP_EQUAL("", hook_test_calls);
+}
+
+/*
+ * Tests functions:
+ *   hook_signal_send (with WEECHAT_RC_OK_EAT)
+ */
+
+TEST(Hook, SignalEat)
+{
+    struct t_hook *hook1, *hook2, *hook3;
+    int rc;
+
+    hook1 = hook_signal (NULL, "test_hook_eat*",
+                         &test_signal_cb, "first", NULL);
+    hook2 = hook_signal (NULL, "test_hook_eat",
+                         &test_signal_eat_cb, "eat", NULL);
+    hook3 = hook_signal (NULL, "*hook_eat",
+                         &test_signal_cb, "last", NULL);
+
+    hook_test_calls[0] = '\0';
+    rc = hook_signal_send ("test_hook_eat", WEECHAT_HOOK_SIGNAL_STRING, NULL);
+    LONGS_EQUAL(WEECHAT_RC_OK_EAT, rc);
+    STRCMP_EQUAL("first,eat", hook_test_calls);
+
+    unhook (hook1);
+    unhook (hook2);
+    unhook (hook3);
+}
+
+/*
+ * Benchmark of function hook_signal_send: signals sent per second, by number
+ * of signal hooks (the signal sent matches only one hook).
+ */
+
+TEST(Hook, SignalSendBenchmark)
+{
+    struct t_hook *hooks[HOOK_TEST_MAX_HOOKS];
+    const char *masks[4] = { "test_bench_%d", "test_bench_%d_*",
+                             "*_test_bench_%d", "test_*_bench_%d" };
+    char mask[128];
+    const char *ptr_mask;
+    struct timeval tv1, tv2;
+    long long diff;
+    int num_hooks, i, sent;
+
+    for (num_hooks = 10; num_hooks <= HOOK_TEST_MAX_HOOKS; num_hooks *= 10)
+    {
+        for (i = 0; i < num_hooks; i++)
+        {
+            /* 98% of exact names/prefixes, 2% of other masks */
+            ptr_mask = (i % 50 == 0) ?
+                masks[2 + ((i / 50) % 2)] : masks[i % 2];
+            snprintf (mask, sizeof (mask), ptr_mask, i);
+            hooks[i] = hook_signal (NULL, mask, &test_signal_count_cb,
+                                    NULL, NULL);
+        }
+        hook_test_count = 0;
+        sent = 0;
+        gettimeofday (&tv1, NULL);
+        do
+        {
+            for (i = 0; i < 1000; i++)
+            {
+                hook_signal_send ("test_bench_1_line_added",
+                                  WEECHAT_HOOK_SIGNAL_POINTER, NULL);
+            }
+            sent += i;
+            gettimeofday (&tv2, NULL);
+            diff = util_timeval_diff (&tv1, &tv2);
+        } while (diff < 100000);
+        LONGS_EQUAL(sent, hook_test_count);
+        printf ("    hook_signal_send: %d hooks: %lld signals/s\n",
+                num_hooks, (sent * 1000000LL) / ((diff > 0) ? diff : 1));
+        for (i = 0; i < num_hooks; i++)
+        {
+            unhook (hooks[i]);
+        }
+    }
+}
+
+/*
+ * Tests functions:
+ *   hook_timer
+ *   hook_timer_get_time_to_next
+ *   hook_timer_exec
+ */
+
+TEST(Hook, Timer)
+{
+    struct t_hook *hook1, *hook2, *hook3;
+    int count, time_to_next;
+
+    count = hook_timer_heap_count;
+
+    POINTERS_EQUAL(NULL, hook_timer (NULL, 0, 0, 0, &test_timer_cb,
+                                     "t0", NULL));
+    POINTERS_EQUAL(NULL, hook_timer (NULL, 1000, 0, 0, NULL, "t0", NULL));
+
+    hook1 = hook_timer (NULL, 60000, 0, 0, &test_timer_cb, "t1", NULL);
+    hook2 = hook_timer (NULL, 20, 0, 2, &test_timer_cb, "t2", NULL);
+    hook3 = hook_timer (NULL, 40, 0, 1, &test_timer_cb, "t3", NULL);
+    CHECK(hook1);
+    CHECK(hook2);
+    CHECK(hook3);
+    LONGS_EQUAL(count + 3, hook_timer_heap_count);
+    CHECK(test_timer_heap_valid ());
+
+    /* next timeout is at most 20ms (timer "t2") */
+    time_to_next = hook_timer_get_time_to_next ();
+    CHECK(time_to_next >= 1);
+    CHECK(time_to_next <= 20);
+
+    /* nothing to execute now */
+    hook_test_calls[0] = '\0';
+    hook_timer_exec ();
+    STRCMP_EQUAL("", hook_test_calls);
+
+    /* after 30ms: only "t2" is executed */
+    usleep (30000);
+    hook_timer_exec ();
+    STRCMP_EQUAL("t2", hook_test_calls);
+    CHECK(test_timer_heap_valid ());
+
+    /* after 20ms more: "t2" (last call, then removed), "t3" (removed) */
+    hook_test_calls[0] = '\0';
+    usleep (20000);
+    hook_timer_exec ();
+    STRCMP_EQUAL("t2,t3", hook_test_calls);
+    LONGS_EQUAL(0, hook_valid (hook2));
+    LONGS_EQUAL(0, hook_valid (hook3));
+    CHECK(HOOK_TIMER(hook1, heap_index) >= 0);
+    POINTERS_EQUAL(hook1, hook_timer_heap[HOOK_TIMER(hook1, heap_index)]);
+    CHECK(test_timer_heap_valid ());
+
+    /* timer removed: not in heap any more */
+    count = hook_timer_heap_count;
+    unhook (hook1);
+    LONGS_EQUAL(count - 1, hook_timer_heap_count);
+    CHECK(test_timer_heap_valid ());
+}
+
+/*
+ * Tests functions:
+ *   hook_timer_exec (timer late by many intervals, like after a suspend of
+ *                    system)
+ */
+
+TEST(Hook, TimerLate)
+{
+    struct t_hook *hook1, *hook2;
+    long long time_before, time_after;
+    int time_to_next;
+
+    hook1 = hook_timer (NULL, 1000, 0, 3, &test_timer_cb, "t1", NULL);
+    hook2 = hook_timer (NULL, 1000, 1, 3, &test_timer_cb, "t2", NULL);
+    CHECK(hook1);
+    CHECK(hook2);
+
+    /* timers should have been executed 8 and 7 hours ago */
+    HOOK_TIMER(hook1, next_exec_monotonic) -= 8LL * 3600 * 1000000;
+    HOOK_TIMER(hook1, next_exec).tv_sec -= 8 * 3600;
+    hook_timer_heap_update (hook1);
+    HOOK_TIMER(hook2, next_exec_monotonic) -= 7LL * 3600 * 1000000;
+    HOOK_TIMER(hook2, next_exec).tv_sec -= 7 * 3600;
+    hook_timer_heap_update (hook2);
+    CHECK(test_timer_heap_valid ());
+
+    /* executed once (not one time per interval missed) */
+    hook_test_calls[0] = '\0';
+    time_before = util_get_time_monotonic ();
+    hook_timer_exec ();
+    time_after = util_get_time_monotonic ();
+    STRCMP_EQUAL("t1,t2", hook_test_calls);
+    LONGS_EQUAL(2, HOOK_TIMER(hook1, remaining_calls));
+    LONGS_EQUAL(2, HOOK_TIMER(hook2, remaining_calls));
+    CHECK(test_timer_heap_valid ());
+
+    /* next execution one interval later */
+    CHECK(HOOK_TIMER(hook1, next_exec_monotonic) >= time_before + 1000000);
+    CHECK(HOOK_TIMER(hook1, next_exec_monotonic) <= time_after + 1000000);
+    CHECK(HOOK_TIMER(hook2, next_exec_monotonic) > time_after);
+    CHECK(HOOK_TIMER(hook2, next_exec_monotonic) <= time_after + 1000000);
+    time_to_next = hook_timer_get_time_to_next ();
+    CHECK(time_to_next <= 1000);
+
+    /* nothing to execute now */
+    hook_test_calls[0] = '\0';
+    hook_timer_exec ();
+    STRCMP_EQUAL("", hook_test_calls);
+    LONGS_EQUAL(2, HOOK_TIMER(hook1, remaining_calls));
+    LONGS_EQUAL(2, HOOK_TIMER(hook2, remaining_calls));
+
+    unhook (hook1);
+    unhook (hook2);
+    CHECK(test_timer_heap_valid ());
+}
+
+/*
+ * Benchmark of function hook_timer_exec: main loop iterations per second
+ * with many timers that are not yet to execute, then cost of add/remove of
+ * timers.
+ */
+
+TEST(Hook, TimerBenchmark)
+{
+    struct t_hook *hooks[HOOK_TEST_TIMERS];
+    struct timeval tv1, tv2, tv3;
+    int i, loops;
+
+    hook_test_count = 0;
+
+    gettimeofday (&tv1, NULL);
+    for (i = 0; i < HOOK_TEST_TIMERS; i++)
+    {
+        hooks[i] = hook_timer (NULL, 60000 + ((i * 7919) % 10000), 0, 0,
+                               &test_timer_count_cb, NULL, NULL);
+        CHECK(hooks[i]);
+    }
+    gettimeofday (&tv2, NULL);
+    CHECK(test_timer_heap_valid ());
+
+    loops = 100000;
+    for (i = 0; i < loops; i++)
+    {
+        (void) hook_timer_get_time_to_next ();
+        hook_timer_exec ();
+    }
+    gettimeofday (&tv3, NULL);
+    LONGS_EQUAL(0, hook_test_count);
+
+    printf ("    hook_timer: %d timers: add: %lld us, "
+            "%lld main loop iterations/s\n",
+            HOOK_TEST_TIMERS,
+            util_timeval_diff (&tv1, &tv2),
+            (loops * 1000000LL) /
+            ((util_timeval_diff (&tv2, &tv3) > 0) ?
+             util_timeval_diff (&tv2, &tv3) : 1));
+
+    /* remove timers in random order */
+    for (i = 0; i < HOOK_TEST_TIMERS; i++)
+    {
+        unhook (hooks[(i * 7919) % HOOK_TEST_TIMERS]);
+        if ((i % 100) == 0)
+            CHECK(test_timer_heap_valid ());
+    }
+}
+
+/*
+ * Tests functions:
+ *   hook_fd
+ *   hook_fd_set_flags
+ *   hook_fd_exec
+ */
+
+TEST(Hook, Fd)
+{
+    struct t_hook *hook_read, *hook_write, *hook_ready;
+    int pipe1[2], pipe2[2];
+
+    CHECK(pipe (pipe1) == 0);
+    CHECK(pipe (pipe2) == 0);
+
+    /* pipe2 is always ready for writing, so hook_fd_exec never blocks */
+    hook_ready = hook_fd (NULL, pipe2[1], 0, 1, 0, &test_fd_cb, "always",
+                          NULL);
+    CHECK(hook_ready);
+
+    /* invalid fd hooks */
+    POINTERS_EQUAL(NULL, hook_fd (NULL, -1, 1, 0, 0, &test_fd_cb, "", NULL));
+    POINTERS_EQUAL(NULL, hook_fd (NULL, pipe1[0], 1, 0, 0, NULL, "", NULL));
+
+    hook_read = hook_fd (NULL, pipe1[0], 1, 0, 0, &test_fd_cb, "read", NULL);
+    CHECK(hook_read);
+    hook_write = hook_fd (NULL, pipe1[1], 0, 0, 1, &test_fd_cb, "write",
+                          NULL);
+    CHECK(hook_write);
+
+    /* only one hook per fd */
+    POINTERS_EQUAL(NULL, hook_fd (NULL, pipe1[0], 1, 0, 0, &test_fd_cb, "",
+                                  NULL));
+
+    /* nothing to read */
+    hook_test_calls[0] = '\0';
+    hook_fd_exec ();
+    STRCMP_EQUAL("always", hook_test_calls);
+
+    /* data to read */
+    CHECK(write (pipe1[1], "test", 4) == 4);
+    hook_test_calls[0] = '\0';
+    hook_fd_exec ();
+    CHECK(strstr (hook_test_calls, "read"));
+    CHECK(strstr (hook_test_calls, "always"));
+    CHECK(!strstr (hook_test_calls, "write"));
+
+    /* data has been read */
+    hook_test_calls[0] = '\0';
+    hook_fd_exec ();
+    STRCMP_EQUAL("always", hook_test_calls);
+
+    /* watch fd for writing */
+    hook_fd_set_flags (hook_write, HOOK_FD_FLAG_WRITE);
+    LONGS_EQUAL(HOOK_FD_FLAG_WRITE, HOOK_FD(hook_write, flags));
+    hook_test_calls[0] = '\0';
+    hook_fd_exec ();
+    CHECK(strstr (hook_test_calls, "write"));
+    CHECK(strstr (hook_test_calls, "always"));
+    CHECK(!strstr (hook_test_calls, "read"));
+
+    /* unhook and hook again the same fd */
+    unhook (hook_read);
+    hook_read = hook_fd (NULL, pipe1[0], 1, 0, 0, &test_fd_cb, "read2", NULL);
+    CHECK(hook_read);
+    hook_fd_set_flags (hook_write, 0);
+    CHECK(write (pipe1[1], "test", 4) == 4);
+    hook_test_calls[0] = '\0';
+    hook_fd_exec ();
+    CHECK(strstr (hook_test_calls, "read2"));
+    CHECK(strstr (hook_test_calls, "always"));
+    CHECK(!strstr (hook_test_calls, "write"));
+
+    unhook (hook_read);
+    unhook (hook_write);
+    unhook (hook_ready);
+
+    close (pipe1[0]);
+    close (pipe1[1]);
+    close (pipe2[0]);
+    close (pipe2[1]);
+}
+
+/*
+ * Benchmark of function hook_fd_exec: main loop iterations per second with
+ * many idle fd hooks (and one fd always ready, so that the loop never waits).
+ *
+ * If epoll is used, the same benchmark is done with poll(), for comparison.
+ */
+
+TEST(Hook, FdIdleBenchmark)
+{
+    struct t_hook *hooks[HOOK_TEST_FD_PIPES * 2], *hook_ready;
+    int pipes[HOOK_TEST_FD_PIPES][2], pipe_ready[2];
+    int i, num_pipes, loops, saved_epoll, backend;
+    struct rlimit limit;
+    struct timeval tv1, tv2;
+    long long diff;
+
+    /* raise limit of open files if needed */
+    if (getrlimit (RLIMIT_NOFILE, &limit) == 0)
+    {
+        if ((limit.rlim_cur != RLIM_INFINITY)
+            && (limit.rlim_cur < (HOOK_TEST_FD_PIPES * 2) + 64))
+        {
+            limit.rlim_cur = (HOOK_TEST_FD_PIPES * 2) + 64;
+            if ((limit.rlim_max != RLIM_INFINITY)
+                && (limit.rlim_cur > limit.rlim_max))
+            {
+                limit.rlim_cur = limit.rlim_max;
+            }
+            setrlimit (RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    CHECK(pipe (pipe_ready) == 0);
+    hook_ready = hook_fd (NULL, pipe_ready[1], 0, 1, 0, &test_fd_count_cb,
+                          NULL, NULL);
+    CHECK(hook_ready);
+
+    num_pipes = 0;
+    for (i = 0; i < HOOK_TEST_FD_PIPES; i++)
+    {
+        if (pipe (pipes[i]) != 0)
+            break;
+        hooks[i * 2] = hook_fd (NULL, pipes[i][0], 1, 0, 0,
+                                &test_fd_count_cb, NULL, NULL);
+        hooks[(i * 2) + 1] = hook_fd (NULL, pipes[i][1], 0, 0, 1,
+                                      &test_fd_count_cb, NULL, NULL);
+        num_pipes++;
+    }
+
+    saved_epoll = hook_fd_epoll;
+    for (backend = 0; backend < 2; backend++)
+    {
+        if (backend == 1)
+        {
+            if (saved_epoll < 0)
+                break;
+            /* force use of poll() */
+            hook_fd_epoll = -1;
+        }
+        hook_test_count = 0;
+        loops = 0;
+        gettimeofday (&tv1, NULL);
+        do
+        {
+            for (i = 0; i < 100; i++)
+            {
+                hook_fd_exec ();
+            }
+            loops += i;
+            gettimeofday (&tv2, NULL);
+            diff = util_timeval_diff (&tv1, &tv2);
+        } while (diff < 100000);
+        LONGS_EQUAL(loops, hook_test_count);
+        printf ("    hook_fd_exec (%s): %d fd hooks: %lld loops/s\n",
+                (hook_fd_epoll >= 0) ? "epoll" : "poll",
+                (num_pipes * 2) + 1,
+                (loops * 1000000LL) / ((diff > 0) ? diff : 1));
+    }
+    hook_fd_epoll = saved_epoll;
+
+    for (i = 0; i < num_pipes; i++)
+    {
+        unhook (hooks[i * 2]);
+        unhook (hooks[(i * 2) + 1]);
+        close (pipes[i][0]);
+        close (pipes[i][1]);
+    }
+    unhook (hook_ready);
+    close (pipe_ready[0]);
+    close (pipe_ready[1]);
+}
+
+/*
+ * Benchmark of function hook_process: number of round-trips per second
+ * (process started, then completed in the main loop), one process at a time.
+ *
+ * The end of child process is detected with SIGCHLD, so that the process
+ * is completed as soon as it exits (before, the child was checked every
+ * 100ms, which was limiting the round-trips to about 10 per second).
+ */
+
+TEST(Hook, ProcessBenchmark)
+{
+    struct timeval tv1, tv2, tv_start;
+    long long diff;
+    int i, return_code, count;
+
+    hook_test_count = 0;
+    gettimeofday (&tv1, NULL);
+    for (i = 0; i < HOOK_TEST_PROCESSES; i++)
+    {
+        return_code = -1;
+        count = hook_test_count;
+        CHECK(hook_process (NULL, "sh -c true", 5000, &test_process_cb,
+                            &return_code, NULL));
+        gettimeofday (&tv_start, NULL);
+        while (hook_test_count == count)
+        {
+            hook_timer_exec ();
+            hook_fd_exec ();
+            hook_process_exec ();
+            gettimeofday (&tv2, NULL);
+            if (util_timeval_diff (&tv_start, &tv2) > 5000000LL)
+                break;
+        }
+        LONGS_EQUAL(count + 1, hook_test_count);
+        LONGS_EQUAL(0, return_code);
+    }
+    gettimeofday (&tv2, NULL);
+    diff = util_timeval_diff (&tv1, &tv2);
+
+    printf ("    hook_process: %d processes: %lld round-trips/s\n",
+            HOOK_TEST_PROCESSES,
+            (HOOK_TEST_PROCESSES * 1000000LL) / ((diff > 0) ? diff : 1));
+}
+
+/*
+ * Tests functions:
+ *   hook_connect (without proxy)
+ */
+
+TEST(Hook, Connect)
+{
+    int sock_listen, sock_peer, port;
+
+    sock_listen = test_listen (&port);
+    CHECK(sock_listen >= 0);
+
+    /* connection OK */
+    hook_test_count = 0;
+    CHECK(hook_connect (NULL, NULL, "127.0.0.1", port, 0, 0,
+                        NULL, NULL, 0, NULL, NULL,
+                        &test_connect_cb, NULL, NULL));
+    test_wait_connect (1);
+    LONGS_EQUAL(1, hook_test_count);
+    LONGS_EQUAL(WEECHAT_HOOK_CONNECT_OK, hook_test_connect_status);
+    CHECK(hook_test_connect_sock >= 0);
+    STRCMP_EQUAL("127.0.0.1", hook_test_connect_ip);
+    sock_peer = accept (sock_listen, NULL, NULL);
+    CHECK(sock_peer >= 0);
+    close (sock_peer);
+    close (hook_test_connect_sock);
+
+    /* connection refused (nothing listening on port) */
+    close (sock_listen);
+    hook_test_count = 0;
+    CHECK(hook_connect (NULL, NULL, "127.0.0.1", port, 0, 0,
+                        NULL, NULL, 0, NULL, NULL,
+                        &test_connect_cb, NULL, NULL));
+    test_wait_connect (1);
+    LONGS_EQUAL(1, hook_test_count);
+    LONGS_EQUAL(WEECHAT_HOOK_CONNECT_CONNECTION_REFUSED,
+                hook_test_connect_status);
+    LONGS_EQUAL(-1, hook_test_connect_sock);
+
+    /* proxy not found (error sent immediately) */
+    hook_test_count = 0;
+    hook_connect (NULL, "unknown_proxy", "127.0.0.1", port, 0, 0,
+                  NULL, NULL, 0, NULL, NULL,
+                  &test_connect_cb, NULL, NULL);
+    LONGS_EQUAL(1, hook_test_count);
+    LONGS_EQUAL(WEECHAT_HOOK_CONNECT_PROXY_ERROR, hook_test_connect_status);
+}
+
+/*
+ * Tests functions:
+ *   hook_connect (with socks5 and http proxies, handshake without blocking)
+ */
+
+TEST(Hook, ConnectProxy)
+{
+    struct t_proxy *proxy;
+    struct t_hook *hook_listen;
+    int sock_listen, port, i;
+    char str_port[16];
+    const char *types[] = { "socks5", "http" };
+    const char *targets[] = { "irc.example.com:6697",
+                              "CONNECT irc.example.com:6697 HTTP/1.0" };
+
+    for (i = 0; i < 2; i++)
+    {
+        sock_listen = test_listen (&port);
+        CHECK(sock_listen >= 0);
+        hook_listen = hook_fd (NULL, sock_listen, 1, 0, 0,
+                               &test_proxy_accept_cb, types[i], NULL);
+        CHECK(hook_listen);
+        snprintf (str_port, sizeof (str_port), "%d", port);
+        proxy = proxy_new ("test_proxy", types[i], "off", "127.0.0.1",
+                           str_port, "", "");
+        CHECK(proxy);
+
+        hook_test_count = 0;
+        hook_test_proxy_length = 0;
+        hook_test_proxy_step = 0;
+        hook_test_proxy_target[0] = '\0';
+
+        /* the peer address is resolved by the proxy, not by WeeChat */
+        CHECK(hook_connect (NULL, "test_proxy", "irc.example.com", 6697, 0, 0,
+                            NULL, NULL, 0, NULL, NULL,
+                            &test_connect_cb, NULL, NULL));
+        test_wait_connect (1);
+        LONGS_EQUAL(1, hook_test_count);
+        LONGS_EQUAL(WEECHAT_HOOK_CONNECT_OK, hook_test_connect_status);
+        CHECK(hook_test_connect_sock >= 0);
+        STRCMP_EQUAL("127.0.0.1", hook_test_connect_ip);
+        STRCMP_EQUAL(targets[i], hook_test_proxy_target);
+
+        close (hook_test_connect_sock);
+        unhook (hook_test_proxy_hook);
+        close (hook_test_proxy_sock);
+        unhook (hook_listen);
+        close (sock_listen);
+        proxy_free (proxy);
+    }
+}
+
+/*
+ * Benchmark of function hook_connect: many connections started at same
+ * time (like servers reconnecting after a network failure), all done in
+ * the main loop (no process forked).
+ */
+
+TEST(Hook, ConnectBenchmark)
+{
+    struct timeval tv1, tv2;
+    long long diff;
+    int sock_listen, sock_peer, port, i;
+
+    sock_listen = test_listen (&port);
+    CHECK(sock_listen >= 0);
+
+    hook_test_count = 0;
+    gettimeofday (&tv1, NULL);
+    for (i = 0; i < HOOK_TEST_CONNECTIONS; i++)
+    {
+        CHECK(hook_connect (NULL, NULL, "127.0.0.1", port, 0, 0,
+                            NULL, NULL, 0, NULL, NULL,
+                            &test_connect_close_cb, NULL, NULL));
+    }
+    test_wait_connect (HOOK_TEST_CONNECTIONS);
+    gettimeofday (&tv2, NULL);
+    diff = util_timeval_diff (&tv1, &tv2);
+    LONGS_EQUAL(HOOK_TEST_CONNECTIONS, hook_test_count);
+
+    for (i = 0; i < HOOK_TEST_CONNECTIONS; i++)
+    {
+        sock_peer = accept (sock_listen, NULL, NULL);
+        CHECK(sock_peer >= 0);
+        close (sock_peer);
+    }
+    close (sock_listen);
+
+    printf ("    hook_connect: %d parallel connections: %lld ms\n",
+            HOOK_TEST_CONNECTIONS, diff / 1000);
+}
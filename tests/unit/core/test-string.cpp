@@ -30,10 +30,12 @@ extern "C"
 #include <stdio.h>
 #include <string.h>
 #include <regex.h>
+#include <sys/time.h>
 #include "tests/tests.h"
 #include "src/core/weechat.h"
 #include "src/core/wee-string.h"
 #include "src/core/wee-hashtable.h"
+#include "src/core/wee-util.h"
 #include "src/plugins/plugin.h"
 }
 
@@ -42,11 +44,20 @@ extern "C"
 #define ONE_GB (ONE_MB * 1000ULL)
 #define ONE_TB (ONE_GB * 1000ULL)
 
+#define STRING_TEST_BENCHMARK_HL_WORDS 50
+#define STRING_TEST_BENCHMARK_HL_LINES 10000
+
 #define WEE_IS_WORD_CHAR(__result, __str)                               \
     LONGS_EQUAL(__result, string_is_word_char_highlight (__str));       \
     LONGS_EQUAL(__result, string_is_word_char_input (__str));
 #define WEE_HAS_HL_STR(__result, __str, __words)                        \
-    LONGS_EQUAL(__result, string_has_highlight (__str, __words));
+    LONGS_EQUAL(__result, string_has_highlight (__str, __words));       \
+    highlight = string_highlight_new ();                                \
+    CHECK(highlight);                                                   \
+    LONGS_EQUAL(1, string_highlight_add_words (highlight, __words));    \
+    LONGS_EQUAL(__result,                                               \
+                string_has_highlight_compiled (__str, highlight));      \
+    string_highlight_free (highlight);
 
 #define WEE_HAS_HL_REGEX(__result_regex, __result_hl, __str, __regex)   \
     LONGS_EQUAL(__result_hl,                                            \
@@ -614,12 +625,17 @@ TEST(String, Regex)
 /*
  * Tests functions:
  *   string_has_highlight
+ *   string_highlight_new
+ *   string_highlight_add_words
+ *   string_has_highlight_compiled
+ *   string_highlight_free
  *   string_has_highlight_regex_compiled
  *   string_has_highlight_regex
  */
 
 TEST(String, Highlight)
 {
+    struct t_string_highlight *highlight;
     regex_t regex;
 
     /* check highlight with a string */
@@ -640,6 +656,27 @@ TEST(String, Highlight)
     WEE_HAS_HL_STR(1, "test\u00A0:here", "test");  /* unbreakable space */
     WEE_HAS_HL_STR(1, "this is a test here", "test");
     WEE_HAS_HL_STR(1, "this is a test here", "abc,test");
+    WEE_HAS_HL_STR(1, "this is a TEST here", "abc,test");
+    WEE_HAS_HL_STR(0, "this is a TEST here", "abc,(?-i)test");
+    WEE_HAS_HL_STR(1, "this is a TEST here", "abc,(?-i)TEST");
+    WEE_HAS_HL_STR(1, "this is a TEST here", "(?-i)test,TEST");
+    WEE_HAS_HL_STR(0, "testing", "test");
+    WEE_HAS_HL_STR(1, "testing", "test*");
+    WEE_HAS_HL_STR(0, "retest", "test*");
+    WEE_HAS_HL_STR(1, "retest", "*test");
+    WEE_HAS_HL_STR(0, "retesting", "*test");
+    WEE_HAS_HL_STR(1, "retesting", "*test*");
+    WEE_HAS_HL_STR(0, "test", "*");
+    WEE_HAS_HL_STR(0, "test", ",,");
+    WEE_HAS_HL_STR(1, "xtest test", "test");
+    WEE_HAS_HL_STR(1, "testtest test", "test");
+    WEE_HAS_HL_STR(0, "aaa", "aa");
+    WEE_HAS_HL_STR(0, "xa a", "a a");
+    WEE_HAS_HL_STR(1, "x a a", "a a");
+    WEE_HAS_HL_STR(0, "xa a a", "a a");
+    WEE_HAS_HL_STR(1, "he said éte!", "été,éte");
+    WEE_HAS_HL_STR(0, "he said étés", "été,éte");
+    WEE_HAS_HL_STR(1, "he said étés", "été*");
 
     /*
      * check highlight with a regex, each call of macro
@@ -660,6 +697,153 @@ TEST(String, Highlight)
     WEE_HAS_HL_REGEX(0, 0, "test here", "teste.*");
 }
 
+/*
+ * Tests functions:
+ *   string_has_highlight_compiled
+ *
+ * Compares result of function string_has_highlight_compiled with function
+ * string_has_highlight on random strings and words.
+ */
+
+TEST(String, HighlightCompiledRandom)
+{
+    struct t_string_highlight *highlight;
+    const char *chars[] = { "a", "A", "b", "B", " ", "-", ":", "é", "É",
+                            "\u00A0", NULL };
+    const char *prefixes[] = { "", "", "*", "(?-i)", "(?-i)*", NULL };
+    char str[256], words[256];
+    int i, j, count_chars, count_prefixes, length, result, result_compiled;
+
+    for (count_chars = 0; chars[count_chars]; count_chars++)
+    {
+    }
+    for (count_prefixes = 0; prefixes[count_prefixes]; count_prefixes++)
+    {
+    }
+
+    srand (42);
+
+    for (i = 0; i < 20000; i++)
+    {
+        /* random string */
+        str[0] = '\0';
+        length = rand () % 16;
+        for (j = 0; j < length; j++)
+        {
+            strcat (str, chars[rand () % count_chars]);
+        }
+
+        /* random words (with random flags and wildcards) */
+        words[0] = '\0';
+        length = 1 + (rand () % 4);
+        for (j = 0; j < length; j++)
+        {
+            if (j > 0)
+                strcat (words, ",");
+            strcat (words, prefixes[rand () % count_prefixes]);
+            switch (rand () % 3)
+            {
+                case 0:
+                    strcat (words, chars[rand () % count_chars]);
+                    break;
+                case 1:
+                    strcat (words, chars[rand () % count_chars]);
+                    strcat (words, chars[rand () % count_chars]);
+                    break;
+                default:
+                    strcat (words, chars[rand () % count_chars]);
+                    strcat (words, chars[rand () % count_chars]);
+                    strcat (words, chars[rand () % count_chars]);
+                    break;
+            }
+            if (rand () % 4 == 0)
+                strcat (words, "*");
+        }
+
+        result = string_has_highlight (str, words);
+        highlight = string_highlight_new ();
+        CHECK(highlight);
+        LONGS_EQUAL(1, string_highlight_add_words (highlight, words));
+        result_compiled = string_has_highlight_compiled (str, highlight);
+        string_highlight_free (highlight);
+        if (result != result_compiled)
+        {
+            printf ("\nstring: \"%s\", words: \"%s\"\n", str, words);
+        }
+        LONGS_EQUAL(result, result_compiled);
+    }
+}
+
+/*
+ * Tests functions:
+ *   string_has_highlight (benchmark)
+ *   string_has_highlight_compiled (benchmark)
+ */
+
+TEST(String, HighlightBenchmark)
+{
+    struct t_string_highlight *highlight;
+    struct timeval time1, time2;
+    char words[4096], word[64], line[256];
+    long long time_hl, time_hl_compiled;
+    int i, count, count_compiled;
+
+    /* build a list of words, like in a long option weechat.look.highlight */
+    words[0] = '\0';
+    for (i = 0; i < STRING_TEST_BENCHMARK_HL_WORDS; i++)
+    {
+        snprintf (word, sizeof (word), "%s%sword%03d%s",
+                  (i > 0) ? "," : "",
+                  (i % 5 == 0) ? "(?-i)" : "",
+                  i,
+                  (i % 7 == 0) ? "*" : "");
+        strcat (words, word);
+    }
+
+    /* check highlight with words as string */
+    count = 0;
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < STRING_TEST_BENCHMARK_HL_LINES; i++)
+    {
+        snprintf (line, sizeof (line),
+                  "this is a message on an IRC channel, with some words "
+                  "but not always a highlight: word%03d",
+                  (i * 7) % (STRING_TEST_BENCHMARK_HL_WORDS * 20));
+        if (string_has_highlight (line, words))
+            count++;
+    }
+    gettimeofday (&time2, NULL);
+    time_hl = util_timeval_diff (&time1, &time2);
+
+    /* check highlight with compiled words */
+    count_compiled = 0;
+    gettimeofday (&time1, NULL);
+    highlight = string_highlight_new ();
+    CHECK(highlight);
+    LONGS_EQUAL(1, string_highlight_add_words (highlight, words));
+    for (i = 0; i < STRING_TEST_BENCHMARK_HL_LINES; i++)
+    {
+        snprintf (line, sizeof (line),
+                  "this is a message on an IRC channel, with some words "
+                  "but not always a highlight: word%03d",
+                  (i * 7) % (STRING_TEST_BENCHMARK_HL_WORDS * 20));
+        if (string_has_highlight_compiled (line, highlight))
+            count_compiled++;
+    }
+    string_highlight_free (highlight);
+    gettimeofday (&time2, NULL);
+    time_hl_compiled = util_timeval_diff (&time1, &time2);
+
+    CHECK(count > 0);
+    LONGS_EQUAL(count, count_compiled);
+
+    printf ("\n");
+    printf ("highlight benchmark (%d words, %d lines):\n",
+            STRING_TEST_BENCHMARK_HL_WORDS, STRING_TEST_BENCHMARK_HL_LINES);
+    printf ("  string. . : %lld ms\n", time_hl / 1000);
+    printf ("  compiled. : %lld ms\n", time_hl_compiled / 1000);
+}
+
 /*
  * Test callback for function string_replace_with_callback.
  *
@@ -1056,6 +1240,15 @@ TEST(String, Iconv)
     WEE_TEST_STR("abc", string_iconv (1, "UTF-8", "ISO-8859-15", "abc"));
     WEE_TEST_STR(noel_iso, string_iconv (1, "UTF-8", "ISO-8859-15", noel_utf8));
     WEE_TEST_STR(noel_utf8, string_iconv (0, "ISO-8859-15", "UTF-8", noel_iso));
+    WEE_TEST_STR(noel_iso, string_iconv (1, "UTF-8", "ISO-8859-15", noel_utf8));
+    WEE_TEST_STR("abc", string_iconv (0, "invalid", "UTF-8", "abc"));
+    WEE_TEST_STR(noel_iso, string_iconv (0, "invalid", "UTF-8", noel_iso));
+    /* 7-bit chars are changed by UTF-7 */
+    WEE_TEST_STR("a+-b", string_iconv (1, "UTF-8", "UTF-7", "a+b"));
+    WEE_TEST_STR("a+b", string_iconv (0, "UTF-7", "UTF-8", "a+-b"));
+    /* UTF-8 to UTF-8: valid string is unchanged, invalid chars are replaced */
+    WEE_TEST_STR(noel_utf8, string_iconv (1, "UTF-8", "UTF8", noel_utf8));
+    WEE_TEST_STR("a?b", string_iconv (1, "UTF-8", "UTF8", "a\xff" "b"));
 
     /* string_iconv_to_internal */
     WEE_TEST_STR(NULL, string_iconv_to_internal (NULL, NULL));
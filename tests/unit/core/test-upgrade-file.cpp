@@ -0,0 +1,563 @@
+/*
+ * test-upgrade-file.cpp - test upgrade file functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#ifndef HAVE_CONFIG_H
+#define HAVE_CONFIG_H
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "src/core/weechat.h"
+#include "src/core/wee-infolist.h"
+#include "src/core/wee-upgrade-file.h"
+#include "src/core/wee-util.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-line.h"
+#include "src/plugins/weechat-plugin.h"
+}
+
+#define UPGRADE_FILE_TEST_NAME "test_upgrade_file"
+#define UPGRADE_FILE_TEST_BENCHMARK_LINES 50000
+
+#define UPGRADE_FILE_TEST_LINE_PREFIX "alice"
+#define UPGRADE_FILE_TEST_LINE_MESSAGE                                  \
+    "this is a message on a busy channel, saved in upgrade file"
+#define UPGRADE_FILE_TEST_LINE_TAGS                                     \
+    "irc_privmsg,notify_message,prefix_nick_lightcyan,nick_alice,log1"
+
+int upgrade_file_test_objects = 0;
+int upgrade_file_test_records = 0;
+char upgrade_file_test_values[1024];
+
+/*
+ * Callback for objects read in upgrade file: values are concatenated in
+ * upgrade_file_test_values.
+ */
+
+int
+test_upgrade_file_read_cb (const void *pointer, void *data,
+                           struct t_upgrade_file *upgrade_file,
+                           int object_id,
+                           struct t_infolist *infolist)
+{
+    char str_value[256];
+    const char *ptr_string;
+    int size;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) upgrade_file;
+
+    upgrade_file_test_objects++;
+
+    infolist_reset_item_cursor (infolist);
+    while (infolist_next (infolist))
+    {
+        ptr_string = infolist_string (infolist, "str");
+        snprintf (str_value, sizeof (str_value),
+                  "%d:%d,%s,%s,%ld,%s;",
+                  object_id,
+                  infolist_integer (infolist, "int"),
+                  (ptr_string) ? ptr_string : "(null)",
+                  (infolist_string (infolist, "null")) ? "not_null" : "(null)",
+                  (long)infolist_time (infolist, "time"),
+                  (infolist_buffer (infolist, "buf", &size)) ?
+                  "buf" : "(null)");
+        strcat (upgrade_file_test_values, str_value);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback for records read in upgrade file: values are concatenated in
+ * upgrade_file_test_values.
+ */
+
+int
+test_upgrade_file_read_record_cb (const void *pointer, void *data,
+                                  struct t_upgrade_file *upgrade_file,
+                                  struct t_upgrade_record *record)
+{
+    char str_value[256];
+    const char *ptr_string;
+    const void *ptr_buffer;
+    int size, value;
+
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) upgrade_file;
+
+    upgrade_file_test_records++;
+
+    ptr_string = upgrade_file_record_string (
+        record, upgrade_file_record_search_field (record, "str"));
+    ptr_buffer = upgrade_file_record_buffer (
+        record, upgrade_file_record_search_field (record, "buf"), &size);
+    value = 0;
+    if (ptr_buffer && (size == (int)sizeof (value)))
+        memcpy (&value, ptr_buffer, size);
+    snprintf (str_value, sizeof (str_value),
+              "%d:%d,%s,%s,%ld,%d;",
+              record->object_id,
+              upgrade_file_record_integer (
+                  record, upgrade_file_record_search_field (record, "int")),
+              (ptr_string) ? ptr_string : "(null)",
+              (upgrade_file_record_string (
+                  record,
+                  upgrade_file_record_search_field (record, "null"))) ?
+              "not_null" : "(null)",
+              (long)upgrade_file_record_time (
+                  record, upgrade_file_record_search_field (record, "time")),
+              value);
+    strcat (upgrade_file_test_values, str_value);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback for benchmark: reads a line from an infolist.
+ */
+
+int
+test_upgrade_file_bench_read_cb (const void *pointer, void *data,
+                                 struct t_upgrade_file *upgrade_file,
+                                 int object_id,
+                                 struct t_infolist *infolist)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) upgrade_file;
+    (void) object_id;
+
+    infolist_reset_item_cursor (infolist);
+    while (infolist_next (infolist))
+    {
+        if (infolist_time (infolist, "date")
+            && infolist_string (infolist, "tags")
+            && infolist_string (infolist, "prefix")
+            && infolist_string (infolist, "message"))
+        {
+            upgrade_file_test_objects++;
+        }
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback for benchmark: reads a line from a record.
+ */
+
+int
+test_upgrade_file_bench_read_record_cb (const void *pointer, void *data,
+                                        struct t_upgrade_file *upgrade_file,
+                                        struct t_upgrade_record *record)
+{
+    /* make C compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) upgrade_file;
+
+    if (upgrade_file_record_time (record, 0)
+        && upgrade_file_record_string (record, 1)
+        && upgrade_file_record_string (record, 2)
+        && upgrade_file_record_string (record, 3))
+    {
+        upgrade_file_test_records++;
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+TEST_GROUP(UpgradeFile)
+{
+    void setup ()
+    {
+        upgrade_file_test_objects = 0;
+        upgrade_file_test_records = 0;
+        upgrade_file_test_values[0] = '\0';
+    }
+
+    void teardown ()
+    {
+        char filename[1024];
+
+        snprintf (filename, sizeof (filename), "%s/%s.upgrade",
+                  weechat_home, UPGRADE_FILE_TEST_NAME);
+        unlink (filename);
+    }
+
+    /*
+     * Writes a test file with a schema, two records and an object (infolist).
+     */
+
+    void write_test_file ()
+    {
+        struct t_upgrade_file *upgrade_file;
+        struct t_infolist *infolist;
+        struct t_infolist_item *item;
+        int value;
+
+        upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                         NULL, NULL, NULL);
+        CHECK(upgrade_file);
+
+        LONGS_EQUAL(1, upgrade_file_write_schema (
+                        upgrade_file, 1,
+                        "i:int,s:str,s:null,t:time,b:buf"));
+        value = 42;
+        LONGS_EQUAL(1, upgrade_file_write_record (
+                        upgrade_file, 1,
+                        123, "abc", NULL, (time_t)1528000000,
+                        &value, (int)sizeof (value)));
+        LONGS_EQUAL(1, upgrade_file_write_record (
+                        upgrade_file, 1,
+                        -5, "", NULL, (time_t)0,
+                        NULL, 0));
+
+        infolist = infolist_new (NULL);
+        CHECK(infolist);
+        item = infolist_new_item (infolist);
+        CHECK(item);
+        infolist_new_var_integer (item, "int", 7);
+        infolist_new_var_string (item, "str", "def");
+        infolist_new_var_time (item, "time", 1);
+        LONGS_EQUAL(1, upgrade_file_write_object (upgrade_file, 2, infolist));
+        infolist_free (infolist);
+
+        upgrade_file_close (upgrade_file);
+    }
+
+    /*
+     * Writes a test file with a signature, an optional version of format
+     * (if >= 0) and an optional object type (if >= 0).
+     */
+
+    void write_raw_test_file (const char *signature, int version, int type)
+    {
+        char filename[1024];
+        FILE *file;
+        int length;
+
+        snprintf (filename, sizeof (filename), "%s/%s.upgrade",
+                  weechat_home, UPGRADE_FILE_TEST_NAME);
+        file = fopen (filename, "w");
+        CHECK(file);
+        length = strlen (signature);
+        fwrite (&length, sizeof (length), 1, file);
+        fwrite (signature, 1, length, file);
+        if (version >= 0)
+            fwrite (&version, sizeof (version), 1, file);
+        if (type >= 0)
+            fwrite (&type, sizeof (type), 1, file);
+        fclose (file);
+    }
+
+    /*
+     * Checks if a message was displayed in the last lines of core buffer.
+     */
+
+    int error_displayed (const char *message)
+    {
+        struct t_gui_line *ptr_line;
+        int i;
+
+        ptr_line = gui_buffers->own_lines->last_line;
+        for (i = 0; ptr_line && (i < 10); i++)
+        {
+            if (ptr_line->data->message
+                && strstr (ptr_line->data->message, message))
+            {
+                return 1;
+            }
+            ptr_line = ptr_line->prev_line;
+        }
+        return 0;
+    }
+
+    /*
+     * Reads the test file, returns the result of upgrade_file_read.
+     */
+
+    int read_test_file (int *version)
+    {
+        struct t_upgrade_file *upgrade_file;
+        int rc;
+
+        upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                         &test_upgrade_file_read_cb,
+                                         NULL, NULL);
+        CHECK(upgrade_file);
+        upgrade_file->callback_read_record = &test_upgrade_file_read_record_cb;
+        rc = upgrade_file_read (upgrade_file);
+        *version = upgrade_file->version;
+        upgrade_file_close (upgrade_file);
+        return rc;
+    }
+};
+
+/*
+ * Tests functions:
+ *   upgrade_file_new (version of format written after signature)
+ *   upgrade_file_read (version of format)
+ */
+
+TEST(UpgradeFile, Version)
+{
+    int version;
+
+    /* file written with the current version */
+    write_test_file ();
+    LONGS_EQUAL(1, read_test_file (&version));
+    LONGS_EQUAL(UPGRADE_FILE_VERSION, version);
+    LONGS_EQUAL(2, upgrade_file_test_records);
+
+    /* old signature (format 1), with only objects */
+    write_raw_test_file (UPGRADE_SIGNATURE_V1, -1, -1);
+    LONGS_EQUAL(1, read_test_file (&version));
+    LONGS_EQUAL(1, version);
+
+    /* old signature (format 1) with a schema: not allowed */
+    write_raw_test_file (UPGRADE_SIGNATURE_V1, -1, UPGRADE_TYPE_SCHEMA);
+    LONGS_EQUAL(0, read_test_file (&version));
+    CHECK(error_displayed ("schema in format 1"));
+
+    /* missing version */
+    write_raw_test_file (UPGRADE_SIGNATURE, -1, -1);
+    LONGS_EQUAL(0, read_test_file (&version));
+    CHECK(error_displayed ("version not found"));
+
+    /* version of a newer WeeChat */
+    write_raw_test_file (UPGRADE_SIGNATURE, UPGRADE_FILE_VERSION + 1,
+                         UPGRADE_TYPE_OBJECT_START);
+    LONGS_EQUAL(0, read_test_file (&version));
+    CHECK(error_displayed ("unsupported upgrade file version"));
+
+    /* unknown signature */
+    write_raw_test_file ("===== WeeChat Upgrade file v1.0 =====", -1, -1);
+    LONGS_EQUAL(0, read_test_file (&version));
+    CHECK(error_displayed ("bad signature"));
+}
+
+/*
+ * Tests functions:
+ *   upgrade_file_new
+ *   upgrade_file_write_schema
+ *   upgrade_file_write_record
+ *   upgrade_file_write_object
+ *   upgrade_file_read
+ *   upgrade_file_record_search_field
+ *   upgrade_file_record_integer
+ *   upgrade_file_record_string
+ *   upgrade_file_record_time
+ *   upgrade_file_record_buffer
+ *   upgrade_file_close
+ */
+
+TEST(UpgradeFile, Records)
+{
+    struct t_upgrade_file *upgrade_file;
+
+    write_test_file ();
+
+    /* read records with record callback */
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     &test_upgrade_file_read_cb, NULL, NULL);
+    CHECK(upgrade_file);
+    upgrade_file->callback_read_record = &test_upgrade_file_read_record_cb;
+    LONGS_EQUAL(1, upgrade_file_read (upgrade_file));
+    LONGS_EQUAL(1, upgrade_file->count_objects);
+    LONGS_EQUAL(2, upgrade_file->count_records);
+    upgrade_file_close (upgrade_file);
+    LONGS_EQUAL(1, upgrade_file_test_objects);
+    LONGS_EQUAL(2, upgrade_file_test_records);
+    STRCMP_EQUAL("1:123,abc,(null),1528000000,42;"
+                 "1:-5,,(null),0,0;"
+                 "2:7,def,(null),1,(null);",
+                 upgrade_file_test_values);
+
+    /* read records without record callback: records are sent in infolists */
+    setup ();
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     &test_upgrade_file_read_cb, NULL, NULL);
+    CHECK(upgrade_file);
+    LONGS_EQUAL(1, upgrade_file_read (upgrade_file));
+    upgrade_file_close (upgrade_file);
+    LONGS_EQUAL(3, upgrade_file_test_objects);
+    LONGS_EQUAL(0, upgrade_file_test_records);
+    STRCMP_EQUAL("1:123,abc,(null),1528000000,buf;"
+                 "1:-5,,(null),0,(null);"
+                 "2:7,def,(null),1,(null);",
+                 upgrade_file_test_values);
+}
+
+/*
+ * Tests functions:
+ *   upgrade_file_write_schema (errors)
+ *   upgrade_file_write_record (errors)
+ *   upgrade_file_read (errors)
+ */
+
+TEST(UpgradeFile, Errors)
+{
+    struct t_upgrade_file *upgrade_file;
+    char filename[1024];
+    FILE *file;
+    long size;
+
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     NULL, NULL, NULL);
+    CHECK(upgrade_file);
+    LONGS_EQUAL(0, upgrade_file_write_schema (upgrade_file, 1, NULL));
+    LONGS_EQUAL(0, upgrade_file_write_schema (upgrade_file, 1, ""));
+    LONGS_EQUAL(0, upgrade_file_write_schema (upgrade_file, 1, "x:name"));
+    LONGS_EQUAL(0, upgrade_file_write_schema (upgrade_file, 1, "i:"));
+    LONGS_EQUAL(0, upgrade_file_write_record (upgrade_file, 3, 1));
+    upgrade_file_close (upgrade_file);
+
+    /* truncated file */
+    write_test_file ();
+    snprintf (filename, sizeof (filename), "%s/%s.upgrade",
+              weechat_home, UPGRADE_FILE_TEST_NAME);
+    file = fopen (filename, "r+");
+    CHECK(file);
+    fseek (file, 0, SEEK_END);
+    size = ftell (file);
+    fclose (file);
+    LONGS_EQUAL(0, truncate (filename, size - 3));
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     &test_upgrade_file_read_cb, NULL, NULL);
+    CHECK(upgrade_file);
+    upgrade_file->callback_read_record = &test_upgrade_file_read_record_cb;
+    LONGS_EQUAL(0, upgrade_file_read (upgrade_file));
+    upgrade_file_close (upgrade_file);
+    LONGS_EQUAL(2, upgrade_file_test_records);
+}
+
+/*
+ * Tests functions:
+ *   upgrade_file_write_record (benchmark)
+ *   upgrade_file_read (benchmark)
+ *
+ * Compares buffer lines saved and read as records with lines saved and read
+ * as infolists (as before).
+ */
+
+TEST(UpgradeFile, Benchmark)
+{
+    struct t_upgrade_file *upgrade_file;
+    struct t_infolist *infolist;
+    struct t_infolist_item *item;
+    struct timeval time1, time2;
+    long long time_write_infolist, time_read_infolist;
+    long long time_write_records, time_read_records;
+    int i;
+
+    /* lines saved as infolists */
+    gettimeofday (&time1, NULL);
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     NULL, NULL, NULL);
+    CHECK(upgrade_file);
+    for (i = 0; i < UPGRADE_FILE_TEST_BENCHMARK_LINES; i++)
+    {
+        infolist = infolist_new (NULL);
+        item = infolist_new_item (infolist);
+        infolist_new_var_integer (item, "y", -1);
+        infolist_new_var_time (item, "date", 1528000000 + i);
+        infolist_new_var_time (item, "date_printed", 1528000000 + i);
+        infolist_new_var_integer (item, "highlight", 0);
+        infolist_new_var_integer (item, "last_read_line", 0);
+        infolist_new_var_string (item, "tags", UPGRADE_FILE_TEST_LINE_TAGS);
+        infolist_new_var_string (item, "prefix", UPGRADE_FILE_TEST_LINE_PREFIX);
+        infolist_new_var_string (item, "message",
+                                 UPGRADE_FILE_TEST_LINE_MESSAGE);
+        upgrade_file_write_object (upgrade_file, 1, infolist);
+        infolist_free (infolist);
+    }
+    upgrade_file_close (upgrade_file);
+    gettimeofday (&time2, NULL);
+    time_write_infolist = util_timeval_diff (&time1, &time2);
+
+    gettimeofday (&time1, NULL);
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     &test_upgrade_file_bench_read_cb,
+                                     NULL, NULL);
+    CHECK(upgrade_file);
+    LONGS_EQUAL(1, upgrade_file_read (upgrade_file));
+    upgrade_file_close (upgrade_file);
+    gettimeofday (&time2, NULL);
+    time_read_infolist = util_timeval_diff (&time1, &time2);
+    LONGS_EQUAL(UPGRADE_FILE_TEST_BENCHMARK_LINES, upgrade_file_test_objects);
+
+    /* lines saved as records */
+    gettimeofday (&time1, NULL);
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     NULL, NULL, NULL);
+    CHECK(upgrade_file);
+    upgrade_file_write_schema (upgrade_file, 1,
+                               "t:date,s:tags,s:prefix,s:message,i:y,"
+                               "t:date_printed,i:highlight,i:last_read_line");
+    for (i = 0; i < UPGRADE_FILE_TEST_BENCHMARK_LINES; i++)
+    {
+        upgrade_file_write_record (upgrade_file, 1,
+                                   (time_t)(1528000000 + i),
+                                   UPGRADE_FILE_TEST_LINE_TAGS,
+                                   UPGRADE_FILE_TEST_LINE_PREFIX,
+                                   UPGRADE_FILE_TEST_LINE_MESSAGE,
+                                   -1,
+                                   (time_t)(1528000000 + i),
+                                   0,
+                                   0);
+    }
+    upgrade_file_close (upgrade_file);
+    gettimeofday (&time2, NULL);
+    time_write_records = util_timeval_diff (&time1, &time2);
+
+    gettimeofday (&time1, NULL);
+    upgrade_file = upgrade_file_new (UPGRADE_FILE_TEST_NAME,
+                                     &test_upgrade_file_bench_read_cb,
+                                     NULL, NULL);
+    CHECK(upgrade_file);
+    upgrade_file->callback_read_record = &test_upgrade_file_bench_read_record_cb;
+    LONGS_EQUAL(1, upgrade_file_read (upgrade_file));
+    upgrade_file_close (upgrade_file);
+    gettimeofday (&time2, NULL);
+    time_read_records = util_timeval_diff (&time1, &time2);
+    LONGS_EQUAL(UPGRADE_FILE_TEST_BENCHMARK_LINES, upgrade_file_test_records);
+
+    printf ("\n");
+    printf ("upgrade file benchmark (%d buffer lines):\n",
+            UPGRADE_FILE_TEST_BENCHMARK_LINES);
+    printf ("  infolists: write: %lld ms, read: %lld ms\n",
+            time_write_infolist / 1000, time_read_infolist / 1000);
+    printf ("  records  : write: %lld ms, read: %lld ms\n",
+            time_write_records / 1000, time_read_records / 1000);
+}
@@ -57,6 +57,10 @@ TEST(Utf8, Validity)
     LONGS_EQUAL(0, utf8_has_8bits (""));
     LONGS_EQUAL(0, utf8_has_8bits ("abc"));
     LONGS_EQUAL(1, utf8_has_8bits ("no\xc3\xabl"));
+    LONGS_EQUAL(0, utf8_has_8bits ("abcdefghijklmnopqrstuvwxyz"));
+    LONGS_EQUAL(1, utf8_has_8bits ("abcdefgh\xc3\xabijklmnopqrstuvwxyz"));
+    LONGS_EQUAL(1, utf8_has_8bits ("abcdefghijklmnopqrstuvwxy\xc3\xab"));
+    LONGS_EQUAL(1, utf8_has_8bits ("abcdefghijklmnopqrstuvwx\xc3\xab"));
 
     /* check validity */
     LONGS_EQUAL(1, utf8_is_valid (NULL, -1, NULL));
@@ -0,0 +1,179 @@
+/*
+ * test-bar-item.cpp - test bar item functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/core/wee-config-file.h"
+#include "src/gui/gui-bar.h"
+#include "src/gui/gui-bar-item.h"
+#include "src/gui/gui-bar-window.h"
+#include "src/gui/gui-window.h"
+}
+
+#define BAR_ITEM_TEST_BAR "test_bar_item"
+
+TEST_GROUP(BarItem)
+{
+    struct t_gui_bar *bar;
+    struct t_gui_bar_window *bar_window;
+
+    void setup ()
+    {
+        /* flush updates asked before the test */
+        gui_bar_item_update_dirty ();
+
+        bar = gui_bar_new (BAR_ITEM_TEST_BAR, "off", "0", "window", "",
+                           "top", "horizontal", "vertical", "1", "0",
+                           "default", "default", "default", "off",
+                           "test_item1,test_item2+test_item1");
+        CHECK(bar);
+        bar_window = gui_bar_window_search_bar (gui_current_window, bar);
+        CHECK(bar_window);
+        bar_window->items_refresh_needed[0][0] = 0;
+        bar_window->items_refresh_needed[1][0] = 0;
+        bar_window->items_refresh_needed[1][1] = 0;
+    }
+
+    void teardown ()
+    {
+        gui_bar_free (bar);
+    }
+};
+
+/*
+ * Tests functions:
+ *   gui_bar_item_update
+ *   gui_bar_item_update_dirty
+ */
+
+TEST(BarItem, UpdateCoalesced)
+{
+    long long requested, done;
+    int i;
+
+    requested = gui_bar_item_count_updates_requested;
+    done = gui_bar_item_count_updates_done;
+
+    gui_bar_item_update (NULL);
+    LONGS_EQUAL(requested, gui_bar_item_count_updates_requested);
+
+    /* updates are delayed until next refresh */
+    for (i = 0; i < 100; i++)
+    {
+        gui_bar_item_update ("test_item1");
+    }
+    gui_bar_item_update ("test_item2");
+    LONGS_EQUAL(requested + 101, gui_bar_item_count_updates_requested);
+    LONGS_EQUAL(done, gui_bar_item_count_updates_done);
+    LONGS_EQUAL(0, bar_window->items_refresh_needed[0][0]);
+    LONGS_EQUAL(0, bar_window->items_refresh_needed[1][0]);
+    LONGS_EQUAL(0, bar_window->items_refresh_needed[1][1]);
+
+    /* all updates of an item are done at once */
+    gui_bar_item_update_dirty ();
+    LONGS_EQUAL(done + 2, gui_bar_item_count_updates_done);
+    LONGS_EQUAL(1, bar_window->items_refresh_needed[0][0]);
+    LONGS_EQUAL(1, bar_window->items_refresh_needed[1][0]);
+    LONGS_EQUAL(1, bar_window->items_refresh_needed[1][1]);
+
+    /* nothing to update */
+    gui_bar_item_update_dirty ();
+    LONGS_EQUAL(done + 2, gui_bar_item_count_updates_done);
+
+    /* only slots of item updated are refreshed */
+    bar_window->items_refresh_needed[0][0] = 0;
+    bar_window->items_refresh_needed[1][0] = 0;
+    bar_window->items_refresh_needed[1][1] = 0;
+    gui_bar_item_update ("test_item2");
+    gui_bar_item_update_dirty ();
+    LONGS_EQUAL(0, bar_window->items_refresh_needed[0][0]);
+    LONGS_EQUAL(1, bar_window->items_refresh_needed[1][0]);
+    LONGS_EQUAL(0, bar_window->items_refresh_needed[1][1]);
+}
+
+/*
+ * Tests functions:
+ *   gui_bar_item_update_dirty
+ *   gui_bar_item_index_invalidate
+ */
+
+TEST(BarItem, UpdateItemsChanged)
+{
+    gui_bar_item_update ("test_item1");
+    gui_bar_item_update_dirty ();
+
+    /* new items in bar: index is built again */
+    config_file_option_set (bar->options[GUI_BAR_OPTION_ITEMS],
+                            "test_item3", 1);
+    bar_window = gui_bar_window_search_bar (gui_current_window, bar);
+    CHECK(bar_window);
+    bar_window->items_refresh_needed[0][0] = 0;
+    gui_bar_item_update ("test_item1");
+    gui_bar_item_update_dirty ();
+    LONGS_EQUAL(0, bar_window->items_refresh_needed[0][0]);
+    gui_bar_item_update ("test_item3");
+    gui_bar_item_update_dirty ();
+    LONGS_EQUAL(1, bar_window->items_refresh_needed[0][0]);
+}
+
+/*
+ * Tests functions:
+ *   gui_bar_item_update_dirty
+ *   gui_bar_conditions_depend_on_items
+ */
+
+TEST(BarItem, UpdateConditions)
+{
+    long long evaluated, skipped;
+
+    LONGS_EQUAL(0, gui_bar_conditions_depend_on_items (bar));
+
+    /* empty conditions: not evaluated when an item is updated */
+    evaluated = gui_bar_item_count_conditions_evaluated;
+    skipped = gui_bar_item_count_conditions_skipped;
+    gui_bar_item_update ("test_item1");
+    gui_bar_item_update ("test_item2");
+    gui_bar_item_update_dirty ();
+    LONGS_EQUAL(evaluated, gui_bar_item_count_conditions_evaluated);
+    LONGS_EQUAL(skipped + 1, gui_bar_item_count_conditions_skipped);
+
+    /* keyword: not evaluated when an item is updated */
+    config_file_option_set (bar->options[GUI_BAR_OPTION_CONDITIONS],
+                            "active", 1);
+    LONGS_EQUAL(0, gui_bar_conditions_depend_on_items (bar));
+
+    /* expression: evaluated once per bar when items are updated */
+    config_file_option_set (bar->options[GUI_BAR_OPTION_CONDITIONS],
+                            "${window.number} > 0", 1);
+    LONGS_EQUAL(1, gui_bar_conditions_depend_on_items (bar));
+    evaluated = gui_bar_item_count_conditions_evaluated;
+    skipped = gui_bar_item_count_conditions_skipped;
+    gui_bar_item_update ("test_item1");
+    gui_bar_item_update ("test_item2");
+    gui_bar_item_update_dirty ();
+    LONGS_EQUAL(evaluated + 1, gui_bar_item_count_conditions_evaluated);
+    LONGS_EQUAL(skipped, gui_bar_item_count_conditions_skipped);
+}
@@ -0,0 +1,245 @@
+/*
+ * test-chat.cpp - test chat functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "src/core/wee-hashtable.h"
+#include "src/core/wee-hook.h"
+#include "src/core/wee-util.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/gui/gui-line.h"
+}
+
+#define CHAT_TEST_BUFFER "test_chat"
+#define CHAT_TEST_BENCHMARK_BUFFERS 1500
+#define CHAT_TEST_BENCHMARK_LINES 20000
+
+TEST_GROUP(Chat)
+{
+    struct t_gui_buffer *buffer;
+
+    void setup ()
+    {
+        buffer = gui_buffer_new (NULL, CHAT_TEST_BUFFER,
+                                 NULL, NULL, NULL,
+                                 NULL, NULL, NULL);
+        CHECK(buffer);
+    }
+
+    void teardown ()
+    {
+        gui_buffer_close (buffer);
+    }
+};
+
+/*
+ * Test callback for modifier "weechat_print": saves modifier data and
+ * changes message.
+ */
+
+char *
+test_chat_modifier_cb (const void *pointer, void *data,
+                       const char *modifier, const char *modifier_data,
+                       const char *string)
+{
+    char **ptr_modifier_data, *result;
+    int length;
+
+    /* make C compiler happy */
+    (void) data;
+    (void) modifier;
+
+    ptr_modifier_data = (char **)pointer;
+    if (*ptr_modifier_data)
+        free (*ptr_modifier_data);
+    *ptr_modifier_data = strdup (modifier_data);
+
+    length = strlen (string) + 16;
+    result = (char *)malloc (length);
+    if (result)
+        snprintf (result, length, "%s (modified)", string);
+
+    return result;
+}
+
+/*
+ * Tests functions:
+ *   gui_buffer_valid
+ *   gui_buffer_search_main
+ */
+
+TEST(Chat, BufferValid)
+{
+    struct t_gui_buffer *buffer2, *ptr_main;
+
+    LONGS_EQUAL(1, gui_buffer_valid (NULL));
+    LONGS_EQUAL(1, gui_buffer_valid (gui_buffers));
+    LONGS_EQUAL(1, gui_buffer_valid (buffer));
+    LONGS_EQUAL(0, gui_buffer_valid ((struct t_gui_buffer *)0x1));
+
+    buffer2 = gui_buffer_new (NULL, CHAT_TEST_BUFFER "2",
+                              NULL, NULL, NULL,
+                              NULL, NULL, NULL);
+    CHECK(buffer2);
+    LONGS_EQUAL(1, gui_buffer_valid (buffer2));
+    gui_buffer_close (buffer2);
+    LONGS_EQUAL(0, gui_buffer_valid (buffer2));
+
+    /* main buffer is kept after first search */
+    ptr_main = gui_buffer_search_main ();
+    CHECK(ptr_main);
+    STRCMP_EQUAL(GUI_BUFFER_MAIN, ptr_main->name);
+    POINTERS_EQUAL(NULL, ptr_main->plugin);
+    POINTERS_EQUAL(ptr_main, gui_buffer_main);
+    POINTERS_EQUAL(ptr_main, gui_buffer_search_main ());
+}
+
+/*
+ * Tests functions:
+ *   gui_chat_printf_date_tags
+ */
+
+TEST(Chat, Printf)
+{
+    struct t_hook *ptr_hook, *ptr_hook2, *ptr_hook3;
+    char *modifier_data;
+    int lines_count, print_count;
+
+    /* invalid buffer: nothing printed */
+    lines_count = buffer->own_lines->lines_count;
+    gui_chat_printf ((struct t_gui_buffer *)0x1, "test");
+    LONGS_EQUAL(lines_count, buffer->own_lines->lines_count);
+
+    /* print without modifier */
+    gui_chat_printf_date_tags (buffer, 0, "tag1,tag2", "prefix\tmessage");
+    LONGS_EQUAL(lines_count + 1, buffer->own_lines->lines_count);
+    STRCMP_EQUAL("prefix", buffer->own_lines->last_line->data->prefix);
+    STRCMP_EQUAL("message", buffer->own_lines->last_line->data->message);
+
+    /* print with modifier "weechat_print" (many lines) */
+    print_count = hook_modifier_print_count;
+    modifier_data = NULL;
+    ptr_hook = hook_modifier (NULL, "weechat_print",
+                              &test_chat_modifier_cb, &modifier_data, NULL);
+    CHECK(ptr_hook);
+    LONGS_EQUAL(print_count + 1, hook_modifier_print_count);
+    gui_chat_printf_date_tags (buffer, 0, "tag1,tag2", "line1\nline2");
+    LONGS_EQUAL(lines_count + 3, buffer->own_lines->lines_count);
+    STRCMP_EQUAL("core;" CHAT_TEST_BUFFER ";tag1,tag2", modifier_data);
+    STRCMP_EQUAL("line1 (modified)",
+                 buffer->own_lines->last_line->prev_line->data->message);
+    STRCMP_EQUAL("line2 (modified)",
+                 buffer->own_lines->last_line->data->message);
+
+    /* count of "weechat_print" modifiers (with priority, other modifier) */
+    ptr_hook2 = hook_modifier (NULL, "500|WeeChat_Print",
+                               &test_chat_modifier_cb, &modifier_data, NULL);
+    CHECK(ptr_hook2);
+    ptr_hook3 = hook_modifier (NULL, "weechat_print_other",
+                               &test_chat_modifier_cb, &modifier_data, NULL);
+    CHECK(ptr_hook3);
+    LONGS_EQUAL(print_count + 2, hook_modifier_print_count);
+    unhook (ptr_hook3);
+    unhook (ptr_hook2);
+    unhook (ptr_hook);
+    LONGS_EQUAL(print_count, hook_modifier_print_count);
+    unhook (ptr_hook);
+    LONGS_EQUAL(print_count, hook_modifier_print_count);
+    free (modifier_data);
+
+    /* print without modifier after unhook */
+    gui_chat_printf_date_tags (buffer, 0, NULL, "message2");
+    LONGS_EQUAL(lines_count + 4, buffer->own_lines->lines_count);
+    STRCMP_EQUAL("message2", buffer->own_lines->last_line->data->message);
+}
+
+/*
+ * Tests functions:
+ *   gui_chat_printf_date_tags (benchmark)
+ *
+ * Prints lines in a buffer with many buffers opened, with the registry of
+ * buffers and with the walk of list of buffers to check the buffer pointer.
+ */
+
+TEST(Chat, PrintfBenchmark)
+{
+    struct t_gui_buffer *buffers[CHAT_TEST_BENCHMARK_BUFFERS];
+    struct t_hashtable *ptr_pointers;
+    struct timeval time1, time2;
+    char name[128];
+    long long time_registry, time_list;
+    int i;
+
+    for (i = 0; i < CHAT_TEST_BENCHMARK_BUFFERS; i++)
+    {
+        snprintf (name, sizeof (name), "test_chat_%d", i);
+        buffers[i] = gui_buffer_new (NULL, name,
+                                     NULL, NULL, NULL,
+                                     NULL, NULL, NULL);
+        CHECK(buffers[i]);
+    }
+
+    /* check pointer of buffer with the registry of buffers */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < CHAT_TEST_BENCHMARK_LINES; i++)
+    {
+        gui_chat_printf (buffers[CHAT_TEST_BENCHMARK_BUFFERS - 1],
+                         "nick\tthis is message number %d", i);
+    }
+    gettimeofday (&time2, NULL);
+    time_registry = util_timeval_diff (&time1, &time2);
+
+    /* check pointer of buffer with the walk of list of buffers */
+    ptr_pointers = gui_buffers_pointers;
+    gui_buffers_pointers = NULL;
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < CHAT_TEST_BENCHMARK_LINES; i++)
+    {
+        gui_chat_printf (buffers[CHAT_TEST_BENCHMARK_BUFFERS - 1],
+                         "nick\tthis is message number %d", i);
+    }
+    gettimeofday (&time2, NULL);
+    time_list = util_timeval_diff (&time1, &time2);
+    gui_buffers_pointers = ptr_pointers;
+
+    snprintf (name, sizeof (name), "this is message number %d",
+              CHAT_TEST_BENCHMARK_LINES - 1);
+    STRCMP_EQUAL(name,
+                 buffers[CHAT_TEST_BENCHMARK_BUFFERS - 1]->own_lines->last_line->data->message);
+
+    for (i = 0; i < CHAT_TEST_BENCHMARK_BUFFERS; i++)
+    {
+        gui_buffer_close (buffers[i]);
+    }
+
+    printf ("\n");
+    printf ("printf benchmark (%d lines, %d buffers):\n",
+            CHAT_TEST_BENCHMARK_LINES, CHAT_TEST_BENCHMARK_BUFFERS);
+    printf ("  registry of buffers . : %lld ms\n", time_registry / 1000);
+    printf ("  list of buffers . . . : %lld ms\n", time_list / 1000);
+}
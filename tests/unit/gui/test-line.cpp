@@ -0,0 +1,529 @@
+/*
+ * test-line.cpp - test line functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "src/core/wee-config.h"
+#include "src/core/wee-config-file.h"
+#include "src/core/wee-util.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/gui/gui-color.h"
+#include "src/gui/gui-input.h"
+#include "src/gui/gui-line.h"
+#include "src/gui/gui-window.h"
+}
+
+#define LINE_TEST_BUFFER "test_line"
+#define LINE_TEST_BENCHMARK_LINES 20000
+#define LINE_TEST_BENCHMARK_PASSES 5
+#define LINE_TEST_BENCHMARK_SEARCH_LINES 200000
+
+TEST_GROUP(Line)
+{
+    struct t_gui_buffer *buffer, *old_buffer;
+    int old_width, old_height;
+
+    void setup ()
+    {
+        buffer = gui_buffer_new (NULL, LINE_TEST_BUFFER,
+                                 NULL, NULL, NULL,
+                                 NULL, NULL, NULL);
+        CHECK(buffer);
+        old_buffer = gui_current_window->buffer;
+        gui_window_switch_to_buffer (gui_current_window, buffer, 0);
+
+        /* chat area is empty in headless mode: give it a size */
+        old_width = gui_current_window->win_chat_width;
+        old_height = gui_current_window->win_chat_height;
+        gui_current_window->win_chat_width = 80;
+        gui_current_window->win_chat_height = 24;
+    }
+
+    void teardown ()
+    {
+        gui_current_window->win_chat_width = old_width;
+        gui_current_window->win_chat_height = old_height;
+        gui_window_switch_to_buffer (gui_current_window, old_buffer, 0);
+        gui_buffer_close (buffer);
+    }
+};
+
+/*
+ * Tests functions:
+ *   gui_line_rows_get
+ *   gui_line_rows_set
+ *   gui_line_rows_free
+ *   gui_line_layout_changed
+ */
+
+TEST(Line, RowsCache)
+{
+    struct t_gui_line *line;
+
+    gui_chat_printf (buffer, "nick\tthis is a test");
+    line = buffer->own_lines->last_line;
+    CHECK(line);
+    POINTERS_EQUAL(NULL, line->data->rows);
+
+    /* nothing in cache */
+    LONGS_EQUAL(-1, gui_line_rows_get (NULL, buffer, 80, 1));
+    LONGS_EQUAL(-1, gui_line_rows_get (line, NULL, 80, 1));
+    LONGS_EQUAL(-1, gui_line_rows_get (line, buffer, 80, 1));
+
+    /* set rows in cache */
+    gui_line_rows_set (line, buffer, 80, 1, 3);
+    CHECK(line->data->rows);
+    LONGS_EQUAL(3, gui_line_rows_get (line, buffer, 80, 1));
+
+    /* other width, first row flag or buffer: not in cache */
+    LONGS_EQUAL(-1, gui_line_rows_get (line, buffer, 79, 1));
+    LONGS_EQUAL(-1, gui_line_rows_get (line, buffer, 80, 0));
+    LONGS_EQUAL(-1, gui_line_rows_get (line, gui_buffers, 80, 1));
+
+    /* prefix max length changed: not in cache */
+    buffer->lines->prefix_max_length++;
+    LONGS_EQUAL(-1, gui_line_rows_get (line, buffer, 80, 1));
+    buffer->lines->prefix_max_length--;
+    LONGS_EQUAL(3, gui_line_rows_get (line, buffer, 80, 1));
+
+    /* layout changed: not in cache */
+    gui_line_layout_changed ();
+    LONGS_EQUAL(-1, gui_line_rows_get (line, buffer, 80, 1));
+    gui_line_rows_set (line, buffer, 80, 1, 2);
+    LONGS_EQUAL(2, gui_line_rows_get (line, buffer, 80, 1));
+
+    /* layout changed by a buffer property */
+    gui_buffer_set (buffer, "time_for_each_line", "0");
+    LONGS_EQUAL(-1, gui_line_rows_get (line, buffer, 80, 1));
+
+    /* free rows */
+    gui_line_rows_free (line->data);
+    POINTERS_EQUAL(NULL, line->data->rows);
+    LONGS_EQUAL(-1, gui_line_rows_get (line, buffer, 80, 1));
+    gui_line_rows_free (line->data);
+    gui_line_rows_free (NULL);
+}
+
+/*
+ * Tests functions:
+ *   gui_window_page_up (rows computed then read from cache)
+ *   gui_window_page_down (rows computed then read from cache)
+ */
+
+TEST(Line, RowsCacheScroll)
+{
+    struct t_gui_line *ptr_line;
+    int i, num_cached;
+
+    for (i = 0; i < 100; i++)
+    {
+        gui_chat_printf (buffer,
+                         "nick%d\tthis is a long message that should be "
+                         "displayed on more than one row in the chat area "
+                         "of the window, number %d",
+                         i % 3, i);
+    }
+
+    /* scroll to top of buffer: rows of all lines are in cache */
+    for (i = 0; i < 100; i++)
+    {
+        gui_window_page_up (gui_current_window);
+    }
+    num_cached = 0;
+    for (ptr_line = buffer->own_lines->first_line; ptr_line;
+         ptr_line = ptr_line->next_line)
+    {
+        if (ptr_line->data->rows && (ptr_line->data->rows->count > 1))
+            num_cached++;
+    }
+    CHECK(num_cached > 90);
+
+    /* scroll back to bottom: same lines displayed */
+    for (i = 0; i < 100; i++)
+    {
+        gui_window_page_down (gui_current_window);
+    }
+    POINTERS_EQUAL(NULL, gui_current_window->scroll->start_line);
+}
+
+/*
+ * Scrolls window from bottom to top of buffer, page by page.
+ *
+ * If no_cache == 1, the rows cached in lines are invalidated before each page.
+ *
+ * Returns number of pages scrolled.
+ */
+
+int
+test_line_scroll_to_top (struct t_gui_buffer *buffer, int no_cache)
+{
+    int num_pages;
+
+    gui_current_window->scroll->start_line = NULL;
+    gui_current_window->scroll->start_line_pos = 0;
+
+    num_pages = 0;
+    while ((gui_current_window->scroll->start_line != buffer->own_lines->first_line)
+           && (num_pages <= LINE_TEST_BENCHMARK_LINES))
+    {
+        if (no_cache)
+            gui_line_layout_changed ();
+        gui_window_page_up (gui_current_window);
+        num_pages++;
+    }
+
+    return num_pages;
+}
+
+/*
+ * Tests functions:
+ *   gui_window_page_up (benchmark, with and without rows in cache)
+ */
+
+TEST(Line, RowsCacheBenchmark)
+{
+    struct timeval time1, time2;
+    long long time_no_cache, time_cache;
+    int i, pass, num_pages;
+
+    num_pages = 0;
+
+    for (i = 0; i < LINE_TEST_BENCHMARK_LINES; i++)
+    {
+        gui_chat_printf (buffer,
+                         "nick%d\tthis is a long message with some unicode "
+                         "chars: é à ç ☺, it should be "
+                         "displayed on more than one row in the chat area "
+                         "of the window, number %d",
+                         i % 7, i);
+    }
+
+    /* scroll from bottom to top, without cache: layout changed on each page */
+    gettimeofday (&time1, NULL);
+    for (pass = 0; pass < LINE_TEST_BENCHMARK_PASSES; pass++)
+    {
+        num_pages = test_line_scroll_to_top (buffer, 1);
+    }
+    gettimeofday (&time2, NULL);
+    time_no_cache = util_timeval_diff (&time1, &time2);
+
+    /* scroll from bottom to top, rows computed on first scroll only */
+    gui_line_layout_changed ();
+    gettimeofday (&time1, NULL);
+    for (pass = 0; pass < LINE_TEST_BENCHMARK_PASSES; pass++)
+    {
+        num_pages = test_line_scroll_to_top (buffer, 0);
+    }
+    gettimeofday (&time2, NULL);
+    time_cache = util_timeval_diff (&time1, &time2);
+
+    gui_current_window->scroll->start_line = NULL;
+    gui_current_window->scroll->start_line_pos = 0;
+
+    printf ("\n");
+    printf ("line rows benchmark (%d lines, scroll to top %d times, "
+            "%d pages):\n",
+            LINE_TEST_BENCHMARK_LINES, LINE_TEST_BENCHMARK_PASSES,
+            num_pages);
+    printf ("  without cache: %lld ms\n", time_no_cache / 1000);
+    printf ("  with cache . : %lld ms\n", time_cache / 1000);
+}
+
+/*
+ * Tests functions:
+ *   gui_line_search_index_add
+ *   gui_line_search_index_build
+ *   gui_line_search_index_match
+ */
+
+TEST(Line, SearchIndex)
+{
+    struct t_gui_line *line;
+    unsigned long long search_index[GUI_LINE_SEARCH_INDEX_SIZE];
+    char message[256];
+    int i, count;
+
+    /* index of empty string or string with less than 3 chars */
+    memset (search_index, 0, sizeof (search_index));
+    gui_line_search_index_add (search_index, NULL);
+    gui_line_search_index_add (search_index, "");
+    gui_line_search_index_add (search_index, "ab");
+    for (i = 0; i < GUI_LINE_SEARCH_INDEX_SIZE; i++)
+    {
+        CHECK(search_index[i] == 0);
+    }
+
+    /* index of a string: one bit per trigram (at most) */
+    gui_line_search_index_add (search_index, "abc");
+    count = 0;
+    for (i = 0; i < GUI_LINE_SEARCH_INDEX_BITS; i++)
+    {
+        if (search_index[i / 64] & (1ULL << (i % 64)))
+            count++;
+    }
+    LONGS_EQUAL(1, count);
+
+    /* line with colors: index is built on text without colors */
+    snprintf (message, sizeof (message), "Hel%slo %sWorld",
+              gui_color_get_custom ("red"), gui_color_get_custom ("bold"));
+    gui_chat_printf (buffer, "%sNick\t%s",
+                     gui_color_get_custom ("green"), message);
+    line = buffer->own_lines->last_line;
+    LONGS_EQUAL(1, line->data->search_indexed);
+
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, NULL));
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, ""));
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, "xy"));
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, "hello"));
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, "HELLO"));
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, "lo wor"));
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, "nick"));
+    LONGS_EQUAL(0, gui_line_search_index_match (line->data, "goodbye"));
+    LONGS_EQUAL(0, gui_line_search_index_match (line->data, "hello world!"));
+
+    /* line not indexed: it always matches */
+    line->data->search_indexed = 0;
+    LONGS_EQUAL(1, gui_line_search_index_match (line->data, "goodbye"));
+    LONGS_EQUAL(1, gui_line_search_index_match (NULL, "goodbye"));
+
+    /* index is built again if message is updated */
+    gui_line_search_index_build (line->data);
+    LONGS_EQUAL(1, line->data->search_indexed);
+    LONGS_EQUAL(0, gui_line_search_index_match (line->data, "goodbye"));
+
+    /* option is off: line is not indexed */
+    config_file_option_set (config_look_buffer_search_index, "off", 1);
+    gui_chat_printf (buffer, "nick\tgoodbye");
+    line = buffer->own_lines->last_line;
+    LONGS_EQUAL(0, line->data->search_indexed);
+    config_file_option_reset (config_look_buffer_search_index, 1);
+}
+
+/*
+ * Tests functions:
+ *   gui_line_search_text
+ */
+
+TEST(Line, SearchText)
+{
+    struct t_gui_line *line;
+
+    gui_chat_printf (buffer, "%snick\tthis is a %stest%s message",
+                     gui_color_get_custom ("green"),
+                     gui_color_get_custom ("red"),
+                     gui_color_get_custom ("reset"));
+    line = buffer->own_lines->last_line;
+
+    gui_window_search_start (gui_current_window, NULL);
+    buffer->text_search_exact = 0;
+    buffer->text_search_regex = 0;
+    buffer->text_search_where = GUI_TEXT_SEARCH_IN_PREFIX | GUI_TEXT_SEARCH_IN_MESSAGE;
+
+    /* empty input */
+    LONGS_EQUAL(0, gui_line_search_text (buffer, line));
+
+    /* search without case */
+    gui_input_insert_string (buffer, "TEST MESSAGE", -1);
+    LONGS_EQUAL(1, gui_line_search_text (buffer, line));
+    gui_input_delete_line (buffer);
+    gui_input_insert_string (buffer, "nick", -1);
+    LONGS_EQUAL(1, gui_line_search_text (buffer, line));
+    gui_input_delete_line (buffer);
+    gui_input_insert_string (buffer, "other message", -1);
+    LONGS_EQUAL(0, gui_line_search_text (buffer, line));
+
+    /* search with case */
+    buffer->text_search_exact = 1;
+    gui_input_delete_line (buffer);
+    gui_input_insert_string (buffer, "TEST MESSAGE", -1);
+    LONGS_EQUAL(0, gui_line_search_text (buffer, line));
+    gui_input_delete_line (buffer);
+    gui_input_insert_string (buffer, "test message", -1);
+    LONGS_EQUAL(1, gui_line_search_text (buffer, line));
+
+    /* search in prefix or message only */
+    buffer->text_search_where = GUI_TEXT_SEARCH_IN_PREFIX;
+    LONGS_EQUAL(0, gui_line_search_text (buffer, line));
+    buffer->text_search_where = GUI_TEXT_SEARCH_IN_MESSAGE;
+    LONGS_EQUAL(1, gui_line_search_text (buffer, line));
+
+    /* search with a regex (index is not used) */
+    buffer->text_search_regex = 1;
+    gui_input_delete_line (buffer);
+    gui_input_insert_string (buffer, "is a t.st", -1);
+    gui_input_search_compile_regex (buffer);
+    LONGS_EQUAL(1, gui_line_search_text (buffer, line));
+    gui_input_delete_line (buffer);
+    gui_input_insert_string (buffer, "is a z.st", -1);
+    gui_input_search_compile_regex (buffer);
+    LONGS_EQUAL(0, gui_line_search_text (buffer, line));
+
+    gui_window_search_stop (gui_current_window);
+}
+
+/*
+ * Tests functions:
+ *   gui_window_search_text
+ *   gui_window_search_text_lines
+ *   gui_window_search_timer_cb
+ */
+
+TEST(Line, SearchWindow)
+{
+    struct t_gui_line *line_found;
+    int i;
+
+    for (i = 0; i < 100; i++)
+    {
+        gui_chat_printf (buffer, "nick\tthis is message number %d", i);
+    }
+    line_found = buffer->own_lines->first_line->next_line;
+
+    gui_window_search_start (gui_current_window, NULL);
+    buffer->text_search_exact = 0;
+    buffer->text_search_regex = 0;
+    buffer->text_search_where = GUI_TEXT_SEARCH_IN_MESSAGE;
+
+    /* search backward from bottom of buffer */
+    gui_input_insert_string (buffer, "number 1", -1);
+    gui_window_search_restart (gui_current_window);
+    LONGS_EQUAL(1, buffer->text_search_found);
+    STRCMP_EQUAL("this is message number 19",
+                 gui_current_window->scroll->start_line->data->message);
+    LONGS_EQUAL(1, gui_window_search_text (gui_current_window));
+    STRCMP_EQUAL("this is message number 18",
+                 gui_current_window->scroll->start_line->data->message);
+    POINTERS_EQUAL(NULL, gui_current_window->scroll->text_search_next_line);
+
+    /* search continued in timer, from a given line */
+    gui_input_delete_line (buffer);
+    gui_input_insert_string (buffer, "number 1", -1);
+    buffer->text_search_found = 0;
+    gui_current_window->scroll->start_line = NULL;
+    gui_current_window->scroll->text_search_next_line = line_found->next_line;
+    gui_window_search_timer_cb (NULL, NULL, 0);
+    LONGS_EQUAL(1, buffer->text_search_found);
+    POINTERS_EQUAL(line_found, gui_current_window->scroll->start_line);
+    POINTERS_EQUAL(NULL, gui_current_window->scroll->text_search_next_line);
+
+    /* next line to search is removed: search continues on previous line */
+    gui_current_window->scroll->start_line = NULL;
+    gui_current_window->scroll->text_search_next_line = line_found->next_line;
+    gui_line_free (buffer, line_found->next_line);
+    POINTERS_EQUAL(line_found,
+                   gui_current_window->scroll->text_search_next_line);
+
+    /* search stopped: nothing is done in timer */
+    gui_window_search_stop (gui_current_window);
+    POINTERS_EQUAL(NULL, gui_current_window->scroll->text_search_next_line);
+    gui_window_search_timer_cb (NULL, NULL, 0);
+    POINTERS_EQUAL(NULL, gui_current_window->scroll->start_line);
+}
+
+/*
+ * Searches for a string in all lines of a buffer.
+ *
+ * Returns number of lines found.
+ */
+
+int
+test_line_search_all (struct t_gui_buffer *buffer)
+{
+    struct t_gui_line *ptr_line;
+    int count;
+
+    count = 0;
+    for (ptr_line = buffer->own_lines->first_line; ptr_line;
+         ptr_line = ptr_line->next_line)
+    {
+        if (gui_line_search_text (buffer, ptr_line))
+            count++;
+    }
+
+    return count;
+}
+
+/*
+ * Tests functions:
+ *   gui_line_search_text (benchmark, with and without search index)
+ */
+
+TEST(Line, SearchIndexBenchmark)
+{
+    struct t_gui_line *ptr_line;
+    struct timeval time1, time2;
+    long long time_no_index, time_index;
+    int i, count_no_index, count_index;
+
+    config_file_option_set (config_history_max_buffer_lines_number, "0", 1);
+
+    for (i = 0; i < LINE_TEST_BENCHMARK_SEARCH_LINES; i++)
+    {
+        gui_chat_printf (buffer,
+                         "%snick%d\tthis is a message with %scolors%s, "
+                         "number %d",
+                         gui_color_get_custom ("green"), i % 7,
+                         gui_color_get_custom ("red"),
+                         gui_color_get_custom ("reset"), i);
+    }
+
+    gui_window_search_start (gui_current_window, NULL);
+    buffer->text_search_exact = 0;
+    buffer->text_search_regex = 0;
+    buffer->text_search_where = GUI_TEXT_SEARCH_IN_PREFIX | GUI_TEXT_SEARCH_IN_MESSAGE;
+    gui_input_insert_string (buffer, "number 123456", -1);
+
+    /* search with index */
+    gettimeofday (&time1, NULL);
+    count_index = test_line_search_all (buffer);
+    gettimeofday (&time2, NULL);
+    time_index = util_timeval_diff (&time1, &time2);
+
+    /* search without index */
+    for (ptr_line = buffer->own_lines->first_line; ptr_line;
+         ptr_line = ptr_line->next_line)
+    {
+        ptr_line->data->search_indexed = 0;
+    }
+    gettimeofday (&time1, NULL);
+    count_no_index = test_line_search_all (buffer);
+    gettimeofday (&time2, NULL);
+    time_no_index = util_timeval_diff (&time1, &time2);
+
+    LONGS_EQUAL(1, count_index);
+    LONGS_EQUAL(1, count_no_index);
+
+    gui_window_search_stop (gui_current_window);
+    config_file_option_reset (config_history_max_buffer_lines_number, 1);
+
+    printf ("\n");
+    printf ("line search benchmark (%d lines):\n",
+            LINE_TEST_BENCHMARK_SEARCH_LINES);
+    printf ("  without index: %lld ms\n", time_no_index / 1000);
+    printf ("  with index . : %lld ms\n", time_index / 1000);
+}
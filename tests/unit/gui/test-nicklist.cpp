@@ -0,0 +1,461 @@
+/*
+ * test-nicklist.cpp - test nicklist functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "src/core/wee-arraylist.h"
+#include "src/core/wee-hashtable.h"
+#include "src/core/wee-string.h"
+#include "src/core/wee-util.h"
+#include "src/gui/gui-bar-item.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-nicklist.h"
+#include "src/plugins/weechat-plugin.h"
+}
+
+#define NICKLIST_TEST_BUFFER "test_nicklist"
+#define NICKLIST_TEST_BENCHMARK_NICKS 10000
+#define NICKLIST_TEST_BENCHMARK_BAR_ITEM_NICKS 15000
+#define NICKLIST_TEST_BENCHMARK_BAR_ITEM_BUILDS 100
+
+TEST_GROUP(Nicklist)
+{
+    struct t_gui_buffer *buffer;
+
+    void setup ()
+    {
+        buffer = gui_buffer_new (NULL, NICKLIST_TEST_BUFFER,
+                                 NULL, NULL, NULL,
+                                 NULL, NULL, NULL);
+        CHECK(buffer);
+    }
+
+    void teardown ()
+    {
+        gui_buffer_close (buffer);
+    }
+};
+
+/*
+ * Test callback comparing two nicks (case insensitive).
+ */
+
+int
+test_nicklist_nickcmp_cb (const void *pointer, void *data,
+                          struct t_gui_buffer *buffer,
+                          const char *nick1, const char *nick2)
+{
+    /* make C++ compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) buffer;
+
+    return string_strcasecmp (nick1, nick2);
+}
+
+/*
+ * Checks that nicks of a group are sorted (in list and in arraylist of
+ * sorted nicks).
+ */
+
+void
+test_nicklist_check_sorted (struct t_gui_nick_group *group, int count)
+{
+    struct t_gui_nick *ptr_nick;
+    int i;
+
+    i = 0;
+    for (ptr_nick = group->nicks; ptr_nick; ptr_nick = ptr_nick->next_nick)
+    {
+        if (ptr_nick->next_nick)
+        {
+            CHECK(string_strcasecmp (ptr_nick->name,
+                                     ptr_nick->next_nick->name) <= 0);
+            POINTERS_EQUAL(ptr_nick, ptr_nick->next_nick->prev_nick);
+        }
+        else
+        {
+            POINTERS_EQUAL(ptr_nick, group->last_nick);
+        }
+        POINTERS_EQUAL(ptr_nick, arraylist_get (group->nicks_sorted, i));
+        i++;
+    }
+    LONGS_EQUAL(count, i);
+    LONGS_EQUAL(count, arraylist_size (group->nicks_sorted));
+}
+
+/*
+ * Builds bar item "buffer_nicklist" for the buffer: all lines if first_line is
+ * negative, otherwise only lines displayed (the hashtable extra_info is then
+ * filled by the item with total number of lines and max length).
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+test_nicklist_build_bar_item (struct t_gui_buffer *buffer,
+                              int first_line, int num_lines,
+                              struct t_hashtable *extra_info)
+{
+    struct t_gui_bar_item *item;
+    char str_value[32];
+
+    item = gui_bar_item_search (
+        gui_bar_item_names[GUI_BAR_ITEM_BUFFER_NICKLIST]);
+    CHECK(item);
+
+    if (first_line >= 0)
+    {
+        snprintf (str_value, sizeof (str_value), "%d", first_line);
+        hashtable_set (extra_info, "_window_first_line", str_value);
+        snprintf (str_value, sizeof (str_value), "%d", num_lines);
+        hashtable_set (extra_info, "_window_lines", str_value);
+        hashtable_set (extra_info, "_window_max_length", "1");
+    }
+
+    return (item->build_callback) (item->build_callback_pointer,
+                                   item->build_callback_data,
+                                   item, NULL, buffer,
+                                   (first_line >= 0) ? extra_info : NULL);
+}
+
+/*
+ * Tests functions:
+ *   gui_nicklist_add_nick
+ *   gui_nicklist_search_nick
+ *   gui_nicklist_remove_nick
+ */
+
+TEST(Nicklist, AddSearchRemove)
+{
+    struct t_gui_nick_group *group;
+    struct t_gui_nick *nick1, *nick2, *nick3;
+
+    group = gui_nicklist_add_group (buffer, NULL, "group", NULL, 1);
+    CHECK(group);
+
+    nick1 = gui_nicklist_add_nick (buffer, NULL, "bob", NULL, NULL, NULL, 1);
+    CHECK(nick1);
+    nick2 = gui_nicklist_add_nick (buffer, group, "Alice", NULL, NULL, NULL, 1);
+    CHECK(nick2);
+    nick3 = gui_nicklist_add_nick (buffer, NULL, "alice", NULL, NULL, NULL, 1);
+    CHECK(nick3);
+    LONGS_EQUAL(3, buffer->nicklist_nicks_count);
+
+    /* nick already in nicklist */
+    POINTERS_EQUAL(NULL, gui_nicklist_add_nick (buffer, NULL, "bob",
+                                                NULL, NULL, NULL, 1));
+
+    /* search without nickcmp callback (case sensitive) */
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, NULL, NULL));
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, NULL, "carol"));
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, NULL, "BOB"));
+    POINTERS_EQUAL(nick1, gui_nicklist_search_nick (buffer, NULL, "bob"));
+    POINTERS_EQUAL(nick2, gui_nicklist_search_nick (buffer, NULL, "Alice"));
+    POINTERS_EQUAL(nick3, gui_nicklist_search_nick (buffer, NULL, "alice"));
+    POINTERS_EQUAL(nick2, gui_nicklist_search_nick (buffer, group, "Alice"));
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, group, "alice"));
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, group, "bob"));
+    POINTERS_EQUAL(nick2, gui_nicklist_search_nick (NULL, group, "Alice"));
+
+    /* search with nickcmp callback (case insensitive) */
+    buffer->nickcmp_callback = &test_nicklist_nickcmp_cb;
+    POINTERS_EQUAL(nick1, gui_nicklist_search_nick (buffer, NULL, "BOB"));
+    POINTERS_EQUAL(nick2, gui_nicklist_search_nick (buffer, group, "ALICE"));
+    buffer->nickcmp_callback = NULL;
+
+    gui_nicklist_remove_nick (buffer, nick2);
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, NULL, "Alice"));
+    POINTERS_EQUAL(nick3, gui_nicklist_search_nick (buffer, NULL, "alice"));
+    gui_nicklist_remove_nick (buffer, nick3);
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, NULL, "alice"));
+    LONGS_EQUAL(1, buffer->nicklist_nicks_count);
+    LONGS_EQUAL(1, buffer->nicklist_nicks->items_count);
+
+    gui_nicklist_remove_all (buffer);
+    POINTERS_EQUAL(NULL, gui_nicklist_search_nick (buffer, NULL, "bob"));
+    LONGS_EQUAL(0, buffer->nicklist_nicks->items_count);
+}
+
+/*
+ * Tests functions:
+ *   gui_nicklist_add_nick (sort of nicks, with and without bulk mode)
+ *   gui_nicklist_sort
+ */
+
+TEST(Nicklist, Sort)
+{
+    const char *nicks[] = { "delta", "Bravo", "alpha", "echo", "Charlie",
+                            "bravo", "foxtrot", NULL };
+    struct t_gui_nick_group *root;
+    struct t_gui_nick *ptr_nick;
+    int i;
+
+    root = buffer->nicklist_root;
+
+    for (i = 0; nicks[i]; i++)
+    {
+        CHECK(gui_nicklist_add_nick (buffer, NULL, nicks[i],
+                                     NULL, NULL, NULL, 1));
+        test_nicklist_check_sorted (root, i + 1);
+    }
+    STRCMP_EQUAL("alpha", root->nicks->name);
+    STRCMP_EQUAL("foxtrot", root->last_nick->name);
+
+    ptr_nick = gui_nicklist_search_nick (buffer, NULL, "Charlie");
+    gui_nicklist_remove_nick (buffer, ptr_nick);
+    test_nicklist_check_sorted (root, 6);
+
+    gui_nicklist_remove_all (buffer);
+
+    /* bulk mode: nicks are added at the end, then sorted */
+    gui_buffer_set (buffer, "nicklist_bulk_add", "1");
+    LONGS_EQUAL(1, gui_buffer_get_integer (buffer, "nicklist_bulk_add"));
+    for (i = 0; nicks[i]; i++)
+    {
+        CHECK(gui_nicklist_add_nick (buffer, NULL, nicks[i],
+                                     NULL, NULL, NULL, 1));
+        STRCMP_EQUAL(nicks[i], root->last_nick->name);
+    }
+    STRCMP_EQUAL("delta", root->nicks->name);
+    POINTERS_EQUAL(gui_nicklist_search_nick (buffer, NULL, "echo"),
+                   root->nicks->next_nick->next_nick->next_nick);
+
+    /* remove a nick in bulk mode */
+    ptr_nick = gui_nicklist_search_nick (buffer, NULL, "Charlie");
+    gui_nicklist_remove_nick (buffer, ptr_nick);
+
+    gui_buffer_set (buffer, "nicklist_bulk_add", "0");
+    LONGS_EQUAL(0, gui_buffer_get_integer (buffer, "nicklist_bulk_add"));
+    test_nicklist_check_sorted (root, 6);
+    STRCMP_EQUAL("alpha", root->nicks->name);
+    STRCMP_EQUAL("Bravo", root->nicks->next_nick->name);
+    STRCMP_EQUAL("bravo", root->nicks->next_nick->next_nick->name);
+    STRCMP_EQUAL("foxtrot", root->last_nick->name);
+
+    /* add a nick after bulk mode */
+    CHECK(gui_nicklist_add_nick (buffer, NULL, "Charlie",
+                                 NULL, NULL, NULL, 1));
+    test_nicklist_check_sorted (root, 7);
+}
+
+/*
+ * Tests functions:
+ *   gui_nicklist_add_nick (benchmark, with and without bulk mode)
+ *   gui_nicklist_search_nick (benchmark)
+ *   gui_nicklist_remove_nick (benchmark)
+ */
+
+TEST(Nicklist, Benchmark)
+{
+    struct t_gui_nick *ptr_nick;
+    struct timeval time1, time2;
+    char name[64];
+    long long time_add, time_add_bulk, time_search, time_remove;
+    int i;
+
+    /* add nicks (sorted on each add), in reverse order */
+    gettimeofday (&time1, NULL);
+    for (i = NICKLIST_TEST_BENCHMARK_NICKS - 1; i >= 0; i--)
+    {
+        snprintf (name, sizeof (name), "nick%05d", (i * 7919) % 10000);
+        CHECK(gui_nicklist_add_nick (buffer, NULL, name,
+                                     NULL, NULL, NULL, 1));
+    }
+    gettimeofday (&time2, NULL);
+    time_add = util_timeval_diff (&time1, &time2);
+    test_nicklist_check_sorted (buffer->nicklist_root,
+                                NICKLIST_TEST_BENCHMARK_NICKS);
+
+    /* search nicks */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < NICKLIST_TEST_BENCHMARK_NICKS; i++)
+    {
+        snprintf (name, sizeof (name), "nick%05d", i);
+        CHECK(gui_nicklist_search_nick (buffer, NULL, name));
+    }
+    gettimeofday (&time2, NULL);
+    time_search = util_timeval_diff (&time1, &time2);
+
+    /* remove nicks */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < NICKLIST_TEST_BENCHMARK_NICKS; i++)
+    {
+        snprintf (name, sizeof (name), "nick%05d", i);
+        ptr_nick = gui_nicklist_search_nick (buffer, NULL, name);
+        gui_nicklist_remove_nick (buffer, ptr_nick);
+    }
+    gettimeofday (&time2, NULL);
+    time_remove = util_timeval_diff (&time1, &time2);
+    LONGS_EQUAL(0, buffer->nicklist_nicks_count);
+
+    /* add nicks in bulk mode, then sort them */
+    gettimeofday (&time1, NULL);
+    gui_buffer_set (buffer, "nicklist_bulk_add", "1");
+    for (i = NICKLIST_TEST_BENCHMARK_NICKS - 1; i >= 0; i--)
+    {
+        snprintf (name, sizeof (name), "nick%05d", (i * 7919) % 10000);
+        CHECK(gui_nicklist_add_nick (buffer, NULL, name,
+                                     NULL, NULL, NULL, 1));
+    }
+    gui_buffer_set (buffer, "nicklist_bulk_add", "0");
+    gettimeofday (&time2, NULL);
+    time_add_bulk = util_timeval_diff (&time1, &time2);
+    test_nicklist_check_sorted (buffer->nicklist_root,
+                                NICKLIST_TEST_BENCHMARK_NICKS);
+
+    printf ("\n");
+    printf ("nicklist benchmark (%d nicks):\n", NICKLIST_TEST_BENCHMARK_NICKS);
+    printf ("  add. . . . : %lld ms\n", time_add / 1000);
+    printf ("  add (bulk) : %lld ms\n", time_add_bulk / 1000);
+    printf ("  search . . : %lld ms\n", time_search / 1000);
+    printf ("  remove . . : %lld ms\n", time_remove / 1000);
+}
+
+/*
+ * Tests functions:
+ *   gui_bar_item_buffer_nicklist_cb (only lines displayed)
+ */
+
+TEST(Nicklist, BarItemWindowed)
+{
+    struct t_gui_nick_group *group;
+    struct t_hashtable *extra_info;
+    char *value;
+
+    extra_info = hashtable_new (32,
+                                WEECHAT_HASHTABLE_STRING,
+                                WEECHAT_HASHTABLE_STRING,
+                                NULL, NULL);
+    CHECK(extra_info);
+
+    group = gui_nicklist_add_group (buffer, NULL, "01|ops", NULL, 1);
+    CHECK(gui_nicklist_add_nick (buffer, group, "alice", NULL, "@", NULL, 1));
+    CHECK(gui_nicklist_add_nick (buffer, group, "bob", NULL, "@", NULL, 1));
+    group = gui_nicklist_add_group (buffer, NULL, "02|users", NULL, 1);
+    CHECK(gui_nicklist_add_nick (buffer, group, "carol", NULL, NULL, NULL, 1));
+    CHECK(gui_nicklist_add_nick (buffer, group, "dave", NULL, NULL, NULL, 0));
+    CHECK(gui_nicklist_add_nick (buffer, group, "eve_long_nick", NULL, NULL,
+                                 NULL, 1));
+
+    /* all lines */
+    value = test_nicklist_build_bar_item (buffer, -1, 0, extra_info);
+    STRCMP_EQUAL("ops\n @alice\n @bob\nusers\n carol\n eve_long_nick", value);
+    free (value);
+
+    /* lines displayed only */
+    value = test_nicklist_build_bar_item (buffer, 2, 3, extra_info);
+    STRCMP_EQUAL(" @bob\nusers\n carol", value);
+    STRCMP_EQUAL("6", (const char *)hashtable_get (extra_info,
+                                                   "_window_total_lines"));
+    STRCMP_EQUAL("14", (const char *)hashtable_get (extra_info,
+                                                    "_window_max_length"));
+    free (value);
+
+    /* lines displayed after the end */
+    value = test_nicklist_build_bar_item (buffer, 10, 3, extra_info);
+    STRCMP_EQUAL("", value);
+    STRCMP_EQUAL("6", (const char *)hashtable_get (extra_info,
+                                                   "_window_total_lines"));
+    free (value);
+
+    /* nicklist without groups */
+    gui_buffer_set (buffer, "nicklist_display_groups", "0");
+    value = test_nicklist_build_bar_item (buffer, 0, 2, extra_info);
+    STRCMP_EQUAL("@alice\n@bob", value);
+    STRCMP_EQUAL("4", (const char *)hashtable_get (extra_info,
+                                                   "_window_total_lines"));
+    STRCMP_EQUAL("13", (const char *)hashtable_get (extra_info,
+                                                    "_window_max_length"));
+    free (value);
+
+    hashtable_free (extra_info);
+}
+
+/*
+ * Tests functions:
+ *   gui_bar_item_buffer_nicklist_cb (benchmark, all lines and only lines
+ *                                    displayed)
+ */
+
+TEST(Nicklist, BarItemBenchmark)
+{
+    struct t_hashtable *extra_info;
+    struct timeval time1, time2;
+    char name[64], *value;
+    long long time_full, time_windowed;
+    int i;
+
+    extra_info = hashtable_new (32,
+                                WEECHAT_HASHTABLE_STRING,
+                                WEECHAT_HASHTABLE_STRING,
+                                NULL, NULL);
+    CHECK(extra_info);
+
+    gui_buffer_set (buffer, "nicklist_bulk_add", "1");
+    for (i = 0; i < NICKLIST_TEST_BENCHMARK_BAR_ITEM_NICKS; i++)
+    {
+        snprintf (name, sizeof (name), "nick%05d", i);
+        CHECK(gui_nicklist_add_nick (buffer, NULL, name,
+                                     "bar_fg", (i % 10 == 0) ? "@" : " ",
+                                     "lightgreen", 1));
+    }
+    gui_buffer_set (buffer, "nicklist_bulk_add", "0");
+
+    /* all lines */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < NICKLIST_TEST_BENCHMARK_BAR_ITEM_BUILDS; i++)
+    {
+        value = test_nicklist_build_bar_item (buffer, -1, 0, extra_info);
+        CHECK(value);
+        free (value);
+    }
+    gettimeofday (&time2, NULL);
+    time_full = util_timeval_diff (&time1, &time2);
+
+    /* only lines displayed (60 lines in the middle of nicklist) */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < NICKLIST_TEST_BENCHMARK_BAR_ITEM_BUILDS; i++)
+    {
+        value = test_nicklist_build_bar_item (
+            buffer, NICKLIST_TEST_BENCHMARK_BAR_ITEM_NICKS / 2, 60,
+            extra_info);
+        CHECK(value);
+        free (value);
+    }
+    gettimeofday (&time2, NULL);
+    time_windowed = util_timeval_diff (&time1, &time2);
+
+    hashtable_free (extra_info);
+
+    printf ("\n");
+    printf ("nicklist bar item benchmark (%d nicks, %d builds):\n",
+            NICKLIST_TEST_BENCHMARK_BAR_ITEM_NICKS,
+            NICKLIST_TEST_BENCHMARK_BAR_ITEM_BUILDS);
+    printf ("  all lines. . . . . : %lld ms\n", time_full / 1000);
+    printf ("  lines displayed. . : %lld ms\n", time_windowed / 1000);
+}
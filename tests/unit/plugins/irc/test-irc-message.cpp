@@ -0,0 +1,419 @@
+/*
+ * test-irc-message.cpp - test IRC message functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/plugins/irc/irc-server.h"
+#include "src/plugins/irc/irc-message.h"
+}
+
+#define IRC_MESSAGE_TEST_SERVER "test_irc_message"
+
+#define WEE_CHECK_PARSED_FIELD(__result, __pos, __length)               \
+    str = irc_message_parsed_get (&parsed, __pos, __length,             \
+                                  buffer, sizeof (buffer));             \
+    if (__result)                                                       \
+    {                                                                   \
+        STRCMP_EQUAL(__result, str);                                    \
+    }                                                                   \
+    else                                                                \
+    {                                                                   \
+        POINTERS_EQUAL(NULL, str);                                      \
+    }
+
+#define WEE_CHECK_PARSED(__message, __tags, __msg_without_tags, __nick, \
+                         __host, __command, __channel, __arguments,     \
+                         __text)                                        \
+    irc_message_parse_positions (server, __message, &parsed);           \
+    POINTERS_EQUAL(__message, parsed.message);                          \
+    WEE_CHECK_PARSED_FIELD(__tags,                                      \
+                           parsed.pos_tags, parsed.length_tags);        \
+    WEE_CHECK_PARSED_FIELD(__msg_without_tags,                          \
+                           parsed.pos_message_without_tags, -1);        \
+    WEE_CHECK_PARSED_FIELD(__nick,                                      \
+                           parsed.pos_nick, parsed.length_nick);        \
+    WEE_CHECK_PARSED_FIELD(__host,                                      \
+                           parsed.pos_host, parsed.length_host);        \
+    WEE_CHECK_PARSED_FIELD(__command,                                   \
+                           parsed.pos_command, parsed.length_command);  \
+    WEE_CHECK_PARSED_FIELD(__channel,                                   \
+                           parsed.pos_channel, parsed.length_channel);  \
+    WEE_CHECK_PARSED_FIELD(__arguments, parsed.pos_arguments, -1);      \
+    WEE_CHECK_PARSED_FIELD(__text, parsed.pos_text, -1);
+
+#define WEE_CHECK_PARSE_STR(__field, __pos, __length)                   \
+    str = irc_message_parsed_get (&parsed, __pos, __length, NULL, 0);   \
+    if (str)                                                            \
+    {                                                                   \
+        STRCMP_EQUAL(str, __field);                                     \
+        free (str);                                                     \
+    }                                                                   \
+    else                                                                \
+    {                                                                   \
+        POINTERS_EQUAL(NULL, __field);                                  \
+    }                                                                   \
+    if (__field)                                                        \
+        free (__field);
+
+TEST_GROUP(IrcMessage)
+{
+    struct t_irc_server *server;
+    struct t_irc_message_parsed parsed;
+    char buffer[64], *str;
+
+    void setup ()
+    {
+        server = irc_server_alloc (IRC_MESSAGE_TEST_SERVER);
+        CHECK(server);
+    }
+
+    void teardown ()
+    {
+        irc_server_free (server);
+    }
+
+    /*
+     * Checks that irc_message_parse returns the same fields and positions
+     * as irc_message_parse_positions.
+     */
+
+    void check_parse (const char *message)
+    {
+        char *tags, *message_without_tags, *nick, *host, *command, *channel;
+        char *arguments, *text;
+        int pos_command, pos_arguments, pos_channel, pos_text;
+
+        irc_message_parse (server, message, &tags, &message_without_tags,
+                           &nick, &host, &command, &channel, &arguments,
+                           &text, &pos_command, &pos_arguments, &pos_channel,
+                           &pos_text);
+        irc_message_parse_positions (server, message, &parsed);
+
+        WEE_CHECK_PARSE_STR(tags, parsed.pos_tags, parsed.length_tags);
+        WEE_CHECK_PARSE_STR(message_without_tags,
+                            parsed.pos_message_without_tags, -1);
+        WEE_CHECK_PARSE_STR(nick, parsed.pos_nick, parsed.length_nick);
+        WEE_CHECK_PARSE_STR(host, parsed.pos_host, parsed.length_host);
+        WEE_CHECK_PARSE_STR(command,
+                            parsed.pos_command, parsed.length_command);
+        WEE_CHECK_PARSE_STR(channel,
+                            parsed.pos_channel, parsed.length_channel);
+        WEE_CHECK_PARSE_STR(arguments, parsed.pos_arguments, -1);
+        WEE_CHECK_PARSE_STR(text, parsed.pos_text, -1);
+        LONGS_EQUAL(parsed.pos_command, pos_command);
+        LONGS_EQUAL(parsed.pos_arguments, pos_arguments);
+        LONGS_EQUAL(parsed.pos_channel, pos_channel);
+        LONGS_EQUAL(parsed.pos_text, pos_text);
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_message_parse_positions (empty message)
+ */
+
+TEST(IrcMessage, ParsePositionsEmpty)
+{
+    irc_message_parse_positions (server, NULL, &parsed);
+    POINTERS_EQUAL(NULL, parsed.message);
+    LONGS_EQUAL(-1, parsed.pos_tags);
+    LONGS_EQUAL(-1, parsed.pos_message_without_tags);
+    LONGS_EQUAL(-1, parsed.pos_nick);
+    LONGS_EQUAL(-1, parsed.pos_host);
+    LONGS_EQUAL(-1, parsed.pos_command);
+    LONGS_EQUAL(-1, parsed.pos_channel);
+    LONGS_EQUAL(-1, parsed.pos_arguments);
+    LONGS_EQUAL(-1, parsed.pos_text);
+    POINTERS_EQUAL(NULL, irc_message_parsed_get (&parsed, 0, -1, NULL, 0));
+
+    WEE_CHECK_PARSED("", NULL, "", NULL, NULL, NULL, NULL, NULL, NULL);
+}
+
+/*
+ * Tests functions:
+ *   irc_message_parse_positions (tags)
+ */
+
+TEST(IrcMessage, ParsePositionsTags)
+{
+    const char *message =
+        "@time=2015-06-27T16:40:35.000Z :nick!user@host PRIVMSG #weechat "
+        ":hello!";
+
+    WEE_CHECK_PARSED(message,
+                     "time=2015-06-27T16:40:35.000Z",
+                     ":nick!user@host PRIVMSG #weechat :hello!",
+                     "nick", "nick!user@host", "PRIVMSG", "#weechat",
+                     "#weechat :hello!", "hello!");
+    LONGS_EQUAL(1, parsed.pos_tags);
+    LONGS_EQUAL(29, parsed.length_tags);
+    LONGS_EQUAL(31, parsed.pos_message_without_tags);
+    LONGS_EQUAL(32, parsed.pos_nick);
+    LONGS_EQUAL(4, parsed.length_nick);
+    LONGS_EQUAL(32, parsed.pos_host);
+    LONGS_EQUAL(14, parsed.length_host);
+    LONGS_EQUAL(47, parsed.pos_command);
+    LONGS_EQUAL(7, parsed.length_command);
+    LONGS_EQUAL(55, parsed.pos_channel);
+    LONGS_EQUAL(8, parsed.length_channel);
+    LONGS_EQUAL(55, parsed.pos_arguments);
+    LONGS_EQUAL(65, parsed.pos_text);
+
+    /* multiple spaces after tags */
+    WEE_CHECK_PARSED("@a=b;c   :nick!user@host QUIT",
+                     "a=b;c", ":nick!user@host QUIT",
+                     "nick", "nick!user@host", "QUIT", NULL, NULL, NULL);
+
+    /* only tags (no space after tags) */
+    WEE_CHECK_PARSED("@a=b",
+                     NULL, "@a=b", NULL, NULL, "@a=b", NULL, NULL, NULL);
+}
+
+/*
+ * Tests functions:
+ *   irc_message_parse_positions (prefix without host)
+ */
+
+TEST(IrcMessage, ParsePositionsPrefix)
+{
+    /* server name as prefix */
+    WEE_CHECK_PARSED(":irc.example.com 001 alice :Welcome",
+                     NULL, ":irc.example.com 001 alice :Welcome",
+                     "irc.example.com", "irc.example.com", "001", "alice",
+                     "alice :Welcome", "Welcome");
+
+    /* nick@host (no user) */
+    WEE_CHECK_PARSED(":nick@host AWAY",
+                     NULL, ":nick@host AWAY",
+                     "nick", "nick@host", "AWAY", NULL, NULL, NULL);
+
+    /* nick only */
+    WEE_CHECK_PARSED(":nick NICK :nick2",
+                     NULL, ":nick NICK :nick2",
+                     "nick", "nick", "NICK", NULL, ":nick2", "nick2");
+
+    /* no prefix: nick is read in arguments */
+    WEE_CHECK_PARSED("PING alice",
+                     NULL, "PING alice",
+                     "alice", NULL, "PING", NULL, "alice", NULL);
+}
+
+/*
+ * Tests functions:
+ *   irc_message_parse_positions (missing command)
+ */
+
+TEST(IrcMessage, ParsePositionsNoCommand)
+{
+    WEE_CHECK_PARSED(":nick!user@host",
+                     NULL, ":nick!user@host",
+                     "nick", "nick!user@host", NULL, NULL, NULL, NULL);
+    WEE_CHECK_PARSED("@a=b :nick!user@host",
+                     "a=b", ":nick!user@host",
+                     "nick", "nick!user@host", NULL, NULL, NULL, NULL);
+    WEE_CHECK_PARSED(":nick!user@host   ",
+                     NULL, ":nick!user@host   ",
+                     "nick", "nick!user@host", NULL, NULL, NULL, NULL);
+
+    /* command without arguments */
+    WEE_CHECK_PARSED(":nick!user@host QUIT",
+                     NULL, ":nick!user@host QUIT",
+                     "nick", "nick!user@host", "QUIT", NULL, NULL, NULL);
+}
+
+/*
+ * Tests functions:
+ *   irc_message_parse_positions (trailing ":")
+ */
+
+TEST(IrcMessage, ParsePositionsTrailing)
+{
+    /* empty text */
+    WEE_CHECK_PARSED(":nick!user@host PRIVMSG #chan :",
+                     NULL, ":nick!user@host PRIVMSG #chan :",
+                     "nick", "nick!user@host", "PRIVMSG", "#chan",
+                     "#chan :", "");
+
+    /* text with spaces and ":" */
+    WEE_CHECK_PARSED(":nick!user@host PRIVMSG #chan ::a b: c",
+                     NULL, ":nick!user@host PRIVMSG #chan ::a b: c",
+                     "nick", "nick!user@host", "PRIVMSG", "#chan",
+                     "#chan ::a b: c", ":a b: c");
+
+    /* only text in arguments */
+    WEE_CHECK_PARSED(":nick!user@host QUIT :bye bye",
+                     NULL, ":nick!user@host QUIT :bye bye",
+                     "nick", "nick!user@host", "QUIT", NULL,
+                     ":bye bye", "bye bye");
+
+    /* JOIN/PART: the channel can be the trailing argument */
+    WEE_CHECK_PARSED(":nick!user@host JOIN :#chan",
+                     NULL, ":nick!user@host JOIN :#chan",
+                     "nick", "nick!user@host", "JOIN", "#chan",
+                     ":#chan", NULL);
+    WEE_CHECK_PARSED(":nick!user@host PART :#chan",
+                     NULL, ":nick!user@host PART :#chan",
+                     "nick", "nick!user@host", "PART", "#chan",
+                     ":#chan", NULL);
+}
+
+/*
+ * Tests functions:
+ *   irc_message_parse_positions (channel detection)
+ */
+
+TEST(IrcMessage, ParsePositionsChannel)
+{
+    /* channel as first argument */
+    WEE_CHECK_PARSED(":nick!user@host MODE #chan +o bob",
+                     NULL, ":nick!user@host MODE #chan +o bob",
+                     "nick", "nick!user@host", "MODE", "#chan",
+                     "#chan +o bob", "+o bob");
+
+    /* channel as second argument (numeric) */
+    WEE_CHECK_PARSED(":irc.example.com 332 alice #chan :the topic",
+                     NULL, ":irc.example.com 332 alice #chan :the topic",
+                     "irc.example.com", "irc.example.com", "332", "#chan",
+                     "alice #chan :the topic", "the topic");
+
+    /* nick as first argument (private message) */
+    WEE_CHECK_PARSED(":nick!user@host PRIVMSG alice :hi",
+                     NULL, ":nick!user@host PRIVMSG alice :hi",
+                     "nick", "nick!user@host", "PRIVMSG", "alice",
+                     "alice :hi", "hi");
+
+    /* default chantypes ("#&+!") */
+    WEE_CHECK_PARSED(":nick!user@host PRIVMSG &chan :hi",
+                     NULL, ":nick!user@host PRIVMSG &chan :hi",
+                     "nick", "nick!user@host", "PRIVMSG", "&chan",
+                     "&chan :hi", "hi");
+    LONGS_EQUAL(parsed.pos_arguments, parsed.pos_channel);
+
+    /* chantypes of server: "&" is not a channel type any more */
+    server->chantypes = strdup ("#");
+    WEE_CHECK_PARSED(":nick!user@host PRIVMSG &chan :hi",
+                     NULL, ":nick!user@host PRIVMSG &chan :hi",
+                     "nick", "nick!user@host", "PRIVMSG", "&chan",
+                     "&chan :hi", "hi");
+    LONGS_EQUAL(parsed.pos_arguments, parsed.pos_channel);
+    /* no channel found: first argument is the channel, text follows it */
+    WEE_CHECK_PARSED(":irc.example.com 332 alice &chan :the topic",
+                     NULL, ":irc.example.com 332 alice &chan :the topic",
+                     "irc.example.com", "irc.example.com", "332", "alice",
+                     "alice &chan :the topic", "&chan :the topic");
+}
+
+/*
+ * Tests functions:
+ *   irc_message_parsed_get (fields longer than buffer)
+ */
+
+TEST(IrcMessage, ParsedGetLong)
+{
+    char message[1024], command[128], channel[512];
+
+    memset (command, 'A', sizeof (command) - 1);
+    command[sizeof (command) - 1] = '\0';
+    channel[0] = '#';
+    memset (channel + 1, 'c', sizeof (channel) - 2);
+    channel[sizeof (channel) - 1] = '\0';
+    snprintf (message, sizeof (message), ":nick!user@host %s %s :text",
+              command, channel);
+
+    irc_message_parse_positions (server, message, &parsed);
+    LONGS_EQUAL(strlen (command), parsed.length_command);
+    LONGS_EQUAL(strlen (channel), parsed.length_channel);
+
+    /* short field: copied in buffer */
+    str = irc_message_parsed_get (&parsed,
+                                  parsed.pos_nick, parsed.length_nick,
+                                  buffer, sizeof (buffer));
+    POINTERS_EQUAL(buffer, str);
+    STRCMP_EQUAL("nick", str);
+
+    /* command longer than buffer: allocated */
+    str = irc_message_parsed_get (&parsed,
+                                  parsed.pos_command, parsed.length_command,
+                                  buffer, sizeof (buffer));
+    CHECK(str && (str != buffer));
+    STRCMP_EQUAL(command, str);
+    free (str);
+
+    /* channel longer than buffer: allocated */
+    str = irc_message_parsed_get (&parsed,
+                                  parsed.pos_channel, parsed.length_channel,
+                                  buffer, sizeof (buffer));
+    CHECK(str && (str != buffer));
+    STRCMP_EQUAL(channel, str);
+    free (str);
+
+    /* field with exactly the size of buffer (no room for final '\0') */
+    memset (command, 'B', sizeof (buffer));
+    command[sizeof (buffer)] = '\0';
+    snprintf (message, sizeof (message), "%s #chan", command);
+    irc_message_parse_positions (server, message, &parsed);
+    str = irc_message_parsed_get (&parsed,
+                                  parsed.pos_command, parsed.length_command,
+                                  buffer, sizeof (buffer));
+    CHECK(str && (str != buffer));
+    STRCMP_EQUAL(command, str);
+    free (str);
+    command[sizeof (buffer) - 1] = '\0';
+    snprintf (message, sizeof (message), "%s #chan", command);
+    irc_message_parse_positions (server, message, &parsed);
+    str = irc_message_parsed_get (&parsed,
+                                  parsed.pos_command, parsed.length_command,
+                                  buffer, sizeof (buffer));
+    POINTERS_EQUAL(buffer, str);
+    STRCMP_EQUAL(command, str);
+
+    check_parse (message);
+}
+
+/*
+ * Tests functions:
+ *   irc_message_parse
+ */
+
+TEST(IrcMessage, Parse)
+{
+    check_parse (NULL);
+    check_parse ("");
+    check_parse ("@time=2015-06-27T16:40:35.000Z :nick!user@host PRIVMSG "
+                 "#weechat :hello!");
+    check_parse ("@a=b");
+    check_parse (":irc.example.com 001 alice :Welcome");
+    check_parse (":nick@host AWAY");
+    check_parse (":nick NICK :nick2");
+    check_parse ("PING alice");
+    check_parse (":nick!user@host");
+    check_parse (":nick!user@host QUIT");
+    check_parse (":nick!user@host PRIVMSG #chan :");
+    check_parse (":nick!user@host JOIN :#chan");
+    check_parse (":nick!user@host MODE #chan +o bob");
+    check_parse (":irc.example.com 332 alice #chan :the topic");
+    check_parse (":nick!user@host PRIVMSG alice :hi");
+}
@@ -0,0 +1,198 @@
+/*
+ * test-irc-nick.cpp - test IRC nick functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "src/core/wee-hashtable.h"
+#include "src/core/wee-util.h"
+#include "src/plugins/irc/irc-server.h"
+#include "src/plugins/irc/irc-channel.h"
+#include "src/plugins/irc/irc-nick.h"
+}
+
+#define IRC_NICK_TEST_SERVER  "test_irc_nick"
+#define IRC_NICK_TEST_CHANNEL "#test"
+#define IRC_NICK_TEST_BENCHMARK_NICKS 10000
+
+TEST_GROUP(IrcNick)
+{
+    struct t_irc_server *server;
+    struct t_irc_channel *channel;
+
+    void setup ()
+    {
+        server = irc_server_alloc (IRC_NICK_TEST_SERVER);
+        CHECK(server);
+        channel = irc_channel_new (server, IRC_CHANNEL_TYPE_CHANNEL,
+                                   IRC_NICK_TEST_CHANNEL, 0, 0);
+        CHECK(channel);
+    }
+
+    void teardown ()
+    {
+        irc_server_free (server);
+    }
+};
+
+/*
+ * Tests functions:
+ *   irc_nick_new
+ *   irc_nick_change
+ *   irc_nick_free
+ *   irc_nick_search
+ */
+
+TEST(IrcNick, NewChangeFreeSearch)
+{
+    struct t_irc_nick *nick1, *nick2;
+
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, NULL));
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, "alice"));
+
+    nick1 = irc_nick_new (server, channel, "Alice", "user@host", NULL, 0,
+                          NULL, NULL);
+    CHECK(nick1);
+    nick2 = irc_nick_new (server, channel, "bob", "user@host", NULL, 0,
+                          NULL, NULL);
+    CHECK(nick2);
+    LONGS_EQUAL(2, channel->nicks_count);
+    CHECK(channel->nicks_hashtable);
+    LONGS_EQUAL(2, channel->nicks_hashtable->items_count);
+
+    /* same nick added twice: the existing nick is updated */
+    POINTERS_EQUAL(nick1, irc_nick_new (server, channel, "alice", NULL, NULL,
+                                        0, NULL, NULL));
+    LONGS_EQUAL(2, channel->nicks_count);
+
+    POINTERS_EQUAL(nick1, irc_nick_search (server, channel, "Alice"));
+    POINTERS_EQUAL(nick1, irc_nick_search (server, channel, "ALICE"));
+    POINTERS_EQUAL(nick2, irc_nick_search (server, channel, "Bob"));
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, "carol"));
+
+    irc_nick_change (server, channel, nick1, "Carol");
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, "alice"));
+    POINTERS_EQUAL(nick1, irc_nick_search (server, channel, "carol"));
+    LONGS_EQUAL(2, channel->nicks_hashtable->items_count);
+
+    irc_nick_free (server, channel, nick2);
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, "bob"));
+    LONGS_EQUAL(1, channel->nicks_count);
+    LONGS_EQUAL(1, channel->nicks_hashtable->items_count);
+
+    irc_nick_free_all (server, channel);
+    POINTERS_EQUAL(NULL, channel->nicks_hashtable);
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, "carol"));
+}
+
+/*
+ * Tests functions:
+ *   irc_nick_search (with server casemapping)
+ *   irc_nick_hashtable_rebuild
+ */
+
+TEST(IrcNick, SearchCasemapping)
+{
+    struct t_irc_nick *nick;
+
+    /* rfc1459: "[]\~" are the upper case of "{}|^" */
+    server->casemapping = IRC_SERVER_CASEMAPPING_RFC1459;
+    irc_nick_hashtable_rebuild (server, channel);
+    nick = irc_nick_new (server, channel, "Nick[a]\\~", NULL, NULL, 0,
+                         NULL, NULL);
+    CHECK(nick);
+    POINTERS_EQUAL(nick, irc_nick_search (server, channel, "nick{a}|^"));
+    POINTERS_EQUAL(nick, irc_nick_search (server, channel, "NICK[A]\\~"));
+
+    /* strict-rfc1459: "[]\" are the upper case of "{}|" */
+    server->casemapping = IRC_SERVER_CASEMAPPING_STRICT_RFC1459;
+    irc_nick_hashtable_rebuild (server, channel);
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, "nick{a}|^"));
+    POINTERS_EQUAL(nick, irc_nick_search (server, channel, "nick{a}|~"));
+
+    /* ascii: only letters are case insensitive */
+    server->casemapping = IRC_SERVER_CASEMAPPING_ASCII;
+    irc_nick_hashtable_rebuild (server, channel);
+    POINTERS_EQUAL(NULL, irc_nick_search (server, channel, "nick{a}|~"));
+    POINTERS_EQUAL(nick, irc_nick_search (server, channel, "nick[a]\\~"));
+}
+
+/*
+ * Tests functions:
+ *   irc_nick_new (burst of nicks received in NAMES)
+ *   irc_nick_search
+ *   irc_nick_free (mass QUIT)
+ */
+
+TEST(IrcNick, Benchmark)
+{
+    struct t_irc_nick *ptr_nick;
+    struct timeval time1, time2;
+    char nickname[64];
+    long long time_names, time_search, time_quit;
+    int i;
+
+    /* NAMES burst: add nicks */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < IRC_NICK_TEST_BENCHMARK_NICKS; i++)
+    {
+        snprintf (nickname, sizeof (nickname), "Nick[%d]", i);
+        irc_nick_new (server, channel, nickname, "user@host", NULL, 0,
+                      NULL, NULL);
+    }
+    gettimeofday (&time2, NULL);
+    time_names = util_timeval_diff (&time1, &time2);
+    LONGS_EQUAL(IRC_NICK_TEST_BENCHMARK_NICKS, channel->nicks_count);
+
+    /* search all nicks */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < IRC_NICK_TEST_BENCHMARK_NICKS; i++)
+    {
+        snprintf (nickname, sizeof (nickname), "nick{%d}", i);
+        CHECK(irc_nick_search (server, channel, nickname));
+    }
+    gettimeofday (&time2, NULL);
+    time_search = util_timeval_diff (&time1, &time2);
+
+    /* mass QUIT: search and remove all nicks */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < IRC_NICK_TEST_BENCHMARK_NICKS; i++)
+    {
+        snprintf (nickname, sizeof (nickname), "NICK[%d]", i);
+        ptr_nick = irc_nick_search (server, channel, nickname);
+        CHECK(ptr_nick);
+        irc_nick_free (server, channel, ptr_nick);
+    }
+    gettimeofday (&time2, NULL);
+    time_quit = util_timeval_diff (&time1, &time2);
+    LONGS_EQUAL(0, channel->nicks_count);
+    POINTERS_EQUAL(NULL, channel->nicks);
+
+    printf ("\n");
+    printf ("irc nicks benchmark (%d nicks):\n", IRC_NICK_TEST_BENCHMARK_NICKS);
+    printf ("  names burst. . . . : %lld ms\n", time_names / 1000);
+    printf ("  search . . . . . . : %lld ms\n", time_search / 1000);
+    printf ("  mass quit. . . . . : %lld ms\n", time_quit / 1000);
+}
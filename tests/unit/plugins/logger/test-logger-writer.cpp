@@ -0,0 +1,398 @@
+/*
+ * test-logger-writer.cpp - test logger writer functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "src/core/wee-config-file.h"
+#include "src/core/wee-hook.h"
+#include "src/core/wee-util.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/plugins/weechat-plugin.h"
+#include "src/plugins/logger/logger-config.h"
+#include "src/plugins/logger/logger-writer.h"
+}
+
+#define LOGGER_WRITER_TEST_BUFFER "test_logger_writer"
+#define LOGGER_WRITER_TEST_BENCHMARK_LINES 20000
+
+int logger_writer_test_errors = 0;
+
+/*
+ * Callback for errors displayed by logger writer.
+ */
+
+int
+test_logger_writer_error_cb (const void *pointer, void *data,
+                             struct t_gui_buffer *buffer,
+                             time_t date, int tags_count, const char **tags,
+                             int displayed, int highlight,
+                             const char *prefix, const char *message)
+{
+    /* make C++ compiler happy */
+    (void) pointer;
+    (void) data;
+    (void) buffer;
+    (void) date;
+    (void) tags_count;
+    (void) tags;
+    (void) displayed;
+    (void) highlight;
+    (void) prefix;
+    (void) message;
+
+    logger_writer_test_errors++;
+
+    return WEECHAT_RC_OK;
+}
+
+TEST_GROUP(LoggerWriter)
+{
+    char filename[256];
+    int thread_started;
+
+    void setup ()
+    {
+        snprintf (filename, sizeof (filename),
+                  "/tmp/weechat_test_logger_%d.log", (int)getpid ());
+        unlink (filename);
+
+        /*
+         * the writer thread is started by the logger plugin if it is loaded
+         * (then it is not stopped here, because files of plugin are still
+         * opened)
+         */
+        thread_started = 0;
+        if (!logger_writer_thread_running)
+            thread_started = logger_writer_init ();
+        LONGS_EQUAL(1, logger_writer_thread_running);
+    }
+
+    void teardown ()
+    {
+        if (thread_started)
+            logger_writer_end ();
+        unlink (filename);
+    }
+
+    struct t_logger_writer_file *open_file ()
+    {
+        struct t_logger_writer_file *file;
+        int fd;
+
+        fd = open (filename, O_WRONLY | O_APPEND | O_CREAT, 0600);
+        CHECK(fd >= 0);
+        file = logger_writer_file_new (fd, filename);
+        CHECK(file);
+        return file;
+    }
+
+    long file_size ()
+    {
+        struct stat st;
+
+        if (stat (filename, &st) != 0)
+            return -1;
+        return (long)st.st_size;
+    }
+};
+
+/*
+ * Tests functions:
+ *   logger_writer_file_new
+ *   logger_writer_write_line
+ *   logger_writer_flush
+ *   logger_writer_file_close
+ */
+
+TEST(LoggerWriter, WriteLines)
+{
+    struct t_logger_writer_file *file;
+    char line[LOGGER_WRITER_CHUNK_SIZE * 2], buf[64], *content;
+    int fd, i, size;
+
+    file = open_file ();
+
+    /* lines not flushed are kept in memory */
+    logger_writer_write_line (file, "line 1", 0, 0);
+    logger_writer_write_line (file, "line 2", 0, 0);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(14, file_size ());
+
+    /* line bigger than a chunk */
+    memset (line, 'a', sizeof (line) - 1);
+    line[sizeof (line) - 1] = '\0';
+    logger_writer_write_line (file, line, 1, 0);
+    logger_writer_flush (1, 1);
+    LONGS_EQUAL(14 + (long)sizeof (line), file_size ());
+
+    /* many lines, then close (data is written before close) */
+    for (i = 0; i < 1000; i++)
+    {
+        snprintf (buf, sizeof (buf), "line %d", i);
+        logger_writer_write_line (file, buf, 0, 0);
+    }
+    logger_writer_file_close (file);
+    logger_writer_flush (0, 1);
+
+    /* check content of file */
+    size = file_size ();
+    content = (char *)malloc (size + 1);
+    CHECK(content);
+    fd = open (filename, O_RDONLY);
+    CHECK(fd >= 0);
+    LONGS_EQUAL(size, read (fd, content, size));
+    close (fd);
+    content[size] = '\0';
+    CHECK(strncmp (content, "line 1\nline 2\naaaa", 18) == 0);
+    STRCMP_EQUAL("line 998\nline 999\n", content + size - 18);
+    free (content);
+}
+
+/*
+ * Tests functions:
+ *   logger_writer_write_line (lines written by the writer thread)
+ *   logger_writer_flush (wait for the writer thread)
+ */
+
+TEST(LoggerWriter, WaitFlush)
+{
+    struct t_logger_writer_file *file;
+    char line[64];
+    int i;
+
+    file = open_file ();
+
+    /* lines not flushed: nothing is written by the thread */
+    logger_writer_write_line (file, "line 1", 0, 0);
+    usleep (10000);
+    LONGS_EQUAL(0, file_size ());
+
+    /* flush without wait: lines are written later by the thread */
+    logger_writer_flush (0, 0);
+
+    /* flush with wait: lines are written when the function returns */
+    for (i = 0; i < 1000; i++)
+    {
+        snprintf (line, sizeof (line), "line %04d", i);
+        logger_writer_write_line (file, line, 1, 0);
+    }
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(7 + (1000 * 10), file_size ());
+
+    /* close: data is written before the file is closed by the thread */
+    logger_writer_write_line (file, "last line", 0, 0);
+    logger_writer_file_close (file);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(7 + (1000 * 10) + 10, file_size ());
+}
+
+/*
+ * Tests functions:
+ *   logger_writer_write_line (with fsync)
+ *   logger_writer_flush (with fsync)
+ */
+
+TEST(LoggerWriter, Fsync)
+{
+    struct t_logger_writer_file *file;
+    int fsync_count;
+
+    file = open_file ();
+
+    /* fsync requested for line is done, even with a flush without fsync */
+    fsync_count = logger_writer_fsync_count;
+    logger_writer_write_line (file, "line 1", 1, 1);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(fsync_count + 1, logger_writer_fsync_count);
+
+    /* no fsync requested */
+    logger_writer_write_line (file, "line 2", 1, 0);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(fsync_count + 1, logger_writer_fsync_count);
+
+    /* fsync requested by flush */
+    logger_writer_write_line (file, "line 3", 0, 0);
+    logger_writer_flush (1, 1);
+    LONGS_EQUAL(fsync_count + 2, logger_writer_fsync_count);
+
+    /* nothing to write: no fsync */
+    logger_writer_flush (1, 1);
+    LONGS_EQUAL(fsync_count + 2, logger_writer_fsync_count);
+
+    logger_writer_file_close (file);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(21, file_size ());
+}
+
+/*
+ * Tests option logger.file.fsync with logger.file.flush_delay = 0: fsync is
+ * done after each line written.
+ */
+
+TEST(LoggerWriter, FsyncNoFlushDelay)
+{
+    struct t_gui_buffer *buffer;
+    int fsync_count;
+
+    if (!logger_config_file_fsync)
+    {
+        /* logger plugin not loaded */
+        return;
+    }
+
+    config_file_option_set (logger_config_file_flush_delay, "0", 1);
+    config_file_option_set (logger_config_file_fsync, "on", 1);
+
+    buffer = gui_buffer_new (NULL, LOGGER_WRITER_TEST_BUFFER,
+                             NULL, NULL, NULL,
+                             NULL, NULL, NULL);
+    CHECK(buffer);
+
+    fsync_count = logger_writer_fsync_count;
+    gui_chat_printf (buffer, "nick\tline 1");
+    logger_writer_flush (0, 1);
+    CHECK(logger_writer_fsync_count > fsync_count);
+
+    /* an unrelated flush without fsync does not cancel fsync of lines */
+    fsync_count = logger_writer_fsync_count;
+    gui_chat_printf (buffer, "nick\tline 2");
+    logger_writer_flush (0, 1);
+    CHECK(logger_writer_fsync_count > fsync_count);
+
+    /* fsync off: no fsync */
+    config_file_option_set (logger_config_file_fsync, "off", 1);
+    fsync_count = logger_writer_fsync_count;
+    gui_chat_printf (buffer, "nick\tline 3");
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(fsync_count, logger_writer_fsync_count);
+
+    gui_buffer_close (buffer);
+
+    config_file_option_reset (logger_config_file_flush_delay, 1);
+    config_file_option_reset (logger_config_file_fsync, 1);
+}
+
+/*
+ * Tests functions:
+ *   logger_writer_write_line (write error in the writer thread)
+ *   logger_writer_flush (error displayed by main thread)
+ */
+
+TEST(LoggerWriter, WriteError)
+{
+    struct t_logger_writer_file *file;
+    struct t_hook *ptr_hook;
+    int fd;
+
+    fd = open (filename, O_RDONLY | O_CREAT, 0600);
+    CHECK(fd >= 0);
+    file = logger_writer_file_new (fd, filename);
+    CHECK(file);
+
+    logger_writer_test_errors = 0;
+    ptr_hook = hook_print (NULL, NULL, NULL, "unable to write log file", 1,
+                           &test_logger_writer_error_cb, NULL, NULL);
+    CHECK(ptr_hook);
+
+    /* error in thread is displayed by the main thread */
+    logger_writer_write_line (file, "line 1", 1, 0);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(1, logger_writer_test_errors);
+
+    /* error is displayed only once */
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(1, logger_writer_test_errors);
+
+    logger_writer_file_close (file);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL(0, file_size ());
+
+    unhook (ptr_hook);
+}
+
+/*
+ * Tests functions:
+ *   logger_writer_write_line (benchmark)
+ *
+ * Compares lines written by the writer thread with a write + flush of each
+ * line with stdio in the main thread (as before).
+ */
+
+TEST(LoggerWriter, Benchmark)
+{
+    struct t_logger_writer_file *file;
+    struct timeval time1, time2;
+    long long time_writer, time_stdio;
+    char line[256];
+    FILE *f;
+    int i;
+
+    snprintf (line, sizeof (line),
+              "2018-06-01 12:00:00\talice\tthis is a message on a busy "
+              "channel, written in a log file");
+
+    /* lines written by the writer thread */
+    file = open_file ();
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < LOGGER_WRITER_TEST_BENCHMARK_LINES; i++)
+    {
+        logger_writer_write_line (file, line, 1, 0);
+    }
+    gettimeofday (&time2, NULL);
+    time_writer = util_timeval_diff (&time1, &time2);
+    logger_writer_file_close (file);
+    logger_writer_flush (0, 1);
+    LONGS_EQUAL((long)(strlen (line) + 1) * LOGGER_WRITER_TEST_BENCHMARK_LINES,
+                file_size ());
+
+    /* lines written with stdio, with a flush after each line */
+    unlink (filename);
+    f = fopen (filename, "a");
+    CHECK(f);
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < LOGGER_WRITER_TEST_BENCHMARK_LINES; i++)
+    {
+        fprintf (f, "%s\n", line);
+        fflush (f);
+    }
+    gettimeofday (&time2, NULL);
+    time_stdio = util_timeval_diff (&time1, &time2);
+    fclose (f);
+
+    printf ("\n");
+    printf ("logger benchmark (%d lines, flush after each line):\n",
+            LOGGER_WRITER_TEST_BENCHMARK_LINES);
+    printf ("  writer thread  . . . : %lld ms (time in main thread)\n",
+            time_writer / 1000);
+    printf ("  stdio + fflush . . . : %lld ms (time in main thread)\n",
+            time_stdio / 1000);
+}
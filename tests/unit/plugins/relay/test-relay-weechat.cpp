@@ -0,0 +1,428 @@
+/*
+ * test-relay-weechat.cpp - test relay WeeChat protocol functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "src/core/wee-hashtable.h"
+#include "src/core/wee-util.h"
+#include "src/gui/gui-buffer.h"
+#include "src/gui/gui-chat.h"
+#include "src/gui/gui-line.h"
+#include "src/plugins/weechat-plugin.h"
+#include "src/plugins/relay/relay.h"
+#include "src/plugins/relay/relay-buffer.h"
+#include "src/plugins/relay/relay-client.h"
+#include "src/plugins/relay/relay-server.h"
+#include "src/plugins/relay/weechat/relay-weechat.h"
+#include "src/plugins/relay/weechat/relay-weechat-msg.h"
+#include "src/plugins/relay/weechat/relay-weechat-protocol.h"
+}
+
+#define RELAY_WEECHAT_TEST_BUFFER "test_relay_weechat"
+#define RELAY_WEECHAT_TEST_MAX_CLIENTS 8
+#define RELAY_WEECHAT_TEST_BENCHMARK_LINES 2000
+#define RELAY_WEECHAT_TEST_OUTQUEUE_MSGS 1000
+
+TEST_GROUP(RelayWeechat)
+{
+    struct t_relay_server server;
+    struct t_relay_client *clients[RELAY_WEECHAT_TEST_MAX_CLIENTS];
+    int socks[RELAY_WEECHAT_TEST_MAX_CLIENTS];
+    long long bytes_recv[RELAY_WEECHAT_TEST_MAX_CLIENTS];
+    char *data_recv[RELAY_WEECHAT_TEST_MAX_CLIENTS];
+    int data_recv_size[RELAY_WEECHAT_TEST_MAX_CLIENTS];
+    int num_clients;
+    struct t_gui_buffer *buffer;
+
+    void setup ()
+    {
+        int i;
+
+        memset (&server, 0, sizeof (server));
+        server.protocol_string = (char *)"weechat";
+        server.protocol = RELAY_PROTOCOL_WEECHAT;
+        server.start_time = time (NULL);
+
+        for (i = 0; i < RELAY_WEECHAT_TEST_MAX_CLIENTS; i++)
+        {
+            clients[i] = NULL;
+            socks[i] = -1;
+            bytes_recv[i] = 0;
+            data_recv[i] = NULL;
+            data_recv_size[i] = 0;
+        }
+        num_clients = 0;
+
+        buffer = gui_buffer_new (NULL, RELAY_WEECHAT_TEST_BUFFER,
+                                 NULL, NULL, NULL, NULL, NULL, NULL);
+        CHECK(buffer);
+    }
+
+    void teardown ()
+    {
+        int i;
+
+        for (i = 0; i < num_clients; i++)
+        {
+            relay_client_set_status (clients[i], RELAY_STATUS_DISCONNECTED);
+            relay_client_free (clients[i]);
+            close (socks[i]);
+            if (data_recv[i])
+                free (data_recv[i]);
+        }
+        gui_buffer_close (buffer);
+    }
+
+    /*
+     * Creates a synthetic WeeChat relay client connected with a socketpair,
+     * synchronized with all buffers.
+     */
+
+    void add_client (int compression)
+    {
+        int sv[2], flags;
+
+        LONGS_EQUAL(0, socketpair (AF_UNIX, SOCK_STREAM, 0, sv));
+        fcntl (sv[0], F_SETFL, fcntl (sv[0], F_GETFL) | O_NONBLOCK);
+        fcntl (sv[1], F_SETFL, fcntl (sv[1], F_GETFL) | O_NONBLOCK);
+
+        clients[num_clients] = relay_client_new (sv[0], "test", &server);
+        CHECK(clients[num_clients]);
+        RELAY_WEECHAT_DATA(clients[num_clients], compression) =
+            (enum t_relay_weechat_compression)compression;
+        flags = RELAY_WEECHAT_PROTOCOL_SYNC_BUFFERS |
+            RELAY_WEECHAT_PROTOCOL_SYNC_BUFFER;
+        hashtable_set (RELAY_WEECHAT_DATA(clients[num_clients], buffers_sync),
+                       "*", &flags);
+        socks[num_clients] = sv[1];
+        num_clients++;
+    }
+
+    /*
+     * Reads all data available on sockets of clients.
+     */
+
+    void read_clients (int keep_data)
+    {
+        char buf[65536], *ptr_data;
+        int i, num_read;
+
+        for (i = 0; i < num_clients; i++)
+        {
+            while (1)
+            {
+                num_read = read (socks[i], buf, sizeof (buf));
+                if (num_read <= 0)
+                    break;
+                bytes_recv[i] += num_read;
+                if (keep_data)
+                {
+                    ptr_data = (char *)realloc (data_recv[i],
+                                                data_recv_size[i] + num_read);
+                    CHECK(ptr_data);
+                    data_recv[i] = ptr_data;
+                    memcpy (data_recv[i] + data_recv_size[i], buf, num_read);
+                    data_recv_size[i] += num_read;
+                }
+            }
+        }
+    }
+
+    void reset_clients ()
+    {
+        int i;
+
+        read_clients (0);
+        for (i = 0; i < num_clients; i++)
+        {
+            bytes_recv[i] = 0;
+            if (data_recv[i])
+            {
+                free (data_recv[i]);
+                data_recv[i] = NULL;
+            }
+            data_recv_size[i] = 0;
+        }
+    }
+};
+
+/*
+ * Tests functions:
+ *   relay_weechat_msg_compress
+ *   relay_weechat_msg_send
+ */
+
+TEST(RelayWeechat, MsgCompress)
+{
+    struct t_relay_weechat_msg *msg;
+    char str_long[4096];
+
+    msg = relay_weechat_msg_new ("test");
+    CHECK(msg);
+    LONGS_EQUAL(0, relay_weechat_msg_compress (msg, 0));
+
+    /* short message: compressed message is not smaller */
+    relay_weechat_msg_add_string (msg, "a");
+    LONGS_EQUAL(0, relay_weechat_msg_compress (msg, 6));
+    POINTERS_EQUAL(NULL, msg->data_compressed);
+    LONGS_EQUAL(6, msg->compression_level);
+
+    /* long message: compressed once, then message is changed */
+    memset (str_long, 'a', sizeof (str_long) - 1);
+    str_long[sizeof (str_long) - 1] = '\0';
+    relay_weechat_msg_add_string (msg, str_long);
+    LONGS_EQUAL(0, msg->compression_level);
+    LONGS_EQUAL(1, relay_weechat_msg_compress (msg, 6));
+    CHECK(msg->data_compressed);
+    CHECK(msg->data_compressed_size < msg->data_size);
+    LONGS_EQUAL(RELAY_WEECHAT_COMPRESSION_ZLIB, msg->data_compressed[4]);
+    LONGS_EQUAL(1, relay_weechat_msg_compress (msg, 6));
+    LONGS_EQUAL(1, relay_weechat_msg_compress (msg, 9));
+    LONGS_EQUAL(9, msg->compression_level);
+
+    relay_weechat_msg_free (msg);
+}
+
+/*
+ * Tests functions:
+ *   relay_weechat_protocol_signal_buffer_cb (fan-out to many clients)
+ */
+
+TEST(RelayWeechat, SignalBufferFanOut)
+{
+    char str_long[2048];
+    int i;
+
+    add_client (RELAY_WEECHAT_COMPRESSION_ZLIB);
+    add_client (RELAY_WEECHAT_COMPRESSION_OFF);
+    add_client (RELAY_WEECHAT_COMPRESSION_ZLIB);
+    LONGS_EQUAL(3, relay_weechat_signal_buffer_clients);
+    CHECK(relay_weechat_hook_signal_buffer);
+    reset_clients ();
+
+    memset (str_long, 'a', sizeof (str_long) - 1);
+    str_long[sizeof (str_long) - 1] = '\0';
+    gui_chat_printf_date_tags (buffer, 0, NULL, "%s", str_long);
+    read_clients (1);
+
+    /* all clients received the message, with size of message in header */
+    for (i = 0; i < num_clients; i++)
+    {
+        CHECK(data_recv_size[i] > 5);
+        LONGS_EQUAL(data_recv_size[i],
+                    ((unsigned char)data_recv[i][0] << 24)
+                    | ((unsigned char)data_recv[i][1] << 16)
+                    | ((unsigned char)data_recv[i][2] << 8)
+                    | (unsigned char)data_recv[i][3]);
+    }
+    LONGS_EQUAL(RELAY_WEECHAT_COMPRESSION_ZLIB, data_recv[0][4]);
+    LONGS_EQUAL(RELAY_WEECHAT_COMPRESSION_OFF, data_recv[1][4]);
+    LONGS_EQUAL(RELAY_WEECHAT_COMPRESSION_ZLIB, data_recv[2][4]);
+    CHECK(data_recv_size[0] < data_recv_size[1]);
+
+    /* clients with same compression received exactly the same data */
+    LONGS_EQUAL(data_recv_size[0], data_recv_size[2]);
+    MEMCMP_EQUAL(data_recv[0], data_recv[2], data_recv_size[0]);
+
+    /* client not synchronized with buffers does not receive anything */
+    hashtable_remove_all (RELAY_WEECHAT_DATA(clients[1], buffers_sync));
+    reset_clients ();
+    gui_chat_printf_date_tags (buffer, 0, NULL, "test");
+    read_clients (0);
+    CHECK(bytes_recv[0] > 0);
+    LONGS_EQUAL(0, bytes_recv[1]);
+    CHECK(bytes_recv[2] > 0);
+
+    /* disconnected clients do not use the hook any more */
+    relay_client_set_status (clients[0], RELAY_STATUS_DISCONNECTED);
+    LONGS_EQUAL(2, relay_weechat_signal_buffer_clients);
+    relay_client_set_status (clients[1], RELAY_STATUS_DISCONNECTED);
+    relay_client_set_status (clients[2], RELAY_STATUS_DISCONNECTED);
+    LONGS_EQUAL(0, relay_weechat_signal_buffer_clients);
+    POINTERS_EQUAL(NULL, relay_weechat_hook_signal_buffer);
+}
+
+/*
+ * Tests functions:
+ *   relay_weechat_protocol_signal_buffer_cb (benchmark)
+ *
+ * Compares the message built and compressed once for all clients with a
+ * message built and compressed for each client.
+ */
+
+TEST(RelayWeechat, SignalBufferBenchmark)
+{
+    struct t_relay_weechat_msg *msg;
+    struct t_gui_line *ptr_line;
+    struct timeval time1, time2;
+    char cmd_hdata[64];
+    long long time_shared, time_per_client, bytes_shared, bytes_per_client;
+    int i, j;
+
+    for (i = 0; i < RELAY_WEECHAT_TEST_MAX_CLIENTS; i++)
+    {
+        add_client (RELAY_WEECHAT_COMPRESSION_ZLIB);
+    }
+    reset_clients ();
+
+    /* measure only the relay protocol (no refresh of relay buffer) */
+    if (relay_buffer)
+        gui_buffer_close (relay_buffer);
+
+    gui_chat_printf_date_tags (
+        buffer, 0, "irc_privmsg,notify_message,nick_alice,log1",
+        "alice\tthis is a message on a busy channel, sent to %d relay clients",
+        num_clients);
+    ptr_line = buffer->own_lines->last_line;
+    CHECK(ptr_line);
+    reset_clients ();
+
+    /* message built and compressed once for all clients */
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < RELAY_WEECHAT_TEST_BENCHMARK_LINES; i++)
+    {
+        relay_weechat_protocol_signal_buffer_cb (NULL, NULL,
+                                                 "buffer_line_added",
+                                                 WEECHAT_HOOK_SIGNAL_POINTER,
+                                                 ptr_line);
+        read_clients (0);
+    }
+    gettimeofday (&time2, NULL);
+    time_shared = util_timeval_diff (&time1, &time2);
+    bytes_shared = 0;
+    for (i = 0; i < num_clients; i++)
+    {
+        CHECK(bytes_recv[i] > 0);
+        LONGS_EQUAL(bytes_recv[0], bytes_recv[i]);
+        bytes_shared += bytes_recv[i];
+    }
+
+    /* message built and compressed for each client (as before) */
+    snprintf (cmd_hdata, sizeof (cmd_hdata),
+              "line_data:0x%lx", (long unsigned int)ptr_line->data);
+    reset_clients ();
+    gettimeofday (&time1, NULL);
+    for (i = 0; i < RELAY_WEECHAT_TEST_BENCHMARK_LINES; i++)
+    {
+        for (j = 0; j < num_clients; j++)
+        {
+            msg = relay_weechat_msg_new ("_buffer_line_added");
+            CHECK(msg);
+            relay_weechat_msg_add_hdata (msg, cmd_hdata,
+                                         "buffer,date,date_printed,"
+                                         "displayed,highlight,tags_array,"
+                                         "prefix,message");
+            relay_weechat_msg_send (clients[j], msg);
+            relay_weechat_msg_free (msg);
+        }
+        read_clients (0);
+    }
+    gettimeofday (&time2, NULL);
+    time_per_client = util_timeval_diff (&time1, &time2);
+    bytes_per_client = 0;
+    for (i = 0; i < num_clients; i++)
+    {
+        bytes_per_client += bytes_recv[i];
+    }
+    LONGS_EQUAL(bytes_shared, bytes_per_client);
+
+    printf ("\n");
+    printf ("relay benchmark (%d lines, %d clients):\n",
+            RELAY_WEECHAT_TEST_BENCHMARK_LINES, num_clients);
+    printf ("  encoded once . . . . : %lld ms (%lld bytes sent)\n",
+            time_shared / 1000, bytes_shared);
+    printf ("  encoded per client . : %lld ms (%lld bytes sent)\n",
+            time_per_client / 1000, bytes_per_client);
+}
+
+/*
+ * Tests functions:
+ *   relay_client_send (messages added in out queue when socket is full)
+ *   relay_client_outqueue_send
+ *   relay_client_recv_cb (out queue sent when socket is writable)
+ */
+
+TEST(RelayWeechat, ClientOutqueue)
+{
+    struct t_relay_client *client;
+    char data[4096];
+    int i, loops;
+
+    add_client (RELAY_WEECHAT_COMPRESSION_OFF);
+    reset_clients ();
+    client = clients[0];
+    client->bytes_sent = 0;
+
+    /* send more data than the socket can accept: out queue is used */
+    for (i = 0; i < RELAY_WEECHAT_TEST_OUTQUEUE_MSGS; i++)
+    {
+        memset (data, i % 256, sizeof (data));
+        relay_client_send (client, RELAY_CLIENT_MSG_STANDARD,
+                           data, sizeof (data), NULL);
+    }
+    CHECK(client->outqueue);
+    CHECK(client->outqueue_count > 0);
+    CHECK(client->outqueue_bytes > 0);
+    CHECK(client->outqueue_bytes < (unsigned long long)RELAY_WEECHAT_TEST_OUTQUEUE_MSGS * sizeof (data));
+    LONGS_EQUAL(1, client->hook_fd_write);
+
+    /* socket is not writable: nothing is sent */
+    relay_client_outqueue_send (client);
+    CHECK(client->outqueue);
+
+    /* peer reads data, socket becomes writable: out queue is sent */
+    loops = 0;
+    while (client->outqueue && (loops < 100000))
+    {
+        read_clients (1);
+        relay_client_recv_cb (client, NULL, client->sock);
+        loops++;
+    }
+    read_clients (1);
+    POINTERS_EQUAL(NULL, client->outqueue);
+    POINTERS_EQUAL(NULL, client->last_outqueue);
+    LONGS_EQUAL(0, client->outqueue_count);
+    LONGS_EQUAL(0, client->outqueue_bytes);
+    LONGS_EQUAL(0, client->hook_fd_write);
+    LONGS_EQUAL(RELAY_STATUS_CONNECTED, client->status);
+    CHECK(client->outqueue_bytes_drained > 0);
+
+    /* all data received, in order */
+    LONGS_EQUAL(RELAY_WEECHAT_TEST_OUTQUEUE_MSGS * sizeof (data),
+                client->bytes_sent);
+    LONGS_EQUAL(RELAY_WEECHAT_TEST_OUTQUEUE_MSGS * sizeof (data),
+                data_recv_size[0]);
+    for (i = 0; i < data_recv_size[0]; i += 1000)
+    {
+        LONGS_EQUAL((i / (int)sizeof (data)) % 256,
+                    (unsigned char)data_recv[0][i]);
+    }
+}
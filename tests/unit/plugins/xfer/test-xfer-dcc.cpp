@@ -0,0 +1,464 @@
+/*
+ * test-xfer-dcc.cpp - test DCC file transfer functions
+ *
+ * Copyright (C) 2018 Sébastien Helleu <flashcode@flashtux.org>
+ *
+ * This file is part of WeeChat, the extensible chat client.
+ *
+ * WeeChat is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * WeeChat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with WeeChat.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <gcrypt.h>
+#include "src/core/wee-config-file.h"
+#include "src/core/wee-hook.h"
+#include "src/core/wee-util.h"
+#include "src/plugins/xfer/xfer.h"
+#include "src/plugins/xfer/xfer-config.h"
+#include "src/plugins/xfer/xfer-network.h"
+}
+
+#define XFER_DCC_TEST_SIZE (1024 * 1024 + 123)
+#define XFER_DCC_TEST_BENCHMARK_SIZE (64 * 1024 * 1024)
+
+TEST_GROUP(XferDcc)
+{
+    char filename_send[256], filename_recv[256];
+    int sock_listen, sock_peer, port;
+    unsigned long long peer_pos;
+    char *data;
+    unsigned long long size;
+
+    void setup ()
+    {
+        snprintf (filename_send, sizeof (filename_send),
+                  "/tmp/weechat_test_xfer_send_%d", (int)getpid ());
+        snprintf (filename_recv, sizeof (filename_recv),
+                  "/tmp/weechat_test_xfer_recv_%d", (int)getpid ());
+        sock_listen = -1;
+        sock_peer = -1;
+        port = 0;
+        peer_pos = 0;
+        data = NULL;
+        size = 0;
+    }
+
+    void teardown ()
+    {
+        if (sock_peer >= 0)
+            close (sock_peer);
+        if (sock_listen >= 0)
+            close (sock_listen);
+        if (data)
+            free (data);
+        unlink (filename_send);
+        unlink (filename_recv);
+    }
+
+    /*
+     * Creates data (and file to send) with the given size.
+     */
+
+    void create_data (unsigned long long data_size)
+    {
+        unsigned long long i;
+        int fd;
+
+        size = data_size;
+        data = (char *)malloc (size);
+        CHECK(data);
+        for (i = 0; i < size; i++)
+        {
+            data[i] = (char)((i * 7) + (i >> 12));
+        }
+        fd = open (filename_send, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        CHECK(fd >= 0);
+        LONGS_EQUAL(size, write (fd, data, size));
+        close (fd);
+    }
+
+    /*
+     * Checks that received file has the expected content.
+     */
+
+    void check_file_received ()
+    {
+        char *content;
+        int fd;
+
+        content = (char *)malloc (size + 1);
+        CHECK(content);
+        fd = open (filename_recv, O_RDONLY);
+        CHECK(fd >= 0);
+        LONGS_EQUAL(size, read (fd, content, size + 1));
+        close (fd);
+        CHECK(memcmp (content, data, size) == 0);
+        free (content);
+    }
+
+    /*
+     * Creates a listening socket on loopback (non-blocking).
+     */
+
+    void listen_loopback ()
+    {
+        struct sockaddr_in addr;
+        socklen_t length;
+
+        sock_listen = socket (AF_INET, SOCK_STREAM, 0);
+        CHECK(sock_listen >= 0);
+        memset (&addr, 0, sizeof (addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        LONGS_EQUAL(0, bind (sock_listen, (struct sockaddr *)&addr,
+                             sizeof (addr)));
+        LONGS_EQUAL(0, listen (sock_listen, 1));
+        length = sizeof (addr);
+        getsockname (sock_listen, (struct sockaddr *)&addr, &length);
+        port = ntohs (addr.sin_port);
+        fcntl (sock_listen, F_SETFL,
+               fcntl (sock_listen, F_GETFL) | O_NONBLOCK);
+    }
+
+    /*
+     * Creates a xfer for a file of the test.
+     */
+
+    struct t_xfer *new_xfer (enum t_xfer_type type)
+    {
+        struct t_xfer *xfer;
+
+        xfer = xfer_alloc ();
+        CHECK(xfer);
+        xfer->plugin_name = (char *)"test";
+        xfer->plugin_id = strdup ("test");
+        xfer->type = type;
+        xfer->protocol = XFER_PROTOCOL_DCC;
+        xfer->remote_nick = strdup ("bob");
+        xfer->local_nick = strdup ("alice");
+        xfer->filename = strdup ("test_file");
+        xfer->local_filename = strdup ((type == XFER_TYPE_FILE_SEND) ?
+                                       filename_send : filename_recv);
+        xfer->remote_address_str = strdup ("127.0.0.1");
+        xfer->port = port;
+        xfer->proxy = NULL;
+        xfer->size = size;
+        xfer->hash_handle = NULL;
+        xfer->hash_target = NULL;
+        xfer->hash_status = XFER_HASH_STATUS_UNKNOWN;
+        return xfer;
+    }
+
+    /*
+     * Sends ACK with the number of bytes received by peer.
+     */
+
+    void peer_send_ack ()
+    {
+        uint32_t ack;
+
+        ack = htonl ((uint32_t)peer_pos);
+        (void) send (sock_peer, &ack, 4, 0);
+    }
+
+    /*
+     * Runs the main loop (fd and timer hooks) until xfer has ended, acting as
+     * the receiver (if the xfer is sending a file) or the sender (if the
+     * xfer is receiving a file).
+     */
+
+    void run_transfer (struct t_xfer *xfer)
+    {
+        struct timeval tv_start, tv_now;
+        char buf[65536];
+        ssize_t num;
+
+        gettimeofday (&tv_start, NULL);
+        while (!XFER_HAS_ENDED(xfer->status))
+        {
+            hook_timer_exec ();
+            hook_fd_exec ();
+
+            if ((sock_peer < 0) && (sock_listen >= 0))
+            {
+                sock_peer = accept (sock_listen, NULL, NULL);
+                if (sock_peer >= 0)
+                {
+                    fcntl (sock_peer, F_SETFL,
+                           fcntl (sock_peer, F_GETFL) | O_NONBLOCK);
+                }
+            }
+            if (sock_peer >= 0)
+            {
+                if (xfer->type == XFER_TYPE_FILE_SEND)
+                {
+                    /* receive data and send ACK */
+                    while ((num = recv (sock_peer, buf, sizeof (buf), 0)) > 0)
+                    {
+                        CHECK(memcmp (buf, data + peer_pos, num) == 0);
+                        peer_pos += num;
+                    }
+                    if (num != 0)
+                        peer_send_ack ();
+                }
+                else
+                {
+                    /* send data and read ACK */
+                    while (peer_pos < size)
+                    {
+                        num = send (sock_peer, data + peer_pos,
+                                    ((size - peer_pos) > sizeof (buf)) ?
+                                    sizeof (buf) : size - peer_pos, 0);
+                        if (num <= 0)
+                            break;
+                        peer_pos += num;
+                    }
+                    while (recv (sock_peer, buf, sizeof (buf), 0) > 0)
+                    {
+                    }
+                }
+            }
+
+            gettimeofday (&tv_now, NULL);
+            if (util_timeval_diff (&tv_start, &tv_now) > 20000000LL)
+                break;
+        }
+    }
+
+    /*
+     * Sends the test file to peer (connected with TCP on loopback).
+     *
+     * Returns the time elapsed, in microseconds.
+     */
+
+    long long send_file (int fast_send)
+    {
+        struct t_xfer *xfer;
+        struct sockaddr_in addr;
+        struct timeval tv1, tv2;
+        int sock;
+
+        listen_loopback ();
+        memset (&addr, 0, sizeof (addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        addr.sin_port = htons (port);
+        sock_peer = socket (AF_INET, SOCK_STREAM, 0);
+        LONGS_EQUAL(0, connect (sock_peer, (struct sockaddr *)&addr,
+                                sizeof (addr)));
+        fcntl (sock_peer, F_SETFL, fcntl (sock_peer, F_GETFL) | O_NONBLOCK);
+        sock = accept (sock_listen, NULL, NULL);
+        CHECK(sock >= 0);
+        fcntl (sock, F_SETFL, fcntl (sock, F_GETFL) | O_NONBLOCK);
+
+        xfer = new_xfer (XFER_TYPE_FILE_SEND);
+        xfer->fast_send = fast_send;
+        xfer->sock = sock;
+        xfer->status = XFER_STATUS_ACTIVE;
+
+        gettimeofday (&tv1, NULL);
+        xfer_network_send_file_start (xfer);
+        run_transfer (xfer);
+        gettimeofday (&tv2, NULL);
+
+        LONGS_EQUAL(XFER_STATUS_DONE, xfer->status);
+        CHECK(size == xfer->pos);
+        CHECK(size == peer_pos);
+        xfer_free (xfer);
+
+        return util_timeval_diff (&tv1, &tv2);
+    }
+
+    /*
+     * Receives the test file from peer (connected with TCP on loopback).
+     *
+     * Returns the time elapsed, in microseconds.
+     */
+
+    long long recv_file (const char *hash_target)
+    {
+        struct t_xfer *xfer;
+        struct timeval tv1, tv2;
+        int expected_hash_status;
+
+        listen_loopback ();
+
+        xfer = new_xfer (XFER_TYPE_FILE_RECV);
+        if (hash_target)
+        {
+            xfer->hash_handle = (gcry_md_hd_t *)malloc (sizeof (gcry_md_hd_t));
+            CHECK(xfer->hash_handle);
+            LONGS_EQUAL(0, gcry_md_open (xfer->hash_handle, GCRY_MD_CRC32, 0));
+            xfer->hash_target = strdup (hash_target);
+            xfer->hash_status = XFER_HASH_STATUS_IN_PROGRESS;
+        }
+
+        gettimeofday (&tv1, NULL);
+        xfer_network_connect_init (xfer);
+        run_transfer (xfer);
+        gettimeofday (&tv2, NULL);
+
+        LONGS_EQUAL(XFER_STATUS_DONE, xfer->status);
+        CHECK(size == xfer->pos);
+        if (hash_target)
+        {
+            expected_hash_status = (strcmp (hash_target, "00000000") == 0) ?
+                XFER_HASH_STATUS_MISMATCH : XFER_HASH_STATUS_MATCH;
+            LONGS_EQUAL(expected_hash_status, xfer->hash_status);
+        }
+        xfer_free (xfer);
+
+        check_file_received ();
+
+        close (sock_peer);
+        sock_peer = -1;
+        close (sock_listen);
+        sock_listen = -1;
+        peer_pos = 0;
+
+        return util_timeval_diff (&tv1, &tv2);
+    }
+
+    /*
+     * Returns CRC32 of test data (as hexadecimal string).
+     */
+
+    void data_crc32 (char *hash, int size_hash)
+    {
+        unsigned char crc[4];
+
+        gcry_md_hash_buffer (GCRY_MD_CRC32, crc, data, size);
+        snprintf (hash, size_hash, "%02X%02X%02X%02X",
+                  crc[0], crc[1], crc[2], crc[3]);
+    }
+};
+
+/*
+ * Tests functions:
+ *   xfer_network_send_file_start
+ *   xfer_dcc_send_file_start
+ *   xfer_dcc_send_file_blocks
+ */
+
+TEST(XferDcc, SendFile)
+{
+    /* fast send: blocks are sent without waiting ACK */
+    create_data (XFER_DCC_TEST_SIZE);
+    send_file (1);
+    close (sock_peer);
+    sock_peer = -1;
+    close (sock_listen);
+    sock_listen = -1;
+    peer_pos = 0;
+
+    /* slow send: wait ACK after each block */
+    send_file (0);
+}
+
+/*
+ * Tests functions:
+ *   xfer_dcc_speed_limit_refill
+ */
+
+TEST(XferDcc, SendFileSpeedLimit)
+{
+    long long time_send;
+
+    /* 384 KB at 256 KB/s: one block is sent immediately, then ~1.25s */
+    create_data (384 * 1024);
+    config_file_option_set (xfer_config_network_speed_limit, "256", 1);
+    time_send = send_file (1);
+    config_file_option_set (xfer_config_network_speed_limit, "0", 1);
+
+    CHECK(time_send >= 1000000LL);
+    CHECK(time_send < 5000000LL);
+}
+
+/*
+ * Tests functions:
+ *   xfer_network_recv_file_start
+ *   xfer_dcc_recv_file_start
+ *   xfer_dcc_recv_file_fd_cb
+ */
+
+TEST(XferDcc, RecvFile)
+{
+    char hash[16];
+
+    create_data (XFER_DCC_TEST_SIZE);
+    data_crc32 (hash, sizeof (hash));
+
+    /* splice (no hash) */
+    recv_file (NULL);
+
+    /* copy in a buffer (with hash) */
+    recv_file (hash);
+
+    /* wrong hash */
+    recv_file ("00000000");
+}
+
+/*
+ * Tests functions:
+ *   xfer_dcc_send_file_blocks (benchmark)
+ *   xfer_dcc_recv_file_fd_cb (benchmark)
+ *
+ * Transfers a file on loopback, in the main loop of WeeChat.
+ */
+
+TEST(XferDcc, Benchmark)
+{
+    long long time_send, time_recv_splice, time_recv_copy;
+    char hash[16];
+
+    create_data (XFER_DCC_TEST_BENCHMARK_SIZE);
+    data_crc32 (hash, sizeof (hash));
+
+    time_send = send_file (1);
+    close (sock_peer);
+    sock_peer = -1;
+    close (sock_listen);
+    sock_listen = -1;
+    peer_pos = 0;
+
+    time_recv_splice = recv_file (NULL);
+    time_recv_copy = recv_file (hash);
+
+    printf ("\n");
+    printf ("xfer DCC benchmark (%d MB on loopback):\n",
+            XFER_DCC_TEST_BENCHMARK_SIZE / (1024 * 1024));
+    printf ("  send (sendfile). . . . . . : %lld ms (%lld MB/s)\n",
+            time_send / 1000,
+            (long long)XFER_DCC_TEST_BENCHMARK_SIZE / ((time_send > 0) ? time_send : 1));
+    printf ("  receive (splice) . . . . . : %lld ms (%lld MB/s)\n",
+            time_recv_splice / 1000,
+            (long long)XFER_DCC_TEST_BENCHMARK_SIZE / ((time_recv_splice > 0) ? time_recv_splice : 1));
+    printf ("  receive (copy + CRC32) . . : %lld ms (%lld MB/s)\n",
+            time_recv_copy / 1000,
+            (long long)XFER_DCC_TEST_BENCHMARK_SIZE / ((time_recv_copy > 0) ? time_recv_copy : 1));
+}